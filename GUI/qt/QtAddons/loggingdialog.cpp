@@ -15,6 +15,7 @@ LoggingDialog::LoggingDialog(QWidget *parent) :
 
 LoggingDialog::~LoggingDialog()
 {
+    kipl::logging::Logger::RemoveLogTarget(*this);
     delete ui;
 }
 
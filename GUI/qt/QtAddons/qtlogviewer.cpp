@@ -22,6 +22,7 @@ QtLogViewer::QtLogViewer(QWidget *parent) :
 
 QtLogViewer::~QtLogViewer()
 {
+    kipl::logging::Logger::RemoveLogTarget(*this);
     delete ui;
 }
 
@@ -0,0 +1,201 @@
+//<LICENSE>
+
+#include "benchmarkcases.h"
+#include "syntheticdata.h"
+
+#include <algorithm>
+
+#include <base/timage.h>
+
+#include <projectionfilter.h>
+#include <ReferenceImageCorrection.h>
+#include <MorphSpotClean.h>
+
+namespace {
+
+/// Number of projections filtered per run
+const size_t nFilterProjections=32;
+
+/// Number of transmission images normalized per run
+const size_t nNormProjections=16;
+
+class ProjectionFilterBenchmark : public BenchmarkCase
+{
+public:
+    ProjectionFilterBenchmark() : BenchmarkCase("ProjectionFilter","ImagingAlgorithms","pixel") {}
+
+    void setup(size_t size)
+    {
+        std::vector<float> angles;
+        proj=SyntheticData::projections(size,size,nFilterProjections,angles);
+        work.Resize(proj.Dims());
+        filter.setFilter(ImagingAlgorithms::ProjectionFilterHamming,0.5f);
+    }
+
+    void prepare()
+    {
+        std::copy_n(proj.GetDataPtr(),proj.Size(),work.GetDataPtr());
+    }
+
+    void run()
+    {
+        filter.process(work);
+    }
+
+    double items() const { return static_cast<double>(proj.Size()); }
+
+private:
+    ImagingAlgorithms::ProjectionFilter filter;
+    kipl::base::TImage<float,3> proj;
+    kipl::base::TImage<float,3> work;
+};
+
+class ReferenceImageCorrectionBenchmark : public BenchmarkCase
+{
+public:
+    ReferenceImageCorrectionBenchmark() : BenchmarkCase("ReferenceImageCorrection","ImagingAlgorithms","pixel") {}
+
+    void setup(size_t size)
+    {
+        SyntheticData::transmissionImages(size,nNormProjections,img,ob,dc,dose);
+        work.Resize(img.Dims());
+        obwork.Resize(ob.Dims());
+    }
+
+    void prepare()
+    {
+        std::copy_n(img.GetDataPtr(),img.Size(),work.GetDataPtr());
+        std::copy_n(ob.GetDataPtr(),ob.Size(),obwork.GetDataPtr());
+
+        // The references are prepared when they are set, this is not part of the timed normalization
+        correction.reset(new ImagingAlgorithms::ReferenceImageCorrection);
+        correction->SetComputeMinusLog(true);
+        correction->SetPBvariante(false);
+        correction->SetReferenceImages(&obwork,&dc,false,false,false,1.0f,1.0f,false,nullptr,nullptr);
+    }
+
+    void run()
+    {
+        correction->Process(work,dose.data());
+    }
+
+    double items() const { return static_cast<double>(img.Size()); }
+
+    void teardown()
+    {
+        correction.reset();
+    }
+
+private:
+    std::unique_ptr<ImagingAlgorithms::ReferenceImageCorrection> correction;
+    kipl::base::TImage<float,3> img;
+    kipl::base::TImage<float,3> work;
+    kipl::base::TImage<float,2> ob;
+    kipl::base::TImage<float,2> obwork;
+    kipl::base::TImage<float,2> dc;
+    std::vector<float> dose;
+};
+
+class MorphSpotCleanBenchmark : public BenchmarkCase
+{
+public:
+    MorphSpotCleanBenchmark() : BenchmarkCase("MorphSpotClean","ImagingAlgorithms","pixel")
+    {
+        cleaner.setCleanMethod(ImagingAlgorithms::MorphDetectBoth,ImagingAlgorithms::MorphCleanReplace);
+        cleaner.setConnectivity(kipl::base::conn8);
+    }
+
+    void setup(size_t size)
+    {
+        img=SyntheticData::spotImage(size);
+        work.Resize(img.Dims());
+    }
+
+    void prepare()
+    {
+        std::copy_n(img.GetDataPtr(),img.Size(),work.GetDataPtr());
+    }
+
+    void run()
+    {
+        cleaner.process(work,0.5f,0.05f);
+    }
+
+    double items() const { return static_cast<double>(img.Size()); }
+
+private:
+    ImagingAlgorithms::MorphSpotClean cleaner;
+    kipl::base::TImage<float,2> img;
+    kipl::base::TImage<float,2> work;
+};
+
+/// \brief Normalizes, cleans and filters a stack of transmission images like the preprocessing of a reconstruction.
+///
+/// The steps create temporaries for each projection, running it with and without the buffer pool shows the allocation cost.
+class PreprocessingChainBenchmark : public BenchmarkCase
+{
+public:
+    PreprocessingChainBenchmark() : BenchmarkCase("PreprocessingChain","ImagingAlgorithms","pixel")
+    {
+        cleaner.setCleanMethod(ImagingAlgorithms::MorphDetectBoth,ImagingAlgorithms::MorphCleanReplace);
+        cleaner.setConnectivity(kipl::base::conn8);
+        filter.setFilter(ImagingAlgorithms::ProjectionFilterHamming,0.5f);
+    }
+
+    void setup(size_t size)
+    {
+        SyntheticData::transmissionImages(size,nNormProjections,img,ob,dc,dose);
+        work.Resize(img.Dims());
+        obwork.Resize(ob.Dims());
+    }
+
+    void prepare()
+    {
+        std::copy_n(img.GetDataPtr(),img.Size(),work.GetDataPtr());
+        std::copy_n(ob.GetDataPtr(),ob.Size(),obwork.GetDataPtr());
+
+        correction.reset(new ImagingAlgorithms::ReferenceImageCorrection);
+        correction->SetComputeMinusLog(true);
+        correction->SetPBvariante(false);
+        correction->SetReferenceImages(&obwork,&dc,false,false,false,1.0f,1.0f,false,nullptr,nullptr);
+    }
+
+    void run()
+    {
+        correction->Process(work,dose.data());
+
+        for (size_t i=0; i<work.Size(2); ++i) {
+            kipl::base::TImage<float,2> proj(work.GetLinePtr(0,i),work.Dims());
+            cleaner.process(proj,0.5f,0.05f);
+            filter.process(proj);
+        }
+    }
+
+    double items() const { return static_cast<double>(img.Size()); }
+
+    void teardown()
+    {
+        correction.reset();
+    }
+
+private:
+    std::unique_ptr<ImagingAlgorithms::ReferenceImageCorrection> correction;
+    ImagingAlgorithms::MorphSpotClean cleaner;
+    ImagingAlgorithms::ProjectionFilter filter;
+    kipl::base::TImage<float,3> img;
+    kipl::base::TImage<float,3> work;
+    kipl::base::TImage<float,2> ob;
+    kipl::base::TImage<float,2> obwork;
+    kipl::base::TImage<float,2> dc;
+    std::vector<float> dose;
+};
+
+}
+
+void addAlgorithmBenchmarks(BenchmarkRunner &runner)
+{
+    runner.add(std::unique_ptr<BenchmarkCase>(new ProjectionFilterBenchmark));
+    runner.add(std::unique_ptr<BenchmarkCase>(new ReferenceImageCorrectionBenchmark));
+    runner.add(std::unique_ptr<BenchmarkCase>(new MorphSpotCleanBenchmark));
+    runner.add(std::unique_ptr<BenchmarkCase>(new PreprocessingChainBenchmark));
+}
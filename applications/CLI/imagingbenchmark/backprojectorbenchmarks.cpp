@@ -0,0 +1,144 @@
+//<LICENSE>
+
+#include "benchmarkcases.h"
+#include "syntheticdata.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <sstream>
+
+#include <base/timage.h>
+#include <base/kiplenums.h>
+#include <strings/filenames.h>
+
+#include <ReconConfig.h>
+#include <ModuleItem.h>
+
+namespace {
+
+/// Number of projections back-projected per run
+const size_t nBPProjections=180;
+
+/// Number of reconstructed slices
+const size_t nBPSlices=16;
+
+std::string libraryName(const std::string &path, const std::string &name)
+{
+    switch (kipl::base::getOperatingSystem()) {
+    case kipl::base::OSWindows : return path+name+".dll";
+    case kipl::base::OSMacOS   : return path+"lib"+name+".dylib";
+    default                    : return path+"lib"+name+".so";
+    }
+}
+
+/// \brief Reconstructs slices from synthetic projections with a back-projector module.
+///
+/// The module is loaded from its shared library like in the reconstruction engine. The cone beam modules use the same
+/// parallel beam projections with a long source distance, only the timing is of interest.
+class BackProjectorBenchmark : public BenchmarkCase
+{
+public:
+    BackProjectorBenchmark(const std::string &name, const std::string &library, const std::string &module, bool coneBeam) :
+        BenchmarkCase(name,"BackProjectors","voxel update"),
+        m_sLibrary(library),
+        m_sModule(module),
+        m_bConeBeam(coneBeam),
+        m_nSize(0)
+    {}
+
+    void setup(size_t size)
+    {
+        m_nSize=size;
+        std::vector<float> angles;
+        proj=SyntheticData::projections(size,nBPSlices,nBPProjections,angles);
+
+        std::ostringstream angleList, weightList;
+        for (float angle : angles) {
+            angleList<<angle<<" ";
+            weightList<<1.0f/nBPProjections<<" ";
+        }
+        parameters["angles"]  = angleList.str();
+        parameters["weights"] = weightList.str();
+
+        ReconConfig config("");
+        config.ProjectionInfo.beamgeometry    = m_bConeBeam ? ReconConfig::cProjections::BeamGeometry_Cone : ReconConfig::cProjections::BeamGeometry_Parallel;
+        config.ProjectionInfo.imagetype       = ReconConfig::cProjections::ImageType_Projections;
+        config.ProjectionInfo.nDims[0]        = size;
+        config.ProjectionInfo.nDims[1]        = nBPSlices;
+        config.ProjectionInfo.nFirstIndex     = 0;
+        config.ProjectionInfo.nLastIndex      = nBPProjections-1;
+        config.ProjectionInfo.nProjectionStep = 1;
+        config.ProjectionInfo.fScanArc[0]     = 0.0f;
+        config.ProjectionInfo.fScanArc[1]     = 180.0f;
+        config.ProjectionInfo.fCenter         = 0.5f*size;
+        config.ProjectionInfo.fResolution[0]  = config.ProjectionInfo.fResolution[1] = 0.1f;
+        config.ProjectionInfo.fSOD            = 10000.0f;
+        config.ProjectionInfo.fSDD            = 10100.0f;
+        config.ProjectionInfo.fpPoint[0]      = 0.5f*size;
+        config.ProjectionInfo.fpPoint[1]      = 0.5f*nBPSlices;
+        config.ProjectionInfo.eDirection      = kipl::base::RotationDirCCW;
+        config.ProjectionInfo.bCorrectTilt    = false;
+
+        m_ROI[0]=0; m_ROI[1]=0; m_ROI[2]=size; m_ROI[3]=nBPSlices;
+        std::copy_n(m_ROI,4,config.ProjectionInfo.roi);
+        std::copy_n(m_ROI,4,config.ProjectionInfo.projection_roi);
+
+        config.MatrixInfo.nDims[0] = size;
+        config.MatrixInfo.nDims[1] = size;
+        config.MatrixInfo.nDims[2] = nBPSlices;
+        for (size_t i=0; i<3; ++i)
+            config.MatrixInfo.fVoxelSize[i] = config.ProjectionInfo.fResolution[0]*config.ProjectionInfo.fSOD/config.ProjectionInfo.fSDD;
+
+        module.reset(new BackProjItem("muhrecbp",m_sLibrary,m_sModule));
+        module->GetModule()->Configure(config,module->GetModule()->GetParameters());
+        module->GetModule()->Initialize();
+    }
+
+    void prepare()
+    {
+        // Allocates and clears the volume
+        module->GetModule()->SetROI(m_ROI);
+    }
+
+    void run()
+    {
+        module->GetModule()->Process(proj,parameters);
+    }
+
+    double items() const
+    {
+        return static_cast<double>(m_nSize)*m_nSize*nBPSlices*nBPProjections;
+    }
+
+    void teardown()
+    {
+        module.reset();
+        proj=kipl::base::TImage<float,3>();
+    }
+
+private:
+    std::string m_sLibrary;
+    std::string m_sModule;
+    bool m_bConeBeam;
+    size_t m_nSize;
+    size_t m_ROI[4];
+    std::unique_ptr<BackProjItem> module;
+    kipl::base::TImage<float,3> proj;
+    std::map<std::string, std::string> parameters;
+};
+
+}
+
+void addBackProjectorBenchmarks(BenchmarkRunner &runner, const std::string &modulePath)
+{
+    std::string path=modulePath;
+    kipl::strings::filenames::CheckPathSlashes(path,true);
+
+    runner.add(std::unique_ptr<BenchmarkCase>(new BackProjectorBenchmark("MultiProjectionBPparallel",
+                                                                         libraryName(path,"StdBackProjectors"),
+                                                                         "MultiProjBPparallel",false)));
+    runner.add(std::unique_ptr<BenchmarkCase>(new BackProjectorBenchmark("FdkBP",
+                                                                         libraryName(path,"FDKBackProjectors"),
+                                                                         "FDKbp",true)));
+}
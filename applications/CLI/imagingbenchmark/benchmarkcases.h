@@ -0,0 +1,24 @@
+//<LICENSE>
+
+#ifndef BENCHMARKCASES_H
+#define BENCHMARKCASES_H
+
+#include <string>
+
+#include "benchmarkrunner.h"
+
+/// \brief Adds the kipl cases: median filter, labeling, TIFF and NeXus reading
+/// \param runner The runner that receives the cases
+/// \param workPath Folder for the temporary files of the reader benchmarks
+void addKiplBenchmarks(BenchmarkRunner &runner, const std::string &workPath);
+
+/// \brief Adds the ImagingAlgorithms cases: projection filter, reference image correction and spot cleaning
+/// \param runner The runner that receives the cases
+void addAlgorithmBenchmarks(BenchmarkRunner &runner);
+
+/// \brief Adds the back-projector cases, the modules are loaded from their shared libraries
+/// \param runner The runner that receives the cases
+/// \param modulePath Folder of the back-projector libraries, an empty string uses the library search path
+void addBackProjectorBenchmarks(BenchmarkRunner &runner, const std::string &modulePath);
+
+#endif // BENCHMARKCASES_H
@@ -0,0 +1,393 @@
+//<LICENSE>
+
+#include "benchmarkrunner.h"
+
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <base/KiplException.h>
+#include <base/kiplenums.h>
+#include <utilities/threadpool.h>
+#include <base/core/bufferpool.h>
+
+namespace {
+
+/// \brief Applies the thread count to the shared pool and to OpenMP
+/// \returns the resulting number of threads
+size_t setThreadCount(size_t nThreads)
+{
+    kipl::utilities::ThreadPool::setGlobalThreadBudget(nThreads);
+    size_t nActual=kipl::utilities::ThreadPool::globalThreadBudget();
+#ifdef _OPENMP
+    omp_set_num_threads(static_cast<int>(nActual));
+#endif
+    return nActual;
+}
+
+void writeJSONString(std::ostream &os, const std::string &str)
+{
+    os<<'"';
+    for (char c : str) {
+        switch (c) {
+        case '"':  os<<"\\\""; break;
+        case '\\': os<<"\\\\"; break;
+        case '\n': os<<"\\n";  break;
+        case '\r': os<<"\\r";  break;
+        case '\t': os<<"\\t";  break;
+        default:
+            if (static_cast<unsigned char>(c)<0x20)
+                os<<"\\u"<<std::hex<<std::setw(4)<<std::setfill('0')<<static_cast<int>(c)<<std::dec<<std::setfill(' ');
+            else
+                os<<c;
+        }
+    }
+    os<<'"';
+}
+
+template <class T>
+void writeJSONList(std::ostream &os, const std::vector<T> &list)
+{
+    os<<'[';
+    for (size_t i=0; i<list.size(); ++i)
+        os<<(i==0 ? "" : ", ")<<list[i];
+    os<<']';
+}
+
+std::string timeStamp()
+{
+    std::time_t now=std::time(nullptr);
+    char buffer[32];
+    std::strftime(buffer,sizeof(buffer),"%Y-%m-%dT%H:%M:%SZ",std::gmtime(&now));
+
+    return buffer;
+}
+
+std::string compilerName()
+{
+    std::ostringstream s;
+#if defined(__clang__)
+    s<<"clang "<<__clang_major__<<"."<<__clang_minor__<<"."<<__clang_patchlevel__;
+#elif defined(__GNUC__)
+    s<<"gcc "<<__GNUC__<<"."<<__GNUC_MINOR__<<"."<<__GNUC_PATCHLEVEL__;
+#elif defined(_MSC_VER)
+    s<<"msvc "<<_MSC_VER;
+#else
+    s<<"unknown";
+#endif
+    return s.str();
+}
+
+}
+
+BenchmarkCase::BenchmarkCase(const std::string &name, const std::string &group, const std::string &unit, bool threaded) :
+    m_sName(name),
+    m_sGroup(group),
+    m_sUnit(unit),
+    m_bThreaded(threaded)
+{}
+
+BenchmarkCase::~BenchmarkCase()
+{}
+
+std::string enum2string(eBenchmarkStatus status)
+{
+    switch (status) {
+    case BenchmarkOK:      return "ok";
+    case BenchmarkSkipped: return "skipped";
+    case BenchmarkFailed:  return "failed";
+    }
+
+    return "unknown";
+}
+
+std::ostream & operator<<(std::ostream &s, eBenchmarkStatus status)
+{
+    s<<enum2string(status);
+
+    return s;
+}
+
+BenchmarkResult::BenchmarkResult() :
+    size(0),
+    threads(0),
+    repetitions(0),
+    items(0.0),
+    tMin(0.0),
+    tMedian(0.0),
+    tMean(0.0),
+    tMax(0.0),
+    tStdDev(0.0),
+    status(BenchmarkOK),
+    pooled(false),
+    poolRequests(0),
+    systemAllocations(0)
+{}
+
+double BenchmarkResult::throughput() const
+{
+    return 0.0<tMedian ? items/tMedian : 0.0;
+}
+
+BenchmarkRunner::BenchmarkRunner() :
+    logger("BenchmarkRunner"),
+    m_Sizes({256,512,1024}),
+    m_Threads({1,0}),
+    m_nRepetitions(5),
+    m_nWarmup(1)
+{}
+
+void BenchmarkRunner::add(std::unique_ptr<BenchmarkCase> bench)
+{
+    m_Cases.push_back(std::move(bench));
+}
+
+std::vector<std::string> BenchmarkRunner::names() const
+{
+    std::vector<std::string> list;
+    for (const auto &bench : m_Cases)
+        list.push_back(bench->group()+"/"+bench->name());
+
+    return list;
+}
+
+void BenchmarkRunner::setSizes(const std::vector<size_t> &sizes)
+{
+    m_Sizes=sizes;
+}
+
+void BenchmarkRunner::setThreads(const std::vector<size_t> &threads)
+{
+    m_Threads=threads;
+}
+
+void BenchmarkRunner::setRepetitions(size_t n)
+{
+    if (n==0)
+        throw kipl::base::KiplException("At least one repetition is needed",__FILE__,__LINE__);
+
+    m_nRepetitions=n;
+}
+
+void BenchmarkRunner::setWarmup(size_t n)
+{
+    m_nWarmup=n;
+}
+
+void BenchmarkRunner::setFilter(const std::string &filter)
+{
+    m_sFilter=filter;
+}
+
+bool BenchmarkRunner::selected(const BenchmarkCase &bench) const
+{
+    return m_sFilter.empty() || ((bench.group()+"/"+bench.name()).find(m_sFilter)!=std::string::npos);
+}
+
+const std::vector<BenchmarkResult> & BenchmarkRunner::run()
+{
+    m_Results.clear();
+    const size_t nStartThreads=kipl::utilities::ThreadPool::globalThreadBudget();
+
+    for (auto &bench : m_Cases) {
+        if (!selected(*bench))
+            continue;
+
+        for (size_t size : m_Sizes)
+            runCase(*bench,size);
+    }
+
+    setThreadCount(nStartThreads);
+
+    return m_Results;
+}
+
+void BenchmarkRunner::runCase(BenchmarkCase &bench, size_t size)
+{
+    std::ostringstream msg;
+
+    BenchmarkResult setupResult;
+    setupResult.name  = bench.name();
+    setupResult.group = bench.group();
+    setupResult.unit  = bench.unit();
+    setupResult.size  = size;
+
+    try {
+        bench.setup(size);
+    }
+    catch (std::exception &e) {
+        setupResult.status  = BenchmarkSkipped;
+        setupResult.message = e.what();
+        m_Results.push_back(setupResult);
+
+        msg<<"Skipped "<<bench.group()<<"/"<<bench.name()<<" size="<<size<<": "<<e.what();
+        logger(logger.LogWarning,msg.str());
+        bench.teardown();
+        return;
+    }
+
+    std::vector<size_t> threads=m_Threads;
+    if (!bench.threaded())
+        threads={1};
+
+    for (size_t nThreads : threads)
+        m_Results.push_back(measure(bench,size,nThreads));
+
+    bench.teardown();
+}
+
+BenchmarkResult BenchmarkRunner::measure(BenchmarkCase &bench, size_t size, size_t nThreads)
+{
+    std::ostringstream msg;
+
+    BenchmarkResult result;
+    result.name    = bench.name();
+    result.group   = bench.group();
+    result.unit    = bench.unit();
+    result.size    = size;
+    result.threads = setThreadCount(nThreads);
+    result.items   = bench.items();
+    result.pooled  = kipl::base::core::BufferPool::enabled();
+
+    std::vector<double> times;
+    try {
+        for (size_t i=0; i<m_nWarmup; ++i) {
+            bench.prepare();
+            bench.run();
+        }
+
+        for (size_t i=0; i<m_nRepetitions; ++i) {
+            bench.prepare();
+            const auto poolBefore=kipl::base::core::BufferPool::statistics();
+            auto start=std::chrono::steady_clock::now();
+            bench.run();
+            auto stop=std::chrono::steady_clock::now();
+            times.push_back(std::chrono::duration<double>(stop-start).count());
+
+            const auto poolAfter=kipl::base::core::BufferPool::statistics();
+            result.poolRequests      += poolAfter.requests-poolBefore.requests;
+            result.systemAllocations += poolAfter.systemAllocations-poolBefore.systemAllocations;
+        }
+    }
+    catch (std::exception &e) {
+        result.status  = BenchmarkFailed;
+        result.message = e.what();
+
+        msg<<"Failed "<<bench.group()<<"/"<<bench.name()<<" size="<<size<<" threads="<<result.threads<<": "<<e.what();
+        logger(logger.LogError,msg.str());
+        return result;
+    }
+
+    std::sort(times.begin(),times.end());
+    const size_t N=times.size();
+
+    result.repetitions = N;
+    result.tMin    = times.front();
+    result.tMax    = times.back();
+    result.tMedian = (N % 2)==1 ? times[N/2] : 0.5*(times[N/2-1]+times[N/2]);
+    result.tMean   = std::accumulate(times.begin(),times.end(),0.0)/N;
+
+    double sum2=0.0;
+    for (double t : times)
+        sum2+=(t-result.tMean)*(t-result.tMean);
+    result.tStdDev = 1<N ? std::sqrt(sum2/(N-1)) : 0.0;
+
+    msg<<bench.group()<<"/"<<bench.name()<<" size="<<size<<" threads="<<result.threads
+       <<" median="<<result.tMedian<<"s, "<<result.throughput()<<" "<<bench.unit()<<"/s";
+    logger(logger.LogMessage,msg.str());
+
+    return result;
+}
+
+void BenchmarkRunner::writeJSON(std::ostream &os) const
+{
+    os<<std::setprecision(9);
+    os<<"{\n";
+    os<<"  \"benchmark\": \"imagingbenchmark\",\n";
+    os<<"  \"formatVersion\": 1,\n";
+    os<<"  \"timestamp\": "; writeJSONString(os,timeStamp()); os<<",\n";
+
+    os<<"  \"system\": {\n";
+    os<<"    \"os\": "; writeJSONString(os,enum2string(kipl::base::getOperatingSystem())); os<<",\n";
+    os<<"    \"hardwareThreads\": "<<std::thread::hardware_concurrency()<<",\n";
+    os<<"    \"compiler\": "; writeJSONString(os,compilerName()); os<<",\n";
+#ifdef NDEBUG
+    os<<"    \"build\": \"release\"\n";
+#else
+    os<<"    \"build\": \"debug\"\n";
+#endif
+    os<<"  },\n";
+
+    os<<"  \"settings\": {\n";
+    os<<"    \"sizes\": "; writeJSONList(os,m_Sizes); os<<",\n";
+    os<<"    \"threads\": "; writeJSONList(os,m_Threads); os<<",\n";
+    os<<"    \"repetitions\": "<<m_nRepetitions<<",\n";
+    os<<"    \"warmup\": "<<m_nWarmup<<",\n";
+    os<<"    \"filter\": "; writeJSONString(os,m_sFilter); os<<",\n";
+    os<<"    \"bufferPool\": "<<(kipl::base::core::BufferPool::enabled() ? "true" : "false")<<"\n";
+    os<<"  },\n";
+
+    os<<"  \"results\": [";
+    for (size_t i=0; i<m_Results.size(); ++i) {
+        const BenchmarkResult &res=m_Results[i];
+        os<<(i==0 ? "\n" : ",\n");
+        os<<"    {\"group\": "; writeJSONString(os,res.group);
+        os<<", \"name\": "; writeJSONString(os,res.name);
+        os<<", \"size\": "<<res.size;
+        os<<", \"threads\": "<<res.threads;
+        os<<", \"status\": "; writeJSONString(os,enum2string(res.status));
+        if (res.status==BenchmarkOK) {
+            os<<", \"repetitions\": "<<res.repetitions;
+            os<<", \"seconds\": {\"min\": "<<res.tMin<<", \"median\": "<<res.tMedian<<", \"mean\": "<<res.tMean
+              <<", \"max\": "<<res.tMax<<", \"stddev\": "<<res.tStdDev<<"}";
+            os<<", \"items\": "<<res.items;
+            os<<", \"unit\": "; writeJSONString(os,res.unit);
+            os<<", \"throughput\": "<<res.throughput();
+            if (res.pooled)
+                os<<", \"bufferPool\": {\"requests\": "<<res.poolRequests<<", \"systemAllocations\": "<<res.systemAllocations<<"}";
+        }
+        else {
+            os<<", \"message\": "; writeJSONString(os,res.message);
+        }
+        os<<"}";
+    }
+    os<<"\n  ]\n";
+    os<<"}\n";
+}
+
+void BenchmarkRunner::writeJSON(const std::string &fname) const
+{
+    std::ofstream os(fname.c_str());
+
+    if (!os.good())
+        throw kipl::base::KiplException("Could not open "+fname+" for writing",__FILE__,__LINE__);
+
+    writeJSON(os);
+}
+
+void BenchmarkRunner::writeTable(std::ostream &os) const
+{
+    os<<std::left<<std::setw(40)<<"benchmark"<<std::right<<std::setw(7)<<"size"<<std::setw(9)<<"threads"
+      <<std::setw(14)<<"median [s]"<<std::setw(14)<<"min [s]"<<std::setw(16)<<"items/s"<<"\n";
+
+    for (const auto &res : m_Results) {
+        os<<std::left<<std::setw(40)<<(res.group+"/"+res.name)<<std::right<<std::setw(7)<<res.size;
+        if (res.status==BenchmarkOK) {
+            os<<std::setw(9)<<res.threads<<std::setprecision(4)
+              <<std::setw(14)<<res.tMedian<<std::setw(14)<<res.tMin<<std::setw(16)<<res.throughput()<<" "<<res.unit<<"\n";
+        }
+        else {
+            os<<"  "<<res.status<<": "<<res.message<<"\n";
+        }
+    }
+}
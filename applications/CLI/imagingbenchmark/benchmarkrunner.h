@@ -0,0 +1,155 @@
+//<LICENSE>
+
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+
+#include <logging/logger.h>
+
+/// \brief Base class of a benchmark case.
+///
+/// The runner calls setup once per problem size, then prepare and run for each repetition and finally teardown.
+/// Only run is timed.
+class BenchmarkCase
+{
+public:
+    /// \param name Name of the benchmark
+    /// \param group The library or module that is measured, e.g. kipl
+    /// \param unit Name of the items counted by items(), e.g. pixel
+    /// \param threaded Set false if the code under test is single threaded, the case is then only run once per size
+    BenchmarkCase(const std::string &name, const std::string &group, const std::string &unit, bool threaded=true);
+    virtual ~BenchmarkCase();
+
+    const std::string & name() const  { return m_sName; }
+    const std::string & group() const { return m_sGroup; }
+    const std::string & unit() const  { return m_sUnit; }
+    bool threaded() const             { return m_bThreaded; }
+
+    /// \brief Creates the input data for a problem size, this is not timed.
+    /// \param size The problem size, mostly the image width
+    /// \throws An exception if the case can't be run, the case is then reported as skipped for this size.
+    virtual void setup(size_t size)=0;
+
+    /// \brief Restores the input before each timed run, this is not timed.
+    virtual void prepare() {}
+
+    /// \brief The timed operation
+    virtual void run()=0;
+
+    /// \returns the number of items processed by a single run
+    virtual double items() const=0;
+
+    /// \brief Releases the data of the current size
+    virtual void teardown() {}
+
+private:
+    std::string m_sName;
+    std::string m_sGroup;
+    std::string m_sUnit;
+    bool m_bThreaded;
+};
+
+/// \brief Outcome of a benchmark run
+enum eBenchmarkStatus {
+    BenchmarkOK,        ///< All repetitions finished
+    BenchmarkSkipped,   ///< The setup failed, e.g. a module or file format is not available
+    BenchmarkFailed     ///< A timed run threw an exception
+};
+
+std::string enum2string(eBenchmarkStatus status);
+std::ostream & operator<<(std::ostream &s, eBenchmarkStatus status);
+
+/// \brief Timing result of one case, size and thread count. The times are in seconds.
+struct BenchmarkResult
+{
+    BenchmarkResult();
+
+    /// \returns the number of items per second based on the median time
+    double throughput() const;
+
+    std::string name;
+    std::string group;
+    std::string unit;
+    size_t size;
+    size_t threads;
+    size_t repetitions;
+    double items;
+    double tMin;
+    double tMedian;
+    double tMean;
+    double tMax;
+    double tStdDev;
+    eBenchmarkStatus status;
+    std::string message;
+    bool pooled;                ///< The image buffers were allocated from the kipl buffer pool
+    size_t poolRequests;        ///< Pooled allocations during the timed runs
+    size_t systemAllocations;   ///< Pooled allocations during the timed runs that needed new memory
+};
+
+/// \brief Runs benchmark cases over sweeps of problem size and thread count.
+///
+/// The thread count is applied to the shared kipl thread pool and to OpenMP before each sweep step.
+/// The results can be written as JSON for regression tracking between releases.
+class BenchmarkRunner
+{
+    kipl::logging::Logger logger;
+public:
+    BenchmarkRunner();
+
+    /// \brief Adds a case to the suite
+    void add(std::unique_ptr<BenchmarkCase> bench);
+
+    /// \returns the names of all cases as group/name
+    std::vector<std::string> names() const;
+
+    /// \param sizes The problem sizes of the sweep
+    void setSizes(const std::vector<size_t> &sizes);
+
+    /// \param threads The thread counts of the sweep, 0 uses all cores
+    void setThreads(const std::vector<size_t> &threads);
+
+    /// \param n Number of timed runs per sweep step
+    /// \throws KiplException if n is zero
+    void setRepetitions(size_t n);
+
+    /// \param n Number of untimed runs before the timed runs
+    void setWarmup(size_t n);
+
+    /// \param filter Only cases whose group/name contains the filter string are run, an empty string runs all.
+    void setFilter(const std::string &filter);
+
+    /// \brief Runs the selected cases
+    /// \returns the results, one entry per case, size and thread count
+    const std::vector<BenchmarkResult> & run();
+
+    const std::vector<BenchmarkResult> & results() const { return m_Results; }
+
+    /// \brief Writes the settings, the system information and the results as JSON
+    void writeJSON(std::ostream &os) const;
+
+    /// \brief Writes the JSON report to a file
+    /// \throws KiplException if the file can't be opened
+    void writeJSON(const std::string &fname) const;
+
+    /// \brief Writes a readable summary of the results
+    void writeTable(std::ostream &os) const;
+
+private:
+    bool selected(const BenchmarkCase &bench) const;
+    void runCase(BenchmarkCase &bench, size_t size);
+    BenchmarkResult measure(BenchmarkCase &bench, size_t size, size_t threads);
+
+    std::vector<std::unique_ptr<BenchmarkCase>> m_Cases;
+    std::vector<BenchmarkResult> m_Results;
+    std::vector<size_t> m_Sizes;
+    std::vector<size_t> m_Threads;
+    size_t m_nRepetitions;
+    size_t m_nWarmup;
+    std::string m_sFilter;
+};
+
+#endif // BENCHMARKRUNNER_H
@@ -0,0 +1,76 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+QT -= gui
+
+TARGET = imagingbenchmark
+
+CONFIG(release, debug|release): DESTDIR = $$PWD/../../../../lib
+else:CONFIG(debug, debug|release): DESTDIR = $$PWD/../../../../lib/debug
+
+unix:!symbian {
+    maemo5 {
+        target.path = /opt/usr/lib
+    } else {
+        target.path = /usr/lib
+    }
+    INSTALLS += target
+
+    unix:macx {
+        QMAKE_CXXFLAGS += -fPIC -O2
+        INCLUDEPATH += /opt/local/include
+        INCLUDEPATH += /opt/local/include/libxml2
+        QMAKE_LIBDIR += /opt/local/lib
+    }
+    else {
+        QMAKE_CXXFLAGS += -fPIC -fopenmp -O2
+        QMAKE_LFLAGS += -lgomp
+        LIBS += -lgomp -ldl
+        INCLUDEPATH += /usr/include/libxml2
+    }
+
+    LIBS += -ltiff -lxml2
+
+    INCLUDEPATH += $$PWD/../../../external/src/linalg
+}
+
+win32 {
+    contains(QMAKE_HOST.arch, x86_64):{
+        QMAKE_LFLAGS += /MACHINE:X64
+    }
+    INCLUDEPATH += $$PWD/../../../external/src/linalg $$PWD/../../../external/include $$PWD/../../../external/include/cfitsio $$PWD/../../../../external/include/libxml2
+    QMAKE_LIBDIR += $$PWD/../../../external/lib64
+
+    LIBS += -llibxml2_dll -llibtiff -lcfitsio
+    QMAKE_CXXFLAGS += /openmp /O2
+}
+
+SOURCES += \
+    main.cpp \
+    benchmarkrunner.cpp \
+    syntheticdata.cpp \
+    kiplbenchmarks.cpp \
+    algorithmbenchmarks.cpp \
+    backprojectorbenchmarks.cpp
+
+HEADERS += \
+    benchmarkrunner.h \
+    benchmarkcases.h \
+    syntheticdata.h
+
+CONFIG(release, debug|release): LIBS += -L$$PWD/../../../../lib/
+else:CONFIG(debug, debug|release): LIBS += -L$$PWD/../../../../lib/debug/
+
+LIBS += -lkipl -lModuleConfig -lReconFramework -lImagingAlgorithms
+
+INCLUDEPATH += $$PWD/../../../core/kipl/kipl/include
+DEPENDPATH += $$PWD/../../../core/kipl/kipl/include
+
+INCLUDEPATH += $$PWD/../../../core/modules/ModuleConfig/include
+DEPENDPATH += $$PWD/../../../core/modules/ModuleConfig/include
+
+INCLUDEPATH += $$PWD/../../../core/algorithms/ImagingAlgorithms/include
+DEPENDPATH += $$PWD/../../../core/algorithms/ImagingAlgorithms/include
+
+INCLUDEPATH += $$PWD/../../../frameworks/tomography/Framework/ReconFramework/include
+DEPENDPATH += $$PWD/../../../frameworks/tomography/Framework/ReconFramework/src
@@ -0,0 +1,172 @@
+//<LICENSE>
+
+#include "benchmarkcases.h"
+#include "syntheticdata.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <sstream>
+
+#include <base/timage.h>
+#include <filters/medianfilter.h>
+#include <morphology/label.h>
+#include <io/io_tiff.h>
+#include <io/nexusreader.h>
+#include <io/nexuswriter.h>
+#include <strings/filenames.h>
+
+namespace {
+
+/// Number of images in the stacks of the reader benchmarks
+const size_t nStackSize=16;
+
+class MedianFilterBenchmark : public BenchmarkCase
+{
+public:
+    MedianFilterBenchmark() : BenchmarkCase("MedianFilter5x5","kipl","pixel") {}
+
+    void setup(size_t size)
+    {
+        img=SyntheticData::noisyStar(size);
+    }
+
+    void run()
+    {
+        size_t dims[2]={5,5};
+        kipl::filters::TMedianFilter<float,2> filter(dims);
+        result=filter(img,kipl::filters::FilterBase::EdgeMirror);
+    }
+
+    double items() const { return static_cast<double>(img.Size()); }
+
+private:
+    kipl::base::TImage<float,2> img;
+    kipl::base::TImage<float,2> result;
+};
+
+class LabelImageBenchmark : public BenchmarkCase
+{
+public:
+    LabelImageBenchmark() : BenchmarkCase("LabelImage","kipl","pixel",false) {}
+
+    void setup(size_t size)
+    {
+        img=SyntheticData::binaryImage(size);
+    }
+
+    void run()
+    {
+        kipl::morphology::LabelImage(img,lbl,kipl::base::conn8);
+    }
+
+    double items() const { return static_cast<double>(img.Size()); }
+
+private:
+    kipl::base::TImage<float,2> img;
+    kipl::base::TImage<int,2> lbl;
+};
+
+class TIFFReadBenchmark : public BenchmarkCase
+{
+public:
+    TIFFReadBenchmark(const std::string &path) :
+        BenchmarkCase("ReadTIFFStack","kipl","pixel",false),
+        m_sMask(path+"imagingbenchmark_####.tif"),
+        m_nPixels(0)
+    {}
+
+    void setup(size_t size)
+    {
+        kipl::base::TImage<float,2> img=SyntheticData::noisyStar(size);
+        m_nPixels=nStackSize*img.Size();
+
+        for (size_t i=0; i<nStackSize; ++i)
+            kipl::io::WriteTIFF32(img,fileName(i).c_str());
+    }
+
+    void run()
+    {
+        for (size_t i=0; i<nStackSize; ++i)
+            kipl::io::ReadTIFF(img,fileName(i).c_str());
+    }
+
+    double items() const { return static_cast<double>(m_nPixels); }
+
+    void teardown()
+    {
+        for (size_t i=0; i<nStackSize; ++i)
+            std::remove(fileName(i).c_str());
+    }
+
+private:
+    std::string fileName(size_t idx) const
+    {
+        std::string fname,ext;
+        kipl::strings::filenames::MakeFileName(m_sMask,static_cast<int>(idx),fname,ext,'#','0');
+
+        return fname;
+    }
+
+    std::string m_sMask;
+    size_t m_nPixels;
+    kipl::base::TImage<float,2> img;
+};
+
+/// \brief Reads the projections of a NeXus file one by one, the case is skipped without NeXus support.
+class NexusReadBenchmark : public BenchmarkCase
+{
+public:
+    NexusReadBenchmark(const std::string &path) :
+        BenchmarkCase("ReadNeXusProjections","kipl","pixel",false),
+        m_sFileName(path+"imagingbenchmark.hdf"),
+        m_nPixels(0)
+    {}
+
+    void setup(size_t size)
+    {
+        kipl::base::TImage<float,2> img=SyntheticData::noisyStar(size);
+        size_t dims[3]={size,size,nStackSize};
+        m_nPixels=nStackSize*img.Size();
+
+        kipl::base::TImage<float,3> stack(dims);
+        for (size_t i=0; i<nStackSize; ++i)
+            std::copy_n(img.GetDataPtr(),img.Size(),stack.GetLinePtr(0,i));
+
+        kipl::io::NexusVolumeWriter writer;
+        writer.create(m_sFileName,dims,0.1f,kipl::io::NexusVolumeWriter::CompressionNone);
+        writer.write(stack,0);
+        writer.close();
+    }
+
+    void run()
+    {
+        kipl::io::NexusReader reader(m_sFileName);
+        for (size_t i=0; i<nStackSize; ++i)
+            reader.read(img,i);
+    }
+
+    double items() const { return static_cast<double>(m_nPixels); }
+
+    void teardown()
+    {
+        std::remove(m_sFileName.c_str());
+    }
+
+private:
+    std::string m_sFileName;
+    size_t m_nPixels;
+    kipl::base::TImage<float,2> img;
+};
+
+}
+
+void addKiplBenchmarks(BenchmarkRunner &runner, const std::string &workPath)
+{
+    std::string path=workPath;
+    kipl::strings::filenames::CheckPathSlashes(path,true);
+
+    runner.add(std::unique_ptr<BenchmarkCase>(new MedianFilterBenchmark));
+    runner.add(std::unique_ptr<BenchmarkCase>(new LabelImageBenchmark));
+    runner.add(std::unique_ptr<BenchmarkCase>(new TIFFReadBenchmark(path)));
+    runner.add(std::unique_ptr<BenchmarkCase>(new NexusReadBenchmark(path)));
+}
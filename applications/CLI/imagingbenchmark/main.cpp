@@ -0,0 +1,174 @@
+//<LICENSE>
+
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <string>
+
+#include <base/KiplException.h>
+#include <logging/logger.h>
+#include <base/core/bufferpool.h>
+
+#include "benchmarkrunner.h"
+#include "benchmarkcases.h"
+
+kipl::logging::Logger logger("imagingbenchmark");
+
+int process(int argc, char *argv[]);
+
+int showHelp();
+
+int parseArguments(std::vector<std::string> qargs, std::map<std::string, std::string> &pars);
+
+std::vector<size_t> parseList(const std::string &str);
+
+int main(int argc, char *argv[])
+{
+    try {
+        return process(argc,argv);
+    }
+    catch (std::exception &e) {
+        std::cerr<<"imagingbenchmark failed: "<<e.what()<<std::endl;
+    }
+
+    return 1;
+}
+
+int process(int argc, char *argv[])
+{
+    std::vector<std::string> qargs(argv,argv+argc);
+
+    std::map<std::string,std::string> args;
+    parseArguments(qargs,args);
+
+    if (args.count("help")!=0) {
+        showHelp();
+        return 0;
+    }
+
+    kipl::logging::Logger::SetLogLevel(args.count("verbose")!=0 ? kipl::logging::Logger::LogMessage : kipl::logging::Logger::LogWarning);
+
+    BenchmarkRunner runner;
+    addKiplBenchmarks(runner,args["workdir"]);
+    addAlgorithmBenchmarks(runner);
+    addBackProjectorBenchmarks(runner,args["modules"]);
+
+    if (args.count("list")!=0) {
+        for (const auto &name : runner.names())
+            std::cout<<name<<"\n";
+        return 0;
+    }
+
+    if (args.count("sizes")!=0)
+        runner.setSizes(parseList(args["sizes"]));
+
+    if (args.count("threads")!=0)
+        runner.setThreads(parseList(args["threads"]));
+
+    if (args.count("repetitions")!=0)
+        runner.setRepetitions(std::stoul(args["repetitions"]));
+
+    if (args.count("warmup")!=0)
+        runner.setWarmup(std::stoul(args["warmup"]));
+
+    runner.setFilter(args["filter"]);
+
+    kipl::base::core::BufferPool::setEnabled(args.count("pool")!=0);
+
+    runner.run();
+    runner.writeTable(std::cout);
+
+    if (kipl::base::core::BufferPool::enabled()) {
+        auto stats=kipl::base::core::BufferPool::statistics();
+        std::cout<<"Buffer pool: "<<stats.requests<<" requests, "
+                 <<stats.threadCacheHits<<" thread cache hits, "
+                 <<stats.sharedCacheHits<<" shared hits ("<<stats.remoteHits<<" remote), "
+                 <<stats.systemAllocations<<" system allocations, "
+                 <<stats.bypassed<<" not pooled, peak cache "<<stats.peakBytesCached/1048576.0<<" MB"<<std::endl;
+    }
+
+    if (args.count("outfile")!=0) {
+        runner.writeJSON(args["outfile"]);
+        std::cout<<"Wrote "<<args["outfile"]<<std::endl;
+    }
+
+    return 0;
+}
+
+int parseArguments(std::vector<std::string> qargs, std::map<std::string,std::string> &pars)
+{
+    const std::map<std::string,std::string> valueArgs={
+        {"-o","outfile"},
+        {"-sizes","sizes"},
+        {"-threads","threads"},
+        {"-rep","repetitions"},
+        {"-warmup","warmup"},
+        {"-filter","filter"},
+        {"-modules","modules"},
+        {"-workdir","workdir"}
+    };
+
+    const std::map<std::string,std::string> flagArgs={
+        {"-h","help"},
+        {"-list","list"},
+        {"-pool","pool"},
+        {"-v","verbose"}
+    };
+
+    for (auto item=qargs.begin()+1; item!=qargs.end(); ++item) {
+        if (flagArgs.count(*item)!=0) {
+            pars[flagArgs.at(*item)]="true";
+            continue;
+        }
+
+        auto arg=valueArgs.find(*item);
+        if (arg==valueArgs.end())
+            throw kipl::base::KiplException("Invalid argument "+*item,__FILE__,__LINE__);
+
+        ++item;
+        if (item==qargs.end())
+            throw kipl::base::KiplException("Too few arguments",__FILE__,__LINE__);
+
+        pars[arg->second]=*item;
+    }
+
+    return static_cast<int>(pars.size());
+}
+
+std::vector<size_t> parseList(const std::string &str)
+{
+    std::vector<size_t> list;
+    std::istringstream s(str);
+    std::string item;
+
+    while (std::getline(s,item,','))
+        list.push_back(std::stoul(item));
+
+    if (list.empty())
+        throw kipl::base::KiplException("Empty value list",__FILE__,__LINE__);
+
+    return list;
+}
+
+int showHelp()
+{
+    std::cout<<"Imaging benchmark\n";
+    std::cout<<"Measures the throughput of kipl, ImagingAlgorithms and the back-projectors on synthetic data.\n";
+    std::cout<<"Usage: imagingbenchmark [args] \n";
+    std::cout<<"Arguments:\n";
+    std::cout<<"-o <report.json> : Writes the results as JSON\n";
+    std::cout<<"-sizes <list> : Comma separated problem sizes (image width), default is 256,512,1024\n";
+    std::cout<<"-threads <list> : Comma separated thread counts, 0 uses all cores, default is 1,0\n";
+    std::cout<<"-rep <value> : Number of timed runs per size and thread count, default is 5\n";
+    std::cout<<"-warmup <value> : Number of untimed runs before the timed runs, default is 1\n";
+    std::cout<<"-filter <text> : Only runs the benchmarks whose group/name contains the text\n";
+    std::cout<<"-modules <path> : Folder of the back-projector libraries, the library search path is used by default\n";
+    std::cout<<"-workdir <path> : Folder for the temporary files of the reader benchmarks, default is the current folder\n";
+    std::cout<<"-pool : Allocates the image buffers from the kipl buffer pool\n";
+    std::cout<<"-list : Lists the benchmarks\n";
+    std::cout<<"-v : Logs each measurement\n";
+    std::cout<<"-h : Shows this help\n";
+
+    return 0;
+}
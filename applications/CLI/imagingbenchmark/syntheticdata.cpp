@@ -0,0 +1,151 @@
+//<LICENSE>
+
+#include "syntheticdata.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <generators/SiemensStar.h>
+#include <math/mathconstants.h>
+
+namespace SyntheticData {
+
+namespace {
+
+/// \brief A disc of the projection phantom, the coordinates are relative to the half image width
+struct Disc {
+    float x;
+    float y;
+    float r;
+    float mu;
+};
+
+const Disc phantom[]={
+    { 0.00f,  0.00f, 0.85f, 0.010f},
+    {-0.30f,  0.20f, 0.25f, 0.015f},
+    { 0.35f, -0.10f, 0.20f,-0.005f},
+    { 0.10f,  0.45f, 0.10f, 0.030f},
+    {-0.20f, -0.45f, 0.15f, 0.020f}
+};
+
+}
+
+kipl::base::TImage<float,2> noisyStar(size_t N, float noise)
+{
+    kipl::base::TImage<float,2> img;
+    kipl::generators::SiemensStar(N,16,img,false);
+
+    std::mt19937 generator(N);
+    std::normal_distribution<float> distribution(0.0f,noise);
+    float *pImg=img.GetDataPtr();
+    for (size_t i=0; i<img.Size(); ++i)
+        pImg[i]+=distribution(generator);
+
+    return img;
+}
+
+kipl::base::TImage<float,2> spotImage(size_t N, float spotFraction)
+{
+    kipl::base::TImage<float,2> img=noisyStar(N,0.02f);
+
+    std::mt19937 generator(N+1);
+    std::uniform_int_distribution<size_t> position(1,N-3);
+    std::uniform_real_distribution<float> amplitude(2.0f,10.0f);
+
+    const size_t nSpots=static_cast<size_t>(spotFraction*img.Size());
+    for (size_t i=0; i<nSpots; ++i) {
+        const size_t x=position(generator);
+        const size_t y=position(generator);
+        const float value=(i % 2)==0 ? amplitude(generator) : -amplitude(generator);
+        img(x,y)   = value;
+        img(x+1,y) = value;
+        if ((i % 3)==0)
+            img(x,y+1) = value;
+    }
+
+    return img;
+}
+
+kipl::base::TImage<float,2> binaryImage(size_t N)
+{
+    kipl::base::TImage<float,2> img=noisyStar(N,0.4f);
+
+    float *pImg=img.GetDataPtr();
+    for (size_t i=0; i<img.Size(); ++i)
+        pImg[i]=0.5f<pImg[i] ? 1.0f : 0.0f;
+
+    return img;
+}
+
+kipl::base::TImage<float,3> projections(size_t N, size_t nSlices, size_t nProj, std::vector<float> &angles)
+{
+    size_t dims[3]={N,nSlices,nProj};
+    kipl::base::TImage<float,3> proj(dims);
+
+    angles.resize(nProj);
+    std::vector<float> line(N);
+    const float R=0.5f*static_cast<float>(N);
+
+    for (size_t i=0; i<nProj; ++i) {
+        angles[i]=180.0f*static_cast<float>(i)/static_cast<float>(nProj);
+        const float c=std::cos(angles[i]*fPi/180.0f);
+        const float s=std::sin(angles[i]*fPi/180.0f);
+
+        std::fill(line.begin(),line.end(),0.0f);
+        for (const auto &disc : phantom) {
+            const float u0=R*(disc.x*c+disc.y*s);
+            const float r2=R*R*disc.r*disc.r;
+            for (size_t u=0; u<N; ++u) {
+                const float d=static_cast<float>(u)-R-u0;
+                if (d*d<r2)
+                    line[u]+=2.0f*disc.mu*std::sqrt(r2-d*d);
+            }
+        }
+
+        for (size_t y=0; y<nSlices; ++y)
+            std::copy(line.begin(),line.end(),proj.GetLinePtr(y,i));
+    }
+
+    return proj;
+}
+
+void transmissionImages(size_t N, size_t nProj,
+                        kipl::base::TImage<float,3> &img,
+                        kipl::base::TImage<float,2> &ob,
+                        kipl::base::TImage<float,2> &dc,
+                        std::vector<float> &dose)
+{
+    std::vector<float> angles;
+    kipl::base::TImage<float,3> proj=projections(N,N,nProj,angles);
+
+    size_t dims[2]={N,N};
+    ob.Resize(dims);
+    dc.Resize(dims);
+    img.Resize(proj.Dims());
+    dose.resize(nProj);
+
+    std::mt19937 generator(N+2);
+    std::normal_distribution<float> noise(0.0f,5.0f);
+
+    const float R=0.5f*static_cast<float>(N);
+    for (size_t y=0; y<N; ++y) {
+        for (size_t x=0; x<N; ++x) {
+            const float r2=((x-R)*(x-R)+(y-R)*(y-R))/(R*R);
+            dc(x,y) = 100.0f+noise(generator);
+            ob(x,y) = dc(x,y)+20000.0f*std::exp(-0.5f*r2);
+        }
+    }
+
+    for (size_t i=0; i<nProj; ++i) {
+        dose[i]=1.0f+0.01f*static_cast<float>(i % 7);
+        const float *pProj=proj.GetLinePtr(0,i);
+        float *pImg=img.GetLinePtr(0,i);
+        const float *pOB=ob.GetDataPtr();
+        const float *pDC=dc.GetDataPtr();
+        for (size_t j=0; j<N*N; ++j)
+            pImg[j]=pDC[j]+dose[i]*(pOB[j]-pDC[j])*std::exp(-pProj[j])+noise(generator);
+    }
+}
+
+}
@@ -0,0 +1,49 @@
+//<LICENSE>
+
+#ifndef SYNTHETICDATA_H
+#define SYNTHETICDATA_H
+
+#include <vector>
+
+#include <base/timage.h>
+
+/// \brief Generators for the benchmark input data. All generators use fixed seeds, the data is the same in every run.
+namespace SyntheticData {
+
+/// \brief A Siemens star with additive Gaussian noise
+/// \param N The image is NxN pixels
+/// \param noise Standard deviation of the noise, the star has the levels 0 and 1.
+kipl::base::TImage<float,2> noisyStar(size_t N, float noise=0.1f);
+
+/// \brief A noisy star with spots of a few pixels that are much brighter or darker than the surroundings
+/// \param N The image is NxN pixels
+/// \param spotFraction The fraction of the pixels that are spots
+kipl::base::TImage<float,2> spotImage(size_t N, float spotFraction=0.002f);
+
+/// \brief A binary image with many connected components, made by thresholding a noisy star
+/// \param N The image is NxN pixels
+kipl::base::TImage<float,2> binaryImage(size_t N);
+
+/// \brief Parallel beam projections of a phantom made of discs, the line integrals are computed analytically
+/// \param N Width of the projections
+/// \param nSlices Height of the projections
+/// \param nProj Number of projections, they are evenly spread over 180 degrees.
+/// \param angles Receives the projection angles in degrees
+kipl::base::TImage<float,3> projections(size_t N, size_t nSlices, size_t nProj, std::vector<float> &angles);
+
+/// \brief Raw transmission images with open beam and dark current as input for the reference image correction
+/// \param N The images are NxN pixels
+/// \param nProj Number of transmission images
+/// \param img Receives the transmission images
+/// \param ob Receives the open beam image
+/// \param dc Receives the dark current image
+/// \param dose Receives the dose of each transmission image
+void transmissionImages(size_t N, size_t nProj,
+                        kipl::base::TImage<float,3> &img,
+                        kipl::base::TImage<float,2> &ob,
+                        kipl::base::TImage<float,2> &dc,
+                        std::vector<float> &dose);
+
+}
+
+#endif // SYNTHETICDATA_H
@@ -3,13 +3,21 @@
 #include "stdafx.h"
 #include <QCoreApplication>
 
+#include <logging/logger.h>
+
 #include "muhreccli.h"
 
 int main(int argc, char *argv[])
 {
     QCoreApplication a(argc, argv);
 
+    kipl::logging::Logger::StartAsyncLogging();
+
     MuhRecCLI reconstructor(&a);
 
-    return reconstructor.exec();
+    int res=reconstructor.exec();
+
+    kipl::logging::Logger::StopAsyncLogging();
+
+    return res;
 }
@@ -0,0 +1,18 @@
+#!/bin/bash
+if [ `uname` == 'Linux' ]; then
+    SPECSTR="-spec linux-g++"
+else
+    SPECSTR="-spec macx-clang CONFIG+=x86_64"
+fi
+
+REPOSPATH=$WORKSPACE/imagingsuite
+
+DEST=$WORKSPACE/builds
+
+mkdir -p $DEST/build-imagingbenchmark
+cd $DEST/build-imagingbenchmark
+
+$QTBINPATH/qmake -makefile -r $SPECSTR -o Makefile ../../imagingsuite/applications/CLI/imagingbenchmark/imagingbenchmark.pro
+make -f Makefile clean
+make -f Makefile mocables all
+make -f Makefile
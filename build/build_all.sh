@@ -26,4 +26,5 @@ fi
 ./build_applications_muhrec.sh
 #./build_CLI_framesplitter.sh
 #./build_CLI_muhrec.sh
+#./build_CLI_imagingbenchmark.sh
 
@@ -8,6 +8,7 @@
 #include <string>
 
 #include <base/timage.h>
+#include <math/fastmath.h>
 #include <logging/logger.h>
 #include "../include/averageimage.h"
 #if !defined(NO_QT)
@@ -96,7 +97,7 @@ public:
     void SetDoseList(float *doselist); /// set dose list for sample images in the BB dose roi, it has to be called after SetAngles for the right definition of m_nProj
 
     kipl::base::TImage<float,2>  Process(kipl::base::TImage<float,2> &img, float dose); ///< 2D process
-    void Process(kipl::base::TImage<float,3> &img, float *dose); ///< 3D process
+    void Process(kipl::base::TImage<float,3> &img, float *dose); ///< 3D process, the projections are processed in parallel and the sample backgrounds are saved on a background thread
 
     float* PrepareBlackBodyImage(kipl::base::TImage<float,2> &flat, kipl::base::TImage<float,2> &dark, kipl::base::TImage<float,2> &bb, kipl::base::TImage<float,2> &mask); /// segments normalized image (bb-dark)/(flat-dark) to create mask and then call ComputeInterpolationParameter
     float* PrepareBlackBodyImage(kipl::base::TImage<float,2> &flat, kipl::base::TImage<float,2> &dark, kipl::base::TImage<float,2> &bb, kipl::base::TImage<float,2> &mask, float &error); /// segments normalized image (bb-dark)/(flat-dark) to create mask and then call ComputeInterpolationParameter, finally computes interpolation error
@@ -112,6 +113,7 @@ public:
     void SetExternalBBimages(kipl::base::TImage<float, 2> &bb_ext, kipl::base::TImage<float, 3> &bb_sample_ext, float &dose, float *doselist); /// set the BB externally computed images and corresponding doses
     void SetExternalBBimages(kipl::base::TImage<float, 2> &bb_ext, kipl::base::TImage<float, 2> &bb_sample_ext, float &dose, float &dose_s); /// set the BB externally computed images and corresponding doses, case of single file also for the sample background
     void SetComputeMinusLog(bool value) {m_bComputeLogarithm = value;}
+    void SetLogAccuracy(kipl::math::eMathAccuracy accuracy) {m_LogAccuracy = accuracy;} ///< selects the logarithm implementation used by the -log normalization and the spline interpolation, default is exact
     void SaveBG(bool value, string path, string obname, string filemask);
     void SetInteractor(kipl::interactors::InteractionBase *interactor);
 
@@ -134,8 +136,15 @@ protected:
     float *ReplicateParameters(float *param, size_t n); /// Replicate interpolation parameter, to be used for the Average method
     float *ReplicateSplineParameters(float *param, size_t n, int nBBs); /// Replicate interpolation parameters, to be used for the Average method and Spline option
 
+    void InterpolateBlackBodyImage(const float *parameters, const size_t *roi, kipl::base::TImage<float,2> &img); /// compute interpolated image from polynomial parameters into img, img is only reallocated if the roi size changes
+    void InterpolateBlackBodyImagewithSplines(const float *parameters, const std::map<std::pair<int,int>,float> &values, const size_t *roi, kipl::base::TImage<float,2> &img); /// compute interpolated image from splines parameters into img, img is only reallocated if the roi size changes
+    const float *CurrentBackground(float &bgdose); /// returns the background of the current projection from the members used by the 2D process, nullptr without background correction
+    const float *SampleBackground(size_t idx, kipl::base::TImage<float,2> &bg, kipl::base::TImage<float,2> &dosebg, float &bgdose); /// computes the sample background of projection idx using the buffers bg and dosebg, returns the background or nullptr without background correction
+
     int ComputeLogNorm(kipl::base::TImage<float,2> &img, float dose);
     void ComputeNorm(kipl::base::TImage<float,2> &img, float dose);
+    int ComputeLogNorm(kipl::base::TImage<float,2> &img, float dose, const float *pBG, float bgdose); /// log normalization with the background pBG and its dose bgdose, pBG is nullptr without background correction
+    void ComputeNorm(kipl::base::TImage<float,2> &img, float dose, const float *pBG, float bgdose); /// normalization with the background pBG and its dose bgdose, pBG is nullptr without background correction
     int* repeat_matrix(int* source, int count, int expand); /// repeat matrix. not used.
     float computedose(kipl::base::TImage<float,2>&img); /// duplicate.. to move in timage probably or something like this
 
@@ -144,6 +153,7 @@ protected:
 	bool m_bHaveBlackBody;
     bool m_bHaveExternalBlackBody;
 	bool m_bComputeLogarithm;
+    kipl::math::eMathAccuracy m_LogAccuracy;
     bool bUseManualThresh;
     bool bSaveBG;
 
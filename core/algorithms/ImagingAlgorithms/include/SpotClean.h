@@ -8,6 +8,7 @@
 #include <string>
 #include <map>
 #include <list>
+#include <vector>
 
 
 #include <base/timage.h>
@@ -30,6 +31,42 @@ enum DetectionMethod {
     Detection_TriKernel
 };
 
+/// \brief Reusable buffers for the cleaning of one projection.
+///
+/// The spots are stored as structure of arrays. The buffers keep their capacity between projections,
+/// a thread that cleans a sequence of projections with the same workspace allocates only for the first projection.
+class IMAGINGALGORITHMSSHARED_EXPORT SpotCleanWorkspace
+{
+public:
+    /// \brief Removes all spots and prepares the pixel look-up for an image
+    /// \param N Number of pixels in the image
+    void prepare(size_t N);
+
+    /// \brief Adds a spot
+    /// \param idx Image index of the spot
+    /// \param val Original pixel value
+    /// \param w Weight of the correction
+    void push_back(int idx, float val, float w)
+    {
+        spotIndex[idx]=static_cast<int>(pos.size());
+        pos.push_back(idx);
+        value.push_back(val);
+        weight.push_back(w);
+    }
+
+    /// \returns the number of spots
+    size_t size() const { return pos.size(); }
+
+    std::vector<int>   pos;             ///< Image index of the spots
+    std::vector<float> value;           ///< Pixel value of the spots, contains the corrected value after cleaning
+    std::vector<float> weight;          ///< Correction weight of the spots
+    std::vector<unsigned char> state;   ///< Processing state of the spots
+    std::vector<int>   frontier;        ///< Spots that are processed in the current iteration
+    std::vector<int>   nextFrontier;    ///< Spots that have a neighbour corrected in the current iteration
+    std::vector<int>   corrected;       ///< Spots corrected in the current iteration
+    std::vector<int>   spotIndex;       ///< Index of the spot for each pixel or -1
+};
+
 class IMAGINGALGORITHMSSHARED_EXPORT SpotClean
 {
 protected:
@@ -61,11 +98,21 @@ public:
 protected:
 
 
-	kipl::base::TImage<float,2> DetectSpots(kipl::base::TImage<float,2> img, kipl::containers::ArrayBuffer<PixelInfo> *pixels);
+	/// \brief Marks the pixels that need correction and registers them in the workspace
+	/// \param img The image to clean
+	/// \param ws The workspace receiving the spots
+	/// \returns a copy of the image where the spots are set to mark
+	kipl::base::TImage<float,2> DetectSpots(kipl::base::TImage<float,2> img, SpotCleanWorkspace &ws);
 	void ExcludeLargeRegions(kipl::base::TImage<float,2> &img);
 
 	kipl::base::TImage<float,2> CleanByList(kipl::base::TImage<float,2> img);
-	kipl::base::TImage<float,2> CleanByArray(kipl::base::TImage<float,2> img,kipl::containers::ArrayBuffer<PixelInfo> *pixels);
+
+	/// \brief Replaces the marked spots by the weighted neighbourhood mean, from the edge of the spots inwards.
+	/// Only spots next to a pixel corrected in the previous iteration are revisited.
+	/// \param img The image with marked spots, it is corrected in place
+	/// \param ws The workspace with the spots found by DetectSpots
+	/// \throws ImagingException if some spots can't be reached from unmarked pixels
+	void CleanByFrontier(kipl::base::TImage<float,2> &img, SpotCleanWorkspace &ws);
 
 	kipl::base::TImage<float,2> BoxFilter(kipl::base::TImage<float,2> img, size_t dim);
 	kipl::base::TImage<float,2> StdDevDetection(kipl::base::TImage<float,2> img, size_t dim);
@@ -117,6 +164,7 @@ protected:
 	int last_line;
 
 	std::list<PixelInfo > processList;
+	SpotCleanWorkspace m_Workspace;     ///< Buffers for the 2D processing
 	kipl::math::SigmoidLUT mLUT;
 
 	kipl::filters::FilterBase::EdgeProcessingStyle eEdgeProcessingStyle;
@@ -11,6 +11,7 @@
 #include <fft/fftbase.h>
 #include <logging/logger.h>
 #include <wavelets/wavelets.h>
+#include <base/kiplenums.h>
 
 namespace ImagingAlgorithms {
 
@@ -21,10 +22,16 @@ enum eStripeFilterOperation {
 };
 
 /// The class implements the wavelet based stripe removal filter proposed by Muench et al, Optics Express.
+///
+/// The configuration (wavelet, decomposition levels, damping windows, and FFT plans) is set by the constructor
+/// or configure and is not changed by the processing. The process methods only use scratch buffers that are
+/// local to the call, one instance can therefore be shared by several threads. The vertical details are
+/// filtered in batches of columns, i.e. one FFT call transforms NBatch columns at once.
 class IMAGINGALGORITHMSSHARED_EXPORT StripeFilter {
 private:
-    kipl::logging::Logger logger; ///< Logger instance for message reporting
+    mutable kipl::logging::Logger logger; ///< Logger instance for message reporting
     static const size_t NLevels = 16;
+    static const size_t NBatch  = 16;    ///< Number of columns transformed by one FFT call
 public:
     /// \brief The constructor initializes the filter
     /// \note The filter is initialized for one image size only.
@@ -42,63 +49,102 @@ public:
     /// \param sigma High pass cut-off frequency
     StripeFilter(const std::vector<int> &dims, const string &wname, int scale, float sigma);
 
+    StripeFilter(const StripeFilter &) = delete;
+    StripeFilter & operator=(const StripeFilter &) = delete;
+
     virtual ~StripeFilter();
 
     std::vector<int> dims();
-    bool checkDims(const size_t *dims);
+    bool checkDims(const size_t *dims) const;
     std::string waveletName();
     int decompositionLevels();
     float sigma();
     std::vector<float> filterWindow(int level);
     
+    /// \brief Changes the configuration of the filter.
+    /// \note The filter must not be used by other threads while it is configured.
     void configure(const std::vector<int> &dims, const std::string &wname, int scale, float sigma);
 
 
     /// \brief Applies the stripe filter to an image.
     /// \param img the image to process. The result will be stored into the same image
     /// \param op Selects filter operation
-    void process(kipl::base::TImage<float,2> &img, eStripeFilterOperation op=VerticalComponentFFT);
+    /// \note The method can be called concurrently from several threads.
+    void process(kipl::base::TImage<float,2> &img, eStripeFilterOperation op=VerticalComponentFFT) const;
+
+    /// \brief Applies the stripe filter to all slices of a volume in parallel.
+    /// \param img the volume to process. The result will be stored into the same volume
+    /// \param op Selects filter operation
+    /// \param plane Selects the slices to filter, the default is the sinograms of a projection stack.
+    /// \throws ImagingException if the slices don't have the configured size.
+    void process(kipl::base::TImage<float,3> &img,
+                 eStripeFilterOperation op=VerticalComponentFFT,
+                 kipl::base::eImagePlanes plane=kipl::base::ImagePlaneXZ) const;
+
+    /// \brief Applies the stripe filter to a range of slices of a volume.
+    /// This is the work unit of the parallel volume processing, it lets a caller run the slices with its own progress and abort handling.
+    /// \param img the volume to process. The result will be stored into the same volume
+    /// \param op Selects filter operation
+    /// \param plane Selects the slices to filter
+    /// \param first The first slice to filter
+    /// \param last One past the last slice to filter
+    /// \throws ImagingException if the slices don't have the configured size.
+    /// \note The method can be called concurrently for disjoint slice ranges.
+    void process(kipl::base::TImage<float,3> &img,
+                 eStripeFilterOperation op,
+                 kipl::base::eImagePlanes plane,
+                 size_t first, size_t last) const;
+
+    /// \returns the number of slices of a volume in the selected plane
+    /// \param img the volume
+    /// \param plane the slice plane
+    /// \throws ImagingException for planes that are not supported by the filter.
+    static size_t sliceCount(const kipl::base::TImage<float,3> &img, kipl::base::eImagePlanes plane);
 
 private:
+    /// \brief Per call work buffers for the batched column transforms.
+    class Scratch;
+
+    /// \brief Computes the slice size and the number of slices of a volume in the selected plane.
+    /// \param img the volume
+    /// \param plane the slice plane
+    /// \param sliceDims receives the size of a slice
+    /// \returns the number of slices
+    /// \throws ImagingException for planes that are not supported by the filter.
+    static size_t sliceGeometry(const kipl::base::TImage<float,3> &img, kipl::base::eImagePlanes plane, size_t *sliceDims);
+
+    /// \brief Applies the stripe filter using the provided work buffers.
+    void process(kipl::base::TImage<float,2> &img, eStripeFilterOperation op, Scratch &scratch) const;
+
     /// \brief Builds the Fourier filter window.
 	void CreateFilterWindow();
 
+    /// \brief Creates the batched FFT plans of all decomposition levels.
+    void CreatePlans();
+
+    /// \brief Destroys the FFT plans.
+    void DestroyPlans();
+
     /// \brief Applies the Fourier filter operation to the vertical detail component
     /// \param img The vertical component to filter
     /// \param level Decomposition level of the vertical component
-    void FilterVerticalStripes(kipl::base::TImage<float,2> &img, size_t level=0);
+    /// \param scratch Work buffers of the calling thread
+    void FilterVerticalStripes(kipl::base::TImage<float,2> &img, size_t level, Scratch &scratch) const;
 
     /// \brief Set the vertial component to zero
     /// \param img The vertical component to manipulate
-	void VerticalStripesZero(kipl::base::TImage<float,2> &img);
-
-    /// \brief Copies a selected vertical line to a line buffer
-    /// \param pSrc pointer to the image data buffer
-    /// \param pLine pointer to the line buffer
-    /// \param pos index of the vertical line to copy
-    /// \param stride number of pixels between two horizontal lines
-    /// \param len length of a line
-	void GetVerticalLine(float *pSrc, float *pLine, size_t pos, size_t stride, size_t len);
-
-    /// \brief Copies a line buffer to a vertical line in the target image.
-    /// \param pLine pointer to the line buffer
-    /// \param pDest pointer to the image data buffer
-    /// \param pos index of the vertical line to copy
-    /// \param stride number of pixels between two horizontal lines
-    /// \param len length of a line
-	void SetVerticalLine(float *pLine, float *pDest, size_t pos, size_t stride, size_t len);
-
-    kipl::wavelets::WaveletTransform<float> m_wt; ///< Instance of the wavelete transform
+	void VerticalStripesZero(kipl::base::TImage<float,2> &img) const;
+
+    kipl::wavelets::WaveletTransform<float> m_wt; ///< Instance of the wavelete transform, it is copied by each call to process
     int m_nScale;                              ///< Number of decomposition levels
     float m_fSigma;                               ///< Width of the Gaussian used to implement the highpass filter
     size_t m_nFFTlength[NLevels];                      ///< Length of the fft transforms performed on the different decomposition levels
 
     float *m_pDamping[NLevels];                        ///< Filter coefficients for the filter windows
-    float *m_pLine;                               ///< Pointer to the line buffer
-    std::complex<float> *m_pCLine;                ///< Pointer to the Fourier transformed line
 
     std::vector<int> wdims;                              ///< Dimensions of the image for which the filter is configured
-    kipl::math::fft::FFTBaseFloat *fft[NLevels];       ///< FFT instances for each decomposition level.
+    fftwf_plan m_ForwardPlan[NLevels];                  ///< Batched real to complex transforms for each decomposition level
+    fftwf_plan m_InversePlan[NLevels];                  ///< Batched complex to real transforms for each decomposition level
 };
 }
 
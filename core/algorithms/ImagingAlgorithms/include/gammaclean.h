@@ -3,12 +3,13 @@
 #ifndef GAMMACLEAN_H
 #define GAMMACLEAN_H
 
+#include "ImagingAlgorithms_global.h"
 #include <base/timage.h>
 #include <filters/medianfilter.h>
 
 namespace ImagingAlgorithms {
 
-class GammaClean
+class IMAGINGALGORITHMSSHARED_EXPORT GammaClean
 {
 public:
     GammaClean();
@@ -18,7 +19,7 @@ public:
     kipl::base::TImage<float,2> DetectionImage(kipl::base::TImage<float,2> &img);
 
 private:
-    void PrepareNeighborhoods(size_t *dims);
+    void PrepareNeighborhoods(const size_t *dims);
     void MedianNeighborhood(float *pImg, float *pRes, ptrdiff_t pos, ptrdiff_t *ng, size_t N);
     float m_fSigma;
     float m_fThreshold3;
@@ -18,9 +18,20 @@ public:
         centerOfGravity
     };
 
+    /// \brief Selects the implementation of the correlation estimator
+    enum eCorrelationMethod {
+        directCorrelation, ///< Direct correlation of each row with pixel resolution, kept for regression comparisons
+        fftCorrelation     ///< FFT correlation of the rows in parallel
+    };
+
     TomoCenter();
 
     void setFraction(double f);
+
+    /// \brief Selects how the correlation estimator is computed
+    /// \param method The correlation implementation
+    /// \param subPixel Refine the correlation peak with a parabola through the peak and its neighbours, only used by fftCorrelation.
+    void setCorrelationMethod(eCorrelationMethod method, bool subPixel=true);
     void estimate(kipl::base::TImage<float,2> &img0,
                   kipl::base::TImage<float,2> &img180,
                   ImagingAlgorithms::TomoCenter::eEstimator est,
@@ -49,6 +60,9 @@ private:
     double computeR2(std::vector<double> &vec,double k, double m);
     float CorrelationCenter();
 
+    /// \brief Correlation estimate using one cached FFT plan for all rows, the rows are processed in parallel.
+    float FFTCorrelationCenter();
+
     float LeastSquareCenter();
 
     float CenterOfGravity(const kipl::base::TImage<float,2> img, size_t start, size_t end);
@@ -62,6 +76,8 @@ private:
     kipl::base::TImage<float,2> m_Proj180Deg;
     std::vector<double> m_vCoG;
     bool bSavePoints;
+    eCorrelationMethod m_eCorrelationMethod;
+    bool m_bSubPixel;
     std::string pointsFileName;
 };
 }
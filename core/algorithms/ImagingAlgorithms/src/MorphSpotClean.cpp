@@ -1,6 +1,7 @@
 //<LICENSE>
 #include <algorithm>
 #include <morphology/morphextrema.h>
+#include <morphology/morphreconstruction.h>
 #include <math/image_statistics.h>
 #include <morphology/label.h>
 #include <math/median.h>
@@ -83,23 +84,14 @@ void MorphSpotClean::FillOutliers(kipl::base::TImage<float,2> &img, kipl::base::
 
     switch (m_eMorphDetect) {
     case MorphDetectHoles :
-        noholes=kipl::morphology::FillHole(padded,m_eConnectivity);
+        noholes=kipl::morphology::FastFillHole(padded,m_eConnectivity);
         break;
     case MorphDetectPeaks :
-        nopeaks=kipl::morphology::FillPeaks(padded,m_eConnectivity);
+        nopeaks=kipl::morphology::FastFillPeaks(padded,m_eConnectivity);
         break;
 
     case MorphDetectBoth :
-        noholes=kipl::morphology::FillHole(padded,m_eConnectivity);
-
-        // Alternative
-        for (size_t i=0; i<padded.Size(); i++ )
-            padded[i]=-padded[i];
-        nopeaks=kipl::morphology::FillHole(padded,m_eConnectivity);
-        for (size_t i=0; i<padded.Size(); i++ ) {
-            padded[i]=-padded[i];
-            nopeaks[i]=-nopeaks[i];
-        }
+        kipl::morphology::FillHoleAndPeaks(padded,noholes,nopeaks,m_eConnectivity);
         break;
 
     default: throw ImagingException("Unkown detection method selected", __FILE__,__LINE__);
@@ -385,7 +377,7 @@ kipl::base::TImage<float,2> MorphSpotClean::DetectHoles(kipl::base::TImage<float
 
     float *pHoles=nullptr;
 
-    noholes=kipl::morphology::FillHole(padded,m_eConnectivity);
+    noholes=kipl::morphology::FastFillHole(padded,m_eConnectivity);
     pHoles=noholes.GetDataPtr();
 
     for (size_t i=0; i<N; i++) {
@@ -408,7 +400,7 @@ kipl::base::TImage<float,2> MorphSpotClean::DetectPeaks(kipl::base::TImage<float
 
     float *pPeaks=nullptr;
 
-    nopeaks=kipl::morphology::FillPeaks(padded,m_eConnectivity);
+    nopeaks=kipl::morphology::FastFillPeaks(padded,m_eConnectivity);
 
     pPeaks=nopeaks.GetDataPtr();
 
@@ -433,8 +425,7 @@ kipl::base::TImage<float,2> MorphSpotClean::DetectBoth(kipl::base::TImage<float,
     float *pHoles=nullptr;
     float *pPeaks=nullptr;
 
-    noholes=kipl::morphology::FillHole(padded,m_eConnectivity);
-    nopeaks=kipl::morphology::FillPeaks(padded,m_eConnectivity);
+    kipl::morphology::FillHoleAndPeaks(padded,noholes,nopeaks,m_eConnectivity);
     pHoles=noholes.GetDataPtr();
     pPeaks=nopeaks.GetDataPtr();
 
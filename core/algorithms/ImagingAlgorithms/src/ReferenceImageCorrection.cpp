@@ -6,6 +6,14 @@
 #include <list>
 #include <algorithm>
 #include <numeric>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 
 #include <tnt_array1d.h>
 #include <tnt_array2d.h>
@@ -18,12 +26,15 @@
 #include <io/io_tiff.h>
 #include <segmentation/thresholds.h>
 #include <base/thistogram.h>
+#include <base/histogramengine.h>
 #include <base/tprofile.h>
 #include <base/tsubimage.h>
 #include <strings/miscstring.h>
 #include <morphology/label.h>
 #include <morphology/repairhole.h>
 #include <morphology/morphextrema.h>
+#include <utilities/threadpool.h>
+#include <math/fastmath.h>
 
 
 #include "../include/ReferenceImageCorrection.h"
@@ -31,6 +42,125 @@
 
 using namespace TNT;
 
+namespace {
+/// Writes images to TIFF files on a background thread. The queue is bounded, write blocks when it is full.
+class BackgroundWriter
+{
+public:
+    BackgroundWriter(size_t nMaxQueued=8) :
+        m_nMaxQueued(std::max(size_t(1),nMaxQueued)),
+        m_bStop(false),
+        m_Writer(&BackgroundWriter::writerLoop,this)
+    {}
+
+    ~BackgroundWriter()
+    {
+        stop();
+    }
+
+    /// \brief Queues a copy of an image for writing
+    /// \param img The image
+    /// \param fname Name of the TIFF file
+    void write(const kipl::base::TImage<float,2> &img, const std::string &fname)
+    {
+        kipl::base::TImage<float,2> copy(img.Dims());
+        std::copy_n(img.GetDataPtr(),img.Size(),copy.GetDataPtr());
+
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_QueueChanged.wait(lock,[this]{return (m_Queue.size()<m_nMaxQueued) || m_Error;});
+        rethrowError();
+
+        m_Queue.emplace_back(fname,copy);
+        lock.unlock();
+        m_QueueChanged.notify_all();
+    }
+
+    /// \brief Writes the queued images and stops the writer thread
+    /// \throws The first exception raised while writing
+    void close()
+    {
+        stop();
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        rethrowError();
+    }
+
+private:
+    void stop()
+    {
+        if (!m_Writer.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bStop=true;
+        }
+        m_QueueChanged.notify_all();
+        m_Writer.join();
+    }
+
+    void rethrowError()
+    {
+        if (m_Error) {
+            std::exception_ptr e=m_Error;
+            m_Error=nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    void writerLoop()
+    {
+        for (;;) {
+            std::pair<std::string, kipl::base::TImage<float,2> > item;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_QueueChanged.wait(lock,[this]{return m_bStop || !m_Queue.empty();});
+                if (m_Queue.empty())
+                    return;
+
+                item=m_Queue.front();
+                m_Queue.pop_front();
+            }
+            m_QueueChanged.notify_all();
+
+            try {
+                kipl::io::WriteTIFF32(item.second,item.first.c_str());
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (!m_Error)
+                    m_Error=std::current_exception();
+            }
+        }
+    }
+
+    size_t m_nMaxQueued;
+    bool m_bStop;
+    std::exception_ptr m_Error;
+    std::deque<std::pair<std::string, kipl::base::TImage<float,2> > > m_Queue;
+    std::mutex m_Mutex;
+    std::condition_variable m_QueueChanged;
+    std::thread m_Writer;
+};
+
+/// Copies the part of img covering subroi if subroi is inside roi, img covers roi.
+bool CropROI(const kipl::base::TImage<float,2> &img, const size_t *roi, const size_t *subroi, kipl::base::TImage<float,2> &sub)
+{
+    if ((subroi[0]<roi[0]) || (subroi[1]<roi[1]) || (roi[2]<subroi[2]) || (roi[3]<subroi[3]) ||
+            (subroi[2]<subroi[0]) || (subroi[3]<subroi[1]))
+        return false;
+
+    size_t dims[2]={subroi[2]-subroi[0], subroi[3]-subroi[1]};
+    if ((sub.Size(0)!=dims[0]) || (sub.Size(1)!=dims[1]))
+        sub.Resize(dims);
+
+    for (size_t y=0; y<dims[1]; ++y)
+        std::copy_n(img.GetLinePtr(y+subroi[1]-roi[1])+(subroi[0]-roi[0]),dims[0],sub.GetLinePtr(y));
+
+    return true;
+}
+}
+
 namespace ImagingAlgorithms {
 
 ReferenceImageCorrection::ReferenceImageCorrection() :
@@ -39,6 +169,7 @@ ReferenceImageCorrection::ReferenceImageCorrection() :
     m_bHaveDarkCurrent(false),
     m_bHaveBlackBody(false),
     m_bComputeLogarithm(true),
+    m_LogAccuracy(kipl::math::ExactMath),
     m_fOpenBeamDose(1.0f),
     m_bHaveDoseROI(false),
     m_bHaveBlackBodyROI(false),
@@ -284,81 +415,136 @@ kipl::base::TImage<float,2> ReferenceImageCorrection::Process(kipl::base::TImage
 
 void ReferenceImageCorrection::Process(kipl::base::TImage<float,3> &img, float *dose)
 {
-	kipl::base::TImage<float, 2> slice(img.Dims());
+    const size_t nProj=img.Size(2);
+    const size_t nPixels=img.Size(0)*img.Size(1);
 
+    if (m_bHaveBlackBody && ((m_nROI[2]-m_nROI[0])*(m_nROI[3]-m_nROI[1])<nPixels))
+        throw ImagingException("The background roi is smaller than the projections",__FILE__,__LINE__);
 
-    for (size_t i=0; (i<img.Size(2) && (updateStatus(float(i)/img.Size(2),"BBLogNorm: Referencing iteration")==false)); i++) {
+    if (m_bHaveExternalBlackBody) {
+        if (bExtSingleFile) {
+            if (m_BB_slice_ext.Size()<nPixels)
+                throw ImagingException("The externally processed BB image is smaller than the projections",__FILE__,__LINE__);
+        }
+        else {
+            if (m_BB_sample_ext.Size(2)!=nProj)
+                throw ImagingException ("Number of externally processed BB images are not the same as Projection data",__FILE__,__LINE__);
+
+            if (m_BB_sample_ext.Size(0)*m_BB_sample_ext.Size(1)<nPixels)
+                throw ImagingException("The externally processed BB images are smaller than the projections",__FILE__,__LINE__);
+        }
+    }
 
-        if (m_bHaveBlackBody) {
+    // The sample backgrounds are saved while the following projections are processed
+    std::unique_ptr<BackgroundWriter> writer;
+    if (m_bHaveBlackBody && bSaveBG)
+        writer.reset(new BackgroundWriter);
 
+    std::atomic<size_t> nDone(0);
+    std::atomic<bool> bAbort(updateStatus(0.0f,"BBLogNorm: Referencing iteration"));
+    std::mutex statusMutex;
 
-            float *current_param;
+    // Each block of projections reuses its own background buffers
+    kipl::utilities::ThreadPool::global().parallel_for(0,nProj,
+        [&](size_t first, size_t last) {
+            kipl::base::TImage<float,2> slice(img.Dims());
+            kipl::base::TImage<float,2> bg;
+            kipl::base::TImage<float,2> dosebg;
 
-            switch (m_InterpMethod) {
-            case Polynomial:{
-                current_param =new float[6];
-                memcpy(current_param, sample_bb_interp_parameters+i*6, sizeof(float)*6);
-                m_BB_sample_Interpolated = InterpolateBlackBodyImage(current_param ,m_nROI);
-                m_DoseBBsample_image = InterpolateBlackBodyImage(current_param, m_nDoseROI);
-                delete[] current_param;
-                break;
-            }
-            case ThinPlateSplines:{
-                current_param =new float[spline_sample_values.size()+3];
+            for (size_t i=first; (i<last) && !bAbort; ++i) {
+                float bgdose=0.0f;
+                const float *pBG=SampleBackground(i,bg,dosebg,bgdose);
 
-                memcpy(current_param, sample_bb_interp_parameters+i*(spline_sample_values.size()+3), sizeof(float)*(spline_sample_values.size()+3));
+                if (writer) {
+                    std::string filename, ext;
+                    kipl::strings::filenames::MakeFileName(filemask_BG,static_cast<int>(i),filename,ext,'#','0');
+                    std::string fname=pathBG+"/"+filename;
+                    kipl::strings::filenames::CheckPathSlashes(fname,false);
+                    writer->write(bg,fname);
+                }
 
-                m_BB_sample_Interpolated = InterpolateBlackBodyImagewithSplines(current_param, spline_sample_values, m_nROI);
-                m_DoseBBsample_image = InterpolateBlackBodyImagewithSplines(current_param, spline_sample_values, m_nDoseROI);
-                    delete[] current_param;
-                break;
-            }
-            default: throw ImagingException("Unknown m_InterpMethod in ReferenceImageCorrection::SetReferenceImages", __FILE__, __LINE__);
+                std::copy_n(img.GetLinePtr(0,i),slice.Size(),slice.GetDataPtr());
+                if (m_bComputeLogarithm)
+                    ComputeLogNorm(slice,dose[i],pBG,bgdose);
+                else
+                    ComputeNorm(slice,dose[i],pBG,bgdose);
+                std::copy_n(slice.GetDataPtr(),slice.Size(),img.GetLinePtr(0,i));
+
+                std::lock_guard<std::mutex> lock(statusMutex);
+                if (updateStatus(static_cast<float>(++nDone)/nProj,"BBLogNorm: Referencing iteration"))
+                    bAbort=true;
             }
+        });
 
-            // here to save the BG
+    if (writer)
+        writer->close();
+}
 
-            if (bSaveBG){
-                std::string filename, ext;
-                kipl::strings::filenames::MakeFileName(filemask_BG,static_cast<int>(i),filename,ext,'#','0');
-                std::string fname=pathBG+"/"+filename;
-                kipl::strings::filenames::CheckPathSlashes(fname,false);
-                kipl::io::WriteTIFF32(m_BB_sample_Interpolated,fname.c_str()); // seem correct
+const float * ReferenceImageCorrection::SampleBackground(size_t idx, kipl::base::TImage<float,2> &bg, kipl::base::TImage<float,2> &dosebg, float &bgdose)
+{
+    bgdose=0.0f;
 
-            }
+    if (m_bHaveBlackBody) {
+        // The background dose is only used by the PB variant with open beam
+        const bool bNeedDose=bPBvariante && m_bHaveOpenBeam;
 
+        switch (m_InterpMethod) {
+        case Polynomial: {
+            const float *param=sample_bb_interp_parameters+idx*6;
 
+            InterpolateBlackBodyImage(param,m_nROI,bg);
+            if (bNeedDose && !CropROI(bg,m_nROI,m_nDoseROI,dosebg))
+                InterpolateBlackBodyImage(param,m_nDoseROI,dosebg);
+            break;
         }
+        case ThinPlateSplines: {
+            const float *param=sample_bb_interp_parameters+idx*(spline_sample_values.size()+3);
 
-        if (m_bHaveExternalBlackBody){
+            InterpolateBlackBodyImagewithSplines(param,spline_sample_values,m_nROI,bg);
+            if (bNeedDose && !CropROI(bg,m_nROI,m_nDoseROI,dosebg))
+                InterpolateBlackBodyImagewithSplines(param,spline_sample_values,m_nDoseROI,dosebg);
+            break;
+        }
+        default: throw ImagingException("Unknown m_InterpMethod in ReferenceImageCorrection::SampleBackground", __FILE__, __LINE__);
+        }
 
-            m_BB_slice_ext.Resize(m_OB_BB_ext.Dims());
+        if (bNeedDose)
+            bgdose=computedose(dosebg);
 
-            if (bExtSingleFile)
-            {
+        return bg.GetDataPtr();
+    }
 
-//                memcpy(m_BB_slice_ext.GetDataPtr(),m_BB_sample_ext.GetDataPtr(), sizeof(float)*m_BB_sample_ext.Size(0)*m_BB_sample_ext.Size(1));
-                fdose_ext_slice = fdoseS_ext;
-            }
-            else {
+    if (m_bHaveExternalBlackBody) {
+        if (bExtSingleFile) {
+            bgdose=fdoseS_ext;
+            return m_BB_slice_ext.GetDataPtr();
+        }
 
-                if (m_BB_sample_ext.Size(2)!=img.Size(2)){
-                    throw ImagingException ("Number of externally processed BB images are not the same as Projection data",__FILE__,__LINE__);
-                }
-                memcpy(m_BB_slice_ext.GetDataPtr(),m_BB_sample_ext.GetLinePtr(0,i), sizeof(float)*m_BB_sample_ext.Size(0)*m_BB_sample_ext.Size(1));
-                fdose_ext_slice = fdose_ext_list[i];
+        bgdose=fdose_ext_list[idx];
+        return m_BB_sample_ext.GetLinePtr(0,idx);
+    }
 
-            }
+    return nullptr;
+}
 
-        }
+const float * ReferenceImageCorrection::CurrentBackground(float &bgdose)
+{
+    bgdose=0.0f;
 
+    if (m_bHaveBlackBody) {
+        if (bPBvariante && m_bHaveOpenBeam)
+            bgdose=computedose(m_DoseBBsample_image);
 
-        memcpy(slice.GetDataPtr(),img.GetLinePtr(0,i), sizeof(float)*slice.Size());
-        Process(slice,dose[i]);
-        memcpy(img.GetLinePtr(0,i), slice.GetDataPtr(), sizeof(float)*slice.Size()); // and copy the result back
-	}
+        return m_BB_sample_Interpolated.GetDataPtr();
+    }
+
+    if (m_bHaveExternalBlackBody) {
+        bgdose=bExtSingleFile ? fdoseS_ext : fdose_ext_slice;
 
+        return m_BB_slice_ext.GetDataPtr();
+    }
 
+    return nullptr;
 }
 
 void ReferenceImageCorrection::SegmentBlackBody(kipl::base::TImage<float, 2> &img, kipl::base::TImage<float, 2> &mask){
@@ -371,8 +557,9 @@ void ReferenceImageCorrection::SegmentBlackBody(kipl::base::TImage<float, 2> &im
     memcpy(norm.GetDataPtr(), img.GetDataPtr(), sizeof(float)*img.Size()); // copy to norm.. evalute if necessary
 
     std::vector<pair<float, size_t>> histo;
-    float min = *std::min_element(norm.GetLinePtr(0), norm.GetLinePtr(0)+norm.Size());
-    float max = *std::max_element(norm.GetLinePtr(0), norm.GetLinePtr(0)+norm.Size());
+    kipl::math::Statistics normStats = kipl::base::HistogramEngine<float>::statistics(norm.GetDataPtr(),norm.Size());
+    float min = static_cast<float>(normStats.Min());
+    float max = static_cast<float>(normStats.Max());
     kipl::base::THistogram<float> myhist(256, min, max);
     histo =  myhist(norm);
 
@@ -934,8 +1121,9 @@ void ReferenceImageCorrection::SegmentBlackBody(kipl::base::TImage<float,2> &nor
     memcpy(norm.GetDataPtr(), normimg.GetDataPtr(), sizeof(float)*img.Size()); // copy to norm.. evalute if necessary
 
     std::vector<pair<float, size_t>> histo;
-    float min = *std::min_element(norm.GetLinePtr(0), norm.GetLinePtr(0)+norm.Size());
-    float max = *std::max_element(norm.GetLinePtr(0), norm.GetLinePtr(0)+norm.Size());
+    kipl::math::Statistics normStats = kipl::base::HistogramEngine<float>::statistics(norm.GetDataPtr(),norm.Size());
+    float min = static_cast<float>(normStats.Min());
+    float max = static_cast<float>(normStats.Max());
     kipl::base::THistogram<float> myhist(256, min, max);
     histo =  myhist(norm);
 
@@ -1647,66 +1835,94 @@ float * ReferenceImageCorrection::SolveThinPlateSplines(std::map<std::pair<int,i
 
 kipl::base::TImage<float,2> ReferenceImageCorrection::InterpolateBlackBodyImagewithSplines(float *parameters, std::map<std::pair<int, int>, float> &values, size_t *roi){
 
+    kipl::base::TImage<float,2> interpolated_img;
+    InterpolateBlackBodyImagewithSplines(parameters,values,roi,interpolated_img);
 
+    return interpolated_img;
+}
 
-    size_t dimx = roi[2]-roi[0];
-    size_t dimy = roi[3]-roi[1];
-
+void ReferenceImageCorrection::InterpolateBlackBodyImagewithSplines(const float *parameters, const std::map<std::pair<int, int>, float> &values, const size_t *roi, kipl::base::TImage<float,2> &img)
+{
+    const size_t dimx = roi[2]-roi[0];
+    const size_t dimy = roi[3]-roi[1];
+    const size_t nValues = values.size();
 
     size_t dims[2] = {dimx,dimy};
-    kipl::base::TImage <float,2> interpolated_img(dims);
-    interpolated_img = 0.0f;
-
-    float sumdist;
-    std::map<std::pair<int,int>, float>::const_iterator it_i;
-
-    for (size_t x=0; x<dimx; ++x) {
-        for (size_t y=0; y<dimy; ++y){
-             it_i = values.begin();
-
-                sumdist = 0.0;
-                float *dist = new float[values.size()];
-
-            for (size_t ind=0; ind<values.size(); ++ind) {
-                dist[ind] = ((it_i->first.first-(x+roi[0]))*(it_i->first.first-(x+roi[0]))+(it_i->first.second-(y+roi[1]))*(it_i->first.second-(y+roi[1])));
-                if (dist[ind]!=0){
-                    sumdist += (0.5*dist[ind]*log(dist[ind])*parameters[ind]); // correct?                }
-                }
-
-                ++it_i;
+    if ((img.Size(0)!=dimx) || (img.Size(1)!=dimy))
+        img.Resize(dims);
+
+    // Centre positions relative to the roi
+    std::vector<float> cx(nValues);
+    std::vector<float> cy(nValues);
+    size_t ind=0;
+    for (auto it=values.begin(); it!=values.end(); ++it, ++ind) {
+        cx[ind]=static_cast<float>(it->first.first)-static_cast<float>(roi[0]);
+        cy[ind]=static_cast<float>(it->first.second)-static_cast<float>(roi[1]);
+    }
+
+    std::vector<float> xpos(dimx);
+    for (size_t x=0; x<dimx; ++x)
+        xpos[x]=static_cast<float>(x);
+
+    const float *pX=xpos.data();
+    std::vector<float> distLine(dimx);
+    std::vector<float> logLine(dimx);
+
+    // One line at a time with the centres in the outer loop, the inner loop runs along the line
+    for (size_t y=0; y<dimy; ++y) {
+        float *pLine=img.GetLinePtr(y);
+        std::fill_n(pLine,dimx,0.0f);
+
+        for (ind=0; ind<nValues; ++ind) {
+            const float dy     = cy[ind]-static_cast<float>(y);
+            const float dy2    = dy*dy;
+            const float weight = 0.5f*parameters[ind];
+            const float x0     = cx[ind];
+
+            for (size_t x=0; x<dimx; ++x) {
+                const float dx = x0-pX[x];
+                distLine[x]    = dx*dx+dy2;
             }
 
-                delete [] dist;
+            // r^2 log(r^2) vanishes at the centre, log(max(r^2,1)) avoids 0*log(0)
+            kipl::math::logArray(distLine.data(),logLine.data(),dimx,m_LogAccuracy,1.0f);
 
-            interpolated_img(x,y) = sumdist+parameters[values.size()]+parameters[values.size()+1]*(y+roi[1])+parameters[values.size()+2]*(x+roi[0]);
+            for (size_t x=0; x<dimx; ++x)
+                pLine[x] += weight*distLine[x]*logLine[x];
         }
-    }
-
-    return interpolated_img;
-
-
-
 
+        const float fy = static_cast<float>(y+roi[1]);
+        for (size_t x=0; x<dimx; ++x)
+            pLine[x] = pLine[x]+parameters[nValues]+parameters[nValues+1]*fy+parameters[nValues+2]*static_cast<float>(x+roi[0]);
+    }
 }
 
 kipl::base::TImage<float,2> ReferenceImageCorrection::InterpolateBlackBodyImage(float *parameters, size_t *roi) {
 
+    kipl::base::TImage<float,2> interpolated_img;
+    InterpolateBlackBodyImage(parameters,roi,interpolated_img);
 
-    size_t dimx = roi[2]-roi[0];
-    size_t dimy = roi[3]-roi[1];
+    return interpolated_img;
+}
+
+void ReferenceImageCorrection::InterpolateBlackBodyImage(const float *parameters, const size_t *roi, kipl::base::TImage<float,2> &img)
+{
+    const size_t dimx = roi[2]-roi[0];
+    const size_t dimy = roi[3]-roi[1];
 
     size_t dims[2] = {dimx,dimy};
-    kipl::base::TImage <float,2> interpolated_img(dims);
-    interpolated_img = 0.0f;
+    if ((img.Size(0)!=dimx) || (img.Size(1)!=dimy))
+        img.Resize(dims);
+
+    for (size_t y=0; y<dimy; y++) {
+        const float fy = static_cast<float>(y+roi[1]);
+        float *pLine = img.GetLinePtr(y);
 
-    for (size_t x=0; x<dimx; x++) {
-        for (size_t y=0; y<dimy; y++){
-            interpolated_img(x,y) = parameters[0] + parameters[1]*static_cast<float>(x+roi[0])+parameters[2]*static_cast<float>(x+roi[0])*static_cast<float>(x+roi[0])+parameters[3]*static_cast<float>(x+roi[0])*static_cast<float>(y+roi[1])+parameters[4]*static_cast<float>(y+roi[1])+parameters[5]*static_cast<float>(y+roi[1])*static_cast<float>(y+roi[1]);
+        for (size_t x=0; x<dimx; x++) {
+            const float fx = static_cast<float>(x+roi[0]);
+            pLine[x] = parameters[0] + parameters[1]*fx+parameters[2]*fx*fx+parameters[3]*fx*fy+parameters[4]*fy+parameters[5]*fy*fy;
         }
     }
-
-    return interpolated_img;
-
 }
 
 float ReferenceImageCorrection::ComputeInterpolationError(kipl::base::TImage<float,2>&interpolated_img, kipl::base::TImage<float,2>&mask, kipl::base::TImage<float,2>&img) {
@@ -2521,350 +2737,118 @@ void ReferenceImageCorrection::PrepareReferencesExtBB(){
 
 }
 
-int ReferenceImageCorrection:: ComputeLogNorm(kipl::base::TImage<float,2> &img, float dose)
+int ReferenceImageCorrection::ComputeLogNorm(kipl::base::TImage<float,2> &img, float dose)
 {
-    std::ostringstream msg;
-    float Pdose = 0.0f;
-
-    float defaultdose=-log(1.0f/(m_fOpenBeamDose-m_fDarkDose));
-    const float transmissionTreshold=0.005f;
-//    float defaultdose= 0.0f;
+    float bgdose=0.0f;
+    const float *pBG=CurrentBackground(bgdose);
 
+    return ComputeLogNorm(img,dose,pBG,bgdose);
+}
 
-//    float logdose = log(dose<1 ? 1.0f : dose);
+int ReferenceImageCorrection::ComputeLogNorm(kipl::base::TImage<float,2> &img, float dose, const float *pBG, float bgdose)
+{
+    if (!m_bHaveDarkCurrent)
+        return 1;
 
+    std::ostringstream msg;
 
-    int N=static_cast<int>(img.Size(0)*img.Size(1));
+    const float defaultdose=-log(1.0f/(m_fOpenBeamDose-m_fDarkDose));
+    const float transmissionTreshold=0.005f;
+    const float logdose = pBG!=nullptr ? log((dose-bgdose)<1 ? 1.0f : (dose-bgdose)) : log(dose<=0 ? 1.0f : dose);
 
-    float *pFlat=m_OpenBeam.GetDataPtr();
-    float *pDark=m_DarkCurrent.GetDataPtr();
+    const size_t nx=img.Size(0);
+    const float *pFlat=m_OpenBeam.GetDataPtr();
+    const float *pDark=m_DarkCurrent.GetDataPtr();
+    float *pImg=img.GetDataPtr();
+    const bool bFlat=m_bHaveOpenBeam;
 
     std::list<size_t> negPixelList;
+    std::mutex listMutex;
 
-    if (m_bHaveBlackBody) {
-        if (m_bHaveDarkCurrent) {
-
-
-            if (m_bHaveOpenBeam) {
-    //                #pragma omp parallel for firstprivate(pFlat,pDark)
-
-                        float *pImg=img.GetDataPtr();
-                        float *pImgBB = m_BB_sample_Interpolated.GetDataPtr();
-
-                        if(bPBvariante){
-                            Pdose = computedose(m_DoseBBsample_image);
-                        }
-
-                        #pragma omp parallel for firstprivate(pImgBB, pFlat, pDark)
-                        for (int i=0; i<N; i++) {
-
-                            float fProjPixel=(pImg[i]-pDark[i]-pImgBB[i]);
-                            if (fProjPixel<=transmissionTreshold){
-                                pImg[i] = defaultdose;
-
-                                #pragma omp critical
-                                {
-                                    negPixelList.push_back(static_cast<size_t>(i));
-                                }
-                            }
-                            else
-                                pImg[i]=pFlat[i]-log(fProjPixel)+log((dose-Pdose)<1 ? 1.0f : (dose-Pdose));
-
-                        }
-
-            }
-            else {
-    //            #pragma omp parallel for firstprivate(pDark)
-
-                  float *pImg=img.GetDataPtr();
-                  float *pImgBB = m_BB_sample_Interpolated.GetDataPtr();
+    kipl::utilities::ThreadPool::global().parallel_for(0,img.Size(1),
+        [&](size_t first, size_t last) {
+            std::list<size_t> negPixels;
+            std::vector<float> projLine(nx);
+            std::vector<float> logLine(nx);
 
+            for (size_t y=first; y<last; ++y) {
+                const size_t offset=y*nx;
+                float *pLine=pImg+offset;
+                const float *pDarkLine=pDark+offset;
 
-                    #pragma omp parallel for firstprivate(pImgBB, pDark)
-                    for (int i=0; i<N; i++) {
-
-                        float fProjPixel=(pImg[i]-pDark[i]-pImgBB[i]);// to add dose normalization in pImgBB - done
-                        if (fProjPixel<=transmissionTreshold){
-//                            pImg[i]=0;
-                            pImg[i] = defaultdose;
-                            #pragma omp critical
-                            {
-                                negPixelList.push_back(static_cast<size_t>(i));
-                            }
-                        }
-                        else
-                           pImg[i]=-log(fProjPixel)+log((dose-Pdose)<1 ? 1.0f : (dose-Pdose)); // yes but what is logdose if there is no open beam?
-                    }
-
-            }
-        }
-    }
-    else if (m_bHaveExternalBlackBody){
-        if (m_bHaveDarkCurrent) {
+                for (size_t x=0; x<nx; ++x)
+                    projLine[x]=pLine[x]-pDarkLine[x];
 
+                if (pBG!=nullptr)
+                    for (size_t x=0; x<nx; ++x)
+                        projLine[x]-=pBG[offset+x];
 
-            if (m_bHaveOpenBeam) {
-    //                #pragma omp parallel for firstprivate(pFlat,pDark)
-
-                        float *pImg=img.GetDataPtr();
-                        float *pImgBB = m_BB_slice_ext.GetDataPtr();
-
-
-
-
-                        #pragma omp parallel for firstprivate (pImgBB,pFlat,pDark)
-                        for (int i=0; i<N; i++) {
-
-                            float fProjPixel=(pImg[i]-pDark[i]-pImgBB[i]);
-                            if (fProjPixel<=transmissionTreshold){
-    //                                pImg[i]=0;
-                                pImg[i] = defaultdose;
-                                #pragma omp critical
-                                {
-                                    negPixelList.push_back(static_cast<size_t>(i));
-                                }
-                            }
-                            else
-                                pImg[i]=pFlat[i]-log(fProjPixel)+log((dose-fdose_ext_slice)<1 ? 1.0f : (dose-fdose_ext_slice));
-
-                        }
+                // The pixels below the threshold are replaced after the logarithm
+                kipl::math::logArray(projLine.data(),logLine.data(),nx,m_LogAccuracy,transmissionTreshold);
 
-            }
-            else {
-    //            #pragma omp parallel for firstprivate(pDark)
-
-                  float *pImg=img.GetDataPtr();
-                  float *pImgBB = m_BB_slice_ext.GetDataPtr();
-
-
-                    #pragma omp parallel for firstprivate(pImgBB, pDark)
-                    for (int i=0; i<N; i++) {
-
-                        float fProjPixel=(pImg[i]-pDark[i]-pImgBB[i]);
-                        if (fProjPixel<=transmissionTreshold) {
-//                            pImg[i]=0;
-                            pImg[i]= defaultdose;
-                            #pragma omp critical
-                            {
-                                negPixelList.push_back(static_cast<size_t>(i));
-                            }
-                        }
-                        else
-                           pImg[i]=-log(fProjPixel)+log((dose-fdose_ext_slice)<1 ? 1.0f : (dose-fdose_ext_slice)); // yes but what is logdose if there is no open beam?
+                for (size_t x=0; x<nx; ++x) {
+                    if (projLine[x]<=transmissionTreshold) {
+                        pLine[x]=defaultdose;
+                        negPixels.push_back(offset+x);
                     }
-
+                    else if (bFlat)
+                        pLine[x]=pFlat[offset+x]-logLine[x]+logdose;
+                    else
+                        pLine[x]=-logLine[x]+logdose;
+                }
             }
-        }
-
-
-    }
-    else {
-
-        if (m_bHaveDarkCurrent) {
-            if (m_bHaveOpenBeam) {
-
-                        float *pImg=img.GetDataPtr();
-
-                        #pragma omp parallel for firstprivate(pFlat,pDark)
-                        for (int i=0; i<N; i++) {
-
-                            float fProjPixel=(pImg[i]-pDark[i]);
-                            if (fProjPixel<=transmissionTreshold){
-//                                pImg[i]=0;
-                                pImg[i]= defaultdose;
-                                #pragma omp critical
-                                {
-                                    negPixelList.push_back(static_cast<size_t>(i));
-                                }
-                            }
-                            else
-                                pImg[i]=pFlat[i]-log(fProjPixel)+log(dose<=0 ? 1.0f : dose);
-
-                        }
 
+            if (!negPixels.empty()) {
+                std::lock_guard<std::mutex> lock(listMutex);
+                negPixelList.splice(negPixelList.end(),negPixels);
             }
-            else {
+        });
 
-                  float *pImg=img.GetDataPtr();
-
-                    #pragma omp parallel for firstprivate(pDark)
-                    for (int i=0; i<N; i++) {
-                        float fProjPixel=(pImg[i]-pDark[i]);
-                        if (fProjPixel<=transmissionTreshold){
-//                            pImg[i]=0;
-                            pImg[i]= defaultdose;
-                            #pragma omp critical
-                            {
-                                negPixelList.push_back(static_cast<size_t>(i));
-                            }
-                        }
-                        else
-                           pImg[i]=-log(fProjPixel)+log(dose<=0 ? 1.0f : dose);
-                    }
-
-            }
-        }
-    }
+    negPixelList.sort();
 
     msg<<"Correcting "<<negPixelList.size()<<" pixels with negative values using repairHoles.";
     logger.message(msg.str());
     kipl::morphology::RepairHoles(img,negPixelList,kipl::base::conn8);
 
-
     return 1;
 }
 
 void ReferenceImageCorrection::ComputeNorm(kipl::base::TImage<float,2> &img, float dose)
 {
+    float bgdose=0.0f;
+    const float *pBG=CurrentBackground(bgdose);
 
-//    dose = dose - m_fDarkDose;
-    float Pdose = 0.0f;
-
-
-//    float logdose = log(dose<1 ? 1.0f : dose);
-
-    int N=static_cast<int>(img.Size(0)*img.Size(1));
-
-    float *pFlat=m_OpenBeam.GetDataPtr();
-    float *pDark=m_DarkCurrent.GetDataPtr();
-
-
-    if (m_bHaveBlackBody) {
-        if (m_bHaveDarkCurrent) {
-
-
-            if (m_bHaveOpenBeam) {
-    //                #pragma omp parallel for firstprivate(pFlat,pDark)
-
-                        float *pImg=img.GetDataPtr();
-                        float *pImgBB = m_BB_sample_Interpolated.GetDataPtr();
-
-                        if(bPBvariante){
-                            Pdose = computedose(m_DoseBBsample_image);
-                        } // for now I assume I have all images.. other wise makes no much sense
-
-
-
-
-
-                        #pragma omp parallel for firstprivate(pImgBB, pDark, pFlat)
-                        for (int i=0; i<N; i++) {
-
-
-                            float fProjPixel=(pImg[i]-pDark[i]-pImgBB[i]);
-                            if (fProjPixel<=0)
-                                pImg[i]=0;
-                            else
-                                pImg[i] = fProjPixel/pFlat[i]/((dose-Pdose)<1 ? 1.0f : (dose-Pdose)); // pFlat is already dose corrected
-
-                        }
-
-            }
-            else {
-    //            #pragma omp parallel for firstprivate(pDark)
-
-                  float *pImg=img.GetDataPtr();
-                  float *pImgBB = m_BB_sample_Interpolated.GetDataPtr();
-
-
-                    #pragma omp parallel for firstprivate(pImgBB, pDark)
-                    for (int i=0; i<N; i++) {
-
-
-                        float fProjPixel=(pImg[i]-pDark[i]-pImgBB[i]);// to add dose normalization in pImgBB - done
-                        if (fProjPixel<=0)
-                            pImg[i]=0;
-                        else
-                            pImg[i] = fProjPixel/((dose-Pdose)<1 ? 1.0f : (dose-Pdose));
-                    }
-
-            }
-        }
-    }
-    else if (m_bHaveExternalBlackBody){
-        if (m_bHaveDarkCurrent) {
-
-
-            if (m_bHaveOpenBeam) {
-    //                #pragma omp parallel for firstprivate(pFlat,pDark)
-
-                        float *pImg=img.GetDataPtr();
-                        float *pImgBB = m_BB_slice_ext.GetDataPtr();
-
-
-
-
-                        #pragma omp parallel for firstprivate(pImgBB, pFlat, pDark)
-                        for (int i=0; i<N; i++) {
-
-
-                            float fProjPixel=(pImg[i]-pDark[i]-pImgBB[i]); // to add dose normalization in pImgBB - done
-                            if (fProjPixel<=0)
-                                pImg[i]=0;
-                            else
-                                pImg[i] = fProjPixel/pFlat[i]/((dose-fdose_ext_slice)<1 ? 1.0f : (dose-fdose_ext_slice));
-                        }
-
-            }
-            else {
-    //            #pragma omp parallel for firstprivate(pDark)
-
-                  float *pImg=img.GetDataPtr();
-                  float *pImgBB = m_BB_slice_ext.GetDataPtr();
-
-
-                    #pragma omp parallel for firstprivate(pImgBB, pDark)
-                    for (int i=0; i<N; i++) {
-
-
-                        float fProjPixel=(pImg[i]-pDark[i]-pImgBB[i]);// to add dose normalization in pImgBB - done
-                        if (fProjPixel<=0)
-                            pImg[i]=0;
-                        else
-                           pImg[i] = fProjPixel/((dose-fdose_ext_slice)<1 ? 1.0f : (dose-fdose_ext_slice));
-                    }
-
-            }
-        }
-
-
-    }
-    else {
-        if (m_bHaveDarkCurrent) {
-            if (m_bHaveOpenBeam) {
-
-
-                        float *pImg=img.GetDataPtr();
-
-                        #pragma omp parallel for firstprivate(pFlat,pDark)
-                        for (int i=0; i<N; i++) {
-
-                            float fProjPixel=(pImg[i]-pDark[i]);
-                            if (fProjPixel<=0)
-                                pImg[i]=0;
-                            else
-                              pImg[i]=fProjPixel/pFlat[i]/(dose<1 ? 1.0f : dose);
+    ComputeNorm(img,dose,pBG,bgdose);
+}
 
-                        }
+void ReferenceImageCorrection::ComputeNorm(kipl::base::TImage<float,2> &img, float dose, const float *pBG, float bgdose)
+{
+    if (!m_bHaveDarkCurrent)
+        return;
 
-            }
-            else {
-    //            #pragma omp parallel for firstprivate(pDark)
+    const float normdose = pBG!=nullptr ? ((dose-bgdose)<1 ? 1.0f : (dose-bgdose)) : (dose<1 ? 1.0f : dose);
 
-                  float *pImg=img.GetDataPtr();
+    const size_t nx=img.Size(0);
+    const float *pFlat=m_OpenBeam.GetDataPtr();
+    const float *pDark=m_DarkCurrent.GetDataPtr();
+    float *pImg=img.GetDataPtr();
+    const bool bFlat=m_bHaveOpenBeam;
 
-                    #pragma omp parallel for firstprivate(pDark)
-                    for (int i=0; i<N; i++) {
-                        float fProjPixel=(pImg[i]-pDark[i]);
-                        if (fProjPixel<=0)
-                            pImg[i]=0;
-                        else
-                           pImg[i]=fProjPixel/(dose<1 ? 1.0f : dose);
-                    }
+    kipl::utilities::ThreadPool::global().parallel_for(0,img.Size(1),
+        [&](size_t first, size_t last) {
+            for (size_t i=first*nx; i<last*nx; i++) {
+                float fProjPixel=pImg[i]-pDark[i];
+                if (pBG!=nullptr)
+                    fProjPixel-=pBG[i];
 
+                if (fProjPixel<=0)
+                    pImg[i]=0;
+                else if (bFlat)
+                    pImg[i]=fProjPixel/pFlat[i]/normdose; // pFlat is already dose corrected
+                else
+                    pImg[i]=fProjPixel/normdose;
             }
-        }
-    }
+        });
 }
 
 
@@ -4,16 +4,13 @@
 #include <iterator>
 #include <limits>
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
-
 #include <morphology/morphology.h>
 #include <morphology/morphfilters.h>
 #include <math/mathfunctions.h>
 #include <math/image_statistics.h>
 #include <morphology/label.h>
 #include <filters/medianfilter.h>
+#include <utilities/threadpool.h>
 #include "../include/ImagingException.h"
 #include "../include/SpotClean.h"
 
@@ -58,6 +55,16 @@ int SpotClean::Setup(size_t iterations,
 	return 0;
 }
 
+void SpotCleanWorkspace::prepare(size_t N)
+{
+    if (spotIndex.size()!=N)
+        spotIndex.assign(N,-1);
+
+    pos.clear();
+    value.clear();
+    weight.clear();
+}
+
 int SpotClean::Process(kipl::base::TImage<float,2> & img)
 {
 	std::ostringstream msg;
@@ -65,11 +72,8 @@ int SpotClean::Process(kipl::base::TImage<float,2> & img)
 	msg<<Version();
 	logger(kipl::logging::Logger::LogMessage,msg.str());
 
-	kipl::base::TImage<float,2> res;
-
-	kipl::containers::ArrayBuffer<PixelInfo> spots(img.Size());
-	res=DetectSpots(img,&spots);
-	img=CleanByArray(res,&spots);
+	img=DetectSpots(img,m_Workspace);
+	CleanByFrontier(img,m_Workspace);
 
 	return 0;
 }
@@ -86,22 +90,20 @@ int SpotClean::Process(kipl::base::TImage<float,3> & img)
 		msg<<"Spot clean iteration "<<j+1;
 		logger(kipl::logging::Logger::LogVerbose,msg.str());
 
-		#pragma omp parallel
+		// Each thread keeps one workspace for all its blocks and iterations, i.e. the buffers are allocated once per thread.
+		// It is safe to share it between blocks because DetectSpots and CleanByFrontier don't start nested parallel loops.
+		kipl::utilities::ThreadPool::global().parallel_for(0,img.Size(2),[&](size_t first, size_t last)
 		{
-			kipl::base::TImage<float,2> res;
-
+			static thread_local SpotCleanWorkspace ws;
 			kipl::base::TImage<float,2> proj(img.Dims());
-			kipl::containers::ArrayBuffer<PixelInfo> spots(proj.Size());
-            int nSlices=static_cast<int>(img.Size(2));
-			#pragma omp for
-            for (ptrdiff_t i=0; i<nSlices; i++) {
-				memcpy(proj.GetDataPtr(),img.GetLinePtr(0,i),sizeof(float)*proj.Size());
-				res=DetectSpots(proj,&spots);
-				proj=CleanByArray(res,&spots);
-				memcpy(img.GetLinePtr(0,i),proj.GetDataPtr(),sizeof(float)*proj.Size());
-				spots.reset();
+
+			for (size_t i=first; i<last; i++) {
+				std::copy_n(img.GetLinePtr(0,i),proj.Size(),proj.GetDataPtr());
+				kipl::base::TImage<float,2> res=DetectSpots(proj,ws);
+				CleanByFrontier(res,ws);
+				std::copy_n(res.GetDataPtr(),res.Size(),img.GetLinePtr(0,i));
 			}
-		}
+		});
 	}
 	return 0;
 }
@@ -187,42 +189,37 @@ kipl::base::TImage<float,2> SpotClean::CleanByList(kipl::base::TImage<float,2> i
 }
 
 
-kipl::base::TImage<float,2> SpotClean::DetectSpots(kipl::base::TImage<float,2> img, kipl::containers::ArrayBuffer<PixelInfo> *pixels)
+kipl::base::TImage<float,2> SpotClean::DetectSpots(kipl::base::TImage<float,2> img, SpotCleanWorkspace &ws)
 {
 	kipl::base::TImage<float,2> s=DetectionImage(img);
-//	kipl::base::TImage<float,2> s=StdDev(img,3);
 
 	kipl::base::TImage<float,2> result=img;
 	result.Clone();
 
 	mLUT.InPlace(s.GetDataPtr(),s.Size());
 
-//	float *pS=s.GetDataPtr();
-//	for (size_t i=0; i<s.Size(); i++)
-//		pS[i]=pS[i]<m_fGamma ? 0.0f : 1.0f;
-
 	ExcludeLargeRegions(s);
 	// Correction
 	float *pWeight=s.GetDataPtr();
 	float *pRes=result.GetDataPtr();
 
-	kipl::containers::ArrayBuffer<PixelInfo> processArray(img.Size());
-
-	for (size_t i=0; i<img.Size(); i++) {
+	ws.prepare(img.Size());
+	const int N=static_cast<int>(img.Size());
+	for (int i=0; i<N; i++) {
 		if ((pRes[i]<m_fMinLevel) || (m_fMaxLevel<pRes[i])) {
-			pixels->push_back(PixelInfo(i,pRes[i],1.0f));
+			ws.push_back(i,pRes[i],1.0f);
 			pRes[i]=mark;
 		}
 		else if (pWeight[i]!=0) {
-			pixels->push_back(PixelInfo(i,pRes[i],pWeight[i]));
+			ws.push_back(i,pRes[i],pWeight[i]);
 			pRes[i]=mark;
 		}
 	}
 
-	if (img.Size()<4*pixels->size()) {
+	if (img.Size()<4*ws.size()) {
 		std::ostringstream msg;
 
-		msg<<"Detected "<<static_cast<float>(pixels->size())/static_cast<float>(img.Size())<<"pixels. The result may be too smooth.";
+		msg<<"Detected "<<static_cast<float>(ws.size())/static_cast<float>(img.Size())<<"pixels. The result may be too smooth.";
 		logger(kipl::logging::Logger::LogWarning,msg.str());
 	}
 
@@ -269,70 +266,119 @@ void SpotClean::ExcludeLargeRegions(kipl::base::TImage<float,2> &img)
 
 }
 
-kipl::base::TImage<float,2> SpotClean::CleanByArray(kipl::base::TImage<float,2> img,
-													 kipl::containers::ArrayBuffer<PixelInfo> *pixels)
-{
-    PrepareNeighborhood(static_cast<int>(img.Size(0)),static_cast<int>(img.Size()));
+namespace {
+	/// \brief Sum and count of the unmarked neighbours of a pixel, uses the same neighbourhood as SpotClean::Neighborhood.
+	inline int NeighborhoodSum(const float *pImg, int idx, int N, const int *ng, int first_line, int last_line, float mark, float &sum)
+	{
+		sum=0.0f;
+		int cnt=0;
+
+		if ((first_line<idx) && (idx<last_line)) {
+			// Branch free inner loop, a marked pixel adds zero
+			for (int i=0; i<8; i++) {
+				const float val=pImg[idx+ng[i]];
+				const bool valid=(val!=mark);
+				sum+=valid ? val : 0.0f;
+				cnt+=valid;
+			}
+		}
+		else {
+			int start = first_line < idx       ? 0 : (idx!=0 ? 3: 4);
+			int stop  = idx        < last_line ? 8 : (idx+1<N ? 5 : 4);
+
+			for (int i=start; i<stop; i++) {
+				const float val=pImg[idx+ng[i]];
+				if (val!=mark) {
+					sum+=val;
+					cnt++;
+				}
+			}
+		}
 
-	kipl::containers::ArrayBuffer<PixelInfo > toProcess(img.Size()), corrected(img.Size()), remaining(img.Size());
+		return cnt;
+	}
+
+	enum eSpotState {
+		SpotPending = 0,
+		SpotQueued  = 1,
+		SpotDone    = 2
+	};
+}
+
+void SpotClean::CleanByFrontier(kipl::base::TImage<float,2> &img, SpotCleanWorkspace &ws)
+{
+	const int sx=static_cast<int>(img.Size(0));
+	const int N=static_cast<int>(img.Size());
+	const int first_line=sx;
+	const int last_line=N-sx;
+	const int ng[8]={-sx-1, -sx, -sx+1,
+	                 -1,          1,
+	                 sx-1,   sx,  sx+1};
 
-	float neigborhood[8];
-	std::ostringstream msg;
-	toProcess.copy(pixels);
 	float *pRes=img.GetDataPtr();
+	const int nSpots=static_cast<int>(ws.size());
 
-	while (!toProcess.empty())
+	ws.state.assign(nSpots,SpotQueued);
+	ws.frontier.resize(nSpots);
+	for (int k=0; k<nSpots; k++)
+		ws.frontier[k]=k;
+
+	while (!ws.frontier.empty())
 	{
-		size_t N=toProcess.size();
-		PixelInfo *pixel=toProcess.dataptr();
+		ws.corrected.clear();
 
-		for (size_t i=0; i<N; i++)
-		{
-			// Extract neighborhood values
-			int cnt=Neighborhood(pRes,pixel[i].pos,neigborhood);
+		for (const int k : ws.frontier) {
+			ws.state[k]=SpotPending;
+
+			float sum=0.0f;
+			int cnt=NeighborhoodSum(pRes,ws.pos[k],N,ng,first_line,last_line,mark,sum);
 
 			if (cnt!=0) {
 				// Compute replacement value. Here the mean is used, other replacements posible.
-				float mean=0.0f;
+				float mean=sum/cnt;
 
-				for (int j=0; j<cnt; j++)
-					mean+=neigborhood[j];
-				mean=mean/cnt;
-
-				pixel[i].value+= pixel[i].weight * (mean - pixel[i].value);
-				corrected.push_back(pixel[i]);
-			}
-			else {
-				remaining.push_back(pixel[i]);
+				ws.value[k]+= ws.weight[k] * (mean - ws.value[k]);
+				ws.corrected.push_back(k);
 			}
 		}
 
-		if (N!=(corrected.size()+remaining.size()))
-			throw ImagingException("List sizes doesn't match in correction loop",__FILE__,__LINE__);
-
 		// Insert the replacements
-		PixelInfo *correctedpixel=corrected.dataptr();
-		size_t correctedN=corrected.size();
+		for (const int k : ws.corrected) {
+			pRes[ws.pos[k]]=ws.value[k];
+			ws.state[k]=SpotDone;
+		}
 
-		for (size_t i=0; i<correctedN; i++) {
-			pRes[correctedpixel[i].pos]=correctedpixel[i].value;
+		// Only pending spots next to a corrected pixel can be corrected in the next iteration
+		ws.nextFrontier.clear();
+		for (const int k : ws.corrected) {
+			const int idx=ws.pos[k];
+			for (int i=0; i<8; i++) {
+				const int q=idx+ng[i];
+				if ((q<0) || (N<=q))
+					continue;
+
+				const int s=ws.spotIndex[q];
+				if ((s>=0) && (ws.state[s]==SpotPending)) {
+					ws.state[s]=SpotQueued;
+					ws.nextFrontier.push_back(s);
+				}
+			}
 		}
 
-		toProcess.copy(&remaining);
-		remaining.reset();
-		corrected.reset();
+		ws.frontier.swap(ws.nextFrontier);
 	}
 
 	int cnt=0;
-	for (size_t i=0; i<img.Size(); i++) {
-		if (pRes[i]==mark)
-			cnt++;
+	for (int k=0; k<nSpots; k++) {
+		cnt+=(ws.state[k]!=SpotDone);
+		ws.spotIndex[ws.pos[k]]=-1;
 	}
+
 	if (cnt!=0) {
+		std::ostringstream msg;
 		msg<<"Failed to correct "<<cnt<<" pixels";
 		throw ImagingException(msg.str(),__FILE__,__LINE__);
 	}
-	return img;
 }
 
 int SpotClean::PrepareNeighborhood(int dimx, int N)
@@ -2,28 +2,49 @@
 
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 
 #include <fft/zeropadding.h>
 #include <fft/fftbase.h>
-#include <base/trotate.h>
-#include <base/tpermuteimage.h>
-#include <io/io_tiff.h>
+#include <base/textractor.h>
+#include <utilities/threadpool.h>
 
 #include "../include/StripeFilter.h"
 #include "../include/ImagingException.h"
 
-
 namespace ImagingAlgorithms {
 
+/// The column batch is stored line by line, the columns are interleaved with stride NBatch.
+class StripeFilter::Scratch {
+public:
+    Scratch(size_t fftLength) :
+        tile(fftwf_alloc_real(2*fftLength*NBatch)),
+        spectrum(fftwf_alloc_complex((fftLength+1)*NBatch))
+    {
+        std::fill_n(tile,2*fftLength*NBatch,0.0f);
+    }
+
+    ~Scratch()
+    {
+        fftwf_free(tile);
+        fftwf_free(spectrum);
+    }
+
+    Scratch(const Scratch &) = delete;
+    Scratch & operator=(const Scratch &) = delete;
+
+    float *tile;
+    fftwf_complex *spectrum;
+};
 
 StripeFilter::StripeFilter(size_t const * const dims, const string &wname, int scale, float sigma) :
 	logger("StripeFilter"),
 	m_wt(wname),
-    m_pLine(nullptr),
-    m_pCLine(nullptr),
+    m_nScale(0),
     wdims{static_cast<int>(dims[0]), static_cast<int>(dims[1])}
 {
-    std::fill_n(fft,NLevels,nullptr);
+    std::fill_n(m_ForwardPlan,NLevels,nullptr);
+    std::fill_n(m_InversePlan,NLevels,nullptr);
     std::fill_n(m_pDamping,NLevels,nullptr);
     configure(wdims,wname,scale,sigma);
 }
@@ -37,31 +58,20 @@ StripeFilter::StripeFilter(size_t const * const dims, const string &wname, int s
 StripeFilter::StripeFilter(const std::vector<int> &dims, const std::string &wname, int scale, float sigma) :
     logger("StripeFilter"),
     m_wt(wname),
-    m_pLine(nullptr),
-    m_pCLine(nullptr)
+    m_nScale(0)
 {
-    std::fill_n(fft,NLevels,nullptr);
+    std::fill_n(m_ForwardPlan,NLevels,nullptr);
+    std::fill_n(m_InversePlan,NLevels,nullptr);
     std::fill_n(m_pDamping,NLevels,nullptr);
     configure(dims,wname,scale,sigma);
 }
 
 StripeFilter::~StripeFilter() 
 {
-    if (m_pDamping[0]!=nullptr)
-        for (int i=0; i<m_nScale; i++)
+    for (size_t i=0; i<NLevels; i++)
 			delete [] m_pDamping[i];
 
-    if (m_pLine!=nullptr)
-		delete [] m_pLine;
-
-    if (m_pCLine!=nullptr)
-		delete [] m_pCLine;
-
-    if (fft[0]!=nullptr) 
-    {
-        for (int i=0; i<m_nScale; i++)
-		    delete fft[i];
-	}
+    DestroyPlans();
 }
 
 
@@ -80,13 +90,120 @@ void StripeFilter::CreateFilterWindow()
 	}
 }
 
-void StripeFilter::process(kipl::base::TImage<float,2> &img, eStripeFilterOperation op)
+void StripeFilter::CreatePlans()
+{
+    std::lock_guard<std::mutex> lock(kipl::math::fft::plannerMutex());
+
+    for (int i=0; i<m_nScale; i++)
+    {
+        int N=static_cast<int>(2*m_nFFTlength[i]);
+        const int nBatch=static_cast<int>(NBatch);
+
+        // The plans are made on the same kind of buffers as the scratch of the process calls to get the same alignment.
+        Scratch scratch(m_nFFTlength[i]);
+
+        m_ForwardPlan[i]=fftwf_plan_many_dft_r2c(1,&N,nBatch,
+                                                 scratch.tile,nullptr,nBatch,1,
+                                                 scratch.spectrum,nullptr,nBatch,1,
+                                                 FFTW_ESTIMATE);
+
+        m_InversePlan[i]=fftwf_plan_many_dft_c2r(1,&N,nBatch,
+                                                 scratch.spectrum,nullptr,nBatch,1,
+                                                 scratch.tile,nullptr,nBatch,1,
+                                                 FFTW_ESTIMATE);
+
+        if ((m_ForwardPlan[i]==nullptr) || (m_InversePlan[i]==nullptr))
+            throw ImagingException("Failed to create the FFT plans of the stripe filter",__FILE__,__LINE__);
+    }
+}
+
+void StripeFilter::DestroyPlans()
+{
+    std::lock_guard<std::mutex> lock(kipl::math::fft::plannerMutex());
+
+    for (size_t i=0; i<NLevels; i++)
+    {
+        if (m_ForwardPlan[i]!=nullptr)
+            fftwf_destroy_plan(m_ForwardPlan[i]);
+
+        if (m_InversePlan[i]!=nullptr)
+            fftwf_destroy_plan(m_InversePlan[i]);
+
+        m_ForwardPlan[i]=nullptr;
+        m_InversePlan[i]=nullptr;
+    }
+}
+
+void StripeFilter::process(kipl::base::TImage<float,2> &img, eStripeFilterOperation op) const
+{
+    Scratch scratch(m_nFFTlength[0]);
+
+    process(img,op,scratch);
+}
+
+void StripeFilter::process(kipl::base::TImage<float,3> &img, eStripeFilterOperation op, kipl::base::eImagePlanes plane) const
+{
+    size_t sliceDims[2]={0,0};
+    const size_t nSlices=sliceGeometry(img,plane,sliceDims);
+
+    checkDims(sliceDims);
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,nSlices,
+        [&](size_t first, size_t last) {
+            process(img,op,plane,first,last);
+        },1);
+}
+
+void StripeFilter::process(kipl::base::TImage<float,3> &img, eStripeFilterOperation op, kipl::base::eImagePlanes plane, size_t first, size_t last) const
+{
+    size_t sliceDims[2]={0,0};
+    last=std::min(last,sliceGeometry(img,plane,sliceDims));
+
+    checkDims(sliceDims);
+
+    Scratch scratch(m_nFFTlength[0]);
+    kipl::base::TImage<float,2> slice;
+
+    for (size_t i=first; i<last; ++i)
+    {
+        slice=kipl::base::ExtractSlice(img,i,plane,nullptr);
+        process(slice,op,scratch);
+        kipl::base::InsertSlice(slice,img,i,plane);
+    }
+}
+
+size_t StripeFilter::sliceCount(const kipl::base::TImage<float,3> &img, kipl::base::eImagePlanes plane)
 {
-	std::ostringstream msg;
+    size_t sliceDims[2]={0,0};
+
+    return sliceGeometry(img,plane,sliceDims);
+}
+
+size_t StripeFilter::sliceGeometry(const kipl::base::TImage<float,3> &img, kipl::base::eImagePlanes plane, size_t *sliceDims)
+{
+    switch (plane) {
+    case kipl::base::ImagePlaneXY :
+        sliceDims[0]=img.Size(0); sliceDims[1]=img.Size(1);
+        return img.Size(2);
+    case kipl::base::ImagePlaneXZ :
+        sliceDims[0]=img.Size(0); sliceDims[1]=img.Size(2);
+        return img.Size(1);
+    case kipl::base::ImagePlaneYZ :
+        sliceDims[0]=img.Size(1); sliceDims[1]=img.Size(2);
+        return img.Size(0);
+    default :
+        throw ImagingException("Unsupported image plane for the stripe filter",__FILE__,__LINE__);
+    }
+}
+
+void StripeFilter::process(kipl::base::TImage<float,2> &img, eStripeFilterOperation op, Scratch &scratch) const
+{
+    // The transform keeps the coefficients, each call uses its own instance.
+    kipl::wavelets::WaveletTransform<float> wt(m_wt);
    
 	try 
     {
- 		m_wt.transform(img,m_nScale);
+        wt.transform(img,m_nScale);
  	}
 	catch (kipl::base::KiplException &e) 
     {
@@ -97,66 +214,65 @@ void StripeFilter::process(kipl::base::TImage<float,2> &img, eStripeFilterOperat
 
     size_t level=0;
 
-	for (auto &q : m_wt.data) 
+    for (auto &q : wt.data) 
     {
 		switch (op) 
         {
 		case VerticalComponentZero : VerticalStripesZero(q.v); break;
-		case VerticalComponentFFT  : FilterVerticalStripes(q.v, level); break;
+        case VerticalComponentFFT  : FilterVerticalStripes(q.v, level, scratch); break;
 		}
 
         level++;
 	}
 
-	img=m_wt.synthesize();
+    img=wt.synthesize();
  }
 
-void StripeFilter::FilterVerticalStripes(kipl::base::TImage<float,2> &img, size_t level)
+void StripeFilter::FilterVerticalStripes(kipl::base::TImage<float,2> &img, size_t level, Scratch &scratch) const
 {
-	const size_t nLines=img.Size(0);
+    const size_t nColumns = img.Size(0);
+    const size_t nRows    = img.Size(1);
+    const size_t N        = 2*m_nFFTlength[level];
+    const size_t nFreq    = N/2+1;
+
+    if (N<nRows)
+        throw ImagingException("The vertical detail is longer than the FFT of its decomposition level",__FILE__,__LINE__);
 
 	float *pData=img.GetDataPtr();
+    float *pTile=scratch.tile;
+    const float *pDamping=m_pDamping[level];
 
-	for (size_t line=0; line<nLines; line++) 
+    for (size_t column=0; column<nColumns; column+=NBatch)
     {
-        std::fill_n(m_pLine,2*m_nFFTlength[level],0.0f);
-		GetVerticalLine(pData,m_pLine,line,nLines,img.Size(1));
+        const size_t nBatch=std::min(NBatch,nColumns-column);
 
-		(*fft[level])(m_pLine,m_pCLine);
+        // Unused columns of a partial batch keep earlier values, the columns are transformed independently.
+        for (size_t y=0; y<nRows; y++)
+            std::copy_n(pData+y*nColumns+column,nBatch,pTile+y*NBatch);
 
-		for (size_t i=0; i< 2*m_nFFTlength[level]; i++) 
-        {
-			m_pCLine[i]*=m_pDamping[level][i];
-		}
+        std::fill(pTile+nRows*NBatch,pTile+N*NBatch,0.0f);
 
-		(*fft[level])(m_pCLine, m_pLine);
-		SetVerticalLine(m_pLine,pData,line,nLines,img.Size(1));
-	}
-}
+        fftwf_execute_dft_r2c(m_ForwardPlan[level],pTile,scratch.spectrum);
 
-void StripeFilter::VerticalStripesZero(kipl::base::TImage<float,2> &img)
-{
-	img=0.0f;
-}
+        float *pSpectrum=reinterpret_cast<float *>(scratch.spectrum);
+        for (size_t k=0; k<nFreq; k++)
+        {
+            const float d=pDamping[k];
+            float *pFreq=pSpectrum+2*k*NBatch;
+            for (size_t i=0; i<2*NBatch; i++)
+                pFreq[i]*=d;
+		}
 
-void StripeFilter::GetVerticalLine(float *pSrc, float *pLine, size_t pos, size_t stride, size_t len)
-{
-	float *pData=pSrc+pos;
+        fftwf_execute_dft_c2r(m_InversePlan[level],scratch.spectrum,pTile);
 
-	for (size_t i=0; i<len; i++, pData+=stride) 
-    {
-		pLine[i]=*pData;
+        for (size_t y=0; y<nRows; y++)
+            std::copy_n(pTile+y*NBatch,nBatch,pData+y*nColumns+column);
 	}
 }
 
-void StripeFilter::SetVerticalLine(float *pLine, float *pDest, size_t pos, size_t stride, size_t len)
+void StripeFilter::VerticalStripesZero(kipl::base::TImage<float,2> &img) const
 {
-	float *pData=pDest+pos;
-
-	for (size_t i=0; i<len; i++, pData+=stride) 
-    {
-		*pData=pLine[i];
-	}
+	img=0.0f;
 }
 
 std::vector<int> StripeFilter::dims()
@@ -164,7 +280,7 @@ std::vector<int> StripeFilter::dims()
     return wdims;
 }
 
-bool StripeFilter::checkDims(const size_t *dims)
+bool StripeFilter::checkDims(const size_t *dims) const
 {
     if ((static_cast<int>(dims[0])!=wdims[0]) || (static_cast<int>(dims[1])!=wdims[1]))
         throw ImagingException("Image size check failed",__FILE__,__LINE__);
@@ -200,38 +316,29 @@ void StripeFilter::configure(const std::vector<int> &dims, const string &wname,
     if (dims.size()<2)
         throw ImagingException("Stripe filter was configured with too few dimensions.",__FILE__, __LINE__);
 
+    if ((scale<1) || (static_cast<int>(NLevels)<scale))
+        throw ImagingException("The number of decomposition levels of the stripe filter is out of range.",__FILE__, __LINE__);
+
+    DestroyPlans();
+    for (size_t i=0; i<NLevels; i++)
+    {
+        delete [] m_pDamping[i];
+        m_pDamping[i]=nullptr;
+    }
+
     m_wt=kipl::wavelets::WaveletTransform<float>(wname);
     m_fSigma = sigma;
     m_nScale = scale;
     wdims=dims;
 
-    std::ostringstream msg;
     for (int i=0; i<m_nScale; i++) 
     {
         m_nFFTlength[i]=kipl::math::fft::NextPower2(static_cast<size_t>(1.25*dims[1])>>i);
-        size_t N=2*m_nFFTlength[i];
-        if ( fft[i] != nullptr ) 
-            delete fft[i];
-
-        fft[i]=new kipl::math::fft::FFTBaseFloat(&N,1);
-
-        if (m_pDamping[i]!= nullptr)
-            delete [] m_pDamping[i];
-
-        m_pDamping[i] = new float[N];
+        m_pDamping[i] = new float[2*m_nFFTlength[i]];
     }
 
-    size_t N=2*m_nFFTlength[0];
-
-    if (m_pLine != nullptr)
-        delete [] m_pLine;
-    m_pLine    = new float[N];
-
-    if (m_pCLine != nullptr)
-        delete [] m_pCLine;
-    m_pCLine   = new complex<float>[N];
-
     CreateFilterWindow();
+    CreatePlans();
 }
 
 }
@@ -35,6 +35,9 @@ void GammaClean::Configure(float sigma, float th3, float th5, float th7, size_t
 kipl::base::TImage<float,2> GammaClean::Process(kipl::base::TImage<float,2> & img)
 {
     std::stringstream msg;
+    PrepareNeighborhoods(img.Dims());
+    m_nData=static_cast<ptrdiff_t>(img.Size());
+
     kipl::base::TImage<float,2> LoG=kipl::filters::LaplacianOfGaussian(img,m_fSigma);
 
     size_t meddims[2]={m_nMedianSize,m_nMedianSize};
@@ -57,6 +60,7 @@ kipl::base::TImage<float,2> GammaClean::Process(kipl::base::TImage<float,2> & im
         pMask[i]=(m_fThreshold3<diff) + ((m_fThreshold5<diff)<<1) + ((m_fThreshold7<diff)<<2);
 
         switch (static_cast<int>(pMask[i])) {
+            case 0: break;
             case 1: m3.push_back(i); break;
             case 3: m5.push_back(i); break;
             case 7: m7.push_back(i); break;
@@ -101,7 +105,7 @@ kipl::base::TImage<float,2> GammaClean::Process(kipl::base::TImage<float,2> & im
     return res;
 }
 
-void GammaClean::PrepareNeighborhoods(size_t *dims)
+void GammaClean::PrepareNeighborhoods(const size_t *dims)
 {
     for (ptrdiff_t i=-1,idx=0; i<=1; i++)
         for (ptrdiff_t j=-1; j<=1; j++, idx++)
@@ -119,17 +123,13 @@ void GammaClean::PrepareNeighborhoods(size_t *dims)
 
 void GammaClean::MedianNeighborhood(float *pImg, float *pRes, ptrdiff_t pos, ptrdiff_t *ng, size_t N)
 {
-    size_t medN=N;
+    size_t medN=0;
     ptrdiff_t p;
     for (size_t i=0; i<N; i++) {
         p=pos+ng[i];
 
-        if ((p<0) || (m_nData<=p)) {
-            medN--;
-        }
-        else {
-            medvec[i]=pImg[p];
-        }
+        if ((0<=p) && (p<m_nData))
+            medvec[medN++]=pImg[p];
     }
 
     kipl::math::median_quick_select(medvec,medN,pRes+pos);
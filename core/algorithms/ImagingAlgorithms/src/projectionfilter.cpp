@@ -14,6 +14,7 @@
 #include <base/imagecast.h>
 #include <io/io_matlab.h>
 #include <visualization/GNUPlot.h>
+#include <profile/Tracer.h>
 
 #include <vector>
 #include <sstream>
@@ -172,6 +173,7 @@ int ProjectionFilterBase::process(kipl::base::TImage<float,2> & img)
 
 int ProjectionFilterBase::process(kipl::base::TImage<float,3> & img)
 {
+    KIPL_TRACE_SCOPE("ProjectionFilter::process","preprocessing");
     if (m_FilterType != ProjectionFilterNone)
     {
         if (img.Size()==0)
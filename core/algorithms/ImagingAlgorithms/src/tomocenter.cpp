@@ -6,6 +6,8 @@
 #include <vector>
 #include <map>
 #include <numeric>
+#include <cmath>
+#include <fstream>
 
 #if !defined(NO_QT)
 #include <QDebug>
@@ -16,6 +18,11 @@
 #include <base/KiplException.h>
 #include <math/mathconstants.h>
 #include <base/tpermuteimage.h>
+#include <fft/fftbase.h>
+#include <fft/zeropadding.h>
+#include <utilities/threadpool.h>
+
+#include "../include/ImagingException.h"
 
 namespace ImagingAlgorithms {
 TomoCenter::TomoCenter() :
@@ -26,7 +33,9 @@ TomoCenter::TomoCenter() :
     tiltK(1.0),
     mR2(0),
     bSavePoints(false),
-    pointsFileName("TomoCenterPoints.csv")
+    pointsFileName("TomoCenterPoints.csv"),
+    m_eCorrelationMethod(fftCorrelation),
+    m_bSubPixel(true)
 {
 
 }
@@ -36,6 +45,12 @@ void TomoCenter::setFraction(double f)
     fraction=f;
 }
 
+void TomoCenter::setCorrelationMethod(eCorrelationMethod method, bool subPixel)
+{
+    m_eCorrelationMethod = method;
+    m_bSubPixel          = subPixel;
+}
+
 void TomoCenter::estimate(kipl::base::TImage<float, 2> &img0,
                           kipl::base::TImage<float, 2> &img180,
                           ImagingAlgorithms::TomoCenter::eEstimator est,
@@ -57,10 +72,11 @@ void TomoCenter::estimate(kipl::base::TImage<float, 2> &img0,
             LeastSquareCenter();
             break;
         case correlation:
-            CorrelationCenter();
-            break;
         default:
-            CorrelationCenter();
+            if (m_eCorrelationMethod==fftCorrelation)
+                FFTCorrelationCenter();
+            else
+                CorrelationCenter();
             break;
     }
 
@@ -224,7 +240,8 @@ float TomoCenter::CorrelationCenter()
         size_t pos=0;
         for (size_t i=1; i<2*len; i++)
             if (corr[pos]<corr[i]) pos=i;
-        double value=0.5*((static_cast<double>(pos)-static_cast<double>(len))+(static_cast<double>(limg0.Size(0))));
+        // The mirrored row matches the template when 2*center = len - shift + N - 1
+        double value=0.5*((static_cast<double>(len)-static_cast<double>(pos))+(static_cast<double>(limg0.Size(0)))-1.0);
 
         if (bSavePoints)
             cogfile<<y<<", "<<len<<", "<<limg0.Size(0)<<", "<<pos<<", "<<value<<std::endl;
@@ -235,6 +252,130 @@ float TomoCenter::CorrelationCenter()
     return 0.0f;
 }
 
+float TomoCenter::FFTCorrelationCenter()
+{
+    std::ostringstream msg;
+    logger(kipl::logging::Logger::LogMessage,"Center estimation using FFT correlation");
+
+    msg<<"FFT corr center: Current ROI ["<<roi[0]<<", "<<roi[1]<<", "<<roi[2]<<", "<<roi[3]<<"]";
+    logger(kipl::logging::Logger::LogMessage,msg.str());
+
+    kipl::base::TImage<float,2> limg0,limg180;
+    size_t start[2]={roi[0],roi[1]};
+    size_t length[2]={roi[2]-roi[0],roi[3]-roi[1]};
+    kipl::base::TSubImage<float,2> cropper;
+    limg0=cropper.Get(m_Proj0Deg,start,length);
+    limg180 = kipl::base::Mirror(cropper.Get(m_Proj180Deg,start,length),kipl::base::ImageAxisX);
+
+    const size_t N     = limg0.Size(0);
+    const size_t len   = N/3;
+    const size_t nRows = limg0.Size(1);
+
+    if (len<2)
+        throw ImagingException("The ROI is too narrow for the correlation center estimate",__FILE__,__LINE__);
+
+    // The template (middle third of the 0 degree row) is correlated with the first 3*len pixels of the mirrored row.
+    // With at least 3*len samples the circular correlation has no wrap around for the 2*len shifts.
+    const size_t M     = kipl::math::fft::NextPower2(3*len);
+    const size_t nFreq = M/2+1;
+    const int    nFFT  = static_cast<int>(M);
+
+    fftwf_plan forward = nullptr;
+    fftwf_plan inverse = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(kipl::math::fft::plannerMutex());
+        float *pReal = fftwf_alloc_real(M);
+        fftwf_complex *pSpec = fftwf_alloc_complex(nFreq);
+
+        forward = fftwf_plan_dft_r2c_1d(nFFT,pReal,pSpec,FFTW_ESTIMATE);
+        inverse = fftwf_plan_dft_c2r_1d(nFFT,pSpec,pReal,FFTW_ESTIMATE);
+
+        fftwf_free(pReal);
+        fftwf_free(pSpec);
+    }
+
+    std::vector<double> centers(nRows,0.0);
+    std::vector<double> peaks(nRows,0.0);
+
+    try {
+        kipl::utilities::ThreadPool::global().parallel_for(0,nRows,
+            [&](size_t first, size_t last) {
+                float *pTemplate = fftwf_alloc_real(M);
+                float *pSignal   = fftwf_alloc_real(M);
+                fftwf_complex *pTemplateSpec = fftwf_alloc_complex(nFreq);
+                fftwf_complex *pSignalSpec   = fftwf_alloc_complex(nFreq);
+                const float scale = 1.0f/static_cast<float>(M);
+
+                for (size_t y=first; y<last; ++y) {
+                    std::fill_n(pTemplate,M,0.0f);
+                    std::fill_n(pSignal,M,0.0f);
+                    std::copy_n(limg0.GetLinePtr(y)+len,len,pTemplate);
+                    std::copy_n(limg180.GetLinePtr(y),3*len,pSignal);
+
+                    fftwf_execute_dft_r2c(forward,pTemplate,pTemplateSpec);
+                    fftwf_execute_dft_r2c(forward,pSignal,pSignalSpec);
+
+                    // conj(T)*S is the spectrum of the correlation
+                    for (size_t k=0; k<nFreq; ++k) {
+                        const float re = pTemplateSpec[k][0]*pSignalSpec[k][0]+pTemplateSpec[k][1]*pSignalSpec[k][1];
+                        const float im = pTemplateSpec[k][0]*pSignalSpec[k][1]-pTemplateSpec[k][1]*pSignalSpec[k][0];
+                        pSignalSpec[k][0] = re*scale;
+                        pSignalSpec[k][1] = im*scale;
+                    }
+
+                    fftwf_execute_dft_c2r(inverse,pSignalSpec,pSignal);
+
+                    size_t pos=0;
+                    for (size_t i=1; i<2*len; i++)
+                        if (pSignal[pos]<pSignal[i]) pos=i;
+
+                    double peak=static_cast<double>(pos);
+                    if (m_bSubPixel && (0<pos) && (pos<2*len-1)) {
+                        const double cm = pSignal[pos-1];
+                        const double c0 = pSignal[pos];
+                        const double cp = pSignal[pos+1];
+                        const double denom = cm-2.0*c0+cp;
+
+                        if (denom<0.0)
+                            peak += std::max(-0.5,std::min(0.5,0.5*(cm-cp)/denom));
+                    }
+
+                    // The mirrored row matches the template when 2*center = len - shift + N - 1
+                    peaks[y]   = peak;
+                    centers[y] = 0.5*(static_cast<double>(len)-peak+static_cast<double>(N)-1.0);
+                }
+
+                fftwf_free(pTemplate);
+                fftwf_free(pSignal);
+                fftwf_free(pTemplateSpec);
+                fftwf_free(pSignalSpec);
+            });
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(kipl::math::fft::plannerMutex());
+        fftwf_destroy_plan(forward);
+        fftwf_destroy_plan(inverse);
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(kipl::math::fft::plannerMutex());
+        fftwf_destroy_plan(forward);
+        fftwf_destroy_plan(inverse);
+    }
+
+    if (bSavePoints) {
+        std::ofstream cogfile(pointsFileName.c_str());
+
+        for (size_t y=0; y<nRows; ++y)
+            cogfile<<y<<", "<<len<<", "<<N<<", "<<peaks[y]<<", "<<centers[y]<<std::endl;
+    }
+
+    m_vCoG.insert(m_vCoG.end(),centers.begin(),centers.end());
+
+    return 0.0f;
+}
+
 float TomoCenter::CenterOfGravity(const kipl::base::TImage<float, 2> img,
                                   size_t start,
                                   size_t end)
@@ -10,17 +10,23 @@
 
 
 #include <base/timage.h>
+#include <base/textractor.h>
 #include <io/io_fits.h>
 #include <io/io_tiff.h>
 
 #include <MorphSpotClean.h>
+#include <SpotClean.h>
+#include <gammaclean.h>
 #include <averageimage.h>
 #include <piercingpointestimator.h>
 #include <pixelinfo.h>
 #include <PolynomialCorrection.h>
 #include <projectionfilter.h>
 #include <ImagingException.h>
+#include <ReferenceImageCorrection.h>
 #include <StripeFilter.h>
+#include <tomocenter.h>
+#include <utilities/threadpool.h>
 
 class TestImagingAlgorithms : public QObject
 {
@@ -36,6 +42,8 @@ private Q_SLOTS:
     void MorphSpotClean_CleanPeaks();
     void MorphSpotClean_CleanBoth();
     void MorphSpotClean_EdgePreparation();
+    void SpotClean_Processing();
+    void GammaClean_Processing();
 
     void AverageImage_Enums();
     void AverageImage_Processing();
@@ -50,6 +58,10 @@ private Q_SLOTS:
     void ProjectionFilterProcessing();
     void StripeFilterParameters();
     void StripeFilterProcessing2D();
+    void StripeFilterProcessing3D();
+    void TomoCenter_Correlation();
+    void ReferenceImageCorrection_Interpolation();
+    void ReferenceImageCorrection_Process3D();
 
 private:
     void MorphSpotClean_ListAlgorithm();
@@ -200,6 +212,71 @@ void TestImagingAlgorithms::MorphSpotClean_EdgePreparation()
 
 }
 
+void TestImagingAlgorithms::SpotClean_Processing()
+{
+    size_t dims[3]={64,48,5};
+    kipl::base::TImage<float,3> img(dims);
+
+    for (size_t i=0; i<img.Size(); i++)
+        img[i]=1.0f+0.01f*((i%(dims[0]*dims[1]))%7);
+
+    // Isolated spots, a cluster that is cleaned from its edge inwards and spots on the image edge
+    for (size_t k=0; k<dims[2]; k++) {
+        img.GetLinePtr(10,k)[10]=10.0f;
+        img.GetLinePtr(20,k)[30]=-1.0f;
+        for (size_t y=30; y<34; y++)
+            for (size_t x=40; x<44; x++)
+                img.GetLinePtr(y,k)[x]=20.0f;
+        img.GetLinePtr(0,k)[0]=10.0f;
+        img.GetLinePtr(dims[1]-1,k)[dims[0]-1]=10.0f;
+    }
+
+    ImagingAlgorithms::SpotClean cleaner;
+    cleaner.Setup(1,0.1f,0.025f,0.0f,5.0f,100,ImagingAlgorithms::Detection_StdDev);
+
+    kipl::base::TImage<float,2> proj(dims);
+    std::copy_n(img.GetLinePtr(0,2),proj.Size(),proj.GetDataPtr());
+
+    cleaner.Process(proj);
+    for (size_t i=0; i<proj.Size(); i++) {
+        QVERIFY(0.0f<=proj[i]);
+        QVERIFY(proj[i]<=5.0f);
+    }
+
+    // The projections of a volume are cleaned the same way as single projections
+    cleaner.Process(img);
+    for (size_t k=0; k<dims[2]; k++) {
+        float *pSlice=img.GetLinePtr(0,k);
+        for (size_t i=0; i<proj.Size(); i++)
+            QCOMPARE(pSlice[i],proj[i]);
+    }
+}
+
+void TestImagingAlgorithms::GammaClean_Processing()
+{
+    size_t dims[2]={64,48};
+    kipl::base::TImage<float,2> img(dims);
+    img=100.0f;
+
+    ImagingAlgorithms::GammaClean cleaner;
+    cleaner.Configure(0.8f,25.0f,100.0f,400.0f,3);
+
+    // An image without spots has only unmarked pixels and passes unchanged
+    kipl::base::TImage<float,2> res=cleaner.Process(img);
+    QCOMPARE(res.Size(),img.Size());
+    for (size_t i=0; i<img.Size(); i++)
+        QCOMPARE(res[i],100.0f);
+
+    // An inner spot and a spot in the corner, where part of the neighbourhood is outside the image
+    img(10,20)=10000.0f;
+    img(0,0)=10000.0f;
+
+    res=cleaner.Process(img);
+    for (size_t y=0; y<dims[1]; y++)
+        for (size_t x=0; x<dims[0]; x++)
+            QCOMPARE(res(x,y),100.0f);
+}
+
 void TestImagingAlgorithms::MorphSpotClean_ListAlgorithm()
 {
     ImagingAlgorithms::MorphSpotClean cleaner;
@@ -570,6 +647,259 @@ void TestImagingAlgorithms::StripeFilterProcessing2D()
 
 }
 
+void TestImagingAlgorithms::StripeFilterProcessing3D()
+{
+    // Projection stack with vertical stripes in the sinograms
+    size_t dims[3]={96,12,128};
+    kipl::base::TImage<float,3> img(dims);
+    for (size_t z=0; z<dims[2]; ++z)
+        for (size_t y=0; y<dims[1]; ++y) {
+            float *pLine=img.GetLinePtr(y,z);
+            for (size_t x=0; x<dims[0]; ++x)
+                pLine[x]=std::sin(0.1f*x+0.05f*z)+0.1f*y+((x % 17)==3 ? 0.5f : 0.0f);
+        }
+
+    size_t sinoDims[2]={dims[0],dims[2]};
+    ImagingAlgorithms::StripeFilter sf(sinoDims,"daub7",3,0.05f);
+
+    // Reference with the 2D filter, one sinogram at a time
+    std::vector<kipl::base::TImage<float,2>> reference(dims[1]);
+    for (size_t y=0; y<dims[1]; ++y) {
+        reference[y]=kipl::base::ExtractSlice(img,y,kipl::base::ImagePlaneXZ,nullptr);
+        sf.process(reference[y]);
+    }
+
+    // The shared instance gives the same result when it is called concurrently
+    std::vector<kipl::base::TImage<float,2>> concurrent(dims[1]);
+    kipl::utilities::ThreadPool::global().parallel_for(0,dims[1],
+        [&](size_t first, size_t last) {
+            for (size_t y=first; y<last; ++y) {
+                concurrent[y]=kipl::base::ExtractSlice(img,y,kipl::base::ImagePlaneXZ,nullptr);
+                sf.process(concurrent[y]);
+            }
+        },1);
+
+    for (size_t y=0; y<dims[1]; ++y)
+        for (size_t i=0; i<reference[y].Size(); ++i)
+            QCOMPARE(concurrent[y][i],reference[y][i]);
+
+    kipl::base::TImage<float,3> result(img.Dims());
+    std::copy_n(img.GetDataPtr(),img.Size(),result.GetDataPtr());
+    sf.process(result);
+
+    for (size_t y=0; y<dims[1]; ++y) {
+        kipl::base::TImage<float,2> sino=kipl::base::ExtractSlice(result,y,kipl::base::ImagePlaneXZ,nullptr);
+        for (size_t i=0; i<sino.Size(); ++i)
+            QCOMPARE(sino[i],reference[y][i]);
+    }
+
+    // Processing the volume in slice ranges gives the same result
+    std::copy_n(img.GetDataPtr(),img.Size(),result.GetDataPtr());
+    sf.process(result,ImagingAlgorithms::VerticalComponentFFT,kipl::base::ImagePlaneXZ,0,5);
+    sf.process(result,ImagingAlgorithms::VerticalComponentFFT,kipl::base::ImagePlaneXZ,5,dims[1]+3);
+    QCOMPARE(ImagingAlgorithms::StripeFilter::sliceCount(result,kipl::base::ImagePlaneXZ),dims[1]);
+
+    for (size_t y=0; y<dims[1]; ++y) {
+        kipl::base::TImage<float,2> sino=kipl::base::ExtractSlice(result,y,kipl::base::ImagePlaneXZ,nullptr);
+        for (size_t i=0; i<sino.Size(); ++i)
+            QCOMPARE(sino[i],reference[y][i]);
+    }
+
+    // The stripes are damped
+    float stripe=0.0f;
+    float neighbour=0.0f;
+    for (size_t z=0; z<dims[2]; ++z) {
+        stripe    += result.GetLinePtr(5,z)[20]-img.GetLinePtr(5,z)[20];
+        neighbour += result.GetLinePtr(5,z)[22]-img.GetLinePtr(5,z)[22];
+    }
+    QVERIFY(stripe/dims[2] < -0.25f);
+    QVERIFY(std::fabs(neighbour/dims[2]) < 0.1f);
+
+    size_t wrongDims[3]={dims[0],dims[1],dims[2]+2};
+    kipl::base::TImage<float,3> wrong(wrongDims);
+    QVERIFY_EXCEPTION_THROWN(sf.process(wrong),ImagingException);
+}
+
+void TestImagingAlgorithms::TomoCenter_Correlation()
+{
+    size_t dims[2]={300,16};
+    kipl::base::TImage<float,2> proj0(dims);
+    kipl::base::TImage<float,2> proj180(dims);
+
+    const double trueCenter=160.3;
+    auto profile = [](double x) {
+        return std::exp(-(x-120.0)*(x-120.0)/50.0)+0.5*std::exp(-(x-190.0)*(x-190.0)/200.0)+0.3*std::exp(-(x-60.0)*(x-60.0)/30.0);
+    };
+
+    for (size_t y=0; y<dims[1]; ++y)
+        for (size_t x=0; x<dims[0]; ++x) {
+            proj0(x,y)   = static_cast<float>(profile(static_cast<double>(x)));
+            proj180(x,y) = static_cast<float>(profile(2.0*trueCenter-x));
+        }
+
+    size_t roi[4]={0,0,dims[0],dims[1]};
+
+    double center=0.0, tilt=0.0, pivot=0.0;
+
+    ImagingAlgorithms::TomoCenter direct;
+    direct.setCorrelationMethod(ImagingAlgorithms::TomoCenter::directCorrelation);
+    direct.estimate(proj0,proj180,ImagingAlgorithms::TomoCenter::correlation,roi,false,center,tilt,pivot);
+    std::vector<double> directCenters=direct.centers();
+    const double directCenter=center;
+
+    ImagingAlgorithms::TomoCenter fftPixel;
+    fftPixel.setCorrelationMethod(ImagingAlgorithms::TomoCenter::fftCorrelation,false);
+    fftPixel.estimate(proj0,proj180,ImagingAlgorithms::TomoCenter::correlation,roi,false,center,tilt,pivot);
+    std::vector<double> fftCenters=fftPixel.centers();
+
+    // Both paths find the same correlation peak and report the same center
+    QCOMPARE(fftCenters.size(),directCenters.size());
+    for (size_t i=0; i<fftCenters.size(); ++i)
+        QCOMPARE(fftCenters[i],directCenters[i]);
+    QCOMPARE(center,directCenter);
+    QVERIFY(std::fabs(center-trueCenter)<0.5);
+
+    ImagingAlgorithms::TomoCenter fftSubPixel;
+    fftSubPixel.estimate(proj0,proj180,ImagingAlgorithms::TomoCenter::correlation,roi,false,center,tilt,pivot);
+    QVERIFY(std::fabs(center-trueCenter)<0.25);
+}
+
+void TestImagingAlgorithms::ReferenceImageCorrection_Interpolation()
+{
+    ImagingAlgorithms::ReferenceImageCorrection ric;
+    size_t roi[4]={10,20,74,52};
+
+    float poly[6]={100.0f,0.5f,-0.01f,0.002f,0.3f,-0.004f};
+    kipl::base::TImage<float,2> polyImg=ric.InterpolateBlackBodyImage(poly,roi);
+    QCOMPARE(polyImg.Size(0),roi[2]-roi[0]);
+    QCOMPARE(polyImg.Size(1),roi[3]-roi[1]);
+    for (size_t y=0; y<polyImg.Size(1); ++y)
+        for (size_t x=0; x<polyImg.Size(0); ++x) {
+            const float fx=static_cast<float>(x+roi[0]);
+            const float fy=static_cast<float>(y+roi[1]);
+            QCOMPARE(polyImg.GetLinePtr(y)[x],poly[0]+poly[1]*fx+poly[2]*fx*fx+poly[3]*fx*fy+poly[4]*fy+poly[5]*fy*fy);
+        }
+
+    // Thin plate splines with centres inside and outside the roi
+    std::map<std::pair<int,int>,float> values;
+    values[std::make_pair(12,25)]=1.0f;
+    values[std::make_pair(40,30)]=1.0f;
+    values[std::make_pair(70,50)]=1.0f;
+    values[std::make_pair(5,60)]=1.0f;
+    values[std::make_pair(90,10)]=1.0f;
+    float tps[8]={0.002f,-0.001f,0.0015f,-0.0005f,0.001f,50.0f,0.1f,-0.2f};
+
+    kipl::base::TImage<float,2> tpsImg=ric.InterpolateBlackBodyImagewithSplines(tps,values,roi);
+    for (size_t y=0; y<tpsImg.Size(1); ++y)
+        for (size_t x=0; x<tpsImg.Size(0); ++x) {
+            const double fx=static_cast<double>(x+roi[0]);
+            const double fy=static_cast<double>(y+roi[1]);
+            double expected=tps[5]+tps[6]*fy+tps[7]*fx;
+            size_t i=0;
+            for (auto it=values.begin(); it!=values.end(); ++it, ++i) {
+                const double dist=(it->first.first-fx)*(it->first.first-fx)+(it->first.second-fy)*(it->first.second-fy);
+                if (dist!=0.0)
+                    expected+=0.5*dist*std::log(dist)*tps[i];
+            }
+            QVERIFY(std::fabs(tpsImg.GetLinePtr(y)[x]-expected)<1e-4*(1.0+std::fabs(expected)));
+        }
+}
+
+void TestImagingAlgorithms::ReferenceImageCorrection_Process3D()
+{
+    size_t dims[3]={64,48,12};
+    size_t refDims[2]={dims[0],dims[1]};
+    kipl::base::TImage<float,3> img(dims);
+    kipl::base::TImage<float,3> bb(dims);
+    kipl::base::TImage<float,2> ob(refDims);
+    kipl::base::TImage<float,2> dc(refDims);
+    kipl::base::TImage<float,2> obbb(refDims);
+    std::vector<float> dose(dims[2]);
+    std::vector<float> bbdose(dims[2]);
+
+    for (size_t i=0; i<ob.Size(); ++i) {
+        ob[i]   = 1000.0f+(i % 37);
+        dc[i]   = 10.0f+(i % 5);
+        obbb[i] = 20.0f+(i % 3);
+    }
+
+    for (size_t z=0; z<dims[2]; ++z) {
+        dose[z]   = 90.0f+z;
+        bbdose[z] = 5.0f+0.5f*z;
+        for (size_t y=0; y<dims[1]; ++y)
+            for (size_t x=0; x<dims[0]; ++x) {
+                img.GetLinePtr(y,z)[x] = 15.0f+800.0f*std::exp(-0.0005f*((x-32.0f)*(x-32.0f)+(y-20.0f)*(y-20.0f)))+z;
+                bb.GetLinePtr(y,z)[x]  = 3.0f+0.1f*x+0.05f*y+0.2f*z;
+            }
+    }
+    img.GetLinePtr(5,3)[7]=1.0f; // a pixel below the transmission threshold
+
+    for (int logarithm=0; logarithm<2; ++logarithm) {
+        for (int external=0; external<2; ++external) {
+            kipl::base::TImage<float,3> result(dims);
+            std::copy_n(img.GetDataPtr(),img.Size(),result.GetDataPtr());
+
+            kipl::base::TImage<float,2> obcopy(refDims);
+            std::copy_n(ob.GetDataPtr(),ob.Size(),obcopy.GetDataPtr());
+            float obdose=100.0f;
+            float obbbdose=5.0f;
+
+            ImagingAlgorithms::ReferenceImageCorrection ric;
+            ric.SetComputeMinusLog(logarithm!=0);
+            ric.SetPBvariante(false);
+            if (external!=0)
+                ric.SetExternalBBimages(obbb,bb,obbbdose,bbdose.data());
+            ric.SetReferenceImages(&obcopy,&dc,false,external!=0,false,obdose,1.0f,false,nullptr,nullptr);
+            ric.Process(result,dose.data());
+
+            // Reference, one projection at a time with the 2D process
+            for (size_t z=0; z<dims[2]; ++z) {
+                kipl::base::TImage<float,2> slice(refDims);
+                std::copy_n(img.GetLinePtr(0,z),slice.Size(),slice.GetDataPtr());
+
+                kipl::base::TImage<float,2> bbslice(refDims);
+                std::copy_n(bb.GetLinePtr(0,z),bbslice.Size(),bbslice.GetDataPtr());
+
+                std::copy_n(ob.GetDataPtr(),ob.Size(),obcopy.GetDataPtr());
+                ImagingAlgorithms::ReferenceImageCorrection ric2D;
+                ric2D.SetComputeMinusLog(logarithm!=0);
+                ric2D.SetPBvariante(false);
+                if (external!=0)
+                    ric2D.SetExternalBBimages(obbb,bbslice,obbbdose,bbdose[z]);
+                ric2D.SetReferenceImages(&obcopy,&dc,false,external!=0,true,obdose,1.0f,false,nullptr,nullptr);
+                ric2D.Process(slice,dose[z]);
+
+                const float *pResult=result.GetLinePtr(0,z);
+                for (size_t i=0; i<slice.Size(); ++i)
+                    QCOMPARE(pResult[i],slice[i]);
+            }
+        }
+    }
+
+    // The SIMD logarithms only change the result within their accuracy
+    kipl::base::TImage<float,3> exact(dims);
+    for (auto accuracy : {kipl::math::ExactMath, kipl::math::PreciseMath, kipl::math::FastMath}) {
+        kipl::base::TImage<float,3> result(dims);
+        std::copy_n(img.GetDataPtr(),img.Size(),result.GetDataPtr());
+
+        kipl::base::TImage<float,2> obcopy(refDims);
+        std::copy_n(ob.GetDataPtr(),ob.Size(),obcopy.GetDataPtr());
+
+        ImagingAlgorithms::ReferenceImageCorrection ric;
+        ric.SetComputeMinusLog(true);
+        ric.SetLogAccuracy(accuracy);
+        ric.SetPBvariante(false);
+        ric.SetReferenceImages(&obcopy,&dc,false,false,false,100.0f,1.0f,false,nullptr,nullptr);
+        ric.Process(result,dose.data());
+
+        if (accuracy==kipl::math::ExactMath)
+            std::copy_n(result.GetDataPtr(),result.Size(),exact.GetDataPtr());
+
+        for (size_t i=0; i<result.Size(); ++i)
+            QVERIFY(std::abs(result[i]-exact[i])<1e-4f);
+    }
+}
+
 QTEST_APPLESS_MAIN(TestImagingAlgorithms)
 
 #include "tst_testImagingAlgorithms.moc"
@@ -0,0 +1,55 @@
+QT += testlib
+QT -= gui
+
+CONFIG += qt console warn_on depend_includepath testcase
+CONFIG -= app_bundle
+
+CONFIG += c++11
+
+CONFIG(release, debug|release): DESTDIR = $$PWD/../../../../../lib
+else:CONFIG(debug, debug|release): DESTDIR = $$PWD/../../../../../lib/debug
+
+TEMPLATE = app
+
+SOURCES +=  tst_bufferpooltests.cpp
+
+unix {
+    INCLUDEPATH += "../../../../../external/src/linalg"
+    QMAKE_CXXFLAGS += -fPIC -O2
+
+    unix:!macx {
+        QMAKE_CXXFLAGS += -fopenmp
+        QMAKE_LFLAGS += -lgomp
+        LIBS += -lgomp
+        QMAKE_LIBDIR += -L/opt/usr/lib
+    }
+
+    unix:macx {
+        INCLUDEPATH += /opt/local/include
+        QMAKE_LIBDIR += /opt/local/lib
+    }
+}
+
+win32 {
+    contains(QMAKE_HOST.arch, x86_64):{
+    QMAKE_LFLAGS += /MACHINE:X64
+    }
+    INCLUDEPATH += $$PWD/../../../../external/src/linalg $$PWD/../../../../external/include $$PWD/../../../../external/include/cfitsio
+    QMAKE_LIBDIR += $$PWD/../../../../external/lib64
+    QMAKE_CXXFLAGS += /openmp /O2
+
+    LIBS += -llibtiff -lcfitsio -lzlib_a -llibfftw3-3 -llibfftw3f-3 -lIphlpapi
+}
+
+win32:CONFIG(release, debug|release): LIBS += -llibtiff -lcfitsio -lzlib_a -llibfftw3-3 -llibfftw3f-3 -lIphlpapi
+else:win32:CONFIG(debug, debug|release): LIBS += -llibtiff -lcfitsio -lzlib_a -llibfftw3-3 -llibfftw3f-3 -lIphlpapi
+else:symbian: LIBS += -lm -lz -ltiff -lfftw3 -lfftw3f -lcfitsio
+else:unix: LIBS +=  -lm -lz   -ltiff  -lcfitsio
+
+CONFIG(release, debug|release): LIBS += -L$$PWD/../../../../../lib
+else:CONFIG(debug, debug|release): LIBS += -L$$PWD/../../../../../lib/debug/
+
+LIBS += -lkipl
+
+INCLUDEPATH += $$PWD/../../kipl/include
+DEPENDPATH += $$PWD/../../kipl/src
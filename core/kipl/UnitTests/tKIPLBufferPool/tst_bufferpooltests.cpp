@@ -0,0 +1,316 @@
+#include <QtTest>
+
+// add necessary includes here
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+
+#include <base/timage.h>
+#include <base/KiplException.h>
+#include <base/core/bufferpool.h>
+#include <utilities/threadpool.h>
+
+using kipl::base::core::BufferPool;
+
+class BufferPoolTests : public QObject
+{
+    Q_OBJECT
+
+public:
+    BufferPoolTests();
+    ~BufferPoolTests();
+
+private slots:
+    void test_SizeClasses();
+    void test_Reuse();
+    void test_Disabled();
+    void test_CacheLimit();
+    void test_Threads();
+    void test_ImageBuffers();
+    void bench_TemporariesSystem();
+    void bench_TemporariesPooled();
+
+private:
+    void temporaries(const kipl::base::TImage<float,2> &img);
+};
+
+BufferPoolTests::BufferPoolTests()
+{
+
+}
+
+BufferPoolTests::~BufferPoolTests()
+{
+    BufferPool::setEnabled(false);
+}
+
+void BufferPoolTests::test_SizeClasses()
+{
+    QCOMPARE(BufferPool::sizeClass(0),0UL);
+    QCOMPARE(BufferPool::sizeClass(256),0UL);
+    QCOMPARE(BufferPool::classSize(0),256UL);
+    QCOMPARE(BufferPool::sizeClass(257),1UL);
+    QCOMPARE(BufferPool::classSize(1),320UL);
+    QCOMPARE(BufferPool::sizeClass(512),4UL);
+    QCOMPARE(BufferPool::sizeClass(513),5UL);
+    QCOMPARE(BufferPool::maxPooledSize(),1UL<<30);
+
+    size_t prev=0;
+    for (size_t bytes=1; bytes<=BufferPool::maxPooledSize(); bytes+=1+bytes/7)
+    {
+        const size_t c=BufferPool::sizeClass(bytes);
+        QVERIFY(bytes<=BufferPool::classSize(c));
+        QVERIFY(c==0 || BufferPool::classSize(c-1)<bytes);
+        QVERIFY(BufferPool::classSize(c)<=256 || BufferPool::classSize(c)<=bytes+bytes/4+1); // at most 25% extra
+        QVERIFY(prev<=c);
+        prev=c;
+    }
+}
+
+void BufferPoolTests::test_Reuse()
+{
+    BufferPool::setEnabled(true);
+    BufferPool::resetStatistics();
+
+    void *a=BufferPool::allocate(100000);
+    QVERIFY(a!=nullptr);
+    QVERIFY(reinterpret_cast<std::uintptr_t>(a) % 64 == 0);
+    std::fill_n(reinterpret_cast<char *>(a),100000,1);
+
+    auto stats=BufferPool::statistics();
+    QCOMPARE(stats.requests,1UL);
+    QCOMPARE(stats.systemAllocations,1UL);
+    QCOMPARE(stats.bytesInUse,BufferPool::classSize(BufferPool::sizeClass(100000)));
+
+    BufferPool::release(a);
+    void *b=BufferPool::allocate(99000); // Same size class
+    QCOMPARE(b,a);
+
+    stats=BufferPool::statistics();
+    QCOMPARE(stats.requests,2UL);
+    QCOMPARE(stats.threadCacheHits,1UL);
+    QCOMPARE(stats.systemAllocations,1UL);
+
+    // Overflows the thread cache of the class into the shared lists
+    std::vector<void *> blocks;
+    for (size_t i=0; i<10; ++i)
+        blocks.push_back(BufferPool::allocate(100000));
+    for (void *p : blocks)
+        BufferPool::release(p);
+    BufferPool::release(b);
+
+    stats=BufferPool::statistics();
+    QCOMPARE(stats.bytesInUse,0UL);
+    QCOMPARE(stats.releases,12UL);
+    QVERIFY(0<stats.bytesCached);
+    QVERIFY(0<stats.peakBytesCached);
+
+    blocks.clear();
+    for (size_t i=0; i<10; ++i)
+        blocks.push_back(BufferPool::allocate(100000));
+    for (void *p : blocks)
+        BufferPool::release(p);
+
+    stats=BufferPool::statistics();
+    QCOMPARE(stats.systemAllocations,11UL);
+    QCOMPARE(stats.threadCacheHits+stats.sharedCacheHits,11UL);
+
+    QVERIFY(BufferPool::allocate(BufferPool::maxPooledSize()+1)==nullptr);
+    QCOMPARE(BufferPool::statistics().bypassed,1UL);
+
+    BufferPool::trim();
+    QCOMPARE(BufferPool::statistics().bytesCached,0UL);
+
+    BufferPool::setEnabled(false);
+}
+
+void BufferPoolTests::test_Disabled()
+{
+    BufferPool::setEnabled(false);
+    QVERIFY(BufferPool::enabled()==false);
+    QVERIFY(BufferPool::allocate(1000)==nullptr);
+
+    // Blocks allocated before the pool was disabled go back to the system
+    BufferPool::setEnabled(true);
+    void *a=BufferPool::allocate(1000);
+    QVERIFY(a!=nullptr);
+    BufferPool::setEnabled(false);
+    BufferPool::resetStatistics();
+    BufferPool::release(a);
+
+    auto stats=BufferPool::statistics();
+    QCOMPARE(stats.systemReleases,1UL);
+    QCOMPARE(stats.bytesCached,0UL);
+}
+
+void BufferPoolTests::test_CacheLimit()
+{
+    BufferPool::setEnabled(true);
+    const size_t limit=BufferPool::cacheLimit();
+    BufferPool::setCacheLimit(0);
+    BufferPool::resetStatistics();
+
+    std::vector<void *> blocks;
+    for (size_t i=0; i<8; ++i)
+        blocks.push_back(BufferPool::allocate(4096));
+    for (void *p : blocks)
+        BufferPool::release(p);
+
+    // Only the thread cache holds blocks
+    auto stats=BufferPool::statistics();
+    QCOMPARE(stats.systemReleases,4UL);
+    QCOMPARE(stats.bytesCached,4*BufferPool::classSize(BufferPool::sizeClass(4096)));
+    BufferPool::trim();
+
+    // Concurrent releases never put more than the limit in the shared lists
+    const size_t blockSize=BufferPool::classSize(BufferPool::sizeClass(4096));
+    BufferPool::setCacheLimit(3*blockSize);
+    BufferPool::resetStatistics();
+
+    std::vector<std::thread> threads;
+    for (size_t t=0; t<4; ++t) {
+        threads.emplace_back([]()
+        {
+            for (size_t loop=0; loop<50; ++loop) {
+                std::vector<void *> local;
+                for (size_t i=0; i<16; ++i)
+                    local.push_back(BufferPool::allocate(4096));
+                for (void *p : local)
+                    BufferPool::release(p);
+            }
+        });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    QVERIFY(BufferPool::statistics().peakBytesCached<=3*blockSize);
+    BufferPool::trim();
+
+    BufferPool::setCacheLimit(limit);
+    BufferPool::setEnabled(false);
+}
+
+void BufferPoolTests::test_Threads()
+{
+    BufferPool::setEnabled(true);
+    BufferPool::resetStatistics();
+
+    const size_t nThreads=4;
+    const size_t nLoops=200;
+    std::vector<std::thread> threads;
+    std::vector<int> ok(nThreads,1);
+
+    for (size_t t=0; t<nThreads; ++t) {
+        threads.emplace_back([t,&ok]()
+        {
+            for (size_t i=0; i<nLoops; ++i) {
+                const size_t N=1000+(i % 7)*5000;
+                float *p=reinterpret_cast<float *>(BufferPool::allocate(N*sizeof(float)));
+                std::fill_n(p,N,static_cast<float>(t));
+                if (std::count(p,p+N,static_cast<float>(t))!=static_cast<std::ptrdiff_t>(N))
+                    ok[t]=0;
+                BufferPool::release(p);
+            }
+        });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    QCOMPARE(std::count(ok.begin(),ok.end(),1),static_cast<std::ptrdiff_t>(nThreads));
+
+    // The counters of the finished threads are kept and their caches are moved to the shared lists
+    auto stats=BufferPool::statistics();
+    QCOMPARE(stats.requests,nThreads*nLoops);
+    QCOMPARE(stats.releases,nThreads*nLoops);
+    QCOMPARE(stats.bytesInUse,0UL);
+    QCOMPARE(stats.requests,stats.threadCacheHits+stats.sharedCacheHits+stats.systemAllocations);
+    QVERIFY(stats.systemAllocations<=nThreads*7);
+
+    BufferPool::setEnabled(false);
+    QCOMPARE(BufferPool::statistics().bytesCached,0UL);
+}
+
+void BufferPoolTests::test_ImageBuffers()
+{
+    size_t dims[2]={100,100};
+    kipl::base::TImage<float,2> before(dims);
+
+    BufferPool::setEnabled(true);
+    BufferPool::resetStatistics();
+    {
+        kipl::base::TImage<float,2> img(dims);
+        QVERIFY(reinterpret_cast<size_t>(img.GetDataPtr()) % 32 == 0UL);
+        img=1.0f;
+        QCOMPARE(img[0],1.0f);
+        QCOMPARE(img[img.Size()-1],1.0f);
+        img=before;                             // The pooled buffer is released
+
+        kipl::base::TImage<float,2> img2(dims);
+        img2.Clone();
+        img2=3.0f;
+        kipl::base::TImage<float,2> img3=img2;
+        img3.Clone();                           // Copy on write allocates from the pool
+        QCOMPARE(img3[17],3.0f);
+
+        size_t dims2[2]={50,50};
+        img3.Resize(dims2);
+        QCOMPARE(img3.Size(),2500UL);
+    }
+
+    auto stats=BufferPool::statistics();
+    QCOMPARE(stats.requests,4UL);
+    QCOMPARE(stats.releases,4UL);
+    QCOMPARE(stats.bytesInUse,0UL);
+    QVERIFY(0<stats.threadCacheHits);
+
+    // Buffers allocated by the system are still released correctly when the pool is enabled
+    before=kipl::base::TImage<float,2>();
+
+    QVERIFY_EXCEPTION_THROWN(kipl::base::core::buffer<float> c(100000000000000UL),kipl::base::KiplException);
+
+    BufferPool::setEnabled(false);
+}
+
+void BufferPoolTests::temporaries(const kipl::base::TImage<float,2> &img)
+{
+    // Per projection temporaries like in the preprocessing modules
+    kipl::utilities::ThreadPool::global().parallel_for(0,64,[&img](size_t first, size_t last)
+    {
+        for (size_t i=first; i<last; ++i) {
+            kipl::base::TImage<float,2> tmp(img.Dims());
+            kipl::base::TImage<float,2> res=img;
+            res.Clone();
+            res+=tmp;
+        }
+    },1);
+}
+
+void BufferPoolTests::bench_TemporariesSystem()
+{
+    size_t dims[2]={1024,1024};
+    kipl::base::TImage<float,2> img(dims);
+
+    BufferPool::setEnabled(false);
+    QBENCHMARK {
+        temporaries(img);
+    }
+}
+
+void BufferPoolTests::bench_TemporariesPooled()
+{
+    size_t dims[2]={1024,1024};
+    kipl::base::TImage<float,2> img(dims);
+
+    BufferPool::setEnabled(true);
+    QBENCHMARK {
+        temporaries(img);
+    }
+    BufferPool::setEnabled(false);
+}
+
+QTEST_APPLESS_MAIN(BufferPoolTests)
+
+#include "tst_bufferpooltests.moc"
@@ -0,0 +1,309 @@
+#include <QtTest>
+
+// add necessary includes here
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include <base/timage.h>
+#include <base/KiplException.h>
+#include <queuefilter/slicestream.h>
+#include <queuefilter/sliceworkers.h>
+#include <queuefilter/slicestreamio.h>
+
+namespace {
+
+/// Writes the first pixel of each window slice to the result, i.e. the slice index of a volume with slice valued pixels
+class WindowWorker : public akipl::queuefilter::SliceWorker<float>
+{
+public:
+    WindowWorker(size_t r) : akipl::queuefilter::SliceWorker<float>("WindowWorker"), m_nRadius(r) {}
+    virtual size_t neighborhood() const { return m_nRadius; }
+    virtual void process(const std::vector<const kipl::base::TImage<float,2> *> &window, kipl::base::TImage<float,2> &result) const
+    {
+        result.Resize(window[0]->Dims());
+        result=0.0f;
+        for (size_t i=0; i<window.size(); ++i)
+            result[i]=window[i]->GetDataPtr()[0];
+    }
+private:
+    size_t m_nRadius;
+};
+
+/// Fails on one slice
+class FailingWorker : public akipl::queuefilter::SliceWorker<float>
+{
+public:
+    FailingWorker() : akipl::queuefilter::SliceWorker<float>("FailingWorker") {}
+    virtual size_t neighborhood() const { return 1; }
+    virtual void process(const std::vector<const kipl::base::TImage<float,2> *> &window, kipl::base::TImage<float,2> &result) const
+    {
+        if (window[1]->GetDataPtr()[0]==5.0f)
+            throw kipl::base::KiplException("Slice 5 failed",__FILE__,__LINE__);
+        result.Resize(window[1]->Dims());
+    }
+};
+
+}
+
+class QueueFilterTests : public QObject
+{
+    Q_OBJECT
+
+public:
+    QueueFilterTests();
+    ~QueueFilterTests();
+
+private slots:
+    void test_Window();
+    void test_LinearFilter();
+    void test_RankFilter();
+    void test_Chain();
+    void test_TIFFStack();
+    void test_Errors();
+    void test_Benchmark();
+
+private:
+    kipl::base::TImage<float,3> testVolume(size_t nx, size_t ny, size_t nz);
+    kipl::base::TImage<float,3> stream(const kipl::base::TImage<float,3> &img,
+                                       std::vector<akipl::queuefilter::SliceWorker<float> *> stages,
+                                       size_t nThreads, size_t queueSize);
+};
+
+QueueFilterTests::QueueFilterTests()
+{
+
+}
+
+QueueFilterTests::~QueueFilterTests()
+{
+
+}
+
+kipl::base::TImage<float,3> QueueFilterTests::testVolume(size_t nx, size_t ny, size_t nz)
+{
+    size_t dims[3]={nx,ny,nz};
+    kipl::base::TImage<float,3> img(dims);
+
+    for (size_t i=0; i<img.Size(); ++i)
+        img[i]=100.0f*std::sin(0.013f*i)+std::fmod(i*0.37f,7.0f);
+
+    return img;
+}
+
+kipl::base::TImage<float,3> QueueFilterTests::stream(const kipl::base::TImage<float,3> &img,
+                                                     std::vector<akipl::queuefilter::SliceWorker<float> *> stages,
+                                                     size_t nThreads, size_t queueSize)
+{
+    kipl::base::TImage<float,3> res;
+    akipl::queuefilter::VolumeSliceSource<float> source(img);
+    akipl::queuefilter::VolumeSliceSink<float> sink(res);
+
+    akipl::queuefilter::SlicePipeline<float> pipeline;
+    pipeline.setSource(source);
+    for (auto stage : stages)
+        pipeline.addStage(*stage);
+    pipeline.setSink(sink);
+    pipeline.setThreadsPerStage(nThreads);
+    pipeline.setQueueSize(queueSize);
+    pipeline.run();
+
+    return res;
+}
+
+void QueueFilterTests::test_Window()
+{
+    size_t dims[3]={8,4,9};
+    kipl::base::TImage<float,3> img(dims);
+    for (size_t z=0; z<dims[2]; ++z)
+        std::fill_n(img.GetLinePtr(0,z),dims[0]*dims[1],static_cast<float>(z));
+
+    for (size_t r : {0UL,1UL,3UL}) {
+        WindowWorker worker(r);
+        kipl::base::TImage<float,3> res=stream(img,{&worker},3,1);
+
+        for (size_t z=0; z<dims[2]; ++z) {
+            const float *line=res.GetLinePtr(0,z);
+            for (size_t i=0; i<=2*r; ++i) {
+                // The stack ends are mirrored
+                ptrdiff_t idx=static_cast<ptrdiff_t>(z+i)-static_cast<ptrdiff_t>(r);
+                idx= idx<0 ? -idx : idx;
+                idx= static_cast<ptrdiff_t>(dims[2])<=idx ? 2*(static_cast<ptrdiff_t>(dims[2])-1)-idx : idx;
+                QCOMPARE(line[i],static_cast<float>(idx));
+            }
+        }
+    }
+}
+
+void QueueFilterTests::test_LinearFilter()
+{
+    kipl::base::TImage<float,3> img=testVolume(23,17,12);
+    const std::vector<float> kernel={0.1f,0.2f,0.4f,0.2f,0.1f};
+    const ptrdiff_t r=2;
+
+    auto mirror=[](ptrdiff_t i, ptrdiff_t N) {i= i<0 ? -i : i; return N<=i ? 2*(N-1)-i : i;};
+
+    // Direct convolution with mirrored borders
+    kipl::base::TImage<float,3> ref(img.Dims());
+    const ptrdiff_t nx=img.Size(0), ny=img.Size(1), nz=img.Size(2);
+    for (ptrdiff_t z=0; z<nz; ++z)
+        for (ptrdiff_t y=0; y<ny; ++y)
+            for (ptrdiff_t x=0; x<nx; ++x) {
+                double sum=0.0;
+                for (ptrdiff_t k=-r; k<=r; ++k)
+                    for (ptrdiff_t j=-r; j<=r; ++j)
+                        for (ptrdiff_t i=-r; i<=r; ++i)
+                            sum+=kernel[k+r]*kernel[j+r]*kernel[i+r]*
+                                 img(static_cast<size_t>(mirror(x+i,nx)),static_cast<size_t>(mirror(y+j,ny)),static_cast<size_t>(mirror(z+k,nz)));
+                ref(static_cast<size_t>(x),static_cast<size_t>(y),static_cast<size_t>(z))=static_cast<float>(sum);
+            }
+
+    akipl::queuefilter::SliceLinearFilterWorker<float> worker(kernel);
+
+    for (size_t nThreads : {1UL,4UL}) {
+        for (size_t queueSize : {1UL,8UL}) {
+            kipl::base::TImage<float,3> res=stream(img,{&worker},nThreads,queueSize);
+            QCOMPARE(res.Size(),img.Size());
+            for (size_t i=0; i<res.Size(); ++i)
+                QVERIFY(std::abs(res[i]-ref[i])<1e-3f);
+        }
+    }
+
+    QVERIFY_EXCEPTION_THROWN(akipl::queuefilter::SliceLinearFilterWorker<float>({0.5f,0.5f}),kipl::base::KiplException);
+}
+
+void QueueFilterTests::test_RankFilter()
+{
+    kipl::base::TImage<float,3> img=testVolume(11,9,7);
+
+    auto mirror=[](ptrdiff_t i, ptrdiff_t N) {i= i<0 ? -i : i; return N<=i ? 2*(N-1)-i : i;};
+    const ptrdiff_t nx=img.Size(0), ny=img.Size(1), nz=img.Size(2);
+
+    for (auto rank : {akipl::queuefilter::SliceRankMin,akipl::queuefilter::SliceRankMedian,akipl::queuefilter::SliceRankMax}) {
+        akipl::queuefilter::SliceRankFilterWorker<float> worker(3,rank);
+        kipl::base::TImage<float,3> res=stream(img,{&worker},3,2);
+
+        std::vector<float> values;
+        for (ptrdiff_t z=0; z<nz; ++z)
+            for (ptrdiff_t y=0; y<ny; ++y)
+                for (ptrdiff_t x=0; x<nx; ++x) {
+                    values.clear();
+                    for (ptrdiff_t k=-1; k<=1; ++k)
+                        for (ptrdiff_t j=-1; j<=1; ++j)
+                            for (ptrdiff_t i=-1; i<=1; ++i)
+                                values.push_back(img(static_cast<size_t>(mirror(x+i,nx)),static_cast<size_t>(mirror(y+j,ny)),static_cast<size_t>(mirror(z+k,nz))));
+                    std::sort(values.begin(),values.end());
+
+                    const float expected= rank==akipl::queuefilter::SliceRankMin ? values.front() :
+                                         (rank==akipl::queuefilter::SliceRankMax ? values.back() : values[13]);
+                    QCOMPARE(res(static_cast<size_t>(x),static_cast<size_t>(y),static_cast<size_t>(z)),expected);
+                }
+    }
+}
+
+void QueueFilterTests::test_Chain()
+{
+    kipl::base::TImage<float,3> img=testVolume(40,30,25);
+
+    akipl::queuefilter::SliceLinearFilterWorker<float> smooth({0.25f,0.5f,0.25f});
+    akipl::queuefilter::SliceRankFilterWorker<float> median(3);
+    akipl::queuefilter::SliceThresholdWorker<float> threshold(10.0f);
+
+    // The chained stages give the same result as the stages one after the other
+    kipl::base::TImage<float,3> a=stream(img,{&smooth},1,1);
+    a=stream(a,{&median},1,1);
+    a=stream(a,{&threshold},1,1);
+
+    kipl::base::TImage<float,3> b=stream(img,{&smooth,&median,&threshold},4,2);
+
+    QCOMPARE(b.Size(),a.Size());
+    for (size_t i=0; i<a.Size(); ++i) {
+        QCOMPARE(b[i],a[i]);
+        QVERIFY((b[i]==0.0f) || (b[i]==1.0f));
+    }
+
+    // Without stages the volume is copied
+    kipl::base::TImage<float,3> c=stream(img,{},2,1);
+    for (size_t i=0; i<img.Size(); ++i)
+        QCOMPARE(c[i],img[i]);
+}
+
+void QueueFilterTests::test_TIFFStack()
+{
+    kipl::base::TImage<float,3> img=testVolume(32,24,10);
+    const std::string mask=QDir::tempPath().toStdString()+"/slicestream_####.tif";
+
+    {
+        akipl::queuefilter::VolumeSliceSource<float> source(img);
+        akipl::queuefilter::TIFFStackSink<float> sink(mask,3);
+        akipl::queuefilter::SlicePipeline<float> pipeline;
+        pipeline.setSource(source);
+        pipeline.setSink(sink);
+        pipeline.run();
+    }
+
+    akipl::queuefilter::SliceLinearFilterWorker<float> worker({0.25f,0.5f,0.25f});
+    kipl::base::TImage<float,3> res;
+    {
+        akipl::queuefilter::TIFFStackSource<float> source(mask,3,10);
+        akipl::queuefilter::VolumeSliceSink<float> sink(res);
+        akipl::queuefilter::SlicePipeline<float> pipeline;
+        pipeline.setSource(source);
+        pipeline.addStage(worker);
+        pipeline.setSink(sink);
+        pipeline.run();
+    }
+
+    kipl::base::TImage<float,3> ref=stream(img,{&worker},2,4);
+    QCOMPARE(res.Size(),ref.Size());
+    for (size_t i=0; i<ref.Size(); ++i)
+        QCOMPARE(res[i],ref[i]);
+
+    // A missing file stops the streaming
+    akipl::queuefilter::TIFFStackSource<float> missing(mask,3,12);
+    kipl::base::TImage<float,3> tmp;
+    akipl::queuefilter::VolumeSliceSink<float> sink(tmp);
+    akipl::queuefilter::SlicePipeline<float> pipeline;
+    pipeline.setSource(missing);
+    pipeline.setSink(sink);
+    QVERIFY_EXCEPTION_THROWN(pipeline.run(),kipl::base::KiplException);
+}
+
+void QueueFilterTests::test_Errors()
+{
+    kipl::base::TImage<float,3> img=testVolume(16,16,12);
+    for (size_t z=0; z<img.Size(2); ++z)
+        img.GetLinePtr(0,z)[0]=static_cast<float>(z);
+
+    FailingWorker failing;
+    akipl::queuefilter::SliceLinearFilterWorker<float> smooth({0.25f,0.5f,0.25f});
+    QVERIFY_EXCEPTION_THROWN(stream(img,{&failing},4,1),kipl::base::KiplException);
+    QVERIFY_EXCEPTION_THROWN(stream(img,{&failing,&smooth},2,2),kipl::base::KiplException);
+
+    // The neighborhood must fit into the stack
+    WindowWorker wide(12);
+    QVERIFY_EXCEPTION_THROWN(stream(img,{&wide},1,1),kipl::base::KiplException);
+
+    akipl::queuefilter::SlicePipeline<float> pipeline;
+    QVERIFY_EXCEPTION_THROWN(pipeline.run(),kipl::base::KiplException);
+}
+
+void QueueFilterTests::test_Benchmark()
+{
+    kipl::base::TImage<float,3> img=testVolume(256,256,128);
+
+    akipl::queuefilter::SliceLinearFilterWorker<float> smooth({0.1f,0.2f,0.4f,0.2f,0.1f});
+    akipl::queuefilter::SliceRankFilterWorker<float> median(3);
+    akipl::queuefilter::SliceThresholdWorker<float> threshold(10.0f);
+
+    kipl::base::TImage<float,3> res;
+    QBENCHMARK {
+        res=stream(img,{&smooth,&median,&threshold},0,8);
+    }
+    QCOMPARE(res.Size(),img.Size());
+}
+
+QTEST_APPLESS_MAIN(QueueFilterTests)
+
+#include "tst_queuefiltertests.moc"
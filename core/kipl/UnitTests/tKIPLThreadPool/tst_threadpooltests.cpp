@@ -0,0 +1,180 @@
+#include <QtTest>
+
+// add necessary includes here
+#include <vector>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+#include <thread>
+#include <stdexcept>
+#include <chrono>
+
+#include <utilities/threadpool.h>
+#include <utilities/boundedqueue.h>
+
+class ThreadPoolTests : public QObject
+{
+    Q_OBJECT
+
+public:
+    ThreadPoolTests();
+    ~ThreadPoolTests();
+
+private slots:
+    void test_ParallelFor();
+    void test_NestedParallelFor();
+    void test_Exception();
+    void test_GlobalBudget();
+    void test_BoundedQueue();
+
+};
+
+ThreadPoolTests::ThreadPoolTests()
+{
+
+}
+
+ThreadPoolTests::~ThreadPoolTests()
+{
+
+}
+
+void ThreadPoolTests::test_ParallelFor()
+{
+    kipl::utilities::ThreadPool pool(4);
+    QCOMPARE(pool.size(),4UL);
+
+    std::vector<int> data(10007,0);
+
+    for (size_t grain : {0UL, 1UL, 13UL, 20000UL})
+    {
+        std::fill(data.begin(),data.end(),0);
+        pool.parallel_for(0,data.size(),[&data](size_t first, size_t last)
+        {
+            for (size_t i=first; i<last; ++i)
+                data[i]++;
+        },grain);
+
+        QCOMPARE(std::accumulate(data.begin(),data.end(),0),static_cast<int>(data.size()));
+        QCOMPARE(*std::min_element(data.begin(),data.end()),1);
+    }
+
+    // An empty range must not call the function
+    bool called=false;
+    pool.parallel_for(5,5,[&called](size_t, size_t){called=true;});
+    QVERIFY(!called);
+}
+
+void ThreadPoolTests::test_NestedParallelFor()
+{
+    kipl::utilities::ThreadPool pool(4);
+    std::atomic<size_t> cnt(0);
+
+    pool.parallel_for(0,64,[&](size_t first, size_t last)
+    {
+        for (size_t i=first; i<last; ++i)
+            pool.parallel_for(0,100,[&cnt](size_t a, size_t b){cnt+=b-a;},7);
+    },1);
+
+    QCOMPARE(cnt.load(),6400UL);
+}
+
+void ThreadPoolTests::test_Exception()
+{
+    kipl::utilities::ThreadPool pool(4);
+
+    QVERIFY_EXCEPTION_THROWN(pool.parallel_for(0,100,[](size_t first, size_t last)
+    {
+        if ((first<=50) && (50<last))
+            throw std::runtime_error("block failed");
+    },1),std::runtime_error);
+
+    // The pool must still work after an exception
+    std::atomic<size_t> cnt(0);
+    pool.parallel_for(0,100,[&cnt](size_t a, size_t b){cnt+=b-a;},1);
+    QCOMPARE(cnt.load(),100UL);
+}
+
+void ThreadPoolTests::test_GlobalBudget()
+{
+    kipl::utilities::ThreadPool::setGlobalThreadBudget(3);
+    QCOMPARE(kipl::utilities::ThreadPool::globalThreadBudget(),3UL);
+    QCOMPARE(kipl::utilities::ThreadPool::global().size(),3UL);
+
+    std::atomic<size_t> cnt(0);
+    kipl::utilities::ThreadPool::global().parallel_for(5,1005,[&cnt](size_t a, size_t b){cnt+=b-a;});
+    QCOMPARE(cnt.load(),1000UL);
+
+    // A loop in flight on the previous pool is not affected by a budget change
+    kipl::utilities::ThreadPool &previous=kipl::utilities::ThreadPool::global();
+    std::atomic<size_t> running(0);
+    std::thread loop([&previous,&running]()
+    {
+        previous.parallel_for(0,64,[&running](size_t a, size_t b)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            running+=b-a;
+        },1);
+    });
+
+    kipl::utilities::ThreadPool::setGlobalThreadBudget(2);
+    QCOMPARE(kipl::utilities::ThreadPool::global().size(),2UL);
+    loop.join();
+    QCOMPARE(running.load(),64UL);
+
+    cnt=0;
+    previous.parallel_for(0,100,[&cnt](size_t a, size_t b){cnt+=b-a;});
+    QCOMPARE(cnt.load(),100UL);
+
+    kipl::utilities::ThreadPool::setGlobalThreadBudget(3);
+    QVERIFY(&kipl::utilities::ThreadPool::global()==&previous);
+
+    kipl::utilities::ThreadPool::setGlobalThreadBudget(0);
+    QCOMPARE(kipl::utilities::ThreadPool::globalThreadBudget(),static_cast<size_t>(std::max(1U,std::thread::hardware_concurrency())));
+}
+
+void ThreadPoolTests::test_BoundedQueue()
+{
+    const int N=10000;
+    kipl::utilities::BoundedQueue<int> queue(4);
+    QCOMPARE(queue.capacity(),4UL);
+
+    // The consumer receives all items in order and the queue never holds more than its capacity
+    std::vector<int> received;
+    size_t largest=0;
+    std::thread consumer([&]() {
+        int item=0;
+        while (queue.pop(item)) {
+            received.push_back(item);
+            largest=std::max(largest,queue.size());
+        }
+    });
+
+    for (int i=0; i<N; ++i)
+        QVERIFY(queue.push(i));
+    queue.close();
+    consumer.join();
+
+    QCOMPARE(received.size(),static_cast<size_t>(N));
+    for (int i=0; i<N; ++i)
+        QCOMPARE(received[i],i);
+    QVERIFY(largest<=4UL);
+    QVERIFY(!queue.push(N));
+
+    // Abort releases a producer that waits on a full queue
+    kipl::utilities::BoundedQueue<int> full(1);
+    QVERIFY(full.push(1));
+    bool pushed=true;
+    std::thread producer([&]() {pushed=full.push(2);});
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    full.abort();
+    producer.join();
+    QVERIFY(!pushed);
+
+    int item=0;
+    QVERIFY(!full.pop(item));
+}
+
+QTEST_APPLESS_MAIN(ThreadPoolTests)
+
+#include "tst_threadpooltests.moc"
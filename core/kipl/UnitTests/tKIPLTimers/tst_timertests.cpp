@@ -8,7 +8,11 @@
 #include <thread>
 #include <typeinfo>
 
+#include <sstream>
+#include <stdexcept>
+
 #include <profile/Timer.h>
+#include <profile/Tracer.h>
 
 // the function f() does some time-consuming work
 void f()
@@ -31,6 +35,8 @@ private slots:
     void test_case1();
     void test_BasicTiming();
     void test_ThreadedTiming();
+    void test_Tracer();
+    void test_ScopedTracing();
 
 };
 
@@ -111,6 +117,78 @@ void TimerTests::test_ThreadedTiming()
 
 }
 
+void TimerTests::test_Tracer()
+{
+    kipl::profile::Tracer &tracer=kipl::profile::Tracer::instance();
+
+    tracer.setEnabled(false);
+    tracer.clear();
+    {
+        KIPL_TRACE_SCOPE("disabled","test");
+    }
+    QCOMPARE(tracer.eventCount(),size_t(0));
+
+    tracer.setEnabled(true);
+    auto work = [&tracer]() {
+        for (int i=0; i<10; ++i) {
+            kipl::profile::ScopedSpan span(std::string("span"),"test");
+            tracer.addCounter("items",1.0,"test");
+        }
+    };
+
+    std::thread t1(work);
+    std::thread t2(work);
+    t1.join();
+    t2.join();
+    tracer.setEnabled(false);
+
+    QCOMPARE(tracer.eventCount(),size_t(40));
+
+    std::ostringstream json;
+    tracer.writeChromeTrace(json);
+    QVERIFY(json.str().find("\"traceEvents\"")!=std::string::npos);
+    QVERIFY(json.str().find("\"ph\":\"X\"")!=std::string::npos);
+    QVERIFY(json.str().find("\"ph\":\"C\"")!=std::string::npos);
+
+    std::string summary=tracer.summary();
+    QVERIFY(summary.find("test/span")!=std::string::npos);
+    QVERIFY(summary.find("test/items")!=std::string::npos);
+
+    tracer.clear();
+    QCOMPARE(tracer.eventCount(),size_t(0));
+}
+
+void TimerTests::test_ScopedTracing()
+{
+    kipl::profile::Tracer &tracer=kipl::profile::Tracer::instance();
+    tracer.setEnabled(false);
+
+    {
+        kipl::profile::ScopedTracing tracing(false);
+        QVERIFY(!tracing.isActive());
+        QVERIFY(!tracer.isEnabled());
+    }
+
+    {
+        kipl::profile::ScopedTracing tracing;
+        QVERIFY(tracer.isEnabled());
+        tracing.stop();
+        QVERIFY(!tracing.isActive());
+        QVERIFY(!tracer.isEnabled());
+    }
+
+    try {
+        kipl::profile::ScopedTracing tracing(true);
+        QVERIFY(tracer.isEnabled());
+        throw std::runtime_error("aborted");
+    }
+    catch (std::runtime_error &) {
+    }
+    QVERIFY(!tracer.isEnabled());
+
+    tracer.clear();
+}
+
 QTEST_APPLESS_MAIN(TimerTests)
 
 #include "tst_timertests.moc"
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <vector>
+#include <cmath>
+#include <chrono>
 
 #include <QString>
 #include <QtTest>
@@ -8,6 +10,8 @@
 #include <io/io_tiff.h>
 #include <filters/nonlocalmeans.h>
 #include <base/KiplException.h>
+#include <scalespace/ISSfilterQ3Dp.h>
+#include <math/fastmath.h>
 
 
 class TKiplAdvFiltersTest : public QObject
@@ -23,7 +27,13 @@ private Q_SLOTS:
     void NLMeans_WindowEnum();
     void NLMeans_AlgorithmEnum();
     void NLMeans_process();
+    void ISSfilterQ3Dp_process();
+    void ISSfilterQ3Dp_benchmark_data();
+    void ISSfilterQ3Dp_benchmark();
 
+private:
+    kipl::base::TImage<float,3> issTestVolume(size_t N);
+    void issReference(kipl::base::TImage<float,3> &u, float tau, float lambda, float alpha, int nN);
 };
 
 TKiplAdvFiltersTest::TKiplAdvFiltersTest()
@@ -132,6 +142,143 @@ void TKiplAdvFiltersTest::NLMeans_process()
 
 }
 
+kipl::base::TImage<float,3> TKiplAdvFiltersTest::issTestVolume(size_t N)
+{
+    size_t dims[3]={N+3,N,N/2+1};
+    kipl::base::TImage<float,3> img(dims);
+
+    // A ball on a ramp with deterministic noise
+    for (size_t z=0; z<dims[2]; ++z)
+        for (size_t y=0; y<dims[1]; ++y) {
+            float *p=img.GetLinePtr(y,z);
+            for (size_t x=0; x<dims[0]; ++x) {
+                const float r2=(x-dims[0]/2.0f)*(x-dims[0]/2.0f)+(y-dims[1]/2.0f)*(y-dims[1]/2.0f)+(z-dims[2]/2.0f)*(z-dims[2]/2.0f);
+                p[x]=(r2<N*N/16.0f ? 1.0f : 0.0f)+0.001f*x+0.2f*std::sin(0.7f*x+1.3f*y+2.1f*z);
+            }
+        }
+    img[0]=img[1]; // A pixel with zero gradient
+
+    return img;
+}
+
+// Straightforward version of the scheme, the slices are processed one at a time with the mirrored boundaries
+void TKiplAdvFiltersTest::issReference(kipl::base::TImage<float,3> &u, float tau, float lambda, float alpha, int nN)
+{
+    const size_t sx=u.Size(0);
+    const size_t sy=u.Size(1);
+    const size_t sz=u.Size(2);
+    kipl::base::TImage<float,3> f; f.Clone(u);
+    kipl::base::TImage<float,3> v(u.Dims()); v=0.0f;
+    kipl::base::TImage<float,3> dx(u.Dims()), dy(u.Dims()), dz(u.Dims());
+
+    auto lag  = [](size_t i) {return i==0 ? 1 : i-1;};
+    auto lead = [](size_t i, size_t n) {return i+1<n ? i+1 : n-2;};
+
+    for (int it=0; it<nN; ++it) {
+        for (size_t z=0; z<sz; ++z)
+            for (size_t y=0; y<sy; ++y)
+                for (size_t x=0; x<sx; ++x) {
+                    const float c=u(x,y,z);
+                    const double gx=c-u(lag(x),y,z);
+                    const double gy=c-u(x,lag(y),z);
+                    const double gz=c-u(x,y,lag(z));
+                    const double n=std::sqrt(gx*gx+gy*gy+gz*gz);
+                    dx(x,y,z)=n==0.0 ? 0.0f : static_cast<float>(gx/n);
+                    dy(x,y,z)=n==0.0 ? 0.0f : static_cast<float>(gy/n);
+                    dz(x,y,z)=n==0.0 ? 0.0f : static_cast<float>(gz/n);
+                }
+
+        for (size_t z=0; z<sz; ++z)
+            for (size_t y=0; y<sy; ++y)
+                for (size_t x=0; x<sx; ++x) {
+                    const float p=(dx(lead(x,sx),y,z)-dx(x,y,z))+(dy(x,lead(y,sy),z)-dy(x,y,z))+(dz(x,y,lead(z,sz))-dz(x,y,z));
+                    const float fu=f(x,y,z)-u(x,y,z);
+                    u(x,y,z)+=tau*(p+lambda*(fu+v(x,y,z)));
+                    v(x,y,z)+=tau*alpha*fu;
+                }
+    }
+}
+
+void TKiplAdvFiltersTest::ISSfilterQ3Dp_process()
+{
+    const float tau=0.05f;
+    const float lambda=0.5f;
+    const float alpha=0.1f;
+    const int nN=5;
+
+    kipl::base::TImage<float,3> ref=issTestVolume(20);
+    kipl::base::TImage<float,3> orig=issTestVolume(20);
+    issReference(ref,tau,lambda,alpha,nN);
+
+    const kipl::math::eSIMDInstructionSet current=kipl::math::simdInstructionSet();
+
+    kipl::base::TImage<float,3> first;
+    for (auto set : {kipl::math::SIMDScalar, kipl::math::SIMDSSE2, kipl::math::SIMDAVX2}) {
+        kipl::math::setSIMDInstructionSet(set);
+        for (int threads : {1,3,32}) {
+            akipl::scalespace::ISSfilterQ3Dp<float> iss;
+            iss.SetNumThreads(threads);
+            kipl::base::TImage<float,3> img; img.Clone(orig);
+            QCOMPARE(iss.Process(img,tau,lambda,alpha,nN),nN);
+
+            float maxDiff=0.0f;
+            for (size_t i=0; i<img.Size(); ++i)
+                maxDiff=std::max(maxDiff,std::abs(img[i]-ref[i]));
+            QVERIFY2(maxDiff<1e-4f,(enum2string(kipl::math::simdInstructionSet())+" "+std::to_string(threads)+" threads, diff="+std::to_string(maxDiff)).c_str());
+
+            // The slabs don't change the arithmetic of a voxel
+            if (first.Size()==0)
+                first.Clone(img);
+            else if (set==kipl::math::SIMDScalar)
+                for (size_t i=0; i<img.Size(); ++i)
+                    QCOMPARE(img[i],first[i]);
+
+            // The error is the distance to the initial image before each step, it starts at zero
+            const float *error=iss.GetErrorArray();
+            QCOMPARE(error[0],0.0f);
+            QVERIFY(0.0f<error[nN-1]);
+        }
+    }
+    kipl::math::setSIMDInstructionSet(current);
+
+    size_t dims[3]={10,1,10};
+    kipl::base::TImage<float,3> flat(dims);
+    akipl::scalespace::ISSfilterQ3Dp<float> iss;
+    QVERIFY_EXCEPTION_THROWN(iss.Process(flat,tau,lambda,alpha,nN),kipl::base::KiplException);
+}
+
+void TKiplAdvFiltersTest::ISSfilterQ3Dp_benchmark_data()
+{
+    QTest::addColumn<int>("size");
+
+    QTest::newRow("64") << 64;
+    QTest::newRow("128") << 128;
+    QTest::newRow("256") << 256;
+}
+
+void TKiplAdvFiltersTest::ISSfilterQ3Dp_benchmark()
+{
+    QFETCH(int, size);
+
+    size_t dims[3]={size_t(size),size_t(size),size_t(size)};
+    kipl::base::TImage<float,3> img(dims);
+    for (size_t i=0; i<img.Size(); ++i)
+        img[i]=static_cast<float>(std::sin(0.001*i)+0.01*(i % 17));
+
+    akipl::scalespace::ISSfilterQ3Dp<float> iss;
+    const int nN=4;
+    double seconds=0.0;
+    int runs=0;
+
+    QBENCHMARK {
+        auto start=std::chrono::high_resolution_clock::now();
+        iss.Process(img,0.05,0.5,0.1,nN);
+        seconds+=std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+        ++runs;
+    }
+
+    qDebug() << size << "^3 voxels:" << runs*nN/seconds << "iterations/s";
+}
 
 QTEST_APPLESS_MAIN(TKiplAdvFiltersTest)
 
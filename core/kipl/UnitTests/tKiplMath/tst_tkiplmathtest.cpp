@@ -1,5 +1,10 @@
 #include <sstream>
 #include <list>
+#include <map>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 
 #include <QString>
 #include <QtTest>
@@ -10,6 +15,7 @@
 #include <math/tcenterofgravity.h>
 #include <math/circularhoughtransform.h>
 #include <math/nonlinfit.h>
+#include <math/batchfit.h>
 #include <filters/filter.h>
 #include <drawing/drawing.h>
 #include <math/statistics.h>
@@ -19,6 +25,7 @@
 #include <math/covariance.h>
 #include <math/gradient.h>
 #include <math/linfit.h>
+#include <math/fastmath.h>
 
 #include <io/io_tiff.h>
 
@@ -36,9 +43,15 @@ public:
 private Q_SLOTS:
     void testCOG();
     void testCircularHoughTransform();
+    void testCircularHoughTransform_multiRadius();
+    void testCircularHoughTransform_benchmarkSpatial();
+    void testCircularHoughTransform_benchmarkFFT();
     void testNonLinFit_enums();
     void testNonLinFit_GaussianFunction();
     void testNonLinFit_fitter();
+    void testNonLinFit_batchModels();
+    void testNonLinFit_batchFitter();
+    void testNonLinFit_batchBenchmark();
     void testFindPeaks();
 
     void testStatistics();
@@ -49,17 +62,27 @@ private Q_SLOTS:
     void testCovIntactData();
     void testCovSmallData();
     void testCorrSmallData();
+    void testCovChunkedData();
+    void testCovBenchmark();
     void testMinMax();
 
     void testPolyVal();
     void testPolyFit();
     void testPolyDeriv();
 
+    void testFastMath_enums();
+    void testFastMath_accuracy();
+    void testFastMath_limits();
+    void testFastMath_benchmarkExact();
+    void testFastMath_benchmarkPrecise();
+    void testFastMath_benchmarkFast();
+
 
 
 
 private:
     void TestGradient();
+    void benchmarkFastMath(kipl::math::eMathAccuracy accuracy);
     kipl::base::TImage<float,2> sin2D;
 };
 
@@ -167,6 +190,106 @@ void TKiplMathTest::testCircularHoughTransform()
     kipl::io::WriteTIFF32(chm,"chtg_map.tif");
 }
 
+void TKiplMathTest::testCircularHoughTransform_multiRadius()
+{
+    size_t dims[2]={100,90};
+
+    kipl::base::TImage<float,2> img(dims);
+    img=0.0f;
+
+    // Thin rings, the drawing library only has filled circles
+    auto ring = [&img](float cx, float cy, float radius) {
+        for (size_t y=0; y<img.Size(1); ++y)
+            for (size_t x=0; x<img.Size(0); ++x)
+                if (std::abs(std::sqrt((x-cx)*(x-cx)+(y-cy)*(y-cy))-radius)<0.5f)
+                    img(x,y)=1.0f;
+    };
+
+    ring(50.0f,50.0f,10.0f);
+    ring(20.0f,65.0f,6.0f);
+
+    kipl::math::CircularHoughTransform cht;
+
+    std::vector<float> radii={4.0f,6.0f,8.0f,10.0f,12.0f};
+
+    QVERIFY_EXCEPTION_THROWN(cht(img,std::vector<float>()),kipl::base::KiplException);
+    QVERIFY_EXCEPTION_THROWN(cht(img,std::vector<float>({5.0f,0.0f})),kipl::base::KiplException);
+
+    kipl::base::TImage<float,3> chm=cht(img,radii);
+
+    QCOMPARE(chm.Size(0),dims[0]);
+    QCOMPARE(chm.Size(1),dims[1]);
+    QCOMPARE(chm.Size(2),radii.size());
+    QCOMPARE(cht.radii(),radii);
+
+    // The slices equal the single radius transform where the kernel doesn't reach the edge
+    for (size_t r=0; r<radii.size(); ++r) {
+        kipl::base::TImage<float,2> ref=cht(img,radii[r]);
+        const size_t margin=static_cast<size_t>(std::ceil(radii[r]+1.0f));
+
+        float maxDiff=0.0f;
+        for (size_t y=margin; y<dims[1]-margin; ++y) {
+            const float *pRef=ref.GetLinePtr(y);
+            const float *pSlice=chm.GetLinePtr(y,r);
+            for (size_t x=margin; x<dims[0]-margin; ++x)
+                maxDiff=std::max(maxDiff,std::abs(pRef[x]-pSlice[x]));
+        }
+        QVERIFY2(maxDiff<1e-5f,QString("Radius %1 differs by %2").arg(radii[r]).arg(maxDiff).toStdString().c_str());
+    }
+
+    std::vector<kipl::math::CircularHoughPeak> peaks=cht.findPeaks(chm,2,5.0f);
+
+    QCOMPARE(peaks.size(),size_t(2));
+    QVERIFY(peaks[1].value<=peaks[0].value);
+
+    std::map<float,kipl::math::CircularHoughPeak> byRadius;
+    for (const auto &peak : peaks)
+        byRadius[peak.radius]=peak;
+
+    QVERIFY(byRadius.count(10.0f)==1);
+    QCOMPARE(byRadius[10.0f].x,50.0f);
+    QCOMPARE(byRadius[10.0f].y,50.0f);
+    QVERIFY(byRadius.count(6.0f)==1);
+    QCOMPARE(byRadius[6.0f].x,20.0f);
+    QCOMPARE(byRadius[6.0f].y,65.0f);
+
+    QVERIFY_EXCEPTION_THROWN(kipl::math::CircularHoughTransform().findPeaks(chm,2,5.0f),kipl::base::KiplException);
+}
+
+void TKiplMathTest::testCircularHoughTransform_benchmarkSpatial()
+{
+    size_t dims[2]={512,512};
+    kipl::base::TImage<float,2> img(dims);
+    img=0.0f;
+    kipl::drawing::Circle<float> circ(40.0);
+    circ.Draw(img,256,256,1.0);
+
+    kipl::math::CircularHoughTransform cht;
+
+    QBENCHMARK {
+        for (float r=20.0f; r<=60.0f; r+=4.0f)
+            cht(img,r);
+    }
+}
+
+void TKiplMathTest::testCircularHoughTransform_benchmarkFFT()
+{
+    size_t dims[2]={512,512};
+    kipl::base::TImage<float,2> img(dims);
+    img=0.0f;
+    kipl::drawing::Circle<float> circ(40.0);
+    circ.Draw(img,256,256,1.0);
+
+    kipl::math::CircularHoughTransform cht;
+    std::vector<float> radii;
+    for (float r=20.0f; r<=60.0f; r+=4.0f)
+        radii.push_back(r);
+
+    QBENCHMARK {
+        cht(img,radii);
+    }
+}
+
 void TKiplMathTest::testNonLinFit_enums()
 {
     std::string val;
@@ -275,6 +398,179 @@ void TKiplMathTest::testNonLinFit_fitter()
 
 }
 
+void TKiplMathTest::testNonLinFit_batchModels()
+{
+    // The analytic derivatives are compared to central differences
+    const double gauss[3]={2.0,0.5,1.5};
+    const double lorenz[1]={0.7};
+    const double voight[4]={3.0,0.2,0.5,0.8};
+
+    Nonlinear::GaussianModel gm;
+    Nonlinear::LorenzianModel lm;
+    Nonlinear::VoightModel vm;
+
+    auto gaussValue  = [&gm](double x, const double *a) {double d[3]; return gm(x,a,d);};
+    auto lorenzValue = [&lm](double x, const double *a) {double d[1]; return lm(x,a,d);};
+    auto voightValue = [&vm](double x, const double *a) {double d[4]; return vm(x,a,d);};
+
+    Nonlinear::NumericalJacobian<decltype(gaussValue),3>  gn(gaussValue);
+    Nonlinear::NumericalJacobian<decltype(lorenzValue),1> ln(lorenzValue);
+    Nonlinear::NumericalJacobian<decltype(voightValue),4> vn(voightValue);
+
+    Nonlinear::SumOfGaussians sog(1);
+    for (int i=0; i<3; ++i)
+        sog[i]=gauss[i];
+
+    double da[4], dn[4];
+    for (double x=-3.05; x<3.0; x+=0.1) {
+        const double y=gm(x,gauss,da);
+        QVERIFY(std::abs(y-gn(x,gauss,dn))<1e-12);
+        QVERIFY(std::abs(y-sog(x))<1e-12);
+        for (int i=0; i<3; ++i)
+            QVERIFY(std::abs(da[i]-dn[i])<1e-6);
+
+        lm(x,lorenz,da);
+        ln(x,lorenz,dn);
+        QVERIFY(std::abs(da[0]-dn[0])<1e-6);
+
+        vm(x,voight,da);
+        vn(x,voight,dn);
+        for (int i=0; i<4; ++i)
+            QVERIFY(std::abs(da[i]-dn[i])<1e-6);
+    }
+}
+
+void TKiplMathTest::testNonLinFit_batchFitter()
+{
+    const size_t N=100;
+    const size_t nFits=1000;
+    const int NP=Nonlinear::GaussianModel::NPars;
+
+    std::vector<double> x(N);
+    for (size_t i=0; i<N; ++i)
+        x[i]=(static_cast<double>(i)-N/2)*0.2;
+
+    // Each data set has its own Gaussian, the fits start from the same guess
+    std::vector<double> truth(nFits*NP);
+    std::vector<double> y(nFits*N);
+    std::vector<double> pars(nFits*NP);
+    Nonlinear::GaussianModel model;
+    double dyda[NP];
+    for (size_t f=0; f<nFits; ++f) {
+        double *t=truth.data()+f*NP;
+        t[0]=1.0+(f % 7)*0.5;
+        t[1]=-1.0+(f % 11)*0.2;
+        t[2]=0.8+(f % 5)*0.1;
+        for (size_t i=0; i<N; ++i)
+            y[f*N+i]=model(x[i],t,dyda);
+
+        pars[f*NP]=1.0;
+        pars[f*NP+1]=0.5;
+        pars[f*NP+2]=1.5;
+    }
+
+    y[3*N+10]=std::numeric_limits<double>::quiet_NaN();
+
+    Nonlinear::BatchLevenbergMarquardt<Nonlinear::GaussianModel> fitter(1e-15);
+    std::vector<Nonlinear::eFitStatus> status(nFits);
+    std::vector<double> chisq(nFits);
+    fitter.fit(x.data(),N,y.data(),nullptr,nFits,pars.data(),status.data(),chisq.data());
+
+    for (size_t f=0; f<nFits; ++f) {
+        if (f==3) {
+            QCOMPARE(status[f],Nonlinear::FitInvalidData);
+            continue;
+        }
+        QCOMPARE(status[f],Nonlinear::FitConverged);
+        QVERIFY(chisq[f]<1e-12);
+        QVERIFY(std::abs(pars[f*NP]-truth[f*NP])<1e-6);
+        QVERIFY(std::abs(pars[f*NP+1]-truth[f*NP+1])<1e-6);
+        QVERIFY(std::abs(std::abs(pars[f*NP+2])-truth[f*NP+2])<1e-6); // The model only depends on s^2
+    }
+
+    // Same result as the single curve fitter
+    Array1D<double> ax(N), ay(N), asig(N);
+    for (size_t i=0; i<N; ++i) {
+        ax[i]=x[i];
+        ay[i]=y[N+i];
+        asig[i]=1.0;
+    }
+    Nonlinear::SumOfGaussians sog(1);
+    sog[0]=1.0; sog[1]=0.5; sog[2]=1.5;
+    Nonlinear::LevenbergMarquardt mrq(1e-15);
+    mrq.fit(ax,ay,asig,sog);
+    QVERIFY(std::abs(sog[0]-pars[NP])<1e-6);
+    QVERIFY(std::abs(sog[1]-pars[NP+1])<1e-6);
+    QVERIFY(std::abs(std::abs(sog[2])-std::abs(pars[NP+2]))<1e-6);
+
+    // A held parameter keeps its initial value
+    double held[NP]={1.0,0.0,1.0};
+    double c=0.0;
+    int it=0;
+    fitter.hold(1);
+    QVERIFY(!fitter.isFree(1));
+    QCOMPARE(fitter.fit(x.data(),N,y.data(),nullptr,held,c,it),Nonlinear::FitConverged);
+    QCOMPARE(held[1],0.0);
+    QVERIFY(std::abs(held[0]-truth[0])<1e-6);
+    QVERIFY(std::abs(std::abs(held[2])-truth[2])<1e-6);
+    fitter.free(1);
+    QVERIFY(fitter.isFree(1));
+
+    // Too few data points
+    double few[NP]={1.0,0.5,1.5};
+    QCOMPARE(fitter.fit(x.data(),2,y.data(),nullptr,few,c,it),Nonlinear::FitInvalidData);
+
+    // A width without influence on the model gives a singular system
+    Nonlinear::BatchLevenbergMarquardt<Nonlinear::GaussianModel> zeroFitter(1e-15,100);
+    double zeroAmp[NP]={0.0,0.5,1.5};
+    zeroFitter.hold(0);
+    QCOMPARE(zeroFitter.fit(x.data(),N,y.data(),nullptr,zeroAmp,c,it),Nonlinear::FitSingular);
+
+    QVERIFY_EXCEPTION_THROWN(fitter.hold(NP),kipl::base::KiplException);
+
+    std::string val="maxiterations";
+    Nonlinear::eFitStatus e;
+    string2enum(val,e);
+    QCOMPARE(e,Nonlinear::FitMaxIterations);
+    QCOMPARE(enum2string(Nonlinear::FitSingular),std::string("singular"));
+}
+
+void TKiplMathTest::testNonLinFit_batchBenchmark()
+{
+    const size_t N=100;
+    const size_t nFits=10000;
+    const int NP=Nonlinear::GaussianModel::NPars;
+
+    std::vector<double> x(N);
+    std::vector<double> y(nFits*N);
+    std::vector<double> sig(nFits*N,0.1);
+    for (size_t i=0; i<N; ++i)
+        x[i]=(static_cast<double>(i)-N/2)*0.2;
+
+    Nonlinear::GaussianModel model;
+    double dyda[NP];
+    for (size_t f=0; f<nFits; ++f) {
+        const double t[NP]={2.0,0.01*(f % 50),1.0};
+        for (size_t i=0; i<N; ++i)
+            y[f*N+i]=model(x[i],t,dyda)+0.01*std::sin(0.7*(f*N+i));
+    }
+
+    Nonlinear::BatchLevenbergMarquardt<Nonlinear::GaussianModel> fitter(1e-6);
+    std::vector<double> pars(nFits*NP);
+    std::vector<Nonlinear::eFitStatus> status(nFits);
+
+    QBENCHMARK {
+        for (size_t f=0; f<nFits; ++f) {
+            pars[f*NP]=1.0;
+            pars[f*NP+1]=0.5;
+            pars[f*NP+2]=1.5;
+        }
+        fitter.fit(x.data(),N,y.data(),sig.data(),nFits,pars.data(),status.data());
+    }
+
+    QCOMPARE(std::count(status.begin(),status.end(),Nonlinear::FitConverged),static_cast<std::ptrdiff_t>(nFits));
+}
+
 void TKiplMathTest::testFindPeaks()
 {
     const size_t N=100;
@@ -469,6 +765,84 @@ void TKiplMathTest::testCorrSmallData()
     }
 }
 
+void TKiplMathTest::testCovChunkedData()
+{
+    const size_t nElements=1000;
+    const size_t nVars=7;
+    std::vector<float> data(nElements*nVars);
+
+    // A large offset makes the one-pass textbook formula fail
+    for (size_t v=0; v<nVars; ++v)
+        for (size_t i=0; i<nElements; ++i)
+            data[v*nElements+i]=1.0e4f+static_cast<float>((v+1)*sin(0.01*(v+1)*i)+0.1*cos(0.37*i*i));
+
+    for (bool bCenter : {true,false}) {
+        // Two-pass reference
+        std::vector<double> mean(nVars,0.0);
+        if (bCenter)
+            for (size_t v=0; v<nVars; ++v) {
+                for (size_t i=0; i<nElements; ++i)
+                    mean[v]+=data[v*nElements+i];
+                mean[v]/=nElements;
+            }
+
+        kipl::math::Covariance<float> cov;
+        TNT::Array2D<double> C=cov.compute(data.data(),nElements,nVars,bCenter);
+
+        QCOMPARE(cov.count(),nElements);
+        QCOMPARE(C.dim1(),int(nVars));
+
+        for (size_t a=0; a<nVars; ++a) {
+            for (size_t b=0; b<nVars; ++b) {
+                double sum=0.0;
+                for (size_t i=0; i<nElements; ++i)
+                    sum+=(data[a*nElements+i]-mean[a])*(data[b*nElements+i]-mean[b]);
+                sum/=nElements;
+
+                QVERIFY(std::abs(C[a][b]-sum)<1e-9*std::max(1.0,std::abs(sum)));
+            }
+        }
+
+        // The same data added in uneven chunks
+        cov.reset(nVars,bCenter);
+        const size_t chunks[]={0,1,333,334,700,1000};
+        for (size_t k=1; k<sizeof(chunks)/sizeof(size_t); ++k)
+            cov.accumulate(data.data()+chunks[k-1],chunks[k]-chunks[k-1],nElements);
+
+        TNT::Array2D<double> chunked=cov.result();
+        QCOMPARE(cov.count(),nElements);
+
+        for (size_t a=0; a<nVars; ++a)
+            for (size_t b=0; b<nVars; ++b)
+                QVERIFY(std::abs(C[a][b]-chunked[a][b])<1e-10*std::max(1.0,std::abs(C[a][b])));
+
+        if (bCenter)
+            for (size_t v=0; v<nVars; ++v)
+                QVERIFY(std::abs(cov.mean()[v]-mean[v])<1e-9*mean[v]);
+    }
+
+    kipl::math::Covariance<float> cov;
+    QVERIFY_EXCEPTION_THROWN(cov.accumulate(data.data(),nElements),kipl::base::KiplException);
+    cov.reset(nVars);
+    QVERIFY_EXCEPTION_THROWN(cov.result(),kipl::base::KiplException);
+}
+
+void TKiplMathTest::testCovBenchmark()
+{
+    size_t dims[3]={128,128,200};
+    kipl::base::TImage<float,3> img(dims);
+
+    for (size_t i=0; i<img.Size(); ++i)
+        img[i]=static_cast<float>(sin(0.001*i)+0.01*(i % 17));
+
+    kipl::math::Covariance<float> cov;
+    TNT::Array2D<double> C;
+
+    QBENCHMARK {
+        C=cov.compute(img.GetDataPtr(),img.Dims(),3);
+    }
+}
+
 void TKiplMathTest::testMinMax()
 {
     size_t dims[]={100UL,100UL};
@@ -638,6 +1012,144 @@ void TKiplMathTest::testPolyDeriv()
 
 }
 
+void TKiplMathTest::testFastMath_enums()
+{
+    kipl::math::eMathAccuracy accuracy;
+    string2enum("exact",accuracy);
+    QCOMPARE(accuracy,kipl::math::ExactMath);
+    string2enum("precise",accuracy);
+    QCOMPARE(accuracy,kipl::math::PreciseMath);
+    string2enum("fast",accuracy);
+    QCOMPARE(accuracy,kipl::math::FastMath);
+    QCOMPARE(enum2string(kipl::math::PreciseMath),std::string("precise"));
+    QVERIFY_EXCEPTION_THROWN(string2enum("sloppy",accuracy),kipl::base::KiplException);
+
+    kipl::math::eSIMDInstructionSet set;
+    string2enum("avx2",set);
+    QCOMPARE(set,kipl::math::SIMDAVX2);
+    QCOMPARE(enum2string(kipl::math::SIMDAVX512),std::string("avx512"));
+    QVERIFY_EXCEPTION_THROWN(string2enum("mmx",set),kipl::base::KiplException);
+}
+
+void TKiplMathTest::testFastMath_accuracy()
+{
+    // Spans the full exponent range, the odd length also tests the remainder handling
+    const size_t N=100003;
+    std::vector<float> logArg(N);
+    std::vector<float> expArg(N);
+    for (size_t i=0; i<N; ++i) {
+        logArg[i]=std::pow(10.0f,-37.0f+75.0f*i/(N-1));
+        expArg[i]=-87.0f+175.0f*i/(N-1);
+    }
+
+    // Limits on the relative error
+    const std::map<kipl::math::eMathAccuracy,float> tolerance = { {kipl::math::ExactMath,   1.2e-7f},
+                                                                 {kipl::math::PreciseMath, 2.0e-7f},
+                                                                 {kipl::math::FastMath,    2.5e-5f} };
+
+    std::vector<float> res(N);
+    const kipl::math::eSIMDInstructionSet supported=kipl::math::supportedSIMDInstructionSet();
+    for (int s=kipl::math::SIMDScalar; s<=supported; ++s) {
+        QCOMPARE(kipl::math::setSIMDInstructionSet(static_cast<kipl::math::eSIMDInstructionSet>(s)),
+                 static_cast<kipl::math::eSIMDInstructionSet>(s));
+
+        for (const auto & tol : tolerance) {
+            std::ostringstream msg;
+            msg<<"set="<<static_cast<kipl::math::eSIMDInstructionSet>(s)<<", accuracy="<<tol.first;
+
+            kipl::math::logArray(logArg.data(),res.data(),N,tol.first);
+            for (size_t i=0; i<N; ++i) {
+                const double ref=std::log(static_cast<double>(logArg[i]));
+                // The absolute error is used close to log(1)=0
+                QVERIFY2(std::abs(res[i]-ref)<=tol.second*std::max(std::abs(ref),1.0),msg.str().c_str());
+            }
+
+            kipl::math::expArray(expArg.data(),res.data(),N,tol.first);
+            for (size_t i=0; i<N; ++i) {
+                const double ref=std::exp(static_cast<double>(expArg[i]));
+                QVERIFY2(std::abs(res[i]-ref)<=tol.second*ref,msg.str().c_str());
+            }
+        }
+    }
+
+    QCOMPARE(kipl::math::setSIMDInstructionSet(kipl::math::SIMDAVX512),supported);
+
+    // In place
+    std::vector<float> data(logArg);
+    kipl::math::logArray(data.data(),data.data(),N);
+    kipl::math::expArray(data.data(),data.data(),N);
+    for (size_t i=0; i<N; ++i)
+        QVERIFY(std::abs(data[i]-logArg[i])<=2e-5f*logArg[i]);
+}
+
+void TKiplMathTest::testFastMath_limits()
+{
+    const float inf=std::numeric_limits<float>::infinity();
+    const float nan=std::numeric_limits<float>::quiet_NaN();
+    const float fltmin=std::numeric_limits<float>::min();
+    const float fltmax=std::numeric_limits<float>::max();
+
+    std::vector<float> arg={0.0f, -1.0f, -inf, nan, inf, 1e-40f, 1.0f, 0.5f, fltmax};
+    std::vector<float> res(arg.size());
+
+    const kipl::math::eSIMDInstructionSet supported=kipl::math::supportedSIMDInstructionSet();
+    for (int s=kipl::math::SIMDScalar; s<=supported; ++s) {
+        kipl::math::setSIMDInstructionSet(static_cast<kipl::math::eSIMDInstructionSet>(s));
+
+        for (auto accuracy : {kipl::math::ExactMath, kipl::math::PreciseMath, kipl::math::FastMath}) {
+            kipl::math::logArray(arg.data(),res.data(),arg.size(),accuracy);
+            for (size_t i=0; i<4; ++i)
+                QVERIFY(std::abs(res[i]-std::log(fltmin))<1e-4f);
+            QVERIFY(std::abs(res[4]-std::log(fltmax))<1e-4f);
+            QVERIFY(std::abs(res[5]-std::log(fltmin))<1e-4f);
+            QCOMPARE(res[6],0.0f);
+
+            kipl::math::logArray(arg.data(),res.data(),arg.size(),accuracy,0.25f);
+            for (size_t i=0; i<4; ++i)
+                QVERIFY(std::abs(res[i]-std::log(0.25f))<1e-5f);
+            QVERIFY(std::abs(res[7]-std::log(0.5f))<1e-5f);
+
+            kipl::math::expArray(arg.data(),res.data(),arg.size(),accuracy);
+            for (size_t i=0; i<res.size(); ++i)
+                QVERIFY(std::isfinite(res[i]) && (0.0f<res[i]));
+            QVERIFY(std::abs(res[0]-1.0f)<1e-5f);
+            QVERIFY(std::abs(res[6]-std::exp(1.0f))<1e-4f);
+        }
+    }
+
+    kipl::math::setSIMDInstructionSet(supported);
+}
+
+void TKiplMathTest::testFastMath_benchmarkExact()
+{
+    benchmarkFastMath(kipl::math::ExactMath);
+}
+
+void TKiplMathTest::testFastMath_benchmarkPrecise()
+{
+    benchmarkFastMath(kipl::math::PreciseMath);
+}
+
+void TKiplMathTest::testFastMath_benchmarkFast()
+{
+    benchmarkFastMath(kipl::math::FastMath);
+}
+
+void TKiplMathTest::benchmarkFastMath(kipl::math::eMathAccuracy accuracy)
+{
+    const size_t N=1<<20;
+    std::vector<float> arg(N);
+    std::vector<float> res(N);
+    for (size_t i=0; i<N; ++i)
+        arg[i]=0.01f+static_cast<float>(i)/N;
+
+    qDebug() << "Instruction set"<<QString::fromStdString(enum2string(kipl::math::simdInstructionSet()));
+    QBENCHMARK {
+        kipl::math::logArray(arg.data(),res.data(),N,accuracy);
+        kipl::math::expArray(res.data(),res.data(),N,accuracy);
+    }
+}
+
 QTEST_APPLESS_MAIN(TKiplMathTest)
 
 #include "tst_tkiplmathtest.moc"
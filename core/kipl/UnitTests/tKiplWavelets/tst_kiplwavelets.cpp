@@ -0,0 +1,325 @@
+#include <QtTest>
+
+// add necessary includes here
+#include <cmath>
+#include <random>
+#include <string>
+#include <list>
+
+#include <base/timage.h>
+#include <base/KiplException.h>
+#include <wavelets/wavelets.h>
+#include <wavelets/liftingscheme.h>
+#include <wavelets/liftingtransform.h>
+
+class KiplWaveletsTests : public QObject
+{
+    Q_OBJECT
+
+public:
+    KiplWaveletsTests();
+    ~KiplWaveletsTests();
+
+private slots:
+    void testWaveletKernel_names();
+    void testLiftingScheme_factorization();
+    void testLiftingTransform2D_reference();
+    void testLiftingTransform2D_reconstruction();
+    void testLiftingTransform2D_subbands();
+    void testLiftingTransform3D_reconstruction();
+    void testLiftingTransform3D_constantSlices();
+    void benchmarkWaveletTransform2D();
+    void benchmarkLiftingTransform2D();
+
+private:
+    template <size_t N>
+    kipl::base::TImage<float,N> randomImage(const std::vector<size_t> &dims);
+
+    /// \returns the smallest max difference between the interior of a lifting band and a shifted reference band
+    float shiftedDifference(const kipl::base::TImage<float,2> &band,
+                            const kipl::base::TImage<float,2> &reference,
+                            int margin, int maxShift);
+};
+
+KiplWaveletsTests::KiplWaveletsTests()
+{
+
+}
+
+KiplWaveletsTests::~KiplWaveletsTests()
+{
+
+}
+
+template <size_t N>
+kipl::base::TImage<float,N> KiplWaveletsTests::randomImage(const std::vector<size_t> &dims)
+{
+    kipl::base::TImage<float,N> img(dims.data());
+    std::mt19937 generator(4711);
+    std::uniform_real_distribution<float> distribution(-1.0f,1.0f);
+
+    for (size_t i=0; i<img.Size(); ++i)
+        img[i]=100.0f+10.0f*std::sin(0.01f*i)+distribution(generator);
+
+    return img;
+}
+
+float KiplWaveletsTests::shiftedDifference(const kipl::base::TImage<float,2> &band,
+                                           const kipl::base::TImage<float,2> &reference,
+                                           int margin, int maxShift)
+{
+    float best=std::numeric_limits<float>::max();
+    const int nx=static_cast<int>(band.Size(0));
+    const int ny=static_cast<int>(band.Size(1));
+
+    for (int sy=-maxShift; sy<=maxShift; ++sy) {
+        for (int sx=-maxShift; sx<=maxShift; ++sx) {
+            for (float sign : {1.0f,-1.0f}) {
+                float diff=0.0f;
+                for (int y=margin; y<ny-margin; ++y) {
+                    const int ry=y+sy;
+                    if ((ry<0) || (static_cast<int>(reference.Size(1))<=ry))
+                        continue;
+                    for (int x=margin; x<nx-margin; ++x) {
+                        const int rx=x+sx;
+                        if ((rx<0) || (static_cast<int>(reference.Size(0))<=rx))
+                            continue;
+                        diff=std::max(diff,std::abs(band.GetLinePtr(y)[x]-sign*reference.GetLinePtr(ry)[rx]));
+                    }
+                }
+                best=std::min(best,diff);
+            }
+        }
+    }
+
+    return best;
+}
+
+void KiplWaveletsTests::testWaveletKernel_names()
+{
+    // Orthogonality of the kernels
+    std::list<std::string> names={"haar","daub2","daub3","daub4","sym4","sym8"};
+    for (const auto &name : names) {
+        kipl::wavelets::WaveletKernel<double> kernel(name);
+        const double *h=kernel.synthH()+kernel.begin();
+        const int L=kernel.size();
+        for (int shift=0; shift<L; shift+=2) {
+            double sum=0.0;
+            for (int i=0; i+shift<L; ++i)
+                sum+=h[i]*h[i+shift];
+
+            QVERIFY2(std::abs(sum-(shift==0 ? 1.0 : 0.0))<1e-12,name.c_str());
+        }
+    }
+
+    QVERIFY_EXCEPTION_THROWN(kipl::wavelets::WaveletKernel<float> kernel("nokernel"),kipl::base::KiplException);
+}
+
+void KiplWaveletsTests::testLiftingScheme_factorization()
+{
+    for (const auto &name : kipl::wavelets::LiftingScheme::NameList()) {
+        kipl::wavelets::LiftingScheme scheme(name);
+        QVERIFY2(!scheme.steps().empty(),name.c_str());
+        QVERIFY(scheme.name()==name);
+    }
+
+    // The haar wavelet gives the normalized sum and difference
+    kipl::wavelets::LiftingTransform<float,2> lt("haar");
+    kipl::base::TImage<float,2> img=randomImage<2>({8,4});
+    lt.transform(img,1);
+    kipl::base::TImage<float,2> a=lt.subband(1,0);
+    QCOMPARE(a.Size(0),4UL);
+    QCOMPARE(a.Size(1),2UL);
+    for (size_t y=0; y<a.Size(1); ++y)
+        for (size_t x=0; x<a.Size(0); ++x)
+            QVERIFY(std::abs(a(x,y)-0.5f*(img(2*x,2*y)+img(2*x+1,2*y)+img(2*x,2*y+1)+img(2*x+1,2*y+1)))<1e-4f);
+
+    QVERIFY_EXCEPTION_THROWN(kipl::wavelets::LiftingScheme scheme("daub30"),kipl::base::KiplException);
+    QVERIFY_EXCEPTION_THROWN(kipl::wavelets::LiftingScheme scheme("nokernel"),kipl::base::KiplException);
+}
+
+void KiplWaveletsTests::testLiftingTransform2D_reference()
+{
+    kipl::base::TImage<float,2> img=randomImage<2>({96,80});
+
+    for (std::string name : {"haar","daub2","daub3","daub4","daub6","sym4","sym8"}) {
+        kipl::wavelets::WaveletTransform<float> wt(name);
+        wt.transform(img,1);
+        const kipl::wavelets::WaveletQuad<float> &q=wt.data.front();
+
+        kipl::wavelets::LiftingTransform<float,2> lt(name);
+        lt.transform(img,1);
+
+        const int margin=lt.scheme().boundaryWidth()+1;
+        const int maxShift=wt.Kernel().size();
+
+        // Band 1 is high pass along x, band 2 is high pass along y
+        QVERIFY2(shiftedDifference(lt.subband(1,0),q.a,margin,maxShift)<1e-3f,name.c_str());
+        QVERIFY2(shiftedDifference(lt.subband(1,1),q.v,margin,maxShift)<1e-3f,name.c_str());
+        QVERIFY2(shiftedDifference(lt.subband(1,2),q.h,margin,maxShift)<1e-3f,name.c_str());
+        QVERIFY2(shiftedDifference(lt.subband(1,3),q.d,margin,maxShift)<1e-3f,name.c_str());
+    }
+}
+
+void KiplWaveletsTests::testLiftingTransform2D_reconstruction()
+{
+    std::list<std::vector<size_t>> sizes={{64,64},{63,37},{5,2},{128,17}};
+
+    for (const auto &name : kipl::wavelets::LiftingScheme::NameList()) {
+        kipl::wavelets::LiftingTransform<float,2> lt(name);
+        for (const auto &dims : sizes) {
+            kipl::base::TImage<float,2> img=randomImage<2>(dims);
+            const int levels = dims[1]<8 ? 1 : 3;
+            lt.transform(img,levels);
+            QCOMPARE(lt.levels(),levels);
+            QCOMPARE(lt.coefficients().Size(0),dims[0]);
+            QCOMPARE(lt.coefficients().Size(1),dims[1]);
+
+            kipl::base::TImage<float,2> res=lt.synthesize();
+            QCOMPARE(res.Size(0),dims[0]);
+            QCOMPARE(res.Size(1),dims[1]);
+
+            float diff=0.0f;
+            for (size_t i=0; i<img.Size(); ++i)
+                diff=std::max(diff,std::abs(res[i]-img[i]));
+
+            QVERIFY2(diff<1e-3f,name.c_str());
+        }
+    }
+
+    kipl::wavelets::LiftingTransform<float,2> lt("daub4");
+    kipl::base::TImage<float,2> img=randomImage<2>({16,16});
+    QVERIFY_EXCEPTION_THROWN(lt.transform(img,5),kipl::base::KiplException);
+    QVERIFY_EXCEPTION_THROWN(lt.transform(img,0),kipl::base::KiplException);
+
+    // Double precision is limited by the conditioning of the steps
+    kipl::wavelets::LiftingTransform<double,2> ltd("daub10");
+    std::vector<size_t> dims={57,64};
+    kipl::base::TImage<double,2> imgd(dims.data());
+    for (size_t i=0; i<imgd.Size(); ++i)
+        imgd[i]=std::cos(0.1*i);
+    ltd.transform(imgd,3);
+    kipl::base::TImage<double,2> resd=ltd.synthesize();
+    for (size_t i=0; i<imgd.Size(); ++i)
+        QVERIFY(std::abs(resd[i]-imgd[i])<1e-10);
+}
+
+void KiplWaveletsTests::testLiftingTransform2D_subbands()
+{
+    kipl::base::TImage<float,2> img=randomImage<2>({37,20});
+    kipl::wavelets::LiftingTransform<float,2> lt("daub2");
+    lt.transform(img,2);
+
+    size_t origin[2];
+    size_t dims[2];
+    lt.region(1,3,origin,dims);
+    QCOMPARE(origin[0],19UL);
+    QCOMPARE(origin[1],10UL);
+    QCOMPARE(dims[0],18UL);
+    QCOMPARE(dims[1],10UL);
+
+    lt.region(2,0,origin,dims);
+    QCOMPARE(origin[0],0UL);
+    QCOMPARE(origin[1],0UL);
+    QCOMPARE(dims[0],10UL);
+    QCOMPARE(dims[1],5UL);
+
+    // Removing all details gives a smooth image with the same mean
+    for (int level=1; level<=2; ++level) {
+        for (int band=1; band<4; ++band) {
+            kipl::base::TImage<float,2> detail=lt.subband(level,band);
+            detail=0.0f;
+            lt.setSubband(level,band,detail);
+        }
+    }
+
+    kipl::base::TImage<float,2> res=lt.synthesize();
+    double sumImg=0.0;
+    double sumRes=0.0;
+    for (size_t i=0; i<img.Size(); ++i) {
+        sumImg+=img[i];
+        sumRes+=res[i];
+    }
+    QVERIFY(std::abs(sumImg-sumRes)/img.Size()<1.0);
+
+    kipl::base::TImage<float,2> wrong=randomImage<2>({3,3});
+    QVERIFY_EXCEPTION_THROWN(lt.setSubband(1,1,wrong),kipl::base::KiplException);
+    QVERIFY_EXCEPTION_THROWN(lt.subband(3,1),kipl::base::KiplException);
+    QVERIFY_EXCEPTION_THROWN(lt.subband(1,4),kipl::base::KiplException);
+}
+
+void KiplWaveletsTests::testLiftingTransform3D_reconstruction()
+{
+    std::list<std::vector<size_t>> sizes={{32,32,32},{33,20,17},{4,6,2}};
+
+    for (std::string name : {"haar","daub3","daub4","sym6"}) {
+        kipl::wavelets::LiftingTransform<float,3> lt(name);
+        for (const auto &dims : sizes) {
+            kipl::base::TImage<float,3> img=randomImage<3>(dims);
+            const int levels = dims[2]<8 ? 1 : 2;
+            lt.transform(img,levels);
+
+            kipl::base::TImage<float,3> res=lt.synthesize();
+            float diff=0.0f;
+            for (size_t i=0; i<img.Size(); ++i)
+                diff=std::max(diff,std::abs(res[i]-img[i]));
+
+            QVERIFY2(diff<1e-3f,name.c_str());
+        }
+    }
+}
+
+void KiplWaveletsTests::testLiftingTransform3D_constantSlices()
+{
+    // Identical slices are constant along z, the low pass scales them by sqrt(2) and the high pass removes them
+    kipl::base::TImage<float,2> slice=randomImage<2>({40,30});
+    std::vector<size_t> dims={40,30,16};
+    kipl::base::TImage<float,3> vol(dims.data());
+    for (size_t z=0; z<dims[2]; ++z)
+        std::copy_n(slice.GetDataPtr(),slice.Size(),vol.GetLinePtr(0,z));
+
+    kipl::wavelets::LiftingTransform<float,2> lt2("daub4");
+    lt2.transform(slice,1);
+
+    kipl::wavelets::LiftingTransform<float,3> lt3("daub4");
+    lt3.transform(vol,1);
+
+    for (int band=0; band<4; ++band) {
+        kipl::base::TImage<float,2> b2=lt2.subband(1,band);
+        kipl::base::TImage<float,3> b3=lt3.subband(1,band);
+        kipl::base::TImage<float,3> b3high=lt3.subband(1,band+4);
+
+        for (size_t z=0; z<b3.Size(2); ++z) {
+            for (size_t y=0; y<b2.Size(1); ++y) {
+                for (size_t x=0; x<b2.Size(0); ++x) {
+                    QVERIFY(std::abs(b3(x,y,z)-std::sqrt(2.0f)*b2(x,y))<1e-3f);
+                    QVERIFY(std::abs(b3high(x,y,z))<1e-3f);
+                }
+            }
+        }
+    }
+}
+
+void KiplWaveletsTests::benchmarkWaveletTransform2D()
+{
+    kipl::base::TImage<float,2> img=randomImage<2>({1024,1024});
+    kipl::wavelets::WaveletTransform<float> wt("daub4");
+
+    QBENCHMARK {
+        wt.transform(img,3);
+    }
+}
+
+void KiplWaveletsTests::benchmarkLiftingTransform2D()
+{
+    kipl::base::TImage<float,2> img=randomImage<2>({1024,1024});
+    kipl::wavelets::LiftingTransform<float,2> lt("daub4");
+
+    QBENCHMARK {
+        lt.transform(img,3);
+    }
+}
+
+QTEST_APPLESS_MAIN(KiplWaveletsTests)
+
+#include "tst_kiplwavelets.moc"
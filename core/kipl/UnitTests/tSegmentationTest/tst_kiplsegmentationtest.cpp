@@ -1,5 +1,6 @@
 #include <sstream>
 #include <vector>
+#include <cmath>
 
 #include <QString>
 #include <QtTest>
@@ -8,6 +9,10 @@
 #include <io/io_tiff.h>
 #include <segmentation/thresholds.h>
 #include <segmentation/gradientguidedthreshold.h>
+#include <segmentation/fuzzymembership.h>
+#include <segmentation/fuzzykmeans.h>
+#include <segmentation/kernelfuzzykmeans.h>
+#include <math/fastmath.h>
 
 class kiplSegmentationTest : public QObject
 {
@@ -23,6 +28,14 @@ private Q_SLOTS:
     void testMultiThreshold();
     void testGradientGuidedThreshold();
     void testCmpType();
+    void testFuzzyMembership();
+    void testFuzzyKMeans();
+    void testFuzzyKMeansMiniBatchPeriodic();
+    void testKernelFuzzyKMeans();
+    void testFuzzyKMeansBenchmark();
+
+private:
+    kipl::base::TImage<float,3> threeClassVolume(size_t N, float a, float b, float c, float noise);
 };
 
 kiplSegmentationTest::kiplSegmentationTest()
@@ -181,6 +194,193 @@ void kiplSegmentationTest::testCmpType()
 
 }
 
+kipl::base::TImage<float,3> kiplSegmentationTest::threeClassVolume(size_t N, float a, float b, float c, float noise)
+{
+    size_t dims[3]={N,N,N};
+    kipl::base::TImage<float,3> img(dims);
+
+    // Three slabs along x with deterministic noise
+    for (size_t i=0; i<img.Size(); ++i) {
+        const size_t x=i % N;
+        const float level= x<N/3 ? a : (x<2*N/3 ? b : c);
+        img[i]=level+noise*std::sin(0.37f*i);
+    }
+
+    return img;
+}
+
+void kiplSegmentationTest::testFuzzyMembership()
+{
+    // The length gives full vectors and a remainder for all instruction sets
+    const size_t N=37;
+    std::vector<float> x(N);
+    for (size_t i=0; i<N; ++i)
+        x[i]=-1.0f+0.25f*i;
+    const float centers[3]={0.0f,2.0f,4.0f};
+
+    QVERIFY_EXCEPTION_THROWN(kipl::segmentation::FuzzyMembership(1,2.0f),kipl::base::KiplException);
+    QVERIFY_EXCEPTION_THROWN(kipl::segmentation::FuzzyMembership(3,1.0f),kipl::base::KiplException);
+
+    const kipl::math::eSIMDInstructionSet current=kipl::math::simdInstructionSet();
+    for (auto set : {kipl::math::SIMDScalar, kipl::math::SIMDSSE2, kipl::math::SIMDAVX2}) {
+        kipl::math::setSIMDInstructionSet(set);
+        for (auto distance : {kipl::segmentation::FuzzyEuclideanDistance, kipl::segmentation::FuzzyKernelDistance}) {
+            for (float m : {2.0f,1.5f,3.0f}) {
+                const float sigma=3.0f;
+                kipl::segmentation::FuzzyMembership membership(3,m,distance,sigma);
+                std::vector<float> u(3*N);
+                membership.memberships(x.data(),N,centers,u.data());
+
+                for (size_t i=0; i<N; ++i) {
+                    double D[3];
+                    for (size_t k=0; k<3; ++k) {
+                        const double d2=(x[i]-centers[k])*(x[i]-centers[k]);
+                        D[k]= distance==kipl::segmentation::FuzzyKernelDistance ? 1.0-std::exp(-d2/(sigma*sigma)) : d2;
+                    }
+
+                    for (size_t k=0; k<3; ++k) {
+                        double ref=1.0;
+                        if (D[k]!=0.0) {
+                            double sum=0.0;
+                            for (size_t j=0; j<3; ++j)
+                                sum+=D[j]==0.0 ? 1e30 : std::pow(D[k]/D[j],1.0/(m-1.0));
+                            ref=1.0/sum;
+                        }
+                        QVERIFY(std::abs(u[k*N+i]-ref)<1e-5);
+                    }
+                }
+
+                // The sums of a pass give the weighted means of the data
+                kipl::segmentation::FuzzyMembership::Sums sums(3);
+                membership.accumulate(x.data(),N,centers,nullptr,sums);
+                QCOMPARE(sums.count,N);
+                QCOMPARE(sums.change,0.0);
+
+                for (size_t k=0; k<3; ++k) {
+                    double w=0.0;
+                    double wx=0.0;
+                    for (size_t i=0; i<N; ++i) {
+                        const double d2=(x[i]-centers[k])*(x[i]-centers[k]);
+                        const double t=std::pow(static_cast<double>(u[k*N+i]),static_cast<double>(m))*
+                                (distance==kipl::segmentation::FuzzyKernelDistance ? std::exp(-d2/(sigma*sigma)) : 1.0);
+                        w+=t;
+                        wx+=t*x[i];
+                    }
+                    QVERIFY(std::abs(sums.weight[k]-w)<1e-4*(1.0+w));
+                    QVERIFY(std::abs(sums.weightedX[k]-wx)<1e-4*(1.0+std::abs(wx)));
+                }
+
+                kipl::segmentation::FuzzyMembership::Sums same(3);
+                membership.accumulate(x.data(),N,centers,centers,same);
+                QVERIFY(same.change<1e-10);
+            }
+        }
+    }
+    kipl::math::setSIMDInstructionSet(current);
+}
+
+void kiplSegmentationTest::testFuzzyKMeans()
+{
+    kipl::base::TImage<float,3> img=threeClassVolume(48,10.0f,50.0f,100.0f,3.0f);
+
+    for (float m : {2.0f,1.5f}) {
+        for (size_t miniBatch : {size_t(0),size_t(2000)}) {
+            kipl::segmentation::FuzzyKMeans<float,float,3> fcm;
+            fcm.set(3,m,100);
+            fcm.setMiniBatch(miniBatch);
+
+            kipl::base::TImage<float,3> seg;
+            fcm(img,seg);
+
+            const float *c=fcm.getCenters();
+            QVERIFY(std::abs(c[0]-10.0f)<1.0f);
+            QVERIFY(std::abs(c[1]-50.0f)<1.0f);
+            QVERIFY(std::abs(c[2]-100.0f)<1.0f);
+
+            for (size_t i=0; i<img.Size(); ++i) {
+                const size_t x=i % img.Size(0);
+                const float label= x<16 ? 0.0f : (x<32 ? 1.0f : 2.0f);
+                QCOMPARE(seg[i],label);
+            }
+        }
+    }
+
+    // The masked pixels are labelled nClasses and don't change the centers
+    kipl::base::TImage<bool,3> mask(img.Dims());
+    for (size_t i=0; i<img.Size(); ++i)
+        mask[i]= 16<=(i % img.Size(0));
+
+    kipl::segmentation::FuzzyKMeans<float,unsigned char,3> fcm;
+    fcm.set(2,2.0f,100);
+    kipl::base::TImage<unsigned char,3> seg;
+    fcm(img,seg,mask);
+    QVERIFY(std::abs(fcm.getCenters()[0]-50.0f)<1.0f);
+    QVERIFY(std::abs(fcm.getCenters()[1]-100.0f)<1.0f);
+    QCOMPARE(seg[0],static_cast<unsigned char>(2));
+    QCOMPARE(seg[20],static_cast<unsigned char>(0));
+    QCOMPARE(seg[40],static_cast<unsigned char>(1));
+
+    QVERIFY_EXCEPTION_THROWN(fcm(img,seg,kipl::base::TImage<bool,3>(mask.Dims())=false),kipl::base::KiplException);
+}
+
+void kiplSegmentationTest::testFuzzyKMeansMiniBatchPeriodic()
+{
+    // The period divides the row length, a sample with the row length as stride would only see one class
+    size_t dims[2]={48,200};
+    kipl::base::TImage<float,2> img(dims);
+    for (size_t i=0; i<img.Size(); ++i)
+        img[i]=10.0f*static_cast<float>(i % 3);
+
+    kipl::segmentation::FuzzyKMeans<float,float,2> fcm;
+    fcm.set(3,2.0f,100);
+    fcm.setMiniBatch(img.Size()/dims[0]);
+
+    kipl::base::TImage<float,2> seg;
+    fcm(img,seg);
+
+    const float *c=fcm.getCenters();
+    QVERIFY(std::abs(c[0]-0.0f)<0.5f);
+    QVERIFY(std::abs(c[1]-10.0f)<0.5f);
+    QVERIFY(std::abs(c[2]-20.0f)<0.5f);
+
+    for (size_t i=0; i<img.Size(); ++i)
+        QCOMPARE(seg[i],static_cast<float>(i % 3));
+}
+
+void kiplSegmentationTest::testKernelFuzzyKMeans()
+{
+    kipl::base::TImage<float,3> img=threeClassVolume(36,1.0f,4.0f,8.0f,0.3f);
+
+    kipl::segmentation::KernelFuzzyKMeans<float,short,3> kfcm;
+    kfcm.set(3,2.0f,100);
+
+    kipl::base::TImage<short,3> seg;
+    kfcm(img,seg);
+
+    const float *c=kfcm.getCenters();
+    QVERIFY(std::abs(c[0]-1.0f)<0.2f);
+    QVERIFY(std::abs(c[1]-4.0f)<0.2f);
+    QVERIFY(std::abs(c[2]-8.0f)<0.2f);
+
+    for (size_t i=0; i<img.Size(); ++i) {
+        const size_t x=i % img.Size(0);
+        QCOMPARE(seg[i],static_cast<short>(x<12 ? 0 : (x<24 ? 1 : 2)));
+    }
+}
+
+void kiplSegmentationTest::testFuzzyKMeansBenchmark()
+{
+    kipl::base::TImage<float,3> img=threeClassVolume(128,10.0f,50.0f,100.0f,5.0f);
+    kipl::base::TImage<float,3> seg;
+
+    kipl::segmentation::FuzzyKMeans<float,float,3> fcm;
+    fcm.set(3,2.0f,20);
+
+    QBENCHMARK {
+        fcm(img,seg);
+    }
+}
+
 QTEST_APPLESS_MAIN(kiplSegmentationTest)
 
 #include "tst_kiplsegmentationtest.moc"
@@ -8,6 +8,7 @@
 #include <QtTest>
 
 #include <base/thistogram.h>
+#include <base/histogramengine.h>
 #include <base/timage.h>
 #include <base/imageinfo.h>
 #include <base/tsubimage.h>
@@ -38,6 +39,11 @@ private Q_SLOTS:
 
     void testBivariateHistogram();
 
+    /// Tests for HistogramEngine
+    void testHistogramEngineFloat();
+    void testHistogramEngineInteger();
+    void testHistogramEngineBenchmark();
+
     /// Tests cropping
     void testSubImage();
 
@@ -208,6 +214,118 @@ void TkiplbasetestTest::testBivariateHistogram()
 
 }
 
+void TkiplbasetestTest::testHistogramEngineFloat()
+{
+    const size_t N=1<<20; // Several parts are processed in parallel
+    std::vector<float> data(N);
+    for (size_t i=0; i<N; ++i)
+        data[i]=static_cast<float>(100.0*sin(0.001*i)+0.25*(i % 7));
+
+    data[17]=-500.0f;
+    data[4711]=500.0f;
+    data[12]=0.0f;
+
+    const size_t nBins=100;
+    const double lo=-100.0;
+    const double hi=100.0;
+
+    for (auto outside : {kipl::base::HistogramDropOutside, kipl::base::HistogramClampOutside}) {
+        std::vector<size_t> ref(nBins,0);
+        double sum=0.0;
+        double sum2=0.0;
+        for (auto x : data) {
+            sum+=x;
+            sum2+=static_cast<double>(x)*x;
+            const float v=(x-static_cast<float>(lo))*static_cast<float>(nBins/(hi-lo));
+            if ((0<=v) && (v<nBins))
+                ref[static_cast<size_t>(v)]++;
+            else if (outside==kipl::base::HistogramClampOutside)
+                ref[v<0 ? 0 : nBins-1]++;
+        }
+
+        kipl::base::HistogramEngine<float> engine(nBins,lo,hi,outside);
+        engine.put(data.data(),N);
+
+        QCOMPARE(engine.histogram().size(),nBins);
+        for (size_t i=0; i<nBins; ++i)
+            QCOMPARE(engine.histogram()[i],ref[i]);
+
+        kipl::math::Statistics stats=engine.statistics();
+        QCOMPARE(stats.n(),N);
+        QCOMPARE(stats.Min(),-500.0);
+        QCOMPARE(stats.Max(),500.0);
+        QVERIFY(std::abs(stats.E()-sum/N)<1e-9);
+        QVERIFY(std::abs(stats.V()-(sum2-sum*sum/N)/N)<1e-6*stats.V());
+
+        // Streaming the same data in uneven blocks gives the same result
+        kipl::base::HistogramEngine<float> stream(nBins,lo,hi,outside);
+        for (size_t offset=0; offset<N; offset+=99991)
+            stream.put(data.data()+offset,std::min(size_t(99991),N-offset));
+
+        for (size_t i=0; i<nBins; ++i)
+            QCOMPARE(stream.histogram()[i],ref[i]);
+        QCOMPARE(stream.statistics().n(),N);
+        QCOMPARE(stream.statistics().Min(),-500.0);
+    }
+
+    kipl::base::HistogramEngine<float> noZeros(nBins,lo,hi);
+    noZeros.setIgnoreZeros(true);
+    noZeros.put(data.data(),N);
+    QCOMPARE(noZeros.statistics().n(),N-size_t(std::count(data.begin(),data.end(),0.0f)));
+
+    std::vector<float> axis=noZeros.axis();
+    QCOMPARE(axis.size(),nBins);
+    QCOMPARE(axis[0],-99.0f);
+    QCOMPARE(axis[nBins-1],99.0f);
+
+    kipl::math::Statistics stats=kipl::base::HistogramEngine<float>::statistics(data.data(),N);
+    QCOMPARE(stats.n(),N);
+    QCOMPARE(stats.Max(),500.0);
+
+    QVERIFY_EXCEPTION_THROWN(kipl::base::HistogramEngine<float>(10,1.0,1.0),kipl::base::KiplException);
+}
+
+void TkiplbasetestTest::testHistogramEngineInteger()
+{
+    const size_t N=1<<20;
+    std::vector<unsigned short> data(N);
+    for (size_t i=0; i<N; ++i)
+        data[i]=static_cast<unsigned short>((i/64) % 300); // Long runs of equal values
+
+    // One bin per gray level uses the sub-histograms, many bins the plain counting
+    for (size_t nBins : {size_t(256), size_t(4096)}) {
+        std::vector<size_t> ref(nBins,0);
+        const double width=256.0/nBins;
+        for (auto x : data)
+            if (x<256)
+                ref[static_cast<size_t>(x/width)]++;
+
+        kipl::base::HistogramEngine<unsigned short> engine(nBins,0.0,256.0);
+        engine.put(data.data(),N);
+
+        for (size_t i=0; i<nBins; ++i)
+            QCOMPARE(engine.histogram()[i],ref[i]);
+
+        QCOMPARE(engine.statistics().Min(),0.0);
+        QCOMPARE(engine.statistics().Max(),299.0);
+    }
+}
+
+void TkiplbasetestTest::testHistogramEngineBenchmark()
+{
+    size_t dims[3]={512,512,64};
+    kipl::base::TImage<float,3> img(dims);
+    for (size_t i=0; i<img.Size(); ++i)
+        img[i]=static_cast<float>(i % 65536);
+
+    kipl::base::HistogramEngine<float> engine(1024,0.0,65536.0);
+
+    QBENCHMARK {
+        engine.reset();
+        engine.put(img);
+    }
+}
+
 void TkiplbasetestTest::testSubImage()
 {
     std::ostringstream msg;
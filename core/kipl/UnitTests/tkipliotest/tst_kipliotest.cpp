@@ -1,5 +1,6 @@
 #include <vector>
 #include <string>
+#include <fstream>
 #include <limits>
 
 #include <QString>
@@ -10,10 +11,17 @@
 #include <io/io_fits.h>
 #include <io/DirAnalyzer.h>
 #include <io/io_vivaseq.h>
+#include <io/mappedsequencereader.h>
 #include <io/io_tiff.h>
 #include <strings/filenames.h>
 #include <io/io_stack.h>
 #include <io/analyzefileext.h>
+#include <io/nexusreader.h>
+#include <io/nexuswriter.h>
+#include <profile/Timer.h>
+#ifdef HAVE_NEXUS
+#include <io/io_nexus.h>
+#endif
 
 class kiplIOTest : public QObject
 {
@@ -24,6 +32,8 @@ public:
 
 private:
     void MakeFiles(std::string mask, int N, int first=0);
+    void WriteTIFF16(const kipl::base::TImage<unsigned short,2> &img, const char *fname, int rowsPerStrip, int tileSize=0);
+    void ReadTIFFScanlines(kipl::base::TImage<float,2> &img, const char *fname, size_t const *crop);
     QDir dir;
 private Q_SLOTS:
 
@@ -31,11 +41,17 @@ private Q_SLOTS:
     void testCroppedFITSreading();
     void testSEQHeader();
     void testSEQRead();
+    void testMappedSequenceReader();
     void testTIFFBasicReadWrite();
     void testTIFFMultiFrame();
     void testTIFF32();
     void testTIFFclamp();
+    void testTIFFCroppedRead();
+    void benchmarkTIFFCroppedRead();
     void testIOStack_enums();
+    void testNexusReader();
+    void testNexusVolumeWriter();
+    void benchmarkNexusVolumeWriter();
 };
 
 kiplIOTest::kiplIOTest()
@@ -121,6 +137,92 @@ void kiplIOTest::testSEQRead()
 
 }
 
+void kiplIOTest::testMappedSequenceReader()
+{
+    const size_t nx=37, ny=23, nFrames=9;
+    kipl::io::ViVaSEQHeader header;
+    header.imageWidth     = nx;
+    header.imageHeight    = ny;
+    header.bytesPerPixel  = 2;
+    header.numberOfFrames = nFrames;
+
+    std::vector<unsigned short> data(nx*ny*nFrames);
+    for (size_t i=0; i<data.size(); ++i)
+        data[i]=static_cast<unsigned short>((i*7919) & 0xffff);
+
+    {
+        std::ofstream file("mapped.seq",std::ios::binary);
+        file.write(reinterpret_cast<char *>(&header),sizeof(header));
+        file.write(reinterpret_cast<char *>(data.data()),data.size()*sizeof(unsigned short));
+    }
+
+    kipl::io::MappedSequenceReader reader;
+    reader.openSEQ("mapped.seq");
+
+    size_t dims[3];
+    reader.getDims(dims);
+    QCOMPARE(dims[0],nx);
+    QCOMPARE(dims[1],ny);
+    QCOMPARE(dims[2],nFrames);
+
+    kipl::base::TImage<float,2> frame;
+    reader.read(frame,4);
+    QCOMPARE(frame.Size(0),nx);
+    QCOMPARE(frame.Size(1),ny);
+    for (size_t i=0; i<frame.Size(); ++i)
+        QCOMPARE(frame[i],static_cast<float>(data[4*nx*ny+i]));
+
+    size_t roi[4]={3,5,30,17};
+    reader.read(frame,8,roi);
+    QCOMPARE(frame.Size(0),roi[2]-roi[0]);
+    QCOMPARE(frame.Size(1),roi[3]-roi[1]);
+    for (size_t y=roi[1]; y<roi[3]; ++y)
+        for (size_t x=roi[0]; x<roi[2]; ++x)
+            QCOMPARE(frame(x-roi[0],y-roi[1]),static_cast<float>(data[(8*ny+y)*nx+x]));
+
+    kipl::base::TImage<float,3> volume;
+    reader.read(volume,1,nFrames,3,roi);
+    QCOMPARE(volume.Size(2),size_t(3));
+    for (size_t z=0; z<volume.Size(2); ++z)
+        for (size_t y=roi[1]; y<roi[3]; ++y) {
+            const float *pLine=volume.GetLinePtr(y-roi[1],z);
+            for (size_t x=roi[0]; x<roi[2]; ++x)
+                QCOMPARE(pLine[x-roi[0]],static_cast<float>(data[((1+3*z)*ny+y)*nx+x]));
+        }
+
+    QVERIFY_EXCEPTION_THROWN(reader.read(frame,nFrames),kipl::base::KiplException);
+    size_t badroi[4]={0,0,nx+1,ny};
+    QVERIFY_EXCEPTION_THROWN(reader.read(frame,0,badroi),kipl::base::KiplException);
+
+    // The file functions use the same reader
+    kipl::io::ReadViVaSEQ("mapped.seq",volume,roi);
+    QCOMPARE(volume.Size(0),roi[2]-roi[0]);
+    QCOMPARE(volume.Size(1),roi[3]-roi[1]);
+    QCOMPARE(volume.Size(2),nFrames);
+    QCOMPARE(volume.GetLinePtr(2,6)[4],static_cast<float>(data[(6*ny+roi[1]+2)*nx+roi[0]+4]));
+
+    // Raw 8 bit frames with a file header and gaps between the frames
+    const size_t headerSize=100, frameGap=16;
+    std::vector<unsigned char> raw(headerSize+nFrames*(nx*ny+frameGap)-frameGap);
+    for (size_t i=0; i<raw.size(); ++i)
+        raw[i]=static_cast<unsigned char>(i*31);
+
+    {
+        std::ofstream file("mapped.raw",std::ios::binary);
+        file.write(reinterpret_cast<char *>(raw.data()),raw.size());
+    }
+
+    reader.openRaw("mapped.raw",dims,kipl::base::UInt8,headerSize,frameGap);
+    QCOMPARE(reader.numberOfFrames(),nFrames);
+    reader.read(frame,nFrames-1,roi);
+    for (size_t y=roi[1]; y<roi[3]; ++y)
+        for (size_t x=roi[0]; x<roi[2]; ++x)
+            QCOMPARE(frame(x-roi[0],y-roi[1]),static_cast<float>(raw[headerSize+(nFrames-1)*(nx*ny+frameGap)+y*nx+x]));
+
+    reader.close();
+    QVERIFY(!reader.isOpen());
+}
+
 void kiplIOTest::testTIFFBasicReadWrite()
 {
     size_t dims[2]={100,50};
@@ -351,6 +453,139 @@ void kiplIOTest::testTIFFclamp()
 
 }
 
+void kiplIOTest::WriteTIFF16(const kipl::base::TImage<unsigned short,2> &img, const char *fname, int rowsPerStrip, int tileSize)
+{
+    TIFF *image=TIFFOpen(fname,"w");
+    QVERIFY(image!=nullptr);
+
+    TIFFSetField(image, TIFFTAG_IMAGEWIDTH,      static_cast<uint32>(img.Size(0)));
+    TIFFSetField(image, TIFFTAG_IMAGELENGTH,     static_cast<uint32>(img.Size(1)));
+    TIFFSetField(image, TIFFTAG_BITSPERSAMPLE,   16);
+    TIFFSetField(image, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField(image, TIFFTAG_SAMPLEFORMAT,    SAMPLEFORMAT_UINT);
+    TIFFSetField(image, TIFFTAG_PHOTOMETRIC,     PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(image, TIFFTAG_PLANARCONFIG,    PLANARCONFIG_CONTIG);
+    TIFFSetField(image, TIFFTAG_COMPRESSION,     COMPRESSION_NONE);
+
+    if (tileSize!=0) {
+        TIFFSetField(image, TIFFTAG_TILEWIDTH,  tileSize);
+        TIFFSetField(image, TIFFTAG_TILELENGTH, tileSize);
+        std::vector<unsigned short> tile(tileSize*tileSize);
+        for (size_t ty=0; ty<img.Size(1); ty+=tileSize)
+            for (size_t tx=0; tx<img.Size(0); tx+=tileSize) {
+                std::fill(tile.begin(),tile.end(),0);
+                for (size_t y=0; (y<static_cast<size_t>(tileSize)) && (ty+y<img.Size(1)); ++y)
+                    for (size_t x=0; (x<static_cast<size_t>(tileSize)) && (tx+x<img.Size(0)); ++x)
+                        tile[y*tileSize+x]=img.GetLinePtr(ty+y)[tx+x];
+                TIFFWriteTile(image,tile.data(),tx,ty,0,0);
+            }
+    }
+    else {
+        TIFFSetField(image, TIFFTAG_ROWSPERSTRIP, rowsPerStrip);
+        for (size_t y=0; y<img.Size(1); ++y)
+            TIFFWriteScanline(image,const_cast<unsigned short *>(img.GetLinePtr(y)),y,0);
+    }
+
+    TIFFClose(image);
+}
+
+void kiplIOTest::ReadTIFFScanlines(kipl::base::TImage<float,2> &img, const char *fname, size_t const *crop)
+{
+    // Reference with the row by row reading that was used for cropped images before the bulk strip reading
+    TIFF *image=TIFFOpen(fname,"r");
+    QVERIFY(image!=nullptr);
+
+    size_t dims[2]={crop[2]-crop[0],crop[3]-crop[1]};
+    img.Resize(dims);
+    std::vector<unsigned char> buffer(TIFFScanlineSize(image));
+
+    for (size_t row=crop[1]; row<crop[3]; ++row) {
+        TIFFReadScanline(image,buffer.data(),row,0);
+        uint16 bps=0;
+        TIFFGetField(image, TIFFTAG_BITSPERSAMPLE, &bps);
+        float *pLine=img.GetLinePtr(row-crop[1]);
+        switch (bps) {
+        case 16:
+            for (size_t i=crop[0]; i<crop[2]; ++i)
+                pLine[i-crop[0]]=reinterpret_cast<unsigned short *>(buffer.data())[i];
+            break;
+        default:
+            break;
+        }
+    }
+
+    TIFFClose(image);
+}
+
+void kiplIOTest::testTIFFCroppedRead()
+{
+    size_t dims[2]={301,203};
+    kipl::base::TImage<unsigned short,2> ref(dims);
+    for (size_t i=0; i<ref.Size(); ++i)
+        ref[i]=static_cast<unsigned short>((i*7919) % 65536);
+
+    const size_t crops[4][4]={{0,0,301,203},{10,20,50,21},{100,0,101,203},{17,33,290,199}};
+    const int layouts[4][2]={{1,0},{7,0},{203,0},{0,64}}; // Rows per strip, tile size
+
+    kipl::base::TImage<float,2> img;
+    for (const auto &layout : layouts) {
+        WriteTIFF16(ref,"tiffcrop.tif",layout[0],layout[1]);
+
+        for (const auto &crop : crops) {
+            kipl::io::ReadTIFF(img,"tiffcrop.tif",crop);
+            QCOMPARE(img.Size(0),crop[2]-crop[0]);
+            QCOMPARE(img.Size(1),crop[3]-crop[1]);
+
+            for (size_t y=0; y<img.Size(1); ++y)
+                for (size_t x=0; x<img.Size(0); ++x)
+                    QCOMPARE(img(x,y),static_cast<float>(ref(x+crop[0],y+crop[1])));
+        }
+    }
+
+    size_t emptycrop[4]={5,5,5,10};
+    QVERIFY_EXCEPTION_THROWN(kipl::io::ReadTIFF(img,"tiffcrop.tif",emptycrop),kipl::base::KiplException);
+}
+
+void kiplIOTest::benchmarkTIFFCroppedRead()
+{
+    size_t dims[2]={2048,2048};
+    kipl::base::TImage<unsigned short,2> ref(dims);
+    for (size_t i=0; i<ref.Size(); ++i)
+        ref[i]=static_cast<unsigned short>(i % 65536);
+
+    const size_t crops[3][4]={{0,0,2048,2048},{0,1000,2048,1016},{1000,0,1064,2048}};
+    const int N=20;
+    kipl::profile::Timer timer;
+    kipl::base::TImage<float,2> img, refimg;
+
+    for (int rowsPerStrip : {2048,8}) {
+        WriteTIFF16(ref,"tiffbenchmark.tif",rowsPerStrip);
+
+        for (const auto &crop : crops) {
+            timer.reset();
+            timer.Tic();
+            for (int i=0; i<N; ++i)
+                ReadTIFFScanlines(refimg,"tiffbenchmark.tif",crop);
+            timer.Toc();
+            const double tScanline=timer.elapsedTime()/N;
+
+            timer.reset();
+            timer.Tic();
+            for (int i=0; i<N; ++i)
+                kipl::io::ReadTIFF(img,"tiffbenchmark.tif",crop);
+            timer.Toc();
+            const double tBulk=timer.elapsedTime()/N;
+
+            qDebug() << "Rows per strip" << rowsPerStrip << "crop" << crop[2]-crop[0] << "x" << crop[3]-crop[1]
+                     << ": scanlines" << tScanline << "ms, strips" << tBulk << "ms";
+
+            QCOMPARE(img.Size(),refimg.Size());
+            for (size_t i=0; i<img.Size(); ++i)
+                QCOMPARE(img[i],refimg[i]);
+        }
+    }
+}
+
 void kiplIOTest::testIOStack_enums()
 {
     kipl::io::eFileType ft;
@@ -403,6 +638,158 @@ void kiplIOTest::testIOStack_enums()
 
 }
 
+void kiplIOTest::testNexusReader()
+{
+    kipl::io::NexusReader reader;
+    QVERIFY(reader.isOpen()==false);
+    QVERIFY_EXCEPTION_THROWN(reader.open("no_such_file.hdf"),kipl::base::KiplException);
+
+#ifdef HAVE_NEXUS
+    size_t dims[3]={20,15,7};
+    kipl::base::TImage<unsigned short,3> img(dims);
+    for (size_t i=0; i<img.Size(); ++i)
+        img[i]=static_cast<unsigned short>(i % 60000);
+
+    kipl::io::WriteNexus16bits(img,"nexusreader.hdf",static_cast<unsigned short>(0),static_cast<unsigned short>(65535),0.1f);
+
+    reader.open("nexusreader.hdf");
+    QVERIFY(reader.isOpen());
+    QCOMPARE(reader.dataType(),std::string("uint16"));
+
+    size_t nexusdims[3];
+    reader.getDims(nexusdims);
+    QCOMPARE(nexusdims[0],dims[0]);
+    QCOMPARE(nexusdims[1],dims[1]);
+    QCOMPARE(nexusdims[2],dims[2]);
+
+    kipl::base::TImage<float,2> proj;
+    size_t crop[4]={2,3,12,9};
+    reader.read(proj,4,crop);
+    QCOMPARE(proj.Size(0),crop[2]-crop[0]);
+    QCOMPARE(proj.Size(1),crop[3]-crop[1]);
+    for (size_t y=0; y<proj.Size(1); ++y)
+        for (size_t x=0; x<proj.Size(0); ++x)
+            QCOMPARE(proj(x,y),static_cast<float>(img.GetLinePtr(y+crop[1],4)[x+crop[0]]));
+
+    kipl::base::TImage<float,3> stack;
+    reader.read(stack,2,7);
+    QCOMPARE(stack.Size(2),size_t(5));
+    unsigned short *pImg=img.GetLinePtr(0,2);
+    for (size_t i=0; i<stack.Size(); ++i)
+        QCOMPARE(stack[i],static_cast<float>(pImg[i]));
+
+    QVERIFY_EXCEPTION_THROWN(reader.read(stack,5,8),kipl::base::KiplException);
+    reader.close();
+    QVERIFY(reader.isOpen()==false);
+#endif
+}
+
+void kiplIOTest::testNexusVolumeWriter()
+{
+    kipl::io::NexusVolumeWriter writer;
+    QVERIFY(writer.isOpen()==false);
+
+    size_t dims[3]={37,29,0};
+    kipl::base::TImage<float,3> img;
+#ifdef HAVE_NEXUS
+    const kipl::io::NexusVolumeWriter::eCompression modes[3]={kipl::io::NexusVolumeWriter::CompressionNone,
+                                                              kipl::io::NexusVolumeWriter::CompressionDeflate,
+                                                              kipl::io::NexusVolumeWriter::CompressionShuffleDeflate};
+    size_t blockdims[3]={dims[0],dims[1],4};
+    kipl::base::TImage<float,3> block(blockdims);
+
+    for (auto mode : modes) {
+        writer.create("nexuswriter.hdf",dims,0.1f,mode,3);
+        QVERIFY(writer.isOpen());
+        QVERIFY_EXCEPTION_THROWN(writer.create("nexuswriter.hdf",dims,0.1f),kipl::base::KiplException);
+
+        // The blocks are written out of order to check that the data set grows
+        for (size_t b : {3,0,2,1}) {
+            for (size_t i=0; i<block.Size(); ++i)
+                block[i]= (i % 11) == 0 ? static_cast<float>(b*block.Size()+i) : 0.5f*static_cast<float>(i % 7);
+            writer.write(block,b*blockdims[2]);
+        }
+        writer.close();
+        QVERIFY(writer.isOpen()==false);
+        QCOMPARE(writer.writtenSlices(),size_t(16));
+
+        kipl::io::NexusReader reader("nexuswriter.hdf");
+        QCOMPARE(reader.dataType(),std::string("float32"));
+        size_t nexusdims[3];
+        reader.getDims(nexusdims);
+        QCOMPARE(nexusdims[0],dims[0]);
+        QCOMPARE(nexusdims[1],dims[1]);
+        QCOMPARE(nexusdims[2],size_t(16));
+
+        reader.read(img,0,16);
+        for (size_t i=0; i<img.Size(); ++i) {
+            const size_t b=i/block.Size();
+            const size_t j=i%block.Size();
+            QCOMPARE(img[i],(j % 11) == 0 ? static_cast<float>(b*block.Size()+j) : 0.5f*static_cast<float>(j % 7));
+        }
+    }
+#else
+    QVERIFY_EXCEPTION_THROWN(writer.create("nexuswriter.hdf",dims,0.1f),kipl::base::KiplException);
+    QVERIFY_EXCEPTION_THROWN(writer.append(img),kipl::base::KiplException);
+#endif
+}
+
+void kiplIOTest::benchmarkNexusVolumeWriter()
+{
+#ifdef HAVE_NEXUS
+    size_t dims[3]={512,512,128};
+    const size_t nBlock=16;
+    kipl::base::TImage<float,3> img(dims);
+
+    // A smooth object with noise, compresses like a reconstructed slice
+    for (size_t z=0; z<dims[2]; ++z)
+        for (size_t y=0; y<dims[1]; ++y) {
+            float *pLine=img.GetLinePtr(y,z);
+            for (size_t x=0; x<dims[0]; ++x) {
+                const float r2=(x-256.0f)*(x-256.0f)+(y-256.0f)*(y-256.0f);
+                pLine[x]=(r2<200.0f*200.0f ? 0.02f : 0.0f) + 0.001f*static_cast<float>((x*7919+y*104729+z*1299709) % 1000)/1000.0f;
+            }
+        }
+
+    const double MBytes=static_cast<double>(img.Size()*sizeof(float))/(1024.0*1024.0);
+    kipl::profile::Timer timer;
+
+    timer.Tic();
+    kipl::io::WriteImageStack(img,"benchmark_####.tif",0.0f,0.0f,0,dims[2],0,kipl::io::TIFFfloat,kipl::base::ImagePlaneXY);
+    timer.Toc();
+    const double tTIFF=timer.elapsedTime(kipl::profile::Timer::seconds);
+    qDebug() << "TIFF float stack:" << MBytes/tTIFF << "MB/s";
+
+    size_t blockdims[3]={dims[0],dims[1],nBlock};
+    kipl::base::TImage<float,3> block(blockdims);
+    const kipl::io::NexusVolumeWriter::eCompression modes[3]={kipl::io::NexusVolumeWriter::CompressionNone,
+                                                              kipl::io::NexusVolumeWriter::CompressionDeflate,
+                                                              kipl::io::NexusVolumeWriter::CompressionShuffleDeflate};
+    const char *names[3]={"none","deflate","shuffle+deflate"};
+
+    for (size_t m=0; m<3; ++m) {
+        kipl::io::NexusVolumeWriter writer;
+        size_t nexusdims[3]={dims[0],dims[1],0};
+
+        timer.reset();
+        timer.Tic();
+        writer.create("benchmark.hdf",nexusdims,0.1f,modes[m]);
+        for (size_t z=0; z<dims[2]; z+=nBlock) {
+            std::copy_n(img.GetLinePtr(0,z),block.Size(),block.GetDataPtr());
+            writer.append(block);
+        }
+        writer.close();
+        timer.Toc();
+
+        const double t=timer.elapsedTime(kipl::profile::Timer::seconds);
+        qDebug() << "NeXus" << names[m] << ":" << MBytes/t << "MB/s, compression ratio" << writer.compressionRatio();
+        QCOMPARE(writer.writtenSlices(),dims[2]);
+    }
+#else
+    QSKIP("NeXus support is not available");
+#endif
+}
+
 QTEST_APPLESS_MAIN(kiplIOTest)
 
 #include "tst_kipliotest.moc"
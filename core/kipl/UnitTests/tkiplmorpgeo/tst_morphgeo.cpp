@@ -3,6 +3,8 @@
 // add necessary includes here
 #include <QDebug>
 #include <sstream>
+#include <cmath>
+#include <limits>
 
 #include <base/timage.h>
 #include <base/KiplException.h>
@@ -10,6 +12,7 @@
 #include <morphology/morphology.h>
 #include <morphology/morphgeo.h>
 #include <morphology/morphextrema.h>
+#include <morphology/morphreconstruction.h>
 #include <io/io_tiff.h>
 
 class morphgeo : public QObject
@@ -45,6 +48,13 @@ private slots:
     void testFillPeaksTransposedTiming();
     void testFillPeaksTiming();
     void testFillPeaks();
+    void testReconstructByErosion();
+    void testReconstructByDilation();
+    void testFastFillHole();
+    void testFastFillPeaks();
+    void testFastFillExtremaUInt16();
+    void testFillHoleAndPeaks();
+    void testFillHoleAndPeaksNaN();
     //void testFillExtrema();
 };
 
@@ -488,6 +498,232 @@ void morphgeo::testFillPeaksTiming()
     }
 }
 
+void morphgeo::testReconstructByErosion()
+{
+    kipl::base::TImage<float,2> img2;
+    img2.Clone(img);
+    img2+=1.0f;
+
+    kipl::base::TImage<float,2> ref,dev;
+    ref=kipl::morphology::old::RecByErosion(img,img2,kipl::morphology::conn8);
+
+    QBENCHMARK
+    {
+        dev.Clone(img2);
+        kipl::morphology::ReconstructByErosion(dev,img,kipl::base::conn8);
+    }
+
+    QCOMPARE(ref.Size(),dev.Size());
+    size_t cnt=0;
+    for (size_t i=0; i<ref.Size(); ++i)
+    {
+        if (ref[i]!=dev[i])
+            cnt++;
+    }
+
+    QCOMPARE(cnt,0UL);
+
+    QVERIFY_EXCEPTION_THROWN(kipl::morphology::ReconstructByErosion(img,img2,kipl::base::conn8),kipl::base::KiplException);
+}
+
+void morphgeo::testReconstructByDilation()
+{
+    kipl::base::TImage<float,2> img2;
+    img2.Clone(img);
+    img2+=1.0f;
+
+    kipl::base::TImage<float,2> ref,dev;
+    ref=kipl::morphology::old::RecByDilation(img2,img,kipl::morphology::conn8);
+
+    QBENCHMARK
+    {
+        dev.Clone(img);
+        kipl::morphology::ReconstructByDilation(dev,img2,kipl::base::conn8);
+    }
+
+    QCOMPARE(ref.Size(),dev.Size());
+    size_t cnt=0;
+    for (size_t i=0; i<ref.Size(); ++i)
+    {
+        if (ref[i]!=dev[i])
+            cnt++;
+    }
+
+    QCOMPARE(cnt,0UL);
+}
+
+void morphgeo::testFastFillHole()
+{
+    loadData();
+    for (auto conn : {kipl::base::conn4, kipl::base::conn8})
+    {
+        kipl::base::TImage<float,2> ref,dev;
+
+        ref=kipl::morphology::FillHole(img,conn);
+
+        QBENCHMARK
+        {
+            dev=kipl::morphology::FastFillHole(img,conn);
+        }
+
+        QCOMPARE(ref.Size(),dev.Size());
+        size_t cnt=0;
+        for (size_t i=0; i<ref.Size(); ++i)
+        {
+            if (ref[i]!=dev[i])
+                cnt++;
+        }
+
+        QCOMPARE(cnt,0UL);
+    }
+}
+
+void morphgeo::testFastFillPeaks()
+{
+    loadData();
+    for (auto conn : {kipl::base::conn4, kipl::base::conn8})
+    {
+        kipl::base::TImage<float,2> ref,dev;
+
+        ref=kipl::morphology::FillPeaks(img,conn);
+
+        QBENCHMARK
+        {
+            dev=kipl::morphology::FastFillPeaks(img,conn);
+        }
+
+        QCOMPARE(ref.Size(),dev.Size());
+        size_t cnt=0;
+        for (size_t i=0; i<ref.Size(); ++i)
+        {
+            if (ref[i]!=dev[i])
+                cnt++;
+        }
+
+        QCOMPARE(cnt,0UL);
+    }
+}
+
+void morphgeo::testFastFillExtremaUInt16()
+{
+    loadData();
+
+    float minval=img[0];
+    float maxval=img[0];
+    for (size_t i=0; i<img.Size(); ++i)
+    {
+        minval=std::min(minval,img[i]);
+        maxval=std::max(maxval,img[i]);
+    }
+
+    kipl::base::TImage<unsigned short,2> input(img.Dims());
+    for (size_t i=0; i<img.Size(); ++i)
+        input[i]=static_cast<unsigned short>(4095.0f*(img[i]-minval)/(maxval-minval));
+
+    kipl::base::TImage<unsigned short,2> ref,dev;
+    ref=kipl::morphology::FillHole(input,kipl::base::conn8);
+    QBENCHMARK
+    {
+        dev=kipl::morphology::FastFillHole(input,kipl::base::conn8);
+    }
+
+    size_t cnt=0;
+    for (size_t i=0; i<ref.Size(); ++i)
+    {
+        if (ref[i]!=dev[i])
+            cnt++;
+    }
+    QCOMPARE(cnt,0UL);
+
+    ref=kipl::morphology::FillPeaks(input,kipl::base::conn8);
+    dev=kipl::morphology::FastFillPeaks(input,kipl::base::conn8);
+
+    cnt=0;
+    for (size_t i=0; i<ref.Size(); ++i)
+    {
+        if (ref[i]!=dev[i])
+            cnt++;
+    }
+    QCOMPARE(cnt,0UL);
+}
+
+void morphgeo::testFillHoleAndPeaks()
+{
+    loadData();
+    kipl::base::TImage<float,2> refHoles, refPeaks, devHoles, devPeaks;
+
+    refHoles=kipl::morphology::FillHole(img,kipl::base::conn8);
+    refPeaks=kipl::morphology::FillPeaks(img,kipl::base::conn8);
+
+    QBENCHMARK
+    {
+        kipl::morphology::FillHoleAndPeaks(img,devHoles,devPeaks,kipl::base::conn8);
+    }
+
+    QCOMPARE(refHoles.Size(),devHoles.Size());
+    QCOMPARE(refPeaks.Size(),devPeaks.Size());
+    size_t cntHoles=0;
+    size_t cntPeaks=0;
+    for (size_t i=0; i<refHoles.Size(); ++i)
+    {
+        if (refHoles[i]!=devHoles[i])
+            cntHoles++;
+        if (refPeaks[i]!=devPeaks[i])
+            cntPeaks++;
+    }
+
+    QCOMPARE(cntHoles,0UL);
+    QCOMPARE(cntPeaks,0UL);
+}
+
+void morphgeo::testFillHoleAndPeaksNaN()
+{
+    // A pit in a plateau and a peak on a flat background with NaN pixels on the edge and inside
+    size_t dims[2]={9,9};
+    kipl::base::TImage<float,2> src(dims);
+    src=2.0f;
+    for (int y=2; y<5; ++y)
+        for (int x=2; x<5; ++x)
+            src(x,y)=5.0f;
+    src(3,3)=1.0f;
+    src(6,6)=9.0f;
+
+    const float nan=std::numeric_limits<float>::quiet_NaN();
+    src(0,0)=nan;
+    src(6,2)=nan;
+
+    kipl::base::TImage<float,2> holes, peaks;
+    kipl::morphology::FillHoleAndPeaks(src,holes,peaks,kipl::base::conn8);
+
+    kipl::base::TImage<float,2> fastHoles=kipl::morphology::FastFillHole(src,kipl::base::conn8);
+    kipl::base::TImage<float,2> fastPeaks=kipl::morphology::FastFillPeaks(src,kipl::base::conn8);
+
+    // The pit is filled to the level of its rim, the peak and the rim are levelled to the background
+    kipl::base::TImage<float,2> expHoles=src, expPeaks=src;
+    expHoles.Clone();
+    expPeaks.Clone();
+    expHoles(3,3)=5.0f;
+    for (int y=2; y<5; ++y)
+        for (int x=2; x<5; ++x)
+            expPeaks(x,y)=2.0f;
+    expPeaks(3,3)=1.0f;
+    expPeaks(6,6)=2.0f;
+
+    for (size_t i=0; i<src.Size(); ++i)
+    {
+        if (std::isnan(src[i]))
+        {
+            QVERIFY(std::isnan(holes[i]) && std::isnan(peaks[i]));
+            QVERIFY(std::isnan(fastHoles[i]) && std::isnan(fastPeaks[i]));
+            continue;
+        }
+        QCOMPARE(holes[i],expHoles[i]);
+        QCOMPARE(peaks[i],expPeaks[i]);
+        QCOMPARE(fastHoles[i],holes[i]);
+        QCOMPARE(fastPeaks[i],peaks[i]);
+    }
+}
+
 QTEST_APPLESS_MAIN(morphgeo)
 
 #include "tst_morphgeo.moc"
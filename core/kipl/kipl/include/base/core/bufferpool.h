@@ -0,0 +1,93 @@
+//<LICENCE>
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include "../../kipl_global.h"
+
+#include <cstddef>
+
+namespace kipl { namespace base { namespace core {
+
+/// \brief Counters of the image buffer pool
+struct BufferPoolStatistics {
+    size_t requests;            ///< Allocations served by the pool
+    size_t threadCacheHits;     ///< Allocations served from the cache of the calling thread
+    size_t sharedCacheHits;     ///< Allocations served from the shared free lists
+    size_t remoteHits;          ///< Shared hits that took a block of another memory node
+    size_t systemAllocations;   ///< Allocations that needed new memory from the system
+    size_t bypassed;            ///< Allocations larger than the largest size class, these are not pooled
+    size_t releases;            ///< Blocks given back to the pool
+    size_t systemReleases;      ///< Blocks given back to the system when a cache was full or trimmed
+    size_t bytesInUse;          ///< Bytes in pooled blocks owned by buffers
+    size_t bytesCached;         ///< Bytes in free blocks held by the pool
+    size_t peakBytesCached;     ///< Largest number of bytes in the shared free lists
+};
+
+/// \brief A pool for the memory of image buffers with size classes and caches per thread.
+///
+/// The pool is opt-in, buffer allocates with _mm_malloc unless the pool is enabled. Processing chains that create and
+/// drop temporaries of the same size for each projection or iteration then reuse the memory instead of going to the
+/// system allocator, which avoids the lock contention of the allocator and the page faults of fresh memory.
+///
+/// Requests are rounded up to size classes with four classes per power of two, i.e. at most 25% extra memory.
+/// A released block first goes to a small cache of the releasing thread, which serves the next request of the same
+/// class. The thread cache has its own mutex, it is only contended when another thread trims the pool or collects the
+/// statistics, the owning thread otherwise takes it without waiting and the shared lists are not touched.
+/// Blocks that do not fit in the thread cache go to shared free lists, one set per memory node.
+/// New blocks are touched page by page by the allocating thread, i.e. the pages are placed on its node by the first
+/// touch policy, and a request prefers the free blocks of the node of the calling thread.
+///
+/// Blocks larger than the largest class are not pooled. The shared lists are limited by the cache limit, blocks beyond
+/// the limit are returned to the system.
+class KIPLSHARED_EXPORT BufferPool
+{
+public:
+    /// \brief Enables or disables the pool for the following allocations.
+    /// \param enable The pool is used when true. Disabling trims all free blocks, the blocks in use are returned to the system when they are released.
+    static void setEnabled(bool enable);
+
+    /// \returns true if new buffers are allocated from the pool.
+    static bool enabled();
+
+    /// \brief Sets the number of bytes the shared free lists may hold.
+    /// \param bytes The limit, free blocks beyond it are returned to the system.
+    static void setCacheLimit(size_t bytes);
+
+    /// \returns the number of bytes the shared free lists may hold.
+    static size_t cacheLimit();
+
+    /// \brief Allocates a block of at least the requested size, aligned to 64 bytes.
+    /// \param bytes The requested size
+    /// \returns a pointer to the block or nullptr if the pool is disabled or the request is larger than the largest size class.
+    /// \throws KiplException if the system allocation fails also after trimming the pool.
+    static void *allocate(size_t bytes);
+
+    /// \brief Gives a block allocated by allocate back to the pool.
+    /// \param ptr Pointer to the block, nullptr is ignored.
+    static void release(void *ptr);
+
+    /// \brief Returns all free blocks to the system, also the ones in the thread caches.
+    static void trim();
+
+    /// \returns the current counters of the pool.
+    static BufferPoolStatistics statistics();
+
+    /// \brief Clears the event counters, the byte counters are kept.
+    static void resetStatistics();
+
+    /// \param bytes A requested size, it must not be larger than maxPooledSize.
+    /// \returns the size class of the request.
+    static size_t sizeClass(size_t bytes);
+
+    /// \param sizeClass A size class
+    /// \returns the number of bytes in the blocks of the class.
+    static size_t classSize(size_t sizeClass);
+
+    /// \returns the largest request that is pooled.
+    static size_t maxPooledSize();
+};
+
+}}}
+
+#endif // BUFFERPOOL_H
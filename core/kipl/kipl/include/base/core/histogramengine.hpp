@@ -0,0 +1,300 @@
+//<LICENCE>
+
+#ifndef HISTOGRAMENGINE_HPP
+#define HISTOGRAMENGINE_HPP
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include "../KiplException.h"
+#include "../../utilities/threadpool.h"
+
+namespace kipl { namespace base { namespace core {
+
+/// Number of pixels that are processed by the statistics and the binning loops before moving on, the block stays in the L1 cache
+const size_t cHistogramBlockSize = 4096;
+
+/// Smallest number of pixels that is worth a part of its own
+const size_t cHistogramMinPartSize = 1<<18;
+
+/// Largest number of bins that are counted in interleaved sub-histograms
+const size_t cSubHistogramMaxBins = 1024;
+
+/// Number of pixels after which the 32-bit sub-histograms are added to the bins of the part
+const size_t cSubHistogramFlush = size_t(1)<<30;
+
+/// Float data is binned in single precision like the legacy histograms, other types in double precision
+template <typename T>
+struct HistogramComputeType {
+    typedef typename std::conditional<std::is_same<T,float>::value,float,double>::type type;
+};
+
+}
+
+template <typename T>
+HistogramEngine<T>::Partial::Partial(size_t nBins) :
+    bins(nBins,0),
+    n(0),
+    sum(0.0),
+    sum2(0.0),
+    minval(std::numeric_limits<double>::max()),
+    maxval(-std::numeric_limits<double>::max())
+{}
+
+template <typename T>
+void HistogramEngine<T>::Partial::merge(const Partial &p)
+{
+    for (size_t i=0; i<bins.size(); ++i)
+        bins[i]+=p.bins[i];
+
+    n+=p.n;
+    sum+=p.sum;
+    sum2+=p.sum2;
+    minval=std::min(minval,p.minval);
+    maxval=std::max(maxval,p.maxval);
+}
+
+template <typename T>
+HistogramEngine<T>::HistogramEngine(size_t nBins, double lo, double hi, eHistogramOutside outside) :
+    m_nBins(0),
+    m_fLow(0.0),
+    m_fHigh(1.0),
+    m_fScale(1.0),
+    m_eOutside(outside),
+    m_bIgnoreZeros(false),
+    m_Total(0)
+{
+    setBins(nBins,lo,hi,outside);
+}
+
+template <typename T>
+void HistogramEngine<T>::setBins(size_t nBins, double lo, double hi, eHistogramOutside outside)
+{
+    if ((nBins!=0) && !(lo<hi))
+        throw kipl::base::KiplException("The histogram interval is empty",__FILE__,__LINE__);
+
+    m_nBins    = nBins;
+    m_fLow     = lo;
+    m_fHigh    = hi;
+    m_fScale   = nBins==0 ? 0.0 : nBins/(hi-lo);
+    m_eOutside = outside;
+
+    reset();
+}
+
+template <typename T>
+void HistogramEngine<T>::reset()
+{
+    m_Total=Partial(m_nBins);
+}
+
+template <typename T>
+void HistogramEngine<T>::put(const T *data, size_t N)
+{
+    if (N==0)
+        return;
+
+    kipl::utilities::ThreadPool &pool=kipl::utilities::ThreadPool::global();
+    const size_t nParts=std::max(size_t(1),std::min(4*pool.size(),N/core::cHistogramMinPartSize));
+
+    if (nParts==1) {
+        processPart(data,N,m_Total);
+        return;
+    }
+
+    const size_t partSize=(N+nParts-1)/nParts;
+    std::vector<Partial> parts(nParts,Partial(m_nBins));
+
+    pool.parallel_for(0,nParts,
+        [&](size_t first, size_t last) {
+            for (size_t p=first; p<last; ++p) {
+                const size_t offset=p*partSize;
+                if (offset<N)
+                    processPart(data+offset,std::min(partSize,N-offset),parts[p]);
+            }
+        },1);
+
+    // Tree reduction, each level merges pairs of parts at twice the distance of the previous level
+    for (size_t step=1; step<nParts; step*=2) {
+        pool.parallel_for(0,(nParts+2*step-1)/(2*step),
+            [&](size_t first, size_t last) {
+                for (size_t k=first; k<last; ++k) {
+                    const size_t a=2*k*step;
+                    if (a+step<nParts)
+                        parts[a].merge(parts[a+step]);
+                }
+            },1);
+    }
+
+    m_Total.merge(parts[0]);
+}
+
+template <typename T>
+std::vector<float> HistogramEngine<T>::axis() const
+{
+    std::vector<float> binAxis(m_nBins);
+
+    const double width=(m_fHigh-m_fLow)/m_nBins;
+    for (size_t i=0; i<m_nBins; ++i)
+        binAxis[i]=static_cast<float>(m_fLow+(i+0.5)*width);
+
+    return binAxis;
+}
+
+template <typename T>
+kipl::math::Statistics HistogramEngine<T>::statistics() const
+{
+    return kipl::math::Statistics(m_Total.n,m_Total.sum,m_Total.sum2,m_Total.minval,m_Total.maxval);
+}
+
+template <typename T>
+kipl::math::Statistics HistogramEngine<T>::statistics(const T *data, size_t N)
+{
+    HistogramEngine<T> engine(0);
+    engine.put(data,N);
+
+    return engine.statistics();
+}
+
+template <typename T>
+bool HistogramEngine<T>::useSubHistograms() const
+{
+    return std::is_integral<T>::value && (m_nBins<=core::cSubHistogramMaxBins);
+}
+
+template <typename T>
+void HistogramEngine<T>::processPart(const T *data, size_t N, Partial &part) const
+{
+    const bool subHistograms=(m_nBins!=0) && useSubHistograms();
+    std::vector<uint32_t> subBins(subHistograms ? 4*m_nBins : 0,0);
+    size_t nSubCounted=0;
+
+    for (size_t offset=0; offset<N; offset+=core::cHistogramBlockSize) {
+        const size_t n=std::min(core::cHistogramBlockSize,N-offset);
+        const T *block=data+offset;
+
+        blockStatistics(block,n,part);
+
+        if (m_nBins==0)
+            continue;
+
+        if (subHistograms) {
+            countBlockInterleaved(block,n,subBins.data());
+            nSubCounted+=n;
+            if ((core::cSubHistogramFlush<=nSubCounted) || (N<=offset+n)) {
+                for (size_t i=0; i<subBins.size(); ++i)
+                    part.bins[i % m_nBins]+=subBins[i];
+                std::fill(subBins.begin(),subBins.end(),0);
+                nSubCounted=0;
+            }
+        }
+        else
+            countBlock(block,n,part.bins.data());
+    }
+}
+
+template <typename T>
+void HistogramEngine<T>::blockStatistics(const T *data, size_t N, Partial &part) const
+{
+    if (m_bIgnoreZeros) {
+        for (size_t i=0; i<N; ++i) {
+            if (data[i]==static_cast<T>(0))
+                continue;
+
+            const double x=static_cast<double>(data[i]);
+            part.sum+=x;
+            part.sum2+=x*x;
+            part.minval=std::min(part.minval,x);
+            part.maxval=std::max(part.maxval,x);
+            ++part.n;
+        }
+        return;
+    }
+
+    // Four independent lanes break the dependency chains of the sums
+    double sum[4]={0.0,0.0,0.0,0.0};
+    double sum2[4]={0.0,0.0,0.0,0.0};
+    double minval[4]={part.minval,part.minval,part.minval,part.minval};
+    double maxval[4]={part.maxval,part.maxval,part.maxval,part.maxval};
+
+    size_t i=0;
+    for (; i+4<=N; i+=4) {
+        for (size_t l=0; l<4; ++l) {
+            const double x=static_cast<double>(data[i+l]);
+            sum[l]+=x;
+            sum2[l]+=x*x;
+            minval[l]= x<minval[l] ? x : minval[l];
+            maxval[l]= maxval[l]<x ? x : maxval[l];
+        }
+    }
+    for (; i<N; ++i) {
+        const double x=static_cast<double>(data[i]);
+        sum[0]+=x;
+        sum2[0]+=x*x;
+        minval[0]=std::min(minval[0],x);
+        maxval[0]=std::max(maxval[0],x);
+    }
+
+    part.sum+=(sum[0]+sum[1])+(sum[2]+sum[3]);
+    part.sum2+=(sum2[0]+sum2[1])+(sum2[2]+sum2[3]);
+    part.minval=std::min(std::min(minval[0],minval[1]),std::min(minval[2],minval[3]));
+    part.maxval=std::max(std::max(maxval[0],maxval[1]),std::max(maxval[2],maxval[3]));
+    part.n+=N;
+}
+
+template <typename T>
+void HistogramEngine<T>::countBlock(const T *data, size_t N, size_t *bins) const
+{
+    typedef typename core::HistogramComputeType<T>::type Scalar;
+
+    const Scalar low   = static_cast<Scalar>(m_fLow);
+    const Scalar scale = static_cast<Scalar>(m_fScale);
+    const Scalar top   = static_cast<Scalar>(m_nBins);
+    const bool clamp   = m_eOutside==HistogramClampOutside;
+
+    for (size_t i=0; i<N; ++i) {
+        if (m_bIgnoreZeros && (data[i]==static_cast<T>(0)))
+            continue;
+
+        const Scalar v=(static_cast<Scalar>(data[i])-low)*scale;
+        if ((0<=v) && (v<top))
+            bins[static_cast<size_t>(v)]++;
+        else if (clamp) {
+            if (v<0)
+                bins[0]++;
+            else if (top<=v)
+                bins[m_nBins-1]++;
+        }
+    }
+}
+
+template <typename T>
+void HistogramEngine<T>::countBlockInterleaved(const T *data, size_t N, uint32_t *bins) const
+{
+    const double low   = m_fLow;
+    const double scale = m_fScale;
+    const double top   = static_cast<double>(m_nBins);
+    const bool clamp   = m_eOutside==HistogramClampOutside;
+
+    // Pixel i is counted in the bin set i%4, repeated values don't wait for the previous increment of the same counter
+    for (size_t i=0; i<N; ++i) {
+        if (m_bIgnoreZeros && (data[i]==static_cast<T>(0)))
+            continue;
+
+        uint32_t *set=bins+(i & 3)*m_nBins;
+        const double v=(static_cast<double>(data[i])-low)*scale;
+        if ((0<=v) && (v<top))
+            set[static_cast<size_t>(v)]++;
+        else if (clamp) {
+            if (v<0)
+                set[0]++;
+            else if (top<=v)
+                set[m_nBins-1]++;
+        }
+    }
+}
+
+}}
+
+#endif // HISTOGRAMENGINE_HPP
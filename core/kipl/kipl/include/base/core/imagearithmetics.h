@@ -73,6 +73,18 @@ void BasicDiv(T *a, T c, const size_t N)
 	}
 }
 
+/// \brief Converts an array of pixels to float
+/// \param dst The destination array
+/// \param src The source array
+/// \param N Number of elements
+template <typename T>
+void BasicConvert(float *dst, const T *src, const size_t N)
+{
+	for (size_t i=0; i<N ; i++) {
+		dst[i]=static_cast<float>(src[i]);
+	}
+}
+
 #ifdef __CYGWIN__
 void SSE2Add(float *a, const float *b, const size_t N) {BasicAdd(a,b,N);}
 void SSE2Add(float *a, const float b, const size_t N) {BasicAdd(a,b,N);}
@@ -82,6 +94,10 @@ void SSE2Mult(float *a, const float *b, const size_t N) {BasicMult(a,b,N);}
 void SSE2Mult(float *a, const float b, const size_t N) {BasicMult(a,b,N);}
 void SSE2Div(float *a, const float *b, const size_t N) {BasicDiv(a,b,N);}
 void SSE2Div(float *a, const float b, const size_t N) {BasicDiv(a,b,N);}
+void SSE2Convert(float *dst, const unsigned char *src, const size_t N) {BasicConvert(dst,src,N);}
+void SSE2Convert(float *dst, const short *src, const size_t N) {BasicConvert(dst,src,N);}
+void SSE2Convert(float *dst, const unsigned short *src, const size_t N) {BasicConvert(dst,src,N);}
+void SSE2Convert(float *dst, const int *src, const size_t N) {BasicConvert(dst,src,N);}
 #else
 void KIPLSHARED_EXPORT SSE2Add(float *a, const float *b, const size_t N);
 void KIPLSHARED_EXPORT SSE2Add(float *a, const float b, const size_t N);
@@ -91,6 +107,15 @@ void KIPLSHARED_EXPORT SSE2Mult(float *a, const float *b, const size_t N);
 void KIPLSHARED_EXPORT SSE2Mult(float *a, const float b, const size_t N);
 void KIPLSHARED_EXPORT SSE2Div(float *a, const float *b, const size_t N);
 void KIPLSHARED_EXPORT SSE2Div(float *a, const float b, const size_t N);
+
+/// \brief Converts an array of integer pixels to float using SSE2, the arrays don't need to be aligned.
+/// \param dst The destination array
+/// \param src The source array
+/// \param N Number of elements
+void KIPLSHARED_EXPORT SSE2Convert(float *dst, const unsigned char *src, const size_t N);
+void KIPLSHARED_EXPORT SSE2Convert(float *dst, const short *src, const size_t N);
+void KIPLSHARED_EXPORT SSE2Convert(float *dst, const unsigned short *src, const size_t N);
+void KIPLSHARED_EXPORT SSE2Convert(float *dst, const int *src, const size_t N);
 #endif
 
 }}}
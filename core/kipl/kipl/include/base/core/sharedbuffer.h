@@ -11,6 +11,7 @@
 #include <algorithm>
 
 #include "../KiplException.h"
+#include "bufferpool.h"
 
 using namespace std;
 namespace kipl { namespace base { namespace core {
@@ -25,7 +26,9 @@ class buffer {
         cref(size_t N) :
             cnt(1),
             m_nData(N),
-            bExternalBuffer(false)
+            m_pRawPointer(nullptr),
+            bExternalBuffer(false),
+            bPooled(false)
         {
             _Allocate(N);
         }
@@ -36,7 +39,8 @@ class buffer {
             data(buffer),
             m_nData(N),
             m_pRawPointer(nullptr),
-            bExternalBuffer(true)
+            bExternalBuffer(true),
+            bPooled(false)
         {
 
         }
@@ -47,7 +51,10 @@ class buffer {
 		/// \brief D'tor deallocated the buffer
         ~cref()
         {
-            if (m_pRawPointer!=nullptr) _mm_free(m_pRawPointer);
+            if (bPooled)
+                BufferPool::release(m_pRawPointer);
+            else if (m_pRawPointer!=nullptr)
+                _mm_free(m_pRawPointer);
         }
 
 		/// \returns The size of the allocated buffer 
@@ -63,9 +70,15 @@ class buffer {
 			char *m_pRawPointer;
 
             bool bExternalBuffer;
+            /// \brief The buffer was allocated from the BufferPool
+            bool bPooled;
 			/// \brief Does the allocation and adjusts the data pointer to the beginning of the next 32 block
 			void _Allocate(size_t N) {
-				m_pRawPointer=reinterpret_cast<char *>(_mm_malloc((N+16)*sizeof(T),32));               
+                m_pRawPointer=reinterpret_cast<char *>(BufferPool::allocate((N+16)*sizeof(T)));
+                bPooled=(m_pRawPointer!=nullptr);
+
+                if (!bPooled)
+                    m_pRawPointer=reinterpret_cast<char *>(_mm_malloc((N+16)*sizeof(T),32));
 
                 if (m_pRawPointer==nullptr) {
 					std::ostringstream msg;
@@ -148,19 +148,26 @@ void InsertSlice(kipl::base::TImage<T,2> &slice, kipl::base::TImage<T,3> &volume
 		if (volume.Size(1)<=index)
 			throw kipl::base::KiplException("Index exceeds image dimension for PlaneXZ.", __FILE__, __LINE__);
 
-		if ((volume.Size(0)!=slice.Size(0)) || (volume.Size(2)!=slice.Size(2)))
+		if ((volume.Size(0)!=slice.Size(0)) || (volume.Size(2)!=slice.Size(1)))
 			throw kipl::base::KiplException("Slice dimensions does not match the volume plane for PlaneXZ.", __FILE__, __LINE__);
 		
-		throw kipl::base::KiplException("Extraction for PlaneXZ is not implemented",__FILE__,__LINE__);
+		for (size_t z=0; z<slice.Size(1); z++)
+			memcpy(volume.GetLinePtr(index,z),slice.GetLinePtr(z),sizeof(T)*slice.Size(0));
 		break;
-	case kipl::base::ImagePlaneYZ : break;
+	case kipl::base::ImagePlaneYZ :
 		if (volume.Size(0)<=index)
 			throw kipl::base::KiplException("Index exceeds image dimension for PlaneYZ.", __FILE__, __LINE__);
 
-		if ((volume.Size(2)!=slice.Size(2)) || (volume.Size(1)!=slice.Size(1)))
+		if ((volume.Size(1)!=slice.Size(0)) || (volume.Size(2)!=slice.Size(1)))
 			throw kipl::base::KiplException("Slice dimensions does not match the volume plane for PlaneYZ.", __FILE__, __LINE__);
 		
-		throw kipl::base::KiplException("Extraction for PlaneYZ is not implemented",__FILE__,__LINE__);
+		for (size_t z=0; z<slice.Size(1); z++) {
+			T const * pSrc=slice.GetLinePtr(z);
+			T * pData=volume.GetLinePtr(0,z)+index;
+			for (size_t y=0; y<slice.Size(0); y++)
+				pData[y*volume.Size(0)]=pSrc[y];
+		}
+		break;
 	default : 
 		throw kipl::base::KiplException("Unknown image plane", __FILE__, __LINE__); 
 		break;
@@ -3,6 +3,10 @@
 #ifndef THISTOGRAM_HPP
 #define THISTOGRAM_HPP
 
+#include <algorithm>
+
+#include "../histogramengine.h"
+
 namespace kipl { namespace base {
 template<typename T>
 THistogram<T>::THistogram(size_t nbins, T low, T high) :
@@ -53,34 +57,26 @@ void THistogram<T>::SetInterval(size_t length, T low, T high)
 template<typename T>
 void THistogram<T>::ComputeHistogram(T * pData, size_t nData)
 {
-    memset(m_pHistogram,0,sizeof(size_t)*m_nBins);
-
-    float scale=1.0f/m_fSlope;
-    #pragma omp parallel firstprivate(nData,scale)
-    {
-        int index;
-        long long int i=0;
-        size_t *temp_hist=new size_t[m_nBins];
-        memset(temp_hist,0,m_nBins*sizeof(size_t));
-        const ptrdiff_t snData=static_cast<ptrdiff_t>(nData);
-        const ptrdiff_t snBins=static_cast<ptrdiff_t>(m_nBins);
-
-        #pragma omp for
-        for (i=0; i<snData; i++) {
-            index=static_cast<int>((pData[i]-m_fIntercept)*scale);
-            if ((index<snBins) && (0<=index))
-                temp_hist[index]++;
-        }
-        #pragma omp critical
-        {
-            for (i=0; i<snBins; i++)
-                m_pHistogram[i]+=temp_hist[i];
-        }
-        delete [] temp_hist;
+    double low    = m_fIntercept;
+    double slope  = m_fSlope;
+    float axisLow = m_LowValue;
+    float scale   = (m_HighValue-m_LowValue)/m_nBins;
+
+    if (!(0<slope)) { // An empty interval uses the data range
+        kipl::math::Statistics stats=HistogramEngine<T>::statistics(pData,nData);
+        low     = stats.Min();
+        slope   = stats.Min()<stats.Max() ? (stats.Max()-stats.Min())/(m_nBins-1) : 1.0;
+        axisLow = static_cast<float>(low);
+        scale   = static_cast<float>(slope*(m_nBins-1)/m_nBins);
     }
-    scale=(m_HighValue-m_LowValue)/m_nBins;
+
+    // The bins start at low and have the width slope
+    HistogramEngine<T> engine(m_nBins,low,low+m_nBins*slope);
+    engine.put(pData,nData);
+    std::copy(engine.histogram().begin(),engine.histogram().end(),m_pHistogram);
+
     if (m_pAxis!=NULL) {
-        m_pAxis[0]=m_LowValue+scale/2;
+        m_pAxis[0]=axisLow+scale/2;
         for (size_t i=1; i<m_nBins; i++)
             m_pAxis[i]=m_pAxis[i-1]+scale;
     }
@@ -0,0 +1,131 @@
+//<LICENCE>
+
+#ifndef HISTOGRAMENGINE_H
+#define HISTOGRAMENGINE_H
+
+#include "../kipl_global.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "timage.h"
+#include "../math/statistics.h"
+
+namespace kipl { namespace base {
+
+/// \brief Selects how a histogram counts values outside the bin interval
+enum eHistogramOutside {
+    HistogramDropOutside,   ///< Values outside the interval are not counted
+    HistogramClampOutside   ///< Values outside the interval are counted in the first or last bin
+};
+
+/// \brief Computes a histogram together with the min, max, sum and square sum of the data in one pass.
+///
+/// The data is split in parts that are processed in parallel, each part has private bins and statistics.
+/// The parts are reduced by a tree merge without locking. Within a part the data is processed in short
+/// blocks, the statistics loop is vectorized and the binning loop reads the block again from the cache.
+/// Integer data with few bins is counted in interleaved sub-histograms, which avoids the stalls when
+/// neighbouring pixels fall in the same bin.
+///
+/// The engine accumulates, data can be added block by block, e.g. slice by slice from a volume, by repeated calls to put.
+/// An engine with zero bins only computes the statistics.
+/// \tparam T Pixel type
+template <typename T>
+class HistogramEngine
+{
+public:
+    /// \brief Prepares an empty histogram, the bins have equal width and cover the interval [lo,hi).
+    /// \param nBins Number of bins, 0 only computes the statistics.
+    /// \param lo Lower bound of the first bin
+    /// \param hi Upper bound of the last bin
+    /// \param outside Selects how values outside the interval are counted
+    /// \throws KiplException if the interval is empty and there are bins
+    HistogramEngine(size_t nBins=256, double lo=0.0, double hi=1.0, eHistogramOutside outside=HistogramDropOutside);
+
+    /// \brief Changes the bins and clears the accumulated data
+    /// \param nBins Number of bins, 0 only computes the statistics.
+    /// \param lo Lower bound of the first bin
+    /// \param hi Upper bound of the last bin
+    /// \param outside Selects how values outside the interval are counted
+    /// \throws KiplException if the interval is empty and there are bins
+    void setBins(size_t nBins, double lo, double hi, eHistogramOutside outside=HistogramDropOutside);
+
+    /// \brief Excludes zero valued pixels from the histogram and the statistics, e.g. outside a reconstruction mask
+    void setIgnoreZeros(bool ignore) {m_bIgnoreZeros=ignore;}
+
+    /// \brief Clears the histogram and the statistics
+    void reset();
+
+    /// \brief Adds data to the histogram and the statistics
+    /// \param data The data array
+    /// \param N Number of elements in the array
+    void put(const T *data, size_t N);
+
+    /// \brief Adds all pixels of an image
+    template <size_t NDims>
+    void put(const TImage<T,NDims> &img) {put(img.GetDataPtr(),img.Size());}
+
+    /// \returns the bin counts
+    const std::vector<size_t> & histogram() const {return m_Total.bins;}
+
+    /// \returns the centers of the bins
+    std::vector<float> axis() const;
+
+    /// \returns the statistics of the accumulated data including the values outside the bin interval
+    kipl::math::Statistics statistics() const;
+
+    /// \returns the number of bins
+    size_t bins() const {return m_nBins;}
+
+    /// \brief Computes the statistics of an array in parallel
+    /// \param data The data array
+    /// \param N Number of elements in the array
+    static kipl::math::Statistics statistics(const T *data, size_t N);
+
+protected:
+    /// \brief Bins and statistics of one part of the data
+    struct Partial {
+        Partial(size_t nBins);
+
+        /// \brief Adds the bins and statistics of another part
+        void merge(const Partial &p);
+
+        std::vector<size_t> bins;
+        size_t n;
+        double sum;
+        double sum2;
+        double minval;
+        double maxval;
+    };
+
+    /// \brief Processes the data of one part
+    void processPart(const T *data, size_t N, Partial &part) const;
+
+    /// \brief Computes the statistics of a block, the loop is vectorized over four lanes
+    void blockStatistics(const T *data, size_t N, Partial &part) const;
+
+    /// \brief Counts a block with one set of bins
+    void countBlock(const T *data, size_t N, size_t *bins) const;
+
+    /// \brief Counts a block in four interleaved sets of bins
+    void countBlockInterleaved(const T *data, size_t N, uint32_t *bins) const;
+
+    /// \returns true if the sub-histogram counting is used
+    bool useSubHistograms() const;
+
+    size_t m_nBins;
+    double m_fLow;
+    double m_fHigh;
+    double m_fScale;
+    eHistogramOutside m_eOutside;
+    bool m_bIgnoreZeros;
+
+    Partial m_Total;
+};
+
+}}
+
+#include "core/histogramengine.hpp"
+
+#endif // HISTOGRAMENGINE_H
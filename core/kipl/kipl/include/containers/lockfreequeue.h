@@ -0,0 +1,134 @@
+//<LICENCE>
+
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+#include "../base/KiplException.h"
+
+namespace kipl { namespace containers {
+
+/// \brief A bounded multi-producer/multi-consumer queue without locks.
+///
+/// The queue is a ring of slots where each slot carries a sequence number that tells if it is free
+/// for writing or ready for reading (D. Vyukov's bounded MPMC queue). Producers and consumers only
+/// contend on one atomic counter each and never block. The capacity is rounded up to a power of two.
+/// \note The element type must be default constructible and move assignable.
+template <typename T>
+class LockFreeQueue
+{
+public:
+    /// \brief C'tor that allocates the slots of the queue.
+    /// \param capacity The minimum number of elements the queue can hold, it is rounded up to the next power of two.
+    /// \throws KiplException if the capacity is less than two.
+    LockFreeQueue(size_t capacity) :
+        m_Slots(RoundUp(capacity)),
+        m_nMask(m_Slots.size()-1),
+        m_nEnqueuePos(0),
+        m_nDequeuePos(0)
+    {
+        if (capacity<2)
+            throw kipl::base::KiplException("LockFreeQueue needs a capacity of at least two elements",__FILE__,__LINE__);
+
+        for (size_t i=0; i<m_Slots.size(); ++i)
+            m_Slots[i].sequence.store(i,std::memory_order_relaxed);
+    }
+
+    LockFreeQueue(const LockFreeQueue &) = delete;
+    LockFreeQueue & operator=(const LockFreeQueue &) = delete;
+
+    /// \brief Tries to put an element at the end of the queue.
+    /// \param item The element to add, it is moved into the queue on success.
+    /// \returns true if the element was added, false if the queue is full.
+    bool try_push(T && item)
+    {
+        Slot *slot=nullptr;
+        size_t pos=m_nEnqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            slot=&m_Slots[pos & m_nMask];
+            size_t seq=slot->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff=static_cast<std::ptrdiff_t>(seq)-static_cast<std::ptrdiff_t>(pos);
+            if (diff==0) {
+                if (m_nEnqueuePos.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff<0)
+                return false;
+            else
+                pos=m_nEnqueuePos.load(std::memory_order_relaxed);
+        }
+
+        slot->data=std::move(item);
+        slot->sequence.store(pos+1,std::memory_order_release);
+
+        return true;
+    }
+
+    /// \brief Tries to take the first element from the queue.
+    /// \param item Receives the element on success.
+    /// \returns true if an element was taken, false if the queue is empty.
+    bool try_pop(T & item)
+    {
+        Slot *slot=nullptr;
+        size_t pos=m_nDequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            slot=&m_Slots[pos & m_nMask];
+            size_t seq=slot->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff=static_cast<std::ptrdiff_t>(seq)-static_cast<std::ptrdiff_t>(pos+1);
+            if (diff==0) {
+                if (m_nDequeuePos.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff<0)
+                return false;
+            else
+                pos=m_nDequeuePos.load(std::memory_order_relaxed);
+        }
+
+        item=std::move(slot->data);
+        slot->sequence.store(pos+m_nMask+1,std::memory_order_release);
+
+        return true;
+    }
+
+    /// \returns true if the queue was empty at the time of the call. The result is only a snapshot when other threads use the queue.
+    bool empty() const
+    {
+        return m_nEnqueuePos.load(std::memory_order_acquire)==m_nDequeuePos.load(std::memory_order_acquire);
+    }
+
+    /// \returns the number of slots in the queue.
+    size_t capacity() const { return m_Slots.size(); }
+
+private:
+    struct Slot {
+        Slot() : sequence(0), data() {}
+        Slot(const Slot &) = delete;
+        Slot(Slot && s) : sequence(s.sequence.load()), data(std::move(s.data)) {}
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static size_t RoundUp(size_t n)
+    {
+        size_t N=2;
+        while (N<n)
+            N<<=1;
+
+        return N;
+    }
+
+    std::vector<Slot> m_Slots;
+    const size_t m_nMask;
+    char m_Pad0[64];                    ///< Keeps the producer and consumer positions on separate cache lines
+    std::atomic<size_t> m_nEnqueuePos;
+    char m_Pad1[64];
+    std::atomic<size_t> m_nDequeuePos;
+};
+
+}}
+#endif // LOCKFREEQUEUE_H
@@ -7,6 +7,7 @@
 
 #include <complex>
 #include <cstring>
+#include <mutex>
 #include <fftw3.h>
 
 #include "../logging/logger.h"
@@ -17,6 +18,14 @@ namespace math {
 /// \brief The FFT namespace collects classes related to the fft
 namespace fft {
 
+/// \brief Lock that serialises calls to the FFTW planner.
+///
+/// Creating and destroying FFTW plans is not thread safe, executing a plan on new arrays
+/// with the fftw(f)_execute_dft_* functions is. Code that plans its own transforms shall
+/// hold this lock while planning.
+/// \returns the process wide planner lock
+KIPLSHARED_EXPORT std::mutex & plannerMutex();
+
 /// \brief Base class to provide an efficient interface to libFFTW
 ///
 ///	The class only computes the plan once and recycles it afterwards for all transforms.
@@ -9,6 +9,7 @@
 #include "../base/textractor.h"
 #include "../strings/filenames.h"
 #include "../base/kiplenums.h"
+#include "nexusreader.h"
 
 #include <iostream>
 #include <iomanip>
@@ -17,6 +18,7 @@
 #include <sstream>
 #include <vector>
 #include <map>
+#include <algorithm>
 
 #include <nexus/napi.h>
 #include <nexus/NeXusFile.hpp>
@@ -41,258 +43,42 @@ using namespace std;
 
 namespace kipl { namespace io {
 
-/// \brief Read the image data content from Nexus file and stores it in the data type specified by the image
-///	\param src the image to be stored
-///	\param fname file name of the destination file (including extension .hdf)
-/// \return 1 if successful, 0 if fail
+/// \brief Reads a projection from a Nexus file and stores it in the data type specified by the image
+///	\param img the image receiving the projection
+///	\param fname file name of the source file (including extension .hdf)
+///	\param number index of the projection
+///	\param nCrop ROI to read (x0,y0,x1,y1), nullptr reads the whole projection.
+/// \return 0 if successful
+/// \note Each call opens the file, use a NexusReader to read a sequence of projections.
 template <class ImgType, size_t NDim>
 int ReadNexus(kipl::base::TImage<ImgType,NDim> &img, const char *fname, size_t number, size_t const * const nCrop) {
+    kipl::io::NexusReader reader(fname);
+    kipl::base::TImage<float,2> proj;
 
+    reader.read(proj,number,nCrop);
 
-    std::stringstream msg;
-
-    NeXus::File file(fname);
-    vector<NeXus::AttrInfo> attr_infos = file.getAttrInfos();
-
-
-    file.openGroup("entry", "NXentry");
-    attr_infos = file.getAttrInfos(); // check how many or assuming that there is only one?
-    map<string, string> entries = file.getEntries();
-
-
-    for (map<string,string>::const_iterator it = entries.begin();it != entries.end(); ++it) {
-        if(it->second=="NXdata") {
-//            std::cout << " found data!"<< std::endl;
-            file.openGroup(it->first, it->second);
-            attr_infos = file.getAttrInfos();
-//            cout << "Number of group attributes for "<< it->second <<": " << attr_infos.size() << endl;
-
-            map<string, string> entries_data = file.getEntries();
-//            cout << "Group contains " << entries_data.size() << " items" << endl;
-
-            for (map<string,string>::const_iterator it_data = entries_data.begin();
-                 it_data != entries_data.end(); it_data++) {
-//                std::cout << it_data->first << ": " << it_data->second << std::endl;
-                file.openData(it_data->first);
-                attr_infos = file.getAttrInfos();
-//                cout << "Number of data attributes for " << it_data->first <<  ": "<< attr_infos.size() <<std::endl;
-                for (vector<NeXus::AttrInfo>::iterator it_att = attr_infos.begin(); it_att != attr_infos.end(); it_att++) {
-//                  cout << "   " << it_att->name << " = ";
-//                  if (it_att->type == NeXus::CHAR) {
-//                    cout << file.getStrAttr(*it_att);
-//                  }
-//                  cout << endl;
-
-                  if (it_att->name=="signal"){
-//                      std::cout << "found plottable data!!" << std::endl;
-
-                      size_t img_size[3];
-
-                      if (nCrop==nullptr)
-                      {
-                          img_size[0] = file.getInfo().dims[2];
-                          img_size[1] = file.getInfo().dims[1];
-                          img_size[2] = file.getInfo().dims[0];
-                      }
-                      else
-                      {
-                          img_size[0] = nCrop[2]-nCrop[0]; // missing exceptions
-                          img_size[1] = nCrop[3]-nCrop[1];
-                          img_size[2] = file.getInfo().dims[0];
-                      }
-
-                      int16_t *slab=new int16_t[img_size[0]*img_size[1]]; // assuming images are all int_16.. but possibly this can be read from nexus info..
-
-                      vector<int> slab_start;
-                      slab_start.push_back(number);
-                      if (nCrop==nullptr)
-                      {
-                          slab_start.push_back(0);
-                          slab_start.push_back(0);
-                      }
-                      else
-                      {
-                          slab_start.push_back(nCrop[1]);
-                          slab_start.push_back(nCrop[0]);
-
-                      }
-                      vector<int> slab_size;
-                      slab_size.push_back(1);
-                      slab_size.push_back(img_size[1]);
-                      slab_size.push_back(img_size[0]);
-
-
-                      try{
-                        file.getSlab(slab, slab_start, slab_size);
-                      }
-                      catch (const std::bad_alloc & E) {
-                              msg.str("");
-                              msg<<"ReadNexus file.getSlab caused an STL exception: "<<E.what();
-                              throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
-                      }
-                      catch (...){
-                          msg.str("");
-                          msg<<"ReadNexus file.getSlab caused an unknown exception: ";
-                          throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
-                      }
-
-
-
-
-                      size_t size2D[2] = {img_size[0], img_size[1]};
-                      img.Resize(size2D);
-                      ImgType *pslice = img.GetDataPtr();
-
-                      // casting to ImgType
-                      for (size_t i=0; i<img.Size();++i){
-                          pslice[i] = static_cast<ImgType>(slab[i]);
-                      }
-
-
-//                      kipl::io::WriteTIFF(img, "cropped_img.tif");
-
-
-//                      break;
-                      }
-                  }
-                file.closeData();
-                }
-
-            file.closeGroup();
-            }
-
-    }
-
-    file.close(); // close the file. hopefully
-
+    img.Resize(proj.Dims());
+    std::copy_n(proj.GetDataPtr(),proj.Size(),img.GetDataPtr());
 
     return 0;
 }
 
-/// \brief Read the image data content from Nexus file and stores it in the data type specified by the image
-///	\param src the image to be stored
-///	\param fname file name of the destination file (including extension .hdf)
-/// \return 1 if successful, 0 if fail
+/// \brief Reads a range of projections from a Nexus file and stores it in the data type specified by the image
+///	\param img the image receiving the projections
+///	\param fname file name of the source file (including extension .hdf)
+///	\param start index of the first projection
+///	\param end one past the index of the last projection
+///	\param nCrop ROI to read (x0,y0,x1,y1), nullptr reads the whole projections.
+/// \return 1 if successful
 template <class ImgType, size_t NDim>
 int ReadNexusStack(kipl::base::TImage<ImgType,NDim> &img, const char *fname, size_t start, size_t end, size_t const * const nCrop) {
+    kipl::io::NexusReader reader(fname);
+    kipl::base::TImage<float,3> projections;
 
+    reader.read(projections,start,end,nCrop);
 
-    std::stringstream msg;
-
-    NeXus::File file(fname);
-    vector<NeXus::AttrInfo> attr_infos = file.getAttrInfos();
-
-
-    file.openGroup("entry", "NXentry");
-    attr_infos = file.getAttrInfos(); // check how many or assuming that there is only one?
-    map<string, string> entries = file.getEntries();
-
-
-    for (map<string,string>::const_iterator it = entries.begin();it != entries.end(); ++it) {
-        if(it->second=="NXdata") {
-//            std::cout << " found data!"<< std::endl;
-            file.openGroup(it->first, it->second);
-            attr_infos = file.getAttrInfos();
-//            cout << "Number of group attributes for "<< it->second <<": " << attr_infos.size() << endl;
-
-            map<string, string> entries_data = file.getEntries();
-//            cout << "Group contains " << entries_data.size() << " items" << endl;
-
-            for (map<string,string>::const_iterator it_data = entries_data.begin();
-                 it_data != entries_data.end(); it_data++) {
-//                std::cout << it_data->first << ": " << it_data->second << std::endl;
-                file.openData(it_data->first);
-                attr_infos = file.getAttrInfos();
-//                cout << "Number of data attributes for " << it_data->first <<  ": "<< attr_infos.size() <<std::endl;
-                for (vector<NeXus::AttrInfo>::iterator it_att = attr_infos.begin(); it_att != attr_infos.end(); it_att++) {
-//                  cout << "   " << it_att->name << " = ";
-//                  if (it_att->type == NeXus::CHAR) {
-//                    cout << file.getStrAttr(*it_att);
-//                  }
-//                  cout << endl;
-
-                  if (it_att->name=="signal"){
-//                      std::cout << "found plottable data!!" << std::endl;
-
-                      size_t img_size[3];
-
-                      if (nCrop==nullptr)
-                      {
-                          img_size[0] = file.getInfo().dims[2];
-                          img_size[1] = file.getInfo().dims[1];
-                          img_size[2] = file.getInfo().dims[0];
-                      }
-                      else
-                      {
-                          img_size[0] = nCrop[2]-nCrop[0]; // missing exceptions
-                          img_size[1] = nCrop[3]-nCrop[1];
-                          img_size[2] = file.getInfo().dims[0];
-                      }
-
-                      int16_t *slab=new int16_t[img_size[0]*img_size[1]*(end-start)]; // assuming images are all int_16.. but possibly this can be read from nexus info..
-
-                      vector<int> slab_start;
-                      slab_start.push_back(start);
-                      if (nCrop==nullptr)
-                      {
-                          slab_start.push_back(0);
-                          slab_start.push_back(0);
-                      }
-                      else
-                      {
-                          slab_start.push_back(nCrop[1]);
-                          slab_start.push_back(nCrop[0]);
-
-                      }
-                      vector<int> slab_size;
-                      slab_size.push_back(end-start);
-                      slab_size.push_back(img_size[1]);
-                      slab_size.push_back(img_size[0]);
-
-
-                      try{
-                        file.getSlab(slab, slab_start, slab_size);
-                      }
-                      catch (const std::bad_alloc & E) {
-                              msg.str("");
-                              msg<<"ReadNexus file.getSlab caused an STL exception: "<<E.what();
-                              throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
-                      }
-                      catch (...){
-                          msg.str("");
-                          msg<<"ReadNexus file.getSlab caused an unknown exception: ";
-                          throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
-                      }
-
-
-
-
-                      size_t size3D[3] = {img_size[0], img_size[1], end-start};
-                      img.Resize(size3D);
-                      ImgType *pslice = img.GetDataPtr();
-
-                      // casting to ImgType
-                      for (size_t i=0; i<img.Size();++i){
-                          pslice[i] = static_cast<ImgType>(slab[i]);
-                      }
-
-
-//                      kipl::io::WriteTIFF(img, "cropped_img.tif");
-
-
-//                      break;
-                      }
-                  }
-                file.closeData();
-                }
-
-            file.closeGroup();
-            }
-
-    }
-
-    file.close(); // close the file. hopefully
-
+    img.Resize(projections.Dims());
+    std::copy_n(projections.GetDataPtr(),projections.Size(),img.GetDataPtr());
 
     return 1;
 }
@@ -719,22 +505,20 @@ int PrepareNeXusFile16bit(const char *fname, size_t *dims, float p_size, kipl::b
 }
 
 
-/// todo: Add Doxygen information
+/// \brief Arranges a block of reconstructed slices as XY slices for writing to a NeXus file.
+/// \param img The reconstructed block, it is permuted in place when a ROI is used on YZ data.
+/// \param size Number of slices in the block
+/// \param imageplane The plane in which the slices are stored in img
+/// \param roi Optional ROI (x0, y0, x1, y1) including the end points
+/// \returns a volume with the XY slices of the block, slice i of the volume is slice i of the block.
 template <class ImgType, size_t NDim>
-int WriteNeXusStack(kipl::base::TImage<ImgType,NDim> &img, const char *fname, size_t start, size_t size, const kipl::base::eImagePlanes imageplane=kipl::base::ImagePlaneYZ, size_t *roi=nullptr) {
+kipl::base::TImage<ImgType,NDim> PrepareNeXusSlab(kipl::base::TImage<ImgType,NDim> &img, size_t size, const kipl::base::eImagePlanes imageplane=kipl::base::ImagePlaneYZ, size_t *roi=nullptr) {
 
 
     kipl::base::PermuteAxes<ImgType> permute;
     kipl::base::TImage<ImgType, NDim> permuted;
     kipl::base::TImage<ImgType, NDim> tmp_vol;
 
-    int slabstart[3] = {static_cast<int>(start), 0, 0};
-    int slabsize[3];
-
-    slabsize[0] = static_cast<int>(size);
-
-
-
     if (imageplane==kipl::base::ImagePlaneYZ) {
 
 
@@ -753,9 +537,6 @@ int WriteNeXusStack(kipl::base::TImage<ImgType,NDim> &img, const char *fname, si
 
         if (roi==nullptr) {
             tmp = img;
-            slabsize[1] = static_cast<int>(tmp.Size(1));
-            slabsize[2] = static_cast<int>(tmp.Size(2));
-
 
            permuted = permute(tmp,kipl::base::PermuteZYX);
            tmp_vol  = permute(permuted, kipl::base::PermuteYXZ);
@@ -777,10 +558,6 @@ int WriteNeXusStack(kipl::base::TImage<ImgType,NDim> &img, const char *fname, si
 
         }
 
-
-        slabsize[1] = static_cast<int>(tmp_vol.Size(1));
-        slabsize[2] = static_cast<int>(tmp_vol.Size(0));
-
         }
     }
 
@@ -801,9 +578,6 @@ int WriteNeXusStack(kipl::base::TImage<ImgType,NDim> &img, const char *fname, si
 
         if (roi==nullptr) {
             tmp = img;
-            slabsize[1] = static_cast<int>(tmp.Size(1));
-            slabsize[2] = static_cast<int>(tmp.Size(0));
-
             tmp_vol = img;
 //           permuted = permute(tmp,kipl::base::PermuteZYX);
 //           tmp_vol  = permute(permuted, kipl::base::PermuteYXZ);
@@ -826,13 +600,20 @@ int WriteNeXusStack(kipl::base::TImage<ImgType,NDim> &img, const char *fname, si
 
         }
 
-
-        slabsize[1] = static_cast<int>(tmp_vol.Size(1));
-        slabsize[2] = static_cast<int>(tmp_vol.Size(0));
-
         }
     }
 
+    return tmp_vol;
+}
+
+/// todo: Add Doxygen information
+template <class ImgType, size_t NDim>
+int WriteNeXusStack(kipl::base::TImage<ImgType,NDim> &img, const char *fname, size_t start, size_t size, const kipl::base::eImagePlanes imageplane=kipl::base::ImagePlaneYZ, size_t *roi=nullptr) {
+
+    kipl::base::TImage<ImgType, NDim> tmp_vol=PrepareNeXusSlab(img, size, imageplane, roi);
+
+    int slabstart[3] = {static_cast<int>(start), 0, 0};
+    int slabsize[3]  = {static_cast<int>(size), static_cast<int>(tmp_vol.Size(1)), static_cast<int>(tmp_vol.Size(0))};
 
      NXhandle file_id;
      NXopen (fname, NXACC_RDWR, &file_id);
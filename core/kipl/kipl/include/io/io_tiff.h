@@ -10,6 +10,8 @@
 #include <cstdio>
 #include <cstring>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 
 #include <tiffio.h>
 
@@ -18,6 +20,7 @@
 #include "../base/imageinfo.h"
 #include "../strings/filenames.h"
 #include "../base/kiplenums.h"
+#include "../base/core/imagearithmetics.h"
 
 
 namespace kipl { namespace io {
@@ -95,6 +98,89 @@ int KIPLSHARED_EXPORT GetTIFFDims(char const * const fname, size_t *dims);
 /// \retval False if at least one parameter was missing.
 bool KIPLSHARED_EXPORT GetSlopeOffset(std::string msg, float &slope, float &offset);
 
+/// \brief Scratch buffer for decoded strips and tiles. Each thread has its own buffer that is reused between reads.
+/// \returns a reference to the buffer of the calling thread
+KIPLSHARED_EXPORT std::vector<unsigned char> & TIFFScratchBuffer();
+
+/// \brief Corrects the bits of decoded TIFF data that is stored min-is-white or with the LSB to MSB fill order.
+/// \param buffer the decoded data
+/// \param N number of bytes in the buffer
+/// \param photo the photometric interpretation of the image
+/// \param fillorder the fill order of the image
+KIPLSHARED_EXPORT void FixTIFFBits(unsigned char *buffer, size_t N, uint16 photo, uint16 fillorder);
+
+namespace core {
+/// \brief Converts a row of TIFF samples to the pixel type of the image
+template <class ImgType, class SampleType>
+void ConvertTIFFSamples(ImgType *dst, SampleType const *src, size_t N)
+{
+    for (size_t i=0; i<N; ++i)
+        dst[i]=static_cast<ImgType>(src[i]);
+}
+
+inline void ConvertTIFFSamples(float *dst, unsigned char const *src, size_t N)  { kipl::base::core::SSE2Convert(dst,src,N); }
+inline void ConvertTIFFSamples(float *dst, short const *src, size_t N)          { kipl::base::core::SSE2Convert(dst,src,N); }
+inline void ConvertTIFFSamples(float *dst, unsigned short const *src, size_t N) { kipl::base::core::SSE2Convert(dst,src,N); }
+inline void ConvertTIFFSamples(float *dst, int const *src, size_t N)            { kipl::base::core::SSE2Convert(dst,src,N); }
+inline void ConvertTIFFSamples(float *dst, float const *src, size_t N)          { std::copy_n(src,N,dst); }
+
+/// \brief Crops and converts the part of a decoded strip or tile that is inside the ROI
+/// \param img the target image, its size is the size of the ROI
+/// \param block the decoded strip or tile
+/// \param stride the number of bytes in a row of the block
+/// \param blockroi the region covered by the block (x0, y0, x1, y1) in image coordinates
+/// \param roi the region to read (x0, y0, x1, y1)
+template <class ImgType, class SampleType>
+void CopyTIFFBlock(kipl::base::TImage<ImgType,2> &img, unsigned char const *block, size_t stride, size_t const *blockroi, size_t const *roi)
+{
+    const size_t x0=std::max(roi[0],blockroi[0]);
+    const size_t x1=std::min(roi[2],blockroi[2]);
+    const size_t y0=std::max(roi[1],blockroi[1]);
+    const size_t y1=std::min(roi[3],blockroi[3]);
+
+    if ((x1<=x0) || (y1<=y0))
+        return;
+
+    for (size_t y=y0; y<y1; ++y) {
+        SampleType const *pSrc=reinterpret_cast<SampleType const *>(block+(y-blockroi[1])*stride)+(x0-blockroi[0]);
+        ConvertTIFFSamples(img.GetLinePtr(y-roi[1])+(x0-roi[0]),pSrc,x1-x0);
+    }
+}
+
+/// \brief Selects the sample type once per block and crops and converts the block
+/// \param bps bits per sample
+/// \param sformat the sample format of the image
+template <class ImgType>
+void CopyTIFFBlock(kipl::base::TImage<ImgType,2> &img, unsigned char const *block, size_t stride, size_t const *blockroi, size_t const *roi,
+                   uint16 bps, uint16 sformat)
+{
+    switch (bps) {
+    case 8:
+        if (sformat==SAMPLEFORMAT_INT)
+            CopyTIFFBlock<ImgType,signed char>(img,block,stride,blockroi,roi);
+        else
+            CopyTIFFBlock<ImgType,unsigned char>(img,block,stride,blockroi,roi);
+        break;
+    case 16:
+        if (sformat==SAMPLEFORMAT_INT)
+            CopyTIFFBlock<ImgType,short>(img,block,stride,blockroi,roi);
+        else
+            CopyTIFFBlock<ImgType,unsigned short>(img,block,stride,blockroi,roi);
+        break;
+    case 32:
+        if (sformat==SAMPLEFORMAT_IEEEFP)
+            CopyTIFFBlock<ImgType,float>(img,block,stride,blockroi,roi);
+        else if (sformat==SAMPLEFORMAT_INT)
+            CopyTIFFBlock<ImgType,int>(img,block,stride,blockroi,roi);
+        else
+            CopyTIFFBlock<ImgType,unsigned int>(img,block,stride,blockroi,roi);
+        break;
+    default:
+        throw kipl::base::KiplException("Only 8, 16, and 32 bit TIFF images are supported in crop mode",__FILE__,__LINE__);
+    }
+}
+}
+
 /// \brief Writes an uncompressed TIFF image from any image data type (grayscale)
 ///	\param src the image to be stored
 ///	\param fname file name of the destination file (including extension .tif)
@@ -477,30 +563,25 @@ int ReadTIFF(kipl::base::TImage<ImgType,2> &src,const char *fname, size_t idx=0L
 	return bps;
 }
 
-/// \brief Reads the contents of a tiff file and stores the contents in the data type specified by the image
+/// \brief Reads a region of a tiff file and stores the contents in the data type specified by the image
+///
+/// Only the strips or tiles that intersect the region are decoded. They are decoded into the scratch buffer
+/// of the calling thread, and the crop and the conversion to the image type are done in one pass per block.
 ///	\param src the image to be stored
 ///	\param fname file name of the destination file (including extension .bmp)
-///	
-///	\return Error code 	
-///	\retval 0 The writing failed
-///	\retval 1 Successful 
+/// \param crop the region to read (x0, y0, x1, y1), the full image is read if crop is nullptr.
+/// \param idx index of the frame in a multi-frame file
+///
+///	\returns the number of bits per sample of the file
 template <class ImgType>
 int ReadTIFF(kipl::base::TImage<ImgType,2> &src,const char *fname, size_t const * const crop, size_t idx=0L)
 {
-    kipl::logging::Logger logger("ReadTIFF");
-
     if (crop==nullptr) {
         return ReadTIFF(src,fname,idx);
 	}
 	std::stringstream msg;
 	TIFF *image;
 	uint16 photo, spp, fillorder,bps, sformat;
-	tsize_t stripSize;
-	unsigned long imageOffset;
-
-	int stripMax;
-	unsigned char *buffer, tempbyte;
-	unsigned long bufferSize, count;
 
     TIFFSetWarningHandler(nullptr);
 	// Open the TIFF image
@@ -521,133 +602,99 @@ int ReadTIFF(kipl::base::TImage<ImgType,2> &src,const char *fname, size_t const
         throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
     }
 
-	// Check that it is of a type that we support
-	if((TIFFGetField(image, TIFFTAG_BITSPERSAMPLE, &bps) == 0) ){
-		throw kipl::base::KiplException("ReadTIFF: Either undefined or unsupported number of bits per pixel",__FILE__,__LINE__);
-	}
-	if((TIFFGetField(image, TIFFTAG_SAMPLEFORMAT, &sformat) == 0) ){
-		sformat=1; // Assuming unsigned integer data if unknown
-	}
-	if((TIFFGetField(image, TIFFTAG_SAMPLESPERPIXEL, &spp) == 0) || (spp != 1)){
-		throw kipl::base::KiplException("ReadTIFF: Either undefined or unsupported number of samples per pixel",__FILE__,__LINE__);
-	}
-
-	// Read in the possibly multiple strips
-	stripSize = TIFFStripSize (image);
-	stripMax = TIFFNumberOfStrips (image);
-	imageOffset = 0;
-
-	int dimx,dimy;
-	// We need to set some values for basic tags before we can add any data
-	TIFFGetField(image, TIFFTAG_IMAGEWIDTH,&dimx);
-	TIFFGetField(image, TIFFTAG_IMAGELENGTH, &dimy);
-    int adjcrop[4]={static_cast<int>(min(static_cast<size_t>(dimx),crop[0])),
-                    static_cast<int>(min(static_cast<size_t>(dimy),crop[1])),
-                    static_cast<int>(min(static_cast<size_t>(dimx),crop[2])),
-                    static_cast<int>(min(static_cast<size_t>(dimy),crop[3]))};
-	if ((adjcrop[2]-adjcrop[0])==0) kipl::base::KiplException("Failed to crop image in X",__FILE__,__LINE__);
-	if ((adjcrop[3]-adjcrop[1])==0) kipl::base::KiplException("Failed to crop image in Y",__FILE__,__LINE__);
-	
-    size_t imgdims[2]={static_cast<size_t>(adjcrop[2]-adjcrop[0]),static_cast<size_t>(adjcrop[3]-adjcrop[1])};
-
-	bufferSize = TIFFScanlineSize(image);
-	try {
-        if((buffer = new unsigned char[bufferSize]) == nullptr) {
-			msg.str("");
-			msg<<"Could not allocate"<<bufferSize<<" bytes for the uncompressed image";
-			throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
-		}
-	}
-	catch (std::bad_alloc & E) {
-		msg.str("");
-		msg<<"Could not allocate"<<bufferSize<<" bytes for the uncompressed image ("<<E.what()<<")";
-		throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
-	}
-	catch (kipl::base::KiplException &E) {
-		throw E;
-	}
-
-	src.Resize(imgdims);
-	for (int row=adjcrop[1]; row<adjcrop[3]; row++) {
-        if (TIFFReadScanline(image,static_cast<tdata_t>(buffer), row, 0)!=1) {
-			msg.str("");
-			msg<<"ReadTIFFLine: an error occurred during reading scan line "<<row;
-			TIFFClose(image);
-			throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
-		}
-		// Deal with photometric interpretations
-		if(TIFFGetField(image, TIFFTAG_PHOTOMETRIC, &photo) == 0){
-			throw kipl::base::KiplException("Image has an undefined photometric interpretation",__FILE__,__LINE__);
-		}
-		
-		if(photo == PHOTOMETRIC_MINISWHITE){
-			// Flip bits
-            std::clog<<"Fixing the photometric interpretation"<<std::endl;
-			
-			for(count = 0; count < bufferSize; count++)
-				buffer[count] = ~buffer[count];
-		}
-		
-		// Deal with fillorder
-		if(TIFFGetField(image, TIFFTAG_FILLORDER, &fillorder) == 0){
-			fillorder=FILLORDER_MSB2LSB;
-		}
-		
-		if(fillorder != FILLORDER_MSB2LSB){
-			// We need to swap bits -- ABCDEFGH becomes HGFEDCBA
-            logger(logger.LogVerbose,"Fixing the fillorder");
-			
-			for(count = 0; count < bufferSize; count++){
-				tempbyte = 0;
-                if(buffer[count] & 128) tempbyte += 1;
-                if(buffer[count] & 64) tempbyte += 2;
-                if(buffer[count] & 32) tempbyte += 4;
-                if(buffer[count] & 16) tempbyte += 8;
-                if(buffer[count] & 8) tempbyte += 16;
-                if(buffer[count] & 4) tempbyte += 32;
-                if(buffer[count] & 2) tempbyte += 64;
-                if(buffer[count] & 1) tempbyte += 128;
-				buffer[count] = tempbyte;
-			}
-		}
-
-		ImgType *pLine=src.GetLinePtr(row-adjcrop[1]);
-
-		switch (bps) {
-			case 32:
-				switch (sformat) {
-				case 1: // Unsigned integer
-					for (int i=adjcrop[0]; i<adjcrop[2]; i++)
-						pLine[i-adjcrop[0]]=static_cast<ImgType>((reinterpret_cast<int *>(buffer))[i]);
-					break;
-				case 2: // Signed integer
-					for (int i=adjcrop[0]; i<adjcrop[2]; i++)
-						pLine[i-adjcrop[0]]=static_cast<ImgType>((reinterpret_cast<unsigned int *>(buffer))[i]);
-					break;
-				case 3: // IEEE floating point
-					for (int i=adjcrop[0]; i<adjcrop[2]; i++)
-						pLine[i-adjcrop[0]]=static_cast<ImgType>((reinterpret_cast<float *>(buffer))[i]);
-					break;
-				default:
-					break;
-				}
-				break;
-			case 16:
-				for (int i=adjcrop[0]; i<adjcrop[2]; i++)
-					pLine[i-adjcrop[0]]=(reinterpret_cast<unsigned short *>(buffer))[i];
-				break;
-			case 8:	
-				for (int i=adjcrop[0]; i<adjcrop[2]; i++)
-					pLine[i-adjcrop[0]]=buffer[i];
-				break;
-			case 4:
-				TIFFClose(image);
-				delete [] buffer;
-				throw kipl::base::KiplException("4-bit TIFF images are not supported in crop mode",__FILE__,__LINE__);
-
-				break;
-			}
-	}
+    try {
+        // Check that it is of a type that we support
+        if((TIFFGetField(image, TIFFTAG_BITSPERSAMPLE, &bps) == 0) ){
+            throw kipl::base::KiplException("ReadTIFF: Either undefined or unsupported number of bits per pixel",__FILE__,__LINE__);
+        }
+        if((TIFFGetField(image, TIFFTAG_SAMPLEFORMAT, &sformat) == 0) ){
+            sformat=1; // Assuming unsigned integer data if unknown
+        }
+        if((TIFFGetField(image, TIFFTAG_SAMPLESPERPIXEL, &spp) == 0) || (spp != 1)){
+            throw kipl::base::KiplException("ReadTIFF: Either undefined or unsupported number of samples per pixel",__FILE__,__LINE__);
+        }
+        if ((bps!=8) && (bps!=16) && (bps!=32)) {
+            msg.str("");
+            msg<<bps<<"-bit TIFF images are not supported in crop mode";
+            throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+        }
+        // Deal with photometric interpretations
+        if(TIFFGetField(image, TIFFTAG_PHOTOMETRIC, &photo) == 0){
+            throw kipl::base::KiplException("Image has an undefined photometric interpretation",__FILE__,__LINE__);
+        }
+        if(TIFFGetField(image, TIFFTAG_FILLORDER, &fillorder) == 0){
+            fillorder=FILLORDER_MSB2LSB;
+        }
+        const bool bFixBits=(photo==PHOTOMETRIC_MINISWHITE) || (fillorder!=FILLORDER_MSB2LSB);
+
+        uint32 dimx=0,dimy=0;
+        TIFFGetField(image, TIFFTAG_IMAGEWIDTH,&dimx);
+        TIFFGetField(image, TIFFTAG_IMAGELENGTH, &dimy);
+        size_t adjcrop[4]={std::min(static_cast<size_t>(dimx),crop[0]),
+                           std::min(static_cast<size_t>(dimy),crop[1]),
+                           std::min(static_cast<size_t>(dimx),crop[2]),
+                           std::min(static_cast<size_t>(dimy),crop[3])};
+        if (adjcrop[2]<=adjcrop[0]) throw kipl::base::KiplException("Failed to crop image in X",__FILE__,__LINE__);
+        if (adjcrop[3]<=adjcrop[1]) throw kipl::base::KiplException("Failed to crop image in Y",__FILE__,__LINE__);
+
+        size_t imgdims[2]={adjcrop[2]-adjcrop[0],adjcrop[3]-adjcrop[1]};
+        src.Resize(imgdims);
+
+        std::vector<unsigned char> &buffer=TIFFScratchBuffer();
+        size_t blockroi[4];
+
+        if (TIFFIsTiled(image)) {
+            uint32 tileWidth=0, tileLength=0;
+            TIFFGetField(image, TIFFTAG_TILEWIDTH, &tileWidth);
+            TIFFGetField(image, TIFFTAG_TILELENGTH, &tileLength);
+            const tsize_t tileSize=TIFFTileSize(image);
+            const size_t stride=static_cast<size_t>(tileWidth)*bps/8;
+            buffer.resize(static_cast<size_t>(tileSize));
+
+            for (size_t ty=(adjcrop[1]/tileLength)*tileLength; ty<adjcrop[3]; ty+=tileLength) {
+                for (size_t tx=(adjcrop[0]/tileWidth)*tileWidth; tx<adjcrop[2]; tx+=tileWidth) {
+                    const ttile_t tile=TIFFComputeTile(image,static_cast<uint32>(tx),static_cast<uint32>(ty),0,0);
+                    if (TIFFReadEncodedTile(image,tile,buffer.data(),tileSize)==-1) {
+                        msg.str("");
+                        msg<<"Read error on input tile number "<<tile;
+                        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+                    }
+                    if (bFixBits)
+                        FixTIFFBits(buffer.data(),buffer.size(),photo,fillorder);
+
+                    blockroi[0]=tx; blockroi[1]=ty; blockroi[2]=tx+tileWidth; blockroi[3]=ty+tileLength;
+                    core::CopyTIFFBlock(src,buffer.data(),stride,blockroi,adjcrop,bps,sformat);
+                }
+            }
+        }
+        else {
+            uint32 rowsPerStrip=0;
+            TIFFGetFieldDefaulted(image, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+            rowsPerStrip=std::max(uint32(1),std::min(rowsPerStrip,dimy));
+            const tsize_t stripSize=TIFFStripSize(image);
+            const size_t stride=static_cast<size_t>(TIFFScanlineSize(image));
+            buffer.resize(static_cast<size_t>(stripSize));
+
+            for (size_t strip=adjcrop[1]/rowsPerStrip; strip*rowsPerStrip<adjcrop[3]; ++strip) {
+                tsize_t nBytes=TIFFReadEncodedStrip(image,static_cast<tstrip_t>(strip),buffer.data(),stripSize);
+                if (nBytes==-1) {
+                    msg.str("");
+                    msg<<"Read error on input strip number "<<strip;
+                    throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+                }
+                if (bFixBits)
+                    FixTIFFBits(buffer.data(),static_cast<size_t>(nBytes),photo,fillorder);
+
+                blockroi[0]=0;    blockroi[1]=strip*rowsPerStrip;
+                blockroi[2]=dimx; blockroi[3]=std::min(static_cast<size_t>(dimy),blockroi[1]+rowsPerStrip);
+                core::CopyTIFFBlock(src,buffer.data(),stride,blockroi,adjcrop,bps,sformat);
+            }
+        }
+    }
+    catch (...) {
+        TIFFClose(image);
+        throw;
+    }
     src.info.nBitsPerSample=bps;
 
 	char *tmpstr[1024];
@@ -680,8 +727,6 @@ int ReadTIFF(kipl::base::TImage<ImgType,2> &src,const char *fname, size_t const
 	}
 
 	TIFFClose(image);
-		
-	delete [] buffer;
 
 	return bps;
 }
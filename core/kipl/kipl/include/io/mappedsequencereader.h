@@ -0,0 +1,170 @@
+//<LICENCE>
+
+#ifndef MAPPEDSEQUENCEREADER_H
+#define MAPPEDSEQUENCEREADER_H
+
+#include "../kipl_global.h"
+
+#include <string>
+
+#include "../base/timage.h"
+#include "../base/kiplenums.h"
+#include "io_vivaseq.h"
+
+namespace kipl { namespace io {
+
+/// \brief Read-only memory map of a whole file.
+///
+/// The pages are loaded by the operating system when they are accessed, reading from the map needs no system
+/// calls and no intermediate copy.
+class KIPLSHARED_EXPORT MemoryMappedFile
+{
+public:
+    MemoryMappedFile();
+
+    /// \brief Maps the file
+    /// \param fname Name of the file to map
+    explicit MemoryMappedFile(const std::string &fname);
+
+    /// \brief Unmaps the file
+    ~MemoryMappedFile();
+
+    MemoryMappedFile(const MemoryMappedFile &) = delete;
+    MemoryMappedFile & operator=(const MemoryMappedFile &) = delete;
+
+    /// \brief Maps a file, a previously mapped file is unmapped.
+    /// \param fname Name of the file to map
+    /// \throws KiplException if the file can't be opened or mapped.
+    void open(const std::string &fname);
+
+    /// \brief Unmaps the file
+    void close();
+
+    /// \returns true if a file is mapped
+    bool isOpen() const;
+
+    /// \returns the name of the mapped file
+    const std::string & fileName() const;
+
+    /// \returns the first byte of the file
+    const unsigned char * data() const;
+
+    /// \returns the size of the file in bytes
+    size_t size() const;
+
+    /// \brief Tells the operating system that a range of the file will be read soon.
+    /// \param offset First byte of the range
+    /// \param length Number of bytes in the range
+    void willNeed(size_t offset, size_t length) const;
+
+private:
+    std::string m_sFileName;
+    unsigned char *m_pData;
+    size_t m_nSize;
+#ifdef _WIN32
+    void *m_hFile;
+    void *m_hMapping;
+#else
+    int m_nFile;
+#endif
+};
+
+/// \brief A frame, or a region of a frame, in a mapped file. The lines of the view are stride bytes apart.
+struct KIPLSHARED_EXPORT FrameView
+{
+    FrameView();
+
+    const unsigned char *data;          ///< The first pixel of the view
+    size_t dims[2];                     ///< Width and height of the view
+    size_t stride;                      ///< Number of bytes from one line to the next
+    kipl::base::eDataType dataType;     ///< The data type of the pixels
+
+    /// \returns a pointer to the first pixel of line y
+    const unsigned char * line(size_t y) const { return data+y*stride; }
+
+    /// \brief Converts the view to float with SIMD instructions, the lines are written one after the other.
+    /// \param dst Destination with room for dims[0]*dims[1] values
+    void convert(float *dst) const;
+};
+
+/// \brief Reads frames from ViVa SEQ files and raw detector dumps through a memory map.
+///
+/// The header is parsed once when the file is opened, the frames are then accessed as strided views of the map.
+/// Reading a frame or a cropped frame converts the pixels directly from the map into the image. Ranges of frames
+/// are extracted in parallel on the shared thread pool. The reader can be used from several threads once it is open.
+class KIPLSHARED_EXPORT MappedSequenceReader
+{
+public:
+    MappedSequenceReader();
+
+    MappedSequenceReader(const MappedSequenceReader &) = delete;
+    MappedSequenceReader & operator=(const MappedSequenceReader &) = delete;
+
+    /// \brief Opens a ViVa SEQ file and parses its header.
+    /// \param fname Name of the SEQ file
+    /// \throws KiplException if the file can't be mapped, or the header doesn't match the size of the file.
+    void openSEQ(const std::string &fname);
+
+    /// \brief Opens a file with raw frames stored one after the other.
+    /// \param fname Name of the raw file
+    /// \param dims Width and height of a frame
+    /// \param dataType Pixel data type, UInt8, UInt16, and Float32 are supported.
+    /// \param headerSize Number of bytes before the first frame
+    /// \param frameGap Number of bytes between two frames
+    /// \throws KiplException if the file can't be mapped or doesn't contain a complete frame.
+    void openRaw(const std::string &fname, const size_t *dims, kipl::base::eDataType dataType, size_t headerSize=0, size_t frameGap=0);
+
+    /// \brief Unmaps the file
+    void close();
+
+    /// \returns true if a file is open
+    bool isOpen() const;
+
+    /// \returns the name of the open file
+    const std::string & fileName() const;
+
+    /// \returns the SEQ header, the image size and number of frames are also set for raw files.
+    const ViVaSEQHeader & header() const;
+
+    /// \brief Gets the size of the sequence
+    /// \param dims Receives the frame width, the frame height, and the number of frames.
+    void getDims(size_t *dims) const;
+
+    /// \returns the number of frames in the file
+    size_t numberOfFrames() const;
+
+    /// \brief Gets a view of a frame without reading it
+    /// \param idx The frame index
+    /// \param roi Optional region (x0, y0, x1, y1) of the frame
+    /// \throws KiplException if the frame or the region is outside the sequence.
+    FrameView frame(size_t idx, size_t const * const roi=nullptr) const;
+
+    /// \brief Reads a frame as float
+    /// \param img Receives the frame, it is resized to the size of the region.
+    /// \param idx The frame index
+    /// \param roi Optional region (x0, y0, x1, y1) of the frame
+    void read(kipl::base::TImage<float,2> &img, size_t idx, size_t const * const roi=nullptr) const;
+
+    /// \brief Reads a range of frames as float, the frames are converted in parallel.
+    /// \param img Receives the frames, it is resized to the size of the region and the number of frames.
+    /// \param first The first frame
+    /// \param last One past the last frame
+    /// \param step Frame increment
+    /// \param roi Optional region (x0, y0, x1, y1) of the frames
+    void read(kipl::base::TImage<float,3> &img, size_t first, size_t last, size_t step=1, size_t const * const roi=nullptr) const;
+
+private:
+    void setLayout(size_t width, size_t height, kipl::base::eDataType dataType, size_t headerSize, size_t frameGap);
+
+    MemoryMappedFile m_File;
+    ViVaSEQHeader m_Header;
+    kipl::base::eDataType m_DataType;
+    size_t m_nBytesPerPixel;
+    size_t m_nHeaderSize;
+    size_t m_nFrameStride;  ///< Number of bytes from one frame to the next
+    size_t m_nFrames;
+};
+
+}}
+
+#endif // MAPPEDSEQUENCEREADER_H
@@ -0,0 +1,89 @@
+//<LICENCE>
+
+#ifndef NEXUSREADER_H
+#define NEXUSREADER_H
+
+#include "../kipl_global.h"
+
+#include <string>
+#include <memory>
+#include <mutex>
+
+#include "../base/timage.h"
+
+namespace kipl { namespace io {
+
+/// \returns the mutex that serializes the calls to the HDF5 library from the NeXus reader and writer classes.
+/// The library is not thread safe in its default build.
+KIPLSHARED_EXPORT std::mutex & NexusLibraryMutex();
+
+/// \brief Reads projections from the plottable data set of a NeXus file.
+///
+/// The file and the data set stay open between the read calls and the path to the data set
+/// (the field with the signal attribute in the NXdata group) is resolved once when the file is opened.
+/// The projections are read as contiguous hyperslabs in the data type of the file and converted in bulk to float.
+/// Float data is read directly into the image buffer. The reader is safe to use from several threads,
+/// the reads are serialized.
+///
+/// The class is always declared, without NeXus support open() throws an exception.
+class KIPLSHARED_EXPORT NexusReader
+{
+public:
+    NexusReader();
+
+    /// \brief Opens a file, see open()
+    /// \param fname File name of the NeXus file
+    NexusReader(const std::string &fname);
+
+    ~NexusReader();
+
+    NexusReader(const NexusReader &) = delete;
+    NexusReader & operator=(const NexusReader &) = delete;
+
+    /// \brief Opens a file and resolves the data set. A file that is already open is closed first.
+    /// \param fname File name of the NeXus file
+    /// \throws KiplException if the file can't be opened or doesn't contain plottable data.
+    void open(const std::string &fname);
+
+    /// \brief Closes the file
+    void close();
+
+    /// \returns true if a file is open
+    bool isOpen() const;
+
+    /// \returns the name of the open file or an empty string.
+    const std::string & fileName() const;
+
+    /// \returns the path of the data set in the file, e.g. /entry/data/data.
+    const std::string & datasetPath() const;
+
+    /// \returns the name of the data type of the data set, e.g. uint16.
+    std::string dataType() const;
+
+    /// \brief Gets the dimensions of the data set
+    /// \param dims Receives the image width, the image height, and the number of images.
+    void getDims(size_t *dims) const;
+
+    /// \brief Reads a projection
+    /// \param img Receives the projection
+    /// \param number Index of the projection in the data set
+    /// \param nCrop ROI to read (x0,y0,x1,y1), nullptr reads the whole projection.
+    /// \throws KiplException if the index or ROI is outside the data set or the read fails.
+    void read(kipl::base::TImage<float,2> &img, size_t number, size_t const * const nCrop=nullptr);
+
+    /// \brief Reads a range of projections with one hyperslab per block of projections
+    /// \param img Receives the projections, the third index is the projection index
+    /// \param first Index of the first projection
+    /// \param last One past the last projection
+    /// \param nCrop ROI to read (x0,y0,x1,y1), nullptr reads the whole projections.
+    /// \throws KiplException if the range or ROI is outside the data set or the read fails.
+    void read(kipl::base::TImage<float,3> &img, size_t first, size_t last, size_t const * const nCrop=nullptr);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+}}
+
+#endif // NEXUSREADER_H
@@ -0,0 +1,97 @@
+//<LICENCE>
+
+#ifndef NEXUSWRITER_H
+#define NEXUSWRITER_H
+
+#include "../kipl_global.h"
+
+#include <string>
+#include <memory>
+
+#include "../base/timage.h"
+
+namespace kipl { namespace io {
+
+/// \brief Writes a float volume to a NeXus file, block by block as the slices are produced.
+///
+/// The volume is stored in /entry/Data1/signal with the same layout as WriteNexusFloat, but the data set
+/// is chunked with one or a few image rows of a slice per chunk and can grow along the slice axis.
+/// The chunks are optionally shuffled and deflated. The compression of a block runs on the shared thread
+/// pool and the chunks are written with direct chunk writes from a background thread, write() only copies
+/// the block to the queue and returns. Files written with compression can be read by any HDF5 reader.
+///
+/// Without NeXus support create() throws an exception.
+class KIPLSHARED_EXPORT NexusVolumeWriter
+{
+public:
+    /// \brief Filters applied to the chunks
+    enum eCompression {
+        CompressionNone,            ///< Chunked, uncompressed data
+        CompressionDeflate,         ///< Deflate (zlib)
+        CompressionShuffleDeflate   ///< Byte shuffle followed by deflate, usually the best ratio for float data
+    };
+
+    NexusVolumeWriter();
+
+    /// \brief Waits for the pending blocks and closes the file. Errors are logged, call close() to receive them.
+    ~NexusVolumeWriter();
+
+    NexusVolumeWriter(const NexusVolumeWriter &) = delete;
+    NexusVolumeWriter & operator=(const NexusVolumeWriter &) = delete;
+
+    /// \brief Creates the file and the data set, an existing file is replaced.
+    /// \param fname File name of the NeXus file
+    /// \param dims Slice width, slice height, and the initial number of slices. The number of slices grows when slices beyond it are written.
+    /// \param pixelsize The voxel size in mm, it is stored in x_pixel_size.
+    /// \param compression Selects the filters applied to the chunks
+    /// \param level Deflate level 1-9, low levels are considerably faster.
+    /// \param nQueuedBlocks Number of blocks that can wait in the queue before write() blocks.
+    /// \throws KiplException if a file is already open or the file can't be created.
+    void create(const std::string &fname,
+                const size_t *dims,
+                float pixelsize,
+                eCompression compression=CompressionShuffleDeflate,
+                int level=1,
+                size_t nQueuedBlocks=2);
+
+    /// \brief Queues a block of slices for writing.
+    /// \param data The slices stored one after the other, the data is copied.
+    /// \param firstSlice Index of the first slice of the block in the volume
+    /// \param nSlices Number of slices in the block
+    /// \throws KiplException if no file is open or a previous block failed.
+    void write(const float *data, size_t firstSlice, size_t nSlices);
+
+    /// \brief Queues a block of XY slices for writing.
+    /// \param img The block, its slices must have the size given to create().
+    /// \param firstSlice Index of the first slice of the block in the volume
+    void write(const kipl::base::TImage<float,3> &img, size_t firstSlice);
+
+    /// \brief Queues a block of XY slices after the last queued slice.
+    /// \param img The block, its slices must have the size given to create().
+    void append(const kipl::base::TImage<float,3> &img);
+
+    /// \brief Waits until all queued blocks are written.
+    /// \throws KiplException if the writing of a block failed.
+    void flush();
+
+    /// \brief Writes the pending blocks and closes the file.
+    /// \throws KiplException if the writing of a block failed.
+    void close();
+
+    /// \returns true if a file is open
+    bool isOpen() const;
+
+    /// \returns the number of slices written to the file.
+    size_t writtenSlices() const;
+
+    /// \returns the ratio between the raw size and the stored size of the written chunks.
+    double compressionRatio() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+}}
+
+#endif // NEXUSWRITER_H
@@ -11,6 +11,28 @@
 #include <string>
 #include <list>
 #include <mutex>
+#include <atomic>
+
+/// \brief The most verbose log level that is compiled into the code.
+/// Messages above this level are removed by the compiler when the KIPL_LOG macro is used.
+/// The value follows the Logger::LogLevel enum, i.e. 0=error ... 4=debug.
+#ifndef KIPL_LOGLEVEL_MAX
+#define KIPL_LOGLEVEL_MAX 4
+#endif
+
+/// \brief Log a streamed message only if the level is enabled.
+/// The message expression is not evaluated when the level is disabled, which makes it cheap to use in loops.
+/// \param lg A Logger instance
+/// \param level The log level of the message
+/// \param expr A stream expression, e.g. "Processing slice "<<i
+#define KIPL_LOG(lg, level, expr) \
+    do { \
+        if (kipl::logging::Logger::IsEnabled(level)) { \
+            std::ostringstream kipl_log_msg_; \
+            kipl_log_msg_<<expr; \
+            (lg)(level,kipl_log_msg_.str()); \
+        } \
+    } while (false)
 
 namespace kipl {
 /// \brief This namespace collects classes related to the handling of log messages.
@@ -57,14 +79,45 @@ public:
 	/// \param s stream for the output
 	Logger(std::string str, std::ostream &s=std::cout); 
 	
-	/// \brief Set the global log target for all logging objects
+	/// \brief Adds a log target that receives the messages from all logging objects.
+	/// The first target added replaces the default console target, further targets are added to the list of targets.
 	/// \param lw A log writer object
+	/// \returns The number of active log targets
 	static size_t AddLogTarget(LogWriter & lw);
 
+	/// \brief Removes a log target from the list of targets. This must be called before a log target is destroyed while the logger still may be used.
+	/// The console target is restored if the list becomes empty.
+	/// \param lw The log writer to remove
+	/// \returns The number of active log targets
+	static size_t RemoveLogTarget(LogWriter & lw);
+
+	/// \brief Access to the default console log target, e.g. to log to console and file at the same time.
+	static LogWriter & ConsoleTarget();
+
+	/// \brief Starts a background thread that writes the messages to the targets.
+	/// Messages are passed through a lock-free queue, the calling threads never wait for the log targets.
+	/// If the queue is full the message is written directly by the calling thread.
+	/// \param queueSize Number of messages that can be buffered
+	static void StartAsyncLogging(size_t queueSize=4096);
+
+	/// \brief Writes all pending messages and stops the background thread. Logging continues synchronously.
+	static void StopAsyncLogging();
+
+	/// \brief Waits until all queued messages are written to the targets.
+	static void Flush();
+
+	/// \brief Checks if a message with a given level will be written
+	/// \param severity The log level to test
+	/// \returns true if messages at this level are written
+	static bool IsEnabled(LogLevel severity)
+	{
+		return (static_cast<int>(severity)<=KIPL_LOGLEVEL_MAX) && (severity<=CurrentLogLevel.load(std::memory_order_relaxed));
+	}
+
 
 	/// \brief Set the global log level
 	static void SetLogLevel(LogLevel level);
-    static kipl::logging::Logger::LogLevel GetLogLevel() { return CurrentLogLevel; }
+    static kipl::logging::Logger::LogLevel GetLogLevel() { return CurrentLogLevel.load(); }
 	
 	/// \brief Log a message
 	/// \param severity The log level of the current log message
@@ -88,14 +141,14 @@ protected:
 	/// \param s The log level of the current log message
 	/// \param message A string containing the message
 	static void WriteMessage(LogLevel s, std::string message);
-#ifdef MULTITARGETS
-    /// \brief
-    static std::list<LogWriter *> LogTargets;   //!< Refence to the global log target. Experimental approach to allow several log targets. It is still not stable
-#else
-    static LogWriter * LogTarget;   //!< Refence to the global log target single log target case
-#endif
-    static LogLevel CurrentLogLevel; //!< The current global log level
-    static std::mutex m_LoggerMutex; ///< A mutex to protect against simultaneous writing from several threads.
+
+	/// \brief Sends a formatted message to all log targets
+	/// \param message The formatted message
+	static void WriteToTargets(const std::string &message);
+
+    static std::list<LogWriter *> LogTargets;   //!< The global log targets
+    static std::atomic<LogLevel> CurrentLogLevel; //!< The current global log level
+    static std::mutex m_LoggerMutex; ///< A mutex to protect the log targets against simultaneous writing from several threads.
 
     std::string sLogOrigin; //!< The name of the current log space. Every class that use a logger instance should tell what their name is to improve the quality of the message.
 };
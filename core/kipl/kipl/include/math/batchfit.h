@@ -0,0 +1,175 @@
+//<LICENCE>
+
+#ifndef BATCHFIT_H
+#define BATCHFIT_H
+
+#include "../kipl_global.h"
+
+#include <cstddef>
+#include <array>
+#include <string>
+#include <iostream>
+
+namespace Nonlinear {
+
+/// \brief The outcome of one fit in a batch
+enum eFitStatus {
+    FitConverged,       ///< The chi-square stopped decreasing within the tolerance
+    FitMaxIterations,   ///< The iteration limit was reached, the parameters are the best found
+    FitSingular,        ///< The normal equations could not be solved, e.g. a parameter doesn't affect the model
+    FitInvalidData      ///< The data has non-finite values or fewer points than free parameters
+};
+
+/// \brief Gaussian A*exp(-((x-m)/s)^2) with analytic derivatives, the parameters are ordered as in SumOfGaussians(1)
+struct KIPLSHARED_EXPORT GaussianModel
+{
+    static const int NPars=3;
+
+    /// \brief Computes the model value and the partial derivatives
+    /// \param x The argument
+    /// \param a The parameters A, m, s
+    /// \param dyda Receives the derivatives with respect to the parameters
+    /// \returns the model value
+    double operator()(double x, const double *a, double *dyda) const;
+};
+
+/// \brief Lorenzian g/(pi*(x^2+g^2)) with analytic derivative, the parameter is ordered as in Lorenzian
+struct KIPLSHARED_EXPORT LorenzianModel
+{
+    static const int NPars=1;
+
+    /// \brief Computes the model value and the derivative
+    /// \param x The argument
+    /// \param a The parameter g
+    /// \param dyda Receives the derivative with respect to g
+    /// \returns the model value
+    double operator()(double x, const double *a, double *dyda) const;
+};
+
+/// \brief Voight profile A*exp(-gamma*|x-m|-sigma*(x-m)^2/2) with analytic derivatives, the parameters are ordered as in Voight
+struct KIPLSHARED_EXPORT VoightModel
+{
+    static const int NPars=4;
+
+    /// \brief Computes the model value and the partial derivatives
+    /// \param x The argument
+    /// \param a The parameters A, m, gamma, sigma
+    /// \param dyda Receives the derivatives with respect to the parameters
+    /// \returns the model value
+    double operator()(double x, const double *a, double *dyda) const;
+};
+
+/// \brief Adds central difference derivatives to a model that only computes values
+///
+/// The value function is called as fn(x,a) and returns the model value, the step of parameter i is step*max(|a_i|,1).
+/// \tparam Fn The value function
+/// \tparam N Number of parameters
+template <class Fn, int N>
+class NumericalJacobian
+{
+public:
+    static const int NPars=N;
+
+    /// \param fn The value function
+    /// \param step The relative step of the central differences
+    NumericalJacobian(const Fn &fn=Fn(), double step=1e-6);
+
+    /// \brief Computes the model value and the partial derivatives
+    double operator()(double x, const double *a, double *dyda) const;
+
+private:
+    Fn m_fn;
+    double m_fStep;
+};
+
+/// \brief Levenberg-Marquardt fitting of many independent data sets with the same model
+///
+/// The iterations follow LevenbergMarquardt, i.e. the diagonal of the normal equations is scaled by 1+lambda and a fit
+/// has converged after the chi-square changed less than the tolerance in four steps. The normal equations are held in fixed-size arrays
+/// on the stack and solved by a Cholesky factorization, there are no allocations during a fit. The data sets are fitted in parallel on the thread pool.
+///
+/// A model provides the number of parameters as the constant NPars and the operator double operator()(double x, const double *a, double *dyda) const
+/// that returns the model value and writes the NPars derivatives. Models without analytic derivatives can be wrapped by NumericalJacobian.
+/// \tparam Model The fit model
+template <class Model>
+class BatchLevenbergMarquardt
+{
+public:
+    static const int NPars=Model::NPars;
+
+    /// \param tol The tolerance of the chi-square change
+    /// \param iterations The largest number of iterations of a fit
+    /// \param model The fit model
+    BatchLevenbergMarquardt(double tol=1e-3, int iterations=2500, const Model &model=Model());
+
+    void setTolerance(double t);
+    void setIterations(int N) { maxIterations=N; }
+    double getTolerance() const {return tol;}
+
+    /// \brief Keeps a parameter at its initial value in all fits
+    /// \param i Index of the parameter
+    void hold(int i);
+
+    /// \brief Makes a held parameter free again
+    /// \param i Index of the parameter
+    void free(int i);
+
+    /// \returns true if the parameter is fitted
+    bool isFree(int i) const;
+
+    /// \brief Fits one data set
+    /// \param x The arguments, N values
+    /// \param N Number of data points
+    /// \param y The data, N values
+    /// \param sig The standard deviations of the data, null gives unit weights
+    /// \param pars The initial parameters, they are replaced by the fitted parameters
+    /// \param chisq Receives the final chi-square
+    /// \param iterations Receives the number of iterations
+    /// \returns the fit status
+    eFitStatus fit(const double *x, size_t N, const double *y, const double *sig, double *pars, double &chisq, int &iterations) const;
+
+    /// \brief Fits many data sets that share the arguments
+    /// \param x The arguments, N values
+    /// \param N Number of data points of each data set
+    /// \param y The data sets stored one after the other, nFits*N values
+    /// \param sig The standard deviations stored like y, null gives unit weights
+    /// \param nFits Number of data sets
+    /// \param pars The initial parameters stored one set after the other, nFits*NPars values. They are replaced by the fitted parameters.
+    /// \param status Receives the status of each fit
+    /// \param chisq Receives the chi-square of each fit, it can be null
+    /// \param iterations Receives the number of iterations of each fit, it can be null
+    void fit(const double *x, size_t N, const double *y, const double *sig, size_t nFits,
+             double *pars, eFitStatus *status, double *chisq=nullptr, int *iterations=nullptr) const;
+
+protected:
+    typedef std::array<double,NPars> Vector;
+    typedef std::array<double,NPars*NPars> Matrix;
+
+    /// \brief Computes the normal equations of the free parameters and the chi-square
+    /// \returns false if the chi-square is not finite
+    bool normalEquations(const double *x, size_t N, const double *y, const double *sig, const double *a,
+                         Matrix &alpha, Vector &beta, double &chisq) const;
+
+    /// \brief Solves the damped normal equations by a Cholesky factorization
+    /// \returns false if the matrix isn't positive definite
+    bool solve(const Matrix &alpha, const Vector &beta, double lambda, Vector &da) const;
+
+    static const int NDONE=4; ///< Number of small chi-square changes before a fit has converged
+
+    Model m_model;
+    double tol;
+    int maxIterations;
+    std::array<bool,NPars> m_free;
+    std::array<int,NPars> m_freeIndex; ///< Indices of the free parameters
+    int mfit;                          ///< Number of free parameters
+};
+
+}
+
+void KIPLSHARED_EXPORT string2enum(const std::string &str, Nonlinear::eFitStatus &status);
+std::string KIPLSHARED_EXPORT enum2string(Nonlinear::eFitStatus status);
+std::ostream KIPLSHARED_EXPORT & operator<<(std::ostream &s, Nonlinear::eFitStatus status);
+
+#include "core/batchfit.hpp"
+
+#endif // BATCHFIT_H
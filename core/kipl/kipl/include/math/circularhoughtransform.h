@@ -1,12 +1,22 @@
 #ifndef CIRCULARHOUGHTRANSFORM_H
 #define CIRCULARHOUGHTRANSFORM_H
 
+#include <vector>
+
 #include "../kipl_global.h"
 #include "../base/timage.h"
 #include "../logging/logger.h"
 
 namespace kipl { namespace math {
 
+/// \brief A local maximum of the radius-stacked Hough accumulator
+struct KIPLSHARED_EXPORT CircularHoughPeak {
+    float x;        ///< Column of the circle center
+    float y;        ///< Row of the circle center
+    float radius;   ///< Radius with the strongest response at the center
+    float value;    ///< Accumulator value
+};
+
 class KIPLSHARED_EXPORT CircularHoughTransform
 {
     kipl::logging::Logger logger;
@@ -14,11 +24,45 @@ public:
     CircularHoughTransform();
 
     kipl::base::TImage<float,2> operator()(kipl::base::TImage<float,2> img, float diameter, bool useDerivative=false);
+
+    /// \brief Computes the transform for a list of radii in the frequency domain.
+    ///
+    /// The spectrum of the mirror padded image is computed once, the ring kernels of the radii are transformed and
+    /// inverted in batches. The slices are equal to the single radius transform except near the image edges.
+    /// \param img The image to transform
+    /// \param radii The ring radii in pixels
+    /// \param useDerivative Transforms the gradient magnitude instead of the image
+    /// \returns the accumulator with one slice per radius in the order of radii
+    /// \throws KiplException if the radius list is empty or contains non positive radii
+    kipl::base::TImage<float,3> operator()(const kipl::base::TImage<float,2> &img, const std::vector<float> &radii, bool useDerivative=false);
+
+    /// \returns the radii of the last multi-radius transform
+    const std::vector<float> & radii() const {return m_Radii;}
+
+    /// \brief Locates circles in a radius-stacked accumulator.
+    ///
+    /// Each pixel takes the radius with the largest response. The local maxima of the resulting map are sorted
+    /// by value, maxima closer than minDistance to a stronger maximum are suppressed.
+    /// \param chm Accumulator computed by the multi-radius transform
+    /// \param maxPeaks The largest number of peaks to return
+    /// \param minDistance Smallest distance between two centers in pixels
+    /// \returns the peaks in descending order of value
+    std::vector<CircularHoughPeak> findPeaks(const kipl::base::TImage<float,3> &chm, size_t maxPeaks, float minDistance) const;
+
 private:
     void buildKernel(float radius);
     void absDerivative(bool useDerivative);
+
+    /// \brief Draws a normalized ring kernel with its center at the origin of a periodic buffer
+    /// \param radius The ring radius
+    /// \param kernel The buffer, it is cleared before drawing
+    /// \param nx Row length of the buffer
+    /// \param ny Number of rows in the buffer
+    static void buildPeriodicKernel(float radius, float *kernel, size_t nx, size_t ny);
+
     kipl::base::TImage<float,2> m_Img;
     kipl::base::TImage<float,2> ringKernel;
+    std::vector<float> m_Radii;
 };
 }}
 #endif // CIRCULARHOUGHTRANSFORM_H
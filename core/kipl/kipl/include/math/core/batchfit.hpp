@@ -0,0 +1,269 @@
+//<LICENCE>
+
+#ifndef BATCHFIT_HPP
+#define BATCHFIT_HPP
+
+#include <cmath>
+#include <algorithm>
+
+#include "../../base/KiplException.h"
+#include "../../utilities/threadpool.h"
+
+namespace Nonlinear {
+
+namespace core {
+
+/// Number of fits that a task of the parallel batch processes
+const size_t cBatchFitGrain = 16;
+
+/// Upper limit of the damping, a larger damping gives steps below the precision of the parameters
+const double cBatchFitMaxLambda = 1e30;
+
+}
+
+template <class Fn, int N>
+NumericalJacobian<Fn,N>::NumericalJacobian(const Fn &fn, double step) :
+    m_fn(fn),
+    m_fStep(step)
+{}
+
+template <class Fn, int N>
+double NumericalJacobian<Fn,N>::operator()(double x, const double *a, double *dyda) const
+{
+    std::array<double,N> p;
+    std::copy_n(a,N,p.begin());
+
+    for (int i=0; i<N; ++i) {
+        const double h=m_fStep*std::max(std::abs(a[i]),1.0);
+        p[i]=a[i]+h;
+        const double yp=m_fn(x,p.data());
+        p[i]=a[i]-h;
+        const double ym=m_fn(x,p.data());
+        p[i]=a[i];
+        dyda[i]=(yp-ym)/(2*h);
+    }
+
+    return m_fn(x,a);
+}
+
+template <class Model>
+BatchLevenbergMarquardt<Model>::BatchLevenbergMarquardt(double tol, int iterations, const Model &model) :
+    m_model(model),
+    tol(std::abs(tol)),
+    maxIterations(iterations),
+    mfit(NPars)
+{
+    m_free.fill(true);
+    for (int i=0; i<NPars; ++i)
+        m_freeIndex[i]=i;
+}
+
+template <class Model>
+void BatchLevenbergMarquardt<Model>::setTolerance(double t)
+{
+    tol=std::abs(t);
+}
+
+template <class Model>
+void BatchLevenbergMarquardt<Model>::hold(int i)
+{
+    if ((i<0) || (NPars<=i))
+        throw kipl::base::KiplException("The parameter index is out of range",__FILE__,__LINE__);
+
+    m_free[i]=false;
+
+    mfit=0;
+    for (int j=0; j<NPars; ++j)
+        if (m_free[j])
+            m_freeIndex[mfit++]=j;
+}
+
+template <class Model>
+void BatchLevenbergMarquardt<Model>::free(int i)
+{
+    if ((i<0) || (NPars<=i))
+        throw kipl::base::KiplException("The parameter index is out of range",__FILE__,__LINE__);
+
+    m_free[i]=true;
+
+    mfit=0;
+    for (int j=0; j<NPars; ++j)
+        if (m_free[j])
+            m_freeIndex[mfit++]=j;
+}
+
+template <class Model>
+bool BatchLevenbergMarquardt<Model>::isFree(int i) const
+{
+    return (0<=i) && (i<NPars) && m_free[i];
+}
+
+template <class Model>
+bool BatchLevenbergMarquardt<Model>::normalEquations(const double *x, size_t N, const double *y, const double *sig, const double *a,
+                                                     Matrix &alpha, Vector &beta, double &chisq) const
+{
+    alpha.fill(0.0);
+    beta.fill(0.0);
+    chisq=0.0;
+
+    Vector dyda;
+    for (size_t i=0; i<N; ++i) {
+        const double ymod=m_model(x[i],a,dyda.data());
+        const double sig2i= sig==nullptr ? 1.0 : 1.0/(sig[i]*sig[i]);
+        const double dy=y[i]-ymod;
+
+        for (int j=0; j<mfit; ++j) {
+            const double wt=dyda[m_freeIndex[j]]*sig2i;
+            for (int k=0; k<=j; ++k)
+                alpha[j*NPars+k]+=wt*dyda[m_freeIndex[k]];
+            beta[j]+=dy*wt;
+        }
+        chisq+=dy*dy*sig2i;
+    }
+
+    for (int j=1; j<mfit; ++j) // Fill in the symmetric side
+        for (int k=0; k<j; ++k)
+            alpha[k*NPars+j]=alpha[j*NPars+k];
+
+    return std::isfinite(chisq);
+}
+
+template <class Model>
+bool BatchLevenbergMarquardt<Model>::solve(const Matrix &alpha, const Vector &beta, double lambda, Vector &da) const
+{
+    Matrix L;
+
+    // Cholesky factorization of the damped matrix, only the lower triangle is used
+    for (int j=0; j<mfit; ++j) {
+        double d=alpha[j*NPars+j]*(1.0+lambda);
+        for (int k=0; k<j; ++k)
+            d-=L[j*NPars+k]*L[j*NPars+k];
+
+        if (!(0.0<d) || !std::isfinite(d))
+            return false;
+
+        L[j*NPars+j]=std::sqrt(d);
+
+        for (int i=j+1; i<mfit; ++i) {
+            double s=alpha[i*NPars+j];
+            for (int k=0; k<j; ++k)
+                s-=L[i*NPars+k]*L[j*NPars+k];
+            L[i*NPars+j]=s/L[j*NPars+j];
+        }
+    }
+
+    for (int i=0; i<mfit; ++i) { // L*z=beta
+        double s=beta[i];
+        for (int k=0; k<i; ++k)
+            s-=L[i*NPars+k]*da[k];
+        da[i]=s/L[i*NPars+i];
+    }
+
+    for (int i=mfit-1; 0<=i; --i) { // L'*da=z
+        double s=da[i];
+        for (int k=i+1; k<mfit; ++k)
+            s-=L[k*NPars+i]*da[k];
+        da[i]=s/L[i*NPars+i];
+    }
+
+    return true;
+}
+
+template <class Model>
+eFitStatus BatchLevenbergMarquardt<Model>::fit(const double *x, size_t N, const double *y, const double *sig,
+                                               double *pars, double &chisq, int &iterations) const
+{
+    iterations=0;
+    chisq=0.0;
+
+    if (N<static_cast<size_t>(mfit))
+        return FitInvalidData;
+
+    for (size_t i=0; i<N; ++i) {
+        if (!std::isfinite(x[i]) || !std::isfinite(y[i]))
+            return FitInvalidData;
+        if ((sig!=nullptr) && (!std::isfinite(sig[i]) || !(0.0<sig[i])))
+            return FitInvalidData;
+    }
+
+    Vector a;
+    std::copy_n(pars,NPars,a.begin());
+
+    Matrix alpha;
+    Vector beta;
+    if (!normalEquations(x,N,y,sig,a.data(),alpha,beta,chisq))
+        return FitInvalidData;
+
+    if (mfit==0)
+        return FitConverged;
+
+    Matrix tryAlpha;
+    Vector tryBeta;
+    Vector da;
+    double lambda=0.001;
+    int done=0;
+
+    for (iterations=0; iterations<maxIterations; ++iterations) {
+        if (done==NDONE) {
+            std::copy(a.begin(),a.end(),pars);
+            return FitConverged;
+        }
+
+        if (!solve(alpha,beta,lambda,da)) {
+            if (core::cBatchFitMaxLambda<=lambda) {
+                std::copy(a.begin(),a.end(),pars);
+                return FitSingular;
+            }
+            lambda=std::min(10.0*lambda,core::cBatchFitMaxLambda);
+            continue;
+        }
+
+        Vector atry=a;
+        for (int j=0; j<mfit; ++j)
+            atry[m_freeIndex[j]]+=da[j];
+
+        double tryChisq=0.0;
+        const bool finite=normalEquations(x,N,y,sig,atry.data(),tryAlpha,tryBeta,tryChisq);
+
+        if (finite && (std::abs(tryChisq-chisq)<std::max(tol,tol*tryChisq)))
+            done++;
+
+        if (finite && (tryChisq<chisq)) { // Success, accept the new solution
+            lambda=std::max(0.1*lambda,1.0/core::cBatchFitMaxLambda);
+            chisq=tryChisq;
+            alpha=tryAlpha;
+            beta=tryBeta;
+            a=atry;
+        }
+        else { // Failure, increase the damping
+            lambda=std::min(10.0*lambda,core::cBatchFitMaxLambda);
+        }
+    }
+
+    std::copy(a.begin(),a.end(),pars);
+
+    return done==NDONE ? FitConverged : FitMaxIterations;
+}
+
+template <class Model>
+void BatchLevenbergMarquardt<Model>::fit(const double *x, size_t N, const double *y, const double *sig, size_t nFits,
+                                         double *pars, eFitStatus *status, double *chisq, int *iterations) const
+{
+    kipl::utilities::ThreadPool::global().parallel_for(0,nFits,
+        [&](size_t first, size_t last) {
+            for (size_t i=first; i<last; ++i) {
+                double c=0.0;
+                int it=0;
+                status[i]=fit(x,N,y+i*N,sig==nullptr ? nullptr : sig+i*N,pars+i*NPars,c,it);
+
+                if (chisq!=nullptr)
+                    chisq[i]=c;
+                if (iterations!=nullptr)
+                    iterations[i]=it;
+            }
+        },core::cBatchFitGrain);
+}
+
+}
+
+#endif // BATCHFIT_HPP
@@ -4,148 +4,236 @@
 #include <cmath>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 
 #include "../../base/KiplException.h"
+#include "../../utilities/threadpool.h"
 
 namespace kipl {
 namespace math {
 
+/// Number of doubles in the centred block of a thread, the block stays in the cache during the rank-k update
+const size_t cCovarianceBlockCapacity = 32768;
+
+/// Number of matrix rows that are updated together by the rank-k update
+const size_t cCovarianceRowTile = 8;
+
 template<typename T>
 Covariance<T>::Covariance() :
     logger("Covariance"),
-    m_pData(NULL),
     m_nVars(0),
-    m_nElements(0),
-    m_fMean(NULL),
+    m_nCount(0),
+    m_bCenter(true),
     m_eResultMatrixType(CovarianceMatrix)
 {}
 
 template<typename T>
 Covariance<T>::~Covariance()
 {
-    DeallocateData();
 }
 
 template<typename T>
 TNT::Array2D<double> Covariance<T>::compute(T *data, size_t nElements, size_t nVars, bool bCenter)
 {
-    m_nVars=nVars;
-    m_pData=data;
-    TNT::Array2D<double> cov(m_nVars,m_nVars);
+    reset(nVars,bCenter);
+    accumulate(data,nElements);
 
-    if (bCenter)
-        ComputeStatistics();
+    return result();
+}
 
-    for (int i=0; i<m_nVars; i++) {
-        for (int j=i; j<m_nVars; j++) {
-            cov[j][i]=cov[i][j]=ComputePairSum(i,j);
-        }
-    }
+template<typename T>
+TNT::Array2D<double> Covariance<T>::compute(T *data, const size_t *dims, size_t Ndims, bool bCenter)
+{
+    size_t nElements=dims[0];
 
-    NormalizeMatrix(cov);
-    return cov;
+    for (size_t i=1; i<(Ndims-1); i++)
+        nElements*=dims[i];
+
+    return compute(data,nElements,dims[Ndims-1],bCenter);
 }
 
 template<typename T>
-TNT::Array2D<double> Covariance<T>::compute(T *data, const size_t *dims, size_t Ndims, bool bCenter)
+void Covariance<T>::reset(size_t nVars, bool bCenter)
 {
-    m_nVars=dims[Ndims-1];
-    m_pData=data;
-    TNT::Array2D<double> cov(m_nVars,m_nVars);
+    m_nVars   = nVars;
+    m_bCenter = bCenter;
+    m_nCount  = 0;
+    m_Mean.assign(nVars,0.0);
+    m_CoMoment.assign(nVars*nVars,0.0);
+}
 
-    m_nElements=dims[0];
+template<typename T>
+void Covariance<T>::accumulate(const T *data, size_t nElements, size_t varStride)
+{
+    if (m_nVars==0)
+        throw kipl::base::KiplException("The covariance computation must be reset before accumulating data",__FILE__,__LINE__);
 
-    for (size_t i=1; i<(Ndims-1); i++)
-        m_nElements*=dims[i];
-
-    if (bCenter)
-        ComputeStatistics();
-
-    for (int i=0; i<m_nVars; i++) {
-        for (int j=i; j<m_nVars; j++) {
-            if (i==j)
-                cov[i][j]=ComputePairSum(i,j,bCenter);
-            else {
-                cov[i][j]=ComputePairSum(i,j,bCenter);
-                cov[j][i]=cov[i][j];
+    if (nElements==0)
+        return;
+
+    if (varStride==0)
+        varStride=nElements;
+
+    const size_t blockSize = std::max(size_t(16),cCovarianceBlockCapacity/m_nVars);
+    const size_t nBlocks   = (nElements+blockSize-1)/blockSize;
+
+    // One partial per worker, each covers a contiguous range of blocks. The ranges only depend on the pool size
+    // and are merged in order, which makes the result independent of the scheduling.
+    kipl::utilities::ThreadPool &pool=kipl::utilities::ThreadPool::global();
+    const size_t nPartials = std::min(nBlocks,pool.size());
+    std::vector<Moments> partials(nPartials);
+
+    pool.parallel_for(0,nPartials,
+        [&](size_t first, size_t last) {
+            std::vector<double> block(blockSize*m_nVars);
+
+            for (size_t p=first; p<last; ++p) {
+                Moments &moments=partials[p];
+                moments.n=0;
+                moments.mean.assign(m_nVars,0.0);
+                moments.C.assign(m_nVars*m_nVars,0.0);
+
+                const size_t lastBlock=(p+1)*nBlocks/nPartials;
+                for (size_t b=p*nBlocks/nPartials; b<lastBlock; ++b) {
+                    const size_t offset=b*blockSize;
+                    addBlock(data+offset,std::min(blockSize,nElements-offset),varStride,block,moments);
+                }
             }
-        }
-    }
+        },1);
+
+    Moments total;
+    total.n=m_nCount;
+    total.mean.swap(m_Mean);
+    total.C.swap(m_CoMoment);
+    for (const auto &partial : partials)
+        merge(total,partial);
+
+    m_nCount=total.n;
+    m_Mean.swap(total.mean);
+    m_CoMoment.swap(total.C);
+}
+
+template<typename T>
+TNT::Array2D<double> Covariance<T>::result() const
+{
+    if (m_nCount==0)
+        throw kipl::base::KiplException("The covariance matrix needs at least one observation",__FILE__,__LINE__);
+
+    TNT::Array2D<double> cov(static_cast<int>(m_nVars),static_cast<int>(m_nVars));
+
+    for (size_t i=0; i<m_nVars; ++i)
+        for (size_t j=i; j<m_nVars; ++j)
+            cov[j][i]=cov[i][j]=m_CoMoment[i*m_nVars+j];
 
     NormalizeMatrix(cov);
     return cov;
 }
 
-template <typename T>
-double Covariance<T>::ComputePairSum(int a,int b, bool bCenter)
+template<typename T>
+void Covariance<T>::addBlock(const T *data, size_t n, size_t varStride, std::vector<double> &block, Moments &moments) const
 {
-    double sum=0.0;
+    const size_t nVars=m_nVars;
+    std::vector<double> blockMean(nVars,0.0);
 
-    T *pA=m_pData+m_nElements*a;
-    T *pB=m_pData+m_nElements*b;
+    // Transposes the block to one row per observation, the variables of an observation are contiguous
+    for (size_t v=0; v<nVars; ++v) {
+        const T *pVar=data+v*varStride;
 
-    if (bCenter) {
-        double ma=m_fMean[a];
-        double mb=m_fMean[b];
+        double m=0.0;
+        if (m_bCenter) {
+            for (size_t e=0; e<n; ++e)
+                m+=static_cast<double>(pVar[e]);
+            m/=static_cast<double>(n);
+            blockMean[v]=m;
+        }
 
+        double *pBlock=block.data()+v;
+        for (size_t e=0; e<n; ++e)
+            pBlock[e*nVars]=static_cast<double>(pVar[e])-m;
+    }
 
-        for (int i=0; i<m_nElements; i++) {
-            sum+=(pA[i]-ma)*(pB[i]-mb);
+    // Rank-k update of the upper triangle. A tile of matrix rows stays in the cache while the observations
+    // of the block stream past it, two observations are added per pass to halve the loads and stores of the matrix.
+    for (size_t i0=0; i0<nVars; i0+=cCovarianceRowTile) {
+        const size_t i1=std::min(nVars,i0+cCovarianceRowTile);
+        size_t e=0;
+        for (; e+1<n; e+=2) {
+            const double *row0=block.data()+e*nVars;
+            const double *row1=row0+nVars;
+            for (size_t i=i0; i<i1; ++i) {
+                const double a0=row0[i];
+                const double a1=row1[i];
+                double *pC=moments.C.data()+i*nVars;
+                for (size_t j=i; j<nVars; ++j)
+                    pC[j]+=a0*row0[j]+a1*row1[j];
+            }
         }
-    }
-    else {
-        for (int i=0; i<m_nElements; i++) {
-            sum+=pA[i]*pB[i];
+
+        if (e<n) {
+            const double *row=block.data()+e*nVars;
+            for (size_t i=i0; i<i1; ++i) {
+                const double a=row[i];
+                double *pC=moments.C.data()+i*nVars;
+                for (size_t j=i; j<nVars; ++j)
+                    pC[j]+=a*row[j];
+            }
         }
     }
 
-    return sum;
-}
+    if (m_bCenter) {
+        const double nA=static_cast<double>(moments.n);
+        const double nB=static_cast<double>(n);
+        const double f=nA*nB/(nA+nB);
 
-template <typename T>
-void Covariance<T>::AllocateData()
-{
-    DeallocateData();
+        for (size_t i=0; i<nVars; ++i) {
+            const double di=blockMean[i]-moments.mean[i];
+            double *pC=moments.C.data()+i*nVars;
+            for (size_t j=i; j<nVars; ++j)
+                pC[j]+=f*di*(blockMean[j]-moments.mean[j]);
+        }
+
+        for (size_t i=0; i<nVars; ++i)
+            moments.mean[i]+=(blockMean[i]-moments.mean[i])*nB/(nA+nB);
+    }
 
-    m_fMean=new double[m_nElements];
+    moments.n+=n;
 }
 
-template <typename T>
-void Covariance<T>::DeallocateData()
+template<typename T>
+void Covariance<T>::merge(Moments &a, const Moments &b) const
 {
-    if (m_fMean!=NULL)
-        delete [] m_fMean;
-    m_fMean=NULL;
-}
+    if (b.n==0)
+        return;
 
+    const size_t nVars=m_nVars;
+    const double nA=static_cast<double>(a.n);
+    const double nB=static_cast<double>(b.n);
+    const double f=m_bCenter ? nA*nB/(nA+nB) : 0.0;
 
-template <typename T>
-void Covariance<T>::ComputeStatistics()
-{
-    AllocateData();
-
-    double dElements=static_cast<double>(m_nElements);
-    for (int i=0; i<m_nVars; i++)
-    {
-        double sum=0.0;
-        T* d=m_pData+i*m_nElements;
-        for (int j=0; j<m_nElements; j++) {
-            double dd=static_cast<double>(d[j]);
-            sum+=dd;
-        }
-        m_fMean[i]=sum/dElements;
+    for (size_t i=0; i<nVars; ++i) {
+        const double di=b.mean[i]-a.mean[i];
+        double *pC=a.C.data()+i*nVars;
+        const double *pB=b.C.data()+i*nVars;
+        for (size_t j=i; j<nVars; ++j)
+            pC[j]+=pB[j]+f*di*(b.mean[j]-a.mean[j]);
     }
+
+    if (m_bCenter)
+        for (size_t i=0; i<nVars; ++i)
+            a.mean[i]+=(b.mean[i]-a.mean[i])*nB/(nA+nB);
+
+    a.n+=b.n;
 }
 
 template<typename T>
-void Covariance<T>::NormalizeMatrix(TNT::Array2D<double> &mat)
+void Covariance<T>::NormalizeMatrix(TNT::Array2D<double> &mat) const
 {
     double scale;
     switch (m_eResultMatrixType) {
     case CovarianceMatrix:
-        scale=1.0/double(m_nElements);
-        for (int i=0 ; i<m_nVars; i++) {
-            for (int j=i ; j<m_nVars; j++) {
+        scale=1.0/double(m_nCount);
+        for (int i=0 ; i<mat.dim1(); i++) {
+            for (int j=i ; j<mat.dim2(); j++) {
                 if (i==j)
                     mat[i][j]*=scale;
                 else {
@@ -157,8 +245,8 @@ void Covariance<T>::NormalizeMatrix(TNT::Array2D<double> &mat)
     break;
 
     case CorrelationMatrix:
-        for (int i=0 ; i<m_nVars; i++) {
-            for (int j=i ; j<m_nVars; j++) {
+        for (int i=0 ; i<mat.dim1(); i++) {
+            for (int j=i ; j<mat.dim2(); j++) {
                 if (i!=j) {
                     scale=1.0/std::sqrt(mat[i][i]*mat[j][j]);
                     mat[i][j]*=scale;
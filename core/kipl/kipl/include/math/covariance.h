@@ -4,6 +4,7 @@
 #define COVARIANCE_H
 
 #include "../kipl_global.h"
+#include <vector>
 #include <tnt_array2d.h>
 
 #include "../logging/logger.h"
@@ -19,6 +20,14 @@ typedef enum {
 
 
 /// \brief A class to compute the covariance matrix for several data sets
+///
+/// The matrix is computed in a single pass over the data. The observations are processed in blocks, each block is
+/// centred with its own mean and added to the matrix as a rank-k update. The blocks are merged with the pairwise
+/// update of the mean and the co-moments (Chan et al.), which avoids the cancellation of the textbook formula.
+/// The blocks are split in one contiguous range per worker of the thread pool. Each range accumulates a partial matrix and the
+/// partial matrices are merged in range order, the result therefore does not depend on the scheduling of the threads.
+///
+/// Large data sets can be added in chunks using reset, accumulate and result.
 template<typename T>
 class Covariance {
     kipl::logging::Logger logger;
@@ -42,6 +51,29 @@ public:
     /// \param bCenter subtract the average value from each variable before computing the covariance matrix.
     TNT::Array2D<double> compute(T *data, const size_t *dims, size_t Ndims, bool bCenter=true);
 
+    /// \brief Starts a chunked computation and clears the accumulated data
+    /// \param nVars number of stochastic variables
+    /// \param bCenter subtract the average value from each variable before computing the covariance matrix.
+    void reset(size_t nVars, bool bCenter=true);
+
+    /// \brief Adds a chunk of observations to the chunked computation
+    /// \param data The first observation of the first variable
+    /// \param nElements Number of observations of each variable in the chunk
+    /// \param varStride Distance between the first observations of two variables, 0 means nElements.
+    /// A chunk of a stack of images can therefore be passed without copying it.
+    /// \throws KiplException if reset wasn't called
+    void accumulate(const T *data, size_t nElements, size_t varStride=0);
+
+    /// \returns the normalized matrix of the accumulated observations
+    /// \throws KiplException if there are no observations
+    TNT::Array2D<double> result() const;
+
+    /// \returns the number of accumulated observations per variable
+    size_t count() const {return m_nCount;}
+
+    /// \returns the mean value of each variable, it is only computed when the data is centred.
+    const std::vector<double> & mean() const {return m_Mean;}
+
     /// \brief Setter for the covariance matrix type
     /// \param m Type value
     void setResultMatrixType(eCovarianceType m) {m_eResultMatrixType = m;}
@@ -49,16 +81,31 @@ public:
     /// \brief Getter for covariance matrix type
     eCovarianceType getResultMatrixType() {return m_eResultMatrixType;}
 protected:
-    double ComputePairSum(int a, int b, bool bCenter);
-    void AllocateData();
-    void DeallocateData();
-    void ComputeStatistics();
-    void NormalizeMatrix(TNT::Array2D<double> &mat);
-
-    T *m_pData;
-    int m_nVars;
-    int m_nElements;
-    double *m_fMean;
+    /// \brief Partial result of a range of observations
+    struct Moments {
+        size_t n;                   ///< Number of observations
+        std::vector<double> mean;   ///< Mean of each variable
+        std::vector<double> C;      ///< Upper triangle of the co-moment matrix in row major order
+    };
+
+    /// \brief Adds the observations of a block to the moments
+    /// \param data First observation of the block
+    /// \param n Number of observations in the block
+    /// \param varStride Distance between two variables
+    /// \param block Buffer for the centred block with n x nVars elements
+    /// \param moments The moments that are updated
+    void addBlock(const T *data, size_t n, size_t varStride, std::vector<double> &block, Moments &moments) const;
+
+    /// \brief Merges the moments b into a
+    void merge(Moments &a, const Moments &b) const;
+
+    void NormalizeMatrix(TNT::Array2D<double> &mat) const;
+
+    size_t m_nVars;
+    size_t m_nCount;
+    bool m_bCenter;
+    std::vector<double> m_Mean;
+    std::vector<double> m_CoMoment;
     eCovarianceType m_eResultMatrixType;
 };
 
@@ -0,0 +1,74 @@
+//<LICENSE>
+
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include "../kipl_global.h"
+
+#include <cstddef>
+#include <string>
+#include <iostream>
+#include <limits>
+
+namespace kipl { namespace math {
+
+/// \brief Accuracy tiers of the array versions of log and exp.
+///
+/// The errors are given in units in the last place (ulp) of the exact result. They were measured over all
+/// single precision arguments in the valid range with SSE2, AVX2 and AVX-512.
+enum eMathAccuracy {
+    ExactMath,      ///< Calls logf and expf of the C library for each element, below 1 ulp
+    PreciseMath,    ///< SIMD polynomials of the Cephes library, below 1.1 ulp for log and exp
+    FastMath        ///< SIMD polynomials of lower degree, below 200 ulp for log and 70 ulp for exp (relative error below 2.5e-5)
+};
+
+/// \brief The instruction sets used by the array functions
+enum eSIMDInstructionSet {
+    SIMDScalar,     ///< Plain C++, used on processors without SSE2 and for the exact tier
+    SIMDSSE2,       ///< SSE2, four elements per instruction
+    SIMDAVX2,       ///< AVX2 with FMA, eight elements per instruction
+    SIMDAVX512      ///< AVX-512F, sixteen elements per instruction
+};
+
+/// \returns the instruction set used by the array functions. The best set supported by the processor is selected at the first call.
+KIPLSHARED_EXPORT eSIMDInstructionSet simdInstructionSet();
+
+/// \brief Limits the instruction set used by the array functions, mainly for tests and benchmarks.
+/// \param set The requested instruction set, sets that the processor doesn't support are replaced by the best supported set.
+/// \returns the instruction set that will be used
+KIPLSHARED_EXPORT eSIMDInstructionSet setSIMDInstructionSet(eSIMDInstructionSet set);
+
+/// \returns the best instruction set supported by the processor
+KIPLSHARED_EXPORT eSIMDInstructionSet supportedSIMDInstructionSet();
+
+/// \brief Computes the natural logarithm of an array.
+/// \param src The arguments
+/// \param dst Receives the logarithms, it can be the same array as src.
+/// \param N Number of elements
+/// \param accuracy Selects the implementation
+/// \param minValue Lower limit of the arguments, smaller arguments including zero, negative values and NaN are replaced by minValue. Limits below the smallest normal float are raised to the smallest normal float.
+/// \note The arguments are also limited to the largest finite float, the result is always finite.
+void KIPLSHARED_EXPORT logArray(const float *src, float *dst, size_t N,
+                                eMathAccuracy accuracy=PreciseMath,
+                                float minValue=std::numeric_limits<float>::min());
+
+/// \brief Computes the exponential of an array.
+/// \param src The arguments
+/// \param dst Receives the exponentials, it can be the same array as src.
+/// \param N Number of elements
+/// \param accuracy Selects the implementation
+/// \note The arguments are limited to [log(FLT_MIN), log(FLT_MAX)] and NaN is replaced by the lower limit, the result is always finite and positive.
+void KIPLSHARED_EXPORT expArray(const float *src, float *dst, size_t N,
+                                eMathAccuracy accuracy=PreciseMath);
+
+}}
+
+void KIPLSHARED_EXPORT string2enum(const std::string &str, kipl::math::eMathAccuracy &accuracy);
+std::string KIPLSHARED_EXPORT enum2string(kipl::math::eMathAccuracy accuracy);
+std::ostream KIPLSHARED_EXPORT & operator<<(std::ostream &s, kipl::math::eMathAccuracy accuracy);
+
+void KIPLSHARED_EXPORT string2enum(const std::string &str, kipl::math::eSIMDInstructionSet &set);
+std::string KIPLSHARED_EXPORT enum2string(kipl::math::eSIMDInstructionSet set);
+std::ostream KIPLSHARED_EXPORT & operator<<(std::ostream &s, kipl::math::eSIMDInstructionSet set);
+
+#endif // FASTMATH_H
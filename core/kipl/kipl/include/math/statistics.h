@@ -75,6 +75,13 @@ namespace math {
         Statistics();
         /// Copy constructor
         Statistics(const Statistics &s);
+        /// \brief Initializes the statistics with sums that were computed elsewhere
+        /// \param n Number of items
+        /// \param sum Sum of the items
+        /// \param sum2 Square sum of the items
+        /// \param minval The smallest item
+        /// \param maxval The largest item
+        Statistics(size_t n, double sum, double sum2, double minval, double maxval);
 
         Statistics & operator=(const Statistics &s);
 
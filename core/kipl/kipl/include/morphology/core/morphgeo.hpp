@@ -11,6 +11,7 @@
 #include "../morphology.h"
 #include "../morphfilters.h"
 #include "../pixeliterator.h"
+#include "../morphreconstruction.h"
 
 using namespace std;
 
@@ -429,6 +430,30 @@ kipl::base::TImage<ImgType,NDimG> RecByErosion(const kipl::base::TImage<ImgType,
     return temp;
 }
 
+template <typename ImgType>
+kipl::base::TImage<ImgType,2> RecByDilation(const kipl::base::TImage<ImgType,2> &g,
+        const kipl::base::TImage<ImgType,2> &f,
+        kipl::base::eConnectivity conn)
+{
+    kipl::base::TImage<ImgType,2> temp;
+    temp.Clone(f);
+    ReconstructByDilation(temp,g,conn);
+
+    return temp;
+}
+
+template <typename ImgType>
+kipl::base::TImage<ImgType,2> RecByErosion(const kipl::base::TImage<ImgType,2> &g,
+        const kipl::base::TImage<ImgType,2> &f,
+        kipl::base::eConnectivity conn)
+{
+    kipl::base::TImage<ImgType,2> temp;
+    temp.Clone(f);
+    ReconstructByErosion(temp,g,conn);
+
+    return temp;
+}
+
 /// \brief Removes the objects that are connected to the edge of the image
 ///	\param img Input image
 ///	\param conn Connectivity of the reconstruction
@@ -0,0 +1,633 @@
+//<LICENCE>
+
+#ifndef MORPHRECONSTRUCTION_HPP
+#define MORPHRECONSTRUCTION_HPP
+
+#include <vector>
+#include <cmath>
+#include <utility>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <sstream>
+#include <cstdint>
+#include <cstddef>
+
+#include "../../base/timage.h"
+#include "../../base/KiplException.h"
+#include "../../utilities/threadpool.h"
+
+namespace kipl { namespace morphology { namespace core {
+
+/// \brief Ordering used by the reconstruction by erosion, low values propagate into high values.
+template <typename T>
+struct ErosionOrder {
+    /// \returns true if the value a can propagate into a pixel with the value b
+    static bool precedes(T a, T b) { return a<b; }
+    /// \returns the propagated value v limited by the mask value m
+    static T bound(T v, T m) { return v<m ? m : v; }
+    /// \returns a value that never propagates and is never changed
+    static T neutral() { return std::numeric_limits<T>::max(); }
+    /// \returns a value that propagates before all other values
+    static T first() { return std::numeric_limits<T>::lowest(); }
+};
+
+/// \brief Ordering used by the reconstruction by dilation, high values propagate into low values.
+template <typename T>
+struct DilationOrder {
+    static bool precedes(T a, T b) { return b<a; }
+    static T bound(T v, T m) { return m<v ? m : v; }
+    static T neutral() { return std::numeric_limits<T>::lowest(); }
+    static T first() { return std::numeric_limits<T>::max(); }
+};
+
+/// \returns true if the value is NaN, always false for integer types
+template <typename T>
+inline bool isNaN(T v) { return v!=v; }
+
+/// \returns false if the value is NaN or infinite, always true for integer types
+template <typename T>
+inline bool isFinite(T v) { return (v-v)==T(0); }
+
+/// \brief A 2D buffer with a one pixel frame around the image. The frame removes all edge tests from the inner loops.
+template <typename T>
+class PaddedImage
+{
+public:
+    PaddedImage() : nx(0), ny(0), stride(0) {}
+
+    /// \brief Allocates the buffer for an image
+    /// \param dims The dimensions of the image without frame
+    void resize(const size_t *dims) { resize(dims[0],dims[1]); }
+
+    /// \brief Allocates the buffer for an image
+    /// \param _nx Number of columns without frame
+    /// \param _ny Number of rows without frame
+    void resize(size_t _nx, size_t _ny)
+    {
+        nx=_nx;
+        ny=_ny;
+        stride=nx+2;
+        data.resize(stride*(ny+2));
+    }
+
+    /// \brief Sets all pixels to a value
+    void fill(T val) { std::fill(data.begin(),data.end(),val); }
+
+    /// \brief Copies an image into the inner part of the buffer
+    void copyFrom(const kipl::base::TImage<T,2> &img)
+    {
+        for (size_t y=0; y<ny; ++y)
+            std::copy_n(img.GetLinePtr(y),nx,&data[(y+1)*stride+1]);
+    }
+
+    /// \brief Copies the inner part of the buffer to an image
+    void copyTo(kipl::base::TImage<T,2> &img) const
+    {
+        for (size_t y=0; y<ny; ++y)
+            std::copy_n(&data[(y+1)*stride+1],nx,img.GetLinePtr(y));
+    }
+
+    /// \brief Sets the frame to a value
+    void setFrame(T val)
+    {
+        std::fill_n(data.begin(),stride,val);
+        std::fill_n(data.begin()+(ny+1)*stride,stride,val);
+        for (size_t y=1; y<=ny; ++y) {
+            data[y*stride]=val;
+            data[y*stride+nx+1]=val;
+        }
+    }
+
+    /// \returns the index of the pixel in the padded buffer
+    ptrdiff_t index(size_t x, size_t y) const { return static_cast<ptrdiff_t>((y+1)*stride+x+1); }
+
+    size_t nx;
+    size_t ny;
+    size_t stride;
+    std::vector<T> data;
+};
+
+/// \brief Neighbourhood offsets in a padded buffer
+struct ReconstructionNeighborhood
+{
+    ReconstructionNeighborhood(size_t stride, kipl::base::eConnectivity conn)
+    {
+        const ptrdiff_t s=static_cast<ptrdiff_t>(stride);
+        switch (conn) {
+        case kipl::base::conn4 :
+            up   = {-s};
+            down = {s};
+            break;
+        case kipl::base::conn8 :
+            up   = {-s-1, -s, -s+1};
+            down = {s-1, s, s+1};
+            break;
+        default :
+            throw kipl::base::KiplException("Morphological reconstruction only supports conn4 and conn8",__FILE__,__LINE__);
+        }
+
+        all.push_back(-1);
+        all.push_back(1);
+        all.insert(all.end(),up.begin(),up.end());
+        all.insert(all.end(),down.begin(),down.end());
+    }
+
+    std::vector<ptrdiff_t> up;      ///< Neighbours on the previous row
+    std::vector<ptrdiff_t> down;    ///< Neighbours on the next row
+    std::vector<ptrdiff_t> all;     ///< The full neighbourhood
+};
+
+inline int reconstructionThreads(int nThreads)
+{
+    return nThreads<1 ? static_cast<int>(kipl::utilities::ThreadPool::global().size()) : nThreads;
+}
+
+/// \brief Forward and backward raster scans of the hybrid algorithm on the rows [y0,y1) of the padded buffer.
+/// Rows outside the stripe are only used if they belong to the frame, therefore stripes can be processed concurrently.
+template <typename T, class Order>
+void rasterScanStripe(PaddedImage<T> &marker, const PaddedImage<T> &mask,
+                      const ReconstructionNeighborhood &NG, size_t y0, size_t y1)
+{
+    T *pm=marker.data.data();
+    const T *pk=mask.data.data();
+    const size_t nx=marker.nx;
+
+    for (size_t y=y0; y<y1; ++y) {
+        const bool useUp = (y!=y0) || (y0==1);
+        ptrdiff_t p=static_cast<ptrdiff_t>(y*marker.stride+1);
+        for (size_t x=0; x<nx; ++x, ++p) {
+            T v=pm[p];
+            if (Order::precedes(pm[p-1],v)) v=pm[p-1];
+            if (useUp) {
+                for (const auto &o : NG.up)
+                    if (Order::precedes(pm[p+o],v)) v=pm[p+o];
+            }
+            pm[p]=Order::bound(v,pk[p]);
+        }
+    }
+
+    for (size_t y=y1; y-->y0; ) {
+        const bool useDown = (y!=y1-1) || (y1==marker.ny+1);
+        ptrdiff_t p=static_cast<ptrdiff_t>(y*marker.stride+nx);
+        for (size_t x=0; x<nx; ++x, --p) {
+            T v=pm[p];
+            if (Order::precedes(pm[p+1],v)) v=pm[p+1];
+            if (useDown) {
+                for (const auto &o : NG.down)
+                    if (Order::precedes(pm[p+o],v)) v=pm[p+o];
+            }
+            pm[p]=Order::bound(v,pk[p]);
+        }
+    }
+}
+
+/// \brief Collects the pixels of a stripe that can still propagate into a neighbour.
+template <typename T, class Order>
+void collectFrontier(const PaddedImage<T> &marker, const PaddedImage<T> &mask,
+                     const ReconstructionNeighborhood &NG, size_t y0, size_t y1,
+                     std::vector<ptrdiff_t> &frontier)
+{
+    const T *pm=marker.data.data();
+    const T *pk=mask.data.data();
+
+    for (size_t y=y0; y<y1; ++y) {
+        ptrdiff_t p=static_cast<ptrdiff_t>(y*marker.stride+1);
+        for (size_t x=0; x<marker.nx; ++x, ++p) {
+            const T v=pm[p];
+            for (const auto &o : NG.all) {
+                const ptrdiff_t q=p+o;
+                if (Order::precedes(v,pm[q]) && (pm[q]!=pk[q])) {
+                    frontier.push_back(p);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/// \brief Hybrid reconstruction on padded buffers.
+/// The frame of both buffers must be set to Order::neutral().
+template <typename T, class Order>
+void hybridReconstruction(PaddedImage<T> &marker, const PaddedImage<T> &mask,
+                          kipl::base::eConnectivity conn, int nThreads)
+{
+    ReconstructionNeighborhood NG(marker.stride,conn);
+
+    const int nStripes=std::max(1,std::min(reconstructionThreads(nThreads),static_cast<int>(marker.ny/16)));
+    std::vector<std::vector<ptrdiff_t>> stripeFrontier(nStripes);
+
+    // The stripes run on the shared pool, callers that already are pool workers nest without extra threads.
+    kipl::utilities::ThreadPool::global().parallel_for(0,nStripes,[&](size_t first, size_t last)
+    {
+        for (size_t i=first; i<last; ++i) {
+            const size_t y0=1+(marker.ny*i)/nStripes;
+            const size_t y1=1+(marker.ny*(i+1))/nStripes;
+            rasterScanStripe<T,Order>(marker,mask,NG,y0,y1);
+        }
+    },1);
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,nStripes,[&](size_t first, size_t last)
+    {
+        for (size_t i=first; i<last; ++i) {
+            const size_t y0=1+(marker.ny*i)/nStripes;
+            const size_t y1=1+(marker.ny*(i+1))/nStripes;
+            collectFrontier<T,Order>(marker,mask,NG,y0,y1,stripeFrontier[i]);
+        }
+    },1);
+
+    std::vector<ptrdiff_t> frontier;
+    for (auto &sf : stripeFrontier)
+        frontier.insert(frontier.end(),sf.begin(),sf.end());
+
+    // Wavefront propagation, each round processes the pixels changed in the previous round.
+    T *pm=marker.data.data();
+    const T *pk=mask.data.data();
+    std::vector<ptrdiff_t> next;
+    next.reserve(frontier.size());
+    while (!frontier.empty()) {
+        next.clear();
+        for (const auto &p : frontier) {
+            const T v=pm[p];
+            for (const auto &o : NG.all) {
+                const ptrdiff_t q=p+o;
+                const T mq=pm[q];
+                if (Order::precedes(v,mq) && (mq!=pk[q])) {
+                    pm[q]=Order::bound(v,pk[q]);
+                    next.push_back(q);
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+}
+
+/// \brief Floods the image from its edge with one bucket per grey level. Used for 8 and 16 bit images.
+template <typename T, class Order>
+void bucketFillExtrema(PaddedImage<T> &result, const PaddedImage<T> &mask, kipl::base::eConnectivity conn)
+{
+    ReconstructionNeighborhood NG(mask.stride,conn);
+
+    T lo=std::numeric_limits<T>::max();
+    T hi=std::numeric_limits<T>::lowest();
+    for (size_t y=0; y<mask.ny; ++y) {
+        const T *pLine=&mask.data[mask.index(0,y)];
+        for (size_t x=0; x<mask.nx; ++x) {
+            lo=std::min(lo,pLine[x]);
+            hi=std::max(hi,pLine[x]);
+        }
+    }
+
+    // The key maps the grey levels such that the flooding always proceeds with increasing key
+    auto key = [lo,hi](T v) -> size_t {
+        return Order::precedes(lo,hi) ? static_cast<size_t>(v-lo) : static_cast<size_t>(hi-v);
+    };
+
+    std::vector<std::vector<ptrdiff_t>> buckets(static_cast<size_t>(hi-lo)+1);
+    std::vector<unsigned char> done(mask.data.size(),0);
+
+    for (size_t y=0; y<mask.ny+2; ++y)
+        for (size_t x=0; x<mask.stride; ++x)
+            if ((y==0) || (y==mask.ny+1) || (x==0) || (x==mask.nx+1))
+                done[y*mask.stride+x]=1;
+
+    T *pr=result.data.data();
+    const T *pk=mask.data.data();
+
+    auto seed = [&](ptrdiff_t p) {
+        if (done[p]==0) {
+            done[p]=1;
+            pr[p]=pk[p];
+            buckets[key(pk[p])].push_back(p);
+        }
+    };
+
+    for (size_t x=0; x<mask.nx; ++x) {
+        seed(mask.index(x,0));
+        seed(mask.index(x,mask.ny-1));
+    }
+    for (size_t y=1; y+1<mask.ny; ++y) {
+        seed(mask.index(0,y));
+        seed(mask.index(mask.nx-1,y));
+    }
+
+    for (size_t k=0; k<buckets.size(); ++k) {
+        for (size_t i=0; i<buckets[k].size(); ++i) {
+            const ptrdiff_t p=buckets[k][i];
+            const T v=pr[p];
+            for (const auto &o : NG.all) {
+                const ptrdiff_t q=p+o;
+                if (done[q]==0) {
+                    done[q]=1;
+                    pr[q]=Order::bound(v,pk[q]);
+                    buckets[key(pr[q])].push_back(q);
+                }
+            }
+        }
+        std::vector<ptrdiff_t>().swap(buckets[k]);
+    }
+}
+
+/// \brief Priority queue for floods where the pushed keys never precede the key of the last popped item.
+///
+/// The range of the grey levels is split in buckets of equal width. The bucket of the current level is a heap,
+/// the later buckets are plain arrays that are turned into heaps when the flood reaches them. The items are popped
+/// in the same key order as from a single heap, but most pushes are appends and the heaps stay small.
+template <typename T, class Order>
+class HierarchicalQueue
+{
+public:
+    typedef std::pair<T,ptrdiff_t> Item;
+
+    /// \brief Prepares the buckets
+    /// \param lo The lowest finite grey level of the image
+    /// \param hi The highest finite grey level of the image
+    /// \param nBuckets Number of buckets, keys outside [lo,hi] go to the first or last bucket
+    HierarchicalQueue(T lo, T hi, size_t nBuckets) :
+        m_Buckets(std::max(nBuckets,size_t(1))),
+        m_nCurrent(0),
+        m_fOrigin(Order::precedes(lo,hi) ? static_cast<double>(lo) : static_cast<double>(hi)),
+        m_fScale(0.0)
+    {
+        const double range=std::abs(static_cast<double>(hi)-static_cast<double>(lo));
+        if (0.0<range)
+            m_fScale=static_cast<double>(m_Buckets.size()-1)/range;
+    }
+
+    /// \brief Adds an item, its key must not precede the key of the last popped item
+    void push(const Item &item)
+    {
+        const size_t b=std::max(bucket(item.first),m_nCurrent);
+        m_Buckets[b].push_back(item);
+        if (b==m_nCurrent)
+            std::push_heap(m_Buckets[b].begin(),m_Buckets[b].end(),later);
+    }
+
+    /// \returns true if there are no more items, otherwise the next item is moved to the top of the current bucket
+    bool empty()
+    {
+        while (m_Buckets[m_nCurrent].empty()) {
+            std::vector<Item>().swap(m_Buckets[m_nCurrent]);
+            if (m_nCurrent+1==m_Buckets.size())
+                return true;
+            ++m_nCurrent;
+            std::make_heap(m_Buckets[m_nCurrent].begin(),m_Buckets[m_nCurrent].end(),later);
+        }
+
+        return false;
+    }
+
+    /// \returns the item with the first key, empty() must be called before
+    const Item & top() const { return m_Buckets[m_nCurrent].front(); }
+
+    /// \brief Removes the item with the first key
+    void pop()
+    {
+        std::pop_heap(m_Buckets[m_nCurrent].begin(),m_Buckets[m_nCurrent].end(),later);
+        m_Buckets[m_nCurrent].pop_back();
+    }
+
+private:
+    static bool later(const Item &a, const Item &b) { return Order::precedes(b.first,a.first); }
+
+    /// \returns the bucket of a key, the mapping is monotone in the order of the flood
+    size_t bucket(T v) const
+    {
+        const double d=std::abs(static_cast<double>(v)-m_fOrigin)*m_fScale;
+        if (!(0.0<d) || Order::precedes(v,static_cast<T>(m_fOrigin)))
+            return 0;
+
+        return d<static_cast<double>(m_Buckets.size()-1) ? static_cast<size_t>(d) : m_Buckets.size()-1;
+    }
+
+    std::vector<std::vector<Item>> m_Buckets;
+    size_t m_nCurrent;
+    double m_fOrigin;
+    double m_fScale;
+};
+
+/// \brief Floods the image from its edge in the order of the grey levels using a hierarchical queue. Used for all other types.
+///
+/// NaN pixels keep their value and pass the level of the flood on to their neighbours. NaN pixels on the edge enter
+/// the queue with the first key of the order, i.e. they do not limit their neighbours, the keys are therefore never NaN.
+template <typename T, class Order>
+void queueFillExtrema(PaddedImage<T> &result, const PaddedImage<T> &mask, kipl::base::eConnectivity conn)
+{
+    ReconstructionNeighborhood NG(mask.stride,conn);
+
+    T lo=std::numeric_limits<T>::max();
+    T hi=std::numeric_limits<T>::lowest();
+    for (size_t y=0; y<mask.ny; ++y) {
+        const T *pLine=&mask.data[mask.index(0,y)];
+        for (size_t x=0; x<mask.nx; ++x) {
+            if (isFinite(pLine[x])) {
+                lo=std::min(lo,pLine[x]);
+                hi=std::max(hi,pLine[x]);
+            }
+        }
+    }
+    if (hi<lo)
+        lo=hi=T(0);
+
+    // About 16 pixels per bucket on average, the number of buckets is limited to keep the empty buckets cheap
+    HierarchicalQueue<T,Order> queue(lo,hi,std::min(mask.nx*mask.ny/16+1,size_t(1)<<16));
+
+    std::vector<unsigned char> done(mask.data.size(),0);
+    for (size_t y=0; y<mask.ny+2; ++y)
+        for (size_t x=0; x<mask.stride; ++x)
+            if ((y==0) || (y==mask.ny+1) || (x==0) || (x==mask.nx+1))
+                done[y*mask.stride+x]=1;
+
+    T *pr=result.data.data();
+    const T *pk=mask.data.data();
+
+    auto seed = [&](ptrdiff_t p) {
+        if (done[p]==0) {
+            done[p]=1;
+            pr[p]=pk[p];
+            queue.push(std::make_pair(isNaN(pk[p]) ? Order::first() : pk[p],p));
+        }
+    };
+
+    for (size_t x=0; x<mask.nx; ++x) {
+        seed(mask.index(x,0));
+        seed(mask.index(x,mask.ny-1));
+    }
+    for (size_t y=1; y+1<mask.ny; ++y) {
+        seed(mask.index(0,y));
+        seed(mask.index(mask.nx-1,y));
+    }
+
+    std::vector<ptrdiff_t> plateau;
+    while (!queue.empty()) {
+        const typename HierarchicalQueue<T,Order>::Item item=queue.top();
+        queue.pop();
+
+        // Pixels on a plateau at the current level are expanded without the queue
+        plateau.clear();
+        plateau.push_back(item.second);
+        for (size_t i=0; i<plateau.size(); ++i) {
+            const ptrdiff_t p=plateau[i];
+            for (const auto &o : NG.all) {
+                const ptrdiff_t q=p+o;
+                if (done[q]==0) {
+                    done[q]=1;
+                    const T r=Order::bound(item.first,pk[q]);
+                    pr[q]=r;
+                    if (r==item.first)
+                        plateau.push_back(q);
+                    else
+                        queue.push(std::make_pair(r,q));
+                }
+            }
+        }
+    }
+
+    for (size_t y=0; y<mask.ny; ++y) {
+        for (size_t x=0; x<mask.nx; ++x) {
+            const ptrdiff_t p=mask.index(x,y);
+            if (isNaN(pk[p]))
+                pr[p]=pk[p];
+        }
+    }
+}
+
+template <typename T, class Order>
+void fillExtrema(PaddedImage<T> &result, const PaddedImage<T> &mask, kipl::base::eConnectivity conn, std::true_type)
+{
+    bucketFillExtrema<T,Order>(result,mask,conn);
+}
+
+template <typename T, class Order>
+void fillExtrema(PaddedImage<T> &result, const PaddedImage<T> &mask, kipl::base::eConnectivity conn, std::false_type)
+{
+    queueFillExtrema<T,Order>(result,mask,conn);
+}
+
+/// \brief Computes FillHole (erosion order) or FillPeaks (dilation order) by flooding the padded image from its edge.
+template <typename T, class Order>
+void fillExtrema(PaddedImage<T> &result, const PaddedImage<T> &mask, kipl::base::eConnectivity conn)
+{
+    result.resize(mask.nx,mask.ny);
+    fillExtrema<T,Order>(result,mask,conn,
+                         std::integral_constant<bool,std::is_integral<T>::value && (sizeof(T)<=2)>());
+}
+
+template <typename T, class Order>
+void reconstruct(kipl::base::TImage<T,2> &marker, const kipl::base::TImage<T,2> &mask,
+                 kipl::base::eConnectivity conn, int nThreads, const char *name)
+{
+    if ((marker.Size(0)!=mask.Size(0)) || (marker.Size(1)!=mask.Size(1)))
+        throw kipl::base::KiplException(std::string(name)+": Size(marker) != Size(mask)",__FILE__,__LINE__);
+
+    size_t errcnt=0;
+    const T *pMarker=marker.GetDataPtr();
+    const T *pMask=mask.GetDataPtr();
+    for (size_t i=0; i<mask.Size(); ++i)
+        if (Order::precedes(pMarker[i],pMask[i]))
+            ++errcnt;
+
+    if (errcnt!=0) {
+        std::ostringstream msg;
+        msg<<name<<": the marker is not bounded by the mask ("<<errcnt<<" times)";
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    PaddedImage<T> pmarker, pmask;
+    pmarker.resize(marker.Dims());
+    pmask.resize(mask.Dims());
+    pmarker.setFrame(Order::neutral());
+    pmask.setFrame(Order::neutral());
+    pmarker.copyFrom(marker);
+    pmask.copyFrom(mask);
+
+    hybridReconstruction<T,Order>(pmarker,pmask,conn,nThreads);
+
+    pmarker.copyTo(marker);
+}
+
+}}}
+
+namespace kipl { namespace morphology {
+
+template <typename T>
+void ReconstructByErosion(kipl::base::TImage<T,2> &marker,
+                          const kipl::base::TImage<T,2> &mask,
+                          kipl::base::eConnectivity conn,
+                          int nThreads)
+{
+    core::reconstruct<T,core::ErosionOrder<T>>(marker,mask,conn,nThreads,"ReconstructByErosion");
+}
+
+template <typename T>
+void ReconstructByDilation(kipl::base::TImage<T,2> &marker,
+                           const kipl::base::TImage<T,2> &mask,
+                           kipl::base::eConnectivity conn,
+                           int nThreads)
+{
+    core::reconstruct<T,core::DilationOrder<T>>(marker,mask,conn,nThreads,"ReconstructByDilation");
+}
+
+template <typename T>
+kipl::base::TImage<T,2> FastFillHole(const kipl::base::TImage<T,2> &img, kipl::base::eConnectivity conn)
+{
+    core::PaddedImage<T> mask, result;
+    mask.resize(img.Dims());
+    mask.setFrame(core::ErosionOrder<T>::neutral());
+    mask.copyFrom(img);
+
+    core::fillExtrema<T,core::ErosionOrder<T>>(result,mask,conn);
+
+    kipl::base::TImage<T,2> res(img.Dims());
+    result.copyTo(res);
+
+    return res;
+}
+
+template <typename T>
+kipl::base::TImage<T,2> FastFillPeaks(const kipl::base::TImage<T,2> &img, kipl::base::eConnectivity conn)
+{
+    core::PaddedImage<T> mask, result;
+    mask.resize(img.Dims());
+    mask.setFrame(core::DilationOrder<T>::neutral());
+    mask.copyFrom(img);
+
+    core::fillExtrema<T,core::DilationOrder<T>>(result,mask,conn);
+
+    kipl::base::TImage<T,2> res(img.Dims());
+    result.copyTo(res);
+
+    return res;
+}
+
+template <typename T>
+void FillHoleAndPeaks(const kipl::base::TImage<T,2> &img,
+                      kipl::base::TImage<T,2> &noholes,
+                      kipl::base::TImage<T,2> &nopeaks,
+                      kipl::base::eConnectivity conn)
+{
+    // The flooding never reads the frame of the mask, both orders can therefore share the padded image.
+    core::PaddedImage<T> mask, holes, peaks;
+    mask.resize(img.Dims());
+    mask.setFrame(T(0));
+    mask.copyFrom(img);
+
+    // The two floods are submitted to the shared pool, this nests without extra threads when the caller is a pool worker.
+    kipl::utilities::ThreadPool::global().parallel_for(0,2,[&](size_t first, size_t last)
+    {
+        for (size_t i=first; i<last; ++i) {
+            if (i==0)
+                core::fillExtrema<T,core::ErosionOrder<T>>(holes,mask,conn);
+            else
+                core::fillExtrema<T,core::DilationOrder<T>>(peaks,mask,conn);
+        }
+    },1);
+
+    noholes.Resize(img.Dims());
+    nopeaks.Resize(img.Dims());
+    holes.copyTo(noholes);
+    peaks.copyTo(nopeaks);
+}
+
+}}
+#endif // MORPHRECONSTRUCTION_HPP
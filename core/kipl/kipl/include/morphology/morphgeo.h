@@ -60,6 +60,24 @@ kipl::base::TImage<ImgType,NDimG> RecByErosion(const kipl::base::TImage<ImgType,
 		const kipl::base::TImage<ImgType,NDimF> &f, 
         kipl::base::eConnectivity  conn);
 
+/// \brief Reconstruction by dilation of 2D images, computed by ReconstructByDilation with the raster scans in parallel.
+///	\param g mask image
+///	\param f marker image, \f$f \leq g \f$
+///	\param conn Selects connectivity, only conn4 and conn8 are supported.
+template <typename ImgType>
+kipl::base::TImage<ImgType,2> RecByDilation(const kipl::base::TImage<ImgType,2> &g,
+        const kipl::base::TImage<ImgType,2> &f,
+        kipl::base::eConnectivity conn);
+
+/// \brief Reconstruction by erosion of 2D images, computed by ReconstructByErosion with the raster scans in parallel.
+///	\param g mask image
+///	\param f marker image, \f$g \leq f \f$
+///	\param conn Selects connectivity, only conn4 and conn8 are supported.
+template <typename ImgType>
+kipl::base::TImage<ImgType,2> RecByErosion(const kipl::base::TImage<ImgType,2> &g,
+        const kipl::base::TImage<ImgType,2> &f,
+        kipl::base::eConnectivity conn);
+
 /// \brief Removes the objects that are connected to the edge of the image
 ///	\param img Input image
 ///	\param conn Connectivity of the reconstruction
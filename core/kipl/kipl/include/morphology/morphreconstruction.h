@@ -0,0 +1,74 @@
+//<LICENCE>
+
+#ifndef MORPHRECONSTRUCTION_H
+#define MORPHRECONSTRUCTION_H
+
+#include "../base/timage.h"
+#include "../base/kiplenums.h"
+
+namespace kipl { namespace morphology {
+
+/// \brief Reconstruction by erosion \f$R^{\epsilon}_{mask}(marker)\f$ computed in place on the marker image.
+///	\param marker The marker image, it is replaced by the reconstruction. Must be \f$\geq\f$ mask.
+///	\param mask The mask image
+///	\param conn Selects connectivity, only conn4 and conn8 are supported.
+///	\param nThreads Number of stripes for the raster scans, 0 uses one stripe per thread of the shared pool.
+///
+///	The raster scans of Vincent's hybrid algorithm are done on horizontal stripes in parallel on the shared thread pool.
+///	The remaining propagation runs as a breadth-first wavefront on a padded buffer, i.e. without
+///	queue containers and without edge tests.
+///	\throws KiplException if the image sizes differ, marker<mask or the connectivity is not supported.
+template <typename T>
+void ReconstructByErosion(kipl::base::TImage<T,2> &marker,
+                          const kipl::base::TImage<T,2> &mask,
+                          kipl::base::eConnectivity conn,
+                          int nThreads=0);
+
+/// \brief Reconstruction by dilation \f$R^{\delta}_{mask}(marker)\f$ computed in place on the marker image.
+///	\param marker The marker image, it is replaced by the reconstruction. Must be \f$\leq\f$ mask.
+///	\param mask The mask image
+///	\param conn Selects connectivity, only conn4 and conn8 are supported.
+///	\param nThreads Number of stripes for the raster scans, 0 uses one stripe per thread of the shared pool.
+///	\throws KiplException if the image sizes differ, marker>mask or the connectivity is not supported.
+template <typename T>
+void ReconstructByDilation(kipl::base::TImage<T,2> &marker,
+                           const kipl::base::TImage<T,2> &mask,
+                           kipl::base::eConnectivity conn,
+                           int nThreads=0);
+
+/// \brief Fills the holes (regional minima not connected to the edge) of an image.
+///	\param img The image to fill
+///	\param conn Selects connectivity, only conn4 and conn8 are supported.
+///	\returns The filled image. The result is identical to FillHole.
+///
+///	The image is flooded from its edge in increasing grey level order, which visits each pixel once.
+///	Eight and 16 bit integer images use one bucket per grey level, other types use a hierarchical queue with
+///	buckets of grey level ranges that are ordered as heaps. Plateaus are expanded without passing the queue.
+///	NaN pixels keep their value and do not stop the flood.
+template <typename T>
+kipl::base::TImage<T,2> FastFillHole(const kipl::base::TImage<T,2> &img, kipl::base::eConnectivity conn);
+
+/// \brief Removes the peaks (regional maxima not connected to the edge) of an image.
+///	\param img The image to process
+///	\param conn Selects connectivity, only conn4 and conn8 are supported.
+///	\returns The image without peaks. The result is identical to FillPeaks.
+template <typename T>
+kipl::base::TImage<T,2> FastFillPeaks(const kipl::base::TImage<T,2> &img, kipl::base::eConnectivity conn);
+
+/// \brief Computes hole filling and peak removal in one call.
+///	\param img The image to process
+///	\param noholes Receives the image with filled holes
+///	\param nopeaks Receives the image with removed peaks
+///	\param conn Selects connectivity, only conn4 and conn8 are supported.
+///
+///	The padded copy of the image is shared by both floods and the two floods run concurrently on the shared thread pool.
+template <typename T>
+void FillHoleAndPeaks(const kipl::base::TImage<T,2> &img,
+                      kipl::base::TImage<T,2> &noholes,
+                      kipl::base::TImage<T,2> &nopeaks,
+                      kipl::base::eConnectivity conn);
+
+}}
+
+#include "core/morphreconstruction.hpp"
+#endif // MORPHRECONSTRUCTION_H
@@ -0,0 +1,167 @@
+//<LICENCE>
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "../kipl_global.h"
+
+#include <string>
+#include <list>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <iostream>
+
+namespace kipl { namespace profile {
+
+/// \brief A single recorded event of the tracer.
+struct KIPLSHARED_EXPORT TraceEvent {
+    enum eEventType {
+        Span,       ///< A time interval with start and duration
+        Counter     ///< A named value at a given time
+    };
+
+    const char *name;       ///< Event name, must be a literal or a string interned by the tracer
+    const char *category;   ///< Event category, used to group events in the viewer
+    eEventType type;        ///< The kind of event
+    long long start;        ///< Start time in microseconds since the tracer epoch
+    long long duration;     ///< Duration in microseconds (spans only)
+    double value;           ///< Counter value (counters only)
+};
+
+/// \brief Collects scoped time spans and counters from all threads.
+///
+/// Each thread records into its own event buffer, so recording is lock free. A disabled tracer costs
+/// one relaxed atomic load per span, the instrumentation can therefore stay in the code.
+/// The events can be exported as Chrome trace-event JSON (chrome://tracing, Perfetto) or summarized as a table.
+/// \note Clear, the export functions and the summary must not be called while threads are recording.
+class KIPLSHARED_EXPORT Tracer {
+public:
+    /// \returns the process wide tracer instance
+    static Tracer & instance();
+
+    /// \brief Turns the recording on or off
+    /// \param enable Set true to start recording
+    void setEnabled(bool enable);
+
+    /// \returns true if events are recorded
+    bool isEnabled() const { return m_bEnabled.load(std::memory_order_relaxed); }
+
+    /// \brief Removes all recorded events and restarts the time epoch
+    void clear();
+
+    /// \brief Makes a persistent copy of a dynamic name that can be used as span name.
+    /// \param name The name to store
+    /// \returns A pointer that is valid for the lifetime of the tracer
+    const char * intern(const std::string &name);
+
+    /// \brief Records a finished span for the calling thread
+    /// \param name Name of the span
+    /// \param category Category of the span
+    /// \param start The time when the span started
+    /// \param stop The time when the span ended
+    void addSpan(const char *name, const char *category,
+                 std::chrono::steady_clock::time_point start,
+                 std::chrono::steady_clock::time_point stop);
+
+    /// \brief Records a counter value for the calling thread
+    /// \param name Name of the counter
+    /// \param value The current value
+    /// \param category Category of the counter
+    void addCounter(const char *name, double value, const char *category="kipl");
+
+    /// \returns the total number of recorded events
+    size_t eventCount();
+
+    /// \brief Writes the events as Chrome trace-event JSON.
+    /// \param os The target stream
+    void writeChromeTrace(std::ostream &os);
+
+    /// \brief Writes the events as Chrome trace-event JSON to a file.
+    /// \param fname Name of the destination file
+    /// \throws KiplException if the file can't be opened.
+    void writeChromeTrace(const std::string &fname);
+
+    /// \brief Produces a table with count, total, mean and maximum time per span name and the sum of the counters.
+    /// \returns the formatted table
+    std::string summary();
+
+private:
+    /// \brief Event storage of a single thread
+    struct ThreadBuffer {
+        int tid;
+        std::vector<TraceEvent> events;
+    };
+
+    Tracer();
+    Tracer(const Tracer &) = delete;
+    Tracer & operator=(const Tracer &) = delete;
+
+    ThreadBuffer & threadBuffer();
+    long long toMicroSeconds(std::chrono::steady_clock::time_point t) const;
+
+    std::atomic<bool> m_bEnabled;
+    std::chrono::steady_clock::time_point m_Epoch;
+    std::mutex m_Mutex;                                     ///< Protects the buffer list and the name table
+    std::list<std::unique_ptr<ThreadBuffer>> m_Buffers;
+    std::set<std::string> m_Names;
+};
+
+/// \brief Measures the time between construction and destruction and records it with the tracer.
+class KIPLSHARED_EXPORT ScopedSpan {
+public:
+    /// \brief Starts a span with a literal name
+    /// \param name Name of the span, must be valid while the tracer is alive (literal)
+    /// \param category Category of the span
+    ScopedSpan(const char *name, const char *category="kipl");
+
+    /// \brief Starts a span with a dynamic name. The name is only copied if the tracer is enabled.
+    /// \param name Name of the span
+    /// \param category Category of the span
+    ScopedSpan(const std::string &name, const char *category="kipl");
+
+    ~ScopedSpan();
+
+    ScopedSpan(const ScopedSpan &) = delete;
+    ScopedSpan & operator=(const ScopedSpan &) = delete;
+private:
+    const char *m_sName;
+    const char *m_sCategory;
+    bool m_bActive;
+    std::chrono::steady_clock::time_point m_Start;
+};
+
+/// \brief Enables the tracer for the lifetime of the object and disables it again on destruction, also when an exception leaves the scope.
+class KIPLSHARED_EXPORT ScopedTracing {
+public:
+    /// \brief Clears the recorded events and starts recording
+    /// \param enable Set false to make the guard a no-op, e.g. when tracing is not requested by the configuration
+    ScopedTracing(bool enable=true);
+
+    /// \brief Stops the recording if this guard started it
+    ~ScopedTracing();
+
+    /// \brief Stops the recording before the end of the scope, e.g. to produce the summary
+    void stop();
+
+    /// \returns true if this guard is recording
+    bool isActive() const { return m_bActive; }
+
+    ScopedTracing(const ScopedTracing &) = delete;
+    ScopedTracing & operator=(const ScopedTracing &) = delete;
+private:
+    bool m_bActive;
+};
+
+}}
+
+#define KIPL_TRACE_CONCAT_INNER(a,b) a ## b
+#define KIPL_TRACE_CONCAT(a,b) KIPL_TRACE_CONCAT_INNER(a,b)
+
+/// \brief Traces the enclosing scope as a span with the given name and category
+#define KIPL_TRACE_SCOPE(name, category) kipl::profile::ScopedSpan KIPL_TRACE_CONCAT(kipl_trace_span_,__LINE__)(name,category)
+
+#endif // TRACER_H
@@ -0,0 +1,277 @@
+//<LICENCE>
+
+#ifndef SLICESTREAM_HPP
+#define SLICESTREAM_HPP
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+
+#include "../../base/KiplException.h"
+#include "../../utilities/threadpool.h"
+#include "../../utilities/boundedqueue.h"
+
+namespace akipl { namespace queuefilter {
+
+namespace core {
+
+/// Default number of slices in a queue between two stages
+const size_t cSliceQueueSize = 8;
+
+/// \brief Mirrors an index at the ends of the range [0,N), the index must be less than N positions outside the range
+inline size_t mirrorIndex(ptrdiff_t idx, size_t N)
+{
+    if (idx<0)
+        idx=-idx;
+
+    if (static_cast<ptrdiff_t>(N)<=idx)
+        idx=2*(static_cast<ptrdiff_t>(N)-1)-idx;
+
+    return static_cast<size_t>(idx);
+}
+
+}
+
+template <class ImgType>
+SlicePipeline<ImgType>::SlicePipeline() :
+    logger("SlicePipeline"),
+    m_pSource(nullptr),
+    m_pSink(nullptr),
+    m_nQueueSize(core::cSliceQueueSize),
+    m_nThreadsPerStage(0)
+{}
+
+template <class ImgType>
+void SlicePipeline<ImgType>::setSource(SliceSource<ImgType> &source)
+{
+    m_pSource=&source;
+}
+
+template <class ImgType>
+void SlicePipeline<ImgType>::addStage(SliceWorker<ImgType> &worker)
+{
+    m_Stages.push_back(&worker);
+}
+
+template <class ImgType>
+void SlicePipeline<ImgType>::clearStages()
+{
+    m_Stages.clear();
+}
+
+template <class ImgType>
+void SlicePipeline<ImgType>::setSink(SliceSink<ImgType> &sink)
+{
+    m_pSink=&sink;
+}
+
+template <class ImgType>
+void SlicePipeline<ImgType>::setQueueSize(size_t n)
+{
+    m_nQueueSize=std::max(n,size_t(1));
+}
+
+template <class ImgType>
+void SlicePipeline<ImgType>::setThreadsPerStage(size_t n)
+{
+    m_nThreadsPerStage=n;
+}
+
+template <class ImgType>
+size_t SlicePipeline<ImgType>::threadsPerStage() const
+{
+    if (m_nThreadsPerStage!=0)
+        return m_nThreadsPerStage;
+
+    const size_t nStages=std::max(m_Stages.size(),size_t(1));
+
+    return std::max(kipl::utilities::ThreadPool::globalThreadBudget()/nStages,size_t(1));
+}
+
+template <class ImgType>
+void SlicePipeline<ImgType>::run()
+{
+    std::ostringstream msg;
+
+    if (m_pSource==nullptr)
+        throw kipl::base::KiplException("The slice pipeline has no source",__FILE__,__LINE__);
+
+    if (m_pSink==nullptr)
+        throw kipl::base::KiplException("The slice pipeline has no sink",__FILE__,__LINE__);
+
+    size_t dims[3]={0,0,0};
+    m_pSource->open(dims);
+    const size_t nSlices=dims[2];
+
+    if (nSlices==0)
+        throw kipl::base::KiplException("The slice source has no slices",__FILE__,__LINE__);
+
+    for (auto &stage : m_Stages) {
+        if (nSlices<=stage->neighborhood()) {
+            msg<<"The stack has "<<nSlices<<" slices, "<<stage->name()<<" needs more than "<<stage->neighborhood();
+            throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+        }
+        stage->setup(dims);
+    }
+
+    m_pSink->open(dims);
+
+    const size_t nStages=m_Stages.size();
+    const size_t nThreads=threadsPerStage();
+
+    msg.str("");
+    msg<<"Streaming "<<nSlices<<" slices through "<<nStages<<" stages with "<<nThreads<<" threads per stage";
+    logger(kipl::logging::Logger::LogMessage,msg.str());
+
+    const auto start=std::chrono::steady_clock::now();
+
+    // queues[s] holds the input of stage s, the last queue feeds the sink
+    std::vector<std::unique_ptr<kipl::utilities::BoundedQueue<Item>>> queues;
+    std::vector<std::unique_ptr<kipl::utilities::BoundedQueue<Job>>> jobs;
+    std::vector<std::unique_ptr<std::atomic<size_t>>> running;
+    for (size_t s=0; s<=nStages; ++s)
+        queues.emplace_back(new kipl::utilities::BoundedQueue<Item>(m_nQueueSize));
+    for (size_t s=0; s<nStages; ++s) {
+        jobs.emplace_back(new kipl::utilities::BoundedQueue<Job>(nThreads));
+        running.emplace_back(new std::atomic<size_t>(nThreads));
+    }
+
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+    auto fail=[&](std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!firstError)
+            firstError=e;
+
+        for (auto &q : queues)
+            q->abort();
+        for (auto &q : jobs)
+            q->abort();
+    };
+
+    std::vector<std::thread> threads;
+
+    threads.emplace_back([&]() {
+        try {
+            for (size_t z=0; z<nSlices; ++z) {
+                std::shared_ptr<kipl::base::TImage<ImgType,2>> slice(new kipl::base::TImage<ImgType,2>);
+                m_pSource->read(z,*slice);
+                if (!queues[0]->push(Item{z,slice}))
+                    break;
+            }
+            queues[0]->close();
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+    });
+
+    for (size_t s=0; s<nStages; ++s) {
+        // Collects the slices in order and releases a window as soon as its last slice has arrived
+        threads.emplace_back([&,s]() {
+            try {
+                const size_t r=m_Stages[s]->neighborhood();
+                std::map<size_t,SlicePtr> cache;
+                size_t nContiguous=0;
+                size_t next=0;
+                Item item;
+
+                while ((next<nSlices) && queues[s]->pop(item)) {
+                    cache[item.index]=item.slice;
+                    while (cache.count(nContiguous)!=0)
+                        ++nContiguous;
+
+                    while ((next<nSlices) && (std::min(nSlices-1,next+r)<nContiguous)) {
+                        Job job;
+                        job.index=next;
+                        for (ptrdiff_t d=-static_cast<ptrdiff_t>(r); d<=static_cast<ptrdiff_t>(r); ++d)
+                            job.window.push_back(cache.at(core::mirrorIndex(static_cast<ptrdiff_t>(next)+d,nSlices)));
+
+                        if (!jobs[s]->push(std::move(job)))
+                            return;
+
+                        ++next;
+                        if (r<next)
+                            cache.erase(cache.begin(),cache.lower_bound(next-r));
+                    }
+                }
+                jobs[s]->close();
+            }
+            catch (...) {
+                fail(std::current_exception());
+            }
+        });
+
+        for (size_t i=0; i<nThreads; ++i) {
+            threads.emplace_back([&,s]() {
+                try {
+                    Job job;
+                    std::vector<const kipl::base::TImage<ImgType,2> *> window;
+                    while (jobs[s]->pop(job)) {
+                        window.clear();
+                        for (auto &p : job.window)
+                            window.push_back(p.get());
+
+                        std::shared_ptr<kipl::base::TImage<ImgType,2>> result(new kipl::base::TImage<ImgType,2>);
+                        m_Stages[s]->process(window,*result);
+                        job.window.clear();
+
+                        if (!queues[s+1]->push(Item{job.index,result}))
+                            break;
+                    }
+
+                    if (--(*running[s])==0)
+                        queues[s+1]->close();
+                }
+                catch (...) {
+                    fail(std::current_exception());
+                }
+            });
+        }
+    }
+
+    size_t nWritten=0;
+    threads.emplace_back([&]() {
+        try {
+            Item item;
+            while (queues[nStages]->pop(item)) {
+                m_pSink->write(item.index,*item.slice);
+                item.slice.reset();
+                ++nWritten;
+            }
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+    });
+
+    for (auto &t : threads)
+        t.join();
+
+    m_pSource->close();
+
+    if (firstError)
+        std::rethrow_exception(firstError);
+
+    if (nWritten!=nSlices) {
+        msg.str("");
+        msg<<"The sink received "<<nWritten<<" of "<<nSlices<<" slices";
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    m_pSink->close();
+
+    msg.str("");
+    msg<<"Streamed "<<nSlices<<" slices in "
+       <<std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()<<" s";
+    logger(kipl::logging::Logger::LogMessage,msg.str());
+}
+
+}}
+
+#endif // SLICESTREAM_HPP
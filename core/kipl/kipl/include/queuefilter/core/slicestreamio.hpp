@@ -0,0 +1,132 @@
+//<LICENCE>
+
+#ifndef SLICESTREAMIO_HPP
+#define SLICESTREAMIO_HPP
+
+#include <algorithm>
+#include <sstream>
+
+#include "../../base/KiplException.h"
+#include "../../io/io_tiff.h"
+#include "../../strings/filenames.h"
+
+namespace akipl { namespace queuefilter {
+
+namespace core {
+
+/// \brief Writes a slice as 16 bit TIFF
+template <class ImgType>
+void writeStackSlice(const kipl::base::TImage<ImgType,2> &slice, const std::string &fname)
+{
+    kipl::io::WriteTIFF(slice,fname.c_str());
+}
+
+/// \brief Writes a float slice as 32 bit float TIFF
+inline void writeStackSlice(const kipl::base::TImage<float,2> &slice, const std::string &fname)
+{
+    kipl::io::WriteTIFF32(slice,fname.c_str());
+}
+
+}
+
+template <class ImgType>
+VolumeSliceSource<ImgType>::VolumeSliceSource(const kipl::base::TImage<ImgType,3> &volume) :
+    m_Volume(volume)
+{}
+
+template <class ImgType>
+void VolumeSliceSource<ImgType>::open(size_t *dims)
+{
+    std::copy_n(m_Volume.Dims(),3,dims);
+}
+
+template <class ImgType>
+void VolumeSliceSource<ImgType>::read(size_t index, kipl::base::TImage<ImgType,2> &slice)
+{
+    slice.Resize(m_Volume.Dims());
+    const ImgType *src=m_Volume.GetLinePtr(0,index);
+    std::copy_n(src,slice.Size(),slice.GetDataPtr());
+}
+
+template <class ImgType>
+VolumeSliceSink<ImgType>::VolumeSliceSink(kipl::base::TImage<ImgType,3> &volume) :
+    m_Volume(volume)
+{}
+
+template <class ImgType>
+void VolumeSliceSink<ImgType>::open(const size_t *dims)
+{
+    m_Volume.Resize(dims);
+}
+
+template <class ImgType>
+void VolumeSliceSink<ImgType>::write(size_t index, const kipl::base::TImage<ImgType,2> &slice)
+{
+    if ((slice.Size(0)!=m_Volume.Size(0)) || (slice.Size(1)!=m_Volume.Size(1)))
+        throw kipl::base::KiplException("The slice doesn't fit into the volume",__FILE__,__LINE__);
+
+    std::copy_n(slice.GetDataPtr(),slice.Size(),m_Volume.GetLinePtr(0,index));
+}
+
+template <class ImgType>
+TIFFStackSource<ImgType>::TIFFStackSource(const std::string &filemask, size_t first, size_t count, size_t step) :
+    m_sFileMask(filemask),
+    m_nFirst(first),
+    m_nCount(count),
+    m_nStep(step)
+{
+    m_Dims[0]=m_Dims[1]=0;
+}
+
+template <class ImgType>
+void TIFFStackSource<ImgType>::open(size_t *dims)
+{
+    std::string fname,ext;
+    kipl::strings::filenames::MakeFileName(m_sFileMask,static_cast<int>(m_nFirst),fname,ext,'#','0');
+
+    size_t fileDims[3]={0,0,0};
+    kipl::io::GetTIFFDims(fname.c_str(),fileDims);
+
+    m_Dims[0]=dims[0]=fileDims[0];
+    m_Dims[1]=dims[1]=fileDims[1];
+    dims[2]=m_nCount;
+}
+
+template <class ImgType>
+void TIFFStackSource<ImgType>::read(size_t index, kipl::base::TImage<ImgType,2> &slice)
+{
+    std::string fname,ext;
+    kipl::strings::filenames::MakeFileName(m_sFileMask,static_cast<int>(m_nFirst+index*m_nStep),fname,ext,'#','0');
+
+    kipl::io::ReadTIFF(slice,fname.c_str());
+
+    if ((slice.Size(0)!=m_Dims[0]) || (slice.Size(1)!=m_Dims[1])) {
+        std::ostringstream msg;
+        msg<<fname<<" has the size "<<slice.Size(0)<<"x"<<slice.Size(1)<<", the stack has "<<m_Dims[0]<<"x"<<m_Dims[1];
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+}
+
+template <class ImgType>
+TIFFStackSink<ImgType>::TIFFStackSink(const std::string &filemask, size_t first) :
+    m_sFileMask(filemask),
+    m_nFirst(first)
+{}
+
+template <class ImgType>
+void TIFFStackSink<ImgType>::open(const size_t * UNUSED(dims))
+{
+}
+
+template <class ImgType>
+void TIFFStackSink<ImgType>::write(size_t index, const kipl::base::TImage<ImgType,2> &slice)
+{
+    std::string fname,ext;
+    kipl::strings::filenames::MakeFileName(m_sFileMask,static_cast<int>(m_nFirst+index),fname,ext,'#','0');
+
+    core::writeStackSlice(slice,fname);
+}
+
+}}
+
+#endif // SLICESTREAMIO_HPP
@@ -0,0 +1,164 @@
+//<LICENCE>
+
+#ifndef SLICEWORKERS_HPP
+#define SLICEWORKERS_HPP
+
+#include <algorithm>
+#include <sstream>
+
+#include "../../base/KiplException.h"
+
+namespace akipl { namespace queuefilter {
+
+template <class ImgType>
+SliceLinearFilterWorker<ImgType>::SliceLinearFilterWorker(const std::vector<float> &kernel) :
+    SliceWorker<ImgType>("SliceLinearFilterWorker"),
+    m_Kernel(kernel)
+{
+    if ((kernel.size() % 2)==0)
+        throw kipl::base::KiplException("The filter kernel must have an odd length",__FILE__,__LINE__);
+}
+
+template <class ImgType>
+void SliceLinearFilterWorker<ImgType>::setup(const size_t *dims)
+{
+    if ((dims[0]<=neighborhood()) || (dims[1]<=neighborhood()))
+        throw kipl::base::KiplException("The slices are too small for the filter kernel",__FILE__,__LINE__);
+}
+
+template <class ImgType>
+void SliceLinearFilterWorker<ImgType>::process(const std::vector<const kipl::base::TImage<ImgType,2> *> &window, kipl::base::TImage<ImgType,2> &result) const
+{
+    const size_t nx=window[0]->Size(0);
+    const size_t ny=window[0]->Size(1);
+    const size_t N=nx*ny;
+    const size_t r=neighborhood();
+    const size_t nK=m_Kernel.size();
+
+    // Along z
+    std::vector<float> acc(N,0.0f);
+    for (size_t k=0; k<nK; ++k) {
+        const float w=m_Kernel[k];
+        const ImgType *p=window[k]->GetDataPtr();
+        for (size_t i=0; i<N; ++i)
+            acc[i]+=w*static_cast<float>(p[i]);
+    }
+
+    // Along x on a row with mirrored ends
+    std::vector<float> padded(nx+2*r);
+    std::vector<float> tmp(N);
+    for (size_t y=0; y<ny; ++y) {
+        const float *row=acc.data()+y*nx;
+        for (size_t x=0; x<nx+2*r; ++x)
+            padded[x]=row[core::mirrorIndex(static_cast<ptrdiff_t>(x)-static_cast<ptrdiff_t>(r),nx)];
+
+        float *dst=tmp.data()+y*nx;
+        std::fill_n(dst,nx,0.0f);
+        for (size_t k=0; k<nK; ++k) {
+            const float w=m_Kernel[k];
+            const float *src=padded.data()+k;
+            for (size_t x=0; x<nx; ++x)
+                dst[x]+=w*src[x];
+        }
+    }
+
+    // Along y, the rows are combined
+    result.Resize(window[0]->Dims());
+    std::vector<float> line(nx);
+    for (size_t y=0; y<ny; ++y) {
+        std::fill(line.begin(),line.end(),0.0f);
+        for (size_t k=0; k<nK; ++k) {
+            const float w=m_Kernel[k];
+            const float *src=tmp.data()+nx*core::mirrorIndex(static_cast<ptrdiff_t>(y+k)-static_cast<ptrdiff_t>(r),ny);
+            for (size_t x=0; x<nx; ++x)
+                line[x]+=w*src[x];
+        }
+
+        ImgType *dst=result.GetLinePtr(y);
+        for (size_t x=0; x<nx; ++x)
+            dst[x]=static_cast<ImgType>(line[x]);
+    }
+}
+
+template <class ImgType>
+SliceRankFilterWorker<ImgType>::SliceRankFilterWorker(size_t size, eSliceRank rank) :
+    SliceWorker<ImgType>("SliceRankFilterWorker"),
+    m_nSize(size),
+    m_eRank(rank)
+{
+    if ((size % 2)==0)
+        throw kipl::base::KiplException("The rank filter size must be odd",__FILE__,__LINE__);
+}
+
+template <class ImgType>
+void SliceRankFilterWorker<ImgType>::setup(const size_t *dims)
+{
+    if ((dims[0]<=neighborhood()) || (dims[1]<=neighborhood()))
+        throw kipl::base::KiplException("The slices are too small for the rank filter",__FILE__,__LINE__);
+}
+
+template <class ImgType>
+void SliceRankFilterWorker<ImgType>::process(const std::vector<const kipl::base::TImage<ImgType,2> *> &window, kipl::base::TImage<ImgType,2> &result) const
+{
+    const size_t nx=window[0]->Size(0);
+    const size_t ny=window[0]->Size(1);
+    const ptrdiff_t r=static_cast<ptrdiff_t>(neighborhood());
+
+    result.Resize(window[0]->Dims());
+    std::vector<ImgType> values(m_nSize*m_nSize*m_nSize);
+    std::vector<size_t> xi(m_nSize);
+
+    for (size_t y=0; y<ny; ++y) {
+        ImgType *dst=result.GetLinePtr(y);
+        for (size_t x=0; x<nx; ++x) {
+            for (ptrdiff_t d=-r; d<=r; ++d)
+                xi[d+r]=core::mirrorIndex(static_cast<ptrdiff_t>(x)+d,nx);
+
+            size_t n=0;
+            for (const auto slice : window) {
+                for (ptrdiff_t dy=-r; dy<=r; ++dy) {
+                    const ImgType *row=slice->GetLinePtr(core::mirrorIndex(static_cast<ptrdiff_t>(y)+dy,ny));
+                    for (size_t i=0; i<m_nSize; ++i)
+                        values[n++]=row[xi[i]];
+                }
+            }
+
+            switch (m_eRank) {
+            case SliceRankMin:
+                dst[x]=*std::min_element(values.begin(),values.end());
+                break;
+            case SliceRankMax:
+                dst[x]=*std::max_element(values.begin(),values.end());
+                break;
+            case SliceRankMedian:
+                std::nth_element(values.begin(),values.begin()+values.size()/2,values.end());
+                dst[x]=values[values.size()/2];
+                break;
+            }
+        }
+    }
+}
+
+template <class ImgType>
+SliceThresholdWorker<ImgType>::SliceThresholdWorker(ImgType threshold, bool bAbove) :
+    SliceWorker<ImgType>("SliceThresholdWorker"),
+    m_Threshold(threshold),
+    m_bAbove(bAbove)
+{}
+
+template <class ImgType>
+void SliceThresholdWorker<ImgType>::process(const std::vector<const kipl::base::TImage<ImgType,2> *> &window, kipl::base::TImage<ImgType,2> &result) const
+{
+    const kipl::base::TImage<ImgType,2> &slice=*window[0];
+    const ImgType *src=slice.GetDataPtr();
+
+    result.Resize(slice.Dims());
+    ImgType *dst=result.GetDataPtr();
+
+    for (size_t i=0; i<slice.Size(); ++i)
+        dst[i]=static_cast<ImgType>((m_Threshold<src[i])==m_bAbove ? 1 : 0);
+}
+
+}}
+
+#endif // SLICEWORKERS_HPP
@@ -0,0 +1,157 @@
+//<LICENCE>
+
+#ifndef SLICESTREAM_H
+#define SLICESTREAM_H
+
+#include "../kipl_global.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "../base/timage.h"
+#include "../logging/logger.h"
+
+namespace akipl { namespace queuefilter {
+
+/// \brief Provides the slices of a volume to a SlicePipeline
+template <class ImgType>
+class SliceSource
+{
+public:
+    virtual ~SliceSource() {}
+
+    /// \brief Prepares the reading
+    /// \param dims Receives the slice size and the number of slices
+    virtual void open(size_t *dims)=0;
+
+    /// \brief Reads a slice, the slices are read in order by one thread
+    /// \param index The slice index
+    /// \param slice Receives the slice
+    virtual void read(size_t index, kipl::base::TImage<ImgType,2> &slice)=0;
+
+    /// \brief Ends the reading
+    virtual void close() {}
+};
+
+/// \brief Receives the result slices of a SlicePipeline
+template <class ImgType>
+class SliceSink
+{
+public:
+    virtual ~SliceSink() {}
+
+    /// \brief Prepares the writing
+    /// \param dims The slice size and the number of slices
+    virtual void open(const size_t *dims)=0;
+
+    /// \brief Writes a slice, it is called by one thread but the slices may arrive in any order
+    /// \param index The slice index
+    /// \param slice The slice
+    virtual void write(size_t index, const kipl::base::TImage<ImgType,2> &slice)=0;
+
+    /// \brief Ends the writing, it is only called if all slices were written
+    virtual void close() {}
+};
+
+/// \brief A processing stage of a SlicePipeline that computes one slice from a neighborhood of slices
+///
+/// The worker declares how many slices it needs on each side of the processed slice. The stack ends are mirrored,
+/// i.e. the window of slice 0 with neighborhood 2 contains the slices 2,1,0,1,2.
+/// process is called concurrently for different slices, it must not change the worker. The window slices are shared
+/// between the threads, they must only be read through their data pointers and never be copied or assigned.
+template <class ImgType>
+class SliceWorker
+{
+public:
+    /// \param name The name of the worker for the log
+    SliceWorker(const std::string &name) : m_sName(name) {}
+    virtual ~SliceWorker() {}
+
+    /// \returns the name of the worker
+    const std::string & name() const { return m_sName; }
+
+    /// \returns the number of slices needed on each side of the processed slice
+    virtual size_t neighborhood() const=0;
+
+    /// \brief Prepares the processing of a volume, it is called before the streaming starts
+    /// \param dims The slice size and the number of slices
+    virtual void setup(const size_t * UNUSED(dims)) {}
+
+    /// \brief Computes a result slice
+    /// \param window The 2*neighborhood()+1 slices centered on the processed slice
+    /// \param result Receives the result, it is an empty image when the call starts
+    virtual void process(const std::vector<const kipl::base::TImage<ImgType,2> *> &window, kipl::base::TImage<ImgType,2> &result) const=0;
+
+private:
+    std::string m_sName;
+};
+
+/// \brief Streams a volume slice by slice through a chain of workers without keeping the volume in memory
+///
+/// The source, each stage and the sink run concurrently and are connected by bounded queues. A stage collects the
+/// slices of a window in order and its threads process the windows of different slices in parallel, the result
+/// slices can therefore reach the next stage out of order. Only the queued slices and the windows are in memory,
+/// volumes larger than the memory can be processed when the source and the sink stream from and to files.
+template <class ImgType>
+class SlicePipeline
+{
+    kipl::logging::Logger logger;
+public:
+    SlicePipeline();
+
+    /// \brief Sets the slice source, the pipeline doesn't take the ownership
+    void setSource(SliceSource<ImgType> &source);
+
+    /// \brief Appends a processing stage, the pipeline doesn't take the ownership
+    void addStage(SliceWorker<ImgType> &worker);
+
+    /// \brief Removes all processing stages
+    void clearStages();
+
+    /// \brief Sets the slice sink, the pipeline doesn't take the ownership
+    void setSink(SliceSink<ImgType> &sink);
+
+    /// \brief Sets the number of slices that each queue between two stages holds
+    void setQueueSize(size_t n);
+
+    /// \brief Sets the number of processing threads of each stage
+    /// \param n Number of threads, 0 spreads the global thread budget over the stages
+    void setThreadsPerStage(size_t n);
+
+    /// \returns the number of processing threads of each stage
+    size_t threadsPerStage() const;
+
+    /// \brief Streams all slices from the source through the stages to the sink
+    /// \throws KiplException if the pipeline is incomplete or the stack has fewer slices than a neighborhood needs.
+    /// The first exception of the source, a stage or the sink stops the streaming and is rethrown.
+    void run();
+
+protected:
+    typedef std::shared_ptr<const kipl::base::TImage<ImgType,2>> SlicePtr;
+
+    /// \brief A slice travelling between the stages
+    struct Item {
+        size_t index;
+        SlicePtr slice;
+    };
+
+    /// \brief The window of one result slice
+    struct Job {
+        size_t index;
+        std::vector<SlicePtr> window;
+    };
+
+    SliceSource<ImgType> *m_pSource;
+    SliceSink<ImgType> *m_pSink;
+    std::vector<SliceWorker<ImgType> *> m_Stages;
+    size_t m_nQueueSize;
+    size_t m_nThreadsPerStage;
+};
+
+}}
+
+#include "core/slicestream.hpp"
+
+#endif // SLICESTREAM_H
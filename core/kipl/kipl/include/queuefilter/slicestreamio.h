@@ -0,0 +1,90 @@
+//<LICENCE>
+
+#ifndef SLICESTREAMIO_H
+#define SLICESTREAMIO_H
+
+#include <string>
+
+#include "slicestream.h"
+
+namespace akipl { namespace queuefilter {
+
+/// \brief Streams the slices of a volume in memory
+template <class ImgType>
+class VolumeSliceSource : public SliceSource<ImgType>
+{
+public:
+    /// \param volume The volume to stream, it must not be changed while the pipeline runs
+    VolumeSliceSource(const kipl::base::TImage<ImgType,3> &volume);
+
+    virtual void open(size_t *dims);
+    virtual void read(size_t index, kipl::base::TImage<ImgType,2> &slice);
+
+private:
+    kipl::base::TImage<ImgType,3> m_Volume;
+};
+
+/// \brief Collects the result slices in a volume in memory
+template <class ImgType>
+class VolumeSliceSink : public SliceSink<ImgType>
+{
+public:
+    /// \param volume Receives the result, it is resized when the pipeline starts
+    VolumeSliceSink(kipl::base::TImage<ImgType,3> &volume);
+
+    virtual void open(const size_t *dims);
+    virtual void write(size_t index, const kipl::base::TImage<ImgType,2> &slice);
+
+private:
+    kipl::base::TImage<ImgType,3> &m_Volume;
+};
+
+/// \brief Reads a stack of numbered TIFF files
+template <class ImgType>
+class TIFFStackSource : public SliceSource<ImgType>
+{
+public:
+    /// \param filemask File name mask, the file number replaces the #'s
+    /// \param first The number of the first file
+    /// \param count The number of files
+    /// \param step The file number increment
+    TIFFStackSource(const std::string &filemask, size_t first, size_t count, size_t step=1);
+
+    /// \throws KiplException if the first file can't be opened
+    virtual void open(size_t *dims);
+
+    /// \throws KiplException if the file can't be read or has a different size than the first file
+    virtual void read(size_t index, kipl::base::TImage<ImgType,2> &slice);
+
+private:
+    std::string m_sFileMask;
+    size_t m_nFirst;
+    size_t m_nCount;
+    size_t m_nStep;
+    size_t m_Dims[2];
+};
+
+/// \brief Writes the result slices as numbered TIFF files, float slices are written as 32 bit float and other types as 16 bit integers
+template <class ImgType>
+class TIFFStackSink : public SliceSink<ImgType>
+{
+public:
+    /// \param filemask File name mask, the file number replaces the #'s
+    /// \param first The number of the first file
+    TIFFStackSink(const std::string &filemask, size_t first=0);
+
+    virtual void open(const size_t *dims);
+
+    /// \throws KiplException if the file can't be written
+    virtual void write(size_t index, const kipl::base::TImage<ImgType,2> &slice);
+
+private:
+    std::string m_sFileMask;
+    size_t m_nFirst;
+};
+
+}}
+
+#include "core/slicestreamio.hpp"
+
+#endif // SLICESTREAMIO_H
@@ -0,0 +1,85 @@
+//<LICENCE>
+
+#ifndef SLICEWORKERS_H
+#define SLICEWORKERS_H
+
+#include <vector>
+
+#include "slicestream.h"
+
+namespace akipl { namespace queuefilter {
+
+/// \brief Separable linear filter that applies the same kernel along x, y and z
+///
+/// The slice borders are mirrored like the stack ends. The filtering is done in single precision.
+template <class ImgType>
+class SliceLinearFilterWorker : public SliceWorker<ImgType>
+{
+public:
+    /// \param kernel The filter kernel, it must have an odd number of weights
+    /// \throws KiplException if the kernel is empty or has an even length
+    SliceLinearFilterWorker(const std::vector<float> &kernel);
+
+    virtual size_t neighborhood() const { return m_Kernel.size()/2; }
+
+    /// \throws KiplException if a slice is not larger than the kernel radius
+    virtual void setup(const size_t *dims);
+
+    virtual void process(const std::vector<const kipl::base::TImage<ImgType,2> *> &window, kipl::base::TImage<ImgType,2> &result) const;
+
+private:
+    std::vector<float> m_Kernel;
+};
+
+/// \brief Selects the rank of SliceRankFilterWorker
+enum eSliceRank {
+    SliceRankMin,       ///< The smallest value of the neighborhood
+    SliceRankMedian,    ///< The median of the neighborhood
+    SliceRankMax        ///< The largest value of the neighborhood
+};
+
+/// \brief Rank filter on a cubic neighborhood
+template <class ImgType>
+class SliceRankFilterWorker : public SliceWorker<ImgType>
+{
+public:
+    /// \param size The side length of the cube, it must be odd
+    /// \param rank The selected rank
+    /// \throws KiplException if the size is even
+    SliceRankFilterWorker(size_t size, eSliceRank rank=SliceRankMedian);
+
+    virtual size_t neighborhood() const { return m_nSize/2; }
+
+    /// \throws KiplException if a slice is not larger than the half cube size
+    virtual void setup(const size_t *dims);
+
+    virtual void process(const std::vector<const kipl::base::TImage<ImgType,2> *> &window, kipl::base::TImage<ImgType,2> &result) const;
+
+private:
+    size_t m_nSize;
+    eSliceRank m_eRank;
+};
+
+/// \brief Binary threshold, pixels above the threshold get one and the others zero
+template <class ImgType>
+class SliceThresholdWorker : public SliceWorker<ImgType>
+{
+public:
+    /// \param threshold The threshold
+    /// \param bAbove Selects the pixels above the threshold, false selects the pixels below or equal to the threshold
+    SliceThresholdWorker(ImgType threshold, bool bAbove=true);
+
+    virtual size_t neighborhood() const { return 0; }
+
+    virtual void process(const std::vector<const kipl::base::TImage<ImgType,2> *> &window, kipl::base::TImage<ImgType,2> &result) const;
+
+private:
+    ImgType m_Threshold;
+    bool m_bAbove;
+};
+
+}}
+
+#include "core/sliceworkers.hpp"
+
+#endif // SLICEWORKERS_H
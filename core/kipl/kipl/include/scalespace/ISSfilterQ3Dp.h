@@ -3,7 +3,8 @@
 #ifndef __ISSFILTERQ3DP_H
 #define __ISSFILTERQ3DP_H
 #include <iostream>
-#include <list>
+#include <string>
+#include <vector>
 
 #include <base/timage.h>
 #include "../logging/logger.h"
@@ -11,13 +12,30 @@
 
 namespace akipl { namespace scalespace {
 
+/// \brief Inverse scale space filter for volumes, the solver processes the volume in slabs of slices in parallel.
+///
+/// Each iteration computes the normalized gradient of a slice, the curvature and the time step in one pass over
+/// the rows. The gradients of two slices are kept in a ring buffer per slab, the buffers are allocated once per call
+/// to Process. The gradient of the first slice of each slab is computed before the slabs are updated, which makes the
+/// result independent of the number of slabs and threads.
 template <typename T>
 class ISSfilterQ3Dp {
 	kipl::logging::Logger logger;
 public:
 	
-  ISSfilterQ3Dp() :logger("ISSfilterQ3Dp"), eInitialImage(InitialImageOriginal),error(nullptr) {m_dEpsilon=1e-7;}
+  ISSfilterQ3Dp() :logger("ISSfilterQ3Dp"), eInitialImage(InitialImageOriginal),m_nThreads(0),error(nullptr) {m_dEpsilon=1e-7;}
   ~ISSfilterQ3Dp() {if (error!=nullptr) delete [] error;}
+
+  /// \brief Filters a volume
+  /// \param img The volume to filter, it is replaced by the result
+  /// \param dTau The time step
+  /// \param dLambda Weight of the fidelity term
+  /// \param dAlpha Weight of the residual feedback
+  /// \param nN Number of iterations
+  /// \param saveiterations Saves the central slice of each iteration
+  /// \param itpath Destination path of the saved slices
+  /// \returns the number of iterations
+  /// \throws KiplException if the volume has less than two pixels along an axis
   int Process(kipl::base::TImage<T,3> &img,
 		  double dTau,
 		  double dLambda,
@@ -27,6 +45,9 @@ public:
 		  std::string itpath="");
 
    T const * const GetErrorArray() {return error;}
+
+   /// \brief Sets the number of slabs that are processed in parallel.
+   /// \param n Number of threads, 0 uses all threads of the global thread pool
    void SetNumThreads(int n) {m_nThreads=n;}
    eInitialImageType eInitialImage;
 private:
@@ -35,6 +56,15 @@ private:
 		dirY=1,
 		dirZ=2
 	};
+
+  /// \brief The normalized lag differences of one slice
+  struct Gradient {
+      kipl::base::TImage<T,2> dx;
+      kipl::base::TImage<T,2> dy;
+      kipl::base::TImage<T,2> dz;
+
+      void resize(const size_t *dims) {dx.Resize(dims); dy.Resize(dims); dz.Resize(dims);}
+  };
 	
   kipl::base::TImage<T,3> m_f;
   kipl::base::TImage<T,3> m_v;
@@ -44,37 +74,30 @@ private:
   double m_dAlpha;
   double m_dEpsilon;
   T *error;
-  T _SolveIteration(kipl::base::TImage<T,3> &img);
-  T _SolveIterationSSE(kipl::base::TImage<T,3> &img);
-  int _P(kipl::base::TImage<T,3> &img, kipl::base::TImage<T,3> &res);
-  int _LeadRegularize(kipl::base::TImage<T,3> *img, Direction dir);
-  int _LagRegularize(kipl::base::TImage<T,3> *img, Direction dir);
-  int _FirstDerivate(   std::list<kipl::base::TImage<T,2> > &img_queue,
-						std::list<kipl::base::TImage<T,2> > &dx_queue,
-						std::list<kipl::base::TImage<T,2> > &dy_queue,
-						std::list<kipl::base::TImage<T,2> > &dz_queue); // Lag difference
 
-  int _FirstDerivateSSE(std::list<kipl::base::TImage<T,2> > &img_queue,
-  									std::list<kipl::base::TImage<T,2> > &dx_queue,
-  									std::list<kipl::base::TImage<T,2> > &dy_queue,
-  									std::list<kipl::base::TImage<T,2> > &dz_queue); // Lag difference
+  std::vector<size_t> m_SlabStart;  ///< First slice of each slab, the last entry is the number of slices
+  std::vector<Gradient> m_Boundary; ///< Gradient of the first slice of each slab, the last entry mirrors the end of the volume
+  std::vector<Gradient> m_Ring;     ///< Two gradient slices per slab
 
+  /// \brief Splits the volume in slabs and allocates the gradient buffers
+  void _Prepare(const kipl::base::TImage<T,3> &img);
 
-  int _FirstDerivateSSE2(std::list<kipl::base::TImage<T,2> > &img_queue,
-  									std::list<kipl::base::TImage<T,2> > &dx_queue,
-  									std::list<kipl::base::TImage<T,2> > &dy_queue,
-  									std::list<kipl::base::TImage<T,2> > &dz_queue); // Lag difference
-  int _Curvature(   std::list<kipl::base::TImage<T,2> > &dx_queue,
-					std::list<kipl::base::TImage<T,2> > &dy_queue,
-					std::list<kipl::base::TImage<T,2> > &dz_queue,
-					kipl::base::TImage<T,2> &result); // Lead difference
+  /// \brief Makes one time step
+  /// \returns the sum of (f-u)^2 before the step
+  T _SolveIteration(kipl::base::TImage<T,3> &img);
 
-  int _CurvatureSSE(std::list<kipl::base::TImage<T,2> > &dx_queue,
-					std::list<kipl::base::TImage<T,2> > &dy_queue,
-					std::list<kipl::base::TImage<T,2> > &dz_queue,
-					kipl::base::TImage<T,2> &result); // Lead difference
+  /// \brief Computes the gradient of a slice
+  /// \param img The volume
+  /// \param z The slice index
+  /// \param g Receives the gradient
+  void _Gradient(kipl::base::TImage<T,3> &img, size_t z, Gradient &g);
 
+  /// \brief Updates the slices of one slab
+  /// \returns the sum of (f-u)^2 over the slab before the update
+  double _UpdateSlab(kipl::base::TImage<T,3> &img, size_t slab);
 
+  int _LeadRegularize(kipl::base::TImage<T,3> *img, Direction dir);
+  int _LagRegularize(kipl::base::TImage<T,3> *img, Direction dir);
 };
 
 }}
@@ -0,0 +1,86 @@
+//<LICENCE>
+
+#ifndef ISSKERNELS_H
+#define ISSKERNELS_H
+
+#include "../kipl_global.h"
+
+#include <cstddef>
+#include <cmath>
+
+namespace akipl { namespace scalespace {
+
+/// \brief Computes the normalized lag differences of one image row for the ISS filter.
+///
+/// The differences are taken to the previous pixel, the previous row and the previous slice. The gradient vector
+/// is scaled to unit length, pixels with zero gradient get zero differences. The row start is mirrored, i.e. dx[0]=u[0]-u[1].
+/// \param u The row
+/// \param uy The previous row of the slice
+/// \param uz The same row in the previous slice
+/// \param dx Receives the differences along x
+/// \param dy Receives the differences along y
+/// \param dz Receives the differences along z
+/// \param N Row length, at least two pixels
+/// \note The float version uses the best instruction set of kipl::math::simdInstructionSet()
+template <typename T>
+void issGradientRow(const T *u, const T *uy, const T *uz, T *dx, T *dy, T *dz, size_t N)
+{
+    for (size_t x=0; x<N; ++x) {
+        const T gx = u[x]-(x==0 ? u[1] : u[x-1]);
+        const T gy = u[x]-uy[x];
+        const T gz = u[x]-uz[x];
+
+        const T sum2 = gx*gx+gy*gy+gz*gz;
+        const T scale = sum2!=static_cast<T>(0) ? static_cast<T>(1)/std::sqrt(sum2) : static_cast<T>(0);
+        dx[x]=gx*scale;
+        dy[x]=gy*scale;
+        dz[x]=gz*scale;
+    }
+}
+
+/// \brief Computes the curvature of one row from the normalized differences and makes the ISS time step.
+///
+/// The curvature is the lead difference of the normalized gradient, the last pixel mirrors the row.
+/// The time step is u+=tau*(p+lambda*(f-u+v)) and v+=tau*alpha*(f-u).
+/// \param u The row of the solution, it is updated
+/// \param v The row of the residual sum, it is updated
+/// \param f The row of the initial image
+/// \param dx The x-differences of the row
+/// \param dy0 The y-differences of the row
+/// \param dy1 The y-differences of the next row
+/// \param dz0 The z-differences of the row
+/// \param dz1 The z-differences of the same row in the next slice
+/// \param N Row length, at least two pixels
+/// \param tau The time step
+/// \param lambda Weight of the fidelity term
+/// \param tauAlpha The time step multiplied by alpha
+/// \returns the sum of (f-u)^2 over the row before the update
+/// \note The float version uses the best instruction set of kipl::math::simdInstructionSet()
+template <typename T>
+double issUpdateRow(T *u, T *v, const T *f, const T *dx, const T *dy0, const T *dy1, const T *dz0, const T *dz1,
+                    size_t N, T tau, T lambda, T tauAlpha)
+{
+    double sum2=0.0;
+    for (size_t x=0; x<N; ++x) {
+        const T d2x = x+1<N ? dx[x+1]-dx[x] : dx[x-1]-dx[x];
+        const T p = d2x+(dy1[x]-dy0[x])+(dz1[x]-dz0[x]);
+        const T fu = f[x]-u[x];
+
+        sum2+=static_cast<double>(fu)*fu;
+        u[x]+=tau*(p+lambda*(fu+v[x]));
+        v[x]+=tauAlpha*fu;
+    }
+
+    return sum2;
+}
+
+/// \brief Single precision version of issGradientRow with SIMD instructions
+void KIPLSHARED_EXPORT issGradientRow(const float *u, const float *uy, const float *uz, float *dx, float *dy, float *dz, size_t N);
+
+/// \brief Single precision version of issUpdateRow with SIMD instructions
+double KIPLSHARED_EXPORT issUpdateRow(float *u, float *v, const float *f, const float *dx, const float *dy0, const float *dy1,
+                                      const float *dz0, const float *dz1, size_t N, float tau, float lambda, float tauAlpha);
+
+}}
+
+#endif // ISSKERNELS_H
@@ -0,0 +1,187 @@
+//<LICENCE>
+
+#ifndef FUZZYMEMBERSHIP_HPP
+#define FUZZYMEMBERSHIP_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <type_traits>
+
+#include "../../base/KiplException.h"
+#include "../../utilities/threadpool.h"
+
+namespace kipl { namespace segmentation { namespace core {
+
+/// Number of pixels in the blocks of the membership computation, the scratch buffers of a block stay in the L1 cache
+const size_t cFuzzyBlockSize = 512;
+
+/// Number of pixels that a task of the parallel pass processes, each chunk has its own sums
+const size_t cFuzzyChunkSize = 1<<16;
+
+/// Seed of the mini-batch sampling, it is fixed to make the clustering reproducible
+const unsigned int cFuzzyMiniBatchSeed = 5489u;
+
+}
+
+template <typename ImgType>
+int FuzzyMembership::cluster(const ImgType *img, size_t N, const bool *mask,
+                             std::vector<float> &centers,
+                             int maxIterations, size_t miniBatch,
+                             kipl::logging::Logger &logger,
+                             std::function<void(int, const std::vector<float> &)> onIteration) const
+{
+    std::ostringstream msg;
+    kipl::utilities::ThreadPool &pool=kipl::utilities::ThreadPool::global();
+    const size_t nChunks=(N+core::cFuzzyChunkSize-1)/core::cFuzzyChunkSize;
+    const bool bDirect=std::is_same<ImgType,float>::value && (mask==nullptr);
+
+    // Returns the pixels of a chunk as float, masked pixels are removed
+    auto load=[&](size_t chunk, std::vector<float> &buffer, size_t &n) -> const float * {
+        const size_t first=chunk*core::cFuzzyChunkSize;
+        const size_t last=std::min(N,first+core::cFuzzyChunkSize);
+        if (bDirect) {
+            n=last-first;
+            return reinterpret_cast<const float *>(img+first);
+        }
+
+        buffer.resize(core::cFuzzyChunkSize);
+        n=0;
+        for (size_t i=first; i<last; ++i)
+            if ((mask==nullptr) || mask[i])
+                buffer[n++]=static_cast<float>(img[i]);
+
+        return buffer.data();
+    };
+
+    if (centers.size()!=m_nClasses) {
+        std::vector<float> lo(nChunks,std::numeric_limits<float>::max());
+        std::vector<float> hi(nChunks,-std::numeric_limits<float>::max());
+        pool.parallel_for(0,nChunks,
+            [&](size_t first, size_t last) {
+                std::vector<float> buffer;
+                for (size_t chunk=first; chunk<last; ++chunk) {
+                    size_t n=0;
+                    const float *x=load(chunk,buffer,n);
+                    for (size_t i=0; i<n; ++i) {
+                        lo[chunk]=std::min(lo[chunk],x[i]);
+                        hi[chunk]=std::max(hi[chunk],x[i]);
+                    }
+                }
+            },1);
+
+        const float minval=*std::min_element(lo.begin(),lo.end());
+        const float maxval=*std::max_element(hi.begin(),hi.end());
+        if (maxval<minval)
+            throw kipl::base::KiplException("There are no pixels to cluster",__FILE__,__LINE__);
+
+        centers.resize(m_nClasses);
+        for (size_t k=0; k<m_nClasses; ++k)
+            centers[k]=minval+(k+0.5f)*(maxval-minval)/m_nClasses;
+    }
+    std::sort(centers.begin(),centers.end());
+
+    if ((0<miniBatch) && (2*miniBatch<=N)) {
+        // One random pixel from each block of the stride, a fixed offset would alias with periodic data like image rows
+        const size_t stride=N/miniBatch;
+        std::mt19937 generator(core::cFuzzyMiniBatchSeed);
+        std::uniform_int_distribution<size_t> offset(0,stride-1);
+        std::vector<float> sample;
+        sample.reserve(miniBatch);
+        for (size_t i=0; i<miniBatch; ++i) {
+            const size_t idx=i*stride+offset(generator);
+            if ((mask==nullptr) || mask[idx])
+                sample.push_back(static_cast<float>(img[idx]));
+        }
+
+        if (m_nClasses<=sample.size()) {
+            const int nBatch=cluster(sample.data(),sample.size(),nullptr,centers,maxIterations,0,logger);
+            msg<<"The mini-batch of "<<sample.size()<<" pixels used "<<nBatch<<" iterations";
+            logger(kipl::logging::Logger::LogVerbose,msg.str());
+        }
+    }
+
+    std::vector<float> previous(centers);
+    std::vector<Sums> sums(nChunks,Sums(m_nClasses));
+    double change=0.0;
+    double oldChange=0.0;
+    int cnt=0;
+    int r=0;
+
+    for (r=0; r<maxIterations; ++r) {
+        const float *pPrevious= r==0 ? nullptr : previous.data();
+
+        pool.parallel_for(0,nChunks,
+            [&](size_t first, size_t last) {
+                std::vector<float> buffer;
+                for (size_t chunk=first; chunk<last; ++chunk) {
+                    sums[chunk]=Sums(m_nClasses);
+                    size_t n=0;
+                    const float *x=load(chunk,buffer,n);
+                    accumulate(x,n,centers.data(),pPrevious,sums[chunk]);
+                }
+            },1);
+
+        Sums total(m_nClasses);
+        for (const auto &s : sums)
+            total.merge(s);
+
+        previous=centers;
+        updateCenters(total,centers.data());
+        change=std::sqrt(total.change);
+
+        msg.str("");
+        msg<<"Iteration "<<r<<": centers= ";
+        for (auto c : centers)
+            msg<<c<<" ";
+        msg<<" change= "<<change;
+        logger(kipl::logging::Logger::LogVerbose,msg.str());
+
+        if (onIteration)
+            onIteration(r,centers);
+
+        if ((0<r) && converged(change,oldChange,cnt))
+            break;
+    }
+
+    msg.str("");
+    msg<<r<<"("<<maxIterations<<") iterations were used, cnt="<<cnt;
+    logger(kipl::logging::Logger::LogVerbose,msg.str());
+
+    return r;
+}
+
+template <typename ImgType, typename SegType>
+void FuzzyMembership::classify(const ImgType *img, size_t N, const bool *mask, const std::vector<float> &centers, SegType *seg, SegType maskedLabel)
+{
+    const size_t NC=centers.size();
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,N,
+        [&](size_t first, size_t last) {
+            for (size_t i=first; i<last; ++i) {
+                if ((mask!=nullptr) && !mask[i]) {
+                    seg[i]=maskedLabel;
+                    continue;
+                }
+
+                // The largest membership belongs to the nearest center, ties go to the lower class
+                const float x=static_cast<float>(img[i]);
+                size_t best=0;
+                float dist=std::abs(x-centers[0]);
+                for (size_t k=1; k<NC; ++k) {
+                    const float d=std::abs(x-centers[k]);
+                    if (d<dist) {
+                        dist=d;
+                        best=k;
+                    }
+                }
+                seg[i]=static_cast<SegType>(best);
+            }
+        },core::cFuzzyChunkSize);
+}
+
+}}
+
+#endif // FUZZYMEMBERSHIP_HPP
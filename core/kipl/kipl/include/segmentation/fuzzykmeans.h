@@ -11,11 +11,15 @@
 
 #include "../base/timage.h"
 #include "segmentationbase.h"
+#include "fuzzymembership.h"
 #include "../logging/logger.h"
 
 namespace kipl { namespace segmentation {
 
 /// \brief The class performs a fuzzy K-means segmentation of an N-dimensional image
+///
+/// Each iteration is a single parallel pass that computes the memberships and the sums of the next centers,
+/// see FuzzyMembership. The memberships are not stored, the segmentation assigns each pixel to the nearest center.
 /// @author Anders Kaestner
 template<class ImgType, class SegType , size_t NDim>
 class FuzzyKMeans : public SegmentationBase<ImgType,SegType,NDim>
@@ -29,9 +33,9 @@ public:
     ~FuzzyKMeans();
     
     /// \brief Set an initial guess of the center values
-    ///	\param cVec A vector containing te guesses
+    ///	\param cVec An array with one guess per class, it must hold nClasses values
     ///	
-    ///	\note If size(cVec)!=nClasses, an initial guess will be randomized
+    ///	\note Without a guess the initial centers are spread evenly over the data range
 	int setCenters(float const * const cVec) {memcpy(centers,cVec,sizeof(float)*this->nClasses); haveCenters=true; return 0;}
 	
     float const * const getCenters() const { return centers; }
@@ -43,6 +47,10 @@ public:
 	///	\param fuz Fuzziness parameter
 	///	\param maxIt Maximal number of iterations to find the solution
 	int set(int NClasses, float fuz=1.5f, int maxIt=250,bool bSaveIterations=false, std::string sFname="" );
+
+	/// \brief Enables a pre-clustering on a sub-sampled image, the iterations on the full image start from its centers
+	/// \param nSamples Number of pixels in the sub-sample, 0 disables the pre-clustering
+	void setMiniBatch(size_t nSamples) {m_nMiniBatch=nSamples;}
 	
     
 	/// \brief Segments an image
@@ -50,7 +58,7 @@ public:
 	///	\param seg Segmented image
     int operator()(const kipl::base::TImage<ImgType,NDim> & img, kipl::base::TImage<SegType,NDim> &seg);
 
-	/// \brief Segments an image
+	/// \brief Segments an image, the same as operator() which is parallel
 	///	\param img Image to be segmented
 	///	\param seg Segmented image
 	int parallel(const kipl::base::TImage<ImgType,NDim> & img, kipl::base::TImage<SegType,NDim> & seg);
@@ -65,17 +73,20 @@ public:
     /// \brief Interface function that is intended to perform the segmentation
     ///	\param img Input graylevel image
     ///	\param seg Segmented output image
-    virtual int operator()(kipl::base::TImage<ImgType,NDim> & img, kipl::base::TImage<SegType,NDim> &seg) { return 0;}
+    virtual int operator()(kipl::base::TImage<ImgType,NDim> & img, kipl::base::TImage<SegType,NDim> &seg) { return (*this)(static_cast<const kipl::base::TImage<ImgType,NDim> &>(img),seg);}
 
     /// Set the parameters for the segmentation
     virtual void setParameters(std::map<std::string,std::string> parameters) { }
 
 protected:
-	/// \brief Finds initial guesses using random locations in the image
-	///	\param img Original image used to find the guesses
-	int initCenters(const kipl::base::TImage<ImgType,NDim> &img);
-	int initU(kipl::base::TImage<float,2> &img);
-	
+	/// \brief Runs the clustering and stores the final centers
+	///	\param img Image to be segmented
+	/// \param mask Mask of the pixels to use, null uses all pixels
+	void cluster(const kipl::base::TImage<ImgType,NDim> & img, const bool *mask);
+
+	/// \brief Saves the central slice of the current classification
+	void saveIteration(const kipl::base::TImage<ImgType,NDim> & img, int iteration, const std::vector<float> &centers);
+
 	/// Limits the iteration process
 	int maxIterations;
 	/// indicates that a initial guess has been provided
@@ -84,10 +95,10 @@ protected:
 	float *centers;
 	/// Fuzziness coefficient
 	float fuzziness;
-	/// Support variable for the fuzziness
-	float mpower;
 	bool m_bSaveIterations;
 	std::string m_sIterationFileName;
+	/// Number of pixels in the mini-batch pre-clustering
+	size_t m_nMiniBatch;
 };
 
 }}
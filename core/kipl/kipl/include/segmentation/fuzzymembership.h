@@ -0,0 +1,137 @@
+//<LICENCE>
+
+#ifndef FUZZYMEMBERSHIP_H
+#define FUZZYMEMBERSHIP_H
+
+#include "../kipl_global.h"
+
+#include <cstddef>
+#include <vector>
+#include <functional>
+
+#include "../logging/logger.h"
+
+namespace kipl { namespace segmentation {
+
+/// \brief Selects the distance measure of the fuzzy clustering
+enum eFuzzyDistance {
+    FuzzyEuclideanDistance, ///< The squared distance (x-c)^2 of fuzzy c-means
+    FuzzyKernelDistance     ///< The distance 1-K(x,c) with the Gaussian kernel K(x,c)=exp(-(x-c)^2/sigma^2) of kernel fuzzy c-means
+};
+
+/// \brief Computes the memberships and the center updates of fuzzy c-means in one pass over the data.
+///
+/// The membership of class k is u_k=D_k^(-p)/sum_j D_j^(-p) with p=1/(m-1), D is the selected distance and m the fuzziness.
+/// The pass also sums u_k^m*w_k and u_k^m*w_k*x for the next centers, the weight w_k is one for the Euclidean
+/// distance and K(x,c_k) for the kernel distance. The pixels are processed in short blocks with the classes
+/// stored one after the other. The loops over a block use SSE2 or AVX2 kernels selected by kipl::math::simdInstructionSet().
+/// The fuzziness m=2 needs no powers, other values use the SIMD versions of log and exp.
+class KIPLSHARED_EXPORT FuzzyMembership
+{
+public:
+    /// \brief Sums of one part of the data
+    struct KIPLSHARED_EXPORT Sums {
+        Sums(size_t nClasses=0);
+
+        /// \brief Adds the sums of another part
+        void merge(const Sums &s);
+
+        std::vector<double> weight;     ///< Sum of u^m*w per class
+        std::vector<double> weightedX;  ///< Sum of u^m*w*x per class
+        double change;                  ///< Sum of the squared membership changes
+        size_t count;                   ///< Number of pixels
+    };
+
+    /// \brief Prepares the membership computation
+    /// \param nClasses Number of classes
+    /// \param fuzziness The fuzziness m, it must be larger than one
+    /// \param distance The distance measure
+    /// \param sigma Width of the Gaussian kernel
+    /// \throws KiplException if there are less than two classes or the fuzziness is not larger than one
+    FuzzyMembership(size_t nClasses, float fuzziness, eFuzzyDistance distance=FuzzyEuclideanDistance, float sigma=1.0f);
+
+    /// \returns the number of classes
+    size_t classes() const {return m_nClasses;}
+
+    /// \brief Computes the memberships of an array and adds the center sums
+    /// \param x The pixels
+    /// \param N Number of pixels
+    /// \param centers The current centers
+    /// \param previous The centers of the previous iteration, the membership change is computed if it isn't null
+    /// \param sums Receives the sums
+    void accumulate(const float *x, size_t N, const float *centers, const float *previous, Sums &sums) const;
+
+    /// \brief Computes the memberships of an array
+    /// \param x The pixels
+    /// \param N Number of pixels
+    /// \param centers The centers
+    /// \param u Receives the memberships, class k of pixel i is stored at u[k*N+i]
+    void memberships(const float *x, size_t N, const float *centers, float *u) const;
+
+    /// \brief Computes the centers from the sums, classes without weight keep their center. The centers are sorted.
+    /// \param sums The sums of all data
+    /// \param centers The centers to update
+    void updateCenters(const Sums &sums, float *centers) const;
+
+    /// \brief Clusters an image, the iterations stop when the membership change is small or doesn't decrease.
+    /// \param img The pixels
+    /// \param N Number of pixels
+    /// \param mask Pixels with false mask are ignored, null uses all pixels
+    /// \param centers The initial centers, they are replaced by the final centers. An empty vector spreads the initial centers over the data range.
+    /// \param maxIterations The largest number of iterations
+    /// \param miniBatch Number of pixels in a sub-sampled pre-clustering, 0 or a number above half the pixels disables it. The sample takes one pixel at a seeded random position from each of miniBatch equal blocks.
+    /// \param logger Receives the progress messages
+    /// \param onIteration Called after each iteration on the full data with the iteration number and the centers
+    /// \returns the number of iterations on the full data
+    template <typename ImgType>
+    int cluster(const ImgType *img, size_t N, const bool *mask,
+                std::vector<float> &centers,
+                int maxIterations, size_t miniBatch,
+                kipl::logging::Logger &logger,
+                std::function<void(int, const std::vector<float> &)> onIteration=nullptr) const;
+
+    /// \brief Assigns each pixel to the class with the largest membership, i.e. the nearest center
+    /// \param img The pixels
+    /// \param N Number of pixels
+    /// \param mask Pixels with false mask get the label maskedLabel, null classifies all pixels
+    /// \param centers The sorted centers
+    /// \param seg Receives the labels
+    /// \param maskedLabel The label of the masked pixels
+    template <typename ImgType, typename SegType>
+    static void classify(const ImgType *img, size_t N, const bool *mask, const std::vector<float> &centers, SegType *seg, SegType maskedLabel);
+
+protected:
+    /// \brief Scratch buffers of one block
+    struct Block {
+        Block(size_t nClasses);
+        std::vector<float> u;   ///< Memberships
+        std::vector<float> w;   ///< Kernel weights
+        std::vector<float> s;   ///< Per pixel sums
+        std::vector<float> um;  ///< Memberships to the power m
+        std::vector<float> prev;///< Memberships of the previous centers
+    };
+
+    /// \brief Computes the memberships of a block
+    /// \param x The pixels
+    /// \param n Number of pixels, at most core::cFuzzyBlockSize
+    /// \param centers The centers
+    /// \param u Receives the memberships, class major
+    /// \param b The scratch buffers
+    /// \param bPower Also computes u^m into b.um and the kernel weights into b.w
+    void blockMemberships(const float *x, size_t n, const float *centers, float *u, Block &b, bool bPower) const;
+
+    /// \returns true if the iterations stop, the rule follows the original implementation
+    static bool converged(double change, double &oldChange, int &cnt);
+
+    size_t m_nClasses;
+    float m_fFuzziness;
+    float m_fPower;
+    eFuzzyDistance m_eDistance;
+    float m_fSigma;
+};
+
+}}
+
+#include "core/fuzzymembership.hpp"
+
+#endif // FUZZYMEMBERSHIP_H
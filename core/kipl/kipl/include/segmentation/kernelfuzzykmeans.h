@@ -1,7 +1,7 @@
 //<LICENCE>
 
-#ifndef SEGMENTATIONFUZZYCMEANS_H
-#define SEGMENTATIONFUZZYCMEANS_H
+#ifndef SEGMENTATIONKERNELFUZZYCMEANS_H
+#define SEGMENTATIONKERNELFUZZYCMEANS_H
 
 #include <stdlib.h>
 #include <vector>
@@ -13,10 +13,14 @@
 #include "../logging/logger.h"
 
 #include "segmentationbase.h"
+#include "fuzzymembership.h"
 
 namespace kipl { namespace segmentation {
 
-/// \brief The class performs a fuzzy K-means segmentation of an N-dimensional image
+/// \brief The class performs a kernel fuzzy K-means segmentation of an N-dimensional image
+///
+/// The distance to a center is 1-K(x,c) with a Gaussian kernel K, the centers are weighted by the kernel.
+/// Each iteration is a single parallel pass, see FuzzyMembership.
 /// @author Anders Kaestner
 template<typename ImgType, typename SegType , size_t NDim>
 class KernelFuzzyKMeans : public kipl::segmentation::SegmentationBase<ImgType,SegType,NDim>
@@ -44,6 +48,10 @@ public:
 	///	\param fuz Fuzziness parameter
 	///	\param maxIt Maximal number of iterations to find the solution
 	int set(int NClasses, float fuz=1.5f, int maxIt=250);
+
+	/// \brief Enables a pre-clustering on a sub-sampled image, the iterations on the full image start from its centers
+	/// \param nSamples Number of pixels in the sub-sample, 0 disables the pre-clustering
+	void setMiniBatch(size_t nSamples) {m_nMiniBatch=nSamples;}
 	
     
 	/// \brief Segments an image
@@ -51,7 +59,7 @@ public:
 	///	\param seg Segmented image
     int operator()(const kipl::base::TImage<ImgType,NDim> & img, kipl::base::TImage<SegType,NDim> &seg);
 
-	/// \brief Segments an image
+	/// \brief Segments an image, the same as operator() which is parallel
 	///	\param img Image to be segmented
 	///	\param seg Segmented image
 	int parallel(const kipl::base::TImage<ImgType,NDim> & img, kipl::base::TImage<SegType,NDim> & seg);
@@ -62,11 +70,19 @@ public:
     /// \param mask mask image for stayaway regions
     int operator()(const kipl::base::TImage<ImgType,NDim> & img, kipl::base::TImage<SegType,NDim> &seg, const kipl::base::TImage<bool,NDim> & mask);
 
+    /// \brief Interface function that is intended to perform the segmentation
+    ///	\param img Input graylevel image
+    ///	\param seg Segmented output image
+    virtual int operator()(kipl::base::TImage<ImgType,NDim> & img, kipl::base::TImage<SegType,NDim> &seg) { return (*this)(static_cast<const kipl::base::TImage<ImgType,NDim> &>(img),seg);}
+
+    /// Set the parameters for the segmentation
+    virtual void setParameters(std::map<std::string,std::string> parameters) { }
+
 protected:
-	/// \brief Finds initial guesses using random locations in the image
-	///	\param img Original image used to find the guesses
-	int initCenters(const kipl::base::TImage<ImgType,NDim> &img);
-	int initU(kipl::base::TImage<float,2> &img); 
+	/// \brief Runs the clustering and stores the final centers
+	///	\param img Image to be segmented
+	/// \param mask Mask of the pixels to use, null uses all pixels
+	void cluster(const kipl::base::TImage<ImgType,NDim> & img, const bool *mask);
 
 	float Gaussian(float x, float v) { return exp(-(x-v)*(x-v)/(m_fSigma*m_fSigma));}
 	
@@ -78,10 +94,10 @@ protected:
 	float *centers;
 	/// Fuzziness coefficient
 	float fuzziness;
-	/// Support variable for the fuzziness
-	float mpower;
 	/// Width of the Gaussian
 	float m_fSigma;
+	/// Number of pixels in the mini-batch pre-clustering
+	size_t m_nMiniBatch;
 };
 
 }}
@@ -0,0 +1,110 @@
+//<LICENCE>
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+namespace kipl { namespace utilities {
+
+/// \brief A first-in first-out queue with limited capacity that connects producer and consumer threads.
+///
+/// push blocks while the queue is full and pop blocks while it is empty. A closed queue accepts no more items,
+/// the consumers receive the remaining items before pop reports the end. An aborted queue drops its items and
+/// releases all waiting threads, it is used to stop a pipeline after an error.
+template <typename T>
+class BoundedQueue
+{
+public:
+    /// \param capacity The largest number of items in the queue, at least one
+    explicit BoundedQueue(size_t capacity=1) :
+        m_nCapacity(capacity<1 ? 1 : capacity),
+        m_bClosed(false),
+        m_bAborted(false)
+    {}
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue & operator=(const BoundedQueue &) = delete;
+
+    /// \brief Adds an item, waits while the queue is full
+    /// \param item The item to add
+    /// \returns false if the queue was closed or aborted, the item is then dropped
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_NotFull.wait(lock,[this]{return (m_Items.size()<m_nCapacity) || m_bClosed || m_bAborted;});
+
+        if (m_bClosed || m_bAborted)
+            return false;
+
+        m_Items.push_back(std::move(item));
+        m_NotEmpty.notify_one();
+
+        return true;
+    }
+
+    /// \brief Takes the oldest item, waits while the queue is empty
+    /// \param item Receives the item
+    /// \returns false if the queue is closed and empty or if it was aborted
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_NotEmpty.wait(lock,[this]{return !m_Items.empty() || m_bClosed || m_bAborted;});
+
+        if (m_bAborted || m_Items.empty())
+            return false;
+
+        item=std::move(m_Items.front());
+        m_Items.pop_front();
+        m_NotFull.notify_one();
+
+        return true;
+    }
+
+    /// \brief Ends the input, the consumers receive the remaining items
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bClosed=true;
+        m_NotEmpty.notify_all();
+        m_NotFull.notify_all();
+    }
+
+    /// \brief Drops the items and releases all waiting threads
+    void abort()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bAborted=true;
+        m_Items.clear();
+        m_NotEmpty.notify_all();
+        m_NotFull.notify_all();
+    }
+
+    /// \returns the number of items in the queue
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        return m_Items.size();
+    }
+
+    /// \returns the largest number of items in the queue
+    size_t capacity() const { return m_nCapacity; }
+
+private:
+    const size_t m_nCapacity;
+    std::deque<T> m_Items;
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_NotEmpty;
+    std::condition_variable m_NotFull;
+    bool m_bClosed;
+    bool m_bAborted;
+};
+
+}}
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,94 @@
+//<LICENCE>
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "../kipl_global.h"
+
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace kipl { namespace utilities {
+
+/// \brief A pool of worker threads that distributes index ranges with work stealing.
+///
+/// Each worker owns a task queue. A parallel loop splits its range in blocks and spreads them over the queues,
+/// a worker takes blocks from the back of its own queue and steals from the front of the other queues when
+/// its own queue is empty. The calling thread takes part in the processing while it waits, loops can therefore
+/// be nested without blocking the pool and without starting additional threads.
+///
+/// The process wide pool returned by global() is sized by the thread budget, all processing modules share it.
+class KIPLSHARED_EXPORT ThreadPool
+{
+public:
+    /// \brief Starts the worker threads.
+    /// \param nThreads The number of threads used by a parallel loop including the calling thread, 0 uses all cores.
+    ThreadPool(size_t nThreads=0);
+
+    /// \brief Stops and joins the worker threads. Pending loops must have finished.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    /// \returns the number of threads that take part in a parallel loop, i.e. the workers and the calling thread.
+    size_t size() const { return m_Workers.size()+1; }
+
+    /// \brief Calls fn for consecutive blocks of the index range [begin,end) in parallel and returns when all blocks are done.
+    /// \param begin First index of the range
+    /// \param end One past the last index of the range
+    /// \param fn Function that processes the indices [first,last)
+    /// \param grain Number of indices per block, 0 selects about four blocks per thread.
+    /// \throws The first exception thrown by fn is rethrown after all started blocks are done, the remaining blocks are skipped.
+    void parallel_for(size_t begin, size_t end, const std::function<void(size_t first, size_t last)> &fn, size_t grain=0);
+
+    /// \returns the process wide pool, it is created with the current thread budget on first use.
+    static ThreadPool & global();
+
+    /// \brief Sets the number of threads of the process wide pool.
+    /// \param nThreads The thread budget including the calling thread, 0 uses all cores.
+    /// \note global() returns a pool of the new size after the call. The previous pool is kept until the process ends,
+    /// loops running on it finish normally and references to it stay valid. Its threads sleep while it is not used.
+    static void setGlobalThreadBudget(size_t nThreads);
+
+    /// \returns the thread budget of the process wide pool.
+    static size_t globalThreadBudget();
+
+private:
+    struct TaskGroup;
+
+    /// \brief A block of indices belonging to a parallel loop
+    struct Task {
+        TaskGroup *group;
+        size_t first;
+        size_t last;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(size_t idx);
+    bool popTask(size_t idx, Task &task);
+    void runTask(Task &task);
+
+    std::vector<std::thread> m_Workers;
+    std::vector<std::unique_ptr<WorkerQueue>> m_Queues;   ///< One queue per worker and one for external callers
+    std::atomic<size_t> m_nQueued;                        ///< Number of blocks waiting in the queues
+    std::atomic<size_t> m_nNextQueue;                     ///< Round robin start for external callers
+    std::mutex m_WakeMutex;
+    std::condition_variable m_WakeCondition;
+    bool m_bStop;
+};
+
+}}
+
+#endif // THREADPOOL_H
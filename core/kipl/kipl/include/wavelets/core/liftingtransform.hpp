@@ -0,0 +1,302 @@
+//<LICENCE>
+
+#ifndef LIFTINGTRANSFORM_HPP
+#define LIFTINGTRANSFORM_HPP
+
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <cmath>
+
+#include "../../base/KiplException.h"
+#include "../../utilities/threadpool.h"
+
+namespace kipl { namespace wavelets { namespace core {
+
+/// Number of neighbouring lines that are processed together by the passes along y and z
+const size_t cLiftingBlockWidth = 64;
+
+/// Wraps an index periodically into the range [0,m)
+inline ptrdiff_t liftingWrap(ptrdiff_t k, ptrdiff_t m)
+{
+    k=k % m;
+
+    return k<0 ? k+m : k;
+}
+
+}
+
+template <typename T, size_t N>
+LiftingTransform<T,N>::LiftingTransform(const std::string &name) :
+    m_Scheme(name),
+    m_nLevels(0)
+{
+    static_assert((N==2) || (N==3),"The lifting transform is implemented for 2D and 3D images");
+}
+
+template <typename T, size_t N>
+void LiftingTransform<T,N>::transform(const kipl::base::TImage<T,N> &img, int levels)
+{
+    if (levels<1)
+        throw kipl::base::KiplException("The lifting transform needs at least one level",__FILE__,__LINE__);
+
+    m_Coefficients.Clone(img);
+    m_nLevels=levels;
+
+    size_t dims[N];
+    levelDims(levels,dims);
+    for (size_t k=0; k<N; ++k) {
+        if (dims[k]<2) {
+            std::ostringstream msg;
+            msg<<"The image is too small for a lifting transform with "<<levels<<" levels";
+            m_nLevels=0;
+            throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+        }
+    }
+
+    for (int level=1; level<=m_nLevels; ++level) {
+        levelDims(level,dims);
+        for (size_t axis=0; axis<N; ++axis)
+            pass(m_Coefficients.GetDataPtr(),dims,axis,true);
+    }
+}
+
+template <typename T, size_t N>
+kipl::base::TImage<T,N> LiftingTransform<T,N>::synthesize() const
+{
+    kipl::base::TImage<T,N> img;
+    img.Clone(m_Coefficients);
+
+    size_t dims[N];
+    for (int level=m_nLevels; 1<=level; --level) {
+        levelDims(level,dims);
+        for (size_t axis=N; 0<axis; --axis)
+            pass(img.GetDataPtr(),dims,axis-1,false);
+    }
+
+    return img;
+}
+
+template <typename T, size_t N>
+void LiftingTransform<T,N>::levelDims(int level, size_t *dims) const
+{
+    for (size_t k=0; k<N; ++k) {
+        dims[k]=m_Coefficients.Size(k);
+        for (int i=1; i<level; ++i)
+            dims[k]=(dims[k]+1)/2;
+    }
+}
+
+template <typename T, size_t N>
+void LiftingTransform<T,N>::region(int level, int band, size_t *origin, size_t *dims) const
+{
+    if ((level<1) || (m_nLevels<level) || (band<0) || ((1<<N)<=band)) {
+        std::ostringstream msg;
+        msg<<"Invalid subband "<<band<<" at level "<<level<<" of a lifting transform with "<<m_nLevels<<" levels";
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    levelDims(level,dims);
+    for (size_t k=0; k<N; ++k) {
+        const size_t low=(dims[k]+1)/2;
+        if (band & (1<<k)) {
+            origin[k]=low;
+            dims[k]-=low;
+        }
+        else {
+            origin[k]=0;
+            dims[k]=low;
+        }
+    }
+}
+
+template <typename T, size_t N>
+kipl::base::TImage<T,N> LiftingTransform<T,N>::subband(int level, int band) const
+{
+    size_t origin[N];
+    size_t dims[N];
+    region(level,band,origin,dims);
+
+    kipl::base::TImage<T,N> img(dims);
+    const size_t nz = N==3 ? dims[2] : 1;
+    for (size_t z=0; z<nz; ++z) {
+        for (size_t y=0; y<dims[1]; ++y) {
+            const T *src = N==3 ? m_Coefficients.GetLinePtr(origin[1]+y,origin[2]+z) : m_Coefficients.GetLinePtr(origin[1]+y);
+            std::copy_n(src+origin[0],dims[0],img.GetLinePtr(y,z));
+        }
+    }
+
+    return img;
+}
+
+template <typename T, size_t N>
+void LiftingTransform<T,N>::setSubband(int level, int band, const kipl::base::TImage<T,N> &img)
+{
+    size_t origin[N];
+    size_t dims[N];
+    region(level,band,origin,dims);
+
+    for (size_t k=0; k<N; ++k)
+        if (img.Size(k)!=dims[k])
+            throw kipl::base::KiplException("The image size doesn't match the subband",__FILE__,__LINE__);
+
+    const size_t nz = N==3 ? dims[2] : 1;
+    for (size_t z=0; z<nz; ++z) {
+        for (size_t y=0; y<dims[1]; ++y) {
+            T *dst = N==3 ? m_Coefficients.GetLinePtr(origin[1]+y,origin[2]+z) : m_Coefficients.GetLinePtr(origin[1]+y);
+            std::copy_n(img.GetLinePtr(y,z),dims[0],dst+origin[0]);
+        }
+    }
+}
+
+template <typename T, size_t N>
+void LiftingTransform<T,N>::pass(T *data, const size_t *dims, size_t axis, bool forward) const
+{
+    size_t strides[3]={1, m_Coefficients.Size(0), N==3 ? m_Coefficients.Size(0)*m_Coefficients.Size(1) : 0};
+
+    const size_t n  = dims[axis];
+    const size_t S  = strides[axis];
+    const size_t ns = (n+1)/2;
+    const size_t nd = n/2;
+
+    // The lines are grouped in blocks of W neighbouring lines along x, a row pass has single lines.
+    // The other axis indexes the blocks together with the block position along x.
+    const size_t B       = axis==0 ? 1 : std::min(core::cLiftingBlockWidth,dims[0]);
+    const size_t nBlocks = axis==0 ? 1 : (dims[0]+B-1)/B;
+    size_t otherAxes[2];
+    size_t nOther=0;
+    for (size_t k=1; k<N; ++k)
+        if (k!=axis)
+            otherAxes[nOther++]=k;
+
+    size_t nGroups=nBlocks;
+    for (size_t i=0; i<nOther; ++i)
+        nGroups*=dims[otherAxes[i]];
+
+    const double K0=m_Scheme.approximationScale();
+    const double K1=m_Scheme.detailScale();
+    const double invK0=1.0/K0;
+    const double invK1=1.0/K1;
+    const double cOddScale=std::sqrt(2.0); // Scales the unpaired last sample of odd lines like the low pass scales a constant
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,nGroups,
+        [&](size_t first, size_t last) {
+            std::vector<double> s(ns*B);
+            std::vector<double> d(nd*B);
+
+            for (size_t group=first; group<last; ++group) {
+                size_t rest=group;
+                const size_t block=rest % nBlocks;
+                rest/=nBlocks;
+                size_t base=block*B;
+                for (size_t i=0; i<nOther; ++i) {
+                    base+=(rest % dims[otherAxes[i]])*strides[otherAxes[i]];
+                    rest/=dims[otherAxes[i]];
+                }
+
+                const size_t W=std::min(B,dims[0]-block*B);
+                T *p=data+base;
+
+                if (forward) {
+                    for (size_t i=0; i<ns; ++i)
+                        std::copy_n(p+2*i*S,W,s.begin()+i*W);
+                    for (size_t i=0; i<nd; ++i)
+                        std::copy_n(p+(2*i+1)*S,W,d.begin()+i*W);
+
+                    lift(s.data(),d.data(),nd,W,true);
+
+                    for (size_t i=0; i<ns; ++i) {
+                        T *dst=p+i*S;
+                        const double *src=s.data()+i*W;
+                        const double k = i<nd ? K0 : cOddScale;
+                        for (size_t l=0; l<W; ++l)
+                            dst[l]=static_cast<T>(k*src[l]);
+                    }
+                    for (size_t i=0; i<nd; ++i) {
+                        T *dst=p+(ns+i)*S;
+                        const double *src=d.data()+i*W;
+                        for (size_t l=0; l<W; ++l)
+                            dst[l]=static_cast<T>(K1*src[l]);
+                    }
+                }
+                else {
+                    for (size_t i=0; i<ns; ++i) {
+                        const T *src=p+i*S;
+                        double *dst=s.data()+i*W;
+                        const double k = i<nd ? invK0 : 1.0/cOddScale;
+                        for (size_t l=0; l<W; ++l)
+                            dst[l]=k*src[l];
+                    }
+                    for (size_t i=0; i<nd; ++i) {
+                        const T *src=p+(ns+i)*S;
+                        double *dst=d.data()+i*W;
+                        for (size_t l=0; l<W; ++l)
+                            dst[l]=invK1*src[l];
+                    }
+
+                    lift(s.data(),d.data(),nd,W,false);
+
+                    for (size_t i=0; i<ns; ++i) {
+                        T *dst=p+2*i*S;
+                        const double *src=s.data()+i*W;
+                        for (size_t l=0; l<W; ++l)
+                            dst[l]=static_cast<T>(src[l]);
+                    }
+                    for (size_t i=0; i<nd; ++i) {
+                        T *dst=p+(2*i+1)*S;
+                        const double *src=d.data()+i*W;
+                        for (size_t l=0; l<W; ++l)
+                            dst[l]=static_cast<T>(src[l]);
+                    }
+                }
+            }
+        });
+}
+
+template <typename T, size_t N>
+void LiftingTransform<T,N>::lift(double *s, double *d, size_t m, size_t W, bool forward) const
+{
+    const std::vector<LiftingScheme::Step> &steps=m_Scheme.steps();
+    const size_t nSteps=steps.size();
+    const ptrdiff_t n = static_cast<ptrdiff_t>(m);
+    const ptrdiff_t w = static_cast<ptrdiff_t>(W);
+
+    for (size_t idx=0; idx<nSteps; ++idx) {
+        const LiftingScheme::Step &step = forward ? steps[idx] : steps[nSteps-1-idx];
+
+        double *dst          = step.update ? s : d;
+        const double *src    = step.update ? d : s;
+        const ptrdiff_t taps = static_cast<ptrdiff_t>(step.coef.size());
+        const ptrdiff_t first= static_cast<ptrdiff_t>(step.first);
+
+        // Positions where all taps are inside the source channel
+        const ptrdiff_t iLo = std::min(n,std::max(ptrdiff_t(0),-first));
+        const ptrdiff_t iHi = std::max(iLo,std::min(n,n-first-taps+1));
+
+        for (ptrdiff_t t=0; t<taps; ++t) {
+            const double c = forward ? step.coef[t] : -step.coef[t];
+
+            double *pDst=dst+iLo*w;
+            const double *pSrc=src+(iLo+first+t)*w;
+            const ptrdiff_t len=(iHi-iLo)*w;
+            for (ptrdiff_t j=0; j<len; ++j)
+                pDst[j]+=c*pSrc[j];
+
+            for (ptrdiff_t i=0; i<n; ++i) {
+                if (i==iLo)
+                    i=iHi;
+                if (n<=i)
+                    break;
+
+                const double *pWrap=src+core::liftingWrap(i+first+t,n)*w;
+                double *pEdge=dst+i*w;
+                for (ptrdiff_t l=0; l<w; ++l)
+                    pEdge[l]+=c*pWrap[l];
+            }
+        }
+    }
+}
+
+}}
+
+#endif // LIFTINGTRANSFORM_HPP
@@ -93,6 +93,9 @@ list<std::string> WaveletKernel<T>::NameList() {
 	names.push_back("daub28");
 	names.push_back("daub29");
 	names.push_back("daub30");
+	names.push_back("haar");
+	for (int i=1; i<=10; i++)
+		names.push_back("sym"+std::to_string(i));
 
 	return names;
 
@@ -116,7 +119,7 @@ void WaveletKernel<T>::BuildKernel(std::string name)
 			break;
 		}
 		case 3: {
-			double daub3[]={0.332670552950082615998512, 0.806891509311092576494494, 0.459877502118491570095152, -0.135011020010254588696390, 0.085441273882026661692819, 0.0352262918857095366027407};
+			double daub3[]={0.332670552950082615998512, 0.806891509311092576494494, 0.459877502118491570095152, -0.135011020010254588696390, -0.085441273882026661692819, 0.0352262918857095366027407};
 			CopyKernel(daub3,0,5);
 			break;
 		}
@@ -381,6 +384,59 @@ void WaveletKernel<T>::BuildKernel(std::string name)
 			throw kipl::base::KiplException("Daubechies are only supported for N<=30", __FILE__, __LINE__);
 		}
 	}
+	else if (name=="haar") {
+		double haar[]={0.707106781186547524400844362104849, 0.707106781186547524400844362104849};
+		CopyKernel(haar,0,1);
+	}
+	else if (name.substr(0,3)=="sym") {
+		// Symlets 1-3 coincide with Daubechies 1-3
+		int N=atoi(name.substr(3).c_str());
+		switch (N) {
+		case 1: BuildKernel("daub1"); break;
+		case 2: BuildKernel("daub2"); break;
+		case 3: BuildKernel("daub3"); break;
+		case 4: {
+			double sym4[]={-0.07576571478950233, -0.02963552764600275, 0.497618667632775, 0.8037387518051327, 0.2978577956053062, -0.09921954357663366, -0.01260396726203138, 0.03222310060405147};
+			CopyKernel(sym4,0,7);
+			break;
+		}
+		case 5: {
+			double sym5[]={0.0195388827352497, -0.02110183402468898, -0.1753280899080548, 0.01660210576451275, 0.6339789634567916, 0.7234076904040388, 0.1993975339768545, -0.03913424930231376, 0.02951949092570631, 0.02733306834499873};
+			CopyKernel(sym5,0,9);
+			break;
+		}
+		case 6: {
+			double sym6[]={0.01540410932704474, 0.003490712084221531, -0.1179901111485212, -0.04831174258569789, 0.4910559419279768, 0.7876411410286536, 0.3379294217281644, -0.07263752278637825, -0.02106029251237119, 0.04472490177078142, 0.001767711864253766, -0.007800708325032496};
+			CopyKernel(sym6,0,11);
+			break;
+		}
+		case 7: {
+			double sym7[]={0.01026817670846495, 0.004010244871523197, -0.1078082377032895, -0.1400472404429405, 0.2886296317506303, 0.7677643170048699, 0.5361019170905749, 0.01744125508685128, -0.04955283493703385, 0.06789269350122353, 0.03051551316588014, -0.01263630340323927, -0.001047384888679668, 0.002681814568260057};
+			CopyKernel(sym7,0,13);
+			break;
+		}
+		case 8: {
+			double sym8[]={-0.003382415951003908, -0.000542132331797018, 0.03169508781151886, 0.00760748732494897, -0.1432942383512576, -0.06127335906765891, 0.4813596512592537, 0.7771857516996492, 0.3644418948360139, -0.05194583810802026, -0.02721902991713553, 0.04913717967372511, 0.003808752013880463, -0.01495225833706814, -0.0003029205147226741, 0.001889950332768561};
+			CopyKernel(sym8,0,15);
+			break;
+		}
+		case 9: {
+			double sym9[]={0.001069490032908175, -0.0004731544986808867, -0.01026406402762793, 0.008859267493410117, 0.06207778930285313, -0.01823377077946773, -0.1915508312971598, 0.03527248803579076, 0.6173384491414731, 0.7178970827644066, 0.2387609146068536, -0.05456895843120489, 0.0005834627459892242, 0.03022487885821281, -0.01152821020772933, -0.01327196778183437, 0.0006197808889867399, 0.001400915525915921};
+			CopyKernel(sym9,0,17);
+			break;
+		}
+		case 10: {
+			double sym10[]={0.0007701598091036597, 0.00009563267068491565, -0.008641299277002591, -0.001465382581138532, 0.04592723923095083, 0.0116098939028464, -0.1594942788849671, -0.0708805357805798, 0.4716906669415791, 0.7695100370206782, 0.3838267610640166, -0.03553674047551473, -0.03199005688220715, 0.04999497207760673, 0.005764912033412411, -0.02035493981234203, -0.0008043589319389408, 0.004593173585320195, 0.00005703608359777954, -0.0004593294210107238};
+			CopyKernel(sym10,0,19);
+			break;
+		}
+		default :
+			throw kipl::base::KiplException("Symlets are only supported for N<=10", __FILE__, __LINE__);
+		}
+		m_sName=name;
+	}
+	else
+		throw kipl::base::KiplException("Unknown wavelet "+name, __FILE__, __LINE__);
 
 }
 
@@ -0,0 +1,69 @@
+//<LICENCE>
+
+#ifndef LIFTINGSCHEME_H
+#define LIFTINGSCHEME_H
+
+#include "../kipl_global.h"
+
+#include <string>
+#include <vector>
+#include <list>
+
+namespace kipl { namespace wavelets {
+
+/// \brief Factorization of an orthogonal wavelet kernel into lifting steps.
+///
+/// The polyphase matrix of the kernel is factored by the Euclidean algorithm of Daubechies and Sweldens.
+/// A signal x is split into s[n]=x[2n] and d[n]=x[2n+1], the steps are applied in order and the channels are
+/// finally scaled. The interior coefficients equal the filter bank a[n]=sum_k h[k]x[2n+k] and
+/// d[n]=sum_k g[k]x[2n+k] delayed by approximationShift() and detailShift() samples. Each step can be undone
+/// by subtracting the same sum, the inverse transform applies the steps in reverse order.
+class KIPLSHARED_EXPORT LiftingScheme
+{
+public:
+    /// \brief One lifting step
+    struct Step {
+        bool update;                ///< Update step s[n]+=sum_i coef[i]*d[n+first+i], otherwise the predict step d[n]+=sum_i coef[i]*s[n+first+i]
+        int first;                  ///< Offset of the first coefficient
+        std::vector<double> coef;   ///< The coefficients
+    };
+
+    /// \brief Factors a kernel
+    /// \param name Name of the kernel, see WaveletKernel.
+    /// \throws KiplException if the kernel is not in NameList() or the factorization is not accurate enough
+    LiftingScheme(const std::string &name);
+
+    /// \returns the name of the kernel
+    const std::string & name() const {return m_sName;}
+
+    /// \returns the lifting steps in the order they are applied by the forward transform
+    const std::vector<Step> & steps() const {return m_Steps;}
+
+    /// \returns the scale factor of the approximation channel
+    double approximationScale() const {return m_fScale[0];}
+
+    /// \returns the scale factor of the detail channel
+    double detailScale() const {return m_fScale[1];}
+
+    /// \returns the delay of the approximation coefficients relative to the filter bank
+    int approximationShift() const {return m_nShift[0];}
+
+    /// \returns the delay of the detail coefficients relative to the filter bank
+    int detailShift() const {return m_nShift[1];}
+
+    /// \returns an upper bound of the number of coefficients at each end of a channel that depend on the boundary extension
+    int boundaryWidth() const;
+
+    /// \returns the kernels that can be used with the lifting scheme. Longer kernels are excluded as the search for a well conditioned factorization grows exponentially with the length.
+    static std::list<std::string> NameList();
+
+private:
+    std::string m_sName;
+    std::vector<Step> m_Steps;
+    double m_fScale[2];
+    int m_nShift[2];
+};
+
+}}
+
+#endif // LIFTINGSCHEME_H
@@ -0,0 +1,108 @@
+//<LICENCE>
+
+#ifndef LIFTINGTRANSFORM_H
+#define LIFTINGTRANSFORM_H
+
+#include <string>
+#include <vector>
+
+#include "../base/timage.h"
+#include "liftingscheme.h"
+
+namespace kipl { namespace wavelets {
+
+/// \brief Multi-level discrete wavelet transform of 2D and 3D images using the lifting scheme.
+///
+/// All levels are stored in place in one coefficient image with the size of the input image (Mallat layout).
+/// Each level splits its region into a low half with ceil(n/2) and a high half with floor(n/2) coefficients
+/// along every axis, the next level transforms the low region in the top left corner. The lines are extended
+/// periodically, which keeps the transform orthogonal and well conditioned for all kernels. The last sample of
+/// a line with odd length has no partner, it is scaled by sqrt(2) and stored as the last low pass coefficient.
+/// The transform is therefore critically sampled and perfectly invertible also for odd sizes.
+///
+/// The subbands of a level are indexed by bits, bit k is set when the band is high pass along axis k.
+/// In 2D band 0 is the approximation, band 1 is high pass along x (the v component of WaveletQuad),
+/// band 2 is high pass along y (the h component) and band 3 is the diagonal detail. A 3D transform has
+/// eight bands per level.
+///
+/// The rows are transformed in parallel. The passes along y and z process blocks of neighbouring lines
+/// together, their inner loops run over contiguous memory and are vectorized by the compiler.
+/// \tparam T Pixel type, float or double
+/// \tparam N Number of image dimensions, 2 or 3
+template <typename T, size_t N>
+class LiftingTransform
+{
+public:
+    /// \brief Prepares the transform
+    /// \param name Name of the wavelet kernel, see LiftingScheme::NameList()
+    /// \throws KiplException if the kernel is not supported
+    LiftingTransform(const std::string &name);
+
+    /// \brief Computes the transform of an image
+    /// \param img The image to transform, it is not changed.
+    /// \param levels Number of decomposition levels
+    /// \throws KiplException if a region is shorter than two samples along any axis at the last level
+    void transform(const kipl::base::TImage<T,N> &img, int levels);
+
+    /// \returns the reconstructed image computed from the current coefficients
+    kipl::base::TImage<T,N> synthesize() const;
+
+    /// \returns the number of levels of the current transform
+    int levels() const {return m_nLevels;}
+
+    /// \returns the coefficient image with all levels
+    kipl::base::TImage<T,N> & coefficients() {return m_Coefficients;}
+
+    /// \returns the coefficient image with all levels
+    const kipl::base::TImage<T,N> & coefficients() const {return m_Coefficients;}
+
+    /// \brief Computes the position of a subband in the coefficient image
+    /// \param level The level starting at 1
+    /// \param band Band index, the approximation band 0 is only stored for the last level.
+    /// \param origin Receives the position of the first coefficient
+    /// \param dims Receives the size of the band
+    void region(int level, int band, size_t *origin, size_t *dims) const;
+
+    /// \returns a copy of a subband
+    /// \param level The level starting at 1
+    /// \param band Band index
+    kipl::base::TImage<T,N> subband(int level, int band) const;
+
+    /// \brief Replaces a subband, e.g. after filtering it
+    /// \param level The level starting at 1
+    /// \param band Band index
+    /// \param img The new coefficients, it must have the size of the band.
+    /// \throws KiplException if the size doesn't match the band
+    void setSubband(int level, int band, const kipl::base::TImage<T,N> &img);
+
+    /// \returns the lifting scheme of the kernel
+    const LiftingScheme & scheme() const {return m_Scheme;}
+
+protected:
+    /// \brief Computes the size of the region that is transformed at a level
+    void levelDims(int level, size_t *dims) const;
+
+    /// \brief Transforms a region along one axis
+    /// \param data Pointer to the first element of the region
+    /// \param dims Size of the region
+    /// \param axis The transformed axis
+    /// \param forward Selects the forward or the inverse transform
+    void pass(T *data, const size_t *dims, size_t axis, bool forward) const;
+
+    /// \brief Applies the lifting steps to W interleaved lines, element i of line l is stored at i*W+l.
+    /// The steps are computed in double precision as the intermediate values of the longer kernels have large cancellations.
+    /// \param s The even samples
+    /// \param d The odd samples
+    /// \param m Number of sample pairs, the channels are extended periodically.
+    void lift(double *s, double *d, size_t m, size_t W, bool forward) const;
+
+    LiftingScheme m_Scheme;
+    kipl::base::TImage<T,N> m_Coefficients;
+    int m_nLevels;
+};
+
+}}
+
+#include "core/liftingtransform.hpp"
+
+#endif // LIFTINGTRANSFORM_H
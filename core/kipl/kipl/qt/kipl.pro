@@ -67,6 +67,9 @@ SOURCES += \
     ../src/io/core/matlabio.cpp \
     ../src/io/core/io_fits.cpp \
     ../src/io/io_vivaseq.cpp \
+    ../src/io/mappedsequencereader.cpp \
+    ../src/io/nexusreader.cpp \
+    ../src/io/nexuswriter.cpp \
     ../src/generators/Sine2D.cpp \
     ../src/generators/SignalGenerator.cpp \
     ../src/generators/SequenceImage.cpp \
@@ -83,19 +86,25 @@ SOURCES += \
     ../src/base/core/imagearithmetics.cpp \
     ../src/base/core/histogram.cpp \
     ../src/base/core/aligned_malloc.cpp \
+    ../src/base/core/bufferpool.cpp \
     ../src/wavelets/wavelets.cpp \
+    ../src/wavelets/liftingscheme.cpp \
     ../src/visualization/GNUPlot.cpp \
     ../src/utilities/SystemInformation.cpp \
     ../src/utilities/nodelocker.cpp \
+    ../src/utilities/threadpool.cpp \
     ../src/strings/string2array.cpp \
     ../src/strings/parenc.cpp \
     ../src/strings/miscstring.cpp \
     ../src/strings/filenames.cpp \
     ../src/segmentation/wsthres.cpp \
     ../src/segmentation/thresholds.cpp \
+    ../src/segmentation/fuzzymembership.cpp \
     ../src/scalespace/filterenums.cpp \
+    ../src/scalespace/isskernels.cpp \
     ../src/profile/Timer.cpp \
     ../src/profile/MicroTimer.cpp \
+    ../src/profile/Tracer.cpp \
     ../src/octree/octree.cpp \
     ../src/morphology/morphology.cpp \
     ../src/morphology/morphdist.cpp \
@@ -122,6 +131,8 @@ SOURCES += \
     ../src/base/roi.cpp \
     ../src/math/findpeaks.cpp \
     ../src/math/normalizeimage.cpp \
+    ../src/math/fastmath.cpp \
+    ../src/math/batchfit.cpp \
     ../src/stltools/stlvecmath.cpp \
     ../src/strings/xmlstrings.cpp
 #    ../src/math/gradient.cpp
@@ -140,6 +151,7 @@ HEADERS +=\
     ../include/base/timagetests.h \
     ../include/base/timage.h \
     ../include/base/thistogram.h \
+    ../include/base/histogramengine.h \
     ../include/base/textractor.h \
     ../include/base/KiplException.h \
     ../include/base/kiplenums.h \
@@ -155,6 +167,7 @@ HEADERS +=\
     ../include/base/core/timage.hpp \
     ../include/base/core/textractor.hpp \
     ../include/base/core/sharedbuffer.h \
+    ../include/base/core/bufferpool.h \
     ../include/base/core/quad.h \
     ../include/base/core/imagesamplers.hpp \
     ../include/base/core/imagecast.hpp \
@@ -239,10 +252,12 @@ HEADERS +=\
     ../include/segmentation/mapupdater.h \
     ../include/segmentation/kernelfuzzykmeans.h \
     ../include/segmentation/fuzzykmeans.h \
+    ../include/segmentation/fuzzymembership.h \
     ../include/segmentation/core/multiresseg.hpp \
     ../include/segmentation/core/mapupdater.hpp \
     ../include/segmentation/core/kernelfuzzykmeans.hpp \
     ../include/segmentation/core/fuzzykmeans.hpp \
+    ../include/segmentation/core/fuzzymembership.hpp \
     ../include/segmentation/core/ClassGrowing.hpp \
     ../include/segmentation/ClassGrowing.h \
     ../include/segmentation/bigunupdater.h \
@@ -251,6 +266,7 @@ HEADERS +=\
     ../include/scalespace/NonLinDiffAOS.h \
     ../include/scalespace/lambdaest.h \
     ../include/scalespace/ISSfilterQ3Dp.h \
+    ../include/scalespace/isskernels.h \
     ../include/scalespace/ISSfilterQ3D.h \
     ../include/scalespace/ISSfilterOrig3D.h \
     ../include/scalespace/ISSfilter2D.h \
@@ -282,15 +298,27 @@ HEADERS +=\
     ../include/queuefilter/basequeueworker.h \
     ../include/queuefilter/baseneighborhoodoperatorworker.h \
     ../include/queuefilter/absgradworker.h \
+    ../include/queuefilter/slicestream.h \
+    ../include/queuefilter/core/slicestream.hpp \
+    ../include/queuefilter/sliceworkers.h \
+    ../include/queuefilter/core/sliceworkers.hpp \
+    ../include/queuefilter/slicestreamio.h \
+    ../include/queuefilter/core/slicestreamio.hpp \
     ../include/profile/Timer.h \
     ../include/profile/MicroTimer.h \
+    ../include/profile/Tracer.h \
     ../include/porespace/poresize.h \
     ../include/porespace/core/poresize.hpp \
     ../include/wavelets/wavelets.h \
     ../include/wavelets/core/wavelets.hpp \
+    ../include/wavelets/liftingscheme.h \
+    ../include/wavelets/liftingtransform.h \
+    ../include/wavelets/core/liftingtransform.hpp \
     ../include/visualization/GNUPlot.h \
     ../include/utilities/SystemInformation.h \
     ../include/utilities/nodelocker.h \
+    ../include/utilities/threadpool.h \
+    ../include/utilities/boundedqueue.h \
     ../include/strings/string2array.h \
     ../include/strings/parenc.h \
     ../include/strings/miscstring.h \
@@ -302,12 +330,16 @@ HEADERS +=\
     ../include/logging/logger.h \
     ../include/utilities/TimeDate.h \
     ../include/math/covariance.h \
+    ../include/math/fastmath.h \
+    ../include/math/batchfit.h \
+    ../include/math/core/batchfit.hpp \
     ../include/pca/pca.h \
     ../include/math/tnt_utils.h \
     ../include/math/core/covariance.hpp \
     ../include/filters/GaborFilter.h \
     ../include/morphology/skeleton.h \
     ../include/base/core/thistogram.hpp \
+    ../include/base/core/histogramengine.hpp \
     ../include/math/linfit.h \
     ../include/math/core/linfit.hpp \
     ../include/base/tprofile.h \
@@ -323,12 +355,16 @@ HEADERS +=\
     ../include/filters/stddevfilter.h \
     ../include/interactors/interactionbase.h \
     ../include/containers/ringbuffer.h \
+    ../include/containers/lockfreequeue.h \
     ../include/segmentation/multivariateclassifyerbase.h \
     ../include/morphology/pixeliterator.h \
     ../include/segmentation/gradientguidedthreshold.h \
     ../include/segmentation/core/gradientguidedthreshold.hpp \
     ../include/morphology/morphgeo2.h \
     ../include/io/io_vivaseq.h \
+    ../include/io/mappedsequencereader.h \
+    ../include/io/nexusreader.h \
+    ../include/io/nexuswriter.h \
     ../include/io/io_png.h \
     ../include/math/tcenterofgravity.h \
     ../include/math/core/tcenterofgravity.hpp \
@@ -344,6 +380,8 @@ HEADERS +=\
     ../include/strings/xmlstrings.h \
     ../include/morphology/repairhole.h \
     ../include/morphology/core/repairhole.hpp \
+    ../include/morphology/morphreconstruction.h \
+    ../include/morphology/core/morphreconstruction.hpp \
     ../include/algorithms/datavalidator.h \
     ../include/math/gradient.h
 
@@ -352,7 +390,9 @@ exists(/usr/lib/*NeXus*) {
 
     message("-lNeXus exists")
     DEFINES += HAVE_NEXUS
-    LIBS += -lNeXus -lNeXusCPP
+    exists(/usr/include/hdf5/serial): INCLUDEPATH += /usr/include/hdf5/serial
+    exists(/usr/lib/x86_64-linux-gnu/hdf5/serial): QMAKE_LIBDIR += /usr/lib/x86_64-linux-gnu/hdf5/serial
+    LIBS += -lNeXus -lNeXusCPP -lhdf5
     SOURCES += ../src/io/io_nexus.cpp
     HEADERS += ../include/io/io_nexus.h
 }
@@ -371,7 +411,7 @@ exists($$PWD/../../../../external/mac/lib/*NeXus*) {
     INCLUDEPATH += $$PWD/../../../../external/mac/include $$PWD/../../../../external/mac/include/nexus $$PWD/../../../../external/mac/include/hdf5
     DEPENDPATH += $$PWD/../../../../external/mac/include $$PWD/../../../../external/mac/include/nexus $$PWD/../../../../external/mac/include/hdf5
 
-    LIBS += -L$$PWD/../../../../external/mac/lib/ -lNeXus.1.0.0 -lNeXusCPP.1.0.0
+    LIBS += -L$$PWD/../../../../external/mac/lib/ -lNeXus.1.0.0 -lNeXusCPP.1.0.0 -lhdf5.10 -lhdf5_hl.10
     SOURCES += ../src/io/io_nexus.cpp
     HEADERS += ../include/io/io_nexus.h
 
@@ -391,7 +431,7 @@ exists($$PWD/../../../../external/lib64/nexus/*NeXus*) {
     INCLUDEPATH += $$PWD/../../../../external/include/nexus $$PWD/../../../../external/include/hdf5
     QMAKE_LIBDIR += $$PWD/../../../../external/lib64/nexus $$PWD/../../../../external/lib64/hdf5
 
-    LIBS +=  -lNeXus -lNeXusCPP
+    LIBS +=  -lNeXus -lNeXusCPP -lhdf5 -lhdf5_hl
 
     SOURCES += ../src/io/io_nexus.cpp
     HEADERS += ../include/io/io_nexus.h
@@ -0,0 +1,525 @@
+//<LICENCE>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <algorithm>
+#include <xmmintrin.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "../../../include/base/core/bufferpool.h"
+#include "../../../include/base/KiplException.h"
+
+namespace kipl { namespace base { namespace core {
+
+namespace {
+    const size_t kMinClassShift    = 8;                              ///< The smallest class holds 256 bytes
+    const size_t kMaxClassShift    = 30;                             ///< The largest class holds 1 GB
+    const size_t kStepShift        = 2;                              ///< Four classes per power of two
+    const size_t kNumClasses       = ((kMaxClassShift-kMinClassShift)<<kStepShift)+1;
+    const size_t kHeaderSize       = 64;                             ///< The header keeps the data aligned to a cache line
+    const size_t kPageSize         = 4096;
+    const size_t kMaxNodes         = 8;
+    const size_t kThreadCacheBlocks = 4;                             ///< Blocks per class in a thread cache
+    const size_t kThreadCacheBytes = size_t(64)<<20;                 ///< Bytes in the cache of one thread
+
+    /// \brief Stored in front of each pooled block, links the block in the free lists.
+    struct BlockHeader {
+        size_t sizeClass;
+        size_t node;        ///< The memory node of the thread that touched the block first
+        BlockHeader *next;
+    };
+
+    static_assert(sizeof(BlockHeader)<=kHeaderSize,"The block header must fit in front of the aligned data");
+
+    struct Counters {
+        size_t requests = 0;
+        size_t threadCacheHits = 0;
+        size_t sharedCacheHits = 0;
+        size_t remoteHits = 0;
+        size_t systemAllocations = 0;
+        size_t bypassed = 0;
+        size_t releases = 0;
+        size_t systemReleases = 0;
+
+        void add(const Counters &c)
+        {
+            requests          += c.requests;
+            threadCacheHits   += c.threadCacheHits;
+            sharedCacheHits   += c.sharedCacheHits;
+            remoteHits        += c.remoteHits;
+            systemAllocations += c.systemAllocations;
+            bypassed          += c.bypassed;
+            releases          += c.releases;
+            systemReleases    += c.systemReleases;
+        }
+    };
+
+    /// \brief The free lists of one memory node
+    struct SharedLists {
+        std::mutex mutex;
+        BlockHeader *free[kNumClasses] = {};
+    };
+
+    struct ThreadCache;
+
+    /// Set when the cache of the thread is destroyed, buffers released later by static objects bypass the cache.
+    thread_local bool tl_bCacheDestroyed = false;
+
+    /// \brief The process wide state of the pool
+    struct PoolState {
+        std::atomic<bool> enabled{false};
+        std::atomic<size_t> cacheLimit{size_t(1)<<30};
+        std::atomic<size_t> sharedBytes{0};
+        std::atomic<size_t> peakSharedBytes{0};
+        SharedLists nodes[kMaxNodes];
+
+        std::mutex registryMutex;
+        std::set<ThreadCache *> caches;
+        Counters retired;               ///< The counters of the finished threads
+        std::ptrdiff_t retiredInUse = 0;
+    };
+
+    /// The state is never destroyed, buffers in static objects may be released after the other statics are gone.
+    PoolState & pool()
+    {
+        static PoolState *state = new PoolState;
+
+        return *state;
+    }
+
+    size_t currentNode()
+    {
+#ifdef _MSC_VER
+        PROCESSOR_NUMBER processor;
+        GetCurrentProcessorNumberEx(&processor);
+        USHORT node=0;
+        if (GetNumaProcessorNodeEx(&processor,&node))
+            return node % kMaxNodes;
+#elif defined(__linux__)
+        unsigned int cpu=0;
+        unsigned int node=0;
+        if (syscall(SYS_getcpu,&cpu,&node,nullptr)==0)
+            return node % kMaxNodes;
+#endif
+        return 0;
+    }
+
+    void *data(BlockHeader *block)
+    {
+        return reinterpret_cast<char *>(block)+kHeaderSize;
+    }
+
+    BlockHeader *header(void *ptr)
+    {
+        return reinterpret_cast<BlockHeader *>(reinterpret_cast<char *>(ptr)-kHeaderSize);
+    }
+
+    /// \brief Allocates a new block and touches its pages from the calling thread
+    BlockHeader *systemAllocate(size_t sizeClass)
+    {
+        const size_t size=BufferPool::classSize(sizeClass);
+        char *raw=reinterpret_cast<char *>(_mm_malloc(kHeaderSize+size,kHeaderSize));
+        if (raw==nullptr)
+            return nullptr;
+
+        for (size_t i=kHeaderSize; i<kHeaderSize+size; i+=kPageSize)
+            raw[i]=0;
+
+        BlockHeader *block=reinterpret_cast<BlockHeader *>(raw);
+        block->sizeClass = sizeClass;
+        block->node      = currentNode();
+        block->next      = nullptr;
+
+        return block;
+    }
+
+    void systemFree(BlockHeader *block)
+    {
+        _mm_free(block);
+    }
+
+    /// \brief Puts a block in the shared lists of its node
+    /// \returns false if the cache limit is reached, the block is then not taken.
+    bool putShared(BlockHeader *block)
+    {
+        PoolState &state=pool();
+        const size_t size=BufferPool::classSize(block->sizeClass);
+        SharedLists &lists=state.nodes[block->node];
+
+        // The bytes are reserved before the block is linked, i.e. concurrent releases on different nodes can't exceed the limit
+        size_t shared=state.sharedBytes.load();
+        do {
+            if (state.cacheLimit.load()<shared+size)
+                return false;
+        } while (!state.sharedBytes.compare_exchange_weak(shared,shared+size));
+        shared+=size;
+
+        {
+            std::lock_guard<std::mutex> lock(lists.mutex);
+            block->next=lists.free[block->sizeClass];
+            lists.free[block->sizeClass]=block;
+        }
+
+        size_t peak=state.peakSharedBytes.load();
+        while ((peak<shared) && !state.peakSharedBytes.compare_exchange_weak(peak,shared)) ;
+
+        return true;
+    }
+
+    /// \brief Takes a block from the shared lists, the node of the calling thread is searched first
+    BlockHeader *takeShared(size_t sizeClass, bool &remote)
+    {
+        PoolState &state=pool();
+        if (state.sharedBytes.load()==0)
+            return nullptr;
+
+        const size_t node=currentNode();
+
+        for (size_t i=0; i<kMaxNodes; ++i) {
+            SharedLists &lists=state.nodes[(node+i) % kMaxNodes];
+
+            std::lock_guard<std::mutex> lock(lists.mutex);
+            BlockHeader *block=lists.free[sizeClass];
+            if (block!=nullptr) {
+                lists.free[sizeClass]=block->next;
+                state.sharedBytes-=BufferPool::classSize(sizeClass);
+                remote = (i!=0);
+                return block;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /// \brief The free blocks and the counters of one thread, the owner locks it without contention.
+    struct ThreadCache {
+        std::mutex mutex;
+        BlockHeader *free[kNumClasses] = {};
+        size_t count[kNumClasses] = {};
+        size_t bytes = 0;
+        Counters counters;
+        std::ptrdiff_t inUse = 0;
+
+        ThreadCache()
+        {
+            PoolState &state=pool();
+            std::lock_guard<std::mutex> lock(state.registryMutex);
+            state.caches.insert(this);
+        }
+
+        ~ThreadCache()
+        {
+            tl_bCacheDestroyed=true;
+            flush(pool().enabled.load());
+
+            PoolState &state=pool();
+            std::lock_guard<std::mutex> registryLock(state.registryMutex);
+            std::lock_guard<std::mutex> lock(mutex);
+            state.retired.add(counters);
+            state.retiredInUse+=inUse;
+            state.caches.erase(this);
+        }
+
+        /// \brief Empties the cache
+        /// \param keep Moves the blocks to the shared lists when true, otherwise they are returned to the system.
+        void flush(bool keep)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (size_t c=0; c<kNumClasses; ++c) {
+                while (free[c]!=nullptr) {
+                    BlockHeader *block=free[c];
+                    free[c]=block->next;
+
+                    if (!keep || !putShared(block)) {
+                        systemFree(block);
+                        ++counters.systemReleases;
+                    }
+                }
+                count[c]=0;
+            }
+            bytes=0;
+        }
+    };
+
+    /// \returns the cache of the calling thread or nullptr if it is already destroyed
+    ThreadCache * threadCache()
+    {
+        if (tl_bCacheDestroyed)
+            return nullptr;
+
+        thread_local ThreadCache cache;
+
+        return &cache;
+    }
+
+    /// \brief Releases a block without thread cache, the counters go to the retired counters
+    void releaseUncached(BlockHeader *block, bool keep)
+    {
+        PoolState &state=pool();
+        const size_t size=BufferPool::classSize(block->sizeClass);
+        const bool shared = keep && putShared(block);
+        if (!shared)
+            systemFree(block);
+
+        std::lock_guard<std::mutex> lock(state.registryMutex);
+        ++state.retired.releases;
+        state.retiredInUse-=size;
+        if (!shared)
+            ++state.retired.systemReleases;
+    }
+
+    size_t floorLog2(size_t x)
+    {
+        size_t n=0;
+        while ((x>>=1)!=0)
+            ++n;
+
+        return n;
+    }
+}
+
+void BufferPool::setEnabled(bool enable)
+{
+    pool().enabled=enable;
+
+    if (!enable)
+        trim();
+}
+
+bool BufferPool::enabled()
+{
+    return pool().enabled.load();
+}
+
+void BufferPool::setCacheLimit(size_t bytes)
+{
+    pool().cacheLimit=bytes;
+}
+
+size_t BufferPool::cacheLimit()
+{
+    return pool().cacheLimit.load();
+}
+
+void *BufferPool::allocate(size_t bytes)
+{
+    if (!pool().enabled.load(std::memory_order_relaxed))
+        return nullptr;
+
+    ThreadCache *pCache=threadCache();
+    if (pCache==nullptr)
+        return nullptr;
+
+    ThreadCache &cache=*pCache;
+    if (maxPooledSize()<bytes) {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        ++cache.counters.bypassed;
+        return nullptr;
+    }
+
+    const size_t c=sizeClass(bytes);
+    const size_t size=classSize(c);
+
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        ++cache.counters.requests;
+
+        BlockHeader *block=cache.free[c];
+        if (block!=nullptr) {
+            cache.free[c]=block->next;
+            --cache.count[c];
+            cache.bytes-=size;
+            cache.inUse+=size;
+            ++cache.counters.threadCacheHits;
+            return data(block);
+        }
+    }
+
+    bool remote=false;
+    BlockHeader *block=takeShared(c,remote);
+    bool fresh=false;
+
+    if (block==nullptr) {
+        block=systemAllocate(c);
+        if (block==nullptr) {
+            // The free blocks of other classes may be what is missing
+            trim();
+            block=systemAllocate(c);
+        }
+
+        if (block==nullptr) {
+            std::ostringstream msg;
+            msg<<"Failed to allocate "<<size<<" bytes";
+            throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+        }
+        fresh=true;
+    }
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.inUse+=size;
+    if (fresh) {
+        ++cache.counters.systemAllocations;
+    }
+    else {
+        ++cache.counters.sharedCacheHits;
+        if (remote)
+            ++cache.counters.remoteHits;
+    }
+
+    return data(block);
+}
+
+void BufferPool::release(void *ptr)
+{
+    if (ptr==nullptr)
+        return;
+
+    BlockHeader *block=header(ptr);
+    const size_t c=block->sizeClass;
+    const size_t size=classSize(c);
+    const bool keep=pool().enabled.load(std::memory_order_relaxed);
+
+    ThreadCache *pCache=threadCache();
+    if (pCache==nullptr) {
+        releaseUncached(block,keep);
+        return;
+    }
+
+    ThreadCache &cache=*pCache;
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        ++cache.counters.releases;
+        cache.inUse-=size;
+
+        if (keep && (cache.count[c]<kThreadCacheBlocks) && (cache.bytes+size<=kThreadCacheBytes)) {
+            block->next=cache.free[c];
+            cache.free[c]=block;
+            ++cache.count[c];
+            cache.bytes+=size;
+            return;
+        }
+    }
+
+    if (keep && putShared(block))
+        return;
+
+    systemFree(block);
+
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    ++cache.counters.systemReleases;
+}
+
+void BufferPool::trim()
+{
+    PoolState &state=pool();
+
+    {
+        std::lock_guard<std::mutex> lock(state.registryMutex);
+        for (ThreadCache *cache : state.caches)
+            cache->flush(false);
+    }
+
+    size_t released=0;
+    for (SharedLists &lists : state.nodes) {
+        std::lock_guard<std::mutex> lock(lists.mutex);
+        for (size_t c=0; c<kNumClasses; ++c) {
+            while (lists.free[c]!=nullptr) {
+                BlockHeader *block=lists.free[c];
+                lists.free[c]=block->next;
+                state.sharedBytes-=classSize(c);
+                systemFree(block);
+                ++released;
+            }
+        }
+    }
+
+    if (released!=0) {
+        std::lock_guard<std::mutex> lock(state.registryMutex);
+        state.retired.systemReleases+=released;
+    }
+}
+
+BufferPoolStatistics BufferPool::statistics()
+{
+    PoolState &state=pool();
+    std::lock_guard<std::mutex> registryLock(state.registryMutex);
+
+    Counters total=state.retired;
+    std::ptrdiff_t inUse=state.retiredInUse;
+    size_t threadBytes=0;
+
+    for (ThreadCache *cache : state.caches) {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        total.add(cache->counters);
+        inUse+=cache->inUse;
+        threadBytes+=cache->bytes;
+    }
+
+    BufferPoolStatistics stats;
+    stats.requests          = total.requests;
+    stats.threadCacheHits   = total.threadCacheHits;
+    stats.sharedCacheHits   = total.sharedCacheHits;
+    stats.remoteHits        = total.remoteHits;
+    stats.systemAllocations = total.systemAllocations;
+    stats.bypassed          = total.bypassed;
+    stats.releases          = total.releases;
+    stats.systemReleases    = total.systemReleases;
+    stats.bytesInUse        = static_cast<size_t>(std::max(inUse,std::ptrdiff_t(0)));
+    stats.bytesCached       = state.sharedBytes.load()+threadBytes;
+    stats.peakBytesCached   = state.peakSharedBytes.load();
+
+    return stats;
+}
+
+void BufferPool::resetStatistics()
+{
+    PoolState &state=pool();
+    std::lock_guard<std::mutex> registryLock(state.registryMutex);
+
+    state.retired=Counters();
+    for (ThreadCache *cache : state.caches) {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->counters=Counters();
+    }
+
+    state.peakSharedBytes=state.sharedBytes.load();
+}
+
+size_t BufferPool::sizeClass(size_t bytes)
+{
+    if (bytes<=(size_t(1)<<kMinClassShift))
+        return 0;
+
+    const size_t p=floorLog2(bytes-1);
+    const size_t step=size_t(1)<<(p-kStepShift);
+    const size_t k=(bytes-(size_t(1)<<p)+step-1)/step;
+
+    return ((p-kMinClassShift)<<kStepShift)+k;
+}
+
+size_t BufferPool::classSize(size_t sizeClass)
+{
+    if (sizeClass==0)
+        return size_t(1)<<kMinClassShift;
+
+    const size_t p=kMinClassShift+((sizeClass-1)>>kStepShift);
+    const size_t k=((sizeClass-1) & ((size_t(1)<<kStepShift)-1))+1;
+
+    return (size_t(1)<<p)+k*(size_t(1)<<(p-kStepShift));
+}
+
+size_t BufferPool::maxPooledSize()
+{
+    return classSize(kNumClasses-1);
+}
+
+}}}
@@ -16,6 +16,7 @@
 #include "../../../include/math/sums.h"
 #include "../../../include/math/image_statistics.h"
 #include "../../../include/base/thistogram.h"
+#include "../../../include/base/histogramengine.h"
 #ifndef NO_TIFF
 #include "../../../include/io/io_tiff.h"
 #endif
@@ -39,48 +40,15 @@ int KIPLSHARED_EXPORT Histogram(float const * const data, size_t nData, size_t *
 		stop=std::max(lo,hi);
     }
 
-    std::fill_n(hist,nBins,0UL);
-    
-	float scale=(nBins)/(stop-start);
-    #pragma omp parallel firstprivate(nData,start,scale)
-    {
-		int index;
-		long long int i=0;	
-        std::vector<size_t> temp_hist(nBins);
-        //size_t *temp_hist=new size_t[nBins];
-        std::fill(temp_hist.begin(),temp_hist.end(),0UL);
-
-		const ptrdiff_t snData=static_cast<ptrdiff_t>(nData);
-		const ptrdiff_t snBins=static_cast<ptrdiff_t>(nBins);
-        if (avoidZeros)
-        {
-            #pragma omp for
-            for (i=0; i<snData; i++) {
-                if (data[i]!=0.0f)
-                {
-                    index=static_cast<int>((data[i]-start)*scale);
-                    if ((index<snBins) && (0<=index))
-                        temp_hist[index]++;
-                }
-            }
-        }
-        else
-        {
-            #pragma omp for
-            for (i=0; i<snData; i++) {
-                index=static_cast<int>((data[i]-start)*scale);
-                if ((index<snBins) && (0<=index))
-                    temp_hist[index]++;
-            }
-        }
-		#pragma omp critical
-		{
-			for (i=0; i<snBins; i++)
-				hist[i]+=temp_hist[i];
-		}
-        //delete [] temp_hist;
-    }
-    scale=(stop-start)/nBins;
+    if (stop<=start) // Constant data ends up in the first bin
+        stop=start+std::max(1.0f,std::abs(start));
+
+    kipl::base::HistogramEngine<float> engine(nBins,start,stop);
+    engine.setIgnoreZeros(avoidZeros);
+    engine.put(data,nData);
+    std::copy(engine.histogram().begin(),engine.histogram().end(),hist);
+
+    float scale=(stop-start)/nBins;
     if (pAxis!=nullptr) {
         pAxis[0]=start+scale/2;
         for (size_t i=1; i<nBins; i++)
@@ -108,45 +76,13 @@ int KIPLSHARED_EXPORT Histogram(float const * const data, size_t nData, size_t n
     hist.resize(nBins);
     axis.resize(nBins);
 
-    std::fill(hist.begin(),hist.end(),0UL);
+    if (stop<=start) // Constant data ends up in the first bin
+        stop=start+std::max(1.0f,std::abs(start));
 
-    float scale=(nBins)/(stop-start);
-    #pragma omp parallel firstprivate(nData,start,scale)
-    {
-        int index;
-        long long int i=0;
-        std::vector<size_t> temp_hist(nBins);
-        std::fill(temp_hist.begin(),temp_hist.end(),0UL);
-
-        const ptrdiff_t snData=static_cast<ptrdiff_t>(nData);
-        const ptrdiff_t snBins=static_cast<ptrdiff_t>(nBins);
-        if (avoidZeros)
-        {
-            #pragma omp for
-            for (i=0; i<snData; i++) {
-                if (data[i]!=0.0f)
-                {
-                    index=static_cast<int>((data[i]-start)*scale);
-                    if ((index<snBins) && (0<=index))
-                        temp_hist[index]++;
-                }
-            }
-        }
-        else
-        {
-            #pragma omp for
-            for (i=0; i<snData; i++) {
-                index=static_cast<int>((data[i]-start)*scale);
-                if ((index<snBins) && (0<=index))
-                    temp_hist[index]++;
-            }
-        }
-        #pragma omp critical
-        {
-            for (i=0; i<hist.size(); i++)
-                hist[i]+=temp_hist[i];
-        }
-    }
+    kipl::base::HistogramEngine<float> engine(nBins,start,stop);
+    engine.setIgnoreZeros(avoidZeros);
+    engine.put(data,nData);
+    std::copy(engine.histogram().begin(),engine.histogram().end(),hist.begin());
 
     float binIncrement = (stop-start)/nBins;
     float binVal       = start+binIncrement/2;
@@ -142,5 +142,74 @@ void SSE2Div(float *a, const float b, const size_t N)
 	}
 }
 
+void SSE2Convert(float *dst, const unsigned char *src, const size_t N)
+{
+	const size_t N16=N>>4;
+	const __m128i zero=_mm_setzero_si128();
+
+	size_t i;
+	for (i=0; i<N16; i++) {
+		__m128i v=_mm_loadu_si128(reinterpret_cast<const __m128i *>(src+16*i));
+		__m128i lo=_mm_unpacklo_epi8(v,zero);
+		__m128i hi=_mm_unpackhi_epi8(v,zero);
+		float *d=dst+16*i;
+		_mm_storeu_ps(d,    _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo,zero)));
+		_mm_storeu_ps(d+4,  _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo,zero)));
+		_mm_storeu_ps(d+8,  _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi,zero)));
+		_mm_storeu_ps(d+12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi,zero)));
+	}
+	for (i=N16<<4; i<N; i++) {
+		dst[i]=static_cast<float>(src[i]);
+	}
+}
+
+void SSE2Convert(float *dst, const short *src, const size_t N)
+{
+	const size_t N8=N>>3;
+
+	size_t i;
+	for (i=0; i<N8; i++) {
+		__m128i v=_mm_loadu_si128(reinterpret_cast<const __m128i *>(src+8*i));
+		// Sign extension by an arithmetic shift of the interleaved words
+		__m128i lo=_mm_srai_epi32(_mm_unpacklo_epi16(v,v),16);
+		__m128i hi=_mm_srai_epi32(_mm_unpackhi_epi16(v,v),16);
+		_mm_storeu_ps(dst+8*i,   _mm_cvtepi32_ps(lo));
+		_mm_storeu_ps(dst+8*i+4, _mm_cvtepi32_ps(hi));
+	}
+	for (i=N8<<3; i<N; i++) {
+		dst[i]=static_cast<float>(src[i]);
+	}
+}
+
+void SSE2Convert(float *dst, const unsigned short *src, const size_t N)
+{
+	const size_t N8=N>>3;
+	const __m128i zero=_mm_setzero_si128();
+
+	size_t i;
+	for (i=0; i<N8; i++) {
+		__m128i v=_mm_loadu_si128(reinterpret_cast<const __m128i *>(src+8*i));
+		_mm_storeu_ps(dst+8*i,   _mm_cvtepi32_ps(_mm_unpacklo_epi16(v,zero)));
+		_mm_storeu_ps(dst+8*i+4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(v,zero)));
+	}
+	for (i=N8<<3; i<N; i++) {
+		dst[i]=static_cast<float>(src[i]);
+	}
+}
+
+void SSE2Convert(float *dst, const int *src, const size_t N)
+{
+	const size_t N4=N>>2;
+
+	size_t i;
+	for (i=0; i<N4; i++) {
+		__m128i v=_mm_loadu_si128(reinterpret_cast<const __m128i *>(src+4*i));
+		_mm_storeu_ps(dst+4*i, _mm_cvtepi32_ps(v));
+	}
+	for (i=N4<<2; i<N; i++) {
+		dst[i]=static_cast<float>(src[i]);
+	}
+}
+
 }}}
 #endif
@@ -15,6 +15,13 @@
 namespace kipl { namespace math { namespace fft {
 using namespace std;
 
+std::mutex & plannerMutex()
+{
+    static std::mutex mutex;
+
+    return mutex;
+}
+
 
 
 FFTBaseFloat::FFTBaseFloat(size_t const * const Dims, size_t const NDim) : 	
@@ -86,52 +86,14 @@ int KIPLSHARED_EXPORT GetNexusInfo(const char *fname, size_t *NofImg, double *Sc
 }
 
 int KIPLSHARED_EXPORT GetNexusDims(const char *fname, size_t *dims){
-//int GetNexusDims(const char *fname, size_t *dims){
+    NexusReader reader(fname);
 
-    NeXus::File file(fname);
-
-    vector<NeXus::AttrInfo> attr_infos = file.getAttrInfos();
-
-    // look for default plottable data and gtet relevant information
-    // check group attributes
-
-    file.openGroup("entry", "NXentry");
-    attr_infos = file.getAttrInfos(); // check how many or assuming that there is only one NXentry entry ?
-    map<string, string> entries = file.getEntries();
-    for (map<string,string>::const_iterator it = entries.begin();        it != entries.end(); ++it) {
-        if(it->second=="NXdata") {
+    size_t nexusdims[3];
+    reader.getDims(nexusdims);
+    dims[0]=nexusdims[0];
+    dims[1]=nexusdims[1];
 
-            file.openGroup(it->first, it->second);
-            attr_infos = file.getAttrInfos();
-
-            map<string, string> entries_data = file.getEntries();
-
-            for (map<string,string>::const_iterator it_data = entries_data.begin();
-                 it_data != entries_data.end(); it_data++) {
-
-                file.openData(it_data->first);
-                attr_infos = file.getAttrInfos();
-
-                for (vector<NeXus::AttrInfo>::iterator it_att = attr_infos.begin();
-                     it_att != attr_infos.end(); it_att++) {
-
-                                      if (it_att->name=="signal"){
-                                          dims[0]=static_cast<size_t>(file.getInfo().dims[2]);
-                                          dims[1]=static_cast<size_t>(file.getInfo().dims[1]);
-//                                          break;
-                                      }
-                }
-                file.closeData();
-              }
-
-            file.closeGroup();
-            }
-
-    }
-
-    file.close();
     return 1;
-
 }
 
 }}
@@ -2,11 +2,13 @@
 
 
 #include <iostream>
+#include <vector>
 
 #include <tiffio.h>
 
 #include "../../include/base/timage.h"
 #include "../../include/base/KiplException.h"
+#include "../../include/io/io_tiff.h"
 
 namespace kipl { namespace io {
 
@@ -55,6 +57,32 @@ int KIPLSHARED_EXPORT GetTIFFDims(char const * const fname,size_t *dims)
     return frames;
 }
 
+std::vector<unsigned char> & TIFFScratchBuffer()
+{
+    thread_local std::vector<unsigned char> buffer;
+
+    return buffer;
+}
+
+void FixTIFFBits(unsigned char *buffer, size_t N, uint16 photo, uint16 fillorder)
+{
+    if (fillorder != FILLORDER_MSB2LSB) {
+        // We need to swap bits -- ABCDEFGH becomes HGFEDCBA
+        for (size_t i=0; i<N; ++i) {
+            unsigned char b=buffer[i];
+            b = static_cast<unsigned char>(((b & 0xF0) >> 4) | ((b & 0x0F) << 4));
+            b = static_cast<unsigned char>(((b & 0xCC) >> 2) | ((b & 0x33) << 2));
+            b = static_cast<unsigned char>(((b & 0xAA) >> 1) | ((b & 0x55) << 1));
+            buffer[i] = b;
+        }
+    }
+
+    if (photo == PHOTOMETRIC_MINISWHITE) {
+        for (size_t i=0; i<N; ++i)
+            buffer[i] = static_cast<unsigned char>(~buffer[i]);
+    }
+}
+
 
 
 
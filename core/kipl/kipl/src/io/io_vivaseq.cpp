@@ -5,6 +5,7 @@
 #include <ios>
 #include <algorithm>
 #include "../../include/io/io_vivaseq.h"
+#include "../../include/io/mappedsequencereader.h"
 #include "../../include/base/KiplException.h"
 
 
@@ -46,125 +47,40 @@ int GetViVaSEQDims(std::string fname,size_t *dims)
 
 int ReadViVaSEQ(std::string fname, kipl::base::TImage<float,3> &img, size_t const * const roi, int first_frame, int last_frame, int frame_step)
 {
-    std::ifstream file(fname.c_str(),ios::binary | ios::in);
-    if (file.bad()) {
-        std::ostringstream msg;
-        msg<<"GetViVaSEQHeader: Failed to open "<<fname;
-        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
-    }
-    ViVaSEQHeader header;
-
-    file.read(reinterpret_cast<char *>(&header),sizeof(ViVaSEQHeader));
-
-    const size_t framesize = header.imageWidth * header.imageHeight * header.bytesPerPixel;
     if (last_frame<first_frame)
         throw kipl::base::KiplException("ReadViVaSEQ: last frame < first_frame",__FILE__,__LINE__);
 
-    int first = first_frame;
-    int last  = last_frame;
-    int step  = frame_step;
-
-    if (first_frame == -1) {
-        first = 0;
-        last = header.numberOfFrames;
-    }
-
+    if (frame_step<1)
+        throw kipl::base::KiplException("ReadViVaSEQ: the frame step must be positive",__FILE__,__LINE__);
 
-    if (roi == nullptr) {
-        size_t dims[3]={static_cast<size_t>(header.imageWidth),
-                        static_cast<size_t>(header.imageHeight),
-                        static_cast<size_t>((last-first)/frame_step)};
+    MappedSequenceReader reader;
+    reader.openSEQ(fname);
 
-        img.Resize(dims);
+    size_t first = static_cast<size_t>(first_frame);
+    size_t last  = static_cast<size_t>(last_frame);
 
-        char * buffer = new char[framesize];
-        unsigned short *sbuffer = reinterpret_cast<unsigned short *>(buffer);
-        for (int i=first; i<last; i+=step) {
-            file.read(buffer,framesize);
-            float* pImg=img.GetLinePtr(0,(i-first)/frame_step);
-
-            std::copy(sbuffer,sbuffer+img.Size(0)*img.Size(1),pImg);
-        }
-        delete [] buffer;
+    if (first_frame == -1) {
+        first = 0;
+        last  = reader.numberOfFrames();
     }
-    else {
-        size_t dims[3]={roi[2]-roi[0],
-                        roi[3]-roi[0],
-                        static_cast<size_t>((last-first)/frame_step)};
-
-        img.Resize(dims);
-
-        const size_t buffersize = img.Size(0) * header.bytesPerPixel;
-        char * buffer = new char[buffersize];
-
-        for (int i=first; i<last; i+=frame_step) {
-            for (int j=roi[1]; j<roi[3]; ++j ) {
-                file.seekg(header.headerSize+                               // header offset
-                           i*framesize +                                    // frame offset
-                           j*header.imageWidth*header.bytesPerPixel +       // row offset
-                           roi[0]*header.bytesPerPixel,                     // indent
-                           ios_base::beg);
-                file.read(buffer,buffersize);
 
-                float* pImg=img.GetLinePtr(j-roi[1],(i-first)/frame_step);
-
-                std::copy(buffer,buffer+img.Size(0),pImg);
-            }
-        }
-
-        delete [] buffer;
-    }
+    reader.read(img,first,last,static_cast<size_t>(frame_step),roi);
 
     return 0;
 }
 
 int ReadViVaSEQ(std::string fname, kipl::base::TImage<float,2> &img, int idx, size_t  const * const roi)
 {
-    std::ifstream file(fname.c_str(),ios::binary | ios::in);
-    if (file.bad()) {
+    if (idx<0) {
         std::ostringstream msg;
-        msg<<"GetViVaSEQHeader: Failed to open "<<fname;
+        msg<<"ReadViVaSEQ: Negative frame index "<<idx;
         throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
     }
-    ViVaSEQHeader header;
-
-    file.read(reinterpret_cast<char *>(&header),sizeof(ViVaSEQHeader));
-
-    const size_t framesize = header.imageWidth * header.imageHeight * header.bytesPerPixel;
-    const size_t linesize  = header.imageWidth * header.bytesPerPixel;
-
-    char *buffer = new char[framesize];
-    unsigned short *sbuffer = reinterpret_cast<unsigned short *>(buffer);
 
-    if (roi == nullptr) {
-        size_t dims[2]={header.imageWidth,header.imageHeight};
-        img.Resize(dims);
-
-        file.seekg(static_cast<size_t>(idx)*framesize+header.headerSize,ios_base::beg);
-        file.read(buffer,framesize);
-
-
-        std::copy(sbuffer,sbuffer+img.Size(),img.GetDataPtr());
-    }
-    else {
-        size_t dims[2]={roi[2]-roi[0],roi[3]-roi[0]};
-        img.Resize(dims);
-
-        for (size_t j=roi[1]; j<roi[3]; ++j ) {
-            file.seekg(header.headerSize+                               // header offset
-                       idx*framesize +                                    // frame offset
-                       j*header.imageWidth*header.bytesPerPixel +       // row offset
-                       roi[0]*header.bytesPerPixel,                     // indent
-                       ios_base::beg);
-            file.read(buffer,linesize);
-
-            float* pImg=img.GetLinePtr(j-roi[1]);
-
-            std::copy(buffer,buffer+img.Size(0),pImg);
-        }
-    }
+    MappedSequenceReader reader;
+    reader.openSEQ(fname);
+    reader.read(img,static_cast<size_t>(idx),roi);
 
-    delete [] buffer;
     return 0;
 }
 
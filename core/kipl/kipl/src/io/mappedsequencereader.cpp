@@ -0,0 +1,393 @@
+//<LICENCE>
+
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../../include/io/mappedsequencereader.h"
+#include "../../include/base/KiplException.h"
+#include "../../include/base/core/imagearithmetics.h"
+#include "../../include/utilities/threadpool.h"
+
+namespace kipl { namespace io {
+
+MemoryMappedFile::MemoryMappedFile() :
+    m_pData(nullptr),
+    m_nSize(0),
+#ifdef _WIN32
+    m_hFile(INVALID_HANDLE_VALUE),
+    m_hMapping(nullptr)
+#else
+    m_nFile(-1)
+#endif
+{
+}
+
+MemoryMappedFile::MemoryMappedFile(const std::string &fname) :
+    MemoryMappedFile()
+{
+    open(fname);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    close();
+}
+
+void MemoryMappedFile::open(const std::string &fname)
+{
+    close();
+
+    std::ostringstream msg;
+#ifdef _WIN32
+    HANDLE hFile=CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile==INVALID_HANDLE_VALUE) {
+        msg<<"MemoryMappedFile: Failed to open "<<fname;
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile,&fileSize) || (fileSize.QuadPart==0)) {
+        CloseHandle(hFile);
+        msg<<"MemoryMappedFile: "<<fname<<" is empty";
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    HANDLE hMapping=CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void *pData= hMapping!=nullptr ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (pData==nullptr) {
+        if (hMapping!=nullptr)
+            CloseHandle(hMapping);
+        CloseHandle(hFile);
+        msg<<"MemoryMappedFile: Failed to map "<<fname;
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    m_hFile    = hFile;
+    m_hMapping = hMapping;
+    m_nSize    = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int nFile=::open(fname.c_str(), O_RDONLY);
+    if (nFile<0) {
+        msg<<"MemoryMappedFile: Failed to open "<<fname;
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    struct stat fileInfo;
+    if ((fstat(nFile,&fileInfo)!=0) || (fileInfo.st_size==0)) {
+        ::close(nFile);
+        msg<<"MemoryMappedFile: "<<fname<<" is empty";
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    void *pData=mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_SHARED, nFile, 0);
+    if (pData==MAP_FAILED) {
+        ::close(nFile);
+        msg<<"MemoryMappedFile: Failed to map "<<fname;
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    m_nFile = nFile;
+    m_nSize = static_cast<size_t>(fileInfo.st_size);
+#endif
+    m_pData     = static_cast<unsigned char *>(pData);
+    m_sFileName = fname;
+}
+
+void MemoryMappedFile::close()
+{
+    if (m_pData==nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_pData);
+    CloseHandle(m_hMapping);
+    CloseHandle(m_hFile);
+    m_hMapping = nullptr;
+    m_hFile    = INVALID_HANDLE_VALUE;
+#else
+    munmap(m_pData,m_nSize);
+    ::close(m_nFile);
+    m_nFile = -1;
+#endif
+    m_pData = nullptr;
+    m_nSize = 0;
+    m_sFileName.clear();
+}
+
+bool MemoryMappedFile::isOpen() const
+{
+    return m_pData!=nullptr;
+}
+
+const std::string & MemoryMappedFile::fileName() const
+{
+    return m_sFileName;
+}
+
+const unsigned char * MemoryMappedFile::data() const
+{
+    return m_pData;
+}
+
+size_t MemoryMappedFile::size() const
+{
+    return m_nSize;
+}
+
+void MemoryMappedFile::willNeed(size_t offset, size_t length) const
+{
+#ifndef _WIN32
+    if ((m_pData==nullptr) || (m_nSize<=offset))
+        return;
+
+    // madvise needs a page aligned address
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t start    = (offset/pageSize)*pageSize;
+    const size_t end      = std::min(m_nSize,offset+length);
+
+    madvise(m_pData+start, end-start, MADV_WILLNEED);
+#else
+    (void)offset;
+    (void)length;
+#endif
+}
+
+FrameView::FrameView() :
+    data(nullptr),
+    stride(0),
+    dataType(kipl::base::UInt16)
+{
+    dims[0]=0;
+    dims[1]=0;
+}
+
+void FrameView::convert(float *dst) const
+{
+    size_t nBytesPerPixel=0;
+    switch (dataType) {
+    case kipl::base::UInt8:   nBytesPerPixel=1; break;
+    case kipl::base::UInt16:  nBytesPerPixel=2; break;
+    case kipl::base::Float32: nBytesPerPixel=4; break;
+    default:
+        throw kipl::base::KiplException("FrameView: unsupported data type",__FILE__,__LINE__);
+    }
+
+    // Contiguous views are converted in one call
+    const bool bContiguous = stride==dims[0]*nBytesPerPixel;
+    const size_t nLines    = bContiguous ? 1 : dims[1];
+    const size_t N         = bContiguous ? dims[0]*dims[1] : dims[0];
+
+    for (size_t y=0; y<nLines; ++y, dst+=N) {
+        const unsigned char *pLine=line(y);
+        switch (dataType) {
+        case kipl::base::UInt8:
+            kipl::base::core::SSE2Convert(dst,pLine,N);
+            break;
+        case kipl::base::UInt16:
+            kipl::base::core::SSE2Convert(dst,reinterpret_cast<const unsigned short *>(pLine),N);
+            break;
+        case kipl::base::Float32:
+            std::memcpy(dst,pLine,N*sizeof(float));
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+MappedSequenceReader::MappedSequenceReader() :
+    m_DataType(kipl::base::UInt16),
+    m_nBytesPerPixel(0),
+    m_nHeaderSize(0),
+    m_nFrameStride(0),
+    m_nFrames(0)
+{
+}
+
+void MappedSequenceReader::setLayout(size_t width, size_t height, kipl::base::eDataType dataType, size_t headerSize, size_t frameGap)
+{
+    std::ostringstream msg;
+
+    switch (dataType) {
+    case kipl::base::UInt8:   m_nBytesPerPixel=1; break;
+    case kipl::base::UInt16:  m_nBytesPerPixel=2; break;
+    case kipl::base::Float32: m_nBytesPerPixel=4; break;
+    default:
+        m_File.close();
+        throw kipl::base::KiplException("MappedSequenceReader: only 8 bit, 16 bit, and float pixels are supported",__FILE__,__LINE__);
+    }
+
+    const size_t frameSize=width*height*m_nBytesPerPixel;
+    if ((frameSize==0) || (m_File.size()<headerSize+frameSize)) {
+        msg<<"MappedSequenceReader: "<<m_File.fileName()<<" ("<<m_File.size()<<" bytes) doesn't contain a "
+           <<width<<"x"<<height<<" frame after "<<headerSize<<" header bytes";
+        m_File.close();
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    m_DataType      = dataType;
+    m_nHeaderSize   = headerSize;
+    m_nFrameStride  = frameSize+frameGap;
+    // The last frame doesn't need a gap after it
+    m_nFrames       = (m_File.size()-headerSize+frameGap)/m_nFrameStride;
+
+    m_Header.imageWidth  = static_cast<unsigned int>(width);
+    m_Header.imageHeight = static_cast<unsigned int>(height);
+}
+
+void MappedSequenceReader::openSEQ(const std::string &fname)
+{
+    m_File.open(fname);
+
+    if (m_File.size()<sizeof(ViVaSEQHeader)) {
+        std::ostringstream msg;
+        msg<<"MappedSequenceReader: "<<fname<<" is too small to be a SEQ file";
+        m_File.close();
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    std::memcpy(&m_Header,m_File.data(),sizeof(ViVaSEQHeader));
+
+    kipl::base::eDataType dataType=kipl::base::UInt16;
+    switch (m_Header.bytesPerPixel) {
+    case 1: dataType=kipl::base::UInt8; break;
+    case 2: dataType=kipl::base::UInt16; break;
+    default: {
+            std::ostringstream msg;
+            msg<<"MappedSequenceReader: "<<m_Header.bytesPerPixel<<" bytes per pixel are not supported in "<<fname;
+            m_File.close();
+            throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+        }
+    }
+
+    setLayout(m_Header.imageWidth,m_Header.imageHeight,dataType,m_Header.headerSize,0);
+
+    // Trust the header when the file holds all frames, a file that was truncated while recording has fewer
+    m_nFrames=std::min(m_nFrames,static_cast<size_t>(m_Header.numberOfFrames));
+    m_Header.numberOfFrames=static_cast<unsigned int>(m_nFrames);
+}
+
+void MappedSequenceReader::openRaw(const std::string &fname, const size_t *dims, kipl::base::eDataType dataType, size_t headerSize, size_t frameGap)
+{
+    m_File.open(fname);
+    m_Header=ViVaSEQHeader();
+
+    setLayout(dims[0],dims[1],dataType,headerSize,frameGap);
+
+    m_Header.headerSize     = static_cast<unsigned int>(headerSize);
+    m_Header.bytesPerPixel  = static_cast<unsigned int>(m_nBytesPerPixel);
+    m_Header.numberOfFrames = static_cast<unsigned int>(m_nFrames);
+}
+
+void MappedSequenceReader::close()
+{
+    m_File.close();
+    m_nFrames=0;
+}
+
+bool MappedSequenceReader::isOpen() const
+{
+    return m_File.isOpen();
+}
+
+const std::string & MappedSequenceReader::fileName() const
+{
+    return m_File.fileName();
+}
+
+const ViVaSEQHeader & MappedSequenceReader::header() const
+{
+    return m_Header;
+}
+
+void MappedSequenceReader::getDims(size_t *dims) const
+{
+    dims[0]=m_Header.imageWidth;
+    dims[1]=m_Header.imageHeight;
+    dims[2]=m_nFrames;
+}
+
+size_t MappedSequenceReader::numberOfFrames() const
+{
+    return m_nFrames;
+}
+
+FrameView MappedSequenceReader::frame(size_t idx, size_t const * const roi) const
+{
+    std::ostringstream msg;
+
+    if (!m_File.isOpen())
+        throw kipl::base::KiplException("MappedSequenceReader: no file is open",__FILE__,__LINE__);
+
+    if (m_nFrames<=idx) {
+        msg<<"MappedSequenceReader: frame "<<idx<<" is outside the sequence with "<<m_nFrames<<" frames";
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    const size_t width  = m_Header.imageWidth;
+    const size_t height = m_Header.imageHeight;
+    size_t region[4]={0,0,width,height};
+
+    if (roi!=nullptr) {
+        std::copy_n(roi,4,region);
+        if ((region[2]<=region[0]) || (region[3]<=region[1]) || (width<region[2]) || (height<region[3])) {
+            msg<<"MappedSequenceReader: the ROI ("<<roi[0]<<", "<<roi[1]<<", "<<roi[2]<<", "<<roi[3]
+               <<") doesn't fit the frame size "<<width<<"x"<<height;
+            throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+        }
+    }
+
+    FrameView view;
+    view.stride   = width*m_nBytesPerPixel;
+    view.data     = m_File.data()+m_nHeaderSize+idx*m_nFrameStride+region[1]*view.stride+region[0]*m_nBytesPerPixel;
+    view.dims[0]  = region[2]-region[0];
+    view.dims[1]  = region[3]-region[1];
+    view.dataType = m_DataType;
+
+    return view;
+}
+
+void MappedSequenceReader::read(kipl::base::TImage<float,2> &img, size_t idx, size_t const * const roi) const
+{
+    FrameView view=frame(idx,roi);
+
+    img.Resize(view.dims);
+    view.convert(img.GetDataPtr());
+}
+
+void MappedSequenceReader::read(kipl::base::TImage<float,3> &img, size_t first, size_t last, size_t step, size_t const * const roi) const
+{
+    std::ostringstream msg;
+
+    if ((last<=first) || (m_nFrames<last) || (step==0)) {
+        msg<<"MappedSequenceReader: the frame range ["<<first<<", "<<last<<") with step "<<step
+           <<" doesn't fit the sequence with "<<m_nFrames<<" frames";
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    const size_t nFrames=(last-first+step-1)/step;
+    FrameView view=frame(first,roi);
+
+    size_t dims[3]={view.dims[0],view.dims[1],nFrames};
+    img.Resize(dims);
+
+    m_File.willNeed(m_nHeaderSize+first*m_nFrameStride,(last-first)*m_nFrameStride);
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,nFrames,
+        [&](size_t begin, size_t end) {
+            for (size_t i=begin; i<end; ++i)
+                frame(first+i*step,roi).convert(img.GetLinePtr(0,i));
+        },1);
+}
+
+}}
@@ -0,0 +1,340 @@
+//<LICENCE>
+
+#include <sstream>
+#include <vector>
+#include <mutex>
+#include <map>
+#include <algorithm>
+
+#include "../../include/io/nexusreader.h"
+#include "../../include/base/KiplException.h"
+#include "../../include/base/core/imagearithmetics.h"
+
+#ifdef HAVE_NEXUS
+#include <nexus/napi.h>
+#include <nexus/NeXusFile.hpp>
+#endif
+
+namespace kipl { namespace io {
+
+namespace {
+    /// Largest conversion buffer used when a range of projections is read, larger ranges are read in blocks.
+    const size_t MaxStagingBytes = 64UL<<20;
+}
+
+std::mutex & NexusLibraryMutex()
+{
+    static std::mutex libraryMutex;
+
+    return libraryMutex;
+}
+
+struct NexusReader::Impl {
+    Impl() : nElementSize(0) { std::fill_n(dims,3,0); }
+
+#ifdef HAVE_NEXUS
+    std::unique_ptr<NeXus::File> file;
+    NeXus::NXnumtype type;
+#endif
+    std::string fname;
+    std::string path;
+    size_t dims[3];                 ///< Width, height and number of projections
+    size_t nElementSize;
+    std::vector<char> buffer;       ///< Staging buffer for data that isn't stored as float
+    std::mutex mutex;
+
+    void checkROI(size_t first, size_t last, size_t const * const nCrop, size_t *roi) const;
+    void readSlab(float *dst, size_t first, size_t count, const size_t *roi);
+};
+
+void NexusReader::Impl::checkROI(size_t first, size_t last, size_t const * const nCrop, size_t *roi) const
+{
+    std::ostringstream msg;
+
+    if (fname.empty())
+        throw kipl::base::KiplException("NexusReader: no file is open",__FILE__,__LINE__);
+
+    if ((last<=first) || (dims[2]<last)) {
+        msg<<"NexusReader: projection range ["<<first<<", "<<last<<") is outside the data set with "<<dims[2]<<" projections";
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    if (nCrop==nullptr) {
+        roi[0]=0;       roi[1]=0;
+        roi[2]=dims[0]; roi[3]=dims[1];
+    }
+    else {
+        std::copy_n(nCrop,4,roi);
+        if ((roi[2]<=roi[0]) || (roi[3]<=roi[1]) || (dims[0]<roi[2]) || (dims[1]<roi[3])) {
+            msg<<"NexusReader: the ROI ("<<roi[0]<<", "<<roi[1]<<", "<<roi[2]<<", "<<roi[3]
+               <<") doesn't fit the image size "<<dims[0]<<"x"<<dims[1];
+            throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+        }
+    }
+}
+
+#ifdef HAVE_NEXUS
+namespace {
+    size_t elementSize(NeXus::NXnumtype type)
+    {
+        switch (type) {
+        case NeXus::INT8:
+        case NeXus::UINT8:   return 1;
+        case NeXus::INT16:
+        case NeXus::UINT16:  return 2;
+        case NeXus::INT32:
+        case NeXus::UINT32:
+        case NeXus::FLOAT32: return 4;
+        case NeXus::INT64:
+        case NeXus::UINT64:
+        case NeXus::FLOAT64: return 8;
+        default: break;
+        }
+
+        return 0;
+    }
+
+    std::string typeName(NeXus::NXnumtype type)
+    {
+        switch (type) {
+        case NeXus::INT8:    return "int8";
+        case NeXus::UINT8:   return "uint8";
+        case NeXus::INT16:   return "int16";
+        case NeXus::UINT16:  return "uint16";
+        case NeXus::INT32:   return "int32";
+        case NeXus::UINT32:  return "uint32";
+        case NeXus::INT64:   return "int64";
+        case NeXus::UINT64:  return "uint64";
+        case NeXus::FLOAT32: return "float32";
+        case NeXus::FLOAT64: return "float64";
+        default: break;
+        }
+
+        return "unsupported";
+    }
+}
+
+void NexusReader::Impl::readSlab(float *dst, size_t first, size_t count, const size_t *roi)
+{
+    const size_t sx=roi[2]-roi[0];
+    const size_t sy=roi[3]-roi[1];
+    const size_t N=count*sx*sy;
+
+    std::vector<int> slab_start = {static_cast<int>(first), static_cast<int>(roi[1]), static_cast<int>(roi[0])};
+    std::vector<int> slab_size  = {static_cast<int>(count), static_cast<int>(sy), static_cast<int>(sx)};
+
+    std::lock_guard<std::mutex> libraryLock(NexusLibraryMutex());
+    try {
+        if (type==NeXus::FLOAT32) {
+            file->getSlab(dst, slab_start, slab_size);
+            return;
+        }
+
+        buffer.resize(N*nElementSize);
+        file->getSlab(buffer.data(), slab_start, slab_size);
+    }
+    catch (std::exception &e) {
+        std::ostringstream msg;
+        msg<<"NexusReader failed to read the slab of "<<count<<" projections starting at "<<first<<" from "<<fname<<": "<<e.what();
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    const void *src=buffer.data();
+    switch (type) {
+    case NeXus::INT8:    kipl::base::core::BasicConvert(dst,static_cast<const signed char *>(src),N); break;
+    case NeXus::UINT8:   kipl::base::core::SSE2Convert(dst,static_cast<const unsigned char *>(src),N); break;
+    case NeXus::INT16:   kipl::base::core::SSE2Convert(dst,static_cast<const short *>(src),N); break;
+    case NeXus::UINT16:  kipl::base::core::SSE2Convert(dst,static_cast<const unsigned short *>(src),N); break;
+    case NeXus::INT32:   kipl::base::core::SSE2Convert(dst,static_cast<const int *>(src),N); break;
+    case NeXus::UINT32:  kipl::base::core::BasicConvert(dst,static_cast<const unsigned int *>(src),N); break;
+    case NeXus::INT64:   kipl::base::core::BasicConvert(dst,static_cast<const long long *>(src),N); break;
+    case NeXus::UINT64:  kipl::base::core::BasicConvert(dst,static_cast<const unsigned long long *>(src),N); break;
+    case NeXus::FLOAT64: kipl::base::core::BasicConvert(dst,static_cast<const double *>(src),N); break;
+    default:
+        throw kipl::base::KiplException("NexusReader: unsupported data type",__FILE__,__LINE__);
+    }
+}
+#else
+void NexusReader::Impl::readSlab(float * /*dst*/, size_t /*first*/, size_t /*count*/, const size_t * /*roi*/)
+{
+    throw kipl::base::KiplException("Nexus library is not supported",__FILE__,__LINE__);
+}
+#endif
+
+NexusReader::NexusReader() :
+    pImpl(new Impl)
+{
+}
+
+NexusReader::NexusReader(const std::string &fname) :
+    pImpl(new Impl)
+{
+    open(fname);
+}
+
+NexusReader::~NexusReader()
+{
+    close();
+}
+
+void NexusReader::open(const std::string &fname)
+{
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+
+#ifdef HAVE_NEXUS
+    std::lock_guard<std::mutex> libraryLock(NexusLibraryMutex());
+    std::ostringstream msg;
+    pImpl->file.reset();
+    pImpl->fname.clear();
+    pImpl->path.clear();
+
+    std::unique_ptr<NeXus::File> file;
+    std::string path;
+
+    try {
+        file.reset(new NeXus::File(fname));
+
+        // The plottable data is the field with the signal attribute in an NXdata group of the entry
+        file->openGroup("entry", "NXentry");
+        std::map<std::string, std::string> entries = file->getEntries();
+
+        for (auto it = entries.begin(); (it != entries.end()) && path.empty(); ++it) {
+            if (it->second!="NXdata")
+                continue;
+
+            file->openGroup(it->first, it->second);
+            std::map<std::string, std::string> entries_data = file->getEntries();
+
+            for (auto it_data = entries_data.begin(); it_data != entries_data.end(); ++it_data) {
+                if (it_data->second!="SDS")
+                    continue;
+
+                file->openData(it_data->first);
+                std::vector<NeXus::AttrInfo> attr_infos = file->getAttrInfos();
+                bool found=std::any_of(attr_infos.begin(),attr_infos.end(),
+                                       [](const NeXus::AttrInfo &info) {return info.name=="signal";});
+                if (found) {
+                    path="/entry/"+it->first+"/"+it_data->first;
+                    break;
+                }
+                file->closeData();
+            }
+
+            if (path.empty())
+                file->closeGroup();
+        }
+    }
+    catch (std::exception &e) {
+        msg<<"NexusReader failed to open "<<fname<<": "<<e.what();
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    if (path.empty()) {
+        msg<<"NexusReader didn't find plottable data in "<<fname;
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    NeXus::Info info=file->getInfo();
+    if (info.dims.size()!=3) {
+        msg<<"NexusReader expects a three dimensional data set, "<<path<<" in "<<fname<<" has "<<info.dims.size()<<" dimensions";
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    pImpl->nElementSize=elementSize(info.type);
+    if (pImpl->nElementSize==0) {
+        msg<<"NexusReader doesn't support the data type of "<<path<<" in "<<fname;
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    pImpl->type    = info.type;
+    pImpl->dims[0] = static_cast<size_t>(info.dims[2]);
+    pImpl->dims[1] = static_cast<size_t>(info.dims[1]);
+    pImpl->dims[2] = static_cast<size_t>(info.dims[0]);
+    pImpl->file    = std::move(file);
+    pImpl->path    = path;
+    pImpl->fname   = fname;
+#else
+    (void)fname;
+    throw kipl::base::KiplException("Nexus library is not supported",__FILE__,__LINE__);
+#endif
+}
+
+void NexusReader::close()
+{
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+
+#ifdef HAVE_NEXUS
+    if (pImpl->file) {
+        std::lock_guard<std::mutex> libraryLock(NexusLibraryMutex());
+        pImpl->file.reset();
+    }
+#endif
+    pImpl->fname.clear();
+    pImpl->path.clear();
+    std::fill_n(pImpl->dims,3,0);
+    pImpl->buffer.clear();
+    pImpl->buffer.shrink_to_fit();
+}
+
+bool NexusReader::isOpen() const
+{
+    return !pImpl->fname.empty();
+}
+
+const std::string & NexusReader::fileName() const
+{
+    return pImpl->fname;
+}
+
+const std::string & NexusReader::datasetPath() const
+{
+    return pImpl->path;
+}
+
+std::string NexusReader::dataType() const
+{
+#ifdef HAVE_NEXUS
+    if (isOpen())
+        return typeName(pImpl->type);
+#endif
+    return "";
+}
+
+void NexusReader::getDims(size_t *dims) const
+{
+    std::copy_n(pImpl->dims,3,dims);
+}
+
+void NexusReader::read(kipl::base::TImage<float,2> &img, size_t number, size_t const * const nCrop)
+{
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+
+    size_t roi[4];
+    pImpl->checkROI(number,number+1,nCrop,roi);
+
+    size_t dims[2]={roi[2]-roi[0], roi[3]-roi[1]};
+    img.Resize(dims);
+
+    pImpl->readSlab(img.GetDataPtr(),number,1,roi);
+}
+
+void NexusReader::read(kipl::base::TImage<float,3> &img, size_t first, size_t last, size_t const * const nCrop)
+{
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+
+    size_t roi[4];
+    pImpl->checkROI(first,last,nCrop,roi);
+
+    size_t dims[3]={roi[2]-roi[0], roi[3]-roi[1], last-first};
+    img.Resize(dims);
+
+    const size_t sliceSize=dims[0]*dims[1];
+    const size_t nBlock=std::max(size_t(1),MaxStagingBytes/(sliceSize*pImpl->nElementSize));
+
+    for (size_t i=first; i<last; i+=nBlock) {
+        const size_t count=std::min(nBlock,last-i);
+        pImpl->readSlab(img.GetLinePtr(0,i-first),i,count,roi);
+    }
+}
+
+}}
@@ -0,0 +1,536 @@
+//<LICENCE>
+
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+#include <cstring>
+
+#include "../../include/io/nexuswriter.h"
+#include "../../include/io/nexusreader.h"
+#include "../../include/base/KiplException.h"
+#include "../../include/logging/logger.h"
+#include "../../include/utilities/threadpool.h"
+
+#ifdef HAVE_NEXUS
+#include <hdf5.h>
+// H5Dwrite_chunk is part of the core library from 1.10.2, older versions have it in the high level library
+#if !H5_VERSION_GE(1,10,2)
+    #include <hdf5_hl.h>
+    #define H5Dwrite_chunk H5DOwrite_chunk
+#endif
+#include <zlib.h>
+#endif
+
+namespace kipl { namespace io {
+
+namespace {
+    /// Target size of a chunk, a chunk holds as many image rows as fit.
+    const size_t ChunkBytes = 1UL<<20;
+}
+
+struct NexusVolumeWriter::Impl {
+    /// \brief A block of slices waiting to be written
+    struct Block {
+        std::vector<float> data;
+        size_t firstSlice;
+        size_t nSlices;
+    };
+
+    /// \brief A chunk ready to be written
+    struct Chunk {
+        std::vector<unsigned char> buffer;
+        unsigned int filterMask;
+        size_t size;
+    };
+
+    Impl() :
+        compression(CompressionNone),
+        level(1),
+        nMaxQueued(2),
+        nRowsPerChunk(0),
+        nChunksPerSlice(0),
+        nExtent(0),
+        nQueuedEnd(0),
+        nWrittenSlices(0),
+        nRawBytes(0),
+        nStoredBytes(0),
+        bBusy(false),
+        bStop(false),
+#ifdef HAVE_NEXUS
+        file(-1),
+        dataset(-1),
+#endif
+        logger("NexusVolumeWriter")
+    {
+        std::fill_n(dims,2,0);
+    }
+
+    void writerLoop();
+    void compressChunk(const float *slice, size_t row, Chunk &chunk);
+    void writeBlock(Block &block);
+    void closeFile();
+    void rethrowError();
+
+    std::string fname;
+    size_t dims[2];
+    eCompression compression;
+    int level;
+    size_t nMaxQueued;
+    size_t nRowsPerChunk;
+    size_t nChunksPerSlice;
+    size_t nExtent;                     ///< Current number of slices in the data set
+    size_t nQueuedEnd;                  ///< One past the last queued slice
+    size_t nWrittenSlices;
+    size_t nRawBytes;
+    size_t nStoredBytes;
+
+    std::deque<Block> queue;
+    std::vector<Chunk> chunks;          ///< Chunk buffers, reused between the blocks
+    bool bBusy;                         ///< The writer thread is processing a block
+    bool bStop;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::thread writer;
+
+#ifdef HAVE_NEXUS
+    hid_t file;
+    hid_t dataset;
+#endif
+    kipl::logging::Logger logger;
+};
+
+void NexusVolumeWriter::Impl::rethrowError()
+{
+    if (error) {
+        std::exception_ptr e=error;
+        error=nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void NexusVolumeWriter::Impl::writerLoop()
+{
+    for (;;) {
+        Block block;
+        bool bFailed=false;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queueChanged.wait(lock,[this]{return bStop || !queue.empty();});
+            if (queue.empty())
+                return;
+
+            block=std::move(queue.front());
+            queue.pop_front();
+            bBusy=true;
+            bFailed=static_cast<bool>(error);
+        }
+        queueChanged.notify_all();
+
+        try {
+            // Blocks following a failed block are dropped, the error is reported by the next call
+            if (!bFailed)
+                writeBlock(block);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error=std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bBusy=false;
+        }
+        queueChanged.notify_all();
+    }
+}
+
+#ifdef HAVE_NEXUS
+namespace {
+    void writeStringAttribute(hid_t obj, const char *name, const std::string &value)
+    {
+        hid_t type  = H5Tcopy(H5T_C_S1);
+        H5Tset_size(type,value.size());
+        hid_t space = H5Screate(H5S_SCALAR);
+        hid_t attr  = H5Acreate2(obj,name,type,space,H5P_DEFAULT,H5P_DEFAULT);
+        herr_t res  = H5Awrite(attr,type,value.c_str());
+        H5Aclose(attr);
+        H5Sclose(space);
+        H5Tclose(type);
+
+        if (res<0)
+            throw kipl::base::KiplException(std::string("Failed to write the attribute ")+name,__FILE__,__LINE__);
+    }
+
+    void writeIntAttribute(hid_t obj, const char *name, int value)
+    {
+        hid_t space = H5Screate(H5S_SCALAR);
+        hid_t attr  = H5Acreate2(obj,name,H5T_NATIVE_INT,space,H5P_DEFAULT,H5P_DEFAULT);
+        herr_t res  = H5Awrite(attr,H5T_NATIVE_INT,&value);
+        H5Aclose(attr);
+        H5Sclose(space);
+
+        if (res<0)
+            throw kipl::base::KiplException(std::string("Failed to write the attribute ")+name,__FILE__,__LINE__);
+    }
+}
+
+void NexusVolumeWriter::Impl::compressChunk(const float *slice, size_t row, Chunk &chunk)
+{
+    const size_t nChunkElements=nRowsPerChunk*dims[0];
+    const size_t nRawSize=nChunkElements*sizeof(float);
+    const size_t nRows=std::min(nRowsPerChunk,dims[1]-row);
+    const size_t nElements=nRows*dims[0];
+    const float *src=slice+row*dims[0];
+
+    // Edge chunks are stored with their full size, the rows outside the image are zero
+    thread_local std::vector<unsigned char> raw;
+    const unsigned char *pRaw=reinterpret_cast<const unsigned char *>(src);
+    if ((nRows<nRowsPerChunk) || (compression==CompressionShuffleDeflate)) {
+        raw.assign(nRawSize,0);
+        if (compression==CompressionShuffleDeflate) {
+            // Byte shuffle as the HDF5 shuffle filter: all first bytes, then all second bytes...
+            const unsigned char *pSrc=reinterpret_cast<const unsigned char *>(src);
+            for (size_t b=0; b<sizeof(float); ++b) {
+                unsigned char *pDst=raw.data()+b*nChunkElements;
+                for (size_t i=0; i<nElements; ++i)
+                    pDst[i]=pSrc[i*sizeof(float)+b];
+            }
+        }
+        else {
+            std::memcpy(raw.data(),src,nElements*sizeof(float));
+        }
+        pRaw=raw.data();
+    }
+
+    if (compression==CompressionNone) {
+        chunk.buffer.resize(nRawSize);
+        std::memcpy(chunk.buffer.data(),pRaw,nRawSize);
+        chunk.size=nRawSize;
+        chunk.filterMask=0;
+        return;
+    }
+
+    uLongf nCompressed=compressBound(static_cast<uLong>(nRawSize));
+    chunk.buffer.resize(nCompressed);
+    int res=compress2(chunk.buffer.data(),&nCompressed,pRaw,static_cast<uLong>(nRawSize),level);
+
+    if ((res!=Z_OK) || (nRawSize<=nCompressed)) {
+        // The deflate filter is skipped for chunks that don't compress, the mask bit tells the reader
+        const unsigned int deflateBit = compression==CompressionShuffleDeflate ? 2U : 1U;
+        chunk.buffer.resize(nRawSize);
+        std::memcpy(chunk.buffer.data(),pRaw,nRawSize);
+        chunk.size=nRawSize;
+        chunk.filterMask=deflateBit;
+        return;
+    }
+
+    chunk.size=nCompressed;
+    chunk.filterMask=0;
+}
+
+void NexusVolumeWriter::Impl::writeBlock(Block &block)
+{
+    const size_t sliceSize=dims[0]*dims[1];
+    const size_t nChunks=block.nSlices*nChunksPerSlice;
+
+    if (chunks.size()<nChunks)
+        chunks.resize(nChunks);
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,nChunks,[&](size_t first, size_t last)
+    {
+        for (size_t i=first; i<last; ++i) {
+            const size_t slice=i/nChunksPerSlice;
+            const size_t row=(i%nChunksPerSlice)*nRowsPerChunk;
+            compressChunk(block.data.data()+slice*sliceSize,row,chunks[i]);
+        }
+    },1);
+
+    std::lock_guard<std::mutex> libraryLock(NexusLibraryMutex());
+
+    const size_t lastSlice=block.firstSlice+block.nSlices;
+    if (nExtent<lastSlice) {
+        hsize_t extent[3]={lastSlice,dims[1],dims[0]};
+        if (H5Dset_extent(dataset,extent)<0)
+            throw kipl::base::KiplException("Failed to extend the NeXus data set",__FILE__,__LINE__);
+        nExtent=lastSlice;
+    }
+
+    size_t nStored=0;
+    for (size_t i=0; i<nChunks; ++i) {
+        hsize_t offset[3]={block.firstSlice+i/nChunksPerSlice, (i%nChunksPerSlice)*nRowsPerChunk, 0};
+        if (H5Dwrite_chunk(dataset,H5P_DEFAULT,chunks[i].filterMask,offset,chunks[i].size,chunks[i].buffer.data())<0) {
+            std::ostringstream msg;
+            msg<<"Failed to write a chunk of slice "<<offset[0]<<" to "<<fname;
+            throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+        }
+        nStored+=chunks[i].size;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    nStoredBytes   += nStored;
+    nRawBytes      += block.nSlices*sliceSize*sizeof(float);
+    nWrittenSlices += block.nSlices;
+}
+
+void NexusVolumeWriter::Impl::closeFile()
+{
+    std::lock_guard<std::mutex> libraryLock(NexusLibraryMutex());
+
+    if (0<=dataset)
+        H5Dclose(dataset);
+    if (0<=file)
+        H5Fclose(file);
+
+    dataset=-1;
+    file=-1;
+}
+#else
+void NexusVolumeWriter::Impl::compressChunk(const float * /*slice*/, size_t /*row*/, Chunk & /*chunk*/)
+{
+}
+
+void NexusVolumeWriter::Impl::writeBlock(Block & /*block*/)
+{
+    throw kipl::base::KiplException("Nexus library is not supported",__FILE__,__LINE__);
+}
+
+void NexusVolumeWriter::Impl::closeFile()
+{
+}
+#endif
+
+NexusVolumeWriter::NexusVolumeWriter() :
+    pImpl(new Impl)
+{
+}
+
+NexusVolumeWriter::~NexusVolumeWriter()
+{
+    try {
+        close();
+    }
+    catch (kipl::base::KiplException &e) {
+        pImpl->logger(kipl::logging::Logger::LogError,e.what());
+    }
+    catch (std::exception &e) {
+        pImpl->logger(kipl::logging::Logger::LogError,e.what());
+    }
+}
+
+void NexusVolumeWriter::create(const std::string &fname,
+                               const size_t *dims,
+                               float pixelsize,
+                               eCompression compression,
+                               int level,
+                               size_t nQueuedBlocks)
+{
+    if (isOpen())
+        throw kipl::base::KiplException("NexusVolumeWriter: a file is already open",__FILE__,__LINE__);
+
+    if ((dims[0]==0) || (dims[1]==0))
+        throw kipl::base::KiplException("NexusVolumeWriter: the slice size must be greater than zero",__FILE__,__LINE__);
+
+#ifdef HAVE_NEXUS
+    Impl &d=*pImpl;
+
+    d.dims[0]         = dims[0];
+    d.dims[1]         = dims[1];
+    d.compression     = compression;
+    d.level           = std::min(9,std::max(1,level));
+    d.nMaxQueued      = std::max(size_t(1),nQueuedBlocks);
+    // The rows are spread evenly over the chunks to keep the padding of the last chunk small
+    const size_t nMaxRows = std::min(dims[1],std::max(size_t(1),ChunkBytes/(dims[0]*sizeof(float))));
+    d.nChunksPerSlice = (dims[1]+nMaxRows-1)/nMaxRows;
+    d.nRowsPerChunk   = (dims[1]+d.nChunksPerSlice-1)/d.nChunksPerSlice;
+    d.nExtent         = dims[2];
+    d.nQueuedEnd      = 0;
+    d.nWrittenSlices  = 0;
+    d.nRawBytes       = 0;
+    d.nStoredBytes    = 0;
+    d.error           = nullptr;
+    d.bStop           = false;
+
+    {
+        std::lock_guard<std::mutex> libraryLock(NexusLibraryMutex());
+
+        hid_t file=H5Fcreate(fname.c_str(),H5F_ACC_TRUNC,H5P_DEFAULT,H5P_DEFAULT);
+        if (file<0)
+            throw kipl::base::KiplException("NexusVolumeWriter failed to create "+fname,__FILE__,__LINE__);
+
+        hid_t entry = -1, data = -1, dcpl = -1, space = -1, dataset = -1;
+        try {
+            // The same group layout as WriteNexusFloat
+            entry = H5Gcreate2(file,"entry",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+            writeStringAttribute(entry,"NX_class","NXentry");
+            data  = H5Gcreate2(entry,"Data1",H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+            writeStringAttribute(data,"NX_class","NXdata");
+
+            hsize_t extent[3]    = {dims[2], dims[1], dims[0]};
+            hsize_t maxextent[3] = {H5S_UNLIMITED, dims[1], dims[0]};
+            hsize_t chunk[3]     = {1, d.nRowsPerChunk, dims[0]};
+
+            dcpl = H5Pcreate(H5P_DATASET_CREATE);
+            H5Pset_chunk(dcpl,3,chunk);
+            if (compression==CompressionShuffleDeflate)
+                H5Pset_shuffle(dcpl);
+            if (compression!=CompressionNone)
+                H5Pset_deflate(dcpl,static_cast<unsigned>(d.level));
+
+            space   = H5Screate_simple(3,extent,maxextent);
+            dataset = H5Dcreate2(data,"signal",H5T_IEEE_F32LE,space,H5P_DEFAULT,dcpl,H5P_DEFAULT);
+            if (dataset<0)
+                throw kipl::base::KiplException("NexusVolumeWriter failed to create the data set in "+fname,__FILE__,__LINE__);
+            writeIntAttribute(dataset,"signal",1);
+
+            // Pixel spacing
+            hsize_t one=1;
+            hid_t sizespace = H5Screate_simple(1,&one,nullptr);
+            hid_t sizeset   = H5Dcreate2(data,"x_pixel_size",H5T_IEEE_F32LE,sizespace,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+            H5Dwrite(sizeset,H5T_NATIVE_FLOAT,H5S_ALL,H5S_ALL,H5P_DEFAULT,&pixelsize);
+            writeStringAttribute(sizeset,"units","mm");
+            H5Dclose(sizeset);
+            H5Sclose(sizespace);
+        }
+        catch (...) {
+            if (0<=dataset) H5Dclose(dataset);
+            if (0<=space)   H5Sclose(space);
+            if (0<=dcpl)    H5Pclose(dcpl);
+            if (0<=data)    H5Gclose(data);
+            if (0<=entry)   H5Gclose(entry);
+            H5Fclose(file);
+            throw;
+        }
+
+        H5Sclose(space);
+        H5Pclose(dcpl);
+        H5Gclose(data);
+        H5Gclose(entry);
+
+        d.file    = file;
+        d.dataset = dataset;
+    }
+
+    d.fname  = fname;
+    d.writer = std::thread(&Impl::writerLoop,pImpl.get());
+#else
+    (void)fname; (void)pixelsize; (void)compression; (void)level; (void)nQueuedBlocks;
+    throw kipl::base::KiplException("Nexus library is not supported",__FILE__,__LINE__);
+#endif
+}
+
+void NexusVolumeWriter::write(const float *data, size_t firstSlice, size_t nSlices)
+{
+    Impl &d=*pImpl;
+
+    if (!isOpen())
+        throw kipl::base::KiplException("NexusVolumeWriter: no file is open",__FILE__,__LINE__);
+
+    if (nSlices==0)
+        return;
+
+    Impl::Block block;
+    block.data.assign(data,data+nSlices*d.dims[0]*d.dims[1]);
+    block.firstSlice = firstSlice;
+    block.nSlices    = nSlices;
+
+    {
+        std::unique_lock<std::mutex> lock(d.mutex);
+        d.queueChanged.wait(lock,[&d]{return (d.queue.size()<d.nMaxQueued) || d.error;});
+        d.rethrowError();
+
+        d.queue.push_back(std::move(block));
+        d.nQueuedEnd=std::max(d.nQueuedEnd,firstSlice+nSlices);
+    }
+    d.queueChanged.notify_all();
+}
+
+void NexusVolumeWriter::write(const kipl::base::TImage<float,3> &img, size_t firstSlice)
+{
+    if ((img.Size(0)!=pImpl->dims[0]) || (img.Size(1)!=pImpl->dims[1])) {
+        std::ostringstream msg;
+        msg<<"NexusVolumeWriter: the slice size "<<img.Size(0)<<"x"<<img.Size(1)
+           <<" differs from the data set "<<pImpl->dims[0]<<"x"<<pImpl->dims[1];
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+
+    write(img.GetDataPtr(),firstSlice,img.Size(2));
+}
+
+void NexusVolumeWriter::append(const kipl::base::TImage<float,3> &img)
+{
+    size_t firstSlice=0;
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        firstSlice=pImpl->nQueuedEnd;
+    }
+
+    write(img,firstSlice);
+}
+
+void NexusVolumeWriter::flush()
+{
+    Impl &d=*pImpl;
+
+    std::unique_lock<std::mutex> lock(d.mutex);
+    d.queueChanged.wait(lock,[&d]{return d.queue.empty() && !d.bBusy;});
+    d.rethrowError();
+}
+
+void NexusVolumeWriter::close()
+{
+    Impl &d=*pImpl;
+
+    if (!d.writer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(d.mutex);
+        d.bStop=true;
+    }
+    d.queueChanged.notify_all();
+    d.writer.join();
+
+    d.closeFile();
+
+    std::ostringstream msg;
+    msg<<"Wrote "<<d.nWrittenSlices<<" slices to "<<d.fname<<" (compression ratio "<<compressionRatio()<<")";
+    d.logger(kipl::logging::Logger::LogVerbose,msg.str());
+
+    d.fname.clear();
+    d.queue.clear();
+    d.chunks.clear();
+
+    std::lock_guard<std::mutex> lock(d.mutex);
+    d.rethrowError();
+}
+
+bool NexusVolumeWriter::isOpen() const
+{
+    return pImpl->writer.joinable();
+}
+
+size_t NexusVolumeWriter::writtenSlices() const
+{
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+
+    return pImpl->nWrittenSlices;
+}
+
+double NexusVolumeWriter::compressionRatio() const
+{
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+
+    if (pImpl->nStoredBytes==0)
+        return 1.0;
+
+    return static_cast<double>(pImpl->nRawBytes)/static_cast<double>(pImpl->nStoredBytes);
+}
+
+}}
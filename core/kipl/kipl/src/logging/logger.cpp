@@ -4,25 +4,82 @@
 #include <list>
 #include <iostream>
 #include <ctime>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <condition_variable>
 
 #include "../../include/kipl_global.h"
 #include "../../include/logging/logger.h"
 #include "../../include/base/KiplException.h"
+#include "../../include/containers/lockfreequeue.h"
 
 namespace kipl { namespace logging {
 using namespace std;
 //std::ostream * Logger::LogTargets=& std::cout;
-Logger::LogLevel Logger::CurrentLogLevel=Logger::LogMessage;
+std::atomic<Logger::LogLevel> Logger::CurrentLogLevel(Logger::LogMessage);
 LogWriter ConsoleLogger;
-#ifdef MULTITARGETS
-#else
-LogWriter * Logger::LogTarget = &ConsoleLogger;
-#endif
+std::list<LogWriter *> Logger::LogTargets(1,&ConsoleLogger);
 
 std::mutex Logger::m_LoggerMutex;
 
+namespace {
+/// \brief State of the background writer used by the asynchronous logging mode
+struct AsyncLogState {
+    AsyncLogState() : running(false), pending(0), producers(0), writerWaiting(false) {}
+
+    std::unique_ptr<kipl::containers::LockFreeQueue<std::string>> queue;
+    std::thread writer;
+    std::atomic<bool> running;
+    std::atomic<size_t> pending;    ///< Number of messages that are queued but not yet written
+    std::atomic<size_t> producers;  ///< Number of threads that are between the running check and the push
+    std::atomic<bool> writerWaiting;///< The writer sleeps, producers must wake it
+    std::mutex controlMutex;        ///< Serializes start and stop of the writer thread
+    std::mutex wakeMutex;           ///< Protects the waits on the condition
+    std::condition_variable condition; ///< Signals new messages, drained queue and finished producers
+};
+
+AsyncLogState & asyncState()
+{
+    static AsyncLogState state;
+
+    return state;
+}
+
+void notifyAll(AsyncLogState *state)
+{
+    std::lock_guard<std::mutex> lock(state->wakeMutex);
+    state->condition.notify_all();
+}
+
+void asyncWriterLoop(AsyncLogState *state, void (*write)(const std::string &))
+{
+    std::string msg;
+    for (;;) {
+        bool wrote=false;
+        while (state->queue->try_pop(msg)) {
+            write(msg);
+            state->pending.fetch_sub(1);
+            wrote=true;
+        }
+
+        // Wakes the threads waiting in Flush
+        if (wrote && state->pending.load()==0)
+            notifyAll(state);
+
+        std::unique_lock<std::mutex> lock(state->wakeMutex);
+        if (!state->running.load() && state->pending.load()==0)
+            break;
+
+        state->writerWaiting.store(true);
+        state->condition.wait(lock,[state]{return !state->running.load() || state->pending.load()!=0;});
+        state->writerWaiting.store(false);
+    }
+}
+}
+
 size_t LogWriter::Write(std::string str){
-	std::cout<<str;
+	std::cout<<str<<std::flush;
 	
 	return 0;
 }
@@ -49,25 +106,89 @@ LogStreamWriter::~LogStreamWriter()
 
 Logger::Logger(std::string str, std::ostream & UNUSED(s))
 {
-#ifdef MULTITARGET
-    if (Logger::LogTargets.empty())
-        Logger::LogTargets.push_back(&ConsoleLogger);
-#endif
-
 	sLogOrigin=str;
 }
 
 size_t Logger::AddLogTarget(LogWriter & lw)
 {
-#ifdef MULTITARGET
-    if (((*(Logger::LogTargets.begin())) == &ConsoleLogger) && (Logger::LogTargets.size()==1))
+    std::lock_guard<std::mutex> lock(m_LoggerMutex);
+
+    if ((Logger::LogTargets.size()==1) && (Logger::LogTargets.front() == &ConsoleLogger))
         Logger::LogTargets.clear();
 
-    Logger::LogTargets.push_back(&lw);
-#else
-    Logger::LogTarget = &lw;
-#endif
-	return 0;
+    if (std::find(Logger::LogTargets.begin(),Logger::LogTargets.end(),&lw)==Logger::LogTargets.end())
+        Logger::LogTargets.push_back(&lw);
+
+    return Logger::LogTargets.size();
+}
+
+size_t Logger::RemoveLogTarget(LogWriter & lw)
+{
+    Flush();
+
+    std::lock_guard<std::mutex> lock(m_LoggerMutex);
+
+    Logger::LogTargets.remove(&lw);
+
+    if (Logger::LogTargets.empty())
+        Logger::LogTargets.push_back(&ConsoleLogger);
+
+    return Logger::LogTargets.size();
+}
+
+LogWriter & Logger::ConsoleTarget()
+{
+    return ConsoleLogger;
+}
+
+void Logger::StartAsyncLogging(size_t queueSize)
+{
+    AsyncLogState &state=asyncState();
+    std::lock_guard<std::mutex> lock(state.controlMutex);
+
+    if (state.running.load())
+        return;
+
+    // The queue is kept when the writer stops since other threads may still hold a reference to it.
+    if (!state.queue || state.queue->capacity()<queueSize)
+        state.queue.reset(new kipl::containers::LockFreeQueue<std::string>(queueSize));
+
+    state.running.store(true,std::memory_order_release);
+    state.writer=std::thread(asyncWriterLoop,&state,&Logger::WriteToTargets);
+}
+
+void Logger::StopAsyncLogging()
+{
+    AsyncLogState &state=asyncState();
+    std::lock_guard<std::mutex> lock(state.controlMutex);
+
+    if (!state.running.load())
+        return;
+
+    // Producers that saw the running flag finish their push before the writer is stopped, later ones write synchronously.
+    {
+        std::unique_lock<std::mutex> wakeLock(state.wakeMutex);
+        state.running.store(false);
+        state.condition.wait(wakeLock,[&state]{return state.producers.load()==0;});
+        state.condition.notify_all();
+    }
+
+    if (state.writer.joinable())
+        state.writer.join();
+
+    std::string msg;
+    while (state.queue->try_pop(msg)) {
+        WriteToTargets(msg);
+        state.pending.fetch_sub(1,std::memory_order_release);
+    }
+}
+
+void Logger::Flush()
+{
+    AsyncLogState &state=asyncState();
+
+    std::unique_lock<std::mutex> lock(state.wakeMutex);
+    state.condition.wait(lock,[&state]{return !state.running.load() || state.pending.load()==0;});
 }
 
 void Logger::SetLogLevel(LogLevel level)
@@ -76,7 +197,10 @@ void Logger::SetLogLevel(LogLevel level)
 }
 
 void Logger::operator()(LogLevel severity, std::string message)
-{	
+{
+	if (!IsEnabled(severity))
+		return;
+
 	std::ostringstream ostr;
 	ostr<<sLogOrigin<<": "<<message;
 	
@@ -89,6 +213,9 @@ void Logger::operator()(LogLevel severity, std::string message)
 /// \param message A string containing the message
 void Logger::operator()(LogLevel severity, std::stringstream & message)
 {
+    if (!IsEnabled(severity))
+        return;
+
     operator ()(severity,message.str());
 }
 
@@ -120,20 +247,43 @@ void Logger::debug(const std::string message)
 
 void Logger::WriteMessage(LogLevel s, std::string message)
 {
-    std::lock_guard<std::mutex> lock(m_LoggerMutex);
+    if (!IsEnabled(s))
+        return;
+
+    std::string msg="["+enum2string(s)+"] "+message+"\n";
+
+    AsyncLogState &state=asyncState();
+    bool queued=false;
+
+    state.producers.fetch_add(1);
+    if (state.running.load()) {
+        state.pending.fetch_add(1);
+        queued=state.queue->try_push(std::move(msg));
 
-	if (s<=CurrentLogLevel) {
-		stringstream msg;
-		msg<<"["<<s<<"] "<<message<<std::endl;
-#ifdef MULTITARGET
-        std::list<kipl::logging::LogWriter *>::iterator it;
-        for (it=Logger::LogTargets.begin(); it!=Logger::LogTargets.end(); it++) {
-            (*it)->Write(msg.str());
+        if (queued) {
+            if (state.writerWaiting.load())
+                notifyAll(&state);
         }
-#else
-        Logger::LogTarget->Write(msg.str());
-#endif
-	}
+        else {
+            // The queue is full, the message is written from this thread instead of dropping it.
+            state.pending.fetch_sub(1);
+        }
+    }
+
+    // The last producer wakes StopAsyncLogging
+    if ((state.producers.fetch_sub(1)==1) && !state.running.load())
+        notifyAll(&state);
+
+    if (!queued)
+        WriteToTargets(msg);
+}
+
+void Logger::WriteToTargets(const std::string &message)
+{
+    std::lock_guard<std::mutex> lock(m_LoggerMutex);
+
+    for (auto & target : Logger::LogTargets)
+        target->Write(message);
 }
 	
 }}
@@ -0,0 +1,77 @@
+//<LICENCE>
+
+#include <cmath>
+
+#include "../../include/math/batchfit.h"
+#include "../../include/math/mathconstants.h"
+#include "../../include/base/KiplException.h"
+
+namespace Nonlinear {
+
+double GaussianModel::operator()(double x, const double *a, double *dyda) const
+{
+    const double arg=(x-a[1])/a[2];
+    const double ex=std::exp(-arg*arg);
+    const double fac=a[0]*ex*2.0*arg;
+
+    dyda[0]=ex;
+    dyda[1]=fac/a[2];
+    dyda[2]=fac*arg/a[2];
+
+    return a[0]*ex;
+}
+
+double LorenzianModel::operator()(double x, const double *a, double *dyda) const
+{
+    const double g2=a[0]*a[0];
+    const double den=x*x+g2;
+
+    dyda[0]=(x*x-g2)/(dPi*den*den);
+
+    return a[0]/(dPi*den);
+}
+
+double VoightModel::operator()(double x, const double *a, double *dyda) const
+{
+    const double diff=x-a[1];
+    const double adiff=std::abs(diff);
+    const double ex=std::exp(-a[2]*adiff-0.5*a[3]*diff*diff);
+    const double y=a[0]*ex;
+
+    dyda[0]=ex;
+    dyda[1]=y*(a[2]*(0.0<diff ? 1.0 : (diff<0.0 ? -1.0 : 0.0))+a[3]*diff);
+    dyda[2]=-y*adiff;
+    dyda[3]=-0.5*y*diff*diff;
+
+    return y;
+}
+
+}
+
+void string2enum(const std::string &str, Nonlinear::eFitStatus &status)
+{
+    if      (str=="converged")     status=Nonlinear::FitConverged;
+    else if (str=="maxiterations") status=Nonlinear::FitMaxIterations;
+    else if (str=="singular")      status=Nonlinear::FitSingular;
+    else if (str=="invaliddata")   status=Nonlinear::FitInvalidData;
+    else throw kipl::base::KiplException("Unknown fit status "+str,__FILE__,__LINE__);
+}
+
+std::string enum2string(Nonlinear::eFitStatus status)
+{
+    switch (status) {
+    case Nonlinear::FitConverged:     return "converged";
+    case Nonlinear::FitMaxIterations: return "maxiterations";
+    case Nonlinear::FitSingular:      return "singular";
+    case Nonlinear::FitInvalidData:   return "invaliddata";
+    }
+
+    throw kipl::base::KiplException("Unknown fit status",__FILE__,__LINE__);
+}
+
+std::ostream & operator<<(std::ostream &s, Nonlinear::eFitStatus status)
+{
+    s<<enum2string(status);
+
+    return s;
+}
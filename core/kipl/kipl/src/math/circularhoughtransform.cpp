@@ -2,12 +2,55 @@
 #include <cmath>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <mutex>
+
+#include <fftw3.h>
 
 #include "../../include/math/circularhoughtransform.h"
 #include "../../include/drawing/drawing.h"
 #include "../../include/filters/filter.h"
 #include "../../include/math/sums.h"
 #include "../../include/io/io_tiff.h"
+#include "../../include/fft/fftbase.h"
+#include "../../include/base/KiplException.h"
+#include "../../include/utilities/threadpool.h"
+
+namespace {
+
+/// \returns the smallest length not less than n that only has the factors 2, 3 and 5
+size_t fftFriendlySize(size_t n)
+{
+    for (size_t len=std::max(n,size_t(1)); ; ++len) {
+        size_t rest=len;
+        for (size_t factor : {2,3,5})
+            while (rest % factor == 0)
+                rest/=factor;
+
+        if (rest==1)
+            return len;
+    }
+}
+
+/// \returns the index mirrored into [0,n) around the edge samples
+ptrdiff_t mirrorIndex(ptrdiff_t k, ptrdiff_t n)
+{
+    if (n==1)
+        return 0;
+
+    const ptrdiff_t period=2*(n-1);
+    k=k % period;
+    if (k<0)
+        k+=period;
+
+    return k<n ? k : period-k;
+}
+
+/// The accumulator slices computed together by one thread, limited by the memory use
+const size_t cMaxRadiusBatch = 8;
+const size_t cBatchMemoryBudget = size_t(512)<<20;
+
+}
 
 namespace kipl { namespace math {
 
@@ -31,6 +74,223 @@ kipl::base::TImage<float,2> CircularHoughTransform::operator()(kipl::base::TImag
     return chtmap;
 }
 
+kipl::base::TImage<float,3> CircularHoughTransform::operator()(const kipl::base::TImage<float,2> &img, const std::vector<float> &radii, bool useDerivative)
+{
+    if (radii.empty())
+        throw kipl::base::KiplException("The circular Hough transform needs at least one radius",__FILE__,__LINE__);
+
+    if (*std::min_element(radii.begin(),radii.end())<=0.0f)
+        throw kipl::base::KiplException("The circular Hough transform needs positive radii",__FILE__,__LINE__);
+
+    m_Radii=radii;
+    m_Img.Clone(img);
+    absDerivative(useDerivative);
+
+    const size_t nx=m_Img.Size(0);
+    const size_t ny=m_Img.Size(1);
+    const size_t pad=static_cast<size_t>(std::ceil(*std::max_element(radii.begin(),radii.end())+1.0f));
+
+    // The padding covers the largest kernel, the circular convolution doesn't wrap around into the image
+    const size_t px=fftFriendlySize(nx+2*pad);
+    const size_t py=fftFriendlySize(ny+2*pad);
+    const size_t nReal=px*py;
+    const size_t nFreq=py*(px/2+1);
+    const size_t nThreads=kipl::utilities::ThreadPool::global().size();
+    const size_t bytesPerRadius=nReal*sizeof(float)+nFreq*sizeof(fftwf_complex);
+    const size_t batch=std::max(size_t(1),std::min({cMaxRadiusBatch,radii.size(),cBatchMemoryBudget/(nThreads*bytesPerRadius)}));
+
+    std::ostringstream msg;
+    msg<<"Multi-radius transform of "<<nx<<"x"<<ny<<" pixels, "<<radii.size()<<" radii, fft size "<<px<<"x"<<py<<", batch "<<batch;
+    logger(logger.LogMessage,msg.str());
+
+    float *pImage=fftwf_alloc_real(nReal);
+    fftwf_complex *pSpectrum=fftwf_alloc_complex(nFreq);
+    float *pReal=fftwf_alloc_real(batch*nReal);
+    fftwf_complex *pSpec=fftwf_alloc_complex(batch*nFreq);
+
+    fftwf_plan imagePlan=nullptr;
+    fftwf_plan forward=nullptr;
+    fftwf_plan inverse=nullptr;
+    {
+        std::lock_guard<std::mutex> lock(kipl::math::fft::plannerMutex());
+        const int n[2]={static_cast<int>(py),static_cast<int>(px)};
+        imagePlan=fftwf_plan_dft_r2c_2d(n[0],n[1],pImage,pSpectrum,FFTW_ESTIMATE);
+        forward=fftwf_plan_many_dft_r2c(2,n,static_cast<int>(batch),
+                                        pReal,nullptr,1,static_cast<int>(nReal),
+                                        pSpec,nullptr,1,static_cast<int>(nFreq),
+                                        FFTW_ESTIMATE);
+        inverse=fftwf_plan_many_dft_c2r(2,n,static_cast<int>(batch),
+                                        pSpec,nullptr,1,static_cast<int>(nFreq),
+                                        pReal,nullptr,1,static_cast<int>(nReal),
+                                        FFTW_ESTIMATE);
+    }
+    fftwf_free(pReal);
+    fftwf_free(pSpec);
+
+    // The spectrum of the mirror padded image is shared by all radii
+    for (size_t y=0; y<py; ++y) {
+        const float *pLine=m_Img.GetLinePtr(mirrorIndex(static_cast<ptrdiff_t>(y)-static_cast<ptrdiff_t>(pad),ny));
+        float *pPadded=pImage+y*px;
+        for (size_t x=0; x<px; ++x)
+            pPadded[x]=pLine[mirrorIndex(static_cast<ptrdiff_t>(x)-static_cast<ptrdiff_t>(pad),nx)];
+    }
+    fftwf_execute(imagePlan);
+
+    size_t dims[3]={nx,ny,radii.size()};
+    kipl::base::TImage<float,3> chm(dims);
+
+    const size_t nBatches=(radii.size()+batch-1)/batch;
+    const float scale=1.0f/static_cast<float>(nReal);
+
+    try {
+        kipl::utilities::ThreadPool::global().parallel_for(0,nBatches,
+            [&](size_t first, size_t last) {
+                float *pKernels=fftwf_alloc_real(batch*nReal);
+                fftwf_complex *pKernelSpec=fftwf_alloc_complex(batch*nFreq);
+
+                for (size_t b=first; b<last; ++b) {
+                    const size_t r0=b*batch;
+                    const size_t nRadii=std::min(batch,radii.size()-r0);
+
+                    for (size_t i=0; i<batch; ++i) {
+                        if (i<nRadii)
+                            buildPeriodicKernel(radii[r0+i],pKernels+i*nReal,px,py);
+                        else
+                            std::fill_n(pKernels+i*nReal,nReal,0.0f);
+                    }
+
+                    fftwf_execute_dft_r2c(forward,pKernels,pKernelSpec);
+
+                    for (size_t i=0; i<nRadii; ++i) {
+                        fftwf_complex *pK=pKernelSpec+i*nFreq;
+                        for (size_t k=0; k<nFreq; ++k) {
+                            const float re=pK[k][0]*pSpectrum[k][0]-pK[k][1]*pSpectrum[k][1];
+                            const float im=pK[k][0]*pSpectrum[k][1]+pK[k][1]*pSpectrum[k][0];
+                            pK[k][0]=scale*re;
+                            pK[k][1]=scale*im;
+                        }
+                    }
+
+                    fftwf_execute_dft_c2r(inverse,pKernelSpec,pKernels);
+
+                    for (size_t i=0; i<nRadii; ++i) {
+                        for (size_t y=0; y<ny; ++y)
+                            std::copy_n(pKernels+i*nReal+(y+pad)*px+pad,nx,chm.GetLinePtr(y,r0+i));
+                    }
+                }
+
+                fftwf_free(pKernels);
+                fftwf_free(pKernelSpec);
+            },1);
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(kipl::math::fft::plannerMutex());
+        fftwf_destroy_plan(imagePlan);
+        fftwf_destroy_plan(forward);
+        fftwf_destroy_plan(inverse);
+        fftwf_free(pImage);
+        fftwf_free(pSpectrum);
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(kipl::math::fft::plannerMutex());
+        fftwf_destroy_plan(imagePlan);
+        fftwf_destroy_plan(forward);
+        fftwf_destroy_plan(inverse);
+    }
+    fftwf_free(pImage);
+    fftwf_free(pSpectrum);
+
+    return chm;
+}
+
+std::vector<CircularHoughPeak> CircularHoughTransform::findPeaks(const kipl::base::TImage<float,3> &chm, size_t maxPeaks, float minDistance) const
+{
+    if (chm.Size(2)!=m_Radii.size())
+        throw kipl::base::KiplException("The accumulator doesn't match the radii of the last transform",__FILE__,__LINE__);
+
+    const size_t nx=chm.Size(0);
+    const size_t ny=chm.Size(1);
+    const size_t nxy=nx*ny;
+
+    // Strongest response over the radii for each pixel
+    std::vector<float> best(chm.GetDataPtr(),chm.GetDataPtr()+nxy);
+    std::vector<size_t> bestRadius(nxy,0);
+    for (size_t r=1; r<chm.Size(2); ++r) {
+        const float *pSlice=chm.GetDataPtr()+r*nxy;
+        for (size_t i=0; i<nxy; ++i) {
+            if (best[i]<pSlice[i]) {
+                best[i]=pSlice[i];
+                bestRadius[i]=r;
+            }
+        }
+    }
+
+    std::vector<CircularHoughPeak> candidates;
+    for (size_t y=0; y<ny; ++y) {
+        for (size_t x=0; x<nx; ++x) {
+            const float value=best[x+y*nx];
+            bool isMax=true;
+            for (size_t yy=(y==0 ? 0 : y-1); isMax && (yy<std::min(ny,y+2)); ++yy)
+                for (size_t xx=(x==0 ? 0 : x-1); xx<std::min(nx,x+2); ++xx)
+                    if (value<best[xx+yy*nx]) {
+                        isMax=false;
+                        break;
+                    }
+
+            if (isMax && (0.0f<value))
+                candidates.push_back({static_cast<float>(x),static_cast<float>(y),m_Radii[bestRadius[x+y*nx]],value});
+        }
+    }
+
+    std::sort(candidates.begin(),candidates.end(),
+              [](const CircularHoughPeak &a, const CircularHoughPeak &b) {return b.value<a.value;});
+
+    std::vector<CircularHoughPeak> peaks;
+    const float minDistance2=minDistance*minDistance;
+    for (const auto &candidate : candidates) {
+        if (maxPeaks<=peaks.size())
+            break;
+
+        bool isolated=true;
+        for (const auto &peak : peaks) {
+            const float dx=peak.x-candidate.x;
+            const float dy=peak.y-candidate.y;
+            if (dx*dx+dy*dy<minDistance2) {
+                isolated=false;
+                break;
+            }
+        }
+
+        if (isolated)
+            peaks.push_back(candidate);
+    }
+
+    return peaks;
+}
+
+void CircularHoughTransform::buildPeriodicKernel(float radius, float *kernel, size_t nx, size_t ny)
+{
+    std::fill_n(kernel,nx*ny,0.0f);
+
+    // Same ring as buildKernel, the negative offsets wrap to the end of the buffer
+    const int C=static_cast<int>(ceil(radius+1));
+    float sum=0.0f;
+    for (int y=-C; y<=C; ++y) {
+        float *pLine=kernel+((y+static_cast<int>(ny)) % static_cast<int>(ny))*nx;
+        for (int x=-C; x<=C; ++x) {
+            if (std::abs(std::sqrt(static_cast<float>(x*x+y*y))-radius)<0.5f) {
+                pLine[(x+static_cast<int>(nx)) % static_cast<int>(nx)]=1.0f;
+                sum+=1.0f;
+            }
+        }
+    }
+
+    for (size_t i=0; i<nx*ny; ++i)
+        kernel[i]/=sum;
+}
+
 void CircularHoughTransform::buildKernel(float radius)
 {
     int N=ceil(radius+1)*2+1;
@@ -0,0 +1,491 @@
+//<LICENSE>
+
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KIPL_FASTMATH_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define KIPL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KIPL_TARGET(isa)
+#endif
+
+#include "../../include/math/fastmath.h"
+#include "../../include/base/KiplException.h"
+
+namespace {
+
+// The polynomials are stored with the highest degree first.
+// log(1+f) = f - f^2/2 + f^3*P(f) for f in [sqrt(0.5)-1, sqrt(2)-1], the precise coefficients are from Cephes logf.
+const float logPrecise[9] = { 7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f,
+                             -1.2420140846e-1f,  1.4249322787e-1f,-1.6668057665e-1f,
+                              2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f };
+const float logFast[4]    = {-1.4776995616e-1f,  2.1891667338e-1f,-2.5235271466e-1f, 3.3275303824e-1f };
+
+// exp(r) = 1 + r + r^2*P(r) for r in [-log(2)/2, log(2)/2], the precise coefficients are from Cephes expf.
+const float expPrecise[6] = { 1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+                              4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f };
+const float expFast[3]    = { 4.0917402900e-2f, 1.6753975960e-1f, 5.0008930975e-1f };
+
+const float cLn2Hi    =  0.693359375f;      // log(2) split in an exact part and a correction
+const float cLn2Lo    = -2.12194440e-4f;
+const float cSqrtHalf =  0.707106781186547524f;
+const float cLog2e    =  1.44269504088896341f;
+const float cExpMax   =  88.7228317f;       // largest float below log(FLT_MAX)
+const float cExpMin   = -87.3365448f;       // log(FLT_MIN)
+
+#ifdef KIPL_FASTMATH_X86
+// ---- SSE2 ----
+template <int NP>
+inline __m128 logSSE2(__m128 x, const float *c, __m128 vMin)
+{
+    const __m128  vOne  = _mm_set1_ps(1.0f);
+    x = _mm_min_ps(_mm_max_ps(x,vMin),_mm_set1_ps(FLT_MAX)); // max returns vMin for NaN
+
+    const __m128i bits = _mm_castps_si128(x);
+    __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits,23),_mm_set1_epi32(126)));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits,_mm_set1_epi32(0x007fffff)),_mm_set1_epi32(0x3f000000))); // [0.5,1)
+
+    // Moves the mantissa to [sqrt(0.5),sqrt(2))
+    const __m128 mask = _mm_cmplt_ps(m,_mm_set1_ps(cSqrtHalf));
+    e = _mm_sub_ps(e,_mm_and_ps(vOne,mask));
+    const __m128 f = _mm_sub_ps(_mm_add_ps(m,_mm_and_ps(m,mask)),vOne);
+    const __m128 z = _mm_mul_ps(f,f);
+
+    __m128 p = _mm_set1_ps(c[0]);
+    for (int k=1; k<NP; ++k)
+        p = _mm_add_ps(_mm_mul_ps(p,f),_mm_set1_ps(c[k]));
+
+    __m128 y = _mm_mul_ps(_mm_mul_ps(p,f),z);
+    y = _mm_add_ps(y,_mm_mul_ps(e,_mm_set1_ps(cLn2Lo)));
+    y = _mm_sub_ps(y,_mm_mul_ps(z,_mm_set1_ps(0.5f)));
+
+    return _mm_add_ps(_mm_add_ps(f,y),_mm_mul_ps(e,_mm_set1_ps(cLn2Hi)));
+}
+
+template <int NP>
+inline __m128 expSSE2(__m128 x, const float *c)
+{
+    x = _mm_min_ps(_mm_max_ps(x,_mm_set1_ps(cExpMin)),_mm_set1_ps(cExpMax));
+
+    const __m128i n  = _mm_cvtps_epi32(_mm_mul_ps(x,_mm_set1_ps(cLog2e))); // rounds to nearest
+    const __m128  fn = _mm_cvtepi32_ps(n);
+    const __m128  r  = _mm_sub_ps(_mm_sub_ps(x,_mm_mul_ps(fn,_mm_set1_ps(cLn2Hi))),_mm_mul_ps(fn,_mm_set1_ps(cLn2Lo)));
+    const __m128  z  = _mm_mul_ps(r,r);
+
+    __m128 p = _mm_set1_ps(c[0]);
+    for (int k=1; k<NP; ++k)
+        p = _mm_add_ps(_mm_mul_ps(p,r),_mm_set1_ps(c[k]));
+
+    __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p,z),r),_mm_set1_ps(1.0f));
+
+    // 2^n in two factors, n is in [-126,128]
+    const __m128i n1 = _mm_srai_epi32(n,1);
+    const __m128i n2 = _mm_sub_epi32(n,n1);
+    const __m128i bias = _mm_set1_epi32(127);
+    y = _mm_mul_ps(y,_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n1,bias),23)));
+    return _mm_mul_ps(y,_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n2,bias),23)));
+}
+
+template <int NP>
+void logArraySSE2(const float *src, float *dst, size_t N, const float *c, float minValue)
+{
+    const __m128 vMin=_mm_set1_ps(minValue);
+    size_t i=0;
+    for (; i+4<=N; i+=4)
+        _mm_storeu_ps(dst+i,logSSE2<NP>(_mm_loadu_ps(src+i),c,vMin));
+
+    if (i<N) {
+        float tmp[4]={1.0f,1.0f,1.0f,1.0f};
+        std::copy(src+i,src+N,tmp);
+        _mm_storeu_ps(tmp,logSSE2<NP>(_mm_loadu_ps(tmp),c,vMin));
+        std::copy(tmp,tmp+(N-i),dst+i);
+    }
+}
+
+template <int NP>
+void expArraySSE2(const float *src, float *dst, size_t N, const float *c)
+{
+    size_t i=0;
+    for (; i+4<=N; i+=4)
+        _mm_storeu_ps(dst+i,expSSE2<NP>(_mm_loadu_ps(src+i),c));
+
+    if (i<N) {
+        float tmp[4]={0.0f,0.0f,0.0f,0.0f};
+        std::copy(src+i,src+N,tmp);
+        _mm_storeu_ps(tmp,expSSE2<NP>(_mm_loadu_ps(tmp),c));
+        std::copy(tmp,tmp+(N-i),dst+i);
+    }
+}
+
+// ---- AVX2 with FMA ----
+template <int NP>
+KIPL_TARGET("avx2,fma") inline __m256 logAVX2(__m256 x, const float *c, __m256 vMin)
+{
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    x = _mm256_min_ps(_mm256_max_ps(x,vMin),_mm256_set1_ps(FLT_MAX));
+
+    const __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits,23),_mm256_set1_epi32(126)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits,_mm256_set1_epi32(0x007fffff)),_mm256_set1_epi32(0x3f000000)));
+
+    const __m256 mask = _mm256_cmp_ps(m,_mm256_set1_ps(cSqrtHalf),_CMP_LT_OQ);
+    e = _mm256_sub_ps(e,_mm256_and_ps(vOne,mask));
+    const __m256 f = _mm256_sub_ps(_mm256_add_ps(m,_mm256_and_ps(m,mask)),vOne);
+    const __m256 z = _mm256_mul_ps(f,f);
+
+    __m256 p = _mm256_set1_ps(c[0]);
+    for (int k=1; k<NP; ++k)
+        p = _mm256_fmadd_ps(p,f,_mm256_set1_ps(c[k]));
+
+    __m256 y = _mm256_mul_ps(_mm256_mul_ps(p,f),z);
+    y = _mm256_fmadd_ps(e,_mm256_set1_ps(cLn2Lo),y);
+    y = _mm256_fnmadd_ps(z,_mm256_set1_ps(0.5f),y);
+
+    return _mm256_fmadd_ps(e,_mm256_set1_ps(cLn2Hi),_mm256_add_ps(f,y));
+}
+
+template <int NP>
+KIPL_TARGET("avx2,fma") inline __m256 expAVX2(__m256 x, const float *c)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x,_mm256_set1_ps(cExpMin)),_mm256_set1_ps(cExpMax));
+
+    const __m256i n  = _mm256_cvtps_epi32(_mm256_mul_ps(x,_mm256_set1_ps(cLog2e)));
+    const __m256  fn = _mm256_cvtepi32_ps(n);
+    const __m256  r  = _mm256_fnmadd_ps(fn,_mm256_set1_ps(cLn2Lo),_mm256_fnmadd_ps(fn,_mm256_set1_ps(cLn2Hi),x));
+    const __m256  z  = _mm256_mul_ps(r,r);
+
+    __m256 p = _mm256_set1_ps(c[0]);
+    for (int k=1; k<NP; ++k)
+        p = _mm256_fmadd_ps(p,r,_mm256_set1_ps(c[k]));
+
+    __m256 y = _mm256_add_ps(_mm256_fmadd_ps(p,z,r),_mm256_set1_ps(1.0f));
+
+    const __m256i n1 = _mm256_srai_epi32(n,1);
+    const __m256i n2 = _mm256_sub_epi32(n,n1);
+    const __m256i bias = _mm256_set1_epi32(127);
+    y = _mm256_mul_ps(y,_mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n1,bias),23)));
+    return _mm256_mul_ps(y,_mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n2,bias),23)));
+}
+
+template <int NP>
+KIPL_TARGET("avx2,fma") void logArrayAVX2(const float *src, float *dst, size_t N, const float *c, float minValue)
+{
+    const __m256 vMin=_mm256_set1_ps(minValue);
+    size_t i=0;
+    for (; i+8<=N; i+=8)
+        _mm256_storeu_ps(dst+i,logAVX2<NP>(_mm256_loadu_ps(src+i),c,vMin));
+
+    if (i<N) {
+        float tmp[8]={1.0f,1.0f,1.0f,1.0f,1.0f,1.0f,1.0f,1.0f};
+        std::copy(src+i,src+N,tmp);
+        _mm256_storeu_ps(tmp,logAVX2<NP>(_mm256_loadu_ps(tmp),c,vMin));
+        std::copy(tmp,tmp+(N-i),dst+i);
+    }
+}
+
+template <int NP>
+KIPL_TARGET("avx2,fma") void expArrayAVX2(const float *src, float *dst, size_t N, const float *c)
+{
+    size_t i=0;
+    for (; i+8<=N; i+=8)
+        _mm256_storeu_ps(dst+i,expAVX2<NP>(_mm256_loadu_ps(src+i),c));
+
+    if (i<N) {
+        float tmp[8]={0.0f,0.0f,0.0f,0.0f,0.0f,0.0f,0.0f,0.0f};
+        std::copy(src+i,src+N,tmp);
+        _mm256_storeu_ps(tmp,expAVX2<NP>(_mm256_loadu_ps(tmp),c));
+        std::copy(tmp,tmp+(N-i),dst+i);
+    }
+}
+
+// ---- AVX-512F ----
+// GCC's avx512fintrin.h builds the results from _mm512_undefined_* which triggers false -Wmaybe-uninitialized warnings
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+template <int NP>
+KIPL_TARGET("avx512f") inline __m512 logAVX512(__m512 x, const float *c, __m512 vMin)
+{
+    const __m512 vOne = _mm512_set1_ps(1.0f);
+    x = _mm512_min_ps(_mm512_max_ps(x,vMin),_mm512_set1_ps(FLT_MAX));
+
+    const __m512i bits = _mm512_castps_si512(x);
+    __m512 e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits,23),_mm512_set1_epi32(126)));
+    __m512 m = _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(bits,_mm512_set1_epi32(0x007fffff)),_mm512_set1_epi32(0x3f000000)));
+
+    const __mmask16 mask = _mm512_cmp_ps_mask(m,_mm512_set1_ps(cSqrtHalf),_CMP_LT_OQ);
+    e = _mm512_mask_sub_ps(e,mask,e,vOne);
+    const __m512 f = _mm512_sub_ps(_mm512_mask_add_ps(m,mask,m,m),vOne);
+    const __m512 z = _mm512_mul_ps(f,f);
+
+    __m512 p = _mm512_set1_ps(c[0]);
+    for (int k=1; k<NP; ++k)
+        p = _mm512_fmadd_ps(p,f,_mm512_set1_ps(c[k]));
+
+    __m512 y = _mm512_mul_ps(_mm512_mul_ps(p,f),z);
+    y = _mm512_fmadd_ps(e,_mm512_set1_ps(cLn2Lo),y);
+    y = _mm512_fnmadd_ps(z,_mm512_set1_ps(0.5f),y);
+
+    return _mm512_fmadd_ps(e,_mm512_set1_ps(cLn2Hi),_mm512_add_ps(f,y));
+}
+
+template <int NP>
+KIPL_TARGET("avx512f") inline __m512 expAVX512(__m512 x, const float *c)
+{
+    x = _mm512_min_ps(_mm512_max_ps(x,_mm512_set1_ps(cExpMin)),_mm512_set1_ps(cExpMax));
+
+    const __m512i n  = _mm512_cvtps_epi32(_mm512_mul_ps(x,_mm512_set1_ps(cLog2e)));
+    const __m512  fn = _mm512_cvtepi32_ps(n);
+    const __m512  r  = _mm512_fnmadd_ps(fn,_mm512_set1_ps(cLn2Lo),_mm512_fnmadd_ps(fn,_mm512_set1_ps(cLn2Hi),x));
+    const __m512  z  = _mm512_mul_ps(r,r);
+
+    __m512 p = _mm512_set1_ps(c[0]);
+    for (int k=1; k<NP; ++k)
+        p = _mm512_fmadd_ps(p,r,_mm512_set1_ps(c[k]));
+
+    __m512 y = _mm512_add_ps(_mm512_fmadd_ps(p,z,r),_mm512_set1_ps(1.0f));
+
+    const __m512i n1 = _mm512_srai_epi32(n,1);
+    const __m512i n2 = _mm512_sub_epi32(n,n1);
+    const __m512i bias = _mm512_set1_epi32(127);
+    y = _mm512_mul_ps(y,_mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(n1,bias),23)));
+    return _mm512_mul_ps(y,_mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(n2,bias),23)));
+}
+
+template <int NP>
+KIPL_TARGET("avx512f") void logArrayAVX512(const float *src, float *dst, size_t N, const float *c, float minValue)
+{
+    const __m512 vMin=_mm512_set1_ps(minValue);
+    size_t i=0;
+    for (; i+16<=N; i+=16)
+        _mm512_storeu_ps(dst+i,logAVX512<NP>(_mm512_loadu_ps(src+i),c,vMin));
+
+    if (i<N) {
+        const __mmask16 mask = static_cast<__mmask16>((1u<<(N-i))-1u);
+        const __m512 x = _mm512_mask_loadu_ps(_mm512_set1_ps(1.0f),mask,src+i);
+        _mm512_mask_storeu_ps(dst+i,mask,logAVX512<NP>(x,c,vMin));
+    }
+}
+
+template <int NP>
+KIPL_TARGET("avx512f") void expArrayAVX512(const float *src, float *dst, size_t N, const float *c)
+{
+    size_t i=0;
+    for (; i+16<=N; i+=16)
+        _mm512_storeu_ps(dst+i,expAVX512<NP>(_mm512_loadu_ps(src+i),c));
+
+    if (i<N) {
+        const __mmask16 mask = static_cast<__mmask16>((1u<<(N-i))-1u);
+        const __m512 x = _mm512_mask_loadu_ps(_mm512_setzero_ps(),mask,src+i);
+        _mm512_mask_storeu_ps(dst+i,mask,expAVX512<NP>(x,c));
+    }
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+kipl::math::eSIMDInstructionSet detectInstructionSet()
+{
+#ifdef KIPL_FASTMATH_X86
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return kipl::math::SIMDAVX512;
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return kipl::math::SIMDAVX2;
+
+    return kipl::math::SIMDSSE2;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info,0);
+    const int nIds=info[0];
+
+    __cpuid(info,1);
+    const bool bFMA     = (info[2] & (1<<12))!=0;
+    const bool bOSXSave = (info[2] & (1<<27))!=0;
+    if (!bOSXSave || (nIds<7))
+        return kipl::math::SIMDSSE2;
+
+    // The operating system must save the AVX and AVX-512 registers
+    const unsigned long long xcr0=_xgetbv(0);
+    __cpuidex(info,7,0);
+    const bool bAVX2    = (info[1] & (1<<5))!=0;
+    const bool bAVX512F = (info[1] & (1<<16))!=0;
+
+    if (bAVX512F && ((xcr0 & 0xe6)==0xe6))
+        return kipl::math::SIMDAVX512;
+
+    if (bAVX2 && bFMA && ((xcr0 & 0x6)==0x6))
+        return kipl::math::SIMDAVX2;
+
+    return kipl::math::SIMDSSE2;
+#else
+    return kipl::math::SIMDSSE2;
+#endif
+#else
+    return kipl::math::SIMDScalar;
+#endif
+}
+
+std::atomic<int> & currentInstructionSet()
+{
+    static std::atomic<int> set(static_cast<int>(kipl::math::supportedSIMDInstructionSet()));
+
+    return set;
+}
+
+}
+
+namespace kipl { namespace math {
+
+eSIMDInstructionSet supportedSIMDInstructionSet()
+{
+    static const eSIMDInstructionSet supported=detectInstructionSet();
+
+    return supported;
+}
+
+eSIMDInstructionSet simdInstructionSet()
+{
+    return static_cast<eSIMDInstructionSet>(currentInstructionSet().load());
+}
+
+eSIMDInstructionSet setSIMDInstructionSet(eSIMDInstructionSet set)
+{
+    const eSIMDInstructionSet selected = std::min(set,supportedSIMDInstructionSet());
+    currentInstructionSet()=static_cast<int>(selected);
+
+    return selected;
+}
+
+void logArray(const float *src, float *dst, size_t N, eMathAccuracy accuracy, float minValue)
+{
+    minValue = std::max(minValue,FLT_MIN); // NaN is also replaced
+
+    const eSIMDInstructionSet set = simdInstructionSet();
+    if ((accuracy==ExactMath) || (set==SIMDScalar)) {
+        for (size_t i=0; i<N; ++i) {
+            const float x=src[i];
+            dst[i]=std::log(x<minValue || x!=x ? minValue : std::min(x,FLT_MAX));
+        }
+        return;
+    }
+
+#ifdef KIPL_FASTMATH_X86
+    const bool bFast = accuracy==FastMath;
+    switch (set) {
+    case SIMDAVX512:
+        if (bFast) logArrayAVX512<4>(src,dst,N,logFast,minValue);
+        else       logArrayAVX512<9>(src,dst,N,logPrecise,minValue);
+        break;
+    case SIMDAVX2:
+        if (bFast) logArrayAVX2<4>(src,dst,N,logFast,minValue);
+        else       logArrayAVX2<9>(src,dst,N,logPrecise,minValue);
+        break;
+    default:
+        if (bFast) logArraySSE2<4>(src,dst,N,logFast,minValue);
+        else       logArraySSE2<9>(src,dst,N,logPrecise,minValue);
+        break;
+    }
+#endif
+}
+
+void expArray(const float *src, float *dst, size_t N, eMathAccuracy accuracy)
+{
+    const eSIMDInstructionSet set = simdInstructionSet();
+    if ((accuracy==ExactMath) || (set==SIMDScalar)) {
+        for (size_t i=0; i<N; ++i) {
+            const float x=src[i];
+            dst[i]=std::exp(x<cExpMin || x!=x ? cExpMin : std::min(x,cExpMax));
+        }
+        return;
+    }
+
+#ifdef KIPL_FASTMATH_X86
+    const bool bFast = accuracy==FastMath;
+    switch (set) {
+    case SIMDAVX512:
+        if (bFast) expArrayAVX512<3>(src,dst,N,expFast);
+        else       expArrayAVX512<6>(src,dst,N,expPrecise);
+        break;
+    case SIMDAVX2:
+        if (bFast) expArrayAVX2<3>(src,dst,N,expFast);
+        else       expArrayAVX2<6>(src,dst,N,expPrecise);
+        break;
+    default:
+        if (bFast) expArraySSE2<3>(src,dst,N,expFast);
+        else       expArraySSE2<6>(src,dst,N,expPrecise);
+        break;
+    }
+#endif
+}
+
+}}
+
+void string2enum(const std::string &str, kipl::math::eMathAccuracy &accuracy)
+{
+    if      (str=="exact")   accuracy=kipl::math::ExactMath;
+    else if (str=="precise") accuracy=kipl::math::PreciseMath;
+    else if (str=="fast")    accuracy=kipl::math::FastMath;
+    else throw kipl::base::KiplException("Unknown math accuracy "+str,__FILE__,__LINE__);
+}
+
+std::string enum2string(kipl::math::eMathAccuracy accuracy)
+{
+    switch (accuracy) {
+    case kipl::math::ExactMath:   return "exact";
+    case kipl::math::PreciseMath: return "precise";
+    case kipl::math::FastMath:    return "fast";
+    }
+
+    throw kipl::base::KiplException("Unknown math accuracy",__FILE__,__LINE__);
+}
+
+std::ostream & operator<<(std::ostream &s, kipl::math::eMathAccuracy accuracy)
+{
+    s<<enum2string(accuracy);
+
+    return s;
+}
+
+void string2enum(const std::string &str, kipl::math::eSIMDInstructionSet &set)
+{
+    if      (str=="scalar") set=kipl::math::SIMDScalar;
+    else if (str=="sse2")   set=kipl::math::SIMDSSE2;
+    else if (str=="avx2")   set=kipl::math::SIMDAVX2;
+    else if (str=="avx512") set=kipl::math::SIMDAVX512;
+    else throw kipl::base::KiplException("Unknown instruction set "+str,__FILE__,__LINE__);
+}
+
+std::string enum2string(kipl::math::eSIMDInstructionSet set)
+{
+    switch (set) {
+    case kipl::math::SIMDScalar: return "scalar";
+    case kipl::math::SIMDSSE2:   return "sse2";
+    case kipl::math::SIMDAVX2:   return "avx2";
+    case kipl::math::SIMDAVX512: return "avx512";
+    }
+
+    throw kipl::base::KiplException("Unknown instruction set",__FILE__,__LINE__);
+}
+
+std::ostream & operator<<(std::ostream &s, kipl::math::eSIMDInstructionSet set)
+{
+    s<<enum2string(set);
+
+    return s;
+}
@@ -33,6 +33,15 @@ KIPLSHARED_EXPORT Statistics::Statistics(const Statistics & s) :
 {
 }
 
+KIPLSHARED_EXPORT Statistics::Statistics(size_t n, double sum, double sum2, double minval, double maxval) :
+			m_fMax(maxval),
+			m_fMin(minval),
+			m_fSum2(sum2),
+			m_fSum(sum),
+			m_nNdata(n)
+{
+}
+
 Statistics & Statistics::operator=(const Statistics &s)
 {
     m_fMax   = s.m_fMax;
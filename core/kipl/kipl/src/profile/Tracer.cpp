@@ -0,0 +1,289 @@
+//<LICENCE>
+
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+
+#include "../../include/profile/Tracer.h"
+#include "../../include/base/KiplException.h"
+
+namespace kipl { namespace profile {
+
+namespace {
+/// \brief Writes a string with JSON escaping
+void writeJSONString(std::ostream &os, const char *str)
+{
+    os<<'"';
+    for (const char *p=str; *p!='\0'; ++p) {
+        switch (*p) {
+        case '"'  : os<<"\\\""; break;
+        case '\\' : os<<"\\\\"; break;
+        case '\n' : os<<"\\n"; break;
+        case '\t' : os<<"\\t"; break;
+        default :
+            if (static_cast<unsigned char>(*p)<0x20)
+                os<<' ';
+            else
+                os<<*p;
+        }
+    }
+    os<<'"';
+}
+}
+
+Tracer & Tracer::instance()
+{
+    static Tracer tracer;
+
+    return tracer;
+}
+
+Tracer::Tracer() :
+    m_bEnabled(false),
+    m_Epoch(std::chrono::steady_clock::now())
+{
+}
+
+void Tracer::setEnabled(bool enable)
+{
+    m_bEnabled.store(enable,std::memory_order_relaxed);
+}
+
+void Tracer::clear()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // The buffers are kept since the threads hold pointers to them.
+    for (auto &buffer : m_Buffers)
+        buffer->events.clear();
+
+    m_Epoch=std::chrono::steady_clock::now();
+}
+
+const char * Tracer::intern(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_Names.insert(name).first->c_str();
+}
+
+Tracer::ThreadBuffer & Tracer::threadBuffer()
+{
+    thread_local ThreadBuffer *buffer=nullptr;
+
+    if (buffer==nullptr) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Buffers.emplace_back(new ThreadBuffer);
+        buffer=m_Buffers.back().get();
+        buffer->tid=static_cast<int>(m_Buffers.size());
+        buffer->events.reserve(1024);
+    }
+
+    return *buffer;
+}
+
+long long Tracer::toMicroSeconds(std::chrono::steady_clock::time_point t) const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(t-m_Epoch).count();
+}
+
+void Tracer::addSpan(const char *name, const char *category,
+                     std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point stop)
+{
+    TraceEvent event;
+    event.name     = name;
+    event.category = category;
+    event.type     = TraceEvent::Span;
+    event.start    = toMicroSeconds(start);
+    event.duration = std::chrono::duration_cast<std::chrono::microseconds>(stop-start).count();
+    event.value    = 0.0;
+
+    threadBuffer().events.push_back(event);
+}
+
+void Tracer::addCounter(const char *name, double value, const char *category)
+{
+    if (!isEnabled())
+        return;
+
+    TraceEvent event;
+    event.name     = name;
+    event.category = category;
+    event.type     = TraceEvent::Counter;
+    event.start    = toMicroSeconds(std::chrono::steady_clock::now());
+    event.duration = 0;
+    event.value    = value;
+
+    threadBuffer().events.push_back(event);
+}
+
+size_t Tracer::eventCount()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    size_t cnt=0;
+    for (auto &buffer : m_Buffers)
+        cnt+=buffer->events.size();
+
+    return cnt;
+}
+
+void Tracer::writeChromeTrace(std::ostream &os)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    os<<"{\"traceEvents\":[\n";
+    bool first=true;
+    for (auto &buffer : m_Buffers) {
+        for (auto &event : buffer->events) {
+            if (!first)
+                os<<",\n";
+            first=false;
+
+            os<<"{\"name\":";
+            writeJSONString(os,event.name);
+            os<<",\"cat\":";
+            writeJSONString(os,event.category);
+            os<<",\"pid\":1,\"tid\":"<<buffer->tid<<",\"ts\":"<<event.start;
+            if (event.type==TraceEvent::Span)
+                os<<",\"ph\":\"X\",\"dur\":"<<event.duration<<"}";
+            else
+                os<<",\"ph\":\"C\",\"args\":{\"value\":"<<event.value<<"}}";
+        }
+    }
+    os<<"\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void Tracer::writeChromeTrace(const std::string &fname)
+{
+    std::ofstream fout(fname.c_str());
+
+    if (!fout.good())
+        throw kipl::base::KiplException("Failed to open trace file "+fname,__FILE__,__LINE__);
+
+    writeChromeTrace(fout);
+}
+
+std::string Tracer::summary()
+{
+    struct SpanStats {
+        SpanStats() : count(0), total(0), maximum(0), threads() {}
+        size_t count;
+        long long total;
+        long long maximum;
+        std::set<int> threads;
+    };
+
+    std::map<std::string,SpanStats> spans;
+    std::map<std::string,std::pair<size_t,double>> counters;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (auto &buffer : m_Buffers) {
+            for (auto &event : buffer->events) {
+                std::string key=std::string(event.category)+"/"+event.name;
+                if (event.type==TraceEvent::Span) {
+                    SpanStats &stats=spans[key];
+                    stats.count++;
+                    stats.total+=event.duration;
+                    stats.maximum=std::max(stats.maximum,event.duration);
+                    stats.threads.insert(buffer->tid);
+                }
+                else {
+                    auto &counter=counters[key];
+                    counter.first++;
+                    counter.second+=event.value;
+                }
+            }
+        }
+    }
+
+    std::vector<std::pair<std::string,SpanStats>> sorted(spans.begin(),spans.end());
+    std::sort(sorted.begin(),sorted.end(),
+              [](const std::pair<std::string,SpanStats> &a, const std::pair<std::string,SpanStats> &b)
+                {return b.second.total<a.second.total;});
+
+    std::ostringstream str;
+    str<<std::left<<std::setw(48)<<"Span"<<std::right
+       <<std::setw(10)<<"Count"
+       <<std::setw(8)<<"Thrds"
+       <<std::setw(14)<<"Total [ms]"
+       <<std::setw(12)<<"Mean [ms]"
+       <<std::setw(12)<<"Max [ms]"<<"\n";
+    str<<std::fixed<<std::setprecision(3);
+    for (auto &item : sorted) {
+        const SpanStats &stats=item.second;
+        str<<std::left<<std::setw(48)<<item.first<<std::right
+           <<std::setw(10)<<stats.count
+           <<std::setw(8)<<stats.threads.size()
+           <<std::setw(14)<<stats.total*1e-3
+           <<std::setw(12)<<stats.total*1e-3/stats.count
+           <<std::setw(12)<<stats.maximum*1e-3<<"\n";
+    }
+
+    if (!counters.empty()) {
+        str<<"\n"<<std::left<<std::setw(48)<<"Counter"<<std::right<<std::setw(10)<<"Count"<<std::setw(22)<<"Sum"<<"\n";
+        for (auto &item : counters)
+            str<<std::left<<std::setw(48)<<item.first<<std::right
+               <<std::setw(10)<<item.second.first
+               <<std::setw(22)<<item.second.second<<"\n";
+    }
+
+    return str.str();
+}
+
+ScopedSpan::ScopedSpan(const char *name, const char *category) :
+    m_sName(name),
+    m_sCategory(category),
+    m_bActive(Tracer::instance().isEnabled())
+{
+    if (m_bActive)
+        m_Start=std::chrono::steady_clock::now();
+}
+
+ScopedSpan::ScopedSpan(const std::string &name, const char *category) :
+    m_sName(nullptr),
+    m_sCategory(category),
+    m_bActive(Tracer::instance().isEnabled())
+{
+    if (m_bActive) {
+        m_sName=Tracer::instance().intern(name);
+        m_Start=std::chrono::steady_clock::now();
+    }
+}
+
+ScopedSpan::~ScopedSpan()
+{
+    if (m_bActive)
+        Tracer::instance().addSpan(m_sName,m_sCategory,m_Start,std::chrono::steady_clock::now());
+}
+
+ScopedTracing::ScopedTracing(bool enable) :
+    m_bActive(enable)
+{
+    if (m_bActive)
+    {
+        Tracer &tracer=Tracer::instance();
+        tracer.clear();
+        tracer.setEnabled(true);
+    }
+}
+
+ScopedTracing::~ScopedTracing()
+{
+    stop();
+}
+
+void ScopedTracing::stop()
+{
+    if (m_bActive)
+    {
+        Tracer::instance().setEnabled(false);
+        m_bActive=false;
+    }
+}
+
+}}
@@ -0,0 +1,226 @@
+//<LICENCE>
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KIPL_ISS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define KIPL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KIPL_TARGET(isa)
+#endif
+
+#include "../../include/scalespace/isskernels.h"
+#include "../../include/math/fastmath.h"
+
+namespace {
+
+inline void gradientPixel(const float *u, const float *uy, const float *uz, float *dx, float *dy, float *dz, size_t x)
+{
+    const float gx = u[x]-(x==0 ? u[1] : u[x-1]);
+    const float gy = u[x]-uy[x];
+    const float gz = u[x]-uz[x];
+
+    const float sum2  = gx*gx+gy*gy+gz*gz;
+    const float scale = sum2!=0.0f ? 1.0f/std::sqrt(sum2) : 0.0f;
+    dx[x]=gx*scale;
+    dy[x]=gy*scale;
+    dz[x]=gz*scale;
+}
+
+inline float updatePixel(float *u, float *v, const float *f, const float *dx, const float *dy0, const float *dy1, const float *dz0, const float *dz1,
+                         size_t x, size_t N, float tau, float lambda, float tauAlpha)
+{
+    const float d2x = x+1<N ? dx[x+1]-dx[x] : dx[x-1]-dx[x];
+    const float p   = d2x+(dy1[x]-dy0[x])+(dz1[x]-dz0[x]);
+    const float fu  = f[x]-u[x];
+
+    u[x]+=tau*(p+lambda*(fu+v[x]));
+    v[x]+=tauAlpha*fu;
+
+    return fu*fu;
+}
+
+#ifdef KIPL_ISS_X86
+// ---- SSE2 ----
+
+// The estimate of rsqrt has 12 bits, one Newton-Raphson step gives almost full single precision.
+// Lanes with zero gradient are cleared, the infinite estimate would otherwise give NaN.
+inline __m128 invNormSSE2(__m128 sum2)
+{
+    const __m128 y = _mm_rsqrt_ps(sum2);
+    const __m128 r = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f),y),
+                                _mm_sub_ps(_mm_set1_ps(3.0f),_mm_mul_ps(_mm_mul_ps(sum2,y),y)));
+
+    return _mm_and_ps(r,_mm_cmpgt_ps(sum2,_mm_setzero_ps()));
+}
+
+void gradientRowSSE2(const float *u, const float *uy, const float *uz, float *dx, float *dy, float *dz, size_t N)
+{
+    gradientPixel(u,uy,uz,dx,dy,dz,0);
+
+    size_t x=1;
+    for (; x+4<=N; x+=4) {
+        const __m128 c  = _mm_loadu_ps(u+x);
+        const __m128 gx = _mm_sub_ps(c,_mm_loadu_ps(u+x-1));
+        const __m128 gy = _mm_sub_ps(c,_mm_loadu_ps(uy+x));
+        const __m128 gz = _mm_sub_ps(c,_mm_loadu_ps(uz+x));
+
+        const __m128 s  = invNormSSE2(_mm_add_ps(_mm_add_ps(_mm_mul_ps(gx,gx),_mm_mul_ps(gy,gy)),_mm_mul_ps(gz,gz)));
+        _mm_storeu_ps(dx+x,_mm_mul_ps(gx,s));
+        _mm_storeu_ps(dy+x,_mm_mul_ps(gy,s));
+        _mm_storeu_ps(dz+x,_mm_mul_ps(gz,s));
+    }
+
+    for (; x<N; ++x)
+        gradientPixel(u,uy,uz,dx,dy,dz,x);
+}
+
+double updateRowSSE2(float *u, float *v, const float *f, const float *dx, const float *dy0, const float *dy1, const float *dz0, const float *dz1,
+                     size_t N, float tau, float lambda, float tauAlpha)
+{
+    const __m128 xTau      = _mm_set1_ps(tau);
+    const __m128 xLambda   = _mm_set1_ps(lambda);
+    const __m128 xTauAlpha = _mm_set1_ps(tauAlpha);
+    __m128 xSum = _mm_setzero_ps();
+
+    size_t x=0;
+    for (; x+4<N; x+=4) { // The last pixel is mirrored and left to the scalar loop
+        const __m128 p = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_loadu_ps(dx+x+1),_mm_loadu_ps(dx+x)),
+                                               _mm_sub_ps(_mm_loadu_ps(dy1+x),_mm_loadu_ps(dy0+x))),
+                                    _mm_sub_ps(_mm_loadu_ps(dz1+x),_mm_loadu_ps(dz0+x)));
+
+        const __m128 xu = _mm_loadu_ps(u+x);
+        const __m128 xv = _mm_loadu_ps(v+x);
+        const __m128 fu = _mm_sub_ps(_mm_loadu_ps(f+x),xu);
+
+        xSum = _mm_add_ps(xSum,_mm_mul_ps(fu,fu));
+        _mm_storeu_ps(u+x,_mm_add_ps(xu,_mm_mul_ps(xTau,_mm_add_ps(p,_mm_mul_ps(xLambda,_mm_add_ps(fu,xv))))));
+        _mm_storeu_ps(v+x,_mm_add_ps(xv,_mm_mul_ps(xTauAlpha,fu)));
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes,xSum);
+    double sum2=(static_cast<double>(lanes[0])+lanes[1])+(static_cast<double>(lanes[2])+lanes[3]);
+
+    for (; x<N; ++x)
+        sum2+=updatePixel(u,v,f,dx,dy0,dy1,dz0,dz1,x,N,tau,lambda,tauAlpha);
+
+    return sum2;
+}
+
+// ---- AVX2 with FMA ----
+KIPL_TARGET("avx2,fma") inline __m256 invNormAVX2(__m256 sum2)
+{
+    const __m256 y = _mm256_rsqrt_ps(sum2);
+    const __m256 r = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f),y),
+                                   _mm256_fnmadd_ps(_mm256_mul_ps(sum2,y),y,_mm256_set1_ps(3.0f)));
+
+    return _mm256_and_ps(r,_mm256_cmp_ps(sum2,_mm256_setzero_ps(),_CMP_GT_OQ));
+}
+
+KIPL_TARGET("avx2,fma") void gradientRowAVX2(const float *u, const float *uy, const float *uz, float *dx, float *dy, float *dz, size_t N)
+{
+    gradientPixel(u,uy,uz,dx,dy,dz,0);
+
+    size_t x=1;
+    for (; x+8<=N; x+=8) {
+        const __m256 c  = _mm256_loadu_ps(u+x);
+        const __m256 gx = _mm256_sub_ps(c,_mm256_loadu_ps(u+x-1));
+        const __m256 gy = _mm256_sub_ps(c,_mm256_loadu_ps(uy+x));
+        const __m256 gz = _mm256_sub_ps(c,_mm256_loadu_ps(uz+x));
+
+        const __m256 s  = invNormAVX2(_mm256_fmadd_ps(gz,gz,_mm256_fmadd_ps(gy,gy,_mm256_mul_ps(gx,gx))));
+        _mm256_storeu_ps(dx+x,_mm256_mul_ps(gx,s));
+        _mm256_storeu_ps(dy+x,_mm256_mul_ps(gy,s));
+        _mm256_storeu_ps(dz+x,_mm256_mul_ps(gz,s));
+    }
+
+    for (; x<N; ++x)
+        gradientPixel(u,uy,uz,dx,dy,dz,x);
+}
+
+KIPL_TARGET("avx2,fma") double updateRowAVX2(float *u, float *v, const float *f, const float *dx, const float *dy0, const float *dy1,
+                                              const float *dz0, const float *dz1, size_t N, float tau, float lambda, float tauAlpha)
+{
+    const __m256 xTau      = _mm256_set1_ps(tau);
+    const __m256 xLambda   = _mm256_set1_ps(lambda);
+    const __m256 xTauAlpha = _mm256_set1_ps(tauAlpha);
+    __m256 xSum = _mm256_setzero_ps();
+
+    size_t x=0;
+    for (; x+8<N; x+=8) { // The last pixel is mirrored and left to the scalar loop
+        const __m256 p = _mm256_add_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_loadu_ps(dx+x+1),_mm256_loadu_ps(dx+x)),
+                                                     _mm256_sub_ps(_mm256_loadu_ps(dy1+x),_mm256_loadu_ps(dy0+x))),
+                                       _mm256_sub_ps(_mm256_loadu_ps(dz1+x),_mm256_loadu_ps(dz0+x)));
+
+        const __m256 xu = _mm256_loadu_ps(u+x);
+        const __m256 xv = _mm256_loadu_ps(v+x);
+        const __m256 fu = _mm256_sub_ps(_mm256_loadu_ps(f+x),xu);
+
+        xSum = _mm256_fmadd_ps(fu,fu,xSum);
+        _mm256_storeu_ps(u+x,_mm256_fmadd_ps(xTau,_mm256_fmadd_ps(xLambda,_mm256_add_ps(fu,xv),p),xu));
+        _mm256_storeu_ps(v+x,_mm256_fmadd_ps(xTauAlpha,fu,xv));
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes,xSum);
+    double sum2=0.0;
+    for (int i=0; i<8; ++i)
+        sum2+=lanes[i];
+
+    for (; x<N; ++x)
+        sum2+=updatePixel(u,v,f,dx,dy0,dy1,dz0,dz1,x,N,tau,lambda,tauAlpha);
+
+    return sum2;
+}
+#endif
+
+}
+
+namespace akipl { namespace scalespace {
+
+void issGradientRow(const float *u, const float *uy, const float *uz, float *dx, float *dy, float *dz, size_t N)
+{
+#ifdef KIPL_ISS_X86
+    switch (kipl::math::simdInstructionSet()) {
+    case kipl::math::SIMDScalar:
+        break;
+    case kipl::math::SIMDSSE2:
+        gradientRowSSE2(u,uy,uz,dx,dy,dz,N);
+        return;
+    default:
+        gradientRowAVX2(u,uy,uz,dx,dy,dz,N);
+        return;
+    }
+#endif
+
+    for (size_t x=0; x<N; ++x)
+        gradientPixel(u,uy,uz,dx,dy,dz,x);
+}
+
+double issUpdateRow(float *u, float *v, const float *f, const float *dx, const float *dy0, const float *dy1,
+                    const float *dz0, const float *dz1, size_t N, float tau, float lambda, float tauAlpha)
+{
+#ifdef KIPL_ISS_X86
+    switch (kipl::math::simdInstructionSet()) {
+    case kipl::math::SIMDScalar:
+        break;
+    case kipl::math::SIMDSSE2:
+        return updateRowSSE2(u,v,f,dx,dy0,dy1,dz0,dz1,N,tau,lambda,tauAlpha);
+    default:
+        return updateRowAVX2(u,v,f,dx,dy0,dy1,dz0,dz1,N,tau,lambda,tauAlpha);
+    }
+#endif
+
+    double sum2=0.0;
+    for (size_t x=0; x<N; ++x)
+        sum2+=updatePixel(u,v,f,dx,dy0,dy1,dz0,dz1,x,N,tau,lambda,tauAlpha);
+
+    return sum2;
+}
+
+}}
@@ -0,0 +1,523 @@
+//<LICENCE>
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KIPL_FUZZY_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define KIPL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KIPL_TARGET(isa)
+#endif
+
+#include "../../include/segmentation/fuzzymembership.h"
+#include "../../include/math/fastmath.h"
+#include "../../include/base/KiplException.h"
+
+namespace {
+
+/// Smallest distance, a pixel on a center gets almost all membership of that class without dividing by zero
+const float cFuzzyMinDistance = 1e-30f;
+
+/// The element-wise loops over a block, there is one set for each instruction set
+struct FuzzyKernels {
+    void  (*distances)(const float *x, size_t n, float c, float scale, float lo, float *d); ///< d=max(scale*(x-c)^2,lo)
+    void  (*affine)(const float *src, size_t n, float a, float b, float lo, float *dst);   ///< dst=max(a*src+b,lo)
+    void  (*invert)(float *u, size_t n);                                                  ///< u=1/u
+    void  (*multiply)(const float *a, const float *b, size_t n, float *dst);              ///< dst=a*b
+    void  (*subtract)(float *u, size_t n, const float *s);                                ///< u-=s
+    void  (*addTo)(const float *u, size_t n, float *s);                                   ///< s+=u
+    void  (*maxTo)(const float *u, size_t n, float *s);                                   ///< s=max(s,u)
+    void  (*weightedSums)(const float *w, const float *x, size_t n, float &sw, float &swx); ///< sw+=sum(w), swx+=sum(w*x)
+    float (*squaredDifference)(const float *a, const float *b, size_t n);                 ///< sum((a-b)^2)
+};
+
+// ---- Scalar, also used for the remaining elements of the vector kernels ----
+void distancesScalar(const float *x, size_t n, float c, float scale, float lo, float *d)
+{
+    for (size_t i=0; i<n; ++i)
+        d[i]=std::max(scale*(x[i]-c)*(x[i]-c),lo);
+}
+
+void affineScalar(const float *src, size_t n, float a, float b, float lo, float *dst)
+{
+    for (size_t i=0; i<n; ++i)
+        dst[i]=std::max(a*src[i]+b,lo);
+}
+
+void invertScalar(float *u, size_t n)
+{
+    for (size_t i=0; i<n; ++i)
+        u[i]=1.0f/u[i];
+}
+
+void multiplyScalar(const float *a, const float *b, size_t n, float *dst)
+{
+    for (size_t i=0; i<n; ++i)
+        dst[i]=a[i]*b[i];
+}
+
+void subtractScalar(float *u, size_t n, const float *s)
+{
+    for (size_t i=0; i<n; ++i)
+        u[i]-=s[i];
+}
+
+void addToScalar(const float *u, size_t n, float *s)
+{
+    for (size_t i=0; i<n; ++i)
+        s[i]+=u[i];
+}
+
+void maxToScalar(const float *u, size_t n, float *s)
+{
+    for (size_t i=0; i<n; ++i)
+        s[i]=std::max(s[i],u[i]);
+}
+
+void weightedSumsScalar(const float *w, const float *x, size_t n, float &sw, float &swx)
+{
+    for (size_t i=0; i<n; ++i) {
+        sw+=w[i];
+        swx+=w[i]*x[i];
+    }
+}
+
+float squaredDifferenceScalar(const float *a, const float *b, size_t n)
+{
+    float sum=0.0f;
+    for (size_t i=0; i<n; ++i)
+        sum+=(a[i]-b[i])*(a[i]-b[i]);
+
+    return sum;
+}
+
+#ifdef KIPL_FUZZY_X86
+// ---- SSE2 ----
+float horizontalSumSSE2(__m128 v)
+{
+    float lanes[4];
+    _mm_storeu_ps(lanes,v);
+
+    return (lanes[0]+lanes[1])+(lanes[2]+lanes[3]);
+}
+
+void distancesSSE2(const float *x, size_t n, float c, float scale, float lo, float *d)
+{
+    const __m128 xc=_mm_set1_ps(c);
+    const __m128 xScale=_mm_set1_ps(scale);
+    const __m128 xLo=_mm_set1_ps(lo);
+
+    size_t i=0;
+    for (; i+4<=n; i+=4) {
+        const __m128 t=_mm_sub_ps(_mm_loadu_ps(x+i),xc);
+        _mm_storeu_ps(d+i,_mm_max_ps(_mm_mul_ps(xScale,_mm_mul_ps(t,t)),xLo));
+    }
+    distancesScalar(x+i,n-i,c,scale,lo,d+i);
+}
+
+void affineSSE2(const float *src, size_t n, float a, float b, float lo, float *dst)
+{
+    const __m128 xa=_mm_set1_ps(a);
+    const __m128 xb=_mm_set1_ps(b);
+    const __m128 xLo=_mm_set1_ps(lo);
+
+    size_t i=0;
+    for (; i+4<=n; i+=4)
+        _mm_storeu_ps(dst+i,_mm_max_ps(_mm_add_ps(_mm_mul_ps(xa,_mm_loadu_ps(src+i)),xb),xLo));
+    affineScalar(src+i,n-i,a,b,lo,dst+i);
+}
+
+void invertSSE2(float *u, size_t n)
+{
+    const __m128 one=_mm_set1_ps(1.0f);
+
+    size_t i=0;
+    for (; i+4<=n; i+=4)
+        _mm_storeu_ps(u+i,_mm_div_ps(one,_mm_loadu_ps(u+i)));
+    invertScalar(u+i,n-i);
+}
+
+void multiplySSE2(const float *a, const float *b, size_t n, float *dst)
+{
+    size_t i=0;
+    for (; i+4<=n; i+=4)
+        _mm_storeu_ps(dst+i,_mm_mul_ps(_mm_loadu_ps(a+i),_mm_loadu_ps(b+i)));
+    multiplyScalar(a+i,b+i,n-i,dst+i);
+}
+
+void subtractSSE2(float *u, size_t n, const float *s)
+{
+    size_t i=0;
+    for (; i+4<=n; i+=4)
+        _mm_storeu_ps(u+i,_mm_sub_ps(_mm_loadu_ps(u+i),_mm_loadu_ps(s+i)));
+    subtractScalar(u+i,n-i,s+i);
+}
+
+void addToSSE2(const float *u, size_t n, float *s)
+{
+    size_t i=0;
+    for (; i+4<=n; i+=4)
+        _mm_storeu_ps(s+i,_mm_add_ps(_mm_loadu_ps(s+i),_mm_loadu_ps(u+i)));
+    addToScalar(u+i,n-i,s+i);
+}
+
+void maxToSSE2(const float *u, size_t n, float *s)
+{
+    size_t i=0;
+    for (; i+4<=n; i+=4)
+        _mm_storeu_ps(s+i,_mm_max_ps(_mm_loadu_ps(s+i),_mm_loadu_ps(u+i)));
+    maxToScalar(u+i,n-i,s+i);
+}
+
+void weightedSumsSSE2(const float *w, const float *x, size_t n, float &sw, float &swx)
+{
+    __m128 xSw=_mm_setzero_ps();
+    __m128 xSwx=_mm_setzero_ps();
+
+    size_t i=0;
+    for (; i+4<=n; i+=4) {
+        const __m128 xw=_mm_loadu_ps(w+i);
+        xSw=_mm_add_ps(xSw,xw);
+        xSwx=_mm_add_ps(xSwx,_mm_mul_ps(xw,_mm_loadu_ps(x+i)));
+    }
+    sw+=horizontalSumSSE2(xSw);
+    swx+=horizontalSumSSE2(xSwx);
+    weightedSumsScalar(w+i,x+i,n-i,sw,swx);
+}
+
+float squaredDifferenceSSE2(const float *a, const float *b, size_t n)
+{
+    __m128 xSum=_mm_setzero_ps();
+
+    size_t i=0;
+    for (; i+4<=n; i+=4) {
+        const __m128 d=_mm_sub_ps(_mm_loadu_ps(a+i),_mm_loadu_ps(b+i));
+        xSum=_mm_add_ps(xSum,_mm_mul_ps(d,d));
+    }
+
+    return horizontalSumSSE2(xSum)+squaredDifferenceScalar(a+i,b+i,n-i);
+}
+
+// ---- AVX2 with FMA ----
+KIPL_TARGET("avx2,fma") float horizontalSumAVX2(__m256 v)
+{
+    return horizontalSumSSE2(_mm_add_ps(_mm256_castps256_ps128(v),_mm256_extractf128_ps(v,1)));
+}
+
+KIPL_TARGET("avx2,fma") void distancesAVX2(const float *x, size_t n, float c, float scale, float lo, float *d)
+{
+    const __m256 xc=_mm256_set1_ps(c);
+    const __m256 xScale=_mm256_set1_ps(scale);
+    const __m256 xLo=_mm256_set1_ps(lo);
+
+    size_t i=0;
+    for (; i+8<=n; i+=8) {
+        const __m256 t=_mm256_sub_ps(_mm256_loadu_ps(x+i),xc);
+        _mm256_storeu_ps(d+i,_mm256_max_ps(_mm256_mul_ps(xScale,_mm256_mul_ps(t,t)),xLo));
+    }
+    distancesScalar(x+i,n-i,c,scale,lo,d+i);
+}
+
+KIPL_TARGET("avx2,fma") void affineAVX2(const float *src, size_t n, float a, float b, float lo, float *dst)
+{
+    const __m256 xa=_mm256_set1_ps(a);
+    const __m256 xb=_mm256_set1_ps(b);
+    const __m256 xLo=_mm256_set1_ps(lo);
+
+    size_t i=0;
+    for (; i+8<=n; i+=8)
+        _mm256_storeu_ps(dst+i,_mm256_max_ps(_mm256_fmadd_ps(xa,_mm256_loadu_ps(src+i),xb),xLo));
+    affineScalar(src+i,n-i,a,b,lo,dst+i);
+}
+
+KIPL_TARGET("avx2,fma") void invertAVX2(float *u, size_t n)
+{
+    const __m256 one=_mm256_set1_ps(1.0f);
+
+    size_t i=0;
+    for (; i+8<=n; i+=8)
+        _mm256_storeu_ps(u+i,_mm256_div_ps(one,_mm256_loadu_ps(u+i)));
+    invertScalar(u+i,n-i);
+}
+
+KIPL_TARGET("avx2,fma") void multiplyAVX2(const float *a, const float *b, size_t n, float *dst)
+{
+    size_t i=0;
+    for (; i+8<=n; i+=8)
+        _mm256_storeu_ps(dst+i,_mm256_mul_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i)));
+    multiplyScalar(a+i,b+i,n-i,dst+i);
+}
+
+KIPL_TARGET("avx2,fma") void subtractAVX2(float *u, size_t n, const float *s)
+{
+    size_t i=0;
+    for (; i+8<=n; i+=8)
+        _mm256_storeu_ps(u+i,_mm256_sub_ps(_mm256_loadu_ps(u+i),_mm256_loadu_ps(s+i)));
+    subtractScalar(u+i,n-i,s+i);
+}
+
+KIPL_TARGET("avx2,fma") void addToAVX2(const float *u, size_t n, float *s)
+{
+    size_t i=0;
+    for (; i+8<=n; i+=8)
+        _mm256_storeu_ps(s+i,_mm256_add_ps(_mm256_loadu_ps(s+i),_mm256_loadu_ps(u+i)));
+    addToScalar(u+i,n-i,s+i);
+}
+
+KIPL_TARGET("avx2,fma") void maxToAVX2(const float *u, size_t n, float *s)
+{
+    size_t i=0;
+    for (; i+8<=n; i+=8)
+        _mm256_storeu_ps(s+i,_mm256_max_ps(_mm256_loadu_ps(s+i),_mm256_loadu_ps(u+i)));
+    maxToScalar(u+i,n-i,s+i);
+}
+
+KIPL_TARGET("avx2,fma") void weightedSumsAVX2(const float *w, const float *x, size_t n, float &sw, float &swx)
+{
+    __m256 xSw=_mm256_setzero_ps();
+    __m256 xSwx=_mm256_setzero_ps();
+
+    size_t i=0;
+    for (; i+8<=n; i+=8) {
+        const __m256 xw=_mm256_loadu_ps(w+i);
+        xSw=_mm256_add_ps(xSw,xw);
+        xSwx=_mm256_fmadd_ps(xw,_mm256_loadu_ps(x+i),xSwx);
+    }
+    sw+=horizontalSumAVX2(xSw);
+    swx+=horizontalSumAVX2(xSwx);
+    weightedSumsScalar(w+i,x+i,n-i,sw,swx);
+}
+
+KIPL_TARGET("avx2,fma") float squaredDifferenceAVX2(const float *a, const float *b, size_t n)
+{
+    __m256 xSum=_mm256_setzero_ps();
+
+    size_t i=0;
+    for (; i+8<=n; i+=8) {
+        const __m256 d=_mm256_sub_ps(_mm256_loadu_ps(a+i),_mm256_loadu_ps(b+i));
+        xSum=_mm256_fmadd_ps(d,d,xSum);
+    }
+
+    return horizontalSumAVX2(xSum)+squaredDifferenceScalar(a+i,b+i,n-i);
+}
+#endif
+
+/// \returns the kernels of the instruction set selected by kipl::math::simdInstructionSet(), AVX-512 uses the AVX2 kernels
+const FuzzyKernels & fuzzyKernels()
+{
+    static const FuzzyKernels scalar = {distancesScalar, affineScalar, invertScalar, multiplyScalar, subtractScalar,
+                                        addToScalar, maxToScalar, weightedSumsScalar, squaredDifferenceScalar};
+#ifdef KIPL_FUZZY_X86
+    static const FuzzyKernels sse2   = {distancesSSE2, affineSSE2, invertSSE2, multiplySSE2, subtractSSE2,
+                                        addToSSE2, maxToSSE2, weightedSumsSSE2, squaredDifferenceSSE2};
+    static const FuzzyKernels avx2   = {distancesAVX2, affineAVX2, invertAVX2, multiplyAVX2, subtractAVX2,
+                                        addToAVX2, maxToAVX2, weightedSumsAVX2, squaredDifferenceAVX2};
+
+    switch (kipl::math::simdInstructionSet()) {
+    case kipl::math::SIMDScalar:
+        break;
+    case kipl::math::SIMDSSE2:
+        return sse2;
+    default:
+        return avx2;
+    }
+#endif
+
+    return scalar;
+}
+
+}
+
+namespace kipl { namespace segmentation {
+
+FuzzyMembership::Sums::Sums(size_t nClasses) :
+    weight(nClasses,0.0),
+    weightedX(nClasses,0.0),
+    change(0.0),
+    count(0)
+{}
+
+void FuzzyMembership::Sums::merge(const Sums &s)
+{
+    for (size_t k=0; k<weight.size(); ++k) {
+        weight[k]+=s.weight[k];
+        weightedX[k]+=s.weightedX[k];
+    }
+    change+=s.change;
+    count+=s.count;
+}
+
+FuzzyMembership::Block::Block(size_t nClasses) :
+    u(nClasses*core::cFuzzyBlockSize),
+    w(nClasses*core::cFuzzyBlockSize),
+    s(core::cFuzzyBlockSize),
+    um(nClasses*core::cFuzzyBlockSize),
+    prev(nClasses*core::cFuzzyBlockSize)
+{}
+
+FuzzyMembership::FuzzyMembership(size_t nClasses, float fuzziness, eFuzzyDistance distance, float sigma) :
+    m_nClasses(nClasses),
+    m_fFuzziness(fuzziness),
+    m_fPower(1.0f),
+    m_eDistance(distance),
+    m_fSigma(sigma)
+{
+    if (nClasses<2)
+        throw kipl::base::KiplException("Fuzzy clustering needs at least two classes",__FILE__,__LINE__);
+
+    if (!(1.0f<fuzziness))
+        throw kipl::base::KiplException("The fuzziness must be larger than one",__FILE__,__LINE__);
+
+    if ((distance==FuzzyKernelDistance) && !(0.0f<sigma))
+        throw kipl::base::KiplException("The kernel width must be positive",__FILE__,__LINE__);
+
+    m_fPower=1.0f/(fuzziness-1.0f);
+}
+
+void FuzzyMembership::blockMemberships(const float *x, size_t n, const float *centers, float *u, Block &b, bool bPower) const
+{
+    const FuzzyKernels &kernels=fuzzyKernels();
+    const size_t NC=m_nClasses;
+    const float cLowest=std::numeric_limits<float>::lowest();
+    float *s=b.s.data();
+
+    // The distances are stored in u and transformed to memberships in place
+    if (m_eDistance==FuzzyKernelDistance) {
+        const float invSigma2=1.0f/(m_fSigma*m_fSigma);
+        float *w=b.w.data();
+        for (size_t k=0; k<NC; ++k)
+            kernels.distances(x,n,centers[k],-invSigma2,cLowest,w+k*n);
+        kipl::math::expArray(w,w,NC*n,kipl::math::PreciseMath);
+        kernels.affine(w,NC*n,-1.0f,1.0f,cFuzzyMinDistance,u);
+    }
+    else {
+        for (size_t k=0; k<NC; ++k)
+            kernels.distances(x,n,centers[k],1.0f,cFuzzyMinDistance,u+k*n);
+    }
+
+    if (m_fFuzziness==2.0f) { // u_k=(1/D_k)/sum_j(1/D_j) and u^m=u*u
+        kernels.invert(u,NC*n);
+        std::fill_n(s,n,0.0f);
+        for (size_t k=0; k<NC; ++k)
+            kernels.addTo(u+k*n,n,s);
+
+        kernels.invert(s,n);
+        for (size_t k=0; k<NC; ++k)
+            kernels.multiply(u+k*n,s,n,u+k*n);
+
+        if (bPower)
+            kernels.multiply(u,u,NC*n,b.um.data());
+
+        return;
+    }
+
+    // u_k=exp(-p*log(D_k)-L)/sum_j exp(-p*log(D_j)-L), the largest exponent L is subtracted to avoid overflow
+    kipl::math::logArray(u,u,NC*n,kipl::math::PreciseMath);
+    kernels.affine(u,NC*n,-m_fPower,0.0f,cLowest,u);
+
+    std::fill_n(s,n,cLowest);
+    for (size_t k=0; k<NC; ++k)
+        kernels.maxTo(u+k*n,n,s);
+
+    for (size_t k=0; k<NC; ++k)
+        kernels.subtract(u+k*n,n,s);
+
+    kipl::math::expArray(u,u,NC*n,kipl::math::PreciseMath);
+
+    std::fill_n(s,n,0.0f);
+    for (size_t k=0; k<NC; ++k)
+        kernels.addTo(u+k*n,n,s);
+
+    kernels.invert(s,n);
+    for (size_t k=0; k<NC; ++k)
+        kernels.multiply(u+k*n,s,n,u+k*n);
+
+    if (bPower) {
+        float *um=b.um.data();
+        kipl::math::logArray(u,um,NC*n,kipl::math::PreciseMath);
+        kernels.affine(um,NC*n,m_fFuzziness,0.0f,cLowest,um);
+        kipl::math::expArray(um,um,NC*n,kipl::math::PreciseMath);
+    }
+}
+
+void FuzzyMembership::accumulate(const float *x, size_t N, const float *centers, const float *previous, Sums &sums) const
+{
+    const FuzzyKernels &kernels=fuzzyKernels();
+    const size_t NC=m_nClasses;
+    const bool bKernel=m_eDistance==FuzzyKernelDistance;
+    Block b(NC);
+
+    for (size_t offset=0; offset<N; offset+=core::cFuzzyBlockSize) {
+        const size_t n=std::min(core::cFuzzyBlockSize,N-offset);
+        const float *xb=x+offset;
+        float *u=b.u.data();
+        float *um=b.um.data();
+
+        blockMemberships(xb,n,centers,u,b,true);
+
+        if (bKernel) // The weights of the kernel distance are u^m*K(x,c)
+            kernels.multiply(um,b.w.data(),NC*n,um);
+
+        for (size_t k=0; k<NC; ++k) {
+            float sw=0.0f;
+            float swx=0.0f;
+            kernels.weightedSums(um+k*n,xb,n,sw,swx);
+            sums.weight[k]+=sw;
+            sums.weightedX[k]+=swx;
+        }
+
+        if (previous!=nullptr) {
+            // The kernel weights are no longer needed and may be overwritten
+            float *prev=b.prev.data();
+            blockMemberships(xb,n,previous,prev,b,false);
+            sums.change+=kernels.squaredDifference(u,prev,NC*n);
+        }
+    }
+
+    sums.count+=N;
+}
+
+void FuzzyMembership::memberships(const float *x, size_t N, const float *centers, float *u) const
+{
+    Block b(m_nClasses);
+
+    for (size_t offset=0; offset<N; offset+=core::cFuzzyBlockSize) {
+        const size_t n=std::min(core::cFuzzyBlockSize,N-offset);
+        blockMemberships(x+offset,n,centers,b.u.data(),b,false);
+
+        for (size_t k=0; k<m_nClasses; ++k)
+            std::copy_n(b.u.data()+k*n,n,u+k*N+offset);
+    }
+}
+
+void FuzzyMembership::updateCenters(const Sums &sums, float *centers) const
+{
+    for (size_t k=0; k<m_nClasses; ++k)
+        if (sums.weight[k]!=0.0)
+            centers[k]=static_cast<float>(sums.weightedX[k]/sums.weight[k]);
+
+    std::sort(centers,centers+m_nClasses); // Assures that the class index is ordered with the center value
+}
+
+bool FuzzyMembership::converged(double change, double &oldChange, int &cnt)
+{
+    if ((change<1e-5) || (10<cnt))
+        return true;
+
+    if (std::abs(change-oldChange)<1e-3)
+        cnt++;
+    else {
+        cnt=0;
+        oldChange=change;
+    }
+
+    return false;
+}
+
+}}
@@ -0,0 +1,238 @@
+//<LICENCE>
+
+#include <exception>
+#include <chrono>
+#include <algorithm>
+#include <map>
+
+#include "../../include/utilities/threadpool.h"
+
+namespace kipl { namespace utilities {
+
+namespace {
+    /// The pool and queue index of the current thread, the index of external threads is the last queue.
+    thread_local ThreadPool *tl_pPool = nullptr;
+    thread_local size_t tl_nQueueIndex = 0;
+
+    std::mutex g_GlobalMutex;
+    /// The pools of all budgets used so far, a pool is never destroyed before the process ends.
+    /// References returned by global() and loops in flight therefore stay valid when the budget changes.
+    std::map<size_t, std::unique_ptr<ThreadPool>> g_GlobalPools;
+    ThreadPool *g_pGlobalPool = nullptr;
+    size_t g_nGlobalBudget = 0;
+
+    ThreadPool *globalPool(size_t nThreads)
+    {
+        std::unique_ptr<ThreadPool> &pool=g_GlobalPools[nThreads];
+        if (!pool)
+            pool.reset(new ThreadPool(nThreads));
+
+        return pool.get();
+    }
+
+    size_t resolveThreadCount(size_t nThreads)
+    {
+        if (nThreads==0)
+            nThreads=std::thread::hardware_concurrency();
+
+        return std::max(nThreads,size_t(1));
+    }
+}
+
+/// \brief Book keeping of one parallel loop
+struct ThreadPool::TaskGroup {
+    TaskGroup(const std::function<void(size_t, size_t)> &f, size_t n) :
+        fn(f),
+        remaining(n),
+        cancelled(false)
+    {}
+
+    const std::function<void(size_t, size_t)> &fn;
+    std::atomic<size_t> remaining;
+    std::atomic<bool> cancelled;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+ThreadPool::ThreadPool(size_t nThreads) :
+    m_nQueued(0),
+    m_nNextQueue(0),
+    m_bStop(false)
+{
+    const size_t nWorkers=resolveThreadCount(nThreads)-1;
+
+    for (size_t i=0; i<=nWorkers; ++i)
+        m_Queues.emplace_back(new WorkerQueue);
+
+    for (size_t i=0; i<nWorkers; ++i)
+        m_Workers.emplace_back(&ThreadPool::workerLoop,this,i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_WakeMutex);
+        m_bStop=true;
+    }
+    m_WakeCondition.notify_all();
+
+    for (auto &worker : m_Workers)
+        worker.join();
+}
+
+void ThreadPool::parallel_for(size_t begin, size_t end, const std::function<void (size_t, size_t)> &fn, size_t grain)
+{
+    if (end<=begin)
+        return;
+
+    const size_t N=end-begin;
+    if (grain==0)
+        grain=std::max(size_t(1),N/(4*size()));
+
+    const size_t nBlocks=(N+grain-1)/grain;
+
+    if ((nBlocks==1) || m_Workers.empty()) {
+        fn(begin,end);
+        return;
+    }
+
+    TaskGroup group(fn,nBlocks);
+
+    // Nested loops put their blocks in the queue of the calling worker, they are stolen by the idle workers.
+    const bool isMember = (tl_pPool==this);
+    const size_t nQueues=m_Queues.size();
+    const size_t q = isMember ? tl_nQueueIndex : m_nNextQueue.fetch_add(1) % nQueues;
+
+    {
+        std::lock_guard<std::mutex> lock(m_WakeMutex);
+        m_nQueued+=nBlocks;
+    }
+
+    for (size_t i=0; i<nBlocks; ++i) {
+        Task task={&group, begin+i*grain, std::min(end,begin+(i+1)*grain)};
+        WorkerQueue &queue = isMember ? *m_Queues[q] : *m_Queues[(q+i) % nQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    m_WakeCondition.notify_all();
+
+    const size_t ownQueue = isMember ? tl_nQueueIndex : nQueues-1;
+    Task task;
+    while (group.remaining.load()!=0) {
+        if (popTask(ownQueue,task)) {
+            runTask(task);
+        }
+        else {
+            std::unique_lock<std::mutex> lock(group.mutex);
+            group.done.wait_for(lock,std::chrono::milliseconds(1),[&group]{return group.remaining.load()==0;});
+        }
+    }
+
+    // The last task may still hold the lock while it notifies, the group must outlive it.
+    std::lock_guard<std::mutex> lock(group.mutex);
+    if (group.error)
+        std::rethrow_exception(group.error);
+}
+
+ThreadPool & ThreadPool::global()
+{
+    std::lock_guard<std::mutex> lock(g_GlobalMutex);
+
+    if (g_pGlobalPool==nullptr) {
+        g_nGlobalBudget=resolveThreadCount(g_nGlobalBudget);
+        g_pGlobalPool=globalPool(g_nGlobalBudget);
+    }
+
+    return *g_pGlobalPool;
+}
+
+void ThreadPool::setGlobalThreadBudget(size_t nThreads)
+{
+    std::lock_guard<std::mutex> lock(g_GlobalMutex);
+
+    nThreads=resolveThreadCount(nThreads);
+    if (nThreads==g_nGlobalBudget)
+        return;
+
+    g_nGlobalBudget=nThreads;
+    if (g_pGlobalPool!=nullptr)
+        g_pGlobalPool=globalPool(g_nGlobalBudget);
+}
+
+size_t ThreadPool::globalThreadBudget()
+{
+    std::lock_guard<std::mutex> lock(g_GlobalMutex);
+
+    return resolveThreadCount(g_nGlobalBudget);
+}
+
+void ThreadPool::workerLoop(size_t idx)
+{
+    tl_pPool=this;
+    tl_nQueueIndex=idx;
+
+    Task task;
+    for (;;) {
+        if (popTask(idx,task)) {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_WakeMutex);
+        m_WakeCondition.wait(lock,[this]{return m_bStop || (m_nQueued.load()!=0);});
+        if (m_bStop)
+            return;
+    }
+}
+
+bool ThreadPool::popTask(size_t idx, Task &task)
+{
+    {
+        WorkerQueue &own=*m_Queues[idx];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task=own.tasks.back();
+            own.tasks.pop_back();
+            --m_nQueued;
+            return true;
+        }
+    }
+
+    const size_t nQueues=m_Queues.size();
+    for (size_t i=1; i<nQueues; ++i) {
+        WorkerQueue &victim=*m_Queues[(idx+i) % nQueues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task=victim.tasks.front();
+            victim.tasks.pop_front();
+            --m_nQueued;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::runTask(Task &task)
+{
+    TaskGroup &group=*task.group;
+
+    if (!group.cancelled.load()) {
+        try {
+            group.fn(task.first,task.last);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(group.mutex);
+            if (!group.error)
+                group.error=std::current_exception();
+            group.cancelled=true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(group.mutex);
+    if (--group.remaining==0)
+        group.done.notify_all();
+}
+
+}}
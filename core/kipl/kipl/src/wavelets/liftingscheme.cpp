@@ -0,0 +1,316 @@
+//<LICENCE>
+
+#include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <limits>
+
+#include "../../include/wavelets/liftingscheme.h"
+#include "../../include/wavelets/wavelets.h"
+#include "../../include/base/KiplException.h"
+
+namespace {
+
+/// A Laurent polynomial sum_i c[i] z^(lo+i), an empty coefficient list is the zero polynomial
+struct Laurent {
+    Laurent() : lo(0) {}
+    int lo;
+    std::vector<double> c;
+
+    bool zero() const {return c.empty();}
+    int span() const {return static_cast<int>(c.size())-1;}
+    int hi() const {return lo+span();}
+};
+
+double magnitude(const Laurent &p)
+{
+    double m=0.0;
+    for (auto c : p.c)
+        m=std::max(m,std::abs(c));
+
+    return m;
+}
+
+/// Removes leading and trailing coefficients below the tolerance
+void trim(Laurent &p, double eps)
+{
+    size_t first=0;
+    size_t last=p.c.size();
+    while ((first<last) && (std::abs(p.c[first])<=eps))
+        ++first;
+    while ((first<last) && (std::abs(p.c[last-1])<=eps))
+        --last;
+
+    p.c=std::vector<double>(p.c.begin()+first,p.c.begin()+last);
+    p.lo+=static_cast<int>(first);
+    if (p.c.empty())
+        p.lo=0;
+}
+
+Laurent multiply(const Laurent &a, const Laurent &b)
+{
+    Laurent p;
+    if (a.zero() || b.zero())
+        return p;
+
+    p.lo=a.lo+b.lo;
+    p.c.assign(a.c.size()+b.c.size()-1,0.0);
+    for (size_t i=0; i<a.c.size(); ++i)
+        for (size_t j=0; j<b.c.size(); ++j)
+            p.c[i+j]+=a.c[i]*b.c[j];
+
+    return p;
+}
+
+Laurent subtract(const Laurent &a, const Laurent &b, double eps)
+{
+    if (b.zero())
+        return a;
+    if (a.zero()) {
+        Laurent p=b;
+        for (auto &c : p.c)
+            c=-c;
+        return p;
+    }
+
+    Laurent p;
+    p.lo=std::min(a.lo,b.lo);
+    p.c.assign(std::max(a.hi(),b.hi())-p.lo+1,0.0);
+    for (size_t i=0; i<a.c.size(); ++i)
+        p.c[a.lo-p.lo+i]+=a.c[i];
+    for (size_t i=0; i<b.c.size(); ++i)
+        p.c[b.lo-p.lo+i]-=b.c[i];
+
+    trim(p,eps);
+    return p;
+}
+
+/// Long division, the remainder has a shorter span than b
+/// \param a The dividend
+/// \param b The divisor
+/// \param r Receives the remainder, coefficients that are negligible compared to the dividend are removed
+/// \param fromTop Eliminates the coefficients of a from the highest power if true, otherwise from the lowest power
+/// \param eps Relative tolerance
+/// \returns the quotient
+Laurent divide(const Laurent &a, const Laurent &b, Laurent &r, bool fromTop, double eps)
+{
+    const int nq=a.span()-b.span()+1;
+    Laurent q;
+    q.lo=a.lo-b.lo;
+    q.c.assign(nq,0.0);
+
+    r=a;
+    if (fromTop) {
+        for (int i=nq-1; 0<=i; --i) {
+            const double coef=r.c[i+b.span()]/b.c.back();
+            q.c[i]=coef;
+            for (size_t j=0; j<b.c.size(); ++j)
+                r.c[i+j]-=coef*b.c[j];
+        }
+        r.c.resize(b.span());
+    }
+    else {
+        for (int i=0; i<nq; ++i) {
+            const double coef=r.c[i]/b.c.front();
+            q.c[i]=coef;
+            for (size_t j=0; j<b.c.size(); ++j)
+                r.c[i+j]-=coef*b.c[j];
+        }
+        r.c.erase(r.c.begin(),r.c.begin()+nq);
+        r.lo+=nq;
+    }
+
+    trim(r,eps*magnitude(a));
+
+    return q;
+}
+
+Laurent monomial(double c, int power)
+{
+    Laurent p;
+    p.lo=power;
+    p.c.push_back(c);
+    return p;
+}
+
+/// The state of the Euclidean algorithm, M is the remaining polyphase matrix
+struct Factorization {
+    Factorization() : cost(1.0) {}
+    Laurent M[2][2];
+    std::vector<kipl::wavelets::LiftingScheme::Step> steps;
+    double cost;        ///< Product of the gains 1+sum|coef| of the steps, a bound on the amplification of rounding errors
+};
+
+// The steps update both rows, the division remainder replaces the first row to remove rounding errors
+void predict(Factorization &f, const Laurent &q, const Laurent &r, double eps)
+{
+    f.M[0][0]=r;
+    f.M[1][0]=subtract(f.M[1][0],multiply(q,f.M[1][1]),eps*magnitude(f.M[1][0]));
+    f.steps.push_back({false,q.lo,q.c});
+    double gain=1.0;
+    for (auto c : q.c)
+        gain+=std::abs(c);
+    f.cost*=gain;
+}
+
+void update(Factorization &f, const Laurent &u, const Laurent &r, double eps)
+{
+    f.M[0][1]=r;
+    f.M[1][1]=subtract(f.M[1][1],multiply(u,f.M[1][0]),eps*magnitude(f.M[1][1]));
+    f.steps.push_back({true,u.lo,u.c});
+    double gain=1.0;
+    for (auto c : u.c)
+        gain+=std::abs(c);
+    f.cost*=gain;
+}
+
+/// Completes the factorization when the first row is reduced to a single term
+/// \returns false if the rounding errors have destroyed the structure of the matrix
+bool finish(Factorization &f, double eps)
+{
+    if (f.M[0][0].zero()) { // Swaps the channels with two extra steps
+        const Laurent m=f.M[0][1];
+        predict(f,monomial(-1.0/m.c[0],-m.lo),monomial(1.0,0),eps);
+        update(f,m,Laurent(),eps);
+    }
+
+    if ((f.M[0][0].span()!=0) || (f.M[1][1].span()!=0))
+        return false;
+
+    if (!f.M[1][0].zero()) {
+        Laurent r;
+        Laurent q=divide(f.M[1][0],f.M[1][1],r,true,eps);
+        const Laurent first=f.M[0][0]; // The first row is not changed as M[0][1] is zero
+        predict(f,q,first,eps);
+        f.M[1][0]=r;
+    }
+
+    const double k0=std::abs(f.M[0][0].c[0]);
+    const double k1=std::abs(f.M[1][1].c[0]);
+    f.cost*=std::max(std::max(k0,1.0/k0),std::max(k1,1.0/k1));
+
+    return true;
+}
+
+/// Euclidean algorithm on the first row, each division is one lifting step. Each division can eliminate
+/// the coefficients from either end, all combinations are tried and the best conditioned factorization is kept.
+void search(const Factorization &f, Factorization &best, double eps)
+{
+    if (best.cost<=f.cost)
+        return;
+
+    if (f.M[0][0].zero() || f.M[0][1].zero()) {
+        Factorization result=f;
+        if (finish(result,eps) && (result.cost<best.cost))
+            best=result;
+        return;
+    }
+
+    const bool isPredict = f.M[0][1].span()<=f.M[0][0].span();
+    for (bool fromTop : {true,false}) {
+        Factorization next=f;
+        Laurent r;
+        if (isPredict)
+            predict(next,divide(f.M[0][0],f.M[0][1],r,fromTop,eps),r,eps);
+        else
+            update(next,divide(f.M[0][1],f.M[0][0],r,fromTop,eps),r,eps);
+        search(next,best,eps);
+    }
+}
+
+
+}
+
+namespace kipl { namespace wavelets {
+
+LiftingScheme::LiftingScheme(const std::string &name) :
+    m_sName(name)
+{
+    const std::list<std::string> names=NameList();
+    if (std::find(names.begin(),names.end(),name)==names.end())
+        throw kipl::base::KiplException("The lifting scheme doesn't support the wavelet "+name,__FILE__,__LINE__);
+
+    WaveletKernel<double> kernel(name);
+
+    const double *h=kernel.synthH()+kernel.begin(); // The scaling filter in natural order
+    const int L=kernel.size();
+    const double eps=1e-10;
+
+    // Polyphase components of the scaling filter h and the wavelet filter g[k]=(-1)^k h[L-1-k]
+    Factorization f;
+    for (int k=0; k<L; ++k) {
+        const double g=(k & 1 ? -1.0 : 1.0)*h[L-1-k];
+        f.M[0][k & 1].c.push_back(h[k]);
+        f.M[1][k & 1].c.push_back(g);
+    }
+    for (auto &row : f.M)
+        for (auto &p : row)
+            trim(p,0.0);
+
+    const Laurent P[2][2]={{f.M[0][0],f.M[0][1]},{f.M[1][0],f.M[1][1]}};
+
+    Factorization best;
+    best.cost=std::numeric_limits<double>::max();
+    search(f,best,eps);
+
+    if (best.steps.empty())
+        throw kipl::base::KiplException("Failed to factor the polyphase matrix of "+name,__FILE__,__LINE__);
+
+    m_Steps    = best.steps;
+    m_fScale[0] = best.M[0][0].c[0];
+    m_fScale[1] = best.M[1][1].c[0];
+    m_nShift[0] = best.M[0][0].lo;
+    m_nShift[1] = best.M[1][1].lo;
+
+    // Rebuilds the polyphase matrix from the steps to check the accuracy of the factorization
+    Laurent R[2][2]={{monomial(1.0,0),Laurent()},{Laurent(),monomial(1.0,0)}};
+    for (const auto &step : m_Steps) {
+        Laurent q;
+        q.lo=step.first;
+        q.c=step.coef;
+        const int target = step.update ? 0 : 1;
+        for (int col=0; col<2; ++col)
+            R[target][col]=subtract(R[target][col],multiply(monomial(-1.0,0),multiply(q,R[1-target][col])),0.0);
+    }
+
+    double error=0.0;
+    for (int row=0; row<2; ++row) {
+        const Laurent scale=monomial(m_fScale[row],m_nShift[row]);
+        for (int col=0; col<2; ++col) {
+            Laurent diff=subtract(multiply(scale,R[row][col]),P[row][col],0.0);
+            for (auto c : diff.c)
+                error=std::max(error,std::abs(c));
+        }
+    }
+
+    if (1e-9<error) {
+        std::ostringstream msg;
+        msg<<"The lifting factorization of "<<name<<" is inaccurate (error="<<error<<")";
+        throw kipl::base::KiplException(msg.str(),__FILE__,__LINE__);
+    }
+}
+
+int LiftingScheme::boundaryWidth() const
+{
+    int width=0;
+    for (const auto &step : m_Steps)
+        width+=std::max(std::abs(step.first),std::abs(step.first+static_cast<int>(step.coef.size())-1));
+
+    return width+std::max(std::abs(m_nShift[0]),std::abs(m_nShift[1]));
+}
+
+std::list<std::string> LiftingScheme::NameList()
+{
+    std::list<std::string> names;
+
+    names.push_back("haar");
+    for (int i=1; i<=10; ++i)
+        names.push_back("daub"+std::to_string(i));
+
+    for (int i=2; i<=10; ++i)
+        names.push_back("sym"+std::to_string(i));
+
+    return names;
+}
+
+}}
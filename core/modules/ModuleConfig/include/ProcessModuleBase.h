@@ -9,12 +9,14 @@
 
 #include <string>
 #include <map>
+#include <functional>
 
 #include <base/timage.h>
 #include <profile/Timer.h>
 #include <logging/logger.h>
 #include <strings/miscstring.h>
 #include <interactors/interactionbase.h>
+#include <utilities/threadpool.h>
 #include <algorithm>
 
 /// Base class for all processing modules. This class will allways be refined for each processing framework.
@@ -89,6 +91,14 @@ protected:
     /// \returns The abort status of interactor object. True means abort back-projection and false continue.
     bool UpdateStatus(float val, std::string msg);
 
+    /// Processes the slices [0,N) in parallel using the shared kipl thread pool. The number of threads is limited by the global thread budget.
+    /// \param N The number of slices to process.
+    /// \param fn Function that processes the slices [first,last), it is called concurrently for different blocks of slices.
+    /// \param grain The number of slices per block, 0 selects the block size automatically.
+    /// \returns true if all slices were processed and false if the processing was aborted through the interactor.
+    /// \throws The first exception thrown by fn after the running blocks are finished.
+    bool parallel_for_slices(size_t N, const std::function<void(size_t first, size_t last)> &fn, size_t grain=0);
+
     std::string m_sModuleName;   ///< The name of the module
     kipl::profile::Timer timer;  ///< Timer object to measure the execution time.
     virtual int SourceVersion(); ///< \returns the value of the repository version of the source code.
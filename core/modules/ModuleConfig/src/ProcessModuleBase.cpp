@@ -1,6 +1,8 @@
 //<LICENSE>
 
 #include <sstream>
+#include <atomic>
+#include <mutex>
 #include "../include/ModuleConfig_global.h"
 #include "../include/ProcessModuleBase.h"
 
@@ -90,3 +92,27 @@ bool ProcessModuleBase::UpdateStatus(float val, std::string msg)
 
     return false;
 }
+
+bool ProcessModuleBase::parallel_for_slices(size_t N, const std::function<void(size_t, size_t)> &fn, size_t grain)
+{
+    std::atomic<size_t> nDone(0);
+    std::atomic<bool> bAbort(false);
+    std::mutex statusMutex;
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,N,
+        [&](size_t first, size_t last)
+        {
+            if (bAbort.load())
+                return;
+
+            fn(first,last);
+
+            const size_t done=(nDone+=last-first);
+            std::lock_guard<std::mutex> lock(statusMutex);
+            if (UpdateStatus(float(done)/N,m_sModuleName))
+                bAbort=true;
+        },
+        grain);
+
+    return !bAbort.load();
+}
@@ -446,7 +446,11 @@ kipl::base::TImage<float,2> ImageReader::ReadHDF(std::string filename, size_t co
 kipl::base::TImage<float,2> ImageReader::ReadSEQ(std::string filename, size_t const * const nCrop, size_t idx)
 {
     kipl::base::TImage<float,2> img;
-    kipl::io::ReadViVaSEQ(filename, img, idx, nCrop);
+
+    if (!m_SEQReader.isOpen() || (m_SEQReader.fileName()!=filename))
+        m_SEQReader.openSEQ(filename);
+
+    m_SEQReader.read(img, idx, nCrop);
 
     return img;
 }
@@ -9,6 +9,7 @@
 #include <base/kiplenums.h>
 #include <profile/Timer.h>
 #include <interactors/interactionbase.h>
+#include <io/mappedsequencereader.h>
 
 #include "datasetbase.h"
 
@@ -166,6 +167,11 @@ protected:
 
     kipl::base::TImage<float,2> ReadHDF(std::string filename, size_t const * const nCrop=nullptr, size_t idx=0L);
 
+    /// Read a frame from a ViVa SEQ file, the file stays mapped until another SEQ file is read.
+    /// \param filename The name of the file to read.
+    /// \param nCrop ROI to read.
+    /// \param idx The frame index
+    /// \returns A floating point image
     kipl::base::TImage<float,2> ReadSEQ(std::string filename, size_t const * const nCrop=nullptr, size_t idx=0L);
 
     /// Interface to the interactor that updates the message and progress.
@@ -179,6 +185,7 @@ protected:
 
     kipl::profile::Timer timer; ///< Timer to measure the execution time for the reading.
     kipl::interactors::InteractionBase *m_Interactor;
+    kipl::io::MappedSequenceReader m_SEQReader; ///< Keeps the last SEQ file mapped between the frames.
 };
 
 #endif
@@ -7,6 +7,7 @@
 #include <strings/filenames.h>
 #include <io/io_stack.h>
 #include <base/KiplException.h>
+#include <base/histogramengine.h>
 
 #include "../include/KiplEngine.h"
 #include "../include/KiplFrameworkException.h"
@@ -159,8 +160,9 @@ bool KiplEngine::SaveImage(KiplProcessConfig::cOutImageInformation * info)
 
         if (config->bRescaleResult)
         {
-			maxval=*std::max_element(m_ResultImage.GetDataPtr(),m_ResultImage.GetDataPtr()+m_ResultImage.Size());
-			minval=*std::min_element(m_ResultImage.GetDataPtr(),m_ResultImage.GetDataPtr()+m_ResultImage.Size());
+            kipl::math::Statistics stats=kipl::base::HistogramEngine<float>::statistics(m_ResultImage.GetDataPtr(),m_ResultImage.Size());
+            maxval=static_cast<float>(stats.Max());
+            minval=static_cast<float>(stats.Min());
 		}
 		m_ResultImage.info.SetMetricX(m_InputImage->info.GetMetricX());
 		m_ResultImage.info.SetMetricY(m_InputImage->info.GetMetricY());
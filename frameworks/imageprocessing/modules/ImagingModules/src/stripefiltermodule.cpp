@@ -100,11 +100,19 @@ int IMAGINGMODULESSHARED_EXPORT StripeFilterModule::ProcessCore(kipl::base::TIma
 
     m_StripeFilter = new ImagingAlgorithms::StripeFilter(slice.Dims(),m_sWaveletName,m_nLevels,m_fSigma);
 
-//    #pragma omp for
-    for (size_t i=0; (i<Nslices && (updateStatus(float(i)/Nslices,"Processing Stripe Filter")==false) ); i++) {
-        slice=kipl::base::ExtractSlice(img,i,plane,nullptr);
-        m_StripeFilter->process(slice,op);
-        kipl::base::InsertSlice(slice,img,i,plane);
+    if (m_bParallelProcessing) {
+        // The filter configuration is shared by the threads, each block of slices has its own work buffers.
+        parallel_for_slices(Nslices,[&](size_t first, size_t last)
+        {
+            m_StripeFilter->process(img,op,plane,first,last);
+        },1);
+    }
+    else {
+        for (size_t i=0; (i<Nslices && (updateStatus(float(i)/Nslices,"Processing Stripe Filter")==false) ); i++) {
+            slice=kipl::base::ExtractSlice(img,i,plane,nullptr);
+            m_StripeFilter->process(slice,op);
+            kipl::base::InsertSlice(slice,img,i,plane);
+        }
     }
 
     delete m_StripeFilter;
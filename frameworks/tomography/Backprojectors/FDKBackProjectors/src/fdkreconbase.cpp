@@ -16,6 +16,7 @@
 #include <base/tpermuteimage.h>
 #include <base/trotate.h>
 #include <math/mathconstants.h>
+#include <profile/Tracer.h>
 
 FdkReconBase::FdkReconBase(std::string application, std::string name, eMatrixAlignment alignment, kipl::interactors::InteractionBase *interactor) :
     BackProjectorModuleBase("muhrec",name,alignment,interactor),
@@ -217,6 +218,7 @@ size_t FdkReconBase::Process(kipl::base::TImage<float,2> proj, float angle, floa
 size_t FdkReconBase::Process(kipl::base::TImage<float,3> projections, std::map<std::string, std::string> parameters)
 {
        logger(kipl::logging::Logger::LogMessage,"FdkReconBase::Process 1");
+       KIPL_TRACE_SCOPE("FdkReconBase::Process","backprojection");
 
        if (volume.Size()==0)
            throw ReconException("The target matrix is not allocated.",__FILE__,__LINE__);
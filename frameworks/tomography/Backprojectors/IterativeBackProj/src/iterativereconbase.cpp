@@ -1,9 +1,18 @@
 #include "iterativereconbase.h"
 
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+#include <ReconException.h>
+#include <strings/miscstring.h>
+#include <josephprojector.h>
+
 IterativeReconBase::IterativeReconBase(std::string application, std::string name, eMatrixAlignment alignment, kipl::interactors::InteractionBase *interactor) :
     BackProjectorModuleBase(application,name,alignment,interactor),
-    m_fp(nullptr),
-    m_bp(nullptr),
+    m_fp(new JosephForwardProjector),
+    m_bp(new JosephBackProjector),
     m_nIterations(10)
 {
 
@@ -19,6 +28,9 @@ IterativeReconBase::~IterativeReconBase()
 /// \param parameters Additional set of configuration parameters
 int IterativeReconBase::Configure(ReconConfig config, std::map<std::string, std::string> parameters)
 {
+    mConfig=config;
+
+    m_nIterations = GetIntParameter(parameters,"iterations");
 
     return 0;
 }
@@ -36,6 +48,8 @@ std::map<std::string, std::string> IterativeReconBase::GetParameters()
 {
    std::map<std::string, std::string> params;
 
+   params["iterations"] = kipl::strings::value2string(m_nIterations);
+
    return params;
 }
 
@@ -43,7 +57,29 @@ std::map<std::string, std::string> IterativeReconBase::GetParameters()
 /// \param roi A four-entry array of ROI coordinates (x0,y0,x1,y1)
 void IterativeReconBase::SetROI(size_t *roi)
 {
+    ClearAll();
+    m_ProjectionBuffer.clear();
+    m_BufferAngles.clear();
+
+    std::copy_n(roi,4,mConfig.ProjectionInfo.roi);
+
+    const size_t SizeU = roi[2]-roi[0];
+    const size_t SizeV = mConfig.ProjectionInfo.imagetype==ReconConfig::cProjections::ImageType_Proj_RepeatSinogram ?
+                             roi[3] : roi[3]-roi[1];
+
+    MatrixDims[0]=SizeU;
+    MatrixDims[1]=SizeU;
+    MatrixDims[2]=SizeV;
 
+    volume.Resize(MatrixDims);
+    volume=0.0f;
+
+    std::ostringstream msg;
+    msg<<"Setting up reconstructor with ROI=["<<roi[0]<<", "<<roi[1]<<", "<<roi[2]<<", "<<roi[3]<<"]"<<std::endl;
+    msg<<"Matrix dimensions "<<volume;
+    logger(kipl::logging::Logger::LogVerbose,msg.str());
+
+    BuildCircleMask();
 }
 
 /// Add one projection to the back-projection stack
@@ -51,9 +87,33 @@ void IterativeReconBase::SetROI(size_t *roi)
 /// \param angle Acquisition angle
 /// \param weight Intensity scaling factor for interpolation when the angles are non-uniformly distributed
 /// \param bLastProjection termination signal. When true the back-projeciton is finalized.
-size_t IterativeReconBase::Process(kipl::base::TImage<float,2> proj, float angle, float weight, bool bLastProjection)
+size_t IterativeReconBase::Process(kipl::base::TImage<float,2> proj, float angle, float /*weight*/, bool bLastProjection)
 {
-    return 0L;
+    if (volume.Size()==0)
+        throw ReconException("The target matrix is not allocated.",__FILE__,__LINE__);
+
+    // The iterations need all projections, they are collected until the last one arrives.
+    proj.Clone();
+    m_ProjectionBuffer.push_back(proj);
+    m_BufferAngles.push_back(2.0f*(mConfig.ProjectionInfo.eDirection-0.5f)*angle);
+
+    if (bLastProjection) {
+        size_t dims[3]={proj.Size(0),proj.Size(1),m_ProjectionBuffer.size()};
+        kipl::base::TImage<float,3> projections(dims);
+
+        for (size_t i=0; i<m_ProjectionBuffer.size(); ++i) {
+            if (m_ProjectionBuffer[i].Size()!=proj.Size())
+                throw ReconException("The collected projections have different sizes.",__FILE__,__LINE__);
+
+            std::copy_n(m_ProjectionBuffer[i].GetDataPtr(),proj.Size(),projections.GetLinePtr(0,i));
+        }
+
+        m_ProjectionBuffer.clear();
+        reconstruct(projections,m_BufferAngles);
+        m_BufferAngles.clear();
+    }
+
+    return m_ProjectionBuffer.size();
 }
 
 /// Starts the back-projection process of projections stored as a 3D volume.
@@ -61,6 +121,62 @@ size_t IterativeReconBase::Process(kipl::base::TImage<float,2> proj, float angle
 /// \param parameters A list of parameters, the list shall contain at least the parameters angles and weights each containing a space separated list with as many values as projections
 size_t IterativeReconBase::Process(kipl::base::TImage<float,3> proj, std::map<std::string, std::string> parameters)
 {
+    if (volume.Size()==0)
+        throw ReconException("The target matrix is not allocated.",__FILE__,__LINE__);
+
+    const size_t nProj=proj.Size(2);
+    std::vector<float> angles(nProj+16);
+    GetFloatParameterVector(parameters,"angles",angles.data(),nProj);
+
+    const float dirWeight = 2.0f*(mConfig.ProjectionInfo.eDirection-0.5f);
+    std::list<float> angleList;
+    for (size_t i=0; i<nProj; ++i)
+        angleList.push_back(dirWeight*angles[i]);
+
+    return reconstruct(proj,angleList);
+}
+
+/// Get the histogram of the reconstructed matrix in the masked region.
+/// \param axis the bin values of the x axis
+/// \param hist the histogram bins
+/// \param nBins number of bins
+void IterativeReconBase::GetHistogram(float *axis, size_t *hist, size_t nBins)
+{
+    memset(axis,0,sizeof(float)*nBins);
+    memset(hist,0,sizeof(size_t)*nBins);
+
+    if ((volume.Size()==0) || (nBins==0))
+        return;
+
+    float matrixMin=std::numeric_limits<float>::max();
+    float matrixMax=-std::numeric_limits<float>::max();
+
+    for (size_t z=0; z<volume.Size(2); z++) {
+        for (size_t y=0; y<mask.size(); y++) {
+            const float *pLine=volume.GetLinePtr(y,z);
+            for (size_t x=mask[y].first; x<mask[y].second; x++) {
+                matrixMin=std::min(matrixMin,pLine[x]);
+                matrixMax=std::max(matrixMax,pLine[x]);
+            }
+        }
+    }
+
+    float scale=(matrixMax-matrixMin)/(nBins+1);
+    float invScale= scale!=0.0f ? 1.0f/scale : 0.0f;
+
+    for (size_t z=0; z<volume.Size(2); z++) {
+        for (size_t y=0; y<mask.size(); y++) {
+            const float *pLine=volume.GetLinePtr(y,z);
+            for (size_t x=mask[y].first; x<mask[y].second; x++) {
+                size_t index=static_cast<size_t>(invScale*(pLine[x]-matrixMin));
+                if (nBins<=index)
+                    index=nBins-1;
+                hist[index]++;
+            }
+        }
+    }
 
-    return 0L;
+    axis[0]=matrixMin+scale/2.0f;
+    for (size_t i=1; i<nBins; i++)
+        axis[i]=axis[i-1]+scale;
 }
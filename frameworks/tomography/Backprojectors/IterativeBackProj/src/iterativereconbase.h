@@ -1,11 +1,17 @@
 #ifndef ITERATIVERECONBASE_H
 #define ITERATIVERECONBASE_H
 
+#include <list>
+#include <vector>
+#include <memory>
+
 #include <BackProjectorModuleBase.h>
 #include <ParameterHandling.h>
 #include <forwardprojectorbase.h>
 #include <backprojectorbase.h>
 
+/// Base class for the iterative reconstruction methods. It collects the projections, manages the matrix, and provides
+/// a matched pair of forward and back projectors. The reconstruction itself is implemented by the method reconstruct.
 class IterativeReconBase : public BackProjectorModuleBase
 {
 public:
@@ -20,7 +26,7 @@ public:
     /// Initializing the reconstructor
     virtual int Initialize();
 
-    /// Add one projection to the back-projection stack
+    /// Add one projection to the back-projection stack, the reconstruction starts when the last projection is added.
     /// \param proj The projection
     /// \param angle Acquisition angle
     /// \param weight Intensity scaling factor for interpolation when the angles are non-uniformly distributed
@@ -41,13 +47,25 @@ public:
     /// \param roi A four-entry array of ROI coordinates (x0,y0,x1,y1)
     virtual void SetROI(size_t *roi);
 
+    /// Get the histogram of the reconstructed matrix in the masked region.
+    /// \param x the bin values of the x axis
+    /// \param y the histogram bins
+    /// \param N number of bins
+    virtual void GetHistogram(float *x, size_t *y, size_t N);
+
 protected:
+    /// Reconstructs the slices of a block of projections into the matrix
+    /// \param proj The projections stored as xy-slices, the rows of the projections are the slices.
+    /// \param angles The acquisition angles in degrees, the rotation direction is already applied.
     virtual size_t reconstruct(kipl::base::TImage<float,3> proj,std::list<float> & angles) = 0;
 
-    ForwardProjectorBase *m_fp;
-    BackProjectorBase    *m_bp;
+    std::unique_ptr<ForwardProjectorBase> m_fp; ///< Forward projector, owned by the module
+    std::unique_ptr<BackProjectorBase>    m_bp; ///< Back-projector matched to the forward projector, owned by the module
 
     int   m_nIterations;
+
+    std::vector<kipl::base::TImage<float,2>> m_ProjectionBuffer; ///< Projections collected by the single projection Process
+    std::list<float> m_BufferAngles;                             ///< Angles of the collected projections
 };
 
 #endif // ITERATIVERECONBASE_H
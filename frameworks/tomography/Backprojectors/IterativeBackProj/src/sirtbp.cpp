@@ -1,11 +1,24 @@
 
-#include <interactors/interactionbase.h>
-#include "sirtbp.h"
+#include <sstream>
+#include <cmath>
+#include <limits>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
 
+#include <interactors/interactionbase.h>
+#include <strings/miscstring.h>
+#include <utilities/threadpool.h>
+#include <ReconException.h>
 
+#include "sirtbp.h"
 
 SIRTbp::SIRTbp(kipl::interactors::InteractionBase *interactor) :
-    IterativeReconBase("muhrec","SIRTbp",BackProjectorModuleBase::MatrixXYZ,interactor)
+    IterativeReconBase("muhrec","SIRTbp",BackProjectorModuleBase::MatrixXYZ,interactor),
+    m_fAlpha(1.0f),
+    m_nSubsets(1),
+    m_fTolerance(0.001f),
+    m_bNonNegative(false)
 {
 
 }
@@ -15,81 +28,218 @@ SIRTbp::~SIRTbp()
 
 }
 
-/// Add one projection to the back-projection stack
-/// \param proj The projection
-/// \param angle Acquisition angle
-/// \param weight Intensity scaling factor for interpolation when the angles are non-uniformly distributed
-/// \param bLastProjection termination signal. When true the back-projeciton is finalized.
-size_t SIRTbp::Process(kipl::base::TImage<float,2> proj, float angle, float weight, bool bLastProjection)
+size_t SIRTbp::reconstruct(kipl::base::TImage<float,3> proj,std::list<float> & angles)
 {
+    std::ostringstream msg;
+
+    const size_t nWidth  = proj.Size(0);
+    const size_t nSlices = proj.Size(1);
+
+    if (angles.size()!=proj.Size(2)) {
+        msg<<"SIRTbp got "<<proj.Size(2)<<" projections and "<<angles.size()<<" angles";
+        throw ReconException(msg.str(),__FILE__,__LINE__);
+    }
+
+    if ((volume.Size(0)!=nWidth) || (volume.Size(2)!=nSlices)) {
+        msg<<"The projections ("<<proj<<") don't fit the matrix ("<<volume<<")";
+        throw ReconException(msg.str(),__FILE__,__LINE__);
+    }
+
+    timer.Tic();
+    const float center=mConfig.ProjectionInfo.fCenter;
+    m_fp->setCenter(center);
+
+    std::vector<Subset> subsets=buildSubsets(angles,nWidth,center);
+
+    std::vector<size_t> iterations(nSlices,0);
+    std::vector<float> residuals(nSlices,0.0f);
+    std::atomic<size_t> nDone(0);
+    std::atomic<bool> bAbort(false);
+    std::mutex statusMutex;
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,nSlices,
+        [&](size_t first, size_t last) {
+            for (size_t i=first; (i<last) && !bAbort; ++i) {
+                iterations[i]=reconstructSlice(proj,i,subsets,center,residuals[i]);
+
+                std::lock_guard<std::mutex> lock(statusMutex);
+                if (UpdateStatus(static_cast<float>(++nDone)/nSlices,"SIRT iterations"))
+                    bAbort=true;
+            }
+        },1);
+
+    timer.Toc();
+
+    size_t nIterations=0;
+    float maxResidual=0.0f;
+    for (size_t i=0; i<nSlices; ++i) {
+        nIterations+=iterations[i];
+        maxResidual=std::max(maxResidual,residuals[i]);
+    }
+
+    msg<<"Reconstructed "<<nSlices<<" slices with "<<subsets.size()<<" subset(s) using "
+       <<(nSlices!=0 ? static_cast<float>(nIterations)/nSlices : 0.0f)<<" iterations per slice on average, largest relative residual "
+       <<maxResidual<<(bAbort ? " (aborted)" : "");
+    logger(kipl::logging::Logger::LogMessage,msg.str());
 
     return 0L;
 }
 
-/// Starts the back-projection process of projections stored as a 3D volume.
-/// \param proj The projection data
-/// \param parameters A list of parameters, the list shall contain at least the parameters angles and weights each containing a space separated list with as many values as projections
-size_t SIRTbp::Process(kipl::base::TImage<float,3> proj, std::map<std::string, std::string> parameters)
+std::vector<SIRTbp::Subset> SIRTbp::buildSubsets(const std::list<float> &angles, size_t width, float center)
 {
-//    //    forwproj2D  - forward projector
-//    //    backproj2D - backprojector
-//    //    x - initial guess
-//    //    b - projection data (sinogram)
-
-//    // Matalab initialization code
-//    //    [nsino1, nsino2] = size(b);
-//    //    N = size(x,1);
-//    //    if (N == 1)
-//    //        disp('Initialize image!');
-//    //    end
-//    //    row_sum = forwproj2D(ones(N,N), theta, nsino2);
-//    //    column_sum = backproj2D(ones(nsino1, nsino2), theta, N);
-//    //    R = zeros(nsino1, nsino2);
-//    //    C = zeros(N,N);
-
-//    //    roi1 = find(row_sum(:) > 0);
-//    //    roi2 = find(column_sum(column_sum(:) > 0));
-
-//    //    R(roi1) = 1./row_sum(roi1);
-//    //    C(roi2) = 1./column_sum(roi2);
-
-//    size_t dims[3]={proj.Size(0), proj.Size(0), proj.Size(2)};
-//    volume.Resize(dims);
-//    kipl::base::TImage<float,2> x(dims);
-//    kipl::base::TImage<float,2> bp(dims);
-//    kipl::base::TImage<float,2> r(dims); // todo fix dimensions
-//    kipl::base::TImage<float,2> res; // todo fix dimensions
-//    kipl::base::TImage<float,2> sino; // todo fix dimensions
-//    for (int i=0; i<m_nIterations; i++) {
-//        // Matlab iteration code
-//        //         r =  forwproj2D(x, theta, nsino2); % forward proj
-//        //         res = (b-r);
-//        //         res = res.*R;
-//        //         bp = backproj2D(res, theta, N);
-//        //         bp = bp.*C;
-//        //         x = x + bp;
-//        //         %x(x<0)=0;
-//        m_fp->project(x,theta,r);
-//        res = sino - r;
-//        res *=R;
-//        m_bp->backproject(res,dims[0]/2.0f,theta,bp);
-//        bp*=C;
-//        x+=bp;
-//    }
+    const size_t nProj    = angles.size();
+    const size_t nSubsets = std::max(size_t(1),std::min(static_cast<size_t>(std::max(m_nSubsets,1)),nProj));
 
-    return 0L;
+    // Visit the interleaved subsets in bit-reversed order, consecutive subsets then cover different angles
+    size_t nBits=0;
+    while ((size_t(1)<<nBits)<nSubsets)
+        ++nBits;
+
+    std::vector<size_t> order;
+    for (size_t i=0; i<(size_t(1)<<nBits); ++i) {
+        size_t reversed=0;
+        for (size_t b=0; b<nBits; ++b)
+            reversed |= ((i>>b) & 1) << (nBits-1-b);
+
+        if (reversed<nSubsets)
+            order.push_back(reversed);
+    }
+
+    std::vector<float> angleVector(angles.begin(),angles.end());
+    std::vector<Subset> subsets(nSubsets);
+
+    size_t sliceDims[2]={width,width};
+    kipl::base::TImage<float,2> ones(sliceDims);
+    ones=1.0f;
+
+    kipl::base::TImage<float,2> sums;
+    for (size_t s=0; s<nSubsets; ++s) {
+        Subset &subset=subsets[s];
+        for (size_t i=order[s]; i<nProj; i+=nSubsets) {
+            subset.index.push_back(i);
+            subset.angles.push_back(angleVector[i]);
+        }
+
+        // Row sums, the length of each ray through the matrix
+        m_fp->project(ones,subset.angles,sums);
+        subset.rowWeights.Resize(sums.Dims());
+        for (size_t i=0; i<sums.Size(); ++i)
+            subset.rowWeights[i] = 1e-6f<sums[i] ? 1.0f/sums[i] : 0.0f;
+
+        // Column sums, the total weight of the rays through each pixel
+        size_t sinoDims[2]={width,subset.angles.size()};
+        kipl::base::TImage<float,2> sino(sinoDims);
+        sino=1.0f;
+        m_bp->backproject(sino,center,subset.angles,sums);
+        subset.columnWeights.Resize(sums.Dims());
+        for (size_t i=0; i<sums.Size(); ++i)
+            subset.columnWeights[i] = 1e-6f<sums[i] ? m_fAlpha/sums[i] : 0.0f;
+    }
+
+    return subsets;
 }
 
-size_t SIRTbp::reconstruct(kipl::base::TImage<float,3> proj,std::list<float> & angles)
+size_t SIRTbp::reconstructSlice(kipl::base::TImage<float,3> &proj, size_t idx, std::vector<Subset> &subsets, float center, float &residual)
 {
-    return 0L;
+    const size_t nWidth=proj.Size(0);
+    size_t sliceDims[2]={nWidth,nWidth};
+
+    kipl::base::TImage<float,2> x(sliceDims);
+    kipl::base::TImage<float,2> forward;
+    kipl::base::TImage<float,2> update;
+    x=0.0f;
+
+    // Sinograms of the subsets
+    std::vector<kipl::base::TImage<float,2>> sinograms(subsets.size());
+    double dataNorm=0.0;
+    for (size_t s=0; s<subsets.size(); ++s) {
+        size_t sinoDims[2]={nWidth,subsets[s].index.size()};
+        sinograms[s].Resize(sinoDims);
+
+        for (size_t i=0; i<subsets[s].index.size(); ++i) {
+            const float *pProj=proj.GetLinePtr(idx,subsets[s].index[i]);
+            std::copy_n(pProj,nWidth,sinograms[s].GetLinePtr(i));
+
+            for (size_t j=0; j<nWidth; ++j)
+                dataNorm+=static_cast<double>(pProj[j])*pProj[j];
+        }
+    }
+
+    residual=0.0f;
+    double previousResidual=std::numeric_limits<double>::max();
+    size_t nIteration=0;
+
+    if (dataNorm!=0.0) {
+        while (nIteration<static_cast<size_t>(m_nIterations)) {
+            ++nIteration;
+            double residualNorm=0.0;
+
+            for (size_t s=0; s<subsets.size(); ++s) {
+                Subset &subset=subsets[s];
+
+                m_fp->project(x,subset.angles,forward);
+
+                const float *pSino=sinograms[s].GetDataPtr();
+                const float *pRow=subset.rowWeights.GetDataPtr();
+                float *pForward=forward.GetDataPtr();
+                for (size_t i=0; i<forward.Size(); ++i) {
+                    const float diff=pSino[i]-pForward[i];
+                    residualNorm+=static_cast<double>(diff)*diff;
+                    pForward[i]=diff*pRow[i];
+                }
+
+                m_bp->backproject(forward,center,subset.angles,update);
+
+                const float *pColumn=subset.columnWeights.GetDataPtr();
+                const float *pUpdate=update.GetDataPtr();
+                float *pX=x.GetDataPtr();
+                if (m_bNonNegative) {
+                    for (size_t i=0; i<x.Size(); ++i)
+                        pX[i]=std::max(0.0f,pX[i]+pColumn[i]*pUpdate[i]);
+                }
+                else {
+                    for (size_t i=0; i<x.Size(); ++i)
+                        pX[i]+=pColumn[i]*pUpdate[i];
+                }
+            }
+
+            // The residual is accumulated before each subset update, for SIRT it is the residual of the previous iterate
+            const double relativeResidual=std::sqrt(residualNorm/dataNorm);
+            residual=static_cast<float>(relativeResidual);
+
+            // A zero tolerance runs all iterations, also when the residual increases
+            if ((0.0f<m_fTolerance) && ((previousResidual-relativeResidual)<m_fTolerance*previousResidual))
+                break;
+
+            previousResidual=relativeResidual;
+        }
+    }
+
+    std::copy_n(x.GetDataPtr(),x.Size(),volume.GetLinePtr(0,idx));
+
+    return nIteration;
 }
+
 /// Sets up the back-projector with new parameters
 /// \param config Reconstruction parameter set
 /// \param parameters Additional set of configuration parameters
 int SIRTbp::Configure(ReconConfig config, std::map<std::string, std::string> parameters)
 {
-    mConfig=config;
+    IterativeReconBase::Configure(config,parameters);
+
+    m_fAlpha       = GetFloatParameter(parameters,"relaxation");
+    m_nSubsets     = GetIntParameter(parameters,"subsets");
+    m_fTolerance   = GetFloatParameter(parameters,"tolerance");
+    m_bNonNegative = kipl::strings::string2bool(GetStringParameter(parameters,"nonnegative"));
+
+    if (m_nIterations<1)
+        throw ReconException("SIRTbp needs at least one iteration",__FILE__,__LINE__);
+
+    if ((m_fAlpha<=0.0f) || (2.0f<=m_fAlpha))
+        throw ReconException("The SIRT relaxation must be in the interval (0,2)",__FILE__,__LINE__);
+
+    if (m_nSubsets<1)
+        throw ReconException("SIRTbp needs at least one subset",__FILE__,__LINE__);
 
     return 0;
 }
@@ -110,22 +260,10 @@ std::map<std::string, std::string> SIRTbp::GetParameters()
 
     parameters=IterativeReconBase::GetParameters();
 
+    parameters["relaxation"]  = kipl::strings::value2string(m_fAlpha);
+    parameters["subsets"]     = kipl::strings::value2string(m_nSubsets);
+    parameters["tolerance"]   = kipl::strings::value2string(m_fTolerance);
+    parameters["nonnegative"] = kipl::strings::bool2string(m_bNonNegative);
 
     return parameters;
 }
-
-/// Sets the region of interest on the projections.
-/// \param roi A four-entry array of ROI coordinates (x0,y0,x1,y1)
-void SIRTbp::SetROI(size_t *roi)
-{
-    IterativeReconBase::SetROI(roi);
-}
-
-/// Get the histogram of the reconstructed matrix. This should be calculated in the masked region only to avoid unnescessary zero counts.
-/// \param x the bin values of the x axis
-/// \param y the histogram bins
-/// \param N number of bins
-void SIRTbp::GetHistogram(float *x, size_t *y, size_t N)
-{
-
-}
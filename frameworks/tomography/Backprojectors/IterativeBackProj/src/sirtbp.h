@@ -5,24 +5,24 @@
 #include "iterativereconbase.h"
 #include <ParameterHandling.h>
 
+#include <vector>
+#include <list>
+
+/// Simultaneous iterative reconstruction (SIRT) and its ordered subset variant (OS-SART).
+///
+/// Each slice is reconstructed by x <- x + lambda*C*A'*(R*(b-A*x)), where A is the Joseph forward projector,
+/// A' the matched back-projector, and R and C the inverse row and column sums of A. With more than one subset
+/// the update is made for one subset of the angles at a time, the subsets are interleaved in angle and visited
+/// in bit-reversed order to keep consecutive subsets far apart. The row and column sums only depend on the
+/// geometry and are computed once per block of slices, the slices are then reconstructed in parallel.
+/// The iterations of a slice stop early when the relative residual decreases less than the tolerance, a zero
+/// tolerance disables the early stop.
 class SIRTbp : public IterativeReconBase
 {
 public:
     SIRTbp(kipl::interactors::InteractionBase *interactor=nullptr);
     ~SIRTbp();
 
-    /// Add one projection to the back-projection stack
-    /// \param proj The projection
-    /// \param angle Acquisition angle
-    /// \param weight Intensity scaling factor for interpolation when the angles are non-uniformly distributed
-    /// \param bLastProjection termination signal. When true the back-projeciton is finalized.
-    virtual size_t Process(kipl::base::TImage<float,2> proj, float angle, float weight, bool bLastProjection);
-
-    /// Starts the back-projection process of projections stored as a 3D volume.
-    /// \param proj The projection data
-    /// \param parameters A list of parameters, the list shall contain at least the parameters angles and weights each containing a space separated list with as many values as projections
-    virtual size_t Process(kipl::base::TImage<float,3> proj, std::map<std::string, std::string> parameters);
-
     /// Sets up the back-projector with new parameters
     /// \param config Reconstruction parameter set
     /// \param parameters Additional set of configuration parameters
@@ -35,19 +35,36 @@ public:
     /// \returns The parameter list
     virtual std::map<std::string, std::string> GetParameters();
 
-    /// Sets the region of interest on the projections.
-    /// \param roi A four-entry array of ROI coordinates (x0,y0,x1,y1)
-    virtual void SetROI(size_t *roi);
-
-    /// Get the histogram of the reconstructed matrix. This should be calculated in the masked region only to avoid unnescessary zero counts.
-    /// \param x the bin values of the x axis
-    /// \param y the histogram bins
-    /// \param N number of bins
-    virtual void GetHistogram(float *x, size_t *y, size_t N);
-
 protected:
+    /// The projection data and the precomputed weights of an angle subset
+    struct Subset {
+        std::vector<size_t> index;                  ///< Projection indices in the subset
+        std::list<float> angles;                    ///< Angles of the projections in the subset
+        kipl::base::TImage<float,2> rowWeights;     ///< Inverse row sums, one value per ray
+        kipl::base::TImage<float,2> columnWeights;  ///< Relaxation divided by the column sums, one value per pixel
+    };
+
     virtual size_t reconstruct(kipl::base::TImage<float,3> proj,std::list<float> & angles);
-    float m_fAlpha;
+
+    /// Splits the angles in interleaved subsets and computes their weights
+    /// \param angles The projection angles
+    /// \param width Width of the projections
+    /// \param center Position of the rotation axis on the projections
+    std::vector<Subset> buildSubsets(const std::list<float> &angles, size_t width, float center);
+
+    /// Reconstructs one slice
+    /// \param proj The projections, the slice is a row of the projections.
+    /// \param idx Index of the slice
+    /// \param subsets The subsets in the order they are visited
+    /// \param center Position of the rotation axis on the projections
+    /// \param residual Receives the relative residual of the last iteration
+    /// \returns The number of iterations used
+    size_t reconstructSlice(kipl::base::TImage<float,3> &proj, size_t idx, std::vector<Subset> &subsets, float center, float &residual);
+
+    float m_fAlpha;         ///< Relaxation factor
+    int   m_nSubsets;       ///< Number of ordered subsets, one gives SIRT
+    float m_fTolerance;     ///< Stop when the relative residual decreases less than this fraction, zero runs all iterations
+    bool  m_bNonNegative;   ///< Clamp negative values after each update
 };
 
 #endif // SIRTBP_H
@@ -8,12 +8,15 @@
 #include <sstream>
 #include <fstream>
 #include <limits>
+#include <algorithm>
 
 #include <ParameterHandling.h>
 
 #include <strings/miscstring.h>
 #include <base/tpermuteimage.h>
+#include <base/histogramengine.h>
 #include <math/mathconstants.h>
+#include <profile/Tracer.h>
 
 #define USE_PROJ_PADDING
 
@@ -112,7 +115,10 @@ size_t StdBackProjectorBase::Process(kipl::base::TImage<float,2> proj, float ang
         msg.str("");
         msg<<"Counter="<<nProjCounter<<", buffer size="<<nProjectionBufferSize<<" last "<<(bLastProjection ? "True" : "False");
         logger(logger.LogDebug,msg.str());
-		this->BackProject();
+        {
+            KIPL_TRACE_SCOPE("BackProject","backprojection");
+            this->BackProject();
+        }
 		nProjCounter=0;
 	}
 
@@ -251,31 +257,36 @@ void StdBackProjectorBase::ChangeMaskValue(float x)
 
 void StdBackProjectorBase::GetHistogram(float *axis, size_t *hist,size_t nBins)
 {
-	float matrixMin=Min();
-	float matrixMax=Max();
+	if (MatrixAlignment==StdBackProjectorBase::MatrixXYZ) {
+		logger(kipl::logging::Logger::LogWarning,"GetHistogram is not implemented for MatrixXYZ");
+		throw ReconException("GetHistogram is not implemented for MatrixXYZ",__FILE__,__LINE__);
+	}
+
+	// The lines of a mask row are contiguous, each row is added as one block
+	const size_t lineLength=volume.Size(0);
+	kipl::base::HistogramEngine<float> engine(0);
+	for (size_t y=0; y<mask.size(); y++)
+		if (mask[y].first<mask[y].second)
+			engine.put(volume.GetLinePtr(mask[y].first,y),(mask[y].second-mask[y].first)*lineLength);
+
+	kipl::math::Statistics stats=engine.statistics();
+	float matrixMin=static_cast<float>(stats.Min());
+	float matrixMax=static_cast<float>(stats.Max());
 	ostringstream msg;
 
 	msg<<"Preparing histogram; #bins: "<<nBins<<", Min: "<<matrixMin<<", Max: "<<matrixMax;
 	logger(kipl::logging::Logger::LogMessage,msg.str());
 
-	memset(axis,0,sizeof(float)*nBins);
-	memset(hist,0,sizeof(size_t)*nBins);
 	float scale=(matrixMax-matrixMin)/(nBins+1);
-	float invScale=1.0f/scale;
-	size_t index=0;
-	for (size_t y=0; y<mask.size(); y++) {
-		for (size_t x=mask[y].first; x<mask[y].second; x++) {
-			float *pLine=volume.GetLinePtr(x,y);
-			for (size_t z=0; z<volume.Size(0); z++) { 
-				index=static_cast<size_t>(invScale*(pLine[z]-matrixMin));
-                if (pLine[z]<matrixMin)
-					index=0;
-				else if (nBins<=index)
-					index=nBins-1;
-				hist[index]++;
-			}
-		}
-	}
+	if (!(0.0f<scale))
+		scale=1.0f;
+
+	engine.setBins(nBins,matrixMin,matrixMin+nBins*static_cast<double>(scale),kipl::base::HistogramClampOutside);
+	for (size_t y=0; y<mask.size(); y++)
+		if (mask[y].first<mask[y].second)
+			engine.put(volume.GetLinePtr(mask[y].first,y),(mask[y].second-mask[y].first)*lineLength);
+
+	std::copy(engine.histogram().begin(),engine.histogram().end(),hist);
 
 	axis[0]=matrixMin+scale/2.0f;
 	for (size_t i=1; i<nBins; i++)
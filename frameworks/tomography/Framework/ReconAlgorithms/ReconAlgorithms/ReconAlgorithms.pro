@@ -55,7 +55,8 @@ SOURCES += reconalgorithms.cpp \
     basicbackprojector.cpp \
     nnforwardprojector.cpp \
     reconalgorithmexception.cpp \
-    linearforwardprojector.cpp
+    linearforwardprojector.cpp \
+    josephprojector.cpp
 
 HEADERS += reconalgorithms.h\
         reconalgorithms_global.h \
@@ -65,7 +66,8 @@ HEADERS += reconalgorithms.h\
     basicbackprojector.h \
     nnforwardprojector.h \
     reconalgorithmexception.h \
-    linearforwardprojector.h
+    linearforwardprojector.h \
+    josephprojector.h
 
 unix {
     target.path = /usr/lib
@@ -1,5 +1,12 @@
 #include "basicbackprojector.h"
 
+#include <cmath>
+#include <algorithm>
+#include <math/mathconstants.h>
+#include <utilities/threadpool.h>
+
+#include "reconalgorithmexception.h"
+
 BasicBackProjector::BasicBackProjector() :
     BackProjectorBase("BasicBackProjector")
 {
@@ -13,8 +20,150 @@ BasicBackProjector::~BasicBackProjector()
 
 int BasicBackProjector::backproject(kipl::base::TImage<float,2> &proj, float center, std::list<float> & angles, kipl::base::TImage<float,2> &slice)
 {
+    if (proj.Size(1)!=angles.size())
+        throw ReconAlgorithmException("The number of angles doesn't match the number of projection lines",__FILE__,__LINE__);
+
+    int t,r,m,n,mmin,mmax,nmin,nmax;
+    int R,M,N;
+    float x_min,rhooffset,Delta_rho,costheta,sintheta;
+    float rho_min,theta,alpha,beta,nfloat,mfloat,w,rho,value;
+    float Delta_x,betap,eps;
+    double dXsinT, dXdsinT, dXcosT, dXdcosT;
+
+    size_t dims[2]={proj.Size(0), proj.Size(0)};
+    slice.Resize(dims);
+    slice=0.0f;
+
+    eps=1e-4;
+    R=proj.Size(0);
+    M=N=slice.Size(0);
+
+    rho_min=-center;
+    Delta_rho=1;
+
+    x_min=-M/2;
+    Delta_x=1;
+
+    float *pSlice=slice.GetDataPtr();
+    auto angle=angles.begin();
+
+    // Same traversal as LinearForwardProjector::project, the interpolation weights are used to scatter the values
+    for (t=0; angle!=angles.end(); t++, angle++)
+    {
+        theta=*angle*fPi/180.0f;
+        sintheta=sin(theta);
+        costheta=cos(theta);
+        rhooffset=x_min*(costheta+sintheta);
+        const float *pProj=proj.GetLinePtr(t);
+
+        if (fabs(sintheta)>sqrt(0.5))
+        {
+            alpha=-costheta/sintheta;
+
+            dXsinT=Delta_x*sintheta;
+            dXdsinT=Delta_x/fabs(sintheta);
+
+            for (r=0, rho=0; r<R; r++, rho+=Delta_rho)
+            {
+                value=pProj[r]*dXdsinT;
+                if (value==0.0f)
+                    continue;
+
+                beta=(rho+rho_min-rhooffset)/(dXsinT);
+                betap=beta+0.5;
+                if (alpha>1e-6) {
+                    mmin=(int)ceil(-(betap-eps)/alpha);
+                    mmax=1+(int)floor((N-betap-eps)/alpha);
+                }
+                else if (alpha<-1e-6) {
+                    mmin=(int)ceil((N-betap-eps)/alpha);
+                    mmax=1+(int)floor(-(betap-eps)/alpha);
+                }
+                else {
+                    mmin=0;
+                    mmax=M;
+                }
 
+                if (mmin<0) mmin=0;
+                if (mmin>=M) mmin=M-1;
+                if (mmax>M) mmax=M;
+                nfloat=beta+mmin*alpha;
+
+                for (m=mmin; m<mmax; m++) {
+                    if ((nfloat>=0) && (nfloat<(N-1))) {
+                        n=(int)nfloat;
+                        w=nfloat-n;
+                        pSlice[n*M+m]     += (1.0f-w)*value;
+                        pSlice[(n+1)*M+m] += w*value;
+                    }
+                    nfloat+=alpha;
+                }
+            }
+        }
+        else {
+            alpha=-sintheta/costheta;
+
+            dXcosT=Delta_x*costheta;
+            dXdcosT=Delta_x/fabs(costheta);
+
+            for (r=0, rho=0; r<R; r++, rho+=Delta_rho)
+            {
+                value=pProj[r]*dXdcosT;
+                if (value==0.0f)
+                    continue;
+
+                beta=(rho+rho_min-rhooffset)/dXcosT;
+                betap=beta+0.5;
+                if (alpha>1e-6) {
+                    nmin=(int)ceil(-(betap-eps)/alpha);
+                    nmax=1+(int)floor((M-betap-eps)/alpha);
+                }
+                else if (alpha<-1e-6) {
+                    nmin=(int)ceil((M-betap-eps)/alpha);
+                    nmax=1+(int)floor(-(betap-eps)/alpha);
+                }
+                else {
+                    nmin=0;
+                    nmax=N;
+                }
+
+                if (nmin<0) nmin=0;
+                if (nmin>=N) nmin=N-1;
+                if (nmax>N) nmax=N;
+                mfloat=beta+nmin*alpha;
+
+                for (n=nmin; n<nmax; n++) {
+                    if ((mfloat>=0) && (mfloat<(M-1))) {
+                        m=(int)mfloat;
+                        w=mfloat-m;
+                        pSlice[n*M+m]   += (1.0f-w)*value;
+                        pSlice[n*M+m+1] += w*value;
+                    }
+                    mfloat+=alpha;
+                }
+            }
+        }
+    }
 
     return 0;
 }
 
+int BasicBackProjector::backproject(kipl::base::TImage<float,3> &proj, float center, std::list<float> & angles, kipl::base::TImage<float,3> &slices)
+{
+    size_t dims[3]={proj.Size(0), proj.Size(0), proj.Size(2)};
+    slices.Resize(dims);
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,proj.Size(2),
+        [&](size_t first, size_t last) {
+            kipl::base::TImage<float,2> sino(proj.Dims());
+            kipl::base::TImage<float,2> slice;
+
+            for (size_t i=first; i<last; ++i) {
+                std::copy_n(proj.GetLinePtr(0,i),sino.Size(),sino.GetDataPtr());
+                backproject(sino,center,angles,slice);
+                std::copy_n(slice.GetDataPtr(),slice.Size(),slices.GetLinePtr(0,i));
+            }
+        },1);
+
+    return 0;
+}
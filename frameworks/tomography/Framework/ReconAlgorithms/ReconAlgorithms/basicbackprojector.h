@@ -4,13 +4,30 @@
 #include "reconalgorithms_global.h"
 #include "backprojectorbase.h"
 
+/// \brief Back-projector that is the transpose of the LinearForwardProjector.
+///
+/// The rays are traversed as in the forward projection and each sinogram value is distributed to the two
+/// pixels that were interpolated by the forward projector. Used together they form a matched projector pair
+/// as required by the algebraic reconstruction methods.
 class RECONALGORITHMSSHARED_EXPORT BasicBackProjector: public BackProjectorBase
 {
 public:
     BasicBackProjector();
     ~BasicBackProjector();
 
+    /// \brief Back-projects a sinogram
+    /// \param proj The sinogram with one projection line per angle
+    /// \param center Position of the rotation axis on the projection lines
+    /// \param angles The projection angles in degrees
+    /// \param slice Receives the square slice, it has the width of the projection lines.
     virtual int backproject(kipl::base::TImage<float,2> &proj, float center, std::list<float> & angles, kipl::base::TImage<float,2> &slice);
+
+    /// \brief Back-projects a stack of sinograms, the slices are processed in parallel.
+    /// \param proj The sinograms stored as xy-slices
+    /// \param center Position of the rotation axis on the projection lines
+    /// \param angles The projection angles in degrees
+    /// \param slices Receives one slice per sinogram
+    virtual int backproject(kipl::base::TImage<float,3> &proj, float center, std::list<float> & angles, kipl::base::TImage<float,3> &slices);
 };
 
 #endif // BASICBACKPROJECTOR_H
@@ -3,10 +3,19 @@
 
 ForwardProjectorBase::ForwardProjectorBase(std::string name) :
     logger(name),
-    m_sName(name)
+    m_sName(name),
+    m_cx(0.0f),
+    m_cy(0.0f),
+    m_PixelSize(1.0f),
+    m_fCenter(-1.0f)
 {
 }
 
+ForwardProjectorBase::~ForwardProjectorBase()
+{
+
+}
+
 int ForwardProjectorBase::buildMask(const size_t *dims)
 {
     if (dims[0]!=dims[1])
@@ -16,11 +16,16 @@ protected:
 
 public:
     ForwardProjectorBase(std::string name = "ForwardProjectorBase");
+    virtual ~ForwardProjectorBase();
 
     virtual int project(kipl::base::TImage<float,2> &slice, std::list<float> & angles, kipl::base::TImage<float,2> &proj) = 0;
     virtual int project(kipl::base::TImage<float,3> &slice, std::list<float> & angles, kipl::base::TImage<float,3> &proj) = 0;
 
     void setPixelSize(float size) { m_PixelSize=size; }
+
+    /// \brief Sets the position of the rotation axis on the projections
+    /// \param center The center in pixels, a negative value places the axis in the middle of the projection.
+    void setCenter(float center) { m_fCenter=center; }
 protected:
     int buildMask(const size_t *dims);
 
@@ -28,6 +33,7 @@ protected:
     float m_cx;
     float m_cy;
     float m_PixelSize; // Size of the pixels in the projections
+    float m_fCenter;   ///< Position of the rotation axis on the projections
 
 };
 
@@ -0,0 +1,402 @@
+#include "josephprojector.h"
+
+#include <cmath>
+#include <algorithm>
+#include <emmintrin.h>
+
+#include <math/mathconstants.h>
+#include <utilities/threadpool.h>
+
+#include "reconalgorithmexception.h"
+
+namespace {
+    /// Adds the interpolated samples of a line to the bins [first,last) of a projection line
+    void marchLine(const float *line, size_t N, float p0, float step, size_t first, size_t last, float *sum)
+    {
+        const __m128 vLane  = _mm_setr_ps(0.0f,1.0f,2.0f,3.0f);
+        const __m128 vP0    = _mm_set1_ps(p0);
+        const __m128 vStep  = _mm_set1_ps(step);
+        const __m128 vZero  = _mm_setzero_ps();
+        const __m128 vLimit = _mm_set1_ps(static_cast<float>(N-1));
+        alignas(16) int idx[4];
+
+        size_t r=first;
+        for (; r+4<=last; r+=4) {
+            __m128 pos  = _mm_add_ps(vP0,_mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(r)),vLane),vStep));
+            __m128 mask = _mm_and_ps(_mm_cmpge_ps(pos,vZero),_mm_cmplt_ps(pos,vLimit));
+            pos = _mm_and_ps(pos,mask); // Samples outside the line read pixel 0 and are masked
+
+            __m128i i = _mm_cvttps_epi32(pos);
+            __m128  w = _mm_sub_ps(pos,_mm_cvtepi32_ps(i));
+            _mm_store_si128(reinterpret_cast<__m128i *>(idx),i);
+
+            __m128 a = _mm_setr_ps(line[idx[0]],  line[idx[1]],  line[idx[2]],  line[idx[3]]);
+            __m128 b = _mm_setr_ps(line[idx[0]+1],line[idx[1]+1],line[idx[2]+1],line[idx[3]+1]);
+            __m128 v = _mm_add_ps(a,_mm_mul_ps(w,_mm_sub_ps(b,a)));
+
+            _mm_storeu_ps(sum+r,_mm_add_ps(_mm_loadu_ps(sum+r),_mm_and_ps(v,mask)));
+        }
+
+        const float limit=static_cast<float>(N-1);
+        for (; r<last; ++r) {
+            const float pos=p0+static_cast<float>(r)*step;
+            if ((0.0f<=pos) && (pos<limit)) {
+                const int i=static_cast<int>(pos);
+                const float w=pos-static_cast<float>(i);
+                sum[r]+=line[i]+w*(line[i+1]-line[i]);
+            }
+        }
+    }
+
+    /// Distributes the bins [first,last) of a projection line to a line, the transpose of marchLine
+    void scatterLine(float *line, size_t N, float p0, float step, size_t first, size_t last, const float *value)
+    {
+        const __m128 vLane  = _mm_setr_ps(0.0f,1.0f,2.0f,3.0f);
+        const __m128 vP0    = _mm_set1_ps(p0);
+        const __m128 vStep  = _mm_set1_ps(step);
+        const __m128 vZero  = _mm_setzero_ps();
+        const __m128 vLimit = _mm_set1_ps(static_cast<float>(N-1));
+        alignas(16) int idx[4];
+        alignas(16) float va[4];
+        alignas(16) float vb[4];
+
+        size_t r=first;
+        for (; r+4<=last; r+=4) {
+            __m128 pos  = _mm_add_ps(vP0,_mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(r)),vLane),vStep));
+            __m128 mask = _mm_and_ps(_mm_cmpge_ps(pos,vZero),_mm_cmplt_ps(pos,vLimit));
+            pos = _mm_and_ps(pos,mask);
+
+            __m128i i = _mm_cvttps_epi32(pos);
+            __m128  w = _mm_sub_ps(pos,_mm_cvtepi32_ps(i));
+            __m128  v = _mm_and_ps(_mm_loadu_ps(value+r),mask);
+            __m128  b = _mm_mul_ps(w,v);
+
+            _mm_store_si128(reinterpret_cast<__m128i *>(idx),i);
+            _mm_store_ps(va,_mm_sub_ps(v,b));
+            _mm_store_ps(vb,b);
+
+            // Neighbouring bins can hit the same pixels, the lanes are added one by one
+            for (int k=0; k<4; ++k) {
+                line[idx[k]]   += va[k];
+                line[idx[k]+1] += vb[k];
+            }
+        }
+
+        const float limit=static_cast<float>(N-1);
+        for (; r<last; ++r) {
+            const float pos=p0+static_cast<float>(r)*step;
+            if ((0.0f<=pos) && (pos<limit)) {
+                const int i=static_cast<int>(pos);
+                const float w=pos-static_cast<float>(i);
+                const float b=w*value[r];
+                line[i]   += value[r]-b;
+                line[i+1] += b;
+            }
+        }
+    }
+}
+
+JosephGeometry::JosephGeometry() :
+    m_nSize(0)
+{
+
+}
+
+void JosephGeometry::build(const std::list<float> &angles, size_t size, float center)
+{
+    if (size<2)
+        throw ReconAlgorithmException("The Joseph projector needs at least two pixels per line",__FILE__,__LINE__);
+
+    m_nSize=size;
+    m_Angles.resize(angles.size());
+
+    const int N=static_cast<int>(size);
+    const float rho_min = center<0.0f ? -(N/2) : -center;
+    const float x_min   = -(N/2);
+
+    auto it=angles.begin();
+    for (size_t i=0; i<m_Angles.size(); ++i, ++it) {
+        const float theta = *it*fPi/180.0f;
+        const float s = sin(theta);
+        const float c = cos(theta);
+        const float rhooffset = x_min*(c+s);
+
+        Angle &a=m_Angles[i];
+        a.transposed = sqrt(0.5f)<fabs(s);
+        const float d = a.transposed ? s : c;
+
+        a.alpha  = a.transposed ? -c/s : -s/c;
+        a.offset = (rho_min-rhooffset)/d;
+        a.step   = 1.0f/d;
+        a.scale  = 1.0f/fabs(d);
+    }
+
+    m_Bins.resize(2*m_Angles.size()*size);
+    size_t first=0;
+    size_t last=0;
+    for (size_t i=0; i<m_Angles.size(); ++i) {
+        for (size_t line=0; line<size; ++line) {
+            binRange(m_Angles[i],line,first,last);
+            m_Bins[2*(i*size+line)]   = static_cast<unsigned int>(first);
+            m_Bins[2*(i*size+line)+1] = static_cast<unsigned int>(last);
+        }
+    }
+}
+
+void JosephGeometry::binRange(const Angle &a, size_t line, size_t &first, size_t &last) const
+{
+    const float p0 = a.offset+static_cast<float>(line)*a.alpha;
+    const float t0 = -p0/a.step;
+    const float t1 = (static_cast<float>(m_nSize-1)-p0)/a.step;
+
+    // One bin of margin on each side, the kernels check the positions
+    const long lo = static_cast<long>(floor(std::min(t0,t1)))-1;
+    const long hi = static_cast<long>(ceil(std::max(t0,t1)))+2;
+    const long N  = static_cast<long>(m_nSize);
+
+    first = static_cast<size_t>(std::min(N,std::max(0L,lo)));
+    last  = static_cast<size_t>(std::min(N,std::max(0L,hi)));
+    if (last<first)
+        last=first;
+}
+
+JosephGeometryCache::JosephGeometryCache(size_t capacity) :
+    m_nCapacity(std::max(capacity,size_t(1)))
+{
+
+}
+
+std::shared_ptr<const JosephGeometry> JosephGeometryCache::get(const std::list<float> &angles, size_t size, float center)
+{
+    std::promise<std::shared_ptr<const JosephGeometry>> promise;
+    std::shared_future<std::shared_ptr<const JosephGeometry>> geometry;
+    bool bBuild=false;
+
+    auto sameGeometry=[&](const Entry &e) {
+        return (e.size==size) && (e.center==center) && (e.angles.size()==angles.size())
+                && std::equal(e.angles.begin(),e.angles.end(),angles.begin());
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        auto it=std::find_if(m_Entries.begin(),m_Entries.end(),sameGeometry);
+
+        if (it!=m_Entries.end()) {
+            m_Entries.splice(m_Entries.begin(),m_Entries,it);
+            geometry=it->geometry;
+        }
+        else {
+            geometry=promise.get_future().share();
+            m_Entries.push_front(Entry{std::vector<float>(angles.begin(),angles.end()),size,center,geometry});
+            bBuild=true;
+        }
+    }
+
+    // The tables are built outside the lock, threads requesting the same geometry wait for the future
+    if (bBuild) {
+        try {
+            std::shared_ptr<JosephGeometry> tables=std::make_shared<JosephGeometry>();
+            tables->build(angles,size,center);
+            promise.set_value(tables);
+        }
+        catch (...) {
+            // The failed entry is removed to let the next request try again
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Entries.remove_if(sameGeometry);
+            }
+            promise.set_exception(std::current_exception());
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        while (m_nCapacity<m_Entries.size())
+            m_Entries.pop_back();
+    }
+
+    return geometry.get();
+}
+
+size_t JosephGeometryCache::size()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_Entries.size();
+}
+
+JosephForwardProjector::JosephForwardProjector() :
+    ForwardProjectorBase("JosephForwardProjector")
+{
+
+}
+
+JosephForwardProjector::~JosephForwardProjector()
+{
+
+}
+
+int JosephForwardProjector::project(kipl::base::TImage<float,2> &slice, std::list<float> & angles, kipl::base::TImage<float,2> &proj)
+{
+    if (slice.Size(0)!=slice.Size(1))
+        throw ReconAlgorithmException("Input slice does not have same number of rows as columns",__FILE__,__LINE__);
+
+    std::shared_ptr<const JosephGeometry> geometry=m_Geometry.get(angles,slice.Size(0),m_fCenter);
+    projectSlice(*geometry,slice,proj);
+
+    return 0;
+}
+
+void JosephForwardProjector::projectSlice(const JosephGeometry &geometry, kipl::base::TImage<float,2> &slice, kipl::base::TImage<float,2> &proj)
+{
+    const size_t N=geometry.width();
+
+    size_t dims[2]={N, geometry.size()};
+    proj.Resize(dims);
+    proj=0.0f;
+
+    // The columns are sampled along the lines of a transposed copy
+    kipl::base::TImage<float,2> transposed(slice.Dims());
+    const float *pSlice=slice.GetDataPtr();
+    float *pTransposed=transposed.GetDataPtr();
+    for (size_t y=0; y<N; ++y)
+        for (size_t x=0; x<N; ++x)
+            pTransposed[x*N+y]=pSlice[y*N+x];
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,geometry.size(),
+        [&](size_t begin, size_t end) {
+            size_t first=0;
+            size_t last=0;
+            for (size_t i=begin; i<end; ++i) {
+                const JosephGeometry::Angle &a=geometry[i];
+                const float *pImg = a.transposed ? pTransposed : pSlice;
+                float *pProj=proj.GetLinePtr(i);
+
+                for (size_t line=0; line<N; ++line) {
+                    geometry.bins(i,line,first,last);
+                    marchLine(pImg+line*N,N,a.offset+static_cast<float>(line)*a.alpha,a.step,first,last,pProj);
+                }
+
+                for (size_t r=0; r<N; ++r)
+                    pProj[r]*=a.scale;
+            }
+        });
+}
+
+int JosephForwardProjector::project(kipl::base::TImage<float,3> &slice, std::list<float> & angles, kipl::base::TImage<float,3> &proj)
+{
+    if (slice.Size(0)!=slice.Size(1))
+        throw ReconAlgorithmException("Input slice does not have same number of rows as columns",__FILE__,__LINE__);
+
+    // The tables are built once for all slices
+    std::shared_ptr<const JosephGeometry> geometry=m_Geometry.get(angles,slice.Size(0),m_fCenter);
+
+    size_t dims[3]={slice.Size(0), angles.size(), slice.Size(2)};
+    proj.Resize(dims);
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,slice.Size(2),
+        [&](size_t first, size_t last) {
+            kipl::base::TImage<float,2> img(slice.Dims());
+            kipl::base::TImage<float,2> sino;
+
+            for (size_t i=first; i<last; ++i) {
+                std::copy_n(slice.GetLinePtr(0,i),img.Size(),img.GetDataPtr());
+                projectSlice(*geometry,img,sino);
+                std::copy_n(sino.GetDataPtr(),sino.Size(),proj.GetLinePtr(0,i));
+            }
+        },1);
+
+    return 0;
+}
+
+JosephBackProjector::JosephBackProjector() :
+    BackProjectorBase("JosephBackProjector")
+{
+
+}
+
+JosephBackProjector::~JosephBackProjector()
+{
+
+}
+
+int JosephBackProjector::backproject(kipl::base::TImage<float,2> &proj, float center, std::list<float> & angles, kipl::base::TImage<float,2> &slice)
+{
+    if (proj.Size(1)!=angles.size())
+        throw ReconAlgorithmException("The number of angles doesn't match the number of projection lines",__FILE__,__LINE__);
+
+    std::shared_ptr<const JosephGeometry> geometry=m_Geometry.get(angles,proj.Size(0),center);
+    backprojectSlice(*geometry,proj,slice);
+
+    return 0;
+}
+
+void JosephBackProjector::backprojectSlice(const JosephGeometry &geometry, kipl::base::TImage<float,2> &proj, kipl::base::TImage<float,2> &slice)
+{
+    const size_t N=geometry.width();
+
+    // The ray length is applied once per projection value
+    kipl::base::TImage<float,2> values(proj.Dims());
+    for (size_t i=0; i<geometry.size(); ++i) {
+        const float *pProj=proj.GetLinePtr(i);
+        float *pValues=values.GetLinePtr(i);
+        for (size_t r=0; r<N; ++r)
+            pValues[r]=pProj[r]*geometry[i].scale;
+    }
+
+    size_t dims[2]={N,N};
+    kipl::base::TImage<float,2> rows(dims);
+    kipl::base::TImage<float,2> columns(dims);
+    rows=0.0f;
+    columns=0.0f;
+
+    // Each task owns a range of lines in both buffers
+    kipl::utilities::ThreadPool::global().parallel_for(0,N,
+        [&](size_t begin, size_t end) {
+            size_t first=0;
+            size_t last=0;
+            for (size_t line=begin; line<end; ++line) {
+                float *pRow    = rows.GetLinePtr(line);
+                float *pColumn = columns.GetLinePtr(line);
+
+                for (size_t i=0; i<geometry.size(); ++i) {
+                    const JosephGeometry::Angle &a=geometry[i];
+                    geometry.bins(i,line,first,last);
+                    scatterLine(a.transposed ? pColumn : pRow,N,a.offset+static_cast<float>(line)*a.alpha,a.step,first,last,values.GetLinePtr(i));
+                }
+            }
+        });
+
+    slice.Resize(dims);
+    const float *pRows=rows.GetDataPtr();
+    const float *pColumns=columns.GetDataPtr();
+    float *pSlice=slice.GetDataPtr();
+    for (size_t y=0; y<N; ++y)
+        for (size_t x=0; x<N; ++x)
+            pSlice[y*N+x]=pRows[y*N+x]+pColumns[x*N+y];
+}
+
+int JosephBackProjector::backproject(kipl::base::TImage<float,3> &proj, float center, std::list<float> & angles, kipl::base::TImage<float,3> &slices)
+{
+    if (proj.Size(1)!=angles.size())
+        throw ReconAlgorithmException("The number of angles doesn't match the number of projection lines",__FILE__,__LINE__);
+
+    // The tables are built once for all sinograms
+    std::shared_ptr<const JosephGeometry> geometry=m_Geometry.get(angles,proj.Size(0),center);
+
+    size_t dims[3]={proj.Size(0), proj.Size(0), proj.Size(2)};
+    slices.Resize(dims);
+
+    kipl::utilities::ThreadPool::global().parallel_for(0,proj.Size(2),
+        [&](size_t first, size_t last) {
+            kipl::base::TImage<float,2> sino(proj.Dims());
+            kipl::base::TImage<float,2> slice;
+
+            for (size_t i=first; i<last; ++i) {
+                std::copy_n(proj.GetLinePtr(0,i),sino.Size(),sino.GetDataPtr());
+                backprojectSlice(*geometry,sino,slice);
+                std::copy_n(slice.GetDataPtr(),slice.Size(),slices.GetLinePtr(0,i));
+            }
+        },1);
+
+    return 0;
+}
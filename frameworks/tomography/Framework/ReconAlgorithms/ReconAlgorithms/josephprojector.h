@@ -0,0 +1,172 @@
+#ifndef JOSEPHPROJECTOR_H
+#define JOSEPHPROJECTOR_H
+
+#include "reconalgorithms_global.h"
+#include "forwardprojectorbase.h"
+#include "backprojectorbase.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <list>
+
+/// \brief Per-angle ray tables shared by the Joseph forward and back projectors.
+///
+/// A ray of a parallel beam projection is sampled once per matrix line along the axis that is closest to the
+/// ray direction, the sample is linearly interpolated between the two nearest pixels on the line. The geometry
+/// is the same as in the LinearForwardProjector. For angle a, line l, and detector bin r the sample position
+/// on the line is offset + l*alpha + r*step. Rays closer to the y-axis walk the columns of the matrix, they
+/// are sampled in a transposed copy of the slice to keep the memory accesses along the lines.
+///
+/// The bins that a line contributes to are also tabulated per angle and line, the projectors keep the tables
+/// of the recently used geometries and only build them for new angles, sizes or centers.
+class RECONALGORITHMSSHARED_EXPORT JosephGeometry
+{
+public:
+    /// \brief The sampling parameters of one angle
+    struct Angle {
+        float offset;       ///< Sample position of bin 0 on line 0
+        float alpha;        ///< Position increment from one line to the next
+        float step;         ///< Position increment from one bin to the next
+        float scale;        ///< Length of the ray segment per line
+        bool  transposed;   ///< True if the rays walk the columns
+    };
+
+    JosephGeometry();
+
+    /// \brief Computes the tables
+    /// \param angles Projection angles in degrees
+    /// \param size Width of the slice and the projections
+    /// \param center Position of the rotation axis on the projections, a negative value places it in the middle.
+    void build(const std::list<float> &angles, size_t size, float center);
+
+    /// \returns the number of angles
+    size_t size() const { return m_Angles.size(); }
+
+    /// \returns the sampling parameters of angle idx
+    const Angle & operator[](size_t idx) const { return m_Angles[idx]; }
+
+    /// \returns the width of the slice and the projections
+    size_t width() const { return m_nSize; }
+
+    /// \brief Finds the bins that have a sample position inside [0,size-1) on a line, the range may include a few bins more.
+    /// \param a Sampling parameters of the angle
+    /// \param line The matrix line
+    /// \param first Receives the first bin
+    /// \param last Receives one past the last bin
+    void binRange(const Angle &a, size_t line, size_t &first, size_t &last) const;
+
+    /// \brief Looks up the bin range of a line in the tables.
+    /// \param angle Index of the angle
+    /// \param line The matrix line
+    /// \param first Receives the first bin
+    /// \param last Receives one past the last bin
+    void bins(size_t angle, size_t line, size_t &first, size_t &last) const
+    {
+        const size_t idx=2*(angle*m_nSize+line);
+        first=m_Bins[idx];
+        last=m_Bins[idx+1];
+    }
+
+protected:
+    std::vector<Angle> m_Angles;
+    std::vector<unsigned int> m_Bins;   ///< First and one past the last bin for each angle and line
+    size_t m_nSize;
+};
+
+/// \brief Keeps the tables of the most recently used geometries for a projector, it can be used from several threads.
+///
+/// Solvers with ordered subsets project each subset with its own angles, every subset keeps its tables as long
+/// as the capacity allows. A geometry is built once also if several threads request it at the same time, the
+/// other threads wait for it without blocking the requests for cached geometries.
+class RECONALGORITHMSSHARED_EXPORT JosephGeometryCache
+{
+public:
+    /// \brief Creates an empty cache
+    /// \param capacity The largest number of geometries that are kept, the least recently used is removed first.
+    JosephGeometryCache(size_t capacity=64);
+
+    /// \brief Returns the tables for a geometry, they are only built if the geometry isn't in the cache.
+    /// \param angles Projection angles in degrees
+    /// \param size Width of the slice and the projections
+    /// \param center Position of the rotation axis on the projections
+    /// \returns the tables, they stay valid while the pointer is held also if the geometry is removed from the cache.
+    std::shared_ptr<const JosephGeometry> get(const std::list<float> &angles, size_t size, float center);
+
+    /// \returns the number of cached geometries
+    size_t size();
+
+private:
+    struct Entry {
+        std::vector<float> angles;
+        size_t size;
+        float center;
+        std::shared_future<std::shared_ptr<const JosephGeometry>> geometry;
+    };
+
+    std::mutex m_Mutex;
+    std::list<Entry> m_Entries; ///< The most recently used geometry first
+    size_t m_nCapacity;
+};
+
+/// \brief Forward projector using Joseph's method with SSE2 ray marching.
+///
+/// The samples of four neighbouring detector bins are interpolated at once, the angles are projected in parallel
+/// on the shared thread pool and the 3D overload also runs the slices in parallel. JosephBackProjector is the
+/// exact transpose of this projector.
+class RECONALGORITHMSSHARED_EXPORT JosephForwardProjector : public ForwardProjectorBase
+{
+public:
+    JosephForwardProjector();
+    ~JosephForwardProjector();
+
+    /// \brief Projects a slice
+    /// \param slice The square slice
+    /// \param angles The projection angles in degrees
+    /// \param proj Receives the sinogram with one line per angle
+    virtual int project(kipl::base::TImage<float,2> &slice, std::list<float> & angles, kipl::base::TImage<float,2> &proj);
+
+    /// \brief Projects a stack of slices
+    /// \param slice The slices stored as xy-slices
+    /// \param angles The projection angles in degrees
+    /// \param proj Receives one sinogram per slice
+    virtual int project(kipl::base::TImage<float,3> &slice, std::list<float> & angles, kipl::base::TImage<float,3> &proj);
+
+private:
+    void projectSlice(const JosephGeometry &geometry, kipl::base::TImage<float,2> &slice, kipl::base::TImage<float,2> &proj);
+
+    JosephGeometryCache m_Geometry;
+};
+
+/// \brief Back projector that is the transpose of the JosephForwardProjector.
+///
+/// The lines of the matrix are distributed over the threads, a line receives the contributions of all angles
+/// from one thread and no synchronisation of the updates is needed.
+class RECONALGORITHMSSHARED_EXPORT JosephBackProjector : public BackProjectorBase
+{
+public:
+    JosephBackProjector();
+    ~JosephBackProjector();
+
+    /// \brief Back-projects a sinogram
+    /// \param proj The sinogram with one projection line per angle
+    /// \param center Position of the rotation axis on the projection lines
+    /// \param angles The projection angles in degrees
+    /// \param slice Receives the square slice, it has the width of the projection lines.
+    virtual int backproject(kipl::base::TImage<float,2> &proj, float center, std::list<float> & angles, kipl::base::TImage<float,2> &slice);
+
+    /// \brief Back-projects a stack of sinograms
+    /// \param proj The sinograms stored as xy-slices
+    /// \param center Position of the rotation axis on the projection lines
+    /// \param angles The projection angles in degrees
+    /// \param slices Receives one slice per sinogram
+    virtual int backproject(kipl::base::TImage<float,3> &proj, float center, std::list<float> & angles, kipl::base::TImage<float,3> &slices);
+
+private:
+    void backprojectSlice(const JosephGeometry &geometry, kipl::base::TImage<float,2> &proj, kipl::base::TImage<float,2> &slice);
+
+    JosephGeometryCache m_Geometry;
+};
+
+#endif // JOSEPHPROJECTOR_H
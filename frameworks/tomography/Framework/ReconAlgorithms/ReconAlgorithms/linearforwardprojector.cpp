@@ -1,8 +1,11 @@
 #include "linearforwardprojector.h"
+#include <algorithm>
 #include <math/mathconstants.h>
+#include <utilities/threadpool.h>
 #include <reconalgorithmexception.h>
 
-LinearForwardProjector::LinearForwardProjector()
+LinearForwardProjector::LinearForwardProjector() :
+    ForwardProjectorBase("LinearForwardProjector")
 {
 
 }
@@ -30,7 +33,7 @@ int LinearForwardProjector::project(kipl::base::TImage<float,2> &slice, std::lis
     R=proj.Size(0);
     M=N=slice.Size(0);
 
-    rho_min=-R/2;
+    rho_min= m_fCenter<0.0f ? -R/2 : -m_fCenter;
 
     Delta_rho=1;
 
@@ -47,7 +50,7 @@ int LinearForwardProjector::project(kipl::base::TImage<float,2> &slice, std::lis
         costheta=cos(theta);
         rhooffset=x_min*(costheta+sintheta);
 
-        if (abs(sintheta)>sqrt(0.5))
+        if (fabs(sintheta)>sqrt(0.5))
         {
             alpha=-costheta/sintheta;
 
@@ -145,7 +148,21 @@ int LinearForwardProjector::project(kipl::base::TImage<float,2> &slice, std::lis
 
 int LinearForwardProjector::project(kipl::base::TImage<float,3> &slice, std::list<float> & angles, kipl::base::TImage<float,3> &proj)
 {
-    throw ReconAlgorithmException("Linear forward projection for multiple slices is not implemented",__FILE__,__LINE__);
+    size_t dims[3]={slice.Size(0), angles.size(), slice.Size(2)};
+    proj.Resize(dims);
+
+    // The slices are independent, each is projected to its own sinogram
+    kipl::utilities::ThreadPool::global().parallel_for(0,slice.Size(2),
+        [&](size_t first, size_t last) {
+            kipl::base::TImage<float,2> img(slice.Dims());
+            kipl::base::TImage<float,2> sino;
+
+            for (size_t i=first; i<last; ++i) {
+                std::copy_n(slice.GetLinePtr(0,i),img.Size(),img.GetDataPtr());
+                project(img,angles,sino);
+                std::copy_n(sino.GetDataPtr(),sino.Size(),proj.GetLinePtr(0,i));
+            }
+        },1);
 
     return 0;
 }
@@ -12,6 +12,7 @@
 #include <base/kiplenums.h>
 #include "ReconConfig.h"
 #include <interactors/interactionbase.h>
+#include <io/nexusreader.h>
 
 /// This class provides reading capabilities for the image data
 class RECONFRAMEWORKSHARED_EXPORT ProjectionReader
@@ -227,8 +228,14 @@ protected:
     void PrintCrop(std::string name, size_t *crop);
     void PrintCrop(std::string name, int *crop);
 
+    /// Gives access to the reader of a NeXus file, the file is only opened when it differs from the previous call.
+    /// \param filename The name of the NeXus file.
+    /// \returns A reader with the file open.
+    kipl::io::NexusReader & OpenNexus(const std::string &filename);
+
     kipl::profile::Timer timer; ///< Timer to measure the execution time for the reading.
     kipl::interactors::InteractionBase *m_Interactor;  ///< Reference to an interactor object.
+    kipl::io::NexusReader m_NexusReader; ///< Keeps the last NeXus file open between the reads.
 };
 
 #endif
@@ -36,6 +36,8 @@ public:
         size_t nMemory; ///< Available memory in kB.
         kipl::logging::Logger::LogLevel eLogLevel; ///< Default log level.
         bool bValidateData;
+        bool bTraceExecution; ///< Record per-stage timing spans and write a trace file after the reconstruction.
+        size_t nMaxThreads; ///< Thread budget of the processing modules, 0 uses all cores.
         std::string WriteXML(int indent=0);          ///< Serializes the settings.
 	};
 
@@ -14,6 +14,7 @@
 #include <interactors/interactionbase.h>
 #include <logging/logger.h>
 #include <base/kiplenums.h>
+#include <io/nexuswriter.h>
 #include <string>
 
 class RECONFRAMEWORKSHARED_EXPORT ProjectionBlock
@@ -107,6 +108,9 @@ protected:
 
 	bool TransferMatrix(size_t *dims);
 
+    /// \brief Creates the NeXus file the slice blocks are written to during automatic serialization, an open file is closed first.
+    void CreateVolumeWriter();
+
     void MakeExtendedROI(size_t *roi, size_t margin, size_t *extroi, size_t *margins);
     void UnpadProjections(kipl::base::TImage<float,3> &projections, size_t *roi, size_t *margins);
 	ReconConfig m_Config;
@@ -115,6 +119,7 @@ protected:
 	size_t m_FirstSlice;
     size_t m_ProjectionMargin;
 	ProjectionReader m_ProjectionReader;             //!< Instance of the projection reader
+    kipl::io::NexusVolumeWriter m_VolumeWriter;      //!< Writes the slice blocks to NeXus files during automatic serialization
 	
     std::vector<ModuleItem *> m_PreprocList;
 	BackProjItem * m_BackProjector;
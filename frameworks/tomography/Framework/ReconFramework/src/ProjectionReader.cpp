@@ -19,6 +19,7 @@
 #include <base/kiplenums.h>
 #include <base/trotate.h>
 #include <base/imagesamplers.h>
+#include <profile/Tracer.h>
 #include "../include/ReconException.h"
 #include "../include/ProjectionReader.h"
 #include "../include/ReconHelpers.h"
@@ -64,9 +65,10 @@ void ProjectionReader::GetImageSize(std::string path,
 
 void ProjectionReader::GetImageSizeNexus(string filename, float binning, size_t *dims){
     #ifdef HAVE_NEXUS
-        kipl::io::GetNexusDims(filename.c_str(), dims);
-        dims[0]/=binning;
-        dims[1]/=binning;
+        size_t nexusdims[3];
+        OpenNexus(filename).getDims(nexusdims);
+        dims[0]=nexusdims[0]/binning;
+        dims[1]=nexusdims[1]/binning;
     #else
         throw ReconException("Nexus library is not supported",__FILE__,__LINE__);
     #endif
@@ -74,6 +76,14 @@ void ProjectionReader::GetImageSizeNexus(string filename, float binning, size_t
 
 }
 
+kipl::io::NexusReader & ProjectionReader::OpenNexus(const std::string &filename)
+{
+    if (m_NexusReader.fileName()!=filename)
+        m_NexusReader.open(filename);
+
+    return m_NexusReader;
+}
+
 void ProjectionReader::GetImageSize(std::string filename, float binning, size_t *dims)
 {
 	std::map<std::string, size_t> extensions;
@@ -207,10 +217,10 @@ Read(std::string filename,
 		float binning,
 		size_t const * const nCrop)
 {
+    KIPL_TRACE_SCOPE("ProjectionReader::Read","io");
     std::ostringstream msg;
 
-    msg.str(""); msg<<"Reading : "<<filename<<", "<<flip<<", "<<rotate<<" "<<binning;
-    logger(logger.LogVerbose,msg.str());
+    KIPL_LOG(logger,logger.LogVerbose,"Reading : "<<filename<<", "<<flip<<", "<<rotate<<" "<<binning);
 
     size_t dims[8];
 	try {
@@ -446,9 +456,6 @@ kipl::base::TImage<float,2> ProjectionReader::ReadNexus(std::string filename,
 
     #ifdef HAVE_NEXUS
 
-
-           const char *fname = filename.c_str();
-
             size_t dims[2];
             try {
                 GetImageSizeNexus(filename, binning,dims);
@@ -489,7 +496,7 @@ kipl::base::TImage<float,2> ProjectionReader::ReadNexus(std::string filename,
 
 
             try {
-                kipl::io::ReadNexus(img, fname, number, pCrop);
+                OpenNexus(filename).read(img, number, pCrop);
             }
             catch (ReconException &e) {
                 throw ReconException(e.what(),__FILE__,__LINE__);
@@ -563,8 +570,6 @@ kipl::base::TImage<float, 3> ProjectionReader::ReadNexusStack(std::string filena
 
      #ifdef HAVE_NEXUS
 
-            const char *fname = filename.c_str();
-
              size_t dims[2];
              try {
                  GetImageSizeNexus(filename, binning,dims);
@@ -605,7 +610,7 @@ kipl::base::TImage<float, 3> ProjectionReader::ReadNexusStack(std::string filena
 
              size_t dim_img[3] = {pCrop[2]-pCrop[0], pCrop[3]-pCrop[1], end-start}; // img size in original coordinate
              img.Resize(dim_img);
-             kipl::io::ReadNexusStack(img, fname, start, end, pCrop);
+             OpenNexus(filename).read(img, start, end, pCrop);
 
              kipl::base::TImage<float,3> returnimg;
              size_t dims_3D[3] = {nCrop[2]-nCrop[0], nCrop[3]-nCrop[1], end-start}; // img size in rotated and binned coordinate
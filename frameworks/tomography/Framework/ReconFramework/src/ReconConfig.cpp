@@ -198,6 +198,12 @@ void ReconConfig::ParseArgv(std::vector<std::string> &args)
             if (var=="pPoint")       kipl::strings::String2Array(value,ProjectionInfo.fpPoint,2);
         }
 
+        if (group=="system")
+        {
+            if (var=="maxthreads")   System.nMaxThreads     = std::stoul(value);
+            if (var=="trace")        System.bTraceExecution = kipl::strings::string2bool(value);
+        }
+
         if (group=="matrix")
         {
             if (var=="dims")         kipl::strings::String2Array(value,MatrixInfo.nDims,3);
@@ -255,6 +261,12 @@ void ReconConfig::ParseSystem(xmlTextReaderPtr reader)
 
             if (sName=="validate")
                 System.bValidateData=kipl::strings::string2bool(sValue);
+
+            if (sName=="trace")
+                System.bTraceExecution=kipl::strings::string2bool(sValue);
+
+            if (sName=="maxthreads")
+                System.nMaxThreads=static_cast<size_t>(std::stoi(sValue));
 		}
         ret = xmlTextReaderRead(reader);
         if (xmlTextReaderDepth(reader)<depth)
@@ -555,13 +567,17 @@ std::string ReconConfig::cUserInformation::WriteXML(int indent)
 ReconConfig::cSystem::cSystem(): 
 	nMemory(1500ul),
     eLogLevel(kipl::logging::Logger::LogMessage),
-    bValidateData(false)
+    bValidateData(false),
+    bTraceExecution(false),
+    nMaxThreads(0)
 {}
 
 ReconConfig::cSystem::cSystem(const cSystem &a) : 
 	nMemory(a.nMemory), 
     eLogLevel(a.eLogLevel),
-    bValidateData(a.bValidateData)
+    bValidateData(a.bValidateData),
+    bTraceExecution(a.bTraceExecution),
+    nMaxThreads(a.nMaxThreads)
 {}
 
 ReconConfig::cSystem & ReconConfig::cSystem::operator=(const cSystem &a) 
@@ -569,6 +585,8 @@ ReconConfig::cSystem & ReconConfig::cSystem::operator=(const cSystem &a)
     nMemory       = a.nMemory;
     eLogLevel     = a.eLogLevel;
     bValidateData = a.bValidateData;
+    bTraceExecution = a.bTraceExecution;
+    nMaxThreads   = a.nMaxThreads;
 	return *this;
 }
 
@@ -581,6 +599,8 @@ std::string ReconConfig::cSystem::WriteXML(int indent)
 	str<<setw(indent+4)<<" "<<"<memory>"<<nMemory<<"</memory>"<<std::endl;
 	str<<setw(indent+4)<<"  "<<"<loglevel>"<<eLogLevel<<"</loglevel>"<<std::endl;
     str<<setw(indent+4)<<"  "<<"<validate>"<<kipl::strings::bool2string(bValidateData)<<"</validate>"<<std::endl;
+    str<<setw(indent+4)<<"  "<<"<trace>"<<kipl::strings::bool2string(bTraceExecution)<<"</trace>"<<std::endl;
+    str<<setw(indent+4)<<"  "<<"<maxthreads>"<<nMaxThreads<<"</maxthreads>"<<std::endl;
 	str<<setw(indent)  <<"  "<<"</system>"<<std::endl;
 
 	return str.str();
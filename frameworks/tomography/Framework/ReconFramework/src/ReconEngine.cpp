@@ -12,6 +12,8 @@
 #include <algorithms/datavalidator.h>
 #include <io/io_nexus.h>
 #include <io/io_stack.h>
+#include <profile/Tracer.h>
+#include <utilities/threadpool.h>
 
 #include <ParameterHandling.h>
 #include <ModuleException.h>
@@ -97,6 +99,8 @@ void ReconEngine::SetConfig(ReconConfig &config)
 
 	m_Config=config;
 
+    kipl::utilities::ThreadPool::setGlobalThreadBudget(m_Config.System.nMaxThreads);
+
     m_ProjectionMargin = config.ProjectionInfo.nMargin;
     std::string fname,ext;
 
@@ -143,51 +147,22 @@ void ReconEngine::SetConfig(ReconConfig &config)
 
 
         if (m_Config.MatrixInfo.FileType==kipl::io::NeXusfloat)
-            {
-
-            // todo here: add the MatrixRoi option
-            size_t dims[3];
-
-            if (m_Config.MatrixInfo.bUseROI){
-                dims[0] = m_Config.MatrixInfo.roi[2]-m_Config.MatrixInfo.roi[0]+1;
-                dims[1] = m_Config.MatrixInfo.roi[3]-m_Config.MatrixInfo.roi[1]+1;
-            }
-            else
-            {
-                dims[0] = (m_Config.ProjectionInfo.projection_roi[2]-m_Config.ProjectionInfo.projection_roi[0]);
-                dims[1] = dims[0];
-            }
-            dims[2] =  (m_Config.ProjectionInfo.roi[3]-m_Config.ProjectionInfo.roi[1]); // it is not necessarelly the entire dataset
-
-            kipl::base::TImage<float, 3> img;
-
-
-            std::stringstream str;
-            str.str("");
-            str<<m_Config.MatrixInfo.sDestinationPath<<m_Config.MatrixInfo.sFileMask;
-
+        {
             try
             {
-
-                kipl::io::PrepareNeXusFileFloat(str.str().c_str(), dims, res, img);
-
-            }
-            catch (ReconException &e)
-            {
-                logger(logger.LogError,"Failed to PrepareNeXusFile while configuring recon engine.");
-                throw ReconException(e.what());
+                CreateVolumeWriter();
             }
             catch (kipl::base::KiplException &e)
             {
-                logger(logger.LogError,"Failed to PrepareNeXusFile while configuring recon engine.");
+                logger(logger.LogError,"Failed to create the NeXus volume writer while configuring recon engine.");
                 throw kipl::base::KiplException(e.what());
             }
             catch (exception &e)
             {
-                logger(logger.LogError,"Failed to PrepareNeXusFile while configuring recon engine.");
+                logger(logger.LogError,"Failed to create the NeXus volume writer while configuring recon engine.");
                 throw std::runtime_error(e.what());
             }
-         }
+        }
 
         if (m_Config.MatrixInfo.FileType==kipl::io::NeXus16bits)
         {
@@ -516,9 +491,7 @@ int ReconEngine::Process(size_t *roi)
 						m_Config.ProjectionInfo.fBinning,
 						m_Config.ProjectionInfo.dose_roi));
 
-		msg.str("");
-		msg<<"Block "<<nProcessedBlocks<<", Projection "<<i<<" (weight="<<fWeight<<", angle="<<fAngle<<")";
-		logger(kipl::logging::Logger::LogVerbose, msg.str());
+		KIPL_LOG(logger,kipl::logging::Logger::LogVerbose,"Block "<<nProcessedBlocks<<", Projection "<<i<<" (weight="<<fWeight<<", angle="<<fAngle<<")");
 
         float moduleCnt=0.0f;
         float fNumberOfModules=static_cast<float>(m_PreprocList.size());
@@ -605,6 +578,7 @@ bool ReconEngine::TransferMatrix(size_t *dims)
 
 bool ReconEngine::Serialize(size_t *dims)
 {
+    KIPL_TRACE_SCOPE("ReconEngine::Serialize","io");
 
 
 	std::stringstream msg;
@@ -635,12 +609,13 @@ bool ReconEngine::Serialize(size_t *dims)
        size_t nSliceBlock=GetIntParameter(m_Config.backprojector.parameters,"SliceBlock");
 
        size_t Start = nSliceBlock*nProcessedBlocks;
-       if (m_Config.MatrixInfo.bUseROI){
-            kipl::io::WriteNeXusStack(img, str.str().c_str(), Start,nSlices, plane, m_Config.MatrixInfo.roi);
-       }
-       else {
-            kipl::io::WriteNeXusStack(img, str.str().c_str(), Start,nSlices, plane, nullptr);
-       }
+       kipl::base::TImage<float,3> slab=kipl::io::PrepareNeXusSlab(img, nSlices, plane, m_Config.MatrixInfo.bUseROI ? m_Config.MatrixInfo.roi : nullptr);
+
+       // The file is closed at the end of each run, a rerun of the back-projection writes a new file
+       if (!m_VolumeWriter.isOpen())
+           CreateVolumeWriter();
+
+       m_VolumeWriter.write(slab, Start);
 
 	}
     else if (m_Config.MatrixInfo.FileType==kipl::io::NeXus16bits) {
@@ -867,7 +842,12 @@ bool ReconEngine::Serialize(ReconConfig::cMatrix *matrixconfig)
     m_Volume.info.SetMetricY(res);
 
     if (matrixconfig->FileType==kipl::io::NeXusfloat){
-       kipl::io::WriteNexusFloat(m_Volume,str.str().c_str(),res);
+        kipl::io::NexusVolumeWriter writer;
+        size_t dims[3]={m_Volume.Size(0), m_Volume.Size(1), m_Volume.Size(2)};
+
+        writer.create(str.str(),dims,res);
+        writer.write(m_Volume,0);
+        writer.close();
     }
     else if (matrixconfig->FileType==kipl::io::NeXus16bits){
         kipl::io::WriteNexus16bits(m_Volume, str.str().c_str(),matrixconfig->fGrayInterval[0],matrixconfig->fGrayInterval[1], res);
@@ -893,6 +873,52 @@ bool ReconEngine::Serialize(ReconConfig::cMatrix *matrixconfig)
 	return bTransposed;
 }
 
+void ReconEngine::CreateVolumeWriter()
+{
+    std::ostringstream msg;
+
+    if (m_VolumeWriter.isOpen())
+    {
+        try
+        {
+            m_VolumeWriter.close();
+        }
+        catch (kipl::base::KiplException &e)
+        {
+            msg<<"The previous volume file was incomplete: "<<e.what();
+            logger(kipl::logging::Logger::LogWarning,msg.str());
+        }
+    }
+
+    float res=0.0f;
+    if (m_Config.ProjectionInfo.beamgeometry==ReconConfig::cProjections::BeamGeometry_Parallel)
+    {
+        res = m_Config.ProjectionInfo.fResolution[0];
+    }
+
+    if (m_Config.ProjectionInfo.beamgeometry==ReconConfig::cProjections::BeamGeometry_Cone)
+    {
+        res = m_Config.MatrixInfo.fVoxelSize[0];
+    }
+
+    size_t dims[3];
+
+    if (m_Config.MatrixInfo.bUseROI){
+        dims[0] = m_Config.MatrixInfo.roi[2]-m_Config.MatrixInfo.roi[0]+1;
+        dims[1] = m_Config.MatrixInfo.roi[3]-m_Config.MatrixInfo.roi[1]+1;
+    }
+    else
+    {
+        dims[0] = (m_Config.ProjectionInfo.projection_roi[2]-m_Config.ProjectionInfo.projection_roi[0]);
+        dims[1] = dims[0];
+    }
+    dims[2] =  (m_Config.ProjectionInfo.roi[3]-m_Config.ProjectionInfo.roi[1]); // it is not necessarelly the entire dataset
+
+    std::string fname=m_Config.MatrixInfo.sDestinationPath+m_Config.MatrixInfo.sFileMask;
+
+    m_VolumeWriter.create(fname, dims, res);
+}
+
 int ReconEngine::Run3D(bool bRerunBackproj)
 {
     std::stringstream msg;
@@ -907,6 +933,9 @@ int ReconEngine::Run3D(bool bRerunBackproj)
             res=Run3DBackProjOnly();
         else
             res=Run3DFull();
+
+        if (m_VolumeWriter.isOpen())
+            m_VolumeWriter.close();
     }
     catch (ReconException &e)
     {
@@ -1020,6 +1049,8 @@ int ReconEngine::Run3DFull()
 
 	totalTimer.Tic();
 
+    kipl::profile::Tracer &tracer=kipl::profile::Tracer::instance();
+    kipl::profile::ScopedTracing tracing(m_Config.System.bTraceExecution);
 
 	size_t nSliceBlock=GetIntParameter(m_Config.backprojector.parameters,"SliceBlock");
 	nTotalBlocks=totalSlices/nSliceBlock;
@@ -1272,6 +1303,25 @@ int ReconEngine::Run3DFull()
 
 		logger(kipl::logging::Logger::LogMessage,msg.str());
 
+        if (tracing.isActive())
+        {
+            tracing.stop();
+            logger(kipl::logging::Logger::LogMessage,"Execution trace summary:\n"+tracer.summary());
+
+            std::string tracename=m_Config.MatrixInfo.sDestinationPath;
+            kipl::strings::filenames::CheckPathSlashes(tracename,true);
+            tracename+=m_Config.MatrixInfo.sFileMask.substr(0,m_Config.MatrixInfo.sFileMask.find_first_of('#'))+"trace.json";
+            try
+            {
+                tracer.writeChromeTrace(tracename);
+                logger(kipl::logging::Logger::LogMessage,"Wrote execution trace to "+tracename);
+            }
+            catch (kipl::base::KiplException &e)
+            {
+                logger(kipl::logging::Logger::LogWarning,std::string("Failed to write the execution trace: ")+e.what());
+            }
+        }
+
         logger(kipl::logging::Logger::LogMessage,"Run 3D done.");
 		Done();
 	}
@@ -1430,6 +1480,7 @@ kipl::base::TImage<float,3> ReconEngine::RunPreproc(size_t * roi, std::string sL
 
 int ReconEngine::Process3D(size_t *roi)
 {
+    KIPL_TRACE_SCOPE("ReconEngine::Process3D","recon");
 	std::stringstream msg;
 	m_bCancel=false;
 
@@ -1586,6 +1637,7 @@ int ReconEngine::Process3D(size_t *roi)
 
     try
     {
+        KIPL_TRACE_SCOPE("ReadProjectionBlock","io");
         ext_projections=m_ProjectionReader.Read(m_Config,extroi,parameters);
         validateImage(ext_projections.GetDataPtr(),ext_projections.Size(),"post reader");
 	}
@@ -1631,7 +1683,10 @@ int ReconEngine::Process3D(size_t *roi)
             msg<<"Processing: "<< moduleName;
 			logger(kipl::logging::Logger::LogMessage,msg.str());
             if (!(m_bCancel=UpdateProgress(moduleCnt/fNumberOfModules, msg.str())))
+            {
+                kipl::profile::ScopedSpan moduleSpan(moduleName,"preprocessing");
                 module->GetModule()->Process(ext_projections,parameters);
+            }
 			else
 				break;
             validateImage(ext_projections.GetDataPtr(),ext_projections.Size(),moduleName);
@@ -1795,6 +1850,7 @@ int ReconEngine::BackProject3D(kipl::base::TImage<float,3> & projections, size_t
     {
         try {
             logger(kipl::logging::Logger::LogMessage,"Back projection started.");
+            KIPL_TRACE_SCOPE("BackProjectBlock","backprojection");
             m_BackProjector->GetModule()->Process(projections,parameters);
             logger(kipl::logging::Logger::LogMessage,"Back projection done.");
         }
@@ -25,8 +25,8 @@ protected:
 	virtual int ProcessCore(kipl::base::TImage<float,2> & img, std::map<std::string, std::string> & coeff);
 	virtual int ProcessCore(kipl::base::TImage<float,3> & img, std::map<std::string, std::string> & coeff);
 
-	int ScaleData(kipl::base::TImage<float,2> &img);
-	int RescaleData(kipl::base::TImage<float,2> &img);
+	int ScaleData(kipl::base::TImage<float,2> &img, float &slope, float &intercept);
+	int RescaleData(kipl::base::TImage<float,2> &img, float slope, float intercept);
 	float m_fTau;
 	int m_nN;
 	float m_fLambda;
@@ -24,8 +24,6 @@ protected:
     virtual int ProcessCore(kipl::base::TImage<float,2> & img, std::map<std::string, std::string> & coeff);
     int ProcessSingle(kipl::base::TImage<float,3> & img);
     int ProcessParallel(kipl::base::TImage<float,3> & img);
-    int ProcessParallelStd(kipl::base::TImage<float,3> & img);
-    int ProcessParallelStdBlock(size_t tid, kipl::base::TImage<float, 3> *img, size_t firstSlice, size_t N);
     kipl::base::eConnectivity m_eConnectivity;
     ImagingAlgorithms::eMorphDetectionMethod m_eDetectionMethod;
     ImagingAlgorithms::eMorphCleanMethod m_eCleanMethod;
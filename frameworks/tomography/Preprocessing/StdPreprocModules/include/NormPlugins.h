@@ -18,6 +18,7 @@
 #include <logging/logger.h>
 #include <base/timage.h>
 #include <math/LUTCollection.h>
+#include <math/fastmath.h>
 #include <PreprocModuleBase.h>
 #include "PreprocEnums.h"
 #include <ReconConfig.h>
@@ -86,6 +87,7 @@ public:
 	virtual ~FullLogNorm();
 
 	virtual int Configure(ReconConfig config, std::map<std::string, std::string> parameters);
+	virtual std::map<std::string, std::string> GetParameters();
 
 	virtual void LoadReferenceImages(size_t *roi);
 
@@ -95,7 +97,17 @@ protected:
 
 private:
 	virtual void SetReferenceImages(kipl::base::TImage<float,2> dark, kipl::base::TImage<float,2> flat);
+
+	/// Computes flat-log(img-dark)+dose for one projection or line, non-positive pixels are set to zero
+	/// \param pImg The pixels, they are normalized in place
+	/// \param pDark The dark current image, nullptr without dark current
+	/// \param pFlat The log of the open beam image, nullptr without open beam
+	/// \param dose The log of the projection dose
+	/// \param N Number of pixels
+	void LogNormProjection(float *pImg, const float *pDark, const float *pFlat, float dose, size_t N);
+
 	kipl::math::LogLUT LUT;
+	kipl::math::eMathAccuracy m_LogAccuracy; ///< Implementation of the logarithm when the LUT isn't used
 };
 
 class  STDPREPROCMODULESSHARED_EXPORT FullNorm : public NormBase
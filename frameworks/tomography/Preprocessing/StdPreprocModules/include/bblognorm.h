@@ -7,6 +7,7 @@
 #include <logging/logger.h>
 #include <base/timage.h>
 #include <math/LUTCollection.h>
+#include <math/fastmath.h>
 
 #include <ReferenceImageCorrection.h>
 
@@ -151,6 +152,7 @@ private:
     ImagingAlgorithms::ReferenceImageCorrection::eInterpOrderX m_xInterpOrder; /// order chosen for interpolation along the X direction
     ImagingAlgorithms::ReferenceImageCorrection::eInterpOrderY m_yInterpOrder; /// order chosen for interpolation along the Y direction
     ImagingAlgorithms::ReferenceImageCorrection::eInterpMethod m_InterpMethod; /// interpolation method
+    kipl::math::eMathAccuracy m_LogAccuracy; /// implementation of the logarithm used by the corrector
     bool updateStatus(float val, std::string msg);
 
 };
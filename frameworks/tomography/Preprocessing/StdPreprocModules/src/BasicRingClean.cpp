@@ -44,22 +44,33 @@ int BasicRingClean::ProcessCore(kipl::base::TImage<float,3> & img, std::map<std:
 	kipl::base::TImage<float,2> meanproj(img.Dims());
 
 	float *pMean=meanproj.GetDataPtr();
-	float *pImg=img.GetDataPtr();
 
 	size_t N=meanproj.Size();
-	memcpy(pMean,pImg,sizeof(float)*N);
+	const size_t nx=img.Size(0);
+	float scale=1.0f/static_cast<float>(img.Size(2));
 
-	for (size_t i=1; i<img.Size(2); i++) {
-		pImg=img.GetLinePtr(0,i);
-		for (size_t j=0; j<N; j++) {
-			pMean[j]+=pImg[j];
+	// The mean projection is accumulated in blocks of detector lines
+	bool completed=parallel_for_slices(img.Size(1),[&](size_t first, size_t last)
+	{
+		const size_t M=(last-first)*nx;
+		float *pBlockMean=meanproj.GetLinePtr(first);
+		memcpy(pBlockMean,img.GetLinePtr(first,0),sizeof(float)*M);
+
+		for (size_t i=1; i<img.Size(2); i++) {
+			const float *pLines=img.GetLinePtr(first,i);
+			for (size_t j=0; j<M; j++) {
+				pBlockMean[j]+=pLines[j];
+			}
 		}
-	}
 
-	float scale=1.0f/static_cast<float>(img.Size(2));
+		for (size_t j=0; j<M; j++) {
+			pBlockMean[j]*=scale;
+		}
+	});
 
-	for (size_t j=0; j<N; j++) {
-		pMean[j]*=scale;
+	if (!completed) {
+		logger(kipl::logging::Logger::LogWarning,"Ring cleaning was aborted");
+		return 1;
 	}
 
 	kipl::io::WriteTIFF32(meanproj,"mean.tif");
@@ -78,11 +89,19 @@ int BasicRingClean::ProcessCore(kipl::base::TImage<float,3> & img, std::map<std:
 
 	kipl::io::WriteTIFF32(medproj,"diff.tif");
 
-	for (size_t i=0; i<img.Size(2); i++) {
-		pImg=img.GetLinePtr(0,i);
-		for (size_t j=0; j<N; j++) {
-			pImg[j]-=pMed[j];
+	completed=parallel_for_slices(img.Size(2),[&](size_t first, size_t last)
+	{
+		for (size_t i=first; i<last; i++) {
+			float *pProj=img.GetLinePtr(0,i);
+			for (size_t j=0; j<N; j++) {
+				pProj[j]-=pMed[j];
+			}
 		}
+	});
+
+	if (!completed) {
+		logger(kipl::logging::Logger::LogWarning,"Ring cleaning was aborted");
+		return 1;
 	}
 
 	return 0;
@@ -7,6 +7,7 @@
 #include <strings/miscstring.h>
 #include <ImagingException.h>
 #include <ReconException.h>
+#include <algorithm>
 
 
 GammaSpotCleanModule::GammaSpotCleanModule() :
@@ -55,99 +56,95 @@ bool GammaSpotCleanModule::SetROI(size_t * UNUSED(roi))
 
 int GammaSpotCleanModule::ProcessCore(kipl::base::TImage<float,3> & img, std::map<std::string, std::string> & UNUSED(coeff))
 {
-//    clog<<"ProcessCore"<<endl;
-#ifdef __APPLE__
-    return ProcessSingle(img);
-#else
-    return ProcessSingle(img);
-    //return ProcessParallel(img);
-#endif
-
-    return 0;
+    return ProcessParallel(img);
 }
 
 
 int GammaSpotCleanModule::ProcessCore(kipl::base::TImage<float,2> & img, std::map<std::string, std::string> & UNUSED(coeff))
 {
-//    std::ostringstream msg;
-//    ImagingAlgorithms::GammaClean cleaner;
-//    cleaner.Configure(m_fSigma,m_fThreshold3,m_fThreshold5,m_fThreshold7,m_nMedianSize);
-
-//    try {
-//        cleaner.Process(img);
-//    }
-//    catch (ImagingException & e) {
-//        msg.str();
-//        msg<<"Failed to process data with ImagingException : "<<std::endl<<e.what();
-//        throw ReconException(msg.str(),__FILE__,__LINE__);
-//    }
-//    catch (kipl::base::KiplException & e) {
-//        msg.str();
-//        msg<<"Failed to process data with KiplException : "<<std::endl<<e.what();
-//        throw ReconException(msg.str(),__FILE__,__LINE__);
-//    }
-//    catch (std::exception & e) {
-//        msg.str();
-//        msg<<"Failed to process data with STL exception : "<<std::endl<<e.what();
-//        throw ReconException(msg.str(),__FILE__,__LINE__);
-//    }
-//    catch (...) {
-
-
-//    }
-
-//    msg.str(""); msg<<"Processed image"<<img;
-//    logger(kipl::logging::Logger::LogMessage,msg.str());
+    std::ostringstream msg;
+    ImagingAlgorithms::GammaClean cleaner;
+    cleaner.Configure(m_fSigma,m_fThreshold3,m_fThreshold5,m_fThreshold7,m_nMedianSize);
+
+    try {
+        img=cleaner.Process(img);
+    }
+    catch (ImagingException & e) {
+        msg.str();
+        msg<<"Failed to process data with ImagingException : "<<std::endl<<e.what();
+        throw ReconException(msg.str(),__FILE__,__LINE__);
+    }
+    catch (kipl::base::KiplException & e) {
+        msg.str();
+        msg<<"Failed to process data with KiplException : "<<std::endl<<e.what();
+        throw ReconException(msg.str(),__FILE__,__LINE__);
+    }
+    catch (std::exception & e) {
+        msg.str();
+        msg<<"Failed to process data with STL exception : "<<std::endl<<e.what();
+        throw ReconException(msg.str(),__FILE__,__LINE__);
+    }
+
     return 0;
 }
 
 int GammaSpotCleanModule::ProcessSingle(kipl::base::TImage<float,3> & img)
 {
-//    const int N = static_cast<int>(img.Size(2));
+    const size_t N = img.Size(2);
 
-//    int i;
+    kipl::base::TImage<float,2> proj(img.Dims());
+    ImagingAlgorithms::GammaClean cleaner;
+    cleaner.Configure(m_fSigma,m_fThreshold3,m_fThreshold5,m_fThreshold7,m_nMedianSize);
 
-//    kipl::base::TImage<float,2> proj(img.Dims());
-//    ImagingAlgorithms::GammaClean cleaner;
-//    cleaner.Configure(m_fSigma,m_fThreshold3,m_fThreshold5,m_fThreshold7,m_nMedianSize);
-
-//    for (i=0; i<N; i++) {
-//        memcpy(proj.GetDataPtr(),img.GetLinePtr(0,i),proj.Size()*sizeof(float));
-//        cleaner.Process(proj);
-//        memcpy(img.GetLinePtr(0,i),proj.GetDataPtr(),proj.Size()*sizeof(float));
-//    }
+    for (size_t i=0; (i<N) && (UpdateStatus(float(i)/N,m_sModuleName)==false); i++) {
+        std::copy_n(img.GetLinePtr(0,i),proj.Size(),proj.GetDataPtr());
+        proj=cleaner.Process(proj);
+        std::copy_n(proj.GetDataPtr(),proj.Size(),img.GetLinePtr(0,i));
+    }
 
     return 0;
 }
 
 int GammaSpotCleanModule::ProcessParallel(kipl::base::TImage<float,3> & img)
 {
-//    const int N = static_cast<int>(img.Size(2));
-
-//    int i;
-//    std::clog<<"Starting parallel processing"<<std::endl;
-//#pragma omp parallel
-//    {
-//        kipl::base::TImage<float,2> proj(img.Dims());
-//        ImagingAlgorithms::GammaClean cleaner;
-//        cleaner.Configure(m_fSigma,m_fThreshold3,m_fThreshold5,m_fThreshold7,m_nMedianSize);
-
-//#pragma omp for
-//        for (i=0; i<N; i++) {
-//            memcpy(proj.GetDataPtr(),img.GetLinePtr(0,i),proj.Size()*sizeof(float));
-//            cleaner.Process(proj);
-//            memcpy(img.GetLinePtr(0,i),proj.GetDataPtr(),proj.Size()*sizeof(float));
-//        }
-//    }
+    bool completed=true;
+    std::ostringstream msg;
+
+    try {
+        completed=parallel_for_slices(img.Size(2),[&](size_t first, size_t last)
+        {
+            kipl::base::TImage<float,2> proj(img.Dims());
+            ImagingAlgorithms::GammaClean cleaner;
+            cleaner.Configure(m_fSigma,m_fThreshold3,m_fThreshold5,m_fThreshold7,m_nMedianSize);
+
+            for (size_t i=first; i<last; i++) {
+                std::copy_n(img.GetLinePtr(0,i),proj.Size(),proj.GetDataPtr());
+                proj=cleaner.Process(proj);
+                std::copy_n(proj.GetDataPtr(),proj.Size(),img.GetLinePtr(0,i));
+            }
+        });
+    }
+    catch (ImagingException & e) {
+        msg<<"Failed to process data with ImagingException : "<<std::endl<<e.what();
+        throw ReconException(msg.str(),__FILE__,__LINE__);
+    }
+    catch (kipl::base::KiplException & e) {
+        msg<<"Failed to process data with KiplException : "<<std::endl<<e.what();
+        throw ReconException(msg.str(),__FILE__,__LINE__);
+    }
+
+    if (!completed)
+    {
+        logger(logger.LogWarning,"Spot cleaning was aborted");
+        return 1;
+    }
 
     return 0;
 }
 
 kipl::base::TImage<float,2> GammaSpotCleanModule::DetectionImage(kipl::base::TImage<float,2> img)
 {
-//    ImagingAlgorithms::GammaClean cleaner;
-//    cleaner.Configure(m_fSigma,m_fThreshold3,m_fThreshold5,m_fThreshold7,m_nMedianSize);
-//    return cleaner.DetectionImage(img);
-
-    return img;
+    ImagingAlgorithms::GammaClean cleaner;
+    cleaner.Configure(m_fSigma,m_fThreshold3,m_fThreshold5,m_fThreshold7,m_nMedianSize);
+    return cleaner.DetectionImage(img);
 }
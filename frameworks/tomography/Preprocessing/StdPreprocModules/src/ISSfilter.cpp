@@ -1,9 +1,6 @@
 //<LICENSE>
 
 #include "../include/StdPreprocModules_global.h"
-#ifdef _OPENMP
-#include <omp.h>
-#endif
 #include <scalespace/ISSfilter2D.h>
 
 #include <ParameterHandling.h>
@@ -74,9 +71,9 @@ int ISSfilter::ProcessCore(kipl::base::TImage<float,2> & img, std::map<std::stri
 	akipl::scalespace::ISSfilter<float> filter;
 	filter.ErrorCurve(m_bErrorCurve);
 
-	ScaleData(img);
+	ScaleData(img,m_fSlope,m_fIntercept);
 	filter.Process(img,m_fTau,m_fLambda,m_fAlpha,m_nN);
-	RescaleData(img);
+	RescaleData(img,m_fSlope,m_fIntercept);
 	if (m_bErrorCurve) {
         if (m_fErrorCurve!=nullptr)
 			delete [] m_fErrorCurve;
@@ -90,39 +87,46 @@ int ISSfilter::ProcessCore(kipl::base::TImage<float,2> & img, std::map<std::stri
 
 int ISSfilter::ProcessCore(kipl::base::TImage<float,3> & img, std::map<std::string, std::string> & coeff)
 {
-    #pragma omp parallel
+	const bool completed=parallel_for_slices(img.Size(2),[&](size_t first, size_t last)
 	{
 		akipl::scalespace::ISSfilter<float> filter;
 
 		kipl::base::TImage<float,2> slice(img.Dims());
 
-		int N=static_cast<int>(img.Size(2));
-		#pragma omp for
-		for (int i=0; i<N; i++) {
+		for (size_t i=first; i<last; i++) {
+			// The automatic scaling is computed per slice, the parameters must therefore be local.
+			float slope=m_fSlope;
+			float intercept=m_fIntercept;
+
 			memcpy(slice.GetDataPtr(),img.GetLinePtr(0,i),sizeof(float)*slice.Size());
-			ScaleData(slice);
+			ScaleData(slice,slope,intercept);
 			filter.Process(slice,m_fTau,m_fLambda,m_fAlpha,m_nN);
-			RescaleData(slice);
+			RescaleData(slice,slope,intercept);
 
 			memcpy(img.GetLinePtr(0,i),slice.GetDataPtr(),sizeof(float)*slice.Size());
 		}
+	});
+
+	if (!completed) {
+		logger(kipl::logging::Logger::LogWarning,"ISS filtering was aborted");
+		return 1;
 	}
 
 	return 0;
 }
 
-int ISSfilter::ScaleData(kipl::base::TImage<float,2> &img)
+int ISSfilter::ScaleData(kipl::base::TImage<float,2> &img, float &slope, float &intercept)
 {
 	if (m_bScaleData) {
 		float *pImg=img.GetDataPtr();
 		if (m_bAutoScale) {
 			std::pair<double,double> stats=kipl::math::statistics(pImg, img.Size());
-			m_fIntercept=-static_cast<float>(stats.first);
-			m_fSlope=1.0f/static_cast<float>(stats.second);
+			intercept=-static_cast<float>(stats.first);
+			slope=1.0f/static_cast<float>(stats.second);
 		}
 
 		for (size_t i=0; i<img.Size(); i++) {
-			pImg[i]=pImg[i]*m_fSlope+m_fIntercept;
+			pImg[i]=pImg[i]*slope+intercept;
 		}
 
 		return 1;
@@ -131,13 +135,13 @@ int ISSfilter::ScaleData(kipl::base::TImage<float,2> &img)
 		return 0;
 }
 
-int ISSfilter::RescaleData(kipl::base::TImage<float,2> &img)
+int ISSfilter::RescaleData(kipl::base::TImage<float,2> &img, float slope, float intercept)
 {
 	if (m_bScaleData) {
 		float *pImg=img.GetDataPtr();
-		float invslope=1.0f/m_fSlope;
+		float invslope=1.0f/slope;
 		for (size_t i=0; i<img.Size(); i++) {
-			pImg[i]=(pImg[i]-m_fIntercept)*invslope;
+			pImg[i]=(pImg[i]-intercept)*invslope;
 		}
 
 		return 1;
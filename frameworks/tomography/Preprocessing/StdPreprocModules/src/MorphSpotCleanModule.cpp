@@ -1,6 +1,5 @@
 //<LICENSE>
 //#include "stdafx.h"
-#include <thread>
 #include <cstdlib>
 #include <functional>
 #include <algorithm>
@@ -15,6 +14,7 @@
 #include <ReconException.h>
 #include <ModuleException.h>
 #include <base/tpermuteimage.h>
+#include <utilities/threadpool.h>
 #include <QDebug>
 
 #include <QDebug>
@@ -128,7 +128,7 @@ int MorphSpotCleanModule::ProcessCore(kipl::base::TImage<float,3> & img, std::ma
     logger(logger.LogMessage,"ProcessCore");
 
     if (m_bThreading)
-        return ProcessParallelStd(img);
+        return ProcessParallel(img);
     else
         return ProcessSingle(img);
 
@@ -214,108 +214,67 @@ int MorphSpotCleanModule::ProcessSingle(kipl::base::TImage<float,3> & img)
 
 int MorphSpotCleanModule::ProcessParallel(kipl::base::TImage<float,3> & img)
 {
-    const int N = static_cast<int>(img.Size(2));
-
-    int i;
-    std::clog<<"Starting parallel processing"<<std::endl;
-#pragma omp parallel
-    {
-        kipl::base::TImage<float,2> proj(img.Dims());
-        ImagingAlgorithms::MorphSpotClean cleaner;
-        cleaner.setCleanMethod(m_eDetectionMethod,m_eCleanMethod);
-        cleaner.setConnectivity(m_eConnectivity);
-        cleaner.setLimits(m_bClampData,m_fMinLevel,m_fMaxLevel,m_nMaxArea);
-
-#pragma omp for
-        for (i=0; i<N; i++) {
-            memcpy(proj.GetDataPtr(),img.GetLinePtr(0,i),proj.Size()*sizeof(float));
-            cleaner.process(proj,m_fThreshold,m_fSigma);
-            memcpy(img.GetLinePtr(0,i),proj.GetDataPtr(),proj.Size()*sizeof(float));
-        }
-    }
-
-    return 0;
-}
-
-int MorphSpotCleanModule::ProcessParallelStd(kipl::base::TImage<float,3> & img)
-{
+    bool completed=true;
     std::ostringstream msg;
-    const size_t concurentThreadsSupported = std::thread::hardware_concurrency();
-
-
-    std::vector<std::thread> threads;
     const size_t N = img.Size(2);
 
-    size_t M=N/concurentThreadsSupported;
-
-    msg.str("");
-    msg<<N<<" projections on "<<concurentThreadsSupported<<" threads, "<<M<<" projections per thread";
+    msg<<N<<" projections on "<<kipl::utilities::ThreadPool::globalThreadBudget()<<" threads";
     logger(logger.LogMessage,msg.str());
 
-    for(size_t i = 0; i < concurentThreadsSupported; ++i)
-    {
-        // spawn threads
-        size_t rest=(i==concurentThreadsSupported-1)*(N % concurentThreadsSupported); // Take care of the rest slices
-        auto pImg = &img;
-        threads.push_back(std::thread([=] { ProcessParallelStdBlock(i,pImg,i*M,M+rest); }));
-    }
-
-    // call join() on each thread in turn
-    for_each(threads.begin(), threads.end(),
-        std::mem_fn(&std::thread::join));
-
-
-
-    return 0;
-}
-
-int MorphSpotCleanModule::ProcessParallelStdBlock(size_t tid, kipl::base::TImage<float, 3> *img, size_t firstSlice, size_t N)
-{
-    std::ostringstream msg;
-    size_t i;
-
-    msg<<"Starting morphclean thread number="<<tid<<", N="<<N;
-    logger.verbose(msg.str());
-    msg.str("");
-    msg<<"Thread "<<tid<<" progress :";
-
-    kipl::base::TImage<float,2> proj(img->Dims());
-
-    kipl::base::Transpose<float> transpose;
-    transpose.bUseReference=true;
     try
     {
-        ImagingAlgorithms::MorphSpotClean cleaner;
-        cleaner.setCleanMethod(this->m_eDetectionMethod,this->m_eCleanMethod);
-        cleaner.setConnectivity(this->m_eConnectivity);
-
-        for (i=0; i<N; i++)
+        completed=parallel_for_slices(N,[&](size_t first, size_t last)
         {
-            std::copy_n(img->GetLinePtr(0,firstSlice+i),proj.Size(),proj.GetDataPtr());
+            kipl::base::TImage<float,2> proj(img.Dims());
+            kipl::base::Transpose<float> transpose;
+            transpose.bUseReference=true;
 
-            if (m_bTranspose)
-            {
-                auto tproj = transpose(proj);
-                cleaner.process(tproj,this->m_fThreshold,this->m_fSigma);
-                proj = transpose(tproj);
-            }
-            else
+            ImagingAlgorithms::MorphSpotClean cleaner;
+            cleaner.setCleanMethod(m_eDetectionMethod,m_eCleanMethod);
+            cleaner.setConnectivity(m_eConnectivity);
+            cleaner.setLimits(m_bClampData,m_fMinLevel,m_fMaxLevel,m_nMaxArea);
+            cleaner.setCleanInfNan(m_bRemoveInfNaN);
+
+            for (size_t i=first; i<last; ++i)
             {
-                cleaner.process(proj,this->m_fThreshold,this->m_fSigma);
+                std::copy_n(img.GetLinePtr(0,i),proj.Size(),proj.GetDataPtr());
+
+                if (m_bTranspose)
+                {
+                    auto tproj = transpose(proj);
+                    cleaner.process(tproj,m_fThreshold,m_fSigma);
+                    proj = transpose(tproj);
+                }
+                else
+                {
+                    cleaner.process(proj,m_fThreshold,m_fSigma);
+                }
+
+                std::copy_n(proj.GetDataPtr(),proj.Size(),img.GetLinePtr(0,i));
             }
-
-            std::copy_n(proj.GetDataPtr(),proj.Size(),img->GetLinePtr(0,firstSlice+i));
-
-            msg<<".";
-        }
+        });
     }
-    catch (...)
-    {
-        msg<<"Thread tid="<<tid<<" failed with an exception.";
-        logger(logger.LogError,msg.str());
+    catch (ImagingException & e) {
+        msg.str("");
+        msg<<"Imaging exception while cleaning projections in parallel"<<std::endl<<e.what();
+        throw ModuleException(msg.str(),__FILE__,__LINE__);
+    }
+    catch (kipl::base::KiplException & e) {
+        msg.str("");
+        msg<<"kipl exception while cleaning projections in parallel"<<std::endl<<e.what();
+        throw ModuleException(msg.str(),__FILE__,__LINE__);
+    }
+    catch (exception & e) {
+        msg.str("");
+        msg<<"STL exception while cleaning projections in parallel"<<std::endl<<e.what();
+        throw ModuleException(msg.str(),__FILE__,__LINE__);
     }
 
-    logger.verbose(msg.str());
+    if (!completed)
+    {
+        logger(logger.LogWarning,"Spot cleaning was aborted");
+        return 1;
+    }
 
     return 0;
 }
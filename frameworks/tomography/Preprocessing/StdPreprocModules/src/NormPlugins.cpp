@@ -1,6 +1,8 @@
 //<LICENSE>
 
 #include <atomic>
+#include <vector>
+#include <algorithm>
 
 #include "../include/StdPreprocModules_global.h"
 
@@ -272,7 +274,8 @@ std::map<std::string, std::string> NormBase::GetParameters()
 //-------------------------------------------------
 FullLogNorm::FullLogNorm() :
 		NormBase("FullLogNorm"),
-		LUT(1<<16,0.0f,(1<<16)-1)
+		LUT(1<<16,0.0f,(1<<16)-1),
+		m_LogAccuracy(kipl::math::ExactMath)
 {
 
 }
@@ -284,9 +287,27 @@ FullLogNorm::~FullLogNorm()
 int FullLogNorm::Configure(ReconConfig config, std::map<std::string, std::string> parameters)
 {
 	NormBase::Configure(config,parameters);
+
+    try {
+        string2enum(GetStringParameter(parameters,"logaccuracy"),m_LogAccuracy);
+    }
+    catch (...) {
+        logger(logger.LogWarning,"Parameter logaccuracy missing, using logaccuracy=exact");
+        m_LogAccuracy=kipl::math::ExactMath;
+    }
+
 	return 0;
 }
 
+std::map<std::string, std::string> FullLogNorm::GetParameters()
+{
+    std::map<std::string, std::string> parameters=NormBase::GetParameters();
+
+    parameters["logaccuracy"]=enum2string(m_LogAccuracy);
+
+    return parameters;
+}
+
 void FullLogNorm::LoadReferenceImages(size_t *roi)
 {
     std::ostringstream msg;
@@ -413,25 +434,15 @@ int FullLogNorm::ProcessCore(kipl::base::TImage<float,2> & img, std::map<std::st
 		}
 	}
 	else {
-		if (nDCCount!=0) {
-			#pragma omp parallel for firstprivate(pImg,pFlat,pDark)
-			for (int i=0; i<N; i++) {
-				float fProjPixel=(pImg[i]-pDark[i]);
-				if (fProjPixel<=0)
-					pImg[i]=0;
-				else
-                    pImg[i]=pFlat[i]-log(fProjPixel)+cLogDose;
-			}
-		}
-		else {
-			#pragma omp parallel for firstprivate(pImg,pFlat)
-			for (int i=0; i<N; i++) {
-				float fProjPixel=pImg[i];
-				if (fProjPixel<=0)
-					pImg[i]=0;
-				else
-                    pImg[i]=pFlat[i]-log(fProjPixel)+cLogDose;
-			}
+		const int nLines=static_cast<int>(img.Size(1));
+		const size_t nx=img.Size(0);
+
+		#pragma omp parallel for
+		for (int j=0; j<nLines; j++) {
+			LogNormProjection(img.GetLinePtr(j),
+			                  nDCCount!=0 ? pDark+j*nx : nullptr,
+			                  pFlat+j*nx,
+			                  cLogDose,nx);
 		}
 	}
 
@@ -509,71 +520,13 @@ int FullLogNorm::ProcessCore(kipl::base::TImage<float,3> & img, std::map<std::st
 		}
 	}
 	else {
-		if (nDCCount!=0) {
-			if (nOBCount!=0) {
-                    #pragma omp parallel for firstprivate(pFlat,pDark)
-//                    for (int j=0; j<static_cast<int>(img.Size(2)) && (UpdateStatus(cnt/static_cast<int>(img.Size(2)),m_sModuleName)==false); cnt=cnt+1,++j) {
-                     for (int j=0; j<static_cast<int>(img.Size(2));++j) {
-						float *pImg=img.GetLinePtr(0,j);
-						float dose=nDose !=1 ? doselist[j] : doselist[0];
-						
-						for (int i=0; i<N; i++) {
-							float fProjPixel=(pImg[i]-pDark[i]);
-                            if (fProjPixel<=0.0f)
-                                pImg[i]=0.0f;
-							else
-								pImg[i]=pFlat[i]-log(fProjPixel)+dose;
-						}
-					}
-			}
-			else {
-				#pragma omp parallel for firstprivate(pDark)
-//                for (int j=0; j<static_cast<int>(img.Size(2)) && (UpdateStatus(cnt/static_cast<int>(img.Size(2)),m_sModuleName)==false); cnt=cnt+1,++j) {
-                for (int j=0; j<static_cast<int>(img.Size(2)); ++j) {
-					float *pImg=img.GetLinePtr(0,j);
-					float dose=nDose !=1 ? doselist[j] : doselist[0];
-					
-					for (int i=0; i<N; i++) {
-						float fProjPixel=(pImg[i]-pDark[i]);
-                        if (fProjPixel<=0.0f)
-                            pImg[i]=0.0f;
-						else
-							pImg[i]=-log(fProjPixel)+dose;
-					}
-				}
-			}
-		}
-		else {
-			if (nOBCount!=0) {
-				#pragma omp parallel for firstprivate(pFlat)
-//                for (int j=0; j<static_cast<int>(img.Size(2)) && (UpdateStatus(cnt/static_cast<int>(img.Size(2)),m_sModuleName)==false); cnt=cnt+1,++j) {
-                for (int j=0; j<static_cast<int>(img.Size(2)); ++j) {
-					float *pImg=img.GetLinePtr(0,j);
-					float dose=nDose !=1 ? doselist[j] : doselist[0];
-					for (int i=0; i<N; i++) {
-						float fProjPixel=(pImg[i]);
-                        if (fProjPixel<=0.0f)
-                            pImg[i]=0.0f;
-						else
-							pImg[i]=pFlat[i]-log(fProjPixel)+dose;
-					}	
-				}
-			}
-			else {
-				#pragma omp parallel for
-//                for (int j=0; j<static_cast<int>(img.Size(2)) && (UpdateStatus(cnt/static_cast<int>(img.Size(2)),m_sModuleName)==false); cnt=cnt+1, ++j) {
-                for (int j=0; j<static_cast<int>(img.Size(2)); ++j) {
-					float *pImg=img.GetLinePtr(0,j);
-					float dose=nDose !=1 ? doselist[j] : doselist[0];
-					for (int i=0; i<N; i++) {
-						float fProjPixel=(pImg[i]);
-                        if (fProjPixel<=0.0f)
-                            pImg[i]=0.0f;
-						else
-							pImg[i]=-log(fProjPixel)+dose;
-					}	
-				}
-			}
+		const float *pDarkImg = nDCCount!=0 ? pDark : nullptr;
+		const float *pFlatImg = nOBCount!=0 ? pFlat : nullptr;
+
+		#pragma omp parallel for
+		for (int j=0; j<static_cast<int>(img.Size(2)); ++j) {
+			float dose=nDose !=1 ? doselist[j] : doselist[0];
+			LogNormProjection(img.GetLinePtr(0,j),pDarkImg,pFlatImg,dose,N);
 		}
 	}
 
@@ -582,6 +535,36 @@ int FullLogNorm::ProcessCore(kipl::base::TImage<float,3> & img, std::map<std::st
     return 0;
 }
 
+void FullLogNorm::LogNormProjection(float *pImg, const float *pDark, const float *pFlat, float dose, size_t N)
+{
+	// The logarithms are computed for blocks of pixels to use the array functions
+	const size_t blockSize=4096;
+	std::vector<float> proj(std::min(N,blockSize));
+	std::vector<float> logproj(proj.size());
+
+	for (size_t first=0; first<N; first+=blockSize) {
+		const size_t len=std::min(blockSize,N-first);
+		float *pBlock=pImg+first;
+
+		if (pDark!=nullptr)
+			for (size_t i=0; i<len; i++)
+				proj[i]=pBlock[i]-pDark[first+i];
+		else
+			std::copy_n(pBlock,len,proj.data());
+
+		kipl::math::logArray(proj.data(),logproj.data(),len,m_LogAccuracy);
+
+		for (size_t i=0; i<len; i++) {
+			if (proj[i]<=0.0f)
+				pBlock[i]=0.0f;
+			else if (pFlat!=nullptr)
+				pBlock[i]=pFlat[first+i]-logproj[i]+dose;
+			else
+				pBlock[i]=-logproj[i]+dose;
+		}
+	}
+}
+
 //----------------------------------------------------
 // Fullnorm module
 
@@ -6,9 +6,6 @@
 #include <ParameterHandling.h>
 #include <StripeFilter.h>
 #include <ReconException.h>
-#ifdef _OPENMP
-#include <omp.h>
-#endif
 #include <math/mathconstants.h>
 
 WaveletRingClean::WaveletRingClean(kipl::interactors::InteractionBase *interactor) :
@@ -110,40 +107,36 @@ int WaveletRingClean::ProcessSingle(kipl::base::TImage<float,3> & img, std::map<
 int WaveletRingClean::ProcessParallel(kipl::base::TImage<float,3> & img, std::map<std::string, std::string> & UNUSED(coeff))
 {
 	size_t dims[2]={img.Size(0), img.Size(2)};
-	bool fail=false;
-    int N=static_cast<int>(img.Size(1));
-	#pragma omp parallel
-	{
-		kipl::base::TImage<float,2> sinogram;
-        ImagingAlgorithms::StripeFilter *filter=nullptr;
-		try {
-			filter=new ImagingAlgorithms::StripeFilter(dims,m_sWName,m_nDecNum, m_fSigma);
-		}
-		catch (kipl::base::KiplException &e) {
-			#pragma omp critical
-			{
-				logger(kipl::logging::Logger::LogError,e.what());
-				fail=true;
-			}
-		}
-		if (!fail) {
-			#pragma omp for
-            for (int j=0; j<N; j++)
+	bool completed=true;
+
+	try {
+		// The filter is configured once and shared by all threads
+		const ImagingAlgorithms::StripeFilter filter(dims,m_sWName,m_nDecNum, m_fSigma);
+
+		completed=parallel_for_slices(img.Size(1),[&](size_t first, size_t last)
+		{
+			kipl::base::TImage<float,2> sinogram;
+
+			for (size_t j=first; j<last; j++)
 			{
-				std::cout<<"Processing sinogram "<<j<<std::endl;
 				ExtractSinogram(img,sinogram,j);
 
-                filter->process(sinogram);
+				filter.process(sinogram);
 
 				InsertSinogram(sinogram,img,j);
 			}
-			delete filter;
-		}
+		});
 	}
-
-	if (fail) {
+	catch (kipl::base::KiplException &e) {
+		logger(kipl::logging::Logger::LogError,e.what());
 		throw ReconException("Failed to process the projections using stripe filter.",__FILE__,__LINE__);
 	}
+
+	if (!completed) {
+		logger(kipl::logging::Logger::LogWarning,"Stripe filtering was aborted");
+		return 1;
+	}
+
 	return 0;
 }
 
@@ -57,7 +57,8 @@ BBLogNorm::BBLogNorm(kipl::interactors::InteractionBase *interactor) :
     min_area(20),
     thresh(0),
     m_Interactor(interactor),
-    bExtSingleFile(true)
+    bExtSingleFile(true),
+    m_LogAccuracy(kipl::math::ExactMath)
 {
 
     doseBBroi[0] = doseBBroi[1] = doseBBroi[2] = doseBBroi[3]=0;
@@ -163,6 +164,15 @@ int BBLogNorm::Configure(ReconConfig config, std::map<std::string, std::string>
     m_corrector.SaveBG(false, blackbodyname, blackbodyname, blackbodyname); // fake names
     m_corrector.SetManualThreshold(bUseManualThresh,thresh);
 
+    try {
+        string2enum(GetStringParameter(parameters,"logaccuracy"),m_LogAccuracy);
+    }
+    catch (...) {
+        logger(logger.LogWarning,"Parameter logaccuracy missing, using logaccuracy=exact");
+        m_LogAccuracy=kipl::math::ExactMath;
+    }
+    m_corrector.SetLogAccuracy(m_LogAccuracy);
+
 
     memcpy(nOriginalNormRegion,config.ProjectionInfo.dose_roi,4*sizeof(size_t));
 
@@ -287,6 +297,15 @@ int BBLogNorm::ConfigureDLG(ReconConfig config, std::map<std::string, std::strin
 
     m_corrector.SetManualThreshold(bUseManualThresh,thresh);
 
+    try {
+        string2enum(GetStringParameter(parameters,"logaccuracy"),m_LogAccuracy);
+    }
+    catch (...) {
+        logger(logger.LogWarning,"Parameter logaccuracy missing, using logaccuracy=exact");
+        m_LogAccuracy=kipl::math::ExactMath;
+    }
+    m_corrector.SetLogAccuracy(m_LogAccuracy);
+
 
     memcpy(nOriginalNormRegion,config.ProjectionInfo.dose_roi,4*sizeof(size_t));
 
@@ -400,6 +419,7 @@ std::map<std::string, std::string> BBLogNorm::GetParameters() {
     parameters["ManualThreshold"] = kipl::strings::bool2string(bUseManualThresh);
     parameters["thresh"]= kipl::strings::value2string(thresh);
     parameters["singleBBext"] = kipl::strings::bool2string(bExtSingleFile);
+    parameters["logaccuracy"] = enum2string(m_LogAccuracy);
 
     return parameters;
 }
@@ -15,7 +15,8 @@ FullLogNormDlg::FullLogNormDlg(QWidget *parent) :
     ui(new Ui::FullLogNormDlg),
     m_bUseDose(true),
     m_bUseLUT(false),
-    m_eAverageMethod(ImagingAlgorithms::AverageImage::ImageWeightedAverage)
+    m_eAverageMethod(ImagingAlgorithms::AverageImage::ImageWeightedAverage),
+    m_eLogAccuracy(kipl::math::ExactMath)
 {
     ui->setupUi(this);
     UpdateDialog();
@@ -52,6 +53,7 @@ void FullLogNormDlg::UpdateDialog()
     ui->check_usedose->setChecked(m_bUseDose);
     ui->check_useLut->setChecked(m_bUseLUT);
     ui->combo_averagemethod->setCurrentIndex(static_cast<int>(m_eAverageMethod));
+    ui->combo_logaccuracy->setCurrentIndex(static_cast<int>(m_eLogAccuracy));
 }
 
 void FullLogNormDlg::UpdateParameters()
@@ -59,6 +61,7 @@ void FullLogNormDlg::UpdateParameters()
     m_bUseDose = ui->check_usedose->checkState();
     m_bUseLUT = ui->check_useLut->checkState();
     m_eAverageMethod = static_cast<ImagingAlgorithms::AverageImage::eAverageMethod>(ui->combo_averagemethod->currentIndex());
+    m_eLogAccuracy = static_cast<kipl::math::eMathAccuracy>(ui->combo_logaccuracy->currentIndex());
 }
 
 void FullLogNormDlg::UpdateParameterList(std::map<std::string, std::string> &parameters)
@@ -69,6 +72,7 @@ void FullLogNormDlg::UpdateParameterList(std::map<std::string, std::string> &par
         parameters["usenormregion"]=kipl::strings::bool2string(m_bUseDose);
         parameters["uselut"]=kipl::strings::bool2string(m_bUseLUT);
         parameters["referenceaverage"]=enum2string(m_eAverageMethod);
+        parameters["logaccuracy"]=enum2string(m_eLogAccuracy);
 }
 
 void FullLogNormDlg::UpdateDialogFromParameterList(std::map<std::string, std::string> &parameters)
@@ -82,6 +86,13 @@ void FullLogNormDlg::UpdateDialogFromParameterList(std::map<std::string, std::st
         logger(logger.LogError,e.what());
     }
 
+    try {
+        string2enum(GetStringParameter(parameters,"logaccuracy"),m_eLogAccuracy);
+    }
+    catch (...) {
+        m_eLogAccuracy=kipl::math::ExactMath; // Older configurations don't have the parameter
+    }
+
     UpdateDialog();
 }
 
@@ -7,6 +7,7 @@
 #include "StdPreprocModulesGUI_global.h"
 
 #include <averageimage.h>
+#include <math/fastmath.h>
 #include <ConfiguratorDialogBase.h>
 
 namespace Ui {
@@ -33,6 +34,7 @@ private:
     bool m_bUseDose;
     bool m_bUseLUT;
     ImagingAlgorithms::AverageImage::eAverageMethod m_eAverageMethod;
+    kipl::math::eMathAccuracy m_eLogAccuracy;
 
 };
 
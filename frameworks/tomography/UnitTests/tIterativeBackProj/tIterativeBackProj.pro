@@ -0,0 +1,76 @@
+QT       += testlib
+
+QT       -= gui
+
+TARGET = tst_iterativebackprojtest
+CONFIG   += console
+CONFIG   -= app_bundle
+
+CONFIG += c++11
+
+TEMPLATE = app
+
+CONFIG(release, debug|release): DESTDIR = $$PWD/../../../../../lib
+else:CONFIG(debug, debug|release): DESTDIR = $$PWD/../../../../../lib/debug
+
+SOURCES += tst_iterativebackprojtest.cpp
+DEFINES += SRCDIR=\\\"$$PWD/\\\"
+
+
+unix:!symbian {
+    maemo5 {
+        target.path = /opt/usr/lib
+    } else {
+        target.path = /usr/lib
+    }
+    INSTALLS += target
+
+    unix:macx {
+        QMAKE_CXXFLAGS += -fPIC -O2
+        INCLUDEPATH += /opt/local/include
+        INCLUDEPATH += /opt/local/include/libxml2
+        QMAKE_LIBDIR += /opt/local/lib
+    }
+    else {
+        QMAKE_CXXFLAGS += -fPIC -fopenmp -O2
+        QMAKE_LFLAGS += -lgomp
+        INCLUDEPATH += /usr/include/libxml2
+    }
+
+    LIBS += -ltiff -lxml2
+
+}
+
+win32 {
+    contains(QMAKE_HOST.arch, x86_64):{
+        QMAKE_LFLAGS += /MACHINE:X64
+    }
+    INCLUDEPATH += $$PWD/../../../../external/src/linalg
+    INCLUDEPATH += $$PWD/../../../../external/include
+    INCLUDEPATH += $$PWD/../../../../external/include/cfitsio
+    INCLUDEPATH += $$PWD/../../../../external/include/libxml2
+    QMAKE_LIBDIR += $$_PRO_FILE_PWD_/../../../../external/lib64
+
+    LIBS += -llibxml2_dll -llibtiff -lcfitsio
+    QMAKE_CXXFLAGS += /openmp /O2
+}
+
+CONFIG(release, debug|release): LIBS += -L$$PWD/../../../../../lib/
+else:CONFIG(debug, debug|release): LIBS += -L$$PWD/../../../../../lib/debug/
+
+LIBS += -lkipl -lModuleConfig -lReconFramework -lReconAlgorithms -lIterativeBackProj
+
+INCLUDEPATH += $$PWD/../../Backprojectors/IterativeBackProj/src
+DEPENDPATH += $$PWD/../../Backprojectors/IterativeBackProj/src
+
+INCLUDEPATH += $$PWD/../../Framework/ReconAlgorithms/ReconAlgorithms
+DEPENDPATH += $$PWD/../../Framework/ReconAlgorithms/ReconAlgorithms
+
+INCLUDEPATH += $$PWD/../../Framework/ReconFramework/include
+DEPENDPATH += $$PWD/../../Framework/ReconFramework/include
+
+INCLUDEPATH += $$PWD/../../../../core/kipl/kipl/include
+DEPENDPATH += $$PWD/../../../../core/kipl/kipl/include
+
+INCLUDEPATH += $$PWD/../../../../core/modules/ModuleConfig/include
+DEPENDPATH += $$PWD/../../../../core/modules/ModuleConfig/include
@@ -0,0 +1,160 @@
+//<LICENSE>
+
+#include <cmath>
+#include <list>
+#include <map>
+#include <sstream>
+#include <algorithm>
+
+#include <QString>
+#include <QtTest>
+
+#include <base/timage.h>
+#include <base/kiplenums.h>
+#include <josephprojector.h>
+#include <ReconConfig.h>
+#include <sirtbp.h>
+
+class TIterativeBackProjTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    TIterativeBackProjTest();
+
+private Q_SLOTS:
+    void testSIRTConvergence();
+    void testOSSARTConvergence();
+
+private:
+    /// Reconstructs the phantom projections and returns the relative error of each slice
+    std::vector<float> reconstructionError(int subsets, int iterations);
+
+    size_t m_nSize;
+    size_t m_nSlices;
+    std::list<float> m_Angles;
+    kipl::base::TImage<float,2> m_Phantom;
+    kipl::base::TImage<float,3> m_Projections;
+};
+
+TIterativeBackProjTest::TIterativeBackProjTest() :
+    m_nSize(32),
+    m_nSlices(3)
+{
+    const size_t nProj=48;
+    for (size_t i=0; i<nProj; ++i)
+        m_Angles.push_back(i*180.0f/nProj);
+
+    // A disk with a denser inclusion, well inside the reconstruction circle
+    size_t dims[2]={m_nSize,m_nSize};
+    m_Phantom.Resize(dims);
+    m_Phantom=0.0f;
+    for (size_t y=0; y<m_nSize; ++y) {
+        for (size_t x=0; x<m_nSize; ++x) {
+            const float dx=x-15.0f;
+            const float dy=y-17.0f;
+            if (dx*dx+dy*dy<60.0f)
+                m_Phantom(x,y)=1.0f;
+            if ((x-11.0f)*(x-11.0f)+(y-12.0f)*(y-12.0f)<6.0f)
+                m_Phantom(x,y)=2.0f;
+        }
+    }
+
+    JosephForwardProjector fp;
+    fp.setCenter(m_nSize/2);
+    kipl::base::TImage<float,2> sino;
+    fp.project(m_Phantom,m_Angles,sino);
+
+    // All slices of the projection stack get the same sinogram
+    size_t projDims[3]={m_nSize,m_nSlices,nProj};
+    m_Projections.Resize(projDims);
+    for (size_t p=0; p<nProj; ++p)
+        for (size_t s=0; s<m_nSlices; ++s)
+            std::copy_n(sino.GetLinePtr(p),m_nSize,m_Projections.GetLinePtr(s,p));
+}
+
+std::vector<float> TIterativeBackProjTest::reconstructionError(int subsets, int iterations)
+{
+    SIRTbp sirt;
+
+    std::map<std::string,std::string> parameters=sirt.GetParameters();
+    parameters["iterations"] = std::to_string(iterations);
+    parameters["subsets"]    = std::to_string(subsets);
+    parameters["tolerance"]  = "0";
+
+    ReconConfig config("");
+    config.ProjectionInfo.fCenter    = m_nSize/2;
+    config.ProjectionInfo.eDirection = kipl::base::RotationDirCCW;
+    sirt.Configure(config,parameters);
+
+    size_t roi[4]={0,0,m_nSize,m_nSlices};
+    sirt.SetROI(roi);
+
+    std::ostringstream angles;
+    for (auto &angle : m_Angles)
+        angles<<angle<<" ";
+
+    std::map<std::string,std::string> projParameters;
+    projParameters["angles"]  = angles.str();
+    projParameters["weights"] = angles.str();
+
+    kipl::base::TImage<float,3> projections(m_Projections.Dims());
+    std::copy_n(m_Projections.GetDataPtr(),m_Projections.Size(),projections.GetDataPtr());
+    sirt.Process(projections,projParameters);
+
+    std::vector<float> errors;
+    for (size_t s=0; s<m_nSlices; ++s) {
+        kipl::base::TImage<float,2> slice=sirt.GetSlice(s);
+
+        double error=0.0;
+        double norm=0.0;
+        for (size_t i=0; i<slice.Size(); ++i) {
+            const double diff=slice[i]-m_Phantom[i];
+            error += diff*diff;
+            norm  += static_cast<double>(m_Phantom[i])*m_Phantom[i];
+        }
+        errors.push_back(static_cast<float>(std::sqrt(error/norm)));
+    }
+
+    return errors;
+}
+
+void TIterativeBackProjTest::testSIRTConvergence()
+{
+    std::vector<float> errors5  = reconstructionError(1,5);
+    std::vector<float> errors20 = reconstructionError(1,20);
+    std::vector<float> errors80 = reconstructionError(1,80);
+
+    QCOMPARE(errors5.size(),m_nSlices);
+
+    for (size_t s=0; s<m_nSlices; ++s) {
+        // The slices have the same data and are reconstructed independently
+        QCOMPARE(errors80[s],errors80[0]);
+
+        QVERIFY(errors20[s]<errors5[s]);
+        QVERIFY(errors80[s]<errors20[s]);
+    }
+
+    QVERIFY(errors80[0]<0.2f);
+}
+
+void TIterativeBackProjTest::testOSSARTConvergence()
+{
+    std::vector<float> sirt       = reconstructionError(1,5);
+    std::vector<float> ossart5    = reconstructionError(8,5);
+    std::vector<float> ossart20   = reconstructionError(8,20);
+
+    for (size_t s=0; s<m_nSlices; ++s) {
+        QCOMPARE(ossart20[s],ossart20[0]);
+
+        // The ordered subsets make one update per subset, they converge faster per iteration
+        QVERIFY(ossart5[s]<sirt[s]);
+        QVERIFY(ossart20[s]<ossart5[s]);
+    }
+
+    QVERIFY(ossart20[0]<0.2f);
+}
+
+QTEST_APPLESS_MAIN(TIterativeBackProjTest)
+
+#include "tst_iterativebackprojtest.moc"
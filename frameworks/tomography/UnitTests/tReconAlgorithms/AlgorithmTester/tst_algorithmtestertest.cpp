@@ -1,4 +1,5 @@
 #include <list>
+#include <random>
 
 #include <QString>
 #include <QtTest>
@@ -9,6 +10,10 @@
 #include <basicforwardprojector.h>
 #include <nnforwardprojector.h>
 #include <linearforwardprojector.h>
+#include <basicbackprojector.h>
+#include <josephprojector.h>
+#include <reconalgorithmexception.h>
+#include <profile/Timer.h>
 
 class AlgorithmTesterTest : public QObject
 {
@@ -20,6 +25,9 @@ public:
 private Q_SLOTS:
     void testNN();
     void testLinearFwd();
+    void testLinearBackProjectorAdjoint();
+    void testJosephProjector();
+    void benchmarkForwardProjectors();
 };
 
 AlgorithmTesterTest::AlgorithmTesterTest()
@@ -89,6 +97,232 @@ void AlgorithmTesterTest::testLinearFwd()
 
   //  QVERIFY2(true, "Failure");
 }
+void AlgorithmTesterTest::testLinearBackProjectorAdjoint()
+{
+    // The iterative methods need a matched pair, <Ax,y> must equal <x,A'y>
+    list<float> angles;
+    const int N=37;
+    for (int i=0; i<N; i++)
+        angles.push_back(3.1f+i*180.0f/N);
+
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> distribution(0.0f,1.0f);
+
+    for (size_t size : {32, 33}) {
+        for (float center : {-1.0f, 15.3f}) {
+            size_t sliceDims[2]={size,size};
+            size_t sinoDims[2]={size,angles.size()};
+            kipl::base::TImage<float,2> x(sliceDims);
+            kipl::base::TImage<float,2> y(sinoDims);
+            kipl::base::TImage<float,2> Ax;
+            kipl::base::TImage<float,2> ATy;
+
+            for (size_t i=0; i<x.Size(); i++)
+                x[i]=distribution(generator);
+
+            for (size_t i=0; i<y.Size(); i++)
+                y[i]=distribution(generator);
+
+            LinearForwardProjector linfp;
+            linfp.setCenter(center);
+            linfp.project(x,angles,Ax);
+            QCOMPARE(Ax.Size(0),size);
+            QCOMPARE(Ax.Size(1),angles.size());
+
+            BasicBackProjector bp;
+            bp.backproject(y, center<0.0f ? static_cast<float>(size/2) : center, angles, ATy);
+            QCOMPARE(ATy.Size(0),size);
+            QCOMPARE(ATy.Size(1),size);
+
+            double forward=0.0;
+            double backward=0.0;
+            for (size_t i=0; i<y.Size(); i++)
+                forward+=static_cast<double>(Ax[i])*y[i];
+
+            for (size_t i=0; i<x.Size(); i++)
+                backward+=static_cast<double>(ATy[i])*x[i];
+
+            QVERIFY(std::abs(forward-backward)<1e-5*std::abs(forward));
+        }
+    }
+}
+
+void AlgorithmTesterTest::testJosephProjector()
+{
+    list<float> angles;
+    const int N=37;
+    for (int i=0; i<N; i++)
+        angles.push_back(3.1f+i*180.0f/N);
+
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<float> distribution(0.0f,1.0f);
+
+    for (size_t size : {32, 33, 101}) {
+        for (float center : {-1.0f, 15.3f}) {
+            size_t sliceDims[2]={size,size};
+            size_t sinoDims[2]={size,angles.size()};
+            kipl::base::TImage<float,2> x(sliceDims);
+            kipl::base::TImage<float,2> y(sinoDims);
+
+            for (size_t i=0; i<x.Size(); i++)
+                x[i]=distribution(generator);
+
+            for (size_t i=0; i<y.Size(); i++)
+                y[i]=distribution(generator);
+
+            // Same geometry as the linear projector pair
+            kipl::base::TImage<float,2> Ax;
+            kipl::base::TImage<float,2> linAx;
+            JosephForwardProjector jfp;
+            LinearForwardProjector linfp;
+            jfp.setCenter(center);
+            linfp.setCenter(center);
+            jfp.project(x,angles,Ax);
+            linfp.project(x,angles,linAx);
+
+            QCOMPARE(Ax.Size(0),linAx.Size(0));
+            QCOMPARE(Ax.Size(1),linAx.Size(1));
+            for (size_t i=0; i<Ax.Size(); i++)
+                QVERIFY(std::abs(Ax[i]-linAx[i])<=1e-3f*(1.0f+std::abs(linAx[i])));
+
+            const float bpCenter = center<0.0f ? static_cast<float>(size/2) : center;
+            kipl::base::TImage<float,2> ATy;
+            kipl::base::TImage<float,2> basicATy;
+            JosephBackProjector jbp;
+            BasicBackProjector bbp;
+            jbp.backproject(y,bpCenter,angles,ATy);
+            bbp.backproject(y,bpCenter,angles,basicATy);
+
+            QCOMPARE(ATy.Size(0),size);
+            QCOMPARE(ATy.Size(1),size);
+            for (size_t i=0; i<ATy.Size(); i++)
+                QVERIFY(std::abs(ATy[i]-basicATy[i])<=1e-3f*(1.0f+std::abs(basicATy[i])));
+
+            // Matched pair
+            double forward=0.0;
+            double backward=0.0;
+            for (size_t i=0; i<y.Size(); i++)
+                forward+=static_cast<double>(Ax[i])*y[i];
+
+            for (size_t i=0; i<x.Size(); i++)
+                backward+=static_cast<double>(ATy[i])*x[i];
+
+            QVERIFY(std::abs(forward-backward)<1e-5*std::abs(forward));
+        }
+    }
+
+    // The stack versions give the same sinograms as the slice versions
+    size_t volDims[3]={33,33,5};
+    kipl::base::TImage<float,3> volume(volDims);
+    for (size_t i=0; i<volume.Size(); i++)
+        volume[i]=distribution(generator);
+
+    JosephForwardProjector jfp;
+    kipl::base::TImage<float,3> sinograms;
+    jfp.project(volume,angles,sinograms);
+    QCOMPARE(sinograms.Size(1),angles.size());
+    QCOMPARE(sinograms.Size(2),volume.Size(2));
+
+    kipl::base::TImage<float,2> slice(volDims);
+    kipl::base::TImage<float,2> sino;
+    std::copy_n(volume.GetLinePtr(0,3),slice.Size(),slice.GetDataPtr());
+    jfp.project(slice,angles,sino);
+    for (size_t i=0; i<sino.Size(); i++)
+        QCOMPARE(sinograms.GetLinePtr(0,3)[i],sino[i]);
+
+    // A reused projector rebuilds its tables when the geometry changes
+    JosephForwardProjector fresh;
+    kipl::base::TImage<float,2> reference;
+    jfp.setCenter(15.3f);
+    fresh.setCenter(15.3f);
+    jfp.project(slice,angles,sino);
+    fresh.project(slice,angles,reference);
+    for (size_t i=0; i<sino.Size(); i++)
+        QCOMPARE(sino[i],reference[i]);
+
+    angles.pop_back();
+    jfp.project(slice,angles,sino);
+    fresh.project(slice,angles,reference);
+    QCOMPARE(sino.Size(1),angles.size());
+    for (size_t i=0; i<sino.Size(); i++)
+        QCOMPARE(sino[i],reference[i]);
+
+    // The cache keeps the tables of each angle set, e.g. the subsets of OS-SART, until the capacity is reached
+    JosephGeometryCache cache(2);
+    std::list<float> first={0.0f,45.0f};
+    std::list<float> second={90.0f};
+    std::list<float> third={10.0f,20.0f,30.0f};
+    std::shared_ptr<const JosephGeometry> geometry=cache.get(first,33,-1.0f);
+    QCOMPARE(geometry->size(),first.size());
+    QCOMPARE(cache.get(second,33,-1.0f)->size(),second.size());
+    QVERIFY(cache.get(first,33,-1.0f)==geometry);
+    QCOMPARE(cache.size(),size_t(2));
+
+    cache.get(third,33,-1.0f); // Removes the least recently used, i.e. the second set
+    QCOMPARE(cache.size(),size_t(2));
+    QVERIFY(cache.get(first,33,-1.0f)==geometry);
+    QVERIFY(cache.get(first,33,15.3f)!=geometry);
+    QVERIFY(cache.get(first,34,-1.0f)!=geometry);
+
+    // A failed build isn't cached
+    QVERIFY_EXCEPTION_THROWN(cache.get(first,1,-1.0f),ReconAlgorithmException);
+    QCOMPARE(cache.size(),size_t(2));
+    QVERIFY_EXCEPTION_THROWN(cache.get(first,1,-1.0f),ReconAlgorithmException);
+}
+
+void AlgorithmTesterTest::benchmarkForwardProjectors()
+{
+    list<float> angles;
+    for (int i=0; i<360; i++)
+        angles.push_back(i*0.5f);
+
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<float> distribution(0.0f,1.0f);
+
+    size_t dims[2]={512,512};
+    kipl::base::TImage<float,2> slice(dims);
+    for (size_t i=0; i<slice.Size(); i++)
+        slice[i]=distribution(generator);
+
+    kipl::base::TImage<float,2> proj;
+    kipl::base::TImage<float,2> bp;
+    kipl::profile::Timer timer;
+
+    NNForwardProjector nnfp;
+    timer.Tic();
+    nnfp.project(slice,angles,proj);
+    timer.Toc();
+    qDebug() << "NN forward projection:" << timer.elapsedTime(kipl::profile::Timer::milliSeconds) << "ms";
+
+    LinearForwardProjector linfp;
+    timer.reset();
+    timer.Tic();
+    linfp.project(slice,angles,proj);
+    timer.Toc();
+    qDebug() << "Linear forward projection:" << timer.elapsedTime(kipl::profile::Timer::milliSeconds) << "ms";
+
+    JosephForwardProjector jfp;
+    timer.reset();
+    timer.Tic();
+    jfp.project(slice,angles,proj);
+    timer.Toc();
+    qDebug() << "Joseph forward projection:" << timer.elapsedTime(kipl::profile::Timer::milliSeconds) << "ms";
+
+    BasicBackProjector bbp;
+    timer.reset();
+    timer.Tic();
+    bbp.backproject(proj,256.0f,angles,bp);
+    timer.Toc();
+    qDebug() << "Basic back projection:" << timer.elapsedTime(kipl::profile::Timer::milliSeconds) << "ms";
+
+    JosephBackProjector jbp;
+    timer.reset();
+    timer.Tic();
+    jbp.backproject(proj,256.0f,angles,bp);
+    timer.Toc();
+    qDebug() << "Joseph back projection:" << timer.elapsedTime(kipl::profile::Timer::milliSeconds) << "ms";
+}
+
 QTEST_APPLESS_MAIN(AlgorithmTesterTest)
 
 #include "tst_algorithmtestertest.moc"